@@ -234,6 +234,22 @@ static inline int z_impl_behavior_keymap_binding_convert_central_state_dependent
     return api->binding_convert_central_state_dependent_params(binding, event);
 }
 
+/**
+ * @brief Check whether a behavior converts its parameters based on central state before use
+ * @param behavior Pointer to the device structure for the driver instance.
+ *
+ * Callers that already resolved the behavior device can use this to skip
+ * behavior_keymap_binding_convert_central_state_dependent_params(), which looks the behavior up
+ * by name again, for the majority of behaviors that don't implement it.
+ *
+ * @retval true If the behavior implements binding_convert_central_state_dependent_params.
+ */
+static inline bool behavior_has_central_state_dependent_params(const struct device *behavior) {
+    const struct behavior_driver_api *api = (const struct behavior_driver_api *)behavior->api;
+
+    return api->binding_convert_central_state_dependent_params != NULL;
+}
+
 #if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_METADATA)
 
 /**
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/types.h>
+#include <stddef.h>
+#include <zephyr/device.h>
+
+/**
+ * Motion an input listener accumulated from one input sync, or from one report interval when
+ * CONFIG_ZMK_INPUT_LISTENER_REPORT_INTERVAL_MS is set.
+ */
+struct zmk_input_processor_frame {
+    int32_t x;
+    int32_t y;
+    // In 1 / ZMK_MOUSE_HID_SCROLL_PER_DETENT detents.
+    int32_t scroll_x;
+    int32_t scroll_y;
+    // Uptime the frame was completed at.
+    int64_t timestamp;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @cond INTERNAL_HIDDEN
+ *
+ * Input processor driver API definition and system call entry points.
+ *
+ * (Internal use only.)
+ */
+
+typedef int (*input_processor_process_frame_t)(const struct device *dev,
+                                               struct zmk_input_processor_frame *frame,
+                                               uint32_t param1, uint32_t param2);
+
+__subsystem struct input_processor_driver_api {
+    input_processor_process_frame_t process_frame;
+};
+/**
+ * @endcond
+ */
+
+/**
+ * @brief Process one frame of motion, changing it in place.
+ * @param dev Pointer to the device structure for the driver instance.
+ * @param frame The frame to process.
+ * @param param1 First parameter given to the processor in the listener's input-processors.
+ * @param param2 Second parameter given to the processor in the listener's input-processors.
+ *
+ * @retval 0 If successful.
+ * @retval Negative errno code if failure.
+ */
+__syscall int zmk_input_processor_process_frame(const struct device *dev,
+                                                struct zmk_input_processor_frame *frame,
+                                                uint32_t param1, uint32_t param2);
+
+static inline int z_impl_zmk_input_processor_process_frame(const struct device *dev,
+                                                           struct zmk_input_processor_frame *frame,
+                                                           uint32_t param1, uint32_t param2) {
+    const struct input_processor_driver_api *api =
+        (const struct input_processor_driver_api *)dev->api;
+
+    if (api->process_frame == NULL) {
+        return -ENOTSUP;
+    }
+
+    return api->process_frame(dev, frame, param1, param2);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#include <syscalls/input_processor.h>
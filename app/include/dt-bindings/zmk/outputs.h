@@ -6,4 +6,5 @@
 
 #define OUT_TOG 0
 #define OUT_USB 1
-#define OUT_BLE 2
\ No newline at end of file
+#define OUT_BLE 2
+#define OUT_MIR 3
\ No newline at end of file
@@ -36,3 +36,23 @@ struct zmk_behavior_binding_event {
  * unrelated node which shares the same name as a behavior.
  */
 const struct device *zmk_behavior_get_binding(const char *name);
+
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_IDS)
+
+/**
+ * @brief Get a compact identifier for the behavior with the given @p name.
+ *
+ * The identifier is a CRC16 of the name, so it is the same on every part of a split keyboard and
+ * can be sent in place of the name.
+ */
+uint16_t zmk_behavior_get_id(const char *name);
+
+/**
+ * @brief Get a const struct device* for a behavior from its identifier.
+ *
+ * @retval Pointer to the device structure for the behavior with the given identifier.
+ * @retval NULL if no behavior, or more than one behavior, has the identifier.
+ */
+const struct device *zmk_behavior_get_binding_by_id(uint16_t id);
+
+#endif // IS_ENABLED(CONFIG_ZMK_BEHAVIOR_IDS)
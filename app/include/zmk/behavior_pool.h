@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/devicetree.h>
+#include <zephyr/sys/util.h>
+
+/*
+ * Behaviors that keep state while active, such as hold-taps, keep it in a pool with one entry per
+ * key position the behavior is active on. Only one binding can be active on a position at a time,
+ * so a behavior only bound in the keymap layers and combos never needs more entries than bindings.
+ *
+ * Any other node that references a behavior instance, such as a macro, tap-dance or sideband
+ * behavior, can invoke it on positions outside of that count, so the pool then keeps its maximum.
+ */
+
+#define ZMK_BEHAVIOR_POOL_KEYMAP DT_INST(0, zmk_keymap)
+#define ZMK_BEHAVIOR_POOL_COMBOS DT_INST(0, zmk_combos)
+
+#define ZMK_BEHAVIOR_POOL_IS_BINDING(node, prop, idx, ord)                                         \
+    +(DT_DEP_ORD(DT_PHANDLE_BY_IDX(node, prop, idx)) == (ord))
+
+#define ZMK_BEHAVIOR_POOL_PROP_USES(node, prop, ord)                                               \
+    COND_CODE_1(DT_NODE_HAS_PROP(node, prop),                                                      \
+                ((0 DT_FOREACH_PROP_ELEM_VARGS(node, prop, ZMK_BEHAVIOR_POOL_IS_BINDING, ord))),   \
+                (0))
+
+#define ZMK_BEHAVIOR_POOL_NODE_USES(node, ord)                                                     \
+    (ZMK_BEHAVIOR_POOL_PROP_USES(node, bindings, ord) +                                            \
+     ZMK_BEHAVIOR_POOL_PROP_USES(node, sensor_bindings, ord))
+
+#define ZMK_BEHAVIOR_POOL_CHILD_USES(node, ord) +ZMK_BEHAVIOR_POOL_NODE_USES(node, ord)
+#define ZMK_BEHAVIOR_POOL_CHILD_REFS(node, ord) +(ZMK_BEHAVIOR_POOL_NODE_USES(node, ord) > 0)
+
+#define ZMK_BEHAVIOR_POOL_SUM_CHILDREN(fn, ord)                                                    \
+    (0 DT_FOREACH_CHILD_VARGS(ZMK_BEHAVIOR_POOL_KEYMAP, fn, ord)                                   \
+         COND_CODE_1(DT_NODE_EXISTS(ZMK_BEHAVIOR_POOL_COMBOS),                                     \
+                     (DT_FOREACH_CHILD_VARGS(ZMK_BEHAVIOR_POOL_COMBOS, fn, ord)), ()))
+
+// Layers and combos each reference an instance once, however many times they bind it, so any
+// further node that references it is something else.
+#define ZMK_BEHAVIOR_POOL_OTHER_REFS(node)                                                         \
+    (NUM_VA_ARGS_LESS_1(DT_SUPPORTS_DEP_ORDS(node)) >                                              \
+     ZMK_BEHAVIOR_POOL_SUM_CHILDREN(ZMK_BEHAVIOR_POOL_CHILD_REFS, DT_DEP_ORD(node)))
+
+#define ZMK_BEHAVIOR_POOL_INST_SIZE(node, max)                                                     \
+    +(ZMK_BEHAVIOR_POOL_OTHER_REFS(node)                                                           \
+          ? (max)                                                                                  \
+          : ZMK_BEHAVIOR_POOL_SUM_CHILDREN(ZMK_BEHAVIOR_POOL_CHILD_USES, DT_DEP_ORD(node)))
+
+/**
+ * The number of entries for the pool shared by all instances of the behavior compatible with
+ * @p compat, at most @p max. With CONFIG_ZMK_BEHAVIOR_POOLS_FROM_KEYMAP, this is the number of
+ * times the instances are bound in the keymap and combos, and otherwise @p max.
+ */
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_POOLS_FROM_KEYMAP)
+#define ZMK_BEHAVIOR_POOL_SIZE(compat, max)                                                        \
+    MAX(1, MIN((max), (0 DT_FOREACH_STATUS_OKAY_VARGS(compat, ZMK_BEHAVIOR_POOL_INST_SIZE, max))))
+#else
+#define ZMK_BEHAVIOR_POOL_SIZE(compat, max) (max)
+#endif
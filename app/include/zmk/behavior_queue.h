@@ -12,3 +12,22 @@
 
 int zmk_behavior_queue_add(uint32_t position, const struct zmk_behavior_binding behavior,
                            bool press, uint32_t wait);
+
+/**
+ * @return The number of behaviors that can be added to the queue before it is full.
+ */
+int zmk_behavior_queue_free_count(void);
+
+/**
+ * Drop any queued behaviors that were added for the given position. Releases for bindings whose
+ * press was already invoked are kept, so nothing is left held.
+ *
+ * @return The number of queued behaviors that were dropped.
+ */
+int zmk_behavior_queue_cancel(uint32_t position);
+
+/**
+ * Notify the queue that a transport has delivered a report to the host, so a queue waiting on
+ * report delivery can move on. Safe to call from any context.
+ */
+void zmk_behavior_queue_report_delivered(void);
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+enum zmk_benchmark_queue {
+    ZMK_BENCHMARK_QUEUE_KSCAN,
+    ZMK_BENCHMARK_QUEUE_BEHAVIORS,
+    ZMK_BENCHMARK_QUEUE_COUNT,
+};
+
+#if IS_ENABLED(CONFIG_ZMK_BENCHMARK)
+
+/**
+ * Marks the start of processing a key event from the kscan queue.
+ */
+void zmk_benchmark_key_event_begin(void);
+
+/**
+ * Marks the end of processing the key event started with zmk_benchmark_key_event_begin().
+ */
+void zmk_benchmark_key_event_end(void);
+
+/**
+ * Counts a call of an event listener.
+ */
+void zmk_benchmark_listener_called(void);
+
+/**
+ * Records that a keyboard or consumer report was sent, timed from the key event behind it.
+ */
+void zmk_benchmark_report_sent(void);
+
+/**
+ * Records that an item was added to or removed from the queue.
+ */
+void zmk_benchmark_queue_push(enum zmk_benchmark_queue queue);
+void zmk_benchmark_queue_pop(enum zmk_benchmark_queue queue);
+
+#else
+
+static inline void zmk_benchmark_key_event_begin(void) {}
+static inline void zmk_benchmark_key_event_end(void) {}
+static inline void zmk_benchmark_listener_called(void) {}
+static inline void zmk_benchmark_report_sent(void) {}
+static inline void zmk_benchmark_queue_push(enum zmk_benchmark_queue queue) {}
+static inline void zmk_benchmark_queue_pop(enum zmk_benchmark_queue queue) {}
+
+#endif // IS_ENABLED(CONFIG_ZMK_BENCHMARK)
@@ -6,6 +6,9 @@
 
 #pragma once
 
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/sys/util.h>
+
 #include <zmk/keys.h>
 #include <zmk/ble/profile.h>
 
@@ -14,7 +17,10 @@
      IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL))
 
 #if ZMK_BLE_IS_CENTRAL
-#define ZMK_BLE_PROFILE_COUNT (CONFIG_BT_MAX_PAIRED - CONFIG_ZMK_SPLIT_BLE_CENTRAL_PERIPHERALS)
+// A dongle central pairs only with peripherals, but keeps one profile that never advertises so
+// code indexing the profiles still has one to work with.
+#define ZMK_BLE_PROFILE_COUNT                                                                      \
+    MAX(1, CONFIG_BT_MAX_PAIRED - CONFIG_ZMK_SPLIT_BLE_CENTRAL_PERIPHERALS)
 #define ZMK_SPLIT_BLE_PERIPHERAL_COUNT CONFIG_ZMK_SPLIT_BLE_CENTRAL_PERIPHERALS
 #else
 #define ZMK_BLE_PROFILE_COUNT CONFIG_BT_MAX_PAIRED
@@ -29,7 +35,13 @@ int zmk_ble_prof_disconnect(uint8_t index);
 
 int zmk_ble_active_profile_index(void);
 int zmk_ble_profile_index(const bt_addr_le_t *addr);
+/**
+ * Returns the profile of the host on @p conn, like zmk_ble_profile_index() with the connection's
+ * address, but without comparing against every profile each time the same connection is looked up.
+ */
+int zmk_ble_profile_index_for_conn(const struct bt_conn *conn);
 bt_addr_le_t *zmk_ble_active_profile_addr(void);
+bt_addr_le_t *zmk_ble_profile_addr(uint8_t index);
 bool zmk_ble_active_profile_is_open(void);
 bool zmk_ble_active_profile_is_connected(void);
 char *zmk_ble_active_profile_name(void);
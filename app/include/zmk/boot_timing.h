@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/init.h>
+#include <zephyr/sys/util.h>
+
+#if IS_ENABLED(CONFIG_ZMK_BOOT_TIMING)
+
+/**
+ * Record the time since boot at which a boot milestone was reached. Only the first mark with a
+ * given name is recorded, so milestones that can happen again, such as connections, keep the time
+ * they were first reached.
+ */
+void zmk_boot_timing_mark(const char *name);
+
+/**
+ * Define a SYS_INIT function. With CONFIG_ZMK_BOOT_TIMING, the time each one finishes is recorded
+ * with its function name.
+ */
+#define ZMK_SYS_INIT(init_fn, level, prio)                                                         \
+    static int _CONCAT(init_fn, _timed)(void) {                                                    \
+        int ret = init_fn();                                                                       \
+        zmk_boot_timing_mark(#init_fn);                                                            \
+        return ret;                                                                                \
+    }                                                                                              \
+    SYS_INIT(_CONCAT(init_fn, _timed), level, prio)
+
+#else
+
+static inline void zmk_boot_timing_mark(const char *name) {}
+
+#define ZMK_SYS_INIT(init_fn, level, prio) SYS_INIT(init_fn, level, prio)
+
+#endif // IS_ENABLED(CONFIG_ZMK_BOOT_TIMING)
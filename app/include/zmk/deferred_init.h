@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/init.h>
+#include <zephyr/sys/util.h>
+
+#include <zmk/boot_timing.h>
+
+struct zmk_deferred_init {
+    int (*init)(void);
+    const char *name;
+};
+
+#if IS_ENABLED(CONFIG_ZMK_DEFERRED_INIT)
+
+/**
+ * Run an init function for a subsystem that isn't needed to send the first key press. With
+ * CONFIG_ZMK_DEFERRED_INIT it runs on the low priority work queue once key scanning has started,
+ * in order of priority from 0 to 99, and otherwise as a SYS_INIT function at the APPLICATION
+ * level with the same priority.
+ *
+ * Event listeners and public functions of the subsystem can run before the init function does,
+ * so they must cope with the subsystem not being initialized yet.
+ */
+#define ZMK_DEFERRED_INIT(init_fn, prio)                                                           \
+    static const struct zmk_deferred_init _CONCAT(zmk_deferred_init_, init_fn) __attribute__((     \
+        __used__, __section__(".zmk_deferred_init." STRINGIFY(prio) "_" #init_fn))) = {            \
+        .init = init_fn,                                                                           \
+        .name = #init_fn,                                                                          \
+    }
+
+/**
+ * Start running the deferred init functions. Called once key scanning has started.
+ */
+void zmk_deferred_init_start(void);
+
+#else
+
+#define ZMK_DEFERRED_INIT(init_fn, prio) ZMK_SYS_INIT(init_fn, APPLICATION, prio)
+
+static inline void zmk_deferred_init_start(void) {}
+
+#endif // IS_ENABLED(CONFIG_ZMK_DEFERRED_INIT)
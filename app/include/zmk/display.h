@@ -10,16 +10,65 @@
 
 #pragma once
 
+#include <zephyr/kernel.h>
+
 struct k_work_q *zmk_display_work_q(void);
 
 bool zmk_display_is_initialized(void);
 int zmk_display_init(void);
 
+/**
+ * @brief Render any changes made to LVGL objects. Call this from the display queue context after
+ * updating the UI outside of the widget listener macros, which already call it. This does nothing
+ * unless CONFIG_ZMK_DISPLAY_TICK_ON_DEMAND is enabled, since LVGL otherwise runs periodically.
+ */
+void zmk_display_request_tick(void);
+
+/**
+ * @brief Get the bytes currently allocated from the LVGL heap, and the most allocated at once
+ * since boot. Needs CONFIG_ZMK_DISPLAY_MEM_STATS.
+ */
+void zmk_display_mem_stats_get(size_t *used, size_t *peak);
+
+/**
+ * @brief A widget update waiting to be applied with the next batch of widget updates.
+ */
+struct zmk_display_widget_update {
+    sys_snode_t node;
+    atomic_t pending;
+    void (*apply)(void);
+};
+
+#define ZMK_DISPLAY_WIDGET_UPDATE_INIT(apply_func) {.apply = apply_func}
+
+/**
+ * @brief Queue a widget update to be applied in the display queue context, together with every
+ * other update queued within CONFIG_ZMK_DISPLAY_WIDGET_BATCH_MS. An update queued again before
+ * it is applied is only applied once, so it should read the latest state when it runs.
+ */
+void zmk_display_widget_update_submit(struct zmk_display_widget_update *update);
+
+/**
+ * @brief Set the text of a widget's label. With CONFIG_ZMK_DISPLAY_WIDGET_STATIC_TEXT the text is
+ * copied into the widget's `text` buffer and the label points at it, so updates don't allocate
+ * from the LVGL heap. Text longer than the buffer is truncated.
+ */
+#if IS_ENABLED(CONFIG_ZMK_DISPLAY_WIDGET_STATIC_TEXT)
+#define ZMK_DISPLAY_WIDGET_SET_TEXT(widget, str)                                                   \
+    do {                                                                                           \
+        snprintf((widget)->text, sizeof((widget)->text), "%s", (str));                             \
+        lv_label_set_text_static((widget)->obj, (widget)->text);                                   \
+    } while (0)
+#else
+#define ZMK_DISPLAY_WIDGET_SET_TEXT(widget, str) lv_label_set_text((widget)->obj, (str))
+#endif
+
 /**
  * @brief Macro to define a ZMK event listener that handles the thread safety of fetching
  * the necessary state from the system work queue context, invoking a work callback
  * in the display queue context, and properly accessing that state safely when performing
- * display/LVGL updates.
+ * display/LVGL updates. Updates are batched with zmk_display_widget_update_submit(), so several
+ * events before the batch is applied only update the UI with the last state.
  *
  * @param listener THe ZMK Event manager listener name.
  * @param state_type The struct/enum type used to store/transfer state.
@@ -39,8 +88,9 @@ int zmk_display_init(void);
         k_mutex_unlock(&listener##_mutex);                                                         \
         return copy;                                                                               \
     };                                                                                             \
-    static void listener##_work_cb(struct k_work *work) { cb(listener##_get_local_state()); };     \
-    K_WORK_DEFINE(listener##_work, listener##_work_cb);                                            \
+    static void listener##_apply() { cb(listener##_get_local_state()); }                           \
+    static struct zmk_display_widget_update listener##_update =                                    \
+        ZMK_DISPLAY_WIDGET_UPDATE_INIT(listener##_apply);                                          \
     static void listener##_refresh_state(const zmk_event_t *eh) {                                  \
         k_mutex_lock(&listener##_mutex, K_FOREVER);                                                \
         __##listener##_state = state_func(eh);                                                     \
@@ -48,12 +98,46 @@ int zmk_display_init(void);
     };                                                                                             \
     static void listener##_init() {                                                                \
         listener##_refresh_state(NULL);                                                            \
-        listener##_work_cb(NULL);                                                                  \
+        listener##_apply();                                                                        \
+        zmk_display_request_tick();                                                                \
     }                                                                                              \
     static int listener##_cb(const zmk_event_t *eh) {                                              \
         if (zmk_display_is_initialized()) {                                                        \
             listener##_refresh_state(eh);                                                          \
-            k_work_submit_to_queue(zmk_display_work_q(), &listener##_work);                        \
+            zmk_display_widget_update_submit(&listener##_update);                                  \
+        }                                                                                          \
+        return ZMK_EV_EVENT_BUBBLE;                                                                \
+    }                                                                                              \
+    ZMK_LISTENER(listener, listener##_cb);
+
+/**
+ * @brief Like ZMK_DISPLAY_WIDGET_LISTENER(), but the state is also fetched in the display queue
+ * context, so handling the event only queues the update. Several events before the batch is
+ * applied are coalesced into a single update.
+ *
+ * Use this for state that is cheap to query from ZMK core at any time, such as the layer state,
+ * so display updates never add to the time spent handling an event in the key path.
+ *
+ * @param listener The ZMK Event manager listener name.
+ * @param state_type The struct/enum type used to store/transfer state.
+ * @param cb The callback to invoke in the display queue context to update the UI. Should be `void
+ * func(state_type)` signature.
+ * @param state_func The callback function to invoke to fetch the current state from ZMK core.
+ * Should be `state type func(const zmk_event_t *eh)` signature, and is always passed NULL.
+ * @retval listener##_init Generates a function `listener##_init` that should be called by the
+ * widget once ready to be updated.
+ **/
+#define ZMK_DISPLAY_WIDGET_DEFERRED_LISTENER(listener, state_type, cb, state_func)                 \
+    static void listener##_apply() { cb(state_func(NULL)); }                                       \
+    static struct zmk_display_widget_update listener##_update =                                    \
+        ZMK_DISPLAY_WIDGET_UPDATE_INIT(listener##_apply);                                          \
+    static void listener##_init() {                                                                \
+        listener##_apply();                                                                        \
+        zmk_display_request_tick();                                                                \
+    }                                                                                              \
+    static int listener##_cb(const zmk_event_t *eh) {                                              \
+        if (zmk_display_is_initialized()) {                                                        \
+            zmk_display_widget_update_submit(&listener##_update);                                  \
         }                                                                                          \
         return ZMK_EV_EVENT_BUBBLE;                                                                \
     }                                                                                              \
@@ -12,6 +12,9 @@
 struct zmk_widget_output_status {
     sys_snode_t node;
     lv_obj_t *obj;
+#if IS_ENABLED(CONFIG_ZMK_DISPLAY_WIDGET_STATIC_TEXT)
+    char text[10];
+#endif
 };
 
 int zmk_widget_output_status_init(struct zmk_widget_output_status *widget, lv_obj_t *parent);
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <errno.h>
+#include <stdint.h>
+
+#include <zmk/endpoints_types.h>
+
+struct zmk_endpoint_latency_stats {
+    uint32_t count;
+    uint32_t avg_ms;
+    uint32_t max_ms;
+};
+
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+
+/**
+ * Sets the timestamp of the event that caused the reports about to be sent.
+ */
+void zmk_endpoint_latency_set_origin(int64_t timestamp);
+
+/**
+ * Gets the origin to attach to a report as it is queued by a transport.
+ */
+uint32_t zmk_endpoint_latency_origin(void);
+
+/**
+ * Records that a report with the given origin has been delivered by the transport.
+ */
+void zmk_endpoint_latency_record(enum zmk_transport transport, uint32_t origin);
+
+/**
+ * Gets a summary of the latencies recorded for the transport.
+ */
+int zmk_endpoint_latency_get_stats(enum zmk_transport transport,
+                                   struct zmk_endpoint_latency_stats *stats);
+
+#else
+
+static inline void zmk_endpoint_latency_set_origin(int64_t timestamp) {}
+static inline uint32_t zmk_endpoint_latency_origin(void) { return 0; }
+static inline void zmk_endpoint_latency_record(enum zmk_transport transport, uint32_t origin) {}
+static inline int zmk_endpoint_latency_get_stats(enum zmk_transport transport,
+                                                 struct zmk_endpoint_latency_stats *stats) {
+    return -ENOTSUP;
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
@@ -63,6 +63,23 @@ int zmk_endpoint_instance_to_index(struct zmk_endpoint_instance endpoint);
 int zmk_endpoints_select_transport(enum zmk_transport transport);
 int zmk_endpoints_toggle_transport(void);
 
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
+/**
+ * Enables or disables mirroring. While enabled and both USB and BLE are connected, reports are
+ * sent to USB and to the active BLE profile. The selected endpoint is unaffected.
+ */
+int zmk_endpoints_set_mirror(bool enabled);
+int zmk_endpoints_toggle_mirror(void);
+bool zmk_endpoints_mirror_enabled(void);
+#endif // IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
+
+/**
+ * Whether the key release must be reported before the modifier release for the current endpoint,
+ * for hosts that otherwise see the modifier release first.
+ */
+bool zmk_endpoints_separate_mod_release(void);
+int zmk_endpoints_set_separate_mod_release(struct zmk_endpoint_instance endpoint, bool enabled);
+
 /**
  * Gets the currently-selected endpoint.
  */
@@ -72,6 +89,16 @@ int zmk_endpoints_send_report(uint16_t usage_page);
 
 #if IS_ENABLED(CONFIG_ZMK_MOUSE)
 int zmk_endpoints_send_mouse_report();
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+int zmk_endpoints_send_mouse_abs_report();
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+
+/**
+ * Gets how many scroll steps the selected endpoint takes per wheel detent. This is 1 unless the
+ * host enabled high resolution scrolling.
+ */
+int zmk_endpoints_mouse_scroll_multiplier(void);
 #endif // IS_ENABLED(CONFIG_ZMK_MOUSE)
 
 void zmk_endpoints_clear_current(void);
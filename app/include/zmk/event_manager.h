@@ -10,8 +10,12 @@
 #include <zephyr/kernel.h>
 #include <zephyr/types.h>
 
+struct zmk_event_subscription;
+
 struct zmk_event_type {
     const char *name;
+    /* First subscription to this event type, resolved at link time. */
+    const struct zmk_event_subscription *subscriptions;
 };
 
 typedef struct {
@@ -26,6 +30,11 @@ typedef struct {
 typedef int (*zmk_listener_callback_t)(const zmk_event_t *eh);
 struct zmk_listener {
     zmk_listener_callback_t callback;
+    /* Only set for listeners defined with ZMK_LISTENER_DYNAMIC, which can be disabled. */
+    bool *enabled;
+#if IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_TRACING)
+    const char *name;
+#endif
 };
 
 struct zmk_event_subscription {
@@ -43,8 +52,16 @@ struct zmk_event_subscription {
     struct event_type *as_##event_type(const zmk_event_t *eh);                                     \
     extern const struct zmk_event_type zmk_event_##event_type;
 
+#define ZMK_EVENT_SUBSCRIPTION_SECTION(event_type, part)                                           \
+    ".event_subscription." STRINGIFY(event_type) "." part
+
 #define ZMK_EVENT_IMPL(event_type)                                                                 \
-    const struct zmk_event_type zmk_event_##event_type = {.name = STRINGIFY(event_type)};          \
+    static const struct zmk_event_subscription zmk_event_subs_start_##event_type[0] __used         \
+        __attribute__((__section__(ZMK_EVENT_SUBSCRIPTION_SECTION(event_type, "0"))));             \
+    const struct zmk_event_type zmk_event_##event_type = {                                         \
+        .name = STRINGIFY(event_type),                                                             \
+        .subscriptions = zmk_event_subs_start_##event_type,                                        \
+    };                                                                                             \
     const struct zmk_event_type *zmk_event_ref_##event_type __used                                 \
         __attribute__((__section__(".event_type"))) = &zmk_event_##event_type;                     \
     struct event_type##_event copy_raised_##event_type(const struct event_type *ev) {              \
@@ -61,12 +78,27 @@ struct zmk_event_subscription {
                                                       : NULL;                                      \
     };
 
-#define ZMK_LISTENER(mod, cb) const struct zmk_listener zmk_listener_##mod = {.callback = cb};
+#define ZMK_LISTENER(mod, cb)                                                                      \
+    const struct zmk_listener zmk_listener_##mod = {                                               \
+        .callback = cb,                                                                            \
+        IF_ENABLED(CONFIG_ZMK_EVENT_MANAGER_TRACING, (.name = STRINGIFY(mod), ))};
+
+/*
+ * Define a listener that can be enabled and disabled at runtime with ZMK_LISTENER_SET_ENABLED.
+ * While disabled, its callback is skipped for every event it subscribes to, so listeners that only
+ * care about events while some state is active cost nothing the rest of the time.
+ */
+#define ZMK_LISTENER_DYNAMIC(mod, cb, initially_enabled)                                           \
+    static bool zmk_listener_enabled_##mod = initially_enabled;                                    \
+    const struct zmk_listener zmk_listener_##mod = {                                               \
+        .callback = cb,                                                                            \
+        .enabled = &zmk_listener_enabled_##mod,                                                    \
+        IF_ENABLED(CONFIG_ZMK_EVENT_MANAGER_TRACING, (.name = STRINGIFY(mod), ))};
 
 #define ZMK_SUBSCRIPTION(mod, ev_type)                                                             \
     const Z_DECL_ALIGN(struct zmk_event_subscription)                                              \
         _CONCAT(_CONCAT(zmk_event_sub_, mod), ev_type) __used                                      \
-        __attribute__((__section__(".event_subscription"))) = {                                    \
+        __attribute__((__section__(ZMK_EVENT_SUBSCRIPTION_SECTION(ev_type, "1")))) = {             \
             .event_type = &zmk_event_##ev_type,                                                    \
             .listener = &zmk_listener_##mod,                                                       \
     };
@@ -80,7 +112,18 @@ struct zmk_event_subscription {
 
 #define ZMK_EVENT_RELEASE(ev) zmk_event_manager_release(&(ev).header)
 
+#define ZMK_LISTENER_SET_ENABLED(mod, enabled)                                                     \
+    zmk_event_manager_set_listener_enabled(&zmk_listener_##mod, enabled)
+
 int zmk_event_manager_raise(zmk_event_t *event);
 int zmk_event_manager_raise_after(zmk_event_t *event, const struct zmk_listener *listener);
 int zmk_event_manager_raise_at(zmk_event_t *event, const struct zmk_listener *listener);
-int zmk_event_manager_release(zmk_event_t *event);
\ No newline at end of file
+int zmk_event_manager_release(zmk_event_t *event);
+
+/**
+ * Enable or disable a listener defined with ZMK_LISTENER_DYNAMIC. Must be called from the same
+ * thread that raises the events the listener subscribes to.
+ *
+ * @retval -ENOTSUP if the listener was not defined with ZMK_LISTENER_DYNAMIC.
+ */
+int zmk_event_manager_set_listener_enabled(const struct zmk_listener *listener, bool enabled);
@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/kernel.h>
+#include <zmk/event_manager.h>
+
+/**
+ * Raised when an input frame begins and ends. All position and sensor events from one scan or
+ * split update are raised between the two, so listeners can defer work until the frame ends.
+ */
+struct zmk_input_frame_state_changed {
+    bool active;
+    int64_t timestamp;
+};
+
+ZMK_EVENT_DECLARE(zmk_input_frame_state_changed);
@@ -8,16 +8,29 @@
 
 #include <zephyr/kernel.h>
 #include <zmk/event_manager.h>
+#include <zmk/keymap.h>
 
+/*
+ * Raised once per layer state transition, which may change several layers at once. For those,
+ * layer and state describe the highest layer that changed.
+ */
 struct zmk_layer_state_changed {
     uint8_t layer;
     bool state;
+    zmk_keymap_layers_state_t old_state;
+    zmk_keymap_layers_state_t new_state;
     int64_t timestamp;
 };
 
 ZMK_EVENT_DECLARE(zmk_layer_state_changed);
 
-static inline int raise_layer_state_changed(uint8_t layer, bool state) {
-    return raise_zmk_layer_state_changed((struct zmk_layer_state_changed){
-        .layer = layer, .state = state, .timestamp = k_uptime_get()});
+static inline int raise_layer_state_changed(uint8_t layer, bool state,
+                                            zmk_keymap_layers_state_t old_state,
+                                            zmk_keymap_layers_state_t new_state) {
+    return raise_zmk_layer_state_changed(
+        (struct zmk_layer_state_changed){.layer = layer,
+                                         .state = state,
+                                         .old_state = old_state,
+                                         .new_state = new_state,
+                                         .timestamp = k_uptime_get()});
 }
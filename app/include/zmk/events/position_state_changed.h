@@ -11,11 +11,13 @@
 
 #define ZMK_POSITION_STATE_CHANGE_SOURCE_LOCAL UINT8_MAX
 
+// Fields are ordered by decreasing alignment so the event packs into 16 bytes. It is copied into
+// the split and hold-tap/combo capture buffers, so keep it that way when adding fields.
 struct zmk_position_state_changed {
-    uint8_t source;
+    int64_t timestamp;
     uint32_t position;
+    uint8_t source;
     bool state;
-    int64_t timestamp;
 };
 
 ZMK_EVENT_DECLARE(zmk_position_state_changed);
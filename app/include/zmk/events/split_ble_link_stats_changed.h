@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/kernel.h>
+#include <zmk/event_manager.h>
+
+struct zmk_split_ble_link_stats {
+    // Position notifications received per second over the last reporting interval.
+    uint16_t notify_rate;
+    // Averaged received signal strength in dBm, or 0 if it could not be read.
+    int8_t rssi;
+    // Negotiated connection interval in 1.25 ms units.
+    uint16_t interval;
+    // Negotiated peripheral latency in connection events.
+    uint16_t latency;
+    // Negotiated supervision timeout in 10 ms units.
+    uint16_t timeout;
+    // Average and maximum time from a key change on the peripheral to its arrival at the central
+    // over the last reporting interval, in milliseconds. Only reported by peripherals which send
+    // position events.
+    uint16_t key_latency_avg_ms;
+    uint16_t key_latency_max_ms;
+};
+
+struct zmk_split_ble_link_stats_changed {
+    uint8_t slot;
+    struct zmk_split_ble_link_stats stats;
+};
+
+ZMK_EVENT_DECLARE(zmk_split_ble_link_stats_changed);
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/kernel.h>
+#include <zmk/event_manager.h>
+
+struct zmk_split_serial_link_stats {
+    // Frames received with a valid checksum.
+    uint32_t rx_frames;
+    // Frames received with an invalid checksum.
+    uint32_t rx_crc_errors;
+    // Bytes discarded while searching for the start of a frame.
+    uint32_t rx_discarded;
+    // Bytes lost because the RX ring buffer was full.
+    uint32_t rx_overflow;
+    // Frames dropped because the TX ring buffer was full.
+    uint32_t tx_overflow;
+    // Echo requests which were not answered before the next one was sent.
+    uint32_t echo_lost;
+    // Round trip time of the last answered echo request in microseconds, or 0 if none yet.
+    uint32_t rtt_us;
+};
+
+struct zmk_split_serial_link_health_changed {
+    uint8_t slot;
+    struct zmk_split_serial_link_stats stats;
+};
+
+ZMK_EVENT_DECLARE(zmk_split_serial_link_health_changed);
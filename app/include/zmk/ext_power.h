@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#if IS_ENABLED(CONFIG_ZMK_EXT_POWER_AUTO_OFF)
+
+/**
+ * Re-evaluates whether anything using external power is on. External power is resumed
+ * immediately if so, or else switched off once nothing has used it for
+ * CONFIG_ZMK_EXT_POWER_AUTO_OFF_DELAY_MS. Call this whenever an external power consumer turns on
+ * or off, before it starts driving any outputs.
+ */
+void zmk_ext_power_auto_off_update(void);
+
+#else
+
+static inline void zmk_ext_power_auto_off_update(void) {}
+
+#endif // IS_ENABLED(CONFIG_ZMK_EXT_POWER_AUTO_OFF)
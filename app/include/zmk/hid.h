@@ -51,11 +51,23 @@
 #define ZMK_HID_MAIN_VAL_BIT_FIELD (0x00 << 8)
 #define ZMK_HID_MAIN_VAL_BUFFERED_BYTES (0x01 << 8)
 
+#if IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP)
+#define ZMK_HID_CONSUMER_BITMAP_MIN_USAGE CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP_MIN_USAGE
+#define ZMK_HID_CONSUMER_BITMAP_MAX_USAGE CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP_MAX_USAGE
+#define ZMK_HID_CONSUMER_BITMAP_USAGES                                                             \
+    (ZMK_HID_CONSUMER_BITMAP_MAX_USAGE - ZMK_HID_CONSUMER_BITMAP_MIN_USAGE + 1)
+#define ZMK_HID_CONSUMER_BITMAP_PADDING                                                            \
+    (DIV_ROUND_UP(ZMK_HID_CONSUMER_BITMAP_USAGES, 8) * 8 - ZMK_HID_CONSUMER_BITMAP_USAGES)
+#endif // IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP)
+
 #define ZMK_HID_REPORT_ID_KEYBOARD 0x01
 #define ZMK_HID_REPORT_ID_LEDS 0x01
 #define ZMK_HID_REPORT_ID_CONSUMER 0x02
 
-static const uint8_t zmk_hid_report_desc[] = {
+// The keyboard and consumer collections are kept apart so they can be exposed through separate
+// USB HID interfaces. Transports using a single report descriptor get both through
+// zmk_hid_get_report_desc().
+static const uint8_t zmk_hid_keyboard_report_desc[] = {
     HID_USAGE_PAGE(HID_USAGE_GEN_DESKTOP),
     HID_USAGE(HID_USAGE_GD_KEYBOARD),
     HID_COLLECTION(HID_COLLECTION_APPLICATION),
@@ -114,6 +126,9 @@ static const uint8_t zmk_hid_report_desc[] = {
 #endif
 
     HID_END_COLLECTION,
+};
+
+static const uint8_t zmk_hid_consumer_report_desc[] = {
     HID_USAGE_PAGE(HID_USAGE_CONSUMER),
     HID_USAGE(HID_USAGE_CONSUMER_CONSUMER_CONTROL),
     HID_COLLECTION(HID_COLLECTION_APPLICATION),
@@ -137,10 +152,31 @@ static const uint8_t zmk_hid_report_desc[] = {
 #endif
     HID_REPORT_COUNT(CONFIG_ZMK_HID_CONSUMER_REPORT_SIZE),
     HID_INPUT(ZMK_HID_MAIN_VAL_DATA | ZMK_HID_MAIN_VAL_ARRAY | ZMK_HID_MAIN_VAL_ABS),
-    HID_END_COLLECTION,
 
+#if IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP)
+    // Placed after the usage array so the array keeps its offset in the report.
+    HID_LOGICAL_MIN8(0x00),
+    HID_LOGICAL_MAX8(0x01),
+    HID_USAGE_MIN16((ZMK_HID_CONSUMER_BITMAP_MIN_USAGE & 0xFF),
+                    (ZMK_HID_CONSUMER_BITMAP_MIN_USAGE >> 8)),
+    HID_USAGE_MAX16((ZMK_HID_CONSUMER_BITMAP_MAX_USAGE & 0xFF),
+                    (ZMK_HID_CONSUMER_BITMAP_MAX_USAGE >> 8)),
+    HID_REPORT_SIZE(0x01),
+    HID_REPORT_COUNT(ZMK_HID_CONSUMER_BITMAP_USAGES),
+    HID_INPUT(ZMK_HID_MAIN_VAL_DATA | ZMK_HID_MAIN_VAL_VAR | ZMK_HID_MAIN_VAL_ABS),
+#if ZMK_HID_CONSUMER_BITMAP_PADDING > 0
+    HID_REPORT_SIZE(0x01),
+    HID_REPORT_COUNT(ZMK_HID_CONSUMER_BITMAP_PADDING),
+    HID_INPUT(ZMK_HID_MAIN_VAL_CONST),
+#endif
+#endif // IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP)
+
+    HID_END_COLLECTION,
 };
 
+#define ZMK_HID_REPORT_DESC_LEN                                                                    \
+    (sizeof(zmk_hid_keyboard_report_desc) + sizeof(zmk_hid_consumer_report_desc))
+
 #if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
 
 #define HID_ERROR_ROLLOVER 0x1
@@ -194,6 +230,9 @@ struct zmk_hid_consumer_report_body {
 #elif IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_USAGES_FULL)
     uint16_t keys[CONFIG_ZMK_HID_CONSUMER_REPORT_SIZE];
 #endif
+#if IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP)
+    uint8_t bitmap[DIV_ROUND_UP(ZMK_HID_CONSUMER_BITMAP_USAGES, 8)];
+#endif
 } __packed;
 
 struct zmk_hid_consumer_report {
@@ -230,6 +269,23 @@ bool zmk_hid_is_pressed(uint32_t usage);
 struct zmk_hid_keyboard_report *zmk_hid_get_keyboard_report(void);
 struct zmk_hid_consumer_report *zmk_hid_get_consumer_report(void);
 
+/**
+ * Get the report descriptor with all collections, which is ZMK_HID_REPORT_DESC_LEN bytes long.
+ */
+const uint8_t *zmk_hid_get_report_desc(void);
+
+#if CONFIG_ZMK_HID_KEYBOARD_REPORT_SNAPSHOTS > 0
+/**
+ * Capture the current keyboard report into a snapshot that stays unchanged until released.
+ * Consecutive captures of an unchanged report share the same snapshot.
+ *
+ * @return The snapshot index, or -ENOMEM if every snapshot is still in use.
+ */
+int zmk_hid_keyboard_report_snapshot_take(void);
+const struct zmk_hid_keyboard_report *zmk_hid_keyboard_report_snapshot_get(uint8_t index);
+void zmk_hid_keyboard_report_snapshot_release(uint8_t index);
+#endif // CONFIG_ZMK_HID_KEYBOARD_REPORT_SNAPSHOTS > 0
+
 #if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
 zmk_hid_boot_report_t *zmk_hid_get_boot_report();
 #endif
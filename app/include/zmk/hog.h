@@ -9,5 +9,22 @@
 #include <zmk/keys.h>
 #include <zmk/hid.h>
 
+/**
+ * Sets the BLE profile that reports sent from now on are delivered to. Reports already queued
+ * still go to the profile they were queued for.
+ */
+void zmk_hog_set_target_profile(uint8_t index);
+
+/**
+ * Returns a hash of the HID report maps served over GATT, which changes whenever a report map does.
+ */
+uint32_t zmk_hog_report_map_hash(void);
+
+/**
+ * Returns true when no keyboard or consumer report is queued or waiting to be sent by the
+ * controller.
+ */
+bool zmk_hog_is_idle(void);
+
 int zmk_hog_send_keyboard_report(struct zmk_hid_keyboard_report_body *body);
 int zmk_hog_send_consumer_report(struct zmk_hid_consumer_report_body *body);
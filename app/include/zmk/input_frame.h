@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+/**
+ * Begin an input frame, which groups all the position and sensor events raised from a single
+ * scan, split update or burst of queued behaviors.
+ *
+ * Frames may be nested; only the outermost begin/end pair raises a
+ * zmk_input_frame_state_changed event. Frames must begin and end on the input work queue.
+ */
+void zmk_input_frame_begin(void);
+
+/**
+ * End the current input frame.
+ */
+void zmk_input_frame_end(void);
+
+/**
+ * Check whether events are currently being raised as part of an input frame.
+ */
+bool zmk_input_frame_is_active(void);
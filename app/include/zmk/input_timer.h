@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/sys/dlist.h>
+
+struct zmk_input_timer;
+
+typedef void (*zmk_input_timer_handler_t)(struct zmk_input_timer *timer);
+
+/**
+ * A deadline registered by a behavior (hold-tap, combo, tap-dance, sticky key, ...) that needs to
+ * make a decision once some time has passed without further input.
+ *
+ * All pending timers share a single kernel timeout, which is armed for the earliest deadline.
+ * When it fires, every timer that has expired by then is run in one batch on the input work queue.
+ *
+ * Embed this in the behavior's own state and use CONTAINER_OF in the handler to get back to it.
+ */
+struct zmk_input_timer {
+    sys_dnode_t node;
+    int64_t deadline;
+    zmk_input_timer_handler_t handler;
+};
+
+/**
+ * Initialize a timer. Must be called once before the timer is started.
+ */
+void zmk_input_timer_init(struct zmk_input_timer *timer, zmk_input_timer_handler_t handler);
+
+/**
+ * Start a timer that expires at the given uptime, in milliseconds. A deadline in the past
+ * expires as soon as possible. Restarting a pending timer moves it to the new deadline.
+ *
+ * Timers may only be started and stopped from the input work queue, so a stopped timer is
+ * guaranteed not to call its handler afterwards.
+ */
+void zmk_input_timer_start(struct zmk_input_timer *timer, int64_t deadline);
+
+/**
+ * Stop a timer. Does nothing if the timer is not pending.
+ */
+void zmk_input_timer_stop(struct zmk_input_timer *timer);
+
+/**
+ * Check whether a timer has been started and has not yet expired or been stopped.
+ */
+bool zmk_input_timer_is_pending(const struct zmk_input_timer *timer);
@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Queues a press or release of a key position, which is raised on the input work queue as though
+ * it came from the kscan. On a split peripheral, it is sent to the central like any other key.
+ *
+ * @retval 0 If the event was queued.
+ * @retval -EINVAL If the position is not in the keymap.
+ * @retval -ENOMEM If the queue is full.
+ */
+int zmk_key_inject(uint32_t position, bool pressed);
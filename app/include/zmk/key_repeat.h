@@ -0,0 +1,15 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zmk/events/keycode_state_changed.h>
+
+/**
+ * Record a keycode press in the key repeat history. Called by the HID listener for every press
+ * it sends, so key repeat doesn't need a keycode listener of its own.
+ */
+void zmk_key_repeat_record_press(const struct zmk_keycode_state_changed *ev);
@@ -6,13 +6,44 @@
 
 #pragma once
 
+#include <zmk/behavior.h>
 #include <zmk/events/position_state_changed.h>
 
 #define ZMK_LAYER_CHILD_LEN_PLUS_ONE(node) 1 +
 #define ZMK_KEYMAP_LAYERS_LEN                                                                      \
     (DT_FOREACH_CHILD(DT_INST(0, zmk_keymap), ZMK_LAYER_CHILD_LEN_PLUS_ONE) 0)
 
+#if IS_ENABLED(CONFIG_ZMK_KEYMAP_LAYER_STATE_64)
+typedef uint64_t zmk_keymap_layers_state_t;
+#define ZMK_KEYMAP_LAYER_STATE_BITS 64
+#define ZMK_KEYMAP_LAYER_BIT(layer) BIT64(layer)
+#else
 typedef uint32_t zmk_keymap_layers_state_t;
+#define ZMK_KEYMAP_LAYER_STATE_BITS 32
+#define ZMK_KEYMAP_LAYER_BIT(layer) ((uint32_t)BIT(layer))
+#endif
+
+/**
+ * Returns the highest layer set in @p state, which must not be empty.
+ */
+static inline uint8_t zmk_keymap_layer_state_highest(zmk_keymap_layers_state_t state) {
+#if IS_ENABLED(CONFIG_ZMK_KEYMAP_LAYER_STATE_64)
+    return 63 - __builtin_clzll(state);
+#else
+    return 31 - __builtin_clz(state);
+#endif
+}
+
+/**
+ * Returns the lowest layer set in @p state, which must not be empty.
+ */
+static inline uint8_t zmk_keymap_layer_state_lowest(zmk_keymap_layers_state_t state) {
+#if IS_ENABLED(CONFIG_ZMK_KEYMAP_LAYER_STATE_64)
+    return __builtin_ctzll(state);
+#else
+    return __builtin_ctz(state);
+#endif
+}
 
 uint8_t zmk_keymap_layer_default(void);
 zmk_keymap_layers_state_t zmk_keymap_layer_state(void);
@@ -22,11 +53,58 @@ int zmk_keymap_layer_activate(uint8_t layer);
 int zmk_keymap_layer_deactivate(uint8_t layer);
 int zmk_keymap_layer_toggle(uint8_t layer);
 int zmk_keymap_layer_to(uint8_t layer);
+
+/**
+ * Activates exactly the layers in @p state, plus the default layer, as one transition that raises
+ * a single layer_state_changed event.
+ */
+int zmk_keymap_layer_state_set(zmk_keymap_layers_state_t state);
 const char *zmk_keymap_layer_name(uint8_t layer);
 
 int zmk_keymap_position_state_changed(uint8_t source, uint32_t position, bool pressed,
                                       int64_t timestamp);
 
+#if IS_ENABLED(CONFIG_ZMK_KEYMAP_RUNTIME)
+
+/**
+ * Gets the binding at @p position on @p layer. If @p modified isn't NULL, it is set to whether the
+ * binding differs from the devicetree keymap.
+ */
+int zmk_keymap_get_binding(uint8_t layer, uint32_t position, struct zmk_behavior_binding *binding,
+                           bool *modified);
+
+/**
+ * Replaces the binding at @p position on @p layer and saves it to settings. A key that is held
+ * while its binding changes is released through the new binding.
+ */
+int zmk_keymap_set_binding(uint8_t layer, uint32_t position,
+                           const struct zmk_behavior_binding *binding);
+
+struct zmk_keymap_binding_change {
+    uint8_t layer;
+    uint32_t position;
+    struct zmk_behavior_binding binding;
+};
+
+/**
+ * Replaces several bindings at once. Every change is checked before any is applied, so either all
+ * of them take effect together or none do. The changed bindings are then written to settings in a
+ * single batch, as long as CONFIG_ZMK_SETTINGS_SAVE_QUEUE_SIZE can hold them all.
+ */
+int zmk_keymap_set_bindings(const struct zmk_keymap_binding_change *changes, size_t len);
+
+/**
+ * Restores the devicetree binding at @p position on @p layer.
+ */
+int zmk_keymap_reset_binding(uint8_t layer, uint32_t position);
+
+/**
+ * Restores the devicetree bindings of the whole keymap.
+ */
+int zmk_keymap_reset_bindings(void);
+
+#endif // IS_ENABLED(CONFIG_ZMK_KEYMAP_RUNTIME)
+
 #define ZMK_KEYMAP_EXTRACT_BINDING(idx, drv_inst)                                                  \
     {                                                                                              \
         .behavior_dev = DEVICE_DT_NAME(DT_PHANDLE_BY_IDX(drv_inst, bindings, idx)),                \
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/devicetree.h>
+#include <zephyr/sys/util_macro.h>
+
+/**
+ * Whether the chosen kscan device is a sideband behaviors device, whose bindings are then invoked
+ * by zmk_kscan_sideband_process() while processing the changes it reports.
+ */
+#define ZMK_KSCAN_SIDEBAND_BEHAVIORS_CHOSEN                                                        \
+    (IS_ENABLED(CONFIG_ZMK_KSCAN_SIDEBAND_BEHAVIORS) &&                                            \
+     DT_NODE_HAS_COMPAT(DT_CHOSEN(zmk_kscan), zmk_kscan_sideband_behaviors))
+
+/**
+ * Invoke the sideband binding, if there is one, for a key state change reported by the chosen
+ * kscan device. This runs in the same input frame as the keymap processing of the change, so
+ * sideband keys don't need any work of their own.
+ */
+void zmk_kscan_sideband_process(uint32_t row, uint32_t column, bool pressed, int64_t timestamp);
@@ -6,4 +6,14 @@
 
 #pragma once
 
-int32_t zmk_matrix_transform_row_column_to_position(uint32_t row, uint32_t column);
\ No newline at end of file
+int32_t zmk_matrix_transform_row_column_to_position(uint32_t row, uint32_t column);
+
+/**
+ * Gets the row and column of the matrix transform that key @p position is mapped to. These are
+ * the transform's own coordinates, so any row or column offset isn't applied.
+ *
+ * @retval 0 on success.
+ * @retval -EINVAL if @p position isn't a key position of the keymap.
+ */
+int zmk_matrix_transform_position_to_row_column(uint32_t position, uint32_t *row,
+                                                uint32_t *column);
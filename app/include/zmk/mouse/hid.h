@@ -20,11 +20,24 @@
 #define ZMK_MOUSE_HID_NUM_BUTTONS 0x05
 
 #define ZMK_MOUSE_HID_REPORT_ID_MOUSE 0x01
+#define ZMK_MOUSE_HID_REPORT_ID_ABS_POINTER 0x02
+
+// Absolute positions range from 0 to this on both axes, regardless of the input device.
+#define ZMK_MOUSE_HID_ABS_MAX 0x7FFF
+
+// Scrolling is accumulated in the units of Linux's high resolution wheel events, 1/120 of a detent.
+#define ZMK_MOUSE_HID_SCROLL_PER_DETENT 120
 
 // Needed until Zephyr offers a 2 byte usage macro
 #define HID_USAGE16(idx)                                                                           \
     HID_ITEM(HID_ITEM_TAG_USAGE, HID_ITEM_TYPE_LOCAL, 2), (idx & 0xFF), (idx >> 8 & 0xFF)
 
+// Needed until Zephyr offers logical collections, physical ranges and feature items
+#define ZMK_HID_COLLECTION_LOGICAL 0x02
+#define ZMK_HID_PHYSICAL_MIN8(a) HID_ITEM(0x3, HID_ITEM_TYPE_GLOBAL, 1), a
+#define ZMK_HID_PHYSICAL_MAX8(a) HID_ITEM(0x4, HID_ITEM_TYPE_GLOBAL, 1), a
+#define ZMK_HID_FEATURE(a) HID_ITEM(0xB, HID_ITEM_TYPE_MAIN, 1), a
+
 static const uint8_t zmk_mouse_hid_report_desc[] = {
     HID_USAGE_PAGE(HID_USAGE_GD),
     HID_USAGE(HID_USAGE_GD_MOUSE),
@@ -48,6 +61,37 @@ static const uint8_t zmk_mouse_hid_report_desc[] = {
     HID_USAGE_PAGE(HID_USAGE_GEN_DESKTOP),
     HID_USAGE(HID_USAGE_GD_X),
     HID_USAGE(HID_USAGE_GD_Y),
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+    HID_LOGICAL_MIN16(0xFF, -0x7F),
+    HID_LOGICAL_MAX16(0xFF, 0x7F),
+    HID_REPORT_SIZE(0x10),
+    HID_REPORT_COUNT(0x02),
+    HID_INPUT(ZMK_HID_MAIN_VAL_DATA | ZMK_HID_MAIN_VAL_VAR | ZMK_HID_MAIN_VAL_REL),
+    // The resolution multiplier applies to the wheel and pan in the same logical collection.
+    HID_COLLECTION(ZMK_HID_COLLECTION_LOGICAL),
+    HID_USAGE(HID_USAGE_GD_RESOLUTION_MULTIPLIER),
+    HID_LOGICAL_MIN8(0x00),
+    HID_LOGICAL_MAX8(0x01),
+    ZMK_HID_PHYSICAL_MIN8(0x01),
+    ZMK_HID_PHYSICAL_MAX8(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING_MULTIPLIER),
+    HID_REPORT_SIZE(0x02),
+    HID_REPORT_COUNT(0x01),
+    ZMK_HID_FEATURE(ZMK_HID_MAIN_VAL_DATA | ZMK_HID_MAIN_VAL_VAR | ZMK_HID_MAIN_VAL_ABS),
+    // Constant padding for the last 6 bits.
+    HID_REPORT_SIZE(0x06),
+    ZMK_HID_FEATURE(ZMK_HID_MAIN_VAL_CONST | ZMK_HID_MAIN_VAL_VAR | ZMK_HID_MAIN_VAL_ABS),
+    ZMK_HID_PHYSICAL_MIN8(0x00),
+    ZMK_HID_PHYSICAL_MAX8(0x00),
+    HID_USAGE(HID_USAGE_GD_WHEEL),
+    HID_LOGICAL_MIN16(0xFF, -0x7F),
+    HID_LOGICAL_MAX16(0xFF, 0x7F),
+    HID_REPORT_SIZE(0x10),
+    HID_INPUT(ZMK_HID_MAIN_VAL_DATA | ZMK_HID_MAIN_VAL_VAR | ZMK_HID_MAIN_VAL_REL),
+    HID_USAGE_PAGE(HID_USAGE_CONSUMER),
+    HID_USAGE16(HID_USAGE_CONSUMER_AC_PAN),
+    HID_INPUT(ZMK_HID_MAIN_VAL_DATA | ZMK_HID_MAIN_VAL_VAR | ZMK_HID_MAIN_VAL_REL),
+    HID_END_COLLECTION,
+#else
     HID_USAGE(HID_USAGE_GD_WHEEL),
     HID_LOGICAL_MIN16(0xFF, -0x7F),
     HID_LOGICAL_MAX16(0xFF, 0x7F),
@@ -58,8 +102,39 @@ static const uint8_t zmk_mouse_hid_report_desc[] = {
     HID_USAGE16(HID_USAGE_CONSUMER_AC_PAN),
     HID_REPORT_COUNT(0x01),
     HID_INPUT(ZMK_HID_MAIN_VAL_DATA | ZMK_HID_MAIN_VAL_VAR | ZMK_HID_MAIN_VAL_REL),
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
     HID_END_COLLECTION,
     HID_END_COLLECTION,
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+    HID_USAGE_PAGE(HID_USAGE_GD),
+    HID_USAGE(HID_USAGE_GD_MOUSE),
+    HID_COLLECTION(HID_COLLECTION_APPLICATION),
+    HID_REPORT_ID(ZMK_MOUSE_HID_REPORT_ID_ABS_POINTER),
+    HID_USAGE(HID_USAGE_GD_POINTER),
+    HID_COLLECTION(HID_COLLECTION_PHYSICAL),
+    HID_USAGE_PAGE(HID_USAGE_BUTTON),
+    HID_USAGE_MIN8(0x1),
+    HID_USAGE_MAX8(ZMK_MOUSE_HID_NUM_BUTTONS),
+    HID_LOGICAL_MIN8(0x00),
+    HID_LOGICAL_MAX8(0x01),
+    HID_REPORT_SIZE(0x01),
+    HID_REPORT_COUNT(0x5),
+    HID_INPUT(ZMK_HID_MAIN_VAL_DATA | ZMK_HID_MAIN_VAL_VAR | ZMK_HID_MAIN_VAL_ABS),
+    // Constant padding for the last 3 bits.
+    HID_REPORT_SIZE(0x03),
+    HID_REPORT_COUNT(0x01),
+    HID_INPUT(ZMK_HID_MAIN_VAL_CONST | ZMK_HID_MAIN_VAL_VAR | ZMK_HID_MAIN_VAL_ABS),
+    HID_USAGE_PAGE(HID_USAGE_GEN_DESKTOP),
+    HID_USAGE(HID_USAGE_GD_X),
+    HID_USAGE(HID_USAGE_GD_Y),
+    HID_LOGICAL_MIN8(0x00),
+    HID_LOGICAL_MAX16(ZMK_MOUSE_HID_ABS_MAX & 0xFF, ZMK_MOUSE_HID_ABS_MAX >> 8),
+    HID_REPORT_SIZE(0x10),
+    HID_REPORT_COUNT(0x02),
+    HID_INPUT(ZMK_HID_MAIN_VAL_DATA | ZMK_HID_MAIN_VAL_VAR | ZMK_HID_MAIN_VAL_ABS),
+    HID_END_COLLECTION,
+    HID_END_COLLECTION,
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
 };
 
 struct zmk_hid_mouse_report_body {
@@ -75,14 +150,47 @@ struct zmk_hid_mouse_report {
     struct zmk_hid_mouse_report_body body;
 } __packed;
 
+struct zmk_hid_mouse_abs_report_body {
+    zmk_mouse_button_flags_t buttons;
+    uint16_t x;
+    uint16_t y;
+} __packed;
+
+struct zmk_hid_mouse_abs_report {
+    uint8_t report_id;
+    struct zmk_hid_mouse_abs_report_body body;
+} __packed;
+
+struct zmk_hid_mouse_resolution_feature_report_body {
+    // 1 when the host wants scrolling in 1 / CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING_MULTIPLIER detents.
+    uint8_t wheel_resolution;
+} __packed;
+
+struct zmk_hid_mouse_resolution_feature_report {
+    uint8_t report_id;
+    struct zmk_hid_mouse_resolution_feature_report_body body;
+} __packed;
+
 int zmk_hid_mouse_button_press(zmk_mouse_button_t button);
 int zmk_hid_mouse_button_release(zmk_mouse_button_t button);
 int zmk_hid_mouse_buttons_press(zmk_mouse_button_flags_t buttons);
 int zmk_hid_mouse_buttons_release(zmk_mouse_button_flags_t buttons);
 void zmk_hid_mouse_movement_set(int16_t x, int16_t y);
-void zmk_hid_mouse_scroll_set(int8_t x, int8_t y);
+void zmk_hid_mouse_scroll_set(int16_t x, int16_t y);
 void zmk_hid_mouse_movement_update(int16_t x, int16_t y);
-void zmk_hid_mouse_scroll_update(int8_t x, int8_t y);
+void zmk_hid_mouse_scroll_update(int16_t x, int16_t y);
 void zmk_hid_mouse_clear(void);
 
 struct zmk_hid_mouse_report *zmk_mouse_hid_get_mouse_report();
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+void zmk_hid_mouse_abs_position_set(uint16_t x, uint16_t y);
+
+/**
+ * Returns true, once, after buttons changed since the absolute pointer report was last taken, so
+ * the absolute pointer can be kept in sync with buttons sent through the relative one.
+ */
+bool zmk_hid_mouse_abs_buttons_changed(void);
+
+struct zmk_hid_mouse_abs_report *zmk_mouse_hid_get_mouse_abs_report(void);
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
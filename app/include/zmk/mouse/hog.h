@@ -10,4 +10,16 @@
 
 #if IS_ENABLED(CONFIG_ZMK_MOUSE)
 int zmk_mouse_hog_send_mouse_report(struct zmk_hid_mouse_report_body *body);
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+int zmk_mouse_hog_send_mouse_abs_report(struct zmk_hid_mouse_abs_report_body *body);
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+/**
+ * Returns true if the host of the active profile enabled the resolution multiplier of the scroll
+ * wheel.
+ */
+bool zmk_mouse_hog_scroll_high_res(void);
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
 #endif // IS_ENABLED(CONFIG_ZMK_MOUSE)
@@ -6,8 +6,20 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #if IS_ENABLED(CONFIG_ZMK_MOUSE)
 int zmk_mouse_usb_hid_send_mouse_report(void);
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+int zmk_mouse_usb_hid_send_mouse_abs_report(void);
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+/**
+ * Returns true if the USB host enabled the resolution multiplier of the scroll wheel.
+ */
+bool zmk_mouse_usb_hid_scroll_high_res(void);
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
 #endif // IS_ENABLED(CONFIG_ZMK_MOUSE)
@@ -6,7 +6,44 @@
 
 #pragma once
 
+#include <stdbool.h>
+
+#include <zephyr/sys/iterable_sections.h>
+
+struct zmk_pm_flush_entry {
+    const char *name;
+    bool (*flush)(void);
+};
+
+/**
+ * Registers work that has to finish before sleep or soft off, such as reports still queued for a
+ * host or split events waiting to be batched.
+ *
+ * @param _name The name of the entry, also shown when it doesn't finish in time.
+ * @param _flush A `bool (*)(void)` that pushes the work along without blocking and returns true
+ *               once nothing is left pending. It is called until then, or until the deadline set by
+ *               CONFIG_ZMK_PM_FLUSH_TIMEOUT_MS passes.
+ */
+#define ZMK_PM_FLUSH_DEFINE(_name, _flush)                                                         \
+    static const STRUCT_SECTION_ITERABLE(zmk_pm_flush_entry, _CONCAT(zmk_pm_flush_, _name)) = {    \
+        .name = STRINGIFY(_name),                                                                  \
+        .flush = _flush,                                                                           \
+    }
+
+/**
+ * Waits for the work registered with ZMK_PM_FLUSH_DEFINE() to finish, then writes any settings
+ * whose debounced save is still pending, so nothing is lost when the devices are suspended next.
+ */
+void zmk_pm_flush_pending(void);
+
 int zmk_pm_suspend_devices(void);
 void zmk_pm_resume_devices(void);
 
+/**
+ * Resume the devices suspended by zmk_pm_suspend_devices() that are needed to handle input, leaving
+ * output only devices such as displays, lighting, and the battery sensor suspended until the next
+ * call to zmk_pm_resume_devices().
+ */
+void zmk_pm_resume_critical_devices(void);
+
 int zmk_pm_soft_off(void);
\ No newline at end of file
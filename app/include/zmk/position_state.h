@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Record the physical state of a key position, from the paths that raise
+ * zmk_position_state_changed events for the matrix, split peripherals and injected keys. Called
+ * just before raising the event, so listeners already see the new state.
+ *
+ * Repeated presses or releases of a position, such as from a split resync, are ignored.
+ */
+void zmk_position_state_update(uint32_t position, bool pressed);
+
+/**
+ * Check whether a key position is held down, whatever behaviors such as combos or hold-taps are
+ * doing with its events.
+ */
+bool zmk_position_state_is_pressed(uint32_t position);
+
+/**
+ * Get the number of key positions held down.
+ */
+uint32_t zmk_position_state_pressed_count(void);
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#if IS_ENABLED(CONFIG_ZMK_PROFILING)
+#include <zephyr/arch/arm/cortex_m/dwt.h>
+#endif
+
+/**
+ * Points on the path of a key event, in the order it reaches them. Each is timed from the kscan
+ * callback that reported the key event.
+ */
+enum zmk_profiling_stage {
+    ZMK_PROFILING_KSCAN_CALLBACK,
+    ZMK_PROFILING_KSCAN_DEQUEUE,
+    ZMK_PROFILING_KEYMAP_DISPATCH,
+    ZMK_PROFILING_BEHAVIOR_PRESS,
+    ZMK_PROFILING_HID_LISTENER,
+    ZMK_PROFILING_ENDPOINT_SEND,
+    ZMK_PROFILING_TRANSPORT_DONE,
+    ZMK_PROFILING_STAGE_COUNT,
+};
+
+#if IS_ENABLED(CONFIG_ZMK_PROFILING)
+
+/**
+ * Gets the current value of the DWT cycle counter.
+ */
+static inline uint32_t zmk_profiling_now(void) { return (uint32_t)z_arm_dwt_get_cycles(); }
+
+/**
+ * Records the cycles taken to reach the stage since the given cycle count.
+ */
+void zmk_profiling_record(enum zmk_profiling_stage stage, uint32_t start);
+
+/**
+ * Starts timing the stages reached while processing a key event, which was reported by the kscan
+ * callback at the given cycle count.
+ */
+void zmk_profiling_begin(uint32_t origin);
+
+/**
+ * Stops timing stages until the next zmk_profiling_begin().
+ */
+void zmk_profiling_end(void);
+
+/**
+ * Records the stage for the key event being processed, if any. Reaching the endpoint send stage
+ * also starts waiting for the transport to complete the report.
+ */
+void zmk_profiling_mark(enum zmk_profiling_stage stage);
+
+/**
+ * Records the transport done stage for the last report sent, if it wasn't recorded yet.
+ */
+void zmk_profiling_transport_done(void);
+
+#else
+
+static inline uint32_t zmk_profiling_now(void) { return 0; }
+static inline void zmk_profiling_record(enum zmk_profiling_stage stage, uint32_t start) {}
+static inline void zmk_profiling_begin(uint32_t origin) {}
+static inline void zmk_profiling_end(void) {}
+static inline void zmk_profiling_mark(enum zmk_profiling_stage stage) {}
+static inline void zmk_profiling_transport_done(void) {}
+
+#endif // IS_ENABLED(CONFIG_ZMK_PROFILING)
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/usb/usb_device.h>
+
+#define ZMK_RAW_HID_PROTOCOL_VERSION 5
+
+#define ZMK_RAW_HID_REPORT_SIZE CONFIG_ZMK_RAW_HID_REPORT_SIZE
+
+/*
+ * Every report in either direction starts with the command byte. Replies and streamed reports
+ * follow it with a status byte, 0 on success or a positive errno value, and then the payload.
+ * Multi-byte values are little-endian.
+ */
+enum zmk_raw_hid_command {
+    // Reply: u8 protocol version, u8 report size.
+    ZMK_RAW_HID_CMD_VERSION = 0x01,
+    // Reply: u32 uptime ms, u32 position events, u32 keycode events, then for USB and BLE:
+    // u32 delivered reports, u16 average latency ms, u16 max latency ms.
+    ZMK_RAW_HID_CMD_GET_COUNTERS = 0x02,
+    // Request: u16 interval ms, 0 to stop. Replies once, then sends the GET_COUNTERS payload
+    // under this command at the requested interval.
+    ZMK_RAW_HID_CMD_STREAM_COUNTERS = 0x03,
+    // Request: null-terminated setting name, under one of ZMK's own subtrees. Reply: u8 value
+    // length, then the value, truncated to fit the report.
+    ZMK_RAW_HID_CMD_READ_SETTING = 0x04,
+    // Request: u8 operation, u8 layer. Reply: u32 layer state, or u64 with
+    // CONFIG_ZMK_KEYMAP_LAYER_STATE_64.
+    ZMK_RAW_HID_CMD_LAYER = 0x05,
+    // Request: u8 layer, u16 position. Reply: u16 behavior ID, u32 param1, u32 param2, u8 1 if
+    // the binding differs from the devicetree keymap, 0 otherwise.
+    ZMK_RAW_HID_CMD_GET_BINDING = 0x06,
+    // Request: u8 layer, u16 position, u16 behavior ID, u32 param1, u32 param2.
+    ZMK_RAW_HID_CMD_SET_BINDING = 0x07,
+    // Request: u8 layer, u16 position. Layer 0xff restores the whole keymap.
+    ZMK_RAW_HID_CMD_RESET_BINDING = 0x08,
+    // Reply: u32 window ms, u32 CPU active us, u16 estimated uA, then a u32 count per
+    // zmk_power_stats_event, all for the last complete window. Needs CONFIG_ZMK_POWER_STATS.
+    ZMK_RAW_HID_CMD_GET_POWER_STATS = 0x09,
+    // Starts a bulk transfer of binding changes, discarding any that were staged but not
+    // committed. Reply: u8 window, the number of data reports that can be sent before waiting for
+    // an ack, u16 most bindings a transfer can hold. Needs CONFIG_ZMK_KEYMAP_RUNTIME.
+    ZMK_RAW_HID_CMD_BULK_BEGIN = 0x0a,
+    // Request: u16 sequence number, counting from 0 for each transfer, u8 binding count, then for
+    // each binding: u8 layer, u16 position, u16 behavior ID, u32 param1, u32 param2. Only the last
+    // report of each window is acked, with a reply of the u16 next sequence number. A report that
+    // fails is always replied to, with the u16 sequence number to resend from.
+    ZMK_RAW_HID_CMD_BULK_DATA = 0x0b,
+    // Request: u16 total binding count. Applies every staged binding together and saves them in
+    // one batch, or none of them on error. Reply: u16 bindings applied.
+    ZMK_RAW_HID_CMD_BULK_COMMIT = 0x0c,
+    // Request: u16 position, u8 1 to press or 0 to release. Queues the key event as though it came
+    // from the kscan. Reply: u32 uptime ms when queued. Needs CONFIG_ZMK_KEY_INJECT.
+    ZMK_RAW_HID_CMD_INJECT_KEY = 0x0d,
+};
+
+#define ZMK_RAW_HID_ALL_LAYERS 0xff
+
+enum zmk_raw_hid_layer_op {
+    ZMK_RAW_HID_LAYER_TOGGLE,
+    ZMK_RAW_HID_LAYER_ACTIVATE,
+    ZMK_RAW_HID_LAYER_DEACTIVATE,
+    ZMK_RAW_HID_LAYER_TO,
+};
+
+/**
+ * Queues a report for the host. Shorter reports are padded with zeros.
+ */
+int zmk_raw_hid_send(const uint8_t *data, size_t len);
+
+/**
+ * Releases the IN endpoint after a bus reset, disconnect or reconfiguration, since the report in
+ * it will never be acknowledged. Called from the USB status callback.
+ */
+void zmk_raw_hid_usb_status_changed(enum usb_dc_status_code status);
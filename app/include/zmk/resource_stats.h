@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/iterable_sections.h>
+#include <zephyr/sys/util.h>
+
+/**
+ * Usage of a queue, updated by its owner whenever an item is queued or doesn't fit.
+ */
+struct zmk_queue_stats {
+    atomic_t high_water;
+    atomic_t overflows;
+};
+
+struct zmk_resource_stats_entry {
+    const char *name;
+    size_t size;
+    // Exactly one of these is set.
+    struct k_thread *thread;
+    struct zmk_queue_stats *queue;
+};
+
+#if IS_ENABLED(CONFIG_ZMK_RESOURCE_STATS)
+
+#define ZMK_RESOURCE_STATS_ENTRY(var, _name, _size, _thread, _queue)                               \
+    static const STRUCT_SECTION_ITERABLE(zmk_resource_stats_entry,                                 \
+                                         _CONCAT(zmk_resource_stats_, var)) = {                    \
+        .name = _name,                                                                             \
+        .size = _size,                                                                             \
+        .thread = _thread,                                                                         \
+        .queue = _queue,                                                                           \
+    }
+
+#else
+
+// Only declared, so uses of the macro still end in a declaration.
+#define ZMK_RESOURCE_STATS_ENTRY(var, _name, _size, _thread, _queue)                               \
+    extern const struct zmk_resource_stats_entry _CONCAT(zmk_resource_stats_, var)
+
+#endif // IS_ENABLED(CONFIG_ZMK_RESOURCE_STATS)
+
+/**
+ * Registers the stack of a work queue for the `zmk resources` shell command.
+ *
+ * @param work_q The work queue, which has to be started with the given stack.
+ * @param stack The stack defined with K_THREAD_STACK_DEFINE.
+ * @param _name The name shown for the stack.
+ */
+#define ZMK_STACK_STATS_DEFINE(work_q, stack, _name)                                               \
+    ZMK_RESOURCE_STATS_ENTRY(stack, _name, K_THREAD_STACK_SIZEOF(stack), &(work_q).thread, NULL)
+
+/**
+ * Defines a struct zmk_queue_stats and registers it for the `zmk resources` shell command.
+ *
+ * @param var The name of the statistics variable to define.
+ * @param _name The name shown for the queue.
+ * @param _size The number of items the queue can hold.
+ */
+#define ZMK_QUEUE_STATS_DEFINE(var, _name, _size)                                                  \
+    static struct zmk_queue_stats var;                                                             \
+    ZMK_RESOURCE_STATS_ENTRY(var, _name, _size, NULL, &var)
+
+#if IS_ENABLED(CONFIG_ZMK_RESOURCE_STATS)
+
+/**
+ * Records that an item was queued, leaving the queue with the given number of items.
+ */
+void zmk_queue_stats_queued(struct zmk_queue_stats *stats, uint32_t used);
+
+/**
+ * Records that an item didn't fit into the full queue, whether it was then dropped, replaced an
+ * older item or waited for space.
+ */
+void zmk_queue_stats_overflowed(struct zmk_queue_stats *stats);
+
+#else
+
+static inline void zmk_queue_stats_queued(struct zmk_queue_stats *stats, uint32_t used) {}
+static inline void zmk_queue_stats_overflowed(struct zmk_queue_stats *stats) {}
+
+#endif // IS_ENABLED(CONFIG_ZMK_RESOURCE_STATS)
@@ -12,6 +12,18 @@ struct zmk_led_hsb {
     uint8_t b;
 };
 
+/**
+ * The underglow state a split central mirrors to its peripherals, which render the effects
+ * themselves. The animation step keeps the halves of animated effects in phase.
+ */
+struct zmk_rgb_underglow_sync_state {
+    struct zmk_led_hsb color;
+    uint16_t animation_step;
+    uint8_t effect;
+    uint8_t speed;
+    uint8_t on;
+} __packed;
+
 int zmk_rgb_underglow_toggle(void);
 int zmk_rgb_underglow_get_state(bool *state);
 int zmk_rgb_underglow_on(void);
@@ -27,3 +39,11 @@ int zmk_rgb_underglow_change_sat(int direction);
 int zmk_rgb_underglow_change_brt(int direction);
 int zmk_rgb_underglow_change_spd(int direction);
 int zmk_rgb_underglow_set_hsb(struct zmk_led_hsb color);
+
+void zmk_rgb_underglow_get_sync_state(struct zmk_rgb_underglow_sync_state *sync);
+
+/**
+ * Switch to the underglow state of the split central, saving it unless only the animation step
+ * changed.
+ */
+int zmk_rgb_underglow_apply_sync_state(const struct zmk_rgb_underglow_sync_state *sync);
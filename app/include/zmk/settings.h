@@ -6,6 +6,12 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Largest value that can be queued with zmk_settings_save(). */
+#define ZMK_SETTINGS_SAVE_MAX_VALUE_LEN 32
+
 /**
  * Erases all saved settings.
  *
@@ -13,3 +19,93 @@
  * subsystem. This should typically be followed by a call to sys_reboot().
  */
 int zmk_settings_erase(void);
+
+#if IS_ENABLED(CONFIG_SETTINGS)
+
+#include <zephyr/settings/settings.h>
+
+/**
+ * Queues a setting to be written. The value is copied, and queueing the same name again before
+ * the write replaces the queued value. All queued settings are written together, at most
+ * CONFIG_ZMK_SETTINGS_SAVE_DEBOUNCE milliseconds after the first one was queued. If
+ * CONFIG_ZMK_SETTINGS_SAVE_RATE_LIMIT writes have already been made in the current rate window,
+ * they are written at the end of the window instead.
+ */
+int zmk_settings_save(const char *name, const void *value, size_t len);
+
+/**
+ * Writes all queued settings as soon as possible, for values that shouldn't wait for the debounce.
+ */
+void zmk_settings_save_flush(void);
+
+/**
+ * Writes all queued settings and waits for the write to finish, such as before powering off. Must
+ * not be called from the low priority work queue, which the write runs on.
+ */
+void zmk_settings_save_flush_sync(void);
+
+/**
+ * Queues a setting to be deleted, in order with any write to the same name that is still queued.
+ */
+static inline int zmk_settings_delete(const char *name) { return zmk_settings_save(name, "", 0); }
+
+#if IS_ENABLED(CONFIG_ZMK_SETTINGS_RESET_ON_START)
+
+/**
+ * Whether the settings saved before boot are still being deleted for
+ * CONFIG_ZMK_SETTINGS_RESET_ON_START. Until they are, loads find no settings.
+ */
+bool zmk_settings_reset_pending(void);
+
+#else
+
+static inline bool zmk_settings_reset_pending(void) { return false; }
+
+#endif // IS_ENABLED(CONFIG_ZMK_SETTINGS_RESET_ON_START)
+
+/**
+ * Loads the settings under a subtree straight from the store, for Bluetooth's own settings, which
+ * aren't cached.
+ */
+static inline int zmk_settings_load_subtree_uncached(const char *subtree) {
+    // Handlers are still committed, since some finish initializing from their commit callback.
+    return zmk_settings_reset_pending() ? settings_commit_subtree(subtree)
+                                        : settings_load_subtree(subtree);
+}
+
+#if CONFIG_ZMK_SETTINGS_LOAD_CACHE_SIZE > 0
+
+/**
+ * Loads the settings under a subtree into their registered handlers, like settings_load_subtree().
+ * The first call at boot reads the whole store into a RAM cache once, and later calls are served
+ * from it. After boot, or if the settings didn't fit the cache, this reads the store.
+ */
+int zmk_settings_load_subtree(const char *subtree);
+
+/**
+ * Loads the settings under a subtree into a callback, like settings_load_subtree_direct(), from the
+ * same cache as zmk_settings_load_subtree().
+ */
+int zmk_settings_load_subtree_direct(const char *subtree, settings_load_direct_cb cb, void *param);
+
+#else
+
+static inline int zmk_settings_load_subtree(const char *subtree) {
+    return zmk_settings_load_subtree_uncached(subtree);
+}
+
+static inline int zmk_settings_load_subtree_direct(const char *subtree,
+                                                   settings_load_direct_cb cb, void *param) {
+    return zmk_settings_reset_pending() ? 0 : settings_load_subtree_direct(subtree, cb, param);
+}
+
+#endif // CONFIG_ZMK_SETTINGS_LOAD_CACHE_SIZE > 0
+
+#else
+
+static inline int zmk_settings_save(const char *name, const void *value, size_t len) { return 0; }
+static inline void zmk_settings_save_flush(void) {}
+static inline void zmk_settings_save_flush_sync(void) {}
+static inline int zmk_settings_delete(const char *name) { return 0; }
+
+#endif // IS_ENABLED(CONFIG_SETTINGS)
@@ -11,12 +11,26 @@
 int zmk_split_invoke_behavior(uint8_t source, struct zmk_behavior_binding *binding,
                               struct zmk_behavior_binding_event event, bool state);
 
+/**
+ * Returns whether the central is scanning for split peripherals to connect to.
+ */
+bool zmk_split_bt_central_is_scanning(void);
+
 #if IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
 
 int zmk_split_bt_update_hid_indicator(zmk_hid_indicators_t indicators);
 
 #endif // IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+
+/**
+ * Send the current underglow state to the peripherals which haven't been sent it yet.
+ */
+int zmk_split_bt_sync_underglow(void);
+
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+
 #if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING)
 
 int zmk_split_get_peripheral_battery_level(uint8_t source, uint8_t *level);
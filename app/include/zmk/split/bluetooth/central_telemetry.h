@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/bluetooth/conn.h>
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_TELEMETRY)
+
+void zmk_split_bt_telemetry_connected(uint8_t slot, struct bt_conn *conn);
+void zmk_split_bt_telemetry_disconnected(uint8_t slot);
+void zmk_split_bt_telemetry_conn_params(uint8_t slot, uint16_t interval, uint16_t latency,
+                                        uint16_t timeout);
+void zmk_split_bt_telemetry_notification(uint8_t slot);
+void zmk_split_bt_telemetry_key_latency(uint8_t slot, uint16_t latency_ms);
+
+#else
+
+static inline void zmk_split_bt_telemetry_connected(uint8_t slot, struct bt_conn *conn) {}
+static inline void zmk_split_bt_telemetry_disconnected(uint8_t slot) {}
+static inline void zmk_split_bt_telemetry_conn_params(uint8_t slot, uint16_t interval,
+                                                      uint16_t latency, uint16_t timeout) {}
+static inline void zmk_split_bt_telemetry_notification(uint8_t slot) {}
+static inline void zmk_split_bt_telemetry_key_latency(uint8_t slot, uint16_t latency_ms) {}
+
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_TELEMETRY)
@@ -8,4 +8,14 @@
 
 bool zmk_split_bt_peripheral_is_connected(void);
 
-bool zmk_split_bt_peripheral_is_bonded(void);
\ No newline at end of file
+bool zmk_split_bt_peripheral_is_bonded(void);
+
+/**
+ * Get the interval of the connection to the central in microseconds, or 0 if not connected.
+ */
+uint32_t zmk_split_bt_peripheral_conn_interval_us(void);
+
+/**
+ * Get the ATT MTU of the connection to the central.
+ */
+uint16_t zmk_split_bt_peripheral_mtu(void);
\ No newline at end of file
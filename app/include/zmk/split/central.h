@@ -6,14 +6,41 @@
 
 #pragma once
 
+#include <zmk/behavior.h>
 #include <zmk/events/position_state_changed.h>
 #include <zmk/events/sensor_event.h>
 #include <zmk/split/service.h>
 
 void zmk_position_state_change_handle(struct zmk_position_state_changed *ev);
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_CENTRAL_REORDER)
+/**
+ * Raise a position state change from the central or any of its peripherals, once every earlier
+ * scanned change that may still be on its way from a peripheral has been raised.
+ *
+ * Must be called from the input work queue.
+ */
+void zmk_split_central_raise_position_state(const struct zmk_position_state_changed *ev);
+#endif
+
 #if ZMK_KEYMAP_HAS_SENSORS
 void zmk_sensor_event_handle(struct zmk_sensor_event *ev);
 #endif
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+/**
+ * Report an input frame received from a peripheral as input events of its zmk,input-split device.
+ */
+int zmk_split_input_frame_handle(const struct zmk_split_input_frame *frame);
+#endif
+
+int zmk_split_invoke_behavior(uint8_t source, struct zmk_behavior_binding *binding,
+                              struct zmk_behavior_binding_event event, bool state);
+
 void send_split_run_impl(struct zmk_split_run_behavior_payload_wrapper *payload_wrapper);
+
+/**
+ * Send any behavior invocations the transport has batched up. Called after each run of
+ * send_split_run_impl() calls for the queued invocations.
+ */
+void send_split_run_flush_impl(void);
@@ -6,23 +6,147 @@
 
 #pragma once
 
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/sys/atomic.h>
 #include <zephyr/sys/ring_buffer.h>
 
+#include <zmk/events/split_serial_link_health_changed.h>
+
 // The serial protocol is defined for payloads of up to 254 bytes. This should
 // be large enough to ensure that one message can be fully buffered.
 #define SERIAL_BUF_SIZE 300
 
+// Full position state bitmap after a struct serial_position_header ("sbt" version 2).
+#define SERIAL_CMD_POSITION_BITMAP 0x73627402
+// Changed positions only, as a struct serial_position_header followed by an array of struct
+// serial_position_delta ("spd" version 3).
+#define SERIAL_CMD_POSITION_DELTA 0x73706403
+// Clock synchronization request from the central, struct serial_clock_ping ("png" version 0).
+#define SERIAL_CMD_CLOCK_PING 0x706e6700
+// Clock synchronization response from the peripheral, struct serial_clock_pong ("pog" version 0).
+#define SERIAL_CMD_CLOCK_PONG 0x706f6700
+
+// Relative motion from a peripheral input device, struct zmk_split_input_frame ("sif" version 0).
+#define SERIAL_CMD_INPUT_FRAME 0x73696600
+
+// Central to peripheral behavior invocation, struct zmk_split_run_behavior_payload ("srb" version
+// 0).
+#define SERIAL_CMD_RUN_BEHAVIOR 0x73726200
+// Central to peripheral HID indicator state, a zmk_hid_indicators_t ("shi" version 0).
+#define SERIAL_CMD_HID_INDICATORS 0x73686900
+
+// Link latency probe, struct serial_echo, answered by either side ("ecq" version 0).
+#define SERIAL_CMD_ECHO_REQUEST 0x65637100
+// Link latency probe response, the struct serial_echo of the request ("ecr" version 0).
+#define SERIAL_CMD_ECHO_REPLY 0x65637200
+
+// Serial links are numbered in this order: UART, then USB CDC ACM. On the central, the link index
+// is the source slot of the peripheral connected to it.
+#define ZMK_SPLIT_SERIAL_LINK_COUNT                                                                \
+    (IS_ENABLED(CONFIG_ZMK_SPLIT_SERIAL_UART) + IS_ENABLED(CONFIG_ZMK_SPLIT_SERIAL_CDC_ACM))
+
+// Bonded links all carry the same peripheral, which then has source slot 0.
+#define ZMK_SPLIT_SERIAL_PERIPHERAL_COUNT                                                          \
+    (IS_ENABLED(CONFIG_ZMK_SPLIT_SERIAL_BOND_LINKS) ? 1 : ZMK_SPLIT_SERIAL_LINK_COUNT)
+
+struct serial_position_header {
+    // Picked by the peripheral at boot, so the central knows to restart its sequence tracking
+    // when the peripheral restarts and its sequence numbers start over.
+    uint16_t epoch;
+    // Incremented for every position frame, so the central can drop the copies of a frame that
+    // arrive on other bonded links.
+    uint16_t seq;
+} __packed;
+
+struct serial_position_delta {
+    uint8_t position;
+    uint8_t state;
+    // Low 32 bits of the peripheral's uptime in milliseconds when the key state changed.
+    uint32_t timestamp;
+} __packed;
+
+struct serial_clock_ping {
+    uint32_t central_time;
+} __packed;
+
+struct serial_clock_pong {
+    uint32_t central_time;
+    uint32_t peripheral_time;
+} __packed;
+
+struct serial_echo {
+    // Cycle counter of the requesting side when the request was sent.
+    uint32_t cycles;
+} __packed;
+
+// Prefix, command, CRC32 of the body and body length.
+#define SERIAL_MSG_HEADER_LEN 13
+
+enum serial_rx_state {
+    SERIAL_RX_STATE_PREFIX,
+    SERIAL_RX_STATE_HEADER,
+    SERIAL_RX_STATE_BODY,
+};
+
 struct serial_device {
     const struct device *dev;
     uint8_t rx_buf[SERIAL_BUF_SIZE], tx_buf[SERIAL_BUF_SIZE];
     struct ring_buf rx_rb, tx_rb;
+    struct k_spinlock tx_lock;
     struct k_work rx_work;
 
+    struct zmk_split_serial_link_stats stats;
+    bool echo_pending;
+
+    // Frame parser state, only accessed from the RX work item.
+    enum serial_rx_state rx_state;
+    uint8_t rx_pos;
+    uint8_t rx_header[SERIAL_MSG_HEADER_LEN];
+    uint32_t rx_crc;
+    uint8_t rx_frame[UINT8_MAX];
+
 #ifdef CONFIG_ZMK_SPLIT_SERIAL_UART_POLL
     bool poll;
     struct k_work tx_work;
     struct k_timer rx_timer;
+    uint32_t rx_poll_ticks;
+#endif
+
+#ifdef CONFIG_ZMK_SPLIT_SERIAL_UART_ASYNC
+    bool async;
+    atomic_t tx_busy;
+    uint8_t rx_next_buf;
+    uint8_t async_rx_bufs[2][CONFIG_ZMK_SPLIT_SERIAL_UART_ASYNC_RX_BUF_SIZE];
 #endif
 };
 
-void serial_handle_rx(uint32_t cmd, uint8_t *data, uint8_t len);
+/**
+ * Handle a message received on the serial link with index @p slot.
+ */
+void serial_handle_rx(uint8_t slot, uint32_t cmd, uint8_t *data, uint8_t len);
+
+/**
+ * Queue a message for transmission on the serial link with index @p slot.
+ *
+ * @retval 0 If the message was queued.
+ * @retval -EINVAL If there is no link with that index.
+ * @retval -ENOMEM If there is no room for the whole message in the TX buffer.
+ */
+int serial_write_slot(uint8_t slot, uint32_t cmd, uint8_t *data, uint8_t len);
+
+/**
+ * Queue a message for transmission on every serial link.
+ *
+ * @retval 0 If the message was queued on all links.
+ * @retval Negative errno code of the first link that failed.
+ */
+int serial_write_all(uint32_t cmd, uint8_t *data, uint8_t len);
+
+/**
+ * Queue a message for transmission on every serial link, succeeding if any link accepted it.
+ *
+ * @retval 0 If the message was queued on at least one link.
+ * @retval Negative errno code of the first link that failed, if all failed.
+ */
+int serial_write_any(uint32_t cmd, uint8_t *data, uint8_t len);
@@ -31,18 +31,71 @@ struct zmk_split_run_behavior_payload {
     char behavior_dev[ZMK_SPLIT_RUN_BEHAVIOR_DEV_LEN];
 } __packed;
 
+// Notifications carry as many events as fit into the ATT MTU, four at the default 23 byte MTU.
+#define ZMK_SPLIT_POS_EVENTS_MAX 16
+
+struct zmk_split_position_event {
+    uint8_t position;
+    uint8_t state;
+    // Milliseconds from the key state change until the notification was sent.
+    uint16_t age;
+} __packed;
+
+struct zmk_split_position_events {
+    // Sequence number of the first event, incremented by one for every event. A gap tells the
+    // central that events were lost and it needs to read the full position state.
+    uint8_t seq;
+    uint8_t count;
+    struct zmk_split_position_event events[ZMK_SPLIT_POS_EVENTS_MAX];
+} __packed;
+
+// Entry of a batched behavior run write, which names the behavior by zmk_behavior_get_id().
+struct zmk_split_run_behavior_compact {
+    uint16_t behavior_id;
+    struct zmk_split_run_behavior_data data;
+} __packed;
+
 struct zmk_split_run_behavior_payload_wrapper {
     uint8_t source;
+    // zmk_behavior_get_id() of the full behavior name, which the payload may have truncated.
+    uint16_t behavior_id;
     struct zmk_split_run_behavior_payload payload;
 };
 
-int zmk_split_position_pressed(uint8_t position);
-int zmk_split_position_released(uint8_t position);
+// Relative motion summed up from one input device on the peripheral, sent at most once per
+// input_frame_interval_us_impl().
+struct zmk_split_input_frame {
+    // The reg of the zmk,input-split node of the device.
+    uint8_t reg;
+    int16_t x;
+    int16_t y;
+    // In 1/120 of a wheel detent, like INPUT_REL_WHEEL_HI_RES.
+    int16_t scroll_x;
+    int16_t scroll_y;
+} __packed;
+
+struct k_work_q *zmk_split_service_work_q(void);
+
+int zmk_split_position_pressed(uint8_t position, int64_t timestamp);
+int zmk_split_position_released(uint8_t position, int64_t timestamp);
 int zmk_split_sensor_triggered(uint8_t sensor_index,
                                const struct zmk_sensor_channel_data channel_data[],
                                size_t channel_data_size);
 
-void send_position_state_impl(uint8_t *state, int len);
+/**
+ * Send the position state bitmap to the central. @p timestamp is the time of the key state change
+ * that produced this state, which transports may pass on to the central.
+ */
+void send_position_state_impl(uint8_t *state, int len, int64_t timestamp);
 #if ZMK_KEYMAP_HAS_SENSORS
 void send_sensor_state_impl(struct sensor_event *event, int len);
 #endif
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+void send_input_frame_impl(const struct zmk_split_input_frame *frame);
+
+/**
+ * Shortest time between input frames the transport takes, in microseconds. Motion reported in the
+ * meantime is added to the next frame.
+ */
+uint32_t input_frame_interval_us_impl(void);
+#endif
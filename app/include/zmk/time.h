@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+
+/**
+ * A point in time as the low 32 bits of the kernel tick count, which is the unit k_uptime_get()
+ * is derived from and finer than a millisecond on the tickless kernels ZMK runs on.
+ *
+ * It wraps, after about 36 hours with the 32768 Hz ticks of nRF SoCs, so only compare times that
+ * are less than half of that apart.
+ */
+typedef uint32_t zmk_time_t;
+
+/**
+ * Gets the current time, without the 64-bit division of k_uptime_get().
+ */
+static inline zmk_time_t zmk_time_now(void) { return (zmk_time_t)k_uptime_ticks(); }
+
+/**
+ * Gets whether time @p a is before time @p b.
+ */
+static inline bool zmk_time_before(zmk_time_t a, zmk_time_t b) { return (int32_t)(a - b) < 0; }
+
+/**
+ * Gets the microseconds from time @p since to time @p until.
+ */
+static inline uint32_t zmk_time_elapsed_us(zmk_time_t since, zmk_time_t until) {
+    return k_ticks_to_us_floor32(until - since);
+}
+
+/**
+ * Gets the time that a number of milliseconds of uptime, as from k_uptime_get(), corresponds to.
+ */
+static inline zmk_time_t zmk_time_from_uptime_ms(int64_t uptime_ms) {
+    return (zmk_time_t)k_ms_to_ticks_ceil64(uptime_ms);
+}
+
+/**
+ * Expands @p time to the full 64-bit tick count, given the full tick count @p ref_ticks of any
+ * time less than half of the wrap away from it, so one read of k_uptime_ticks() can serve a
+ * whole batch of times.
+ */
+static inline int64_t zmk_time_expand(zmk_time_t time, int64_t ref_ticks) {
+    return ref_ticks + (int32_t)(time - (zmk_time_t)ref_ticks);
+}
+
+/**
+ * Gets the milliseconds of uptime, as from k_uptime_get(), of @p time, given the full tick count
+ * @p ref_ticks of any time less than half of the wrap away from it.
+ */
+static inline int64_t zmk_time_to_uptime_ms(zmk_time_t time, int64_t ref_ticks) {
+    return k_ticks_to_ms_floor64(zmk_time_expand(time, ref_ticks));
+}
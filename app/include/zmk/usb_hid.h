@@ -8,9 +8,44 @@
 
 #include <stdint.h>
 
+#include <zephyr/device.h>
+
+/*
+ * Indices of the USB HID devices (HID_0, HID_1, ...) used by each interface. The keyboard
+ * interface always comes first, followed by the optional interfaces in a fixed order, so enabling
+ * one interface never changes the device used by another.
+ */
+#define ZMK_USB_HID_DEVICE_KEYBOARD 0
+#define ZMK_USB_HID_DEVICE_CONSUMER (ZMK_USB_HID_DEVICE_KEYBOARD + 1)
+#define ZMK_USB_HID_DEVICE_MOUSE                                                                   \
+    (ZMK_USB_HID_DEVICE_CONSUMER + IS_ENABLED(CONFIG_ZMK_USB_HID_CONSUMER_INTERFACE))
+#define ZMK_USB_HID_DEVICE_RAW (ZMK_USB_HID_DEVICE_MOUSE + IS_ENABLED(CONFIG_ZMK_MOUSE))
+#define ZMK_USB_HID_DEVICE_COUNT (ZMK_USB_HID_DEVICE_RAW + IS_ENABLED(CONFIG_ZMK_RAW_HID))
+
+/**
+ * Looks up the USB HID device with the given index, or NULL if it does not exist.
+ */
+const struct device *zmk_usb_hid_get_device(uint8_t index);
+
 int zmk_usb_hid_send_keyboard_report(void);
 int zmk_usb_hid_send_consumer_report(void);
 #if IS_ENABLED(CONFIG_ZMK_MOUSE)
 int zmk_usb_hid_send_mouse_report(void);
 #endif // IS_ENABLED(CONFIG_ZMK_MOUSE)
 void zmk_usb_hid_set_protocol(uint8_t protocol);
+
+/**
+ * Returns true when no keyboard or consumer report is queued or waiting for the host to read it.
+ */
+bool zmk_usb_hid_is_idle(void);
+
+/**
+ * Sends the reports queued while the bus was suspended. Called when the bus resumes.
+ */
+void zmk_usb_hid_resumed(void);
+
+/**
+ * Sends the latest keyboard and consumer state if reports were dropped before the host configured
+ * the device. Called when the host configures the device.
+ */
+void zmk_usb_hid_configured(void);
@@ -1 +1,65 @@
+/*
+ * Copyright (c) 2023 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/iterable_sections.h>
+
+/**
+ * How quickly the work run on a work queue has to happen, from the most to the least urgent.
+ */
+enum zmk_workqueue_latency {
+    /** Work on the path of key events, such as processing them or sending them to the central. */
+    ZMK_WORKQUEUE_LATENCY_INPUT,
+    /** Work that delivers reports or split traffic once they are ready. */
+    ZMK_WORKQUEUE_LATENCY_TRANSPORT,
+    /** Work that can wait, such as saving settings or updating the display. */
+    ZMK_WORKQUEUE_LATENCY_BULK,
+};
+
+struct zmk_workqueue_entry {
+    const char *name;
+    struct k_work_q *work_q;
+    enum zmk_workqueue_latency latency;
+};
+
+#if IS_ENABLED(CONFIG_ZMK_WORKQUEUE_AUDIT)
+
+/**
+ * Registers a work queue and the latency class of the work run on it, so the audit at boot can
+ * warn about queues for more urgent work running at a lower thread priority than others.
+ *
+ * @param work_q The work queue.
+ * @param _name The name shown for the queue.
+ * @param _latency The enum zmk_workqueue_latency of the work run on the queue.
+ */
+#define ZMK_WORKQUEUE_REGISTER(work_q, _name, _latency)                                            \
+    static const STRUCT_SECTION_ITERABLE(zmk_workqueue_entry, _CONCAT(zmk_workqueue_, work_q)) = { \
+        .name = _name,                                                                             \
+        .work_q = &(work_q),                                                                       \
+        .latency = _latency,                                                                       \
+    }
+
+#else
+
+// Only declared, so uses of the macro still end in a declaration.
+#define ZMK_WORKQUEUE_REGISTER(work_q, _name, _latency)                                            \
+    extern const struct zmk_workqueue_entry _CONCAT(zmk_workqueue_, work_q)
+
+#endif // IS_ENABLED(CONFIG_ZMK_WORKQUEUE_AUDIT)
+
 struct k_work_q *zmk_workqueue_lowprio_work_q(void);
+
+/**
+ * Get the work queue used to process input events (key positions and sensors) through the keymap
+ * and behaviors.
+ *
+ * This is a dedicated queue if CONFIG_ZMK_INPUT_WORK_QUEUE is enabled, or the system work queue
+ * otherwise. All work that touches behavior or keymap state must be submitted to this queue so it
+ * is never run concurrently with input processing.
+ */
+struct k_work_q *zmk_workqueue_input_work_q(void);
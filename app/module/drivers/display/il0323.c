@@ -34,7 +34,10 @@ LOG_MODULE_REGISTER(il0323, CONFIG_DISPLAY_LOG_LEVEL);
 #define IL0323_PANEL_LAST_GATE (EPD_PANEL_HEIGHT - 1)
 #define IL0323_PANEL_FIRST_PAGE 0U
 #define IL0323_PANEL_LAST_PAGE (IL0323_NUMOF_PAGES - 1)
-#define IL0323_BUFFER_SIZE 1280
+#define IL0323_BUFFER_SIZE (IL0323_NUMOF_PAGES * EPD_PANEL_HEIGHT)
+
+/* How often to check the busy pin if it can't interrupt */
+#define IL0323_BUSY_POLL_PERIOD 10U
 
 struct il0323_cfg {
     struct gpio_dt_spec reset;
@@ -43,11 +46,32 @@ struct il0323_cfg {
     struct spi_dt_spec spi;
 };
 
+/* Region of the panel, in pages horizontally and gates vertically, both inclusive */
+struct il0323_area {
+    uint16_t x_start;
+    uint16_t x_end;
+    uint16_t y_start;
+    uint16_t y_end;
+};
+
 static uint8_t il0323_pwr[] = DT_INST_PROP(0, pwr);
 
-static uint8_t last_buffer[IL0323_BUFFER_SIZE];
+/* Image the panel should show, and the image the panel was last refreshed with */
+static uint8_t frame_buffer[IL0323_BUFFER_SIZE];
+static uint8_t panel_buffer[IL0323_BUFFER_SIZE];
+
+/* Protects the buffers and the dirty area, which are shared with the refresh work */
+static K_MUTEX_DEFINE(buffer_lock);
+static struct il0323_area dirty_area;
+static bool dirty;
+
 static bool blanking_on = true;
-static bool init_clear_done = false;
+/* The first refresh drives every pixel, since the panel contents are unknown until then */
+static bool full_refresh_pending = true;
+static uint32_t partial_refreshes;
+
+static struct gpio_callback busy_cb;
+static struct k_work_delayable refresh_work;
 
 static inline int il0323_write_cmd(const struct il0323_cfg *cfg, uint8_t cmd, uint8_t *data,
                                    size_t len) {
@@ -71,6 +95,34 @@ static inline int il0323_write_cmd(const struct il0323_cfg *cfg, uint8_t cmd, ui
     return 0;
 }
 
+/* Send the rows of an area of a buffer as the data of a command, inverted if requested */
+static int il0323_write_area(const struct il0323_cfg *cfg, uint8_t cmd, const uint8_t *buffer,
+                             const struct il0323_area *area, bool invert) {
+    uint8_t row[IL0323_NUMOF_PAGES];
+    size_t len = area->x_end - area->x_start + 1;
+    struct spi_buf buf = {.buf = row, .len = len};
+    struct spi_buf_set buf_set = {.buffers = &buf, .count = 1};
+
+    if (il0323_write_cmd(cfg, cmd, NULL, 0)) {
+        return -EIO;
+    }
+
+    gpio_pin_set_dt(&cfg->dc, 0);
+    for (int y = area->y_start; y <= area->y_end; y++) {
+        const uint8_t *src = &buffer[y * IL0323_NUMOF_PAGES + area->x_start];
+
+        for (int i = 0; i < len; i++) {
+            row[i] = invert ? ~src[i] : src[i];
+        }
+
+        if (spi_write_dt(&cfg->spi, &buf_set)) {
+            return -EIO;
+        }
+    }
+
+    return 0;
+}
+
 static inline void il0323_busy_wait(const struct il0323_cfg *cfg) {
     int pin = gpio_pin_get_dt(&cfg->busy);
 
@@ -95,129 +147,210 @@ static int il0323_update_display(const struct device *dev) {
     return 0;
 }
 
-static int il0323_write(const struct device *dev, const uint16_t x, const uint16_t y,
-                        const struct display_buffer_descriptor *desc, const void *buf) {
+/*
+ * Refresh the area of the panel that changed. Only that window is sent, with the old image for
+ * it so the controller only drives the pixels that differ. Every so often the whole panel is
+ * refreshed instead, with the old image inverted so every pixel is driven to clear any ghosting.
+ */
+static int il0323_refresh(const struct device *dev, const struct il0323_area *area, bool full) {
     const struct il0323_cfg *cfg = dev->config;
-    uint16_t x_end_idx = x + desc->width - 1;
-    uint16_t y_end_idx = y + desc->height - 1;
     uint8_t ptl[IL0323_PTL_REG_LENGTH] = {0};
-    size_t buf_len;
 
-    LOG_DBG("x %u, y %u, height %u, width %u, pitch %u", x, y, desc->height, desc->width,
-            desc->pitch);
+    LOG_DBG("%s refresh x %u-%u, y %u-%u", full ? "Full" : "Partial",
+            area->x_start * IL0323_PIXELS_PER_BYTE,
+            (area->x_end + 1) * IL0323_PIXELS_PER_BYTE - 1, area->y_start, area->y_end);
 
-    buf_len = MIN(desc->buf_size, desc->height * desc->width / IL0323_PIXELS_PER_BYTE);
-    __ASSERT(desc->width <= desc->pitch, "Pitch is smaller then width");
-    __ASSERT(buf != NULL, "Buffer is not available");
-    __ASSERT(buf_len != 0U, "Buffer of length zero");
-    __ASSERT(!(desc->width % IL0323_PIXELS_PER_BYTE), "Buffer width not multiple of %d",
-             IL0323_PIXELS_PER_BYTE);
+    if (!full) {
+        /* Setup Partial Window and enable Partial Mode */
+        ptl[IL0323_PTL_HRST_IDX] = area->x_start * IL0323_PIXELS_PER_BYTE;
+        ptl[IL0323_PTL_HRED_IDX] = (area->x_end + 1) * IL0323_PIXELS_PER_BYTE - 1;
+        ptl[IL0323_PTL_VRST_IDX] = area->y_start;
+        ptl[IL0323_PTL_VRED_IDX] = area->y_end;
+        ptl[sizeof(ptl) - 1] = IL0323_PTL_PT_SCAN;
+        LOG_HEXDUMP_DBG(ptl, sizeof(ptl), "ptl");
 
-    LOG_DBG("buf_len %d", buf_len);
-    if ((y_end_idx > (EPD_PANEL_HEIGHT - 1)) || (x_end_idx > (EPD_PANEL_WIDTH - 1))) {
-        LOG_ERR("Position out of bounds");
-        return -EINVAL;
-    }
+        if (il0323_write_cmd(cfg, IL0323_CMD_PIN, NULL, 0)) {
+            return -EIO;
+        }
 
-    /* Setup Partial Window and enable Partial Mode */
-    ptl[IL0323_PTL_HRST_IDX] = x;
-    ptl[IL0323_PTL_HRED_IDX] = x_end_idx;
-    ptl[IL0323_PTL_VRST_IDX] = y;
-    ptl[IL0323_PTL_VRED_IDX] = y_end_idx;
-    ptl[sizeof(ptl) - 1] = IL0323_PTL_PT_SCAN;
-    LOG_HEXDUMP_DBG(ptl, sizeof(ptl), "ptl");
+        if (il0323_write_cmd(cfg, IL0323_CMD_PTL, ptl, sizeof(ptl))) {
+            return -EIO;
+        }
+    }
 
-    il0323_busy_wait(cfg);
-    if (il0323_write_cmd(cfg, IL0323_CMD_PIN, NULL, 0)) {
+    if (il0323_write_area(cfg, IL0323_CMD_DTM1, full ? frame_buffer : panel_buffer, area, full)) {
         return -EIO;
     }
 
-    if (il0323_write_cmd(cfg, IL0323_CMD_PTL, ptl, sizeof(ptl))) {
+    if (il0323_write_area(cfg, IL0323_CMD_DTM2, frame_buffer, area, false)) {
         return -EIO;
     }
 
-    if (il0323_write_cmd(cfg, IL0323_CMD_DTM1, last_buffer, IL0323_BUFFER_SIZE)) {
+    for (int y = area->y_start; y <= area->y_end; y++) {
+        size_t offset = y * IL0323_NUMOF_PAGES + area->x_start;
+
+        memcpy(&panel_buffer[offset], &frame_buffer[offset], area->x_end - area->x_start + 1);
+    }
+
+    if (il0323_update_display(dev)) {
         return -EIO;
     }
 
-    if (il0323_write_cmd(cfg, IL0323_CMD_DTM2, (uint8_t *)buf, buf_len)) {
+    /* Disable Partial Mode */
+    if (!full && il0323_write_cmd(cfg, IL0323_CMD_POUT, NULL, 0)) {
         return -EIO;
     }
 
-    memcpy(last_buffer, (uint8_t *)buf, IL0323_BUFFER_SIZE);
+    return 0;
+}
 
-    /* Update partial window and disable Partial Mode */
-    if (blanking_on == false) {
-        if (il0323_update_display(dev)) {
-            return -EIO;
-        }
+/*
+ * Wait for the controller to finish any refresh in progress without blocking the caller. Returns
+ * true if it is ready, or else arranges for the refresh work to run again once it is.
+ */
+static bool il0323_refresh_ready(const struct il0323_cfg *cfg) {
+    if (gpio_pin_get_dt(&cfg->busy) <= 0) {
+        gpio_pin_interrupt_configure_dt(&cfg->busy, GPIO_INT_DISABLE);
+        return true;
     }
 
-    if (il0323_write_cmd(cfg, IL0323_CMD_POUT, NULL, 0)) {
-        return -EIO;
+    if (gpio_pin_interrupt_configure_dt(&cfg->busy, GPIO_INT_EDGE_TO_INACTIVE)) {
+        k_work_schedule(&refresh_work, K_MSEC(IL0323_BUSY_POLL_PERIOD));
+        return false;
     }
 
-    return 0;
+    /* The refresh may have finished before the interrupt was enabled */
+    if (gpio_pin_get_dt(&cfg->busy) <= 0) {
+        gpio_pin_interrupt_configure_dt(&cfg->busy, GPIO_INT_DISABLE);
+        return true;
+    }
+
+    return false;
 }
 
-static int il0323_read(const struct device *dev, const uint16_t x, const uint16_t y,
-                       const struct display_buffer_descriptor *desc, void *buf) {
-    LOG_ERR("not supported");
-    return -ENOTSUP;
+static void il0323_busy_handler(const struct device *port, struct gpio_callback *cb,
+                                gpio_port_pins_t pins) {
+    k_work_schedule(&refresh_work, K_NO_WAIT);
 }
 
-static int il0323_clear_and_write_buffer(const struct device *dev, uint8_t pattern, bool update) {
-    struct display_buffer_descriptor desc = {
-        .buf_size = IL0323_NUMOF_PAGES,
-        .width = EPD_PANEL_WIDTH,
-        .height = 1,
-        .pitch = EPD_PANEL_WIDTH,
-    };
-    uint8_t *line;
+static void il0323_refresh_work_handler(struct k_work *work) {
+    const struct device *dev = DEVICE_DT_INST_GET(0);
+    const struct il0323_cfg *cfg = dev->config;
 
-    line = k_malloc(IL0323_NUMOF_PAGES);
-    if (line == NULL) {
-        LOG_ERR("Failed to allocate memory for the clear");
-        return -ENOMEM;
+    if (blanking_on || !il0323_refresh_ready(cfg)) {
+        return;
     }
 
-    memset(line, pattern, IL0323_NUMOF_PAGES);
-    for (int i = 0; i < EPD_PANEL_HEIGHT; i++) {
-        il0323_write(dev, 0, i, &desc, line);
+    k_mutex_lock(&buffer_lock, K_FOREVER);
+
+    bool full = full_refresh_pending || (CONFIG_IL0323_FULL_REFRESH_INTERVAL > 0 &&
+                                         partial_refreshes >= CONFIG_IL0323_FULL_REFRESH_INTERVAL);
+
+    if (!dirty && !full_refresh_pending) {
+        k_mutex_unlock(&buffer_lock);
+        return;
     }
 
-    k_free(line);
+    struct il0323_area area = dirty_area;
+    if (full) {
+        area = (struct il0323_area){
+            .x_start = IL0323_PANEL_FIRST_PAGE,
+            .x_end = IL0323_PANEL_LAST_PAGE,
+            .y_start = IL0323_PANEL_FIRST_GATE,
+            .y_end = IL0323_PANEL_LAST_GATE,
+        };
+    }
 
-    if (update == true) {
-        if (il0323_update_display(dev)) {
-            return -EIO;
-        }
+    int err = il0323_refresh(dev, &area, full);
+    if (err) {
+        LOG_ERR("Failed to refresh the display (%d)", err);
+    } else {
+        dirty = false;
+        full_refresh_pending = false;
+        partial_refreshes = full ? 0 : partial_refreshes + 1;
     }
 
-    return 0;
+    k_mutex_unlock(&buffer_lock);
 }
 
-static int il0323_blanking_off(const struct device *dev) {
-    const struct il0323_cfg *cfg = dev->config;
+/*
+ * Writes only update the frame buffer and mark the area as changed. The panel is refreshed from
+ * the refresh work once the controller is ready, so changes made during a refresh are combined
+ * into the next one and the caller never waits for the panel.
+ */
+static int il0323_write(const struct device *dev, const uint16_t x, const uint16_t y,
+                        const struct display_buffer_descriptor *desc, const void *buf) {
+    uint16_t x_end_idx = x + desc->width - 1;
+    uint16_t y_end_idx = y + desc->height - 1;
+    size_t pitch = desc->pitch / IL0323_PIXELS_PER_BYTE;
+    size_t len = desc->width / IL0323_PIXELS_PER_BYTE;
+    size_t buf_len;
 
-    if (!init_clear_done) {
-        /* Update EPD panel in normal mode */
-        il0323_busy_wait(cfg);
-        if (il0323_clear_and_write_buffer(dev, 0xff, true)) {
-            return -EIO;
-        }
-        init_clear_done = true;
+    LOG_DBG("x %u, y %u, height %u, width %u, pitch %u", x, y, desc->height, desc->width,
+            desc->pitch);
+
+    buf_len = MIN(desc->buf_size, desc->height * desc->width / IL0323_PIXELS_PER_BYTE);
+    __ASSERT(desc->width <= desc->pitch, "Pitch is smaller then width");
+    __ASSERT(buf != NULL, "Buffer is not available");
+    __ASSERT(buf_len != 0U, "Buffer of length zero");
+    __ASSERT(!(desc->width % IL0323_PIXELS_PER_BYTE), "Buffer width not multiple of %d",
+             IL0323_PIXELS_PER_BYTE);
+    __ASSERT(!(x % IL0323_PIXELS_PER_BYTE), "X coordinate not multiple of %d",
+             IL0323_PIXELS_PER_BYTE);
+
+    LOG_DBG("buf_len %d", buf_len);
+    if ((y_end_idx > (EPD_PANEL_HEIGHT - 1)) || (x_end_idx > (EPD_PANEL_WIDTH - 1))) {
+        LOG_ERR("Position out of bounds");
+        return -EINVAL;
     }
 
-    blanking_on = false;
+    struct il0323_area area = {
+        .x_start = x / IL0323_PIXELS_PER_BYTE,
+        .x_end = x_end_idx / IL0323_PIXELS_PER_BYTE,
+        .y_start = y,
+        .y_end = y_end_idx,
+    };
 
-    if (il0323_update_display(dev)) {
-        return -EIO;
+    k_mutex_lock(&buffer_lock, K_FOREVER);
+
+    for (int i = 0; i < desc->height; i++) {
+        memcpy(&frame_buffer[(y + i) * IL0323_NUMOF_PAGES + area.x_start],
+               (const uint8_t *)buf + i * pitch, len);
+    }
+
+    if (dirty) {
+        dirty_area.x_start = MIN(dirty_area.x_start, area.x_start);
+        dirty_area.x_end = MAX(dirty_area.x_end, area.x_end);
+        dirty_area.y_start = MIN(dirty_area.y_start, area.y_start);
+        dirty_area.y_end = MAX(dirty_area.y_end, area.y_end);
+    } else {
+        dirty_area = area;
+        dirty = true;
+    }
+
+    k_mutex_unlock(&buffer_lock);
+
+    if (!blanking_on) {
+        k_work_schedule(&refresh_work, K_NO_WAIT);
     }
 
     return 0;
 }
 
+static int il0323_read(const struct device *dev, const uint16_t x, const uint16_t y,
+                       const struct display_buffer_descriptor *desc, void *buf) {
+    LOG_ERR("not supported");
+    return -ENOTSUP;
+}
+
+static int il0323_blanking_off(const struct device *dev) {
+    blanking_on = false;
+
+    k_work_schedule(&refresh_work, K_NO_WAIT);
+
+    return 0;
+}
+
 static int il0323_blanking_on(const struct device *dev) {
     blanking_on = true;
 
@@ -368,6 +501,17 @@ static int il0323_init(const struct device *dev) {
 
     gpio_pin_configure_dt(&cfg->busy, GPIO_INPUT);
 
+    /* Without interrupt support, the refresh work polls the busy pin instead */
+    gpio_init_callback(&busy_cb, il0323_busy_handler, BIT(cfg->busy.pin));
+    if (gpio_add_callback(cfg->busy.port, &busy_cb)) {
+        LOG_WRN("Could not add a callback for the IL0323 busy signal");
+    }
+
+    k_work_init_delayable(&refresh_work, il0323_refresh_work_handler);
+
+    /* Blank until the first refresh, which replaces the panel contents */
+    memset(frame_buffer, 0xff, sizeof(frame_buffer));
+
     return il0323_controller_init(dev);
 }
 
@@ -41,6 +41,9 @@ struct reg_595_drv_data {
     struct k_sem lock;
 
     uint32_t gpio_cache;
+
+    /* Whether gpio_cache holds what was last written to the registers */
+    bool cache_valid;
 };
 
 static int reg_595_write_registers(const struct device *dev, uint32_t value) {
@@ -48,6 +51,14 @@ static int reg_595_write_registers(const struct device *dev, uint32_t value) {
     struct reg_595_drv_data *const drv_data = (struct reg_595_drv_data *const)dev->data;
     int ret = 0;
 
+    /*
+     * Matrix scans often set outputs to the level they already have, e.g. releasing every output
+     * before scanning. Those writes would change nothing, so skip the bus transfer.
+     */
+    if (drv_data->cache_valid && value == drv_data->gpio_cache) {
+        return 0;
+    }
+
     uint8_t nwrite = config->ngpios / 8;
     uint32_t reg_data = sys_cpu_to_be32(value);
 
@@ -69,6 +80,7 @@ static int reg_595_write_registers(const struct device *dev, uint32_t value) {
     }
 
     drv_data->gpio_cache = value;
+    drv_data->cache_valid = true;
     return 0;
 }
 
@@ -14,6 +14,7 @@
 
 #include <zephyr/kernel.h>
 #include <zephyr/device.h>
+#include <zephyr/sys/atomic.h>
 #include <zephyr/init.h>
 #include <zephyr/sys/byteorder.h>
 #include <zephyr/drivers/gpio.h>
@@ -39,6 +40,8 @@ struct max7318_config {
     struct gpio_driver_config common;
 
     struct i2c_dt_spec i2c_bus;
+    // Optional INT output of the expander. If set, input reads are cached until it asserts.
+    struct gpio_dt_spec int_gpio;
     uint8_t ngpios;
 };
 
@@ -54,6 +57,11 @@ struct max7318_drv_data {
         uint16_t config;
         uint16_t output;
     } reg_cache;
+
+    // Last value read from the input registers, valid while input_stale is clear.
+    uint16_t input_cache;
+    atomic_t input_stale;
+    struct gpio_callback int_callback;
 };
 
 /**
@@ -101,6 +109,11 @@ static int read_registers(const struct device *dev, uint8_t reg, uint16_t *buf)
  */
 static int write_registers(const struct device *dev, uint8_t reg, uint16_t value) {
     const struct max7318_config *config = dev->config;
+    struct max7318_drv_data *const drv_data = (struct max7318_drv_data *const)dev->data;
+
+    // Changing outputs, directions or polarities can change what the inputs read without INT
+    // asserting in time for the next read, so don't trust the cached inputs after any write.
+    atomic_set(&drv_data->input_stale, 1);
 
     LOG_DBG("max7318: write: reg[0x%X] = 0x%X, reg[0x%X] = 0x%X", reg, (value & 0xFF), (reg + 1),
             (value >> 8));
@@ -206,8 +219,15 @@ done:
 }
 
 static int max7318_port_get_raw(const struct device *dev, uint32_t *value) {
+    const struct max7318_config *config = dev->config;
     struct max7318_drv_data *const drv_data = (struct max7318_drv_data *const)dev->data;
 
+    // The inputs haven't changed since the last read if INT hasn't asserted since.
+    if (config->int_gpio.port != NULL && !atomic_get(&drv_data->input_stale)) {
+        *value = drv_data->input_cache;
+        return 0;
+    }
+
     /* Can't do I2C bus operations from an ISR */
     if (k_is_in_isr()) {
         return -EWOULDBLOCK;
@@ -215,12 +235,18 @@ static int max7318_port_get_raw(const struct device *dev, uint32_t *value) {
 
     k_sem_take(&drv_data->lock, K_FOREVER);
 
+    // Clear the flag before reading, so a change during the read asserts INT and marks the
+    // result stale again.
+    atomic_set(&drv_data->input_stale, 0);
+
     uint16_t buf = 0;
     int ret = read_registers(dev, REG_INPUT_PORTA, &buf);
     if (ret != 0) {
+        atomic_set(&drv_data->input_stale, 1);
         goto done;
     }
 
+    drv_data->input_cache = buf;
     *value = buf;
 
 done:
@@ -285,6 +311,44 @@ static int max7318_pin_interrupt_configure(const struct device *dev, gpio_pin_t
     return -ENOTSUP;
 }
 
+static void max7318_int_handler(const struct device *port, struct gpio_callback *cb,
+                                gpio_port_pins_t pins) {
+    struct max7318_drv_data *drv_data = CONTAINER_OF(cb, struct max7318_drv_data, int_callback);
+
+    atomic_set(&drv_data->input_stale, 1);
+}
+
+static int max7318_init_int(const struct device *dev) {
+    const struct max7318_config *const config = dev->config;
+    struct max7318_drv_data *const drv_data = (struct max7318_drv_data *const)dev->data;
+
+    if (!gpio_is_ready_dt(&config->int_gpio)) {
+        LOG_ERR("INT GPIO not ready");
+        return -ENODEV;
+    }
+
+    int ret = gpio_pin_configure_dt(&config->int_gpio, GPIO_INPUT);
+    if (ret != 0) {
+        LOG_ERR("failed to configure INT GPIO (%d)", ret);
+        return ret;
+    }
+
+    gpio_init_callback(&drv_data->int_callback, max7318_int_handler, BIT(config->int_gpio.pin));
+    ret = gpio_add_callback(config->int_gpio.port, &drv_data->int_callback);
+    if (ret != 0) {
+        LOG_ERR("failed to add INT callback (%d)", ret);
+        return ret;
+    }
+
+    ret = gpio_pin_interrupt_configure_dt(&config->int_gpio, GPIO_INT_EDGE_TO_ACTIVE);
+    if (ret != 0) {
+        LOG_ERR("failed to configure INT interrupt (%d)", ret);
+        return ret;
+    }
+
+    return 0;
+}
+
 static const struct gpio_driver_api api_table = {
     .pin_configure = max7318_config,
     .port_get_raw = max7318_port_get_raw,
@@ -310,9 +374,17 @@ static int max7318_init(const struct device *dev) {
         return -EINVAL;
     }
 
+    k_sem_init(&drv_data->lock, 1, 1);
+
+    if (config->int_gpio.port != NULL) {
+        int ret = max7318_init_int(dev);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
     LOG_INF("device initialised at 0x%x", config->i2c_bus.addr);
 
-    k_sem_init(&drv_data->lock, 1, 1);
     return 0;
 }
 
@@ -324,13 +396,16 @@ static int max7318_init(const struct device *dev) {
 #define MAX7318_INIT(inst)                                                                         \
     static struct max7318_config max7318_##inst##_config = {                                       \
         .common = {.port_pin_mask = GPIO_PORT_PIN_MASK_FROM_DT_INST(inst)},                        \
-        .i2c_bus = I2C_DT_SPEC_INST_GET(inst)};                                                    \
+        .i2c_bus = I2C_DT_SPEC_INST_GET(inst),                                                     \
+        .int_gpio = GPIO_DT_SPEC_INST_GET_OR(inst, int_gpios, {0}),                                \
+    };                                                                                             \
                                                                                                    \
     static struct max7318_drv_data max7318_##inst##_drvdata = {                                    \
         /* Default for registers according to datasheet */                                         \
         .reg_cache.ipol = 0x0,                                                                     \
         .reg_cache.config = 0xFFFF,                                                                \
         .reg_cache.output = 0xFFFF,                                                                \
+        .input_stale = ATOMIC_INIT(1),                                                             \
     };                                                                                             \
                                                                                                    \
     DEVICE_DT_INST_DEFINE(inst, max7318_init, NULL, &max7318_##inst##_drvdata,                     \
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define DT_DRV_COMPAT zmk_input_mock
+
+#include <zephyr/device.h>
+#include <zephyr/input/input.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zephyr/dt-bindings/input/input-event-codes.h>
+
+// Each event is a type, code and value. An INPUT_EV_SYN event isn't reported, it ends a frame.
+#define EVENT_CELLS 3
+
+struct input_mock_config {
+    const int32_t *events;
+    size_t events_len;
+    uint32_t startup_delay;
+    uint32_t event_period;
+};
+
+struct input_mock_data {
+    size_t event_index;
+    struct k_work_delayable work;
+    const struct device *dev;
+};
+
+static bool input_mock_frame_ends(const struct input_mock_config *cfg, size_t index) {
+    return index + EVENT_CELLS >= cfg->events_len ||
+           cfg->events[index + EVENT_CELLS] == INPUT_EV_SYN;
+}
+
+static void input_mock_work_handler(struct k_work *work) {
+    struct k_work_delayable *d_work = k_work_delayable_from_work(work);
+    struct input_mock_data *data = CONTAINER_OF(d_work, struct input_mock_data, work);
+    const struct input_mock_config *cfg = data->dev->config;
+
+    // Report one frame, then wait before the next.
+    while (data->event_index < cfg->events_len) {
+        size_t index = data->event_index;
+        data->event_index += EVENT_CELLS;
+
+        uint8_t type = cfg->events[index];
+        if (type == INPUT_EV_SYN) {
+            break;
+        }
+
+        uint16_t code = cfg->events[index + 1];
+        int32_t value = cfg->events[index + 2];
+        bool sync = input_mock_frame_ends(cfg, index);
+
+        LOG_DBG("input event type %d code %d value %d sync %d", type, code, value, sync);
+        input_report(data->dev, type, code, value, sync, K_FOREVER);
+
+        if (sync) {
+            break;
+        }
+    }
+
+    if (data->event_index < cfg->events_len) {
+        k_work_schedule(&data->work, K_MSEC(cfg->event_period));
+    }
+}
+
+static int input_mock_init(const struct device *dev) {
+    struct input_mock_data *data = dev->data;
+    const struct input_mock_config *cfg = dev->config;
+
+    if (cfg->events_len % EVENT_CELLS != 0) {
+        LOG_ERR("Mock input events must be groups of type, code and value");
+        return -EINVAL;
+    }
+
+    data->dev = dev;
+    k_work_init_delayable(&data->work, input_mock_work_handler);
+    k_work_schedule(&data->work, K_MSEC(cfg->startup_delay));
+
+    return 0;
+}
+
+#define INPUT_MOCK_INST(n)                                                                         \
+    static const int32_t input_mock_events_##n[] = DT_INST_PROP(n, events);                        \
+    static struct input_mock_data input_mock_data_##n;                                             \
+    static const struct input_mock_config input_mock_config_##n = {                                \
+        .events = input_mock_events_##n,                                                           \
+        .events_len = DT_INST_PROP_LEN(n, events),                                                 \
+        .startup_delay = DT_INST_PROP(n, event_startup_delay),                                     \
+        .event_period = DT_INST_PROP(n, event_period),                                             \
+    };                                                                                             \
+    DEVICE_DT_INST_DEFINE(n, input_mock_init, NULL, &input_mock_data_##n,                          \
+                          &input_mock_config_##n, POST_KERNEL, CONFIG_INPUT_INIT_PRIORITY, NULL);
+
+DT_INST_FOREACH_STATUS_OKAY(INPUT_MOCK_INST)
@@ -6,11 +6,17 @@
 
 #define DT_DRV_COMPAT zmk_kscan_composite
 
+#include <string.h>
+
 #include <zephyr/device.h>
 #include <zephyr/drivers/kscan.h>
+#include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
+#include <zmk/kscan_sync.h>
+#include <zmk/kscan_timestamp.h>
+
 #define MATRIX_NODE_ID DT_DRV_INST(0)
 #define MATRIX_ROWS DT_PROP(MATRIX_NODE_ID, rows)
 #define MATRIX_COLS DT_PROP(MATRIX_NODE_ID, columns)
@@ -31,10 +37,26 @@ const struct kscan_composite_child_config kscan_composite_children[] = {
 
 struct kscan_composite_config {};
 
+#if IS_ENABLED(CONFIG_ZMK_KSCAN_COMPOSITE_BATCH)
+struct kscan_composite_event {
+    int64_t timestamp;
+    uint16_t row;
+    uint16_t column;
+    bool pressed;
+};
+#endif
+
 struct kscan_composite_data {
     kscan_callback_t callback;
 
     const struct device *dev;
+
+#if IS_ENABLED(CONFIG_ZMK_KSCAN_COMPOSITE_BATCH)
+    struct k_spinlock lock;
+    struct k_work flush_work;
+    struct kscan_composite_event events[CONFIG_ZMK_KSCAN_COMPOSITE_BATCH_SIZE];
+    size_t event_count;
+#endif
 };
 
 static int kscan_composite_enable_callback(const struct device *dev) {
@@ -55,6 +77,66 @@ static int kscan_composite_disable_callback(const struct device *dev) {
     return 0;
 }
 
+#if IS_ENABLED(CONFIG_ZMK_KSCAN_COMPOSITE_BATCH)
+static void kscan_composite_flush(struct kscan_composite_data *data) {
+    struct kscan_composite_event events[CONFIG_ZMK_KSCAN_COMPOSITE_BATCH_SIZE];
+    size_t count;
+
+    K_SPINLOCK(&data->lock) {
+        count = data->event_count;
+        memcpy(events, data->events, count * sizeof(events[0]));
+        data->event_count = 0;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        zmk_kscan_set_event_timestamp(events[i].timestamp);
+        // Everything the children found in one round is forwarded as one frame.
+        zmk_kscan_set_event_sync(i == count - 1);
+        data->callback(data->dev, events[i].row, events[i].column, events[i].pressed);
+    }
+}
+
+static void kscan_composite_flush_work(struct k_work *work) {
+    struct kscan_composite_data *data = CONTAINER_OF(work, struct kscan_composite_data, flush_work);
+
+    kscan_composite_flush(data);
+}
+
+/**
+ * Queue a key change to forward with the others found in the same round of child scans.
+ *
+ * Child scans which are due at the same time are all queued on the system work queue before any
+ * of them runs, so the flush submitted by the first change runs after the last of them.
+ */
+static void kscan_composite_queue_event(struct kscan_composite_data *data, uint32_t row,
+                                        uint32_t column, bool pressed) {
+    const struct kscan_composite_event ev = {.timestamp = zmk_kscan_take_event_timestamp(),
+                                             .row = row,
+                                             .column = column,
+                                             .pressed = pressed};
+
+    // The flush decides which change ends the frame, not the child.
+    zmk_kscan_take_event_sync();
+
+    while (true) {
+        k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+        if (data->event_count < ARRAY_SIZE(data->events)) {
+            data->events[data->event_count++] = ev;
+            k_spin_unlock(&data->lock, key);
+            break;
+        }
+
+        k_spin_unlock(&data->lock, key);
+
+        // The batch is full, so forward it now to make room.
+        kscan_composite_flush(data);
+    }
+
+    k_work_submit(&data->flush_work);
+}
+#endif
+
 static void kscan_composite_child_callback(const struct device *child_dev, uint32_t row,
                                            uint32_t column, bool pressed) {
     // TODO: Ideally we can get this passed into our callback!
@@ -68,7 +150,12 @@ static void kscan_composite_child_callback(const struct device *child_dev, uint3
             continue;
         }
 
+#if IS_ENABLED(CONFIG_ZMK_KSCAN_COMPOSITE_BATCH)
+        kscan_composite_queue_event(data, row + cfg->row_offset, column + cfg->column_offset,
+                                    pressed);
+#else
         data->callback(dev, row + cfg->row_offset, column + cfg->column_offset, pressed);
+#endif
     }
 }
 
@@ -95,6 +182,10 @@ static int kscan_composite_init(const struct device *dev) {
 
     data->dev = dev;
 
+#if IS_ENABLED(CONFIG_ZMK_KSCAN_COMPOSITE_BATCH)
+    k_work_init(&data->flush_work, kscan_composite_flush_work);
+#endif
+
     return 0;
 }
 
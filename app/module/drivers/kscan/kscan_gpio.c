@@ -19,6 +19,28 @@ void kscan_gpio_list_sort_by_port(struct kscan_gpio_list *list) {
     qsort(list->gpios, list->len, sizeof(list->gpios[0]), compare_ports);
 }
 
+size_t kscan_gpio_list_group_by_port(const struct kscan_gpio_list *list,
+                                     struct kscan_gpio_port_group *groups) {
+    size_t count = 0;
+
+    for (size_t i = 0; i < list->len; i++) {
+        const struct gpio_dt_spec *spec = &list->gpios[i].spec;
+
+        if (count == 0 || groups[count - 1].port != spec->port) {
+            groups[count++] = (struct kscan_gpio_port_group){.port = spec->port, .start = i};
+        }
+
+        struct kscan_gpio_port_group *group = &groups[count - 1];
+        group->len++;
+        group->mask |= BIT(spec->pin);
+        if ((spec->dt_flags & GPIO_ACTIVE_LOW) == 0) {
+            group->active |= BIT(spec->pin);
+        }
+    }
+
+    return count;
+}
+
 int kscan_gpio_pin_get(const struct kscan_gpio *gpio, struct kscan_gpio_port_state *state) {
     if (gpio->spec.port != state->port) {
         state->port = gpio->spec.port;
@@ -42,6 +42,30 @@ struct kscan_gpio_port_state {
  */
 void kscan_gpio_list_sort_by_port(struct kscan_gpio_list *list);
 
+/** The GPIOs of one port in a list sorted by kscan_gpio_list_sort_by_port(). */
+struct kscan_gpio_port_group {
+    const struct device *port;
+    /** Index of the port's first GPIO in the list. */
+    size_t start;
+    /** Number of the port's GPIOs in the list. */
+    size_t len;
+    /** Pins of the port's GPIOs. */
+    gpio_port_pins_t mask;
+    /** Raw pin levels with all of the port's GPIOs active. */
+    gpio_port_value_t active;
+};
+
+/**
+ * Splits a GPIO list sorted by kscan_gpio_list_sort_by_port() into one group per port.
+ *
+ * @param list The sorted list.
+ * @param groups Array with room for at least list->len groups.
+ *
+ * @return The number of groups.
+ */
+size_t kscan_gpio_list_group_by_port(const struct kscan_gpio_list *list,
+                                     struct kscan_gpio_port_group *groups);
+
 /**
  * Get logical level of an input pin.
  *
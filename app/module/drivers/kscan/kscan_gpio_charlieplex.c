@@ -5,6 +5,8 @@
  */
 
 #include <zmk/debounce.h>
+#include <zmk/kscan_poll.h>
+#include <zmk/kscan_timestamp.h>
 
 #include <zephyr/device.h>
 #include <zephyr/devicetree.h>
@@ -58,6 +60,8 @@ struct kscan_charlieplex_data {
     struct k_work_delayable work;
     int64_t scan_time; /* Timestamp of the current or scheduled scan. */
     struct gpio_callback irq_callback;
+    /** Whether every pin is known to be configured as an input. */
+    bool all_inputs;
     /**
      * Current state of the matrix as a flattened 2D array of length
      * (config->cells.length ^2)
@@ -81,6 +85,12 @@ struct kscan_charlieplex_config {
     int32_t poll_period_ms;
     bool use_interrupt;
     const struct gpio_dt_spec interrupt;
+    /**
+     * Time to wait after driving a pin before reading the others, either one value for all pins or
+     * one per pin in config->cells. NULL to use CONFIG_ZMK_KSCAN_CHARLIEPLEX_WAIT_BEFORE_INPUTS.
+     */
+    const uint16_t *settle_time_us;
+    size_t settle_time_us_len;
 };
 
 /**
@@ -120,17 +130,21 @@ static int kscan_charlieplex_set_as_output(const struct gpio_dt_spec *gpio) {
         return -ENODEV;
     }
 
-    int err = gpio_pin_configure_dt(gpio, GPIO_OUTPUT);
+    // Switch to output and drive the pin active in one call.
+    int err = gpio_pin_configure_dt(gpio, GPIO_OUTPUT_ACTIVE);
     if (err) {
         LOG_ERR("Unable to configure pin %u on %s for output", gpio->pin, gpio->port->name);
-        return err;
     }
+    return err;
+}
 
-    err = gpio_pin_set_dt(gpio, 1);
-    if (err) {
-        LOG_ERR("Failed to set output pin %u active: %i", gpio->pin, err);
+static uint32_t kscan_charlieplex_settle_time_us(const struct kscan_charlieplex_config *config,
+                                                 const int row) {
+    if (config->settle_time_us == NULL) {
+        return CONFIG_ZMK_KSCAN_CHARLIEPLEX_WAIT_BEFORE_INPUTS;
     }
-    return err;
+
+    return config->settle_time_us[config->settle_time_us_len == 1 ? 0 : row];
 }
 
 static int kscan_charlieplex_set_all_as_input(const struct device *dev) {
@@ -182,11 +196,15 @@ static int kscan_charlieplex_interrupt_configure(const struct device *dev,
 }
 
 static int kscan_charlieplex_interrupt_enable(const struct device *dev) {
+    struct kscan_charlieplex_data *data = dev->data;
+
     int err = kscan_charlieplex_interrupt_configure(dev, GPIO_INT_LEVEL_ACTIVE);
     if (err) {
         return err;
     }
 
+    data->all_inputs = false;
+
     // While interrupts are enabled, set all outputs active so an pressed key will trigger
     return kscan_charlieplex_set_all_outputs(dev, 1);
 }
@@ -219,7 +237,7 @@ static void kscan_charlieplex_read_end(const struct device *dev) {
         // Return to waiting for an interrupt.
         kscan_charlieplex_interrupt_enable(dev);
     } else {
-        data->scan_time += config->poll_period_ms;
+        data->scan_time += zmk_kscan_poll_period_ms(config->poll_period_ms);
 
         // Return to polling slowly.
         k_work_reschedule(&data->work, K_TIMEOUT_ABS_MS(data->scan_time));
@@ -232,23 +250,36 @@ static int kscan_charlieplex_read(const struct device *dev) {
     bool continue_scan = false;
 
     // NOTE: RR vs MATRIX: set all pins as input, in case there was a failure on a
-    // previous scan, and one of the pins is still set as output
-    int err = kscan_charlieplex_set_all_as_input(dev);
-    if (err) {
-        return err;
+    // previous scan, and one of the pins is still set as output, or they were all
+    // driven to wait for an interrupt. A completed scan leaves them all as inputs.
+    if (!data->all_inputs) {
+        int err = kscan_charlieplex_set_all_as_input(dev);
+        if (err) {
+            return err;
+        }
     }
 
+    // Cleared until the scan completes, so a failure part way sets them all up again next time.
+    data->all_inputs = false;
+
+    zmk_debounce_scan_begin(&config->debounce_config, config->debounce_scan_period_ms);
+
     // Scan the matrix.
     for (int row = 0; row < config->cells.len; row++) {
         const struct gpio_dt_spec *out_gpio = &config->cells.gpios[row];
-        err = kscan_charlieplex_set_as_output(out_gpio);
+        int err = kscan_charlieplex_set_as_output(out_gpio);
         if (err) {
             return err;
         }
 
-#if CONFIG_ZMK_KSCAN_CHARLIEPLEX_WAIT_BEFORE_INPUTS > 0
-        k_busy_wait(CONFIG_ZMK_KSCAN_CHARLIEPLEX_WAIT_BEFORE_INPUTS);
-#endif
+        const uint32_t settle_time_us = kscan_charlieplex_settle_time_us(config, row);
+        if (settle_time_us > 0) {
+            k_busy_wait(settle_time_us);
+        }
+
+        // Read ports once for each run of pins on them, which is usually once per row.
+        const struct device *port = NULL;
+        gpio_port_value_t port_value = 0;
 
         for (int col = 0; col < config->cells.len; col++) {
             if (col == row) {
@@ -257,9 +288,18 @@ static int kscan_charlieplex_read(const struct device *dev) {
             const struct gpio_dt_spec *in_gpio = &config->cells.gpios[col];
             const int index = state_index(config, row, col);
 
+            if (in_gpio->port != port) {
+                port = in_gpio->port;
+                err = gpio_port_get(port, &port_value);
+                if (err) {
+                    LOG_ERR("Failed to read port %s: %i", port->name, err);
+                    return err;
+                }
+            }
+
             struct zmk_debounce_state *state = &data->charlieplex_state[index];
-            zmk_debounce_update(state, gpio_pin_get_dt(in_gpio), config->debounce_scan_period_ms,
-                                &config->debounce_config);
+            zmk_debounce_update(state, (port_value & BIT(in_gpio->pin)) != 0,
+                                config->debounce_scan_period_ms, &config->debounce_config);
 
             // NOTE: RR vs MATRIX: because we don't need an input/output => row/column
             // setup, we can update in the same loop.
@@ -267,6 +307,7 @@ static int kscan_charlieplex_read(const struct device *dev) {
                 const bool pressed = zmk_debounce_is_pressed(state);
 
                 LOG_DBG("Sending event at %i,%i state %s", row, col, pressed ? "on" : "off");
+                zmk_kscan_set_event_timestamp(data->scan_time);
                 data->callback(dev, row, col, pressed);
             }
             continue_scan = continue_scan || zmk_debounce_is_active(state);
@@ -281,6 +322,10 @@ static int kscan_charlieplex_read(const struct device *dev) {
 #endif
     }
 
+    zmk_debounce_scan_end(&config->debounce_config);
+
+    data->all_inputs = true;
+
     if (continue_scan) {
         // At least one key is pressed or the debouncer has not yet decided if
         // it is pressed. Poll quickly until everything is released.
@@ -388,20 +433,34 @@ static const struct kscan_driver_api kscan_charlieplex_api = {
                  "ZMK_KSCAN_DEBOUNCE_RELEASE_MS or debounce-release-ms is too large");             \
                                                                                                    \
     static struct zmk_debounce_state kscan_charlieplex_state_##n[INST_CHARLIEPLEX_LEN(n)];         \
+    static struct zmk_debounce_global kscan_charlieplex_debounce_global_##n;                       \
     static const struct gpio_dt_spec kscan_charlieplex_cells_##n[] = {                             \
         LISTIFY(INST_LEN(n), KSCAN_GPIO_CFG_INIT, (, ), n)};                                       \
     static struct kscan_charlieplex_data kscan_charlieplex_data_##n = {                            \
         .charlieplex_state = kscan_charlieplex_state_##n,                                          \
     };                                                                                             \
                                                                                                    \
+    BUILD_ASSERT(DT_INST_PROP_LEN_OR(n, settle_time_us, 1) == 1 ||                                 \
+                     DT_INST_PROP_LEN_OR(n, settle_time_us, 1) == INST_LEN(n),                     \
+                 "settle-time-us must have one value, or one for each of gpios");                  \
+    COND_CODE_1(DT_INST_NODE_HAS_PROP(n, settle_time_us),                                          \
+                (static const uint16_t kscan_charlieplex_settle_##n[] =                            \
+                     DT_INST_PROP(n, settle_time_us);),                                            \
+                ())                                                                                \
+                                                                                                   \
     static struct kscan_charlieplex_config kscan_charlieplex_config_##n = {                        \
         .cells = KSCAN_GPIO_LIST(kscan_charlieplex_cells_##n),                                     \
         .debounce_config =                                                                         \
             {                                                                                      \
                 .debounce_press_ms = INST_DEBOUNCE_PRESS_MS(n),                                    \
                 .debounce_release_ms = INST_DEBOUNCE_RELEASE_MS(n),                                \
+                .algorithm = DT_INST_ENUM_IDX(n, debounce_algorithm),                              \
+                .global = &kscan_charlieplex_debounce_global_##n,                                  \
             },                                                                                     \
         .debounce_scan_period_ms = DT_INST_PROP(n, debounce_scan_period_ms),                       \
+        .settle_time_us = COND_CODE_1(DT_INST_NODE_HAS_PROP(n, settle_time_us),                    \
+                                      (kscan_charlieplex_settle_##n), (NULL)),                     \
+        .settle_time_us_len = DT_INST_PROP_LEN_OR(n, settle_time_us, 0),                           \
         COND_ANY_POLLING((.poll_period_ms = DT_INST_PROP(n, poll_period_ms), ))                    \
             COND_THIS_INTERRUPT(n, (.use_interrupt = INST_INTR_DEFINED(n), ))                      \
                 COND_THIS_INTERRUPT(n, (.interrupt = KSCAN_INTR_CFG_INIT(n), ))};                  \
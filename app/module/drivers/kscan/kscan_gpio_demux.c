@@ -4,206 +4,461 @@
  * SPDX-License-Identifier: MIT
  */
 
-#define DT_DRV_COMPAT zmk_kscan_gpio_demux
+#include "kscan_gpio.h"
 
 #include <zephyr/device.h>
-#include <zephyr/drivers/kscan.h>
+#include <zephyr/devicetree.h>
 #include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/kscan.h>
+#include <zephyr/pm/device.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+#include <zmk/debounce.h>
+#include <zmk/kscan_poll.h>
+#include <zmk/kscan_timestamp.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
-// Helper macro
-#define PWR_TWO(x) (1 << (x))
+#define DT_DRV_COMPAT zmk_kscan_gpio_demux
 
-// Define row and col cfg
-#define _KSCAN_GPIO_CFG_INIT(n, prop, idx) GPIO_DT_SPEC_GET_BY_IDX(n, prop, idx),
+#define INST_INPUTS_LEN(n) DT_INST_PROP_LEN(n, input_gpios)
+#define INST_ADDRESS_LEN(n) DT_INST_PROP_LEN(n, output_gpios)
+#define INST_OUTPUTS_LEN(n) BIT(INST_ADDRESS_LEN(n))
 
-// Check debounce config
-#define CHECK_DEBOUNCE_CFG(n, a, b) COND_CODE_0(DT_INST_PROP(n, debounce_period), a, b)
+// Inputs are debounced in groups of this many, with one set of groups per output.
+#define INPUT_WORD_BITS 32
+#define INST_INPUT_WORDS(n) DIV_ROUND_UP(INST_INPUTS_LEN(n), INPUT_WORD_BITS)
 
-// Define the row and column lengths
-#define INST_MATRIX_INPUTS(n) DT_INST_PROP_LEN(n, input_gpios)
-#define INST_DEMUX_GPIOS(n) DT_INST_PROP_LEN(n, output_gpios)
-#define INST_MATRIX_OUTPUTS(n) PWR_TWO(INST_DEMUX_GPIOS(n))
-#define POLL_INTERVAL(n) DT_INST_PROP(n, polling_interval_msec)
+#if CONFIG_ZMK_KSCAN_DEBOUNCE_PRESS_MS >= 0
+#define INST_DEBOUNCE_PRESS_MS(n) CONFIG_ZMK_KSCAN_DEBOUNCE_PRESS_MS
+#else
+#define INST_DEBOUNCE_PRESS_MS(n)                                                                  \
+    DT_INST_PROP_OR(n, debounce_period, DT_INST_PROP(n, debounce_press_ms))
+#endif
 
-#define GPIO_INST_INIT(n)                                                                          \
-    struct kscan_gpio_irq_callback_##n {                                                           \
-        struct CHECK_DEBOUNCE_CFG(n, (k_work), (k_work_delayable)) * work;                         \
-        struct gpio_callback callback;                                                             \
-        const struct device *dev;                                                                  \
-    };                                                                                             \
-                                                                                                   \
-    struct kscan_gpio_config_##n {                                                                 \
-        const struct gpio_dt_spec rows[INST_MATRIX_INPUTS(n)];                                     \
-        const struct gpio_dt_spec cols[INST_DEMUX_GPIOS(n)];                                       \
-    };                                                                                             \
-                                                                                                   \
-    struct kscan_gpio_data_##n {                                                                   \
-        kscan_callback_t callback;                                                                 \
-        struct k_timer poll_timer;                                                                 \
-        struct CHECK_DEBOUNCE_CFG(n, (k_work), (k_work_delayable)) work;                           \
-        bool matrix_state[INST_MATRIX_INPUTS(n)][INST_MATRIX_OUTPUTS(n)];                          \
-        const struct device *dev;                                                                  \
-    };                                                                                             \
-    /* IO/GPIO SETUP */                                                                            \
-    static const struct gpio_dt_spec *kscan_gpio_input_specs_##n(const struct device *dev) {       \
-        const struct kscan_gpio_config_##n *cfg = dev->config;                                     \
-        return cfg->rows;                                                                          \
-    }                                                                                              \
-                                                                                                   \
-    static const struct gpio_dt_spec *kscan_gpio_output_specs_##n(const struct device *dev) {      \
-        const struct kscan_gpio_config_##n *cfg = dev->config;                                     \
-        return cfg->cols;                                                                          \
-    }                                                                                              \
-    /* POLLING SETUP */                                                                            \
-    static void kscan_gpio_timer_handler(struct k_timer *timer) {                                  \
-        struct kscan_gpio_data_##n *data =                                                         \
-            CONTAINER_OF(timer, struct kscan_gpio_data_##n, poll_timer);                           \
-        k_work_submit(&data->work.work);                                                           \
-    }                                                                                              \
-                                                                                                   \
-    /* Read the state of the input GPIOs */                                                        \
-    /* This is the core matrix_scan func */                                                        \
-    static int kscan_gpio_read_##n(const struct device *dev) {                                     \
-        bool submit_follow_up_read = false;                                                        \
-        struct kscan_gpio_data_##n *data = dev->data;                                              \
-        static bool read_state[INST_MATRIX_INPUTS(n)][INST_MATRIX_OUTPUTS(n)];                     \
-        for (int o = 0; o < INST_MATRIX_OUTPUTS(n); o++) {                                         \
-            /* Iterate over bits and set GPIOs accordingly */                                      \
-            for (uint8_t bit = 0; bit < INST_DEMUX_GPIOS(n); bit++) {                              \
-                uint8_t state = (o & (0b1 << bit)) >> bit;                                         \
-                const struct gpio_dt_spec *out_spec = &kscan_gpio_output_specs_##n(dev)[bit];      \
-                gpio_pin_set_dt(out_spec, state);                                                  \
-            }                                                                                      \
-            /* Let the col settle before reading the rows */                                       \
-            k_usleep(1);                                                                           \
-                                                                                                   \
-            for (int i = 0; i < INST_MATRIX_INPUTS(n); i++) {                                      \
-                /* Get the input spec */                                                           \
-                const struct gpio_dt_spec *in_spec = &kscan_gpio_input_specs_##n(dev)[i];          \
-                read_state[i][o] = gpio_pin_get_dt(in_spec) > 0;                                   \
-            }                                                                                      \
-        }                                                                                          \
-        for (int r = 0; r < INST_MATRIX_INPUTS(n); r++) {                                          \
-            for (int c = 0; c < INST_MATRIX_OUTPUTS(n); c++) {                                     \
-                bool pressed = read_state[r][c];                                                   \
-                submit_follow_up_read = (submit_follow_up_read || pressed);                        \
-                if (pressed != data->matrix_state[r][c]) {                                         \
-                    LOG_DBG("Sending event at %d,%d state %s", r, c, (pressed ? "on" : "off"));    \
-                    data->matrix_state[r][c] = pressed;                                            \
-                    data->callback(dev, r, c, pressed);                                            \
-                }                                                                                  \
-            }                                                                                      \
-        }                                                                                          \
-        if (submit_follow_up_read) {                                                               \
-            CHECK_DEBOUNCE_CFG(n, ({ k_work_submit(&data->work); }),                               \
-                               ({ k_work_reschedule(&data->work, K_MSEC(5)); }))                   \
-        }                                                                                          \
-        return 0;                                                                                  \
-    }                                                                                              \
+#if CONFIG_ZMK_KSCAN_DEBOUNCE_RELEASE_MS >= 0
+#define INST_DEBOUNCE_RELEASE_MS(n) CONFIG_ZMK_KSCAN_DEBOUNCE_RELEASE_MS
+#else
+#define INST_DEBOUNCE_RELEASE_MS(n)                                                                \
+    DT_INST_PROP_OR(n, debounce_period, DT_INST_PROP(n, debounce_release_ms))
+#endif
+
+#define INST_POLL_PERIOD_MS(n)                                                                     \
+    DT_INST_PROP_OR(n, polling_interval_msec, DT_INST_PROP(n, poll_period_ms))
+
+#define INST_INTR_DEFINED(n) DT_INST_NODE_HAS_PROP(n, interrupt_gpios)
+
+#define KSCAN_GPIO_INPUT_CFG_INIT(idx, inst_idx)                                                   \
+    KSCAN_GPIO_GET_BY_IDX(DT_DRV_INST(inst_idx), input_gpios, idx)
+#define KSCAN_GPIO_ADDRESS_CFG_INIT(idx, inst_idx)                                                 \
+    KSCAN_GPIO_GET_BY_IDX(DT_DRV_INST(inst_idx), output_gpios, idx)
+
+struct kscan_demux_data {
+    const struct device *dev;
+    struct kscan_gpio_list inputs;
+    struct kscan_gpio_list address;
+    kscan_callback_t callback;
+    struct k_work_delayable work;
+    struct gpio_callback irq_callback;
+    /**
+     * Arrays of length inputs.len and address.len, of which the first input_ports_len and
+     * address_ports_len entries are used.
+     */
+    struct kscan_gpio_port_group *input_ports;
+    struct kscan_gpio_port_group *address_ports;
+    size_t input_ports_len;
+    size_t address_ports_len;
+    /** Timestamp of the current or scheduled scan. */
+    int64_t scan_time;
+    /**
+     * Current state of the keys as a flattened 2D array of debounce groups of length
+     * (config->outputs * input_words). Bit j of group w for an output is input
+     * (w * INPUT_WORD_BITS + j) of data->inputs.
+     */
+    struct zmk_debounce_group *state;
+    size_t input_words;
+};
+
+struct kscan_demux_config {
+    /** Number of demultiplexer outputs, which is 2 to the power of the number of address GPIOs. */
+    size_t outputs;
+    struct zmk_debounce_config debounce_config;
+    int32_t debounce_scan_period_ms;
+    int32_t poll_period_ms;
+    bool use_interrupt;
+    const struct gpio_dt_spec interrupt;
+};
+
+/**
+ * Get the debounce groups for the inputs of a demultiplexer output.
+ */
+static struct zmk_debounce_group *output_state(const struct device *dev, const int output) {
+    const struct kscan_demux_data *data = dev->data;
+
+    return &data->state[output * data->input_words];
+}
+
+/**
+ * Get the raw level of a pin's bit in a port for a logical value.
+ */
+static gpio_port_value_t kscan_demux_raw_value(const struct gpio_dt_spec *gpio, const int value) {
+    const bool active_low = (gpio->dt_flags & GPIO_ACTIVE_LOW) != 0;
+    return (value != 0) != active_low ? BIT(gpio->pin) : 0;
+}
+
+/**
+ * Select a demultiplexer output, writing each port of address GPIOs once.
+ */
+static int kscan_demux_select_output(const struct device *dev, const int output) {
+    const struct kscan_demux_data *data = dev->data;
+
+    for (int i = 0; i < data->address_ports_len; i++) {
+        const struct kscan_gpio_port_group *group = &data->address_ports[i];
+        gpio_port_value_t value = 0;
+
+        for (int j = group->start; j < group->start + group->len; j++) {
+            const struct kscan_gpio *gpio = &data->address.gpios[j];
+
+            value |= kscan_demux_raw_value(&gpio->spec, output & BIT(gpio->index));
+        }
+
+        int err = gpio_port_set_masked_raw(group->port, group->mask, value);
+        if (err) {
+            LOG_ERR("Failed to set address on %s: %i", group->port->name, err);
+            return err;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Read all inputs while one output is selected, and update their debounce states.
+ */
+static int kscan_demux_read_inputs(const struct device *dev, const int output) {
+    const struct kscan_demux_data *data = dev->data;
+    const struct kscan_demux_config *config = dev->config;
+    struct zmk_debounce_group *groups = output_state(dev, output);
+    uint32_t word = 0;
+
+    for (int i = 0; i < data->input_ports_len; i++) {
+        const struct kscan_gpio_port_group *group = &data->input_ports[i];
+
+        gpio_port_value_t value;
+        int err = gpio_port_get(group->port, &value);
+        if (err) {
+            LOG_ERR("Failed to read port %s: %i", group->port->name, err);
+            return err;
+        }
+
+        for (int j = group->start; j < group->start + group->len; j++) {
+            const int bit = j % INPUT_WORD_BITS;
+
+            WRITE_BIT(word, bit, (value & BIT(data->inputs.gpios[j].spec.pin)) != 0);
+
+            if (bit == INPUT_WORD_BITS - 1 || j == data->inputs.len - 1) {
+                zmk_debounce_group_update(&groups[j / INPUT_WORD_BITS], word,
+                                          config->debounce_scan_period_ms,
+                                          &config->debounce_config);
+                word = 0;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int kscan_demux_interrupt_configure(const struct device *dev, const gpio_flags_t flags) {
+    const struct kscan_demux_config *config = dev->config;
+
+    int err = gpio_pin_interrupt_configure_dt(&config->interrupt, flags);
+    if (err) {
+        LOG_ERR("Unable to configure interrupt for pin %u on %s", config->interrupt.pin,
+                config->interrupt.port->name);
+    }
+
+    return err;
+}
+
+static void kscan_demux_irq_callback(const struct device *port, struct gpio_callback *cb,
+                                     const gpio_port_pins_t pin) {
+    struct kscan_demux_data *data = CONTAINER_OF(cb, struct kscan_demux_data, irq_callback);
+
+    // Disable our interrupt to avoid re-entry while we scan.
+    kscan_demux_interrupt_configure(data->dev, GPIO_INT_DISABLE);
+    data->scan_time = k_uptime_get();
+    k_work_reschedule(&data->work, K_NO_WAIT);
+}
+
+static void kscan_demux_read_continue(const struct device *dev) {
+    const struct kscan_demux_config *config = dev->config;
+    struct kscan_demux_data *data = dev->data;
+
+    data->scan_time += config->debounce_scan_period_ms;
+
+    k_work_reschedule(&data->work, K_TIMEOUT_ABS_MS(data->scan_time));
+}
+
+static void kscan_demux_read_end(const struct device *dev) {
+    const struct kscan_demux_config *config = dev->config;
+    struct kscan_demux_data *data = dev->data;
+
+    if (config->use_interrupt) {
+        // Return to waiting for an interrupt.
+        kscan_demux_interrupt_configure(dev, GPIO_INT_LEVEL_ACTIVE);
+    } else {
+        data->scan_time += zmk_kscan_poll_period_ms(config->poll_period_ms);
+
+        // Return to polling slowly.
+        k_work_reschedule(&data->work, K_TIMEOUT_ABS_MS(data->scan_time));
+    }
+}
+
+static int kscan_demux_read(const struct device *dev) {
+    struct kscan_demux_data *data = dev->data;
+    const struct kscan_demux_config *config = dev->config;
+
+    zmk_debounce_scan_begin(&config->debounce_config, config->debounce_scan_period_ms);
+
+    // Step through the outputs in Gray code order, so only one address GPIO changes each time.
+    for (int i = 0; i < config->outputs; i++) {
+        const int output = i ^ (i >> 1);
+
+        int err = kscan_demux_select_output(dev, output);
+        if (err) {
+            return err;
+        }
+
+#if CONFIG_ZMK_KSCAN_DEMUX_WAIT_BEFORE_INPUTS > 0
+        k_busy_wait(CONFIG_ZMK_KSCAN_DEMUX_WAIT_BEFORE_INPUTS);
+#endif
+        err = kscan_demux_read_inputs(dev, output);
+        if (err) {
+            return err;
+        }
+    }
+
+    zmk_debounce_scan_end(&config->debounce_config);
+
+    // Process the new state.
+    bool continue_scan = false;
+
+    for (int o = 0; o < config->outputs; o++) {
+        const struct zmk_debounce_group *groups = output_state(dev, o);
+
+        for (int w = 0; w < data->input_words; w++) {
+            const struct zmk_debounce_group *group = &groups[w];
+
+            // Only visit the inputs that changed, which usually means none at all.
+            uint32_t changed = zmk_debounce_group_get_changed(group);
+
+            while (changed != 0) {
+                const int bit = u32_count_trailing_zeros(changed);
+                changed &= changed - 1;
+
+                const int r = data->inputs.gpios[w * INPUT_WORD_BITS + bit].index;
+                const bool pressed = (zmk_debounce_group_get_pressed(group) & BIT(bit)) != 0;
+
+                LOG_DBG("Sending event at %i,%i state %s", r, o, pressed ? "on" : "off");
+                zmk_kscan_set_event_timestamp(data->scan_time);
+                data->callback(dev, r, o, pressed);
+            }
+
+            continue_scan = continue_scan || zmk_debounce_group_get_active(group) != 0;
+        }
+    }
+
+    if (continue_scan) {
+        // At least one key is pressed or the debouncer has not yet decided if
+        // it is pressed. Poll quickly until everything is released.
+        kscan_demux_read_continue(dev);
+    } else {
+        // All keys are released. Return to normal.
+        kscan_demux_read_end(dev);
+    }
+
+    return 0;
+}
+
+static void kscan_demux_work_handler(struct k_work *work) {
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct kscan_demux_data *data = CONTAINER_OF(dwork, struct kscan_demux_data, work);
+    kscan_demux_read(data->dev);
+}
+
+static int kscan_demux_configure(const struct device *dev, const kscan_callback_t callback) {
+    struct kscan_demux_data *data = dev->data;
+
+    if (!callback) {
+        return -EINVAL;
+    }
+
+    data->callback = callback;
+    return 0;
+}
+
+static int kscan_demux_enable(const struct device *dev) {
+    struct kscan_demux_data *data = dev->data;
+
+    data->scan_time = k_uptime_get();
+
+    // Read will automatically start interrupts/polling once done.
+    return kscan_demux_read(dev);
+}
+
+static int kscan_demux_disable(const struct device *dev) {
+    struct kscan_demux_data *data = dev->data;
+    const struct kscan_demux_config *config = dev->config;
+
+    k_work_cancel_delayable(&data->work);
+
+    if (config->use_interrupt) {
+        return kscan_demux_interrupt_configure(dev, GPIO_INT_DISABLE);
+    }
+
+    return 0;
+}
+
+static int kscan_demux_init_gpio(const struct gpio_dt_spec *gpio, const gpio_flags_t flags) {
+    if (!device_is_ready(gpio->port)) {
+        LOG_ERR("GPIO is not ready: %s", gpio->port->name);
+        return -ENODEV;
+    }
+
+    int err = gpio_pin_configure_dt(gpio, flags);
+    if (err) {
+        LOG_ERR("Unable to configure pin %u on %s: %i", gpio->pin, gpio->port->name, err);
+        return err;
+    }
+
+    return 0;
+}
+
+static int kscan_demux_init_list(const struct kscan_gpio_list *list, const gpio_flags_t flags) {
+    for (int i = 0; i < list->len; i++) {
+        int err = kscan_demux_init_gpio(&list->gpios[i].spec, flags);
+        if (err) {
+            return err;
+        }
+    }
+
+    return 0;
+}
+
+static int kscan_demux_init_interrupt(const struct device *dev) {
+    struct kscan_demux_data *data = dev->data;
+    const struct kscan_demux_config *config = dev->config;
+    const struct gpio_dt_spec *gpio = &config->interrupt;
+
+    int err = kscan_demux_init_gpio(gpio, GPIO_INPUT);
+    if (err) {
+        return err;
+    }
+
+    gpio_init_callback(&data->irq_callback, kscan_demux_irq_callback, BIT(gpio->pin));
+    err = gpio_add_callback(gpio->port, &data->irq_callback);
+    if (err) {
+        LOG_ERR("Error adding the callback to the interrupt device: %i", err);
+    }
+
+    return err;
+}
+
+static int kscan_demux_init(const struct device *dev) {
+    struct kscan_demux_data *data = dev->data;
+    const struct kscan_demux_config *config = dev->config;
+
+    data->dev = dev;
+
+    // Sort the GPIOs by port so each scan step reads and writes every port just once.
+    kscan_gpio_list_sort_by_port(&data->inputs);
+    kscan_gpio_list_sort_by_port(&data->address);
+
+    data->input_ports_len = kscan_gpio_list_group_by_port(&data->inputs, data->input_ports);
+    data->address_ports_len = kscan_gpio_list_group_by_port(&data->address, data->address_ports);
+
+    kscan_demux_init_list(&data->inputs, GPIO_INPUT);
+    kscan_demux_init_list(&data->address, GPIO_OUTPUT_INACTIVE);
+
+    if (config->use_interrupt) {
+        kscan_demux_init_interrupt(dev);
+    }
+
+    k_work_init_delayable(&data->work, kscan_demux_work_handler);
+
+    return 0;
+}
+
+#if IS_ENABLED(CONFIG_PM_DEVICE)
+
+static int kscan_demux_pm_action(const struct device *dev, enum pm_device_action action) {
+    switch (action) {
+    case PM_DEVICE_ACTION_SUSPEND:
+        return kscan_demux_disable(dev);
+    case PM_DEVICE_ACTION_RESUME:
+        return kscan_demux_enable(dev);
+    default:
+        return -ENOTSUP;
+    }
+}
+
+#endif // IS_ENABLED(CONFIG_PM_DEVICE)
+
+static const struct kscan_driver_api kscan_demux_api = {
+    .config = kscan_demux_configure,
+    .enable_callback = kscan_demux_enable,
+    .disable_callback = kscan_demux_disable,
+};
+
+#define KSCAN_DEMUX_INIT(n)                                                                        \
+    BUILD_ASSERT(INST_DEBOUNCE_PRESS_MS(n) <= DEBOUNCE_COUNTER_MAX,                                \
+                 "ZMK_KSCAN_DEBOUNCE_PRESS_MS or debounce-press-ms is too large");                 \
+    BUILD_ASSERT(INST_DEBOUNCE_RELEASE_MS(n) <= DEBOUNCE_COUNTER_MAX,                              \
+                 "ZMK_KSCAN_DEBOUNCE_RELEASE_MS or debounce-release-ms is too large");             \
                                                                                                    \
-    static void kscan_gpio_work_handler_##n(struct k_work *work) {                                 \
-        struct k_work_delayable *d_work = k_work_delayable_from_work(work);                        \
-        struct kscan_gpio_data_##n *data = CONTAINER_OF(d_work, struct kscan_gpio_data_##n, work); \
-        kscan_gpio_read_##n(data->dev);                                                            \
-    }                                                                                              \
+    static struct kscan_gpio kscan_demux_inputs_##n[] = {                                          \
+        LISTIFY(INST_INPUTS_LEN(n), KSCAN_GPIO_INPUT_CFG_INIT, (, ), n)};                          \
                                                                                                    \
-    static struct kscan_gpio_data_##n kscan_gpio_data_##n = {};                                    \
+    static struct kscan_gpio kscan_demux_address_##n[] = {                                         \
+        LISTIFY(INST_ADDRESS_LEN(n), KSCAN_GPIO_ADDRESS_CFG_INIT, (, ), n)};                       \
                                                                                                    \
-    /* KSCAN API configure function */                                                             \
-    static int kscan_gpio_configure_##n(const struct device *dev, kscan_callback_t callback) {     \
-        LOG_DBG("KSCAN API configure");                                                            \
-        struct kscan_gpio_data_##n *data = dev->data;                                              \
-        if (!callback) {                                                                           \
-            return -EINVAL;                                                                        \
-        }                                                                                          \
-        data->callback = callback;                                                                 \
-        LOG_DBG("Configured GPIO %d", n);                                                          \
-        return 0;                                                                                  \
-    };                                                                                             \
+    static struct kscan_gpio_port_group kscan_demux_input_ports_##n[INST_INPUTS_LEN(n)];           \
+    static struct kscan_gpio_port_group kscan_demux_address_ports_##n[INST_ADDRESS_LEN(n)];        \
                                                                                                    \
-    /* KSCAN API enable function */                                                                \
-    static int kscan_gpio_enable_##n(const struct device *dev) {                                   \
-        LOG_DBG("KSCAN API enable");                                                               \
-        struct kscan_gpio_data_##n *data = dev->data;                                              \
-        /* TODO: we might want a follow up to hook into the sleep state hooks in Zephyr, */        \
-        /* and disable this timer when we enter a sleep state */                                   \
-        k_timer_start(&data->poll_timer, K_MSEC(POLL_INTERVAL(n)), K_MSEC(POLL_INTERVAL(n)));      \
-        return 0;                                                                                  \
-    };                                                                                             \
+    static struct zmk_debounce_group                                                               \
+        kscan_demux_state_##n[INST_OUTPUTS_LEN(n) * INST_INPUT_WORDS(n)];                          \
+    static struct zmk_debounce_global kscan_demux_debounce_global_##n;                             \
                                                                                                    \
-    /* KSCAN API disable function */                                                               \
-    static int kscan_gpio_disable_##n(const struct device *dev) {                                  \
-        LOG_DBG("KSCAN API disable");                                                              \
-        struct kscan_gpio_data_##n *data = dev->data;                                              \
-        k_timer_stop(&data->poll_timer);                                                           \
-        return 0;                                                                                  \
+    static struct kscan_demux_data kscan_demux_data_##n = {                                        \
+        .inputs = KSCAN_GPIO_LIST(kscan_demux_inputs_##n),                                         \
+        .address = KSCAN_GPIO_LIST(kscan_demux_address_##n),                                       \
+        .input_ports = kscan_demux_input_ports_##n,                                                \
+        .address_ports = kscan_demux_address_ports_##n,                                            \
+        .state = kscan_demux_state_##n,                                                            \
+        .input_words = INST_INPUT_WORDS(n),                                                        \
     };                                                                                             \
                                                                                                    \
-    /* GPIO init function*/                                                                        \
-    static int kscan_gpio_init_##n(const struct device *dev) {                                     \
-        LOG_DBG("KSCAN GPIO init");                                                                \
-        struct kscan_gpio_data_##n *data = dev->data;                                              \
-        int err;                                                                                   \
-        /* configure input devices*/                                                               \
-        for (int i = 0; i < INST_MATRIX_INPUTS(n); i++) {                                          \
-            const struct gpio_dt_spec *in_spec = &kscan_gpio_input_specs_##n(dev)[i];              \
-            if (!device_is_ready(in_spec->port)) {                                                 \
-                LOG_ERR("Unable to find input GPIO device");                                       \
-                return -EINVAL;                                                                    \
-            }                                                                                      \
-            err = gpio_pin_configure_dt(in_spec, GPIO_INPUT);                                      \
-            if (err) {                                                                             \
-                LOG_ERR("Unable to configure pin %d for input", in_spec->pin);                     \
-                return err;                                                                        \
-            } else {                                                                               \
-                LOG_DBG("Configured pin %d for input", in_spec->pin);                              \
-            }                                                                                      \
-            if (err) {                                                                             \
-                LOG_ERR("Error adding the callback to the column device");                         \
-                return err;                                                                        \
-            }                                                                                      \
-        }                                                                                          \
-        /* configure output devices*/                                                              \
-        for (int o = 0; o < INST_DEMUX_GPIOS(n); o++) {                                            \
-            const struct gpio_dt_spec *out_spec = &kscan_gpio_output_specs_##n(dev)[o];            \
-            if (!device_is_ready(out_spec->port)) {                                                \
-                LOG_ERR("Unable to find output GPIO device");                                      \
-                return -EINVAL;                                                                    \
-            }                                                                                      \
-            err = gpio_pin_configure_dt(out_spec, GPIO_OUTPUT_ACTIVE);                             \
-            if (err) {                                                                             \
-                LOG_ERR("Unable to configure pin %d for output", out_spec->pin);                   \
-                return err;                                                                        \
-            } else {                                                                               \
-                LOG_DBG("Configured pin %d for output", out_spec->pin);                            \
-            }                                                                                      \
-        }                                                                                          \
-        data->dev = dev;                                                                           \
-                                                                                                   \
-        k_timer_init(&data->poll_timer, kscan_gpio_timer_handler, NULL);                           \
-                                                                                                   \
-        (CHECK_DEBOUNCE_CFG(n, (k_work_init), (k_work_init_delayable)))(                           \
-            &data->work, kscan_gpio_work_handler_##n);                                             \
-        return 0;                                                                                  \
-    }                                                                                              \
+    static const struct kscan_demux_config kscan_demux_config_##n = {                              \
+        .outputs = INST_OUTPUTS_LEN(n),                                                            \
+        .debounce_config =                                                                         \
+            {                                                                                      \
+                .debounce_press_ms = INST_DEBOUNCE_PRESS_MS(n),                                    \
+                .debounce_release_ms = INST_DEBOUNCE_RELEASE_MS(n),                                \
+                .algorithm = DT_INST_ENUM_IDX(n, debounce_algorithm),                              \
+                .global = &kscan_demux_debounce_global_##n,                                        \
+            },                                                                                     \
+        .debounce_scan_period_ms = DT_INST_PROP(n, debounce_scan_period_ms),                       \
+        .poll_period_ms = INST_POLL_PERIOD_MS(n),                                                  \
+        .use_interrupt = INST_INTR_DEFINED(n),                                                     \
+        COND_CODE_1(INST_INTR_DEFINED(n),                                                          \
+                    (.interrupt = GPIO_DT_SPEC_INST_GET(n, interrupt_gpios), ), ())};              \
                                                                                                    \
-    static const struct kscan_driver_api gpio_driver_api_##n = {                                   \
-        .config = kscan_gpio_configure_##n,                                                        \
-        .enable_callback = kscan_gpio_enable_##n,                                                  \
-        .disable_callback = kscan_gpio_disable_##n,                                                \
-    };                                                                                             \
-                                                                                                   \
-    static const struct kscan_gpio_config_##n kscan_gpio_config_##n = {                            \
-        .rows = {DT_FOREACH_PROP_ELEM(DT_DRV_INST(n), input_gpios, _KSCAN_GPIO_CFG_INIT)},         \
-        .cols = {DT_FOREACH_PROP_ELEM(DT_DRV_INST(n), output_gpios, _KSCAN_GPIO_CFG_INIT)},        \
-    };                                                                                             \
+    PM_DEVICE_DT_INST_DEFINE(n, kscan_demux_pm_action);                                            \
                                                                                                    \
-    DEVICE_DT_INST_DEFINE(n, kscan_gpio_init_##n, NULL, &kscan_gpio_data_##n,                      \
-                          &kscan_gpio_config_##n, POST_KERNEL, CONFIG_KSCAN_INIT_PRIORITY,         \
-                          &gpio_driver_api_##n);
+    DEVICE_DT_INST_DEFINE(n, &kscan_demux_init, PM_DEVICE_DT_INST_GET(n), &kscan_demux_data_##n,   \
+                          &kscan_demux_config_##n, POST_KERNEL, CONFIG_KSCAN_INIT_PRIORITY,        \
+                          &kscan_demux_api);
 
-DT_INST_FOREACH_STATUS_OKAY(GPIO_INST_INIT)
+DT_INST_FOREACH_STATUS_OKAY(KSCAN_DEMUX_INIT);
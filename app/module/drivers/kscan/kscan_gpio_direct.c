@@ -16,6 +16,8 @@
 #include <zephyr/sys/util.h>
 
 #include <zmk/debounce.h>
+#include <zmk/kscan_poll.h>
+#include <zmk/kscan_timestamp.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
@@ -42,6 +44,10 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 #define COND_POLL_OR_INTERRUPTS(pollcode, intcode)                                                 \
     COND_CODE_1(CONFIG_ZMK_KSCAN_DIRECT_POLLING, pollcode, intcode)
 
+#define USE_PORT_BATCHED IS_ENABLED(CONFIG_ZMK_KSCAN_DIRECT_PORT_BATCHED)
+
+#define COND_PORT_BATCHED(code) COND_CODE_1(CONFIG_ZMK_KSCAN_DIRECT_PORT_BATCHED, code, ())
+
 #define INST_INPUTS_LEN(n)                                                                         \
     COND_CODE_1(DT_INST_NODE_HAS_PROP(n, input_gpios), (DT_INST_PROP_LEN(n, input_gpios)),         \
                 (DT_INST_PROP_LEN(n, input_keys)))
@@ -62,8 +68,16 @@ struct kscan_direct_data {
     kscan_callback_t callback;
     struct k_work_delayable work;
 #if USE_INTERRUPTS
-    /** Array of length config->inputs.len */
+    /**
+     * Array of length config->inputs.len, with one callback per input, or per port group with
+     * CONFIG_ZMK_KSCAN_DIRECT_PORT_BATCHED.
+     */
     struct kscan_direct_irq_callback *irqs;
+#endif
+#if USE_PORT_BATCHED
+    /** Array of length config->inputs.len, of which the first input_ports_len entries are used. */
+    struct kscan_gpio_port_group *input_ports;
+    size_t input_ports_len;
 #endif
     /** Timestamp of the current or scheduled scan. */
     int64_t scan_time;
@@ -166,7 +180,7 @@ static void kscan_direct_read_end(const struct device *dev) {
     struct kscan_direct_data *data = dev->data;
     const struct kscan_direct_config *config = dev->config;
 
-    data->scan_time += config->poll_period_ms;
+    data->scan_time += zmk_kscan_poll_period_ms(config->poll_period_ms);
 
     // Return to polling slowly.
     k_work_reschedule(&data->work, K_TIMEOUT_ABS_MS(data->scan_time));
@@ -177,7 +191,31 @@ static int kscan_direct_read(const struct device *dev) {
     struct kscan_direct_data *data = dev->data;
     const struct kscan_direct_config *config = dev->config;
 
+    zmk_debounce_scan_begin(&config->debounce_config, config->debounce_scan_period_ms);
+
     // Read the inputs.
+#if USE_PORT_BATCHED
+    for (int i = 0; i < data->input_ports_len; i++) {
+        const struct kscan_gpio_port_group *group = &data->input_ports[i];
+
+        gpio_port_value_t value;
+        int err = gpio_port_get_raw(group->port, &value);
+        if (err) {
+            LOG_ERR("Failed to read port %s: %i", group->port->name, err);
+            return err;
+        }
+
+        // A pin is active when its raw level matches its level with the input active.
+        const gpio_port_value_t active = ~(value ^ group->active);
+
+        for (int j = group->start; j < group->start + group->len; j++) {
+            const struct kscan_gpio *gpio = &data->inputs.gpios[j];
+
+            zmk_debounce_update(&data->pin_state[gpio->index], (active & BIT(gpio->spec.pin)) != 0,
+                                config->debounce_scan_period_ms, &config->debounce_config);
+        }
+    }
+#else
     struct kscan_gpio_port_state state = {0};
 
     for (int i = 0; i < data->inputs.len; i++) {
@@ -192,6 +230,9 @@ static int kscan_direct_read(const struct device *dev) {
         zmk_debounce_update(&data->pin_state[gpio->index], active, config->debounce_scan_period_ms,
                             &config->debounce_config);
     }
+#endif
+
+    zmk_debounce_scan_end(&config->debounce_config);
 
     // Process the new state.
     bool continue_scan = false;
@@ -204,6 +245,7 @@ static int kscan_direct_read(const struct device *dev) {
             const bool pressed = zmk_debounce_is_pressed(deb_state);
 
             LOG_DBG("Sending event at 0,%i state %s", gpio->index, pressed ? "on" : "off");
+            zmk_kscan_set_event_timestamp(data->scan_time);
             data->callback(dev, 0, gpio->index, pressed);
             if (config->toggle_mode && pressed) {
                 kscan_inputs_set_flags(&data->inputs, &gpio->spec);
@@ -263,6 +305,23 @@ static int kscan_direct_disable(const struct device *dev) {
 #endif
 }
 
+#if USE_INTERRUPTS
+static int kscan_direct_add_callback(const struct device *dev, const int index,
+                                     const struct device *port, const gpio_port_pins_t pins) {
+    struct kscan_direct_data *data = dev->data;
+    struct kscan_direct_irq_callback *irq = &data->irqs[index];
+
+    irq->dev = dev;
+    gpio_init_callback(&irq->callback, kscan_direct_irq_callback_handler, pins);
+    int err = gpio_add_callback(port, &irq->callback);
+    if (err) {
+        LOG_ERR("Error adding the callback to the input device: %i", err);
+    }
+
+    return err;
+}
+#endif
+
 static int kscan_direct_init_input_inst(const struct device *dev, const struct gpio_dt_spec *gpio,
                                         const int index, bool toggle_mode) {
     if (!device_is_ready(gpio->port)) {
@@ -278,15 +337,9 @@ static int kscan_direct_init_input_inst(const struct device *dev, const struct g
 
     LOG_DBG("Configured pin %u on %s for input", gpio->pin, gpio->port->name);
 
-#if USE_INTERRUPTS
-    struct kscan_direct_data *data = dev->data;
-    struct kscan_direct_irq_callback *irq = &data->irqs[index];
-
-    irq->dev = dev;
-    gpio_init_callback(&irq->callback, kscan_direct_irq_callback_handler, BIT(gpio->pin));
-    err = gpio_add_callback(gpio->port, &irq->callback);
+#if USE_INTERRUPTS && !USE_PORT_BATCHED
+    err = kscan_direct_add_callback(dev, index, gpio->port, BIT(gpio->pin));
     if (err) {
-        LOG_ERR("Error adding the callback to the input device: %i", err);
         return err;
     }
 #endif
@@ -306,6 +359,19 @@ static int kscan_direct_init_inputs(const struct device *dev) {
         }
     }
 
+#if USE_INTERRUPTS && USE_PORT_BATCHED
+    // One callback per port sees every input on it, so a press of several keys on the same port
+    // only runs the handler once.
+    for (int i = 0; i < data->input_ports_len; i++) {
+        const struct kscan_gpio_port_group *group = &data->input_ports[i];
+
+        int err = kscan_direct_add_callback(dev, i, group->port, group->mask);
+        if (err) {
+            return err;
+        }
+    }
+#endif
+
     return 0;
 }
 
@@ -317,6 +383,10 @@ static int kscan_direct_init(const struct device *dev) {
     // Sort inputs by port so we can read each port just once per scan.
     kscan_gpio_list_sort_by_port(&data->inputs);
 
+#if USE_PORT_BATCHED
+    data->input_ports_len = kscan_gpio_list_group_by_port(&data->inputs, data->input_ports);
+#endif
+
     kscan_direct_init_inputs(dev);
 
     k_work_init_delayable(&data->work, kscan_direct_work_handler);
@@ -357,20 +427,26 @@ static const struct kscan_driver_api kscan_direct_api = {
                     (LISTIFY(INST_INPUTS_LEN(n), KSCAN_KEY_DIRECT_INPUT_CFG_INIT, (, ), n)))};     \
                                                                                                    \
     static struct zmk_debounce_state kscan_direct_state_##n[INST_INPUTS_LEN(n)];                   \
+    static struct zmk_debounce_global kscan_direct_debounce_global_##n;                            \
                                                                                                    \
     COND_INTERRUPTS(                                                                               \
         (static struct kscan_direct_irq_callback kscan_direct_irqs_##n[INST_INPUTS_LEN(n)];))      \
+    COND_PORT_BATCHED(                                                                             \
+        (static struct kscan_gpio_port_group kscan_direct_input_ports_##n[INST_INPUTS_LEN(n)];))   \
                                                                                                    \
     static struct kscan_direct_data kscan_direct_data_##n = {                                      \
         .inputs = KSCAN_GPIO_LIST(kscan_direct_inputs_##n),                                        \
         .pin_state = kscan_direct_state_##n,                                                       \
-        COND_INTERRUPTS((.irqs = kscan_direct_irqs_##n, ))};                                       \
+        COND_INTERRUPTS((.irqs = kscan_direct_irqs_##n, ))                                         \
+            COND_PORT_BATCHED((.input_ports = kscan_direct_input_ports_##n, ))};                   \
                                                                                                    \
     static struct kscan_direct_config kscan_direct_config_##n = {                                  \
         .debounce_config =                                                                         \
             {                                                                                      \
                 .debounce_press_ms = INST_DEBOUNCE_PRESS_MS(n),                                    \
                 .debounce_release_ms = INST_DEBOUNCE_RELEASE_MS(n),                                \
+                .algorithm = DT_INST_ENUM_IDX(n, debounce_algorithm),                              \
+                .global = &kscan_direct_debounce_global_##n,                                       \
             },                                                                                     \
         .debounce_scan_period_ms = DT_INST_PROP(n, debounce_scan_period_ms),                       \
         .poll_period_ms = DT_INST_PROP(n, poll_period_ms),                                         \
@@ -17,6 +17,9 @@
 #include <zephyr/sys/util.h>
 
 #include <zmk/debounce.h>
+#include <zmk/kscan_poll.h>
+#include <zmk/kscan_sync.h>
+#include <zmk/kscan_timestamp.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
@@ -28,8 +31,12 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #define INST_ROWS_LEN(n) DT_INST_PROP_LEN(n, row_gpios)
 #define INST_COLS_LEN(n) DT_INST_PROP_LEN(n, col_gpios)
-#define INST_MATRIX_LEN(n) (INST_ROWS_LEN(n) * INST_COLS_LEN(n))
 #define INST_INPUTS_LEN(n) COND_DIODE_DIR(n, (INST_COLS_LEN(n)), (INST_ROWS_LEN(n)))
+#define INST_OUTPUTS_LEN(n) COND_DIODE_DIR(n, (INST_ROWS_LEN(n)), (INST_COLS_LEN(n)))
+
+// Inputs are debounced in groups of this many, with one set of groups per output.
+#define INPUT_WORD_BITS 32
+#define INST_INPUT_WORDS(n) DIV_ROUND_UP(INST_INPUTS_LEN(n), INPUT_WORD_BITS)
 
 #if CONFIG_ZMK_KSCAN_DEBOUNCE_PRESS_MS >= 0
 #define INST_DEBOUNCE_PRESS_MS(n) CONFIG_ZMK_KSCAN_DEBOUNCE_PRESS_MS
@@ -52,6 +59,12 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 #define COND_POLL_OR_INTERRUPTS(pollcode, intcode)                                                 \
     COND_CODE_1(CONFIG_ZMK_KSCAN_MATRIX_POLLING, pollcode, intcode)
 
+#define USE_HYBRID_SCAN IS_ENABLED(CONFIG_ZMK_KSCAN_MATRIX_HYBRID_SCAN)
+
+#define USE_PORT_BATCHED IS_ENABLED(CONFIG_ZMK_KSCAN_MATRIX_PORT_BATCHED)
+
+#define COND_PORT_BATCHED(code) COND_CODE_1(CONFIG_ZMK_KSCAN_MATRIX_PORT_BATCHED, code, ())
+
 #define KSCAN_GPIO_ROW_CFG_INIT(idx, inst_idx)                                                     \
     KSCAN_GPIO_GET_BY_IDX(DT_DRV_INST(inst_idx), row_gpios, idx)
 #define KSCAN_GPIO_COL_CFG_INIT(idx, inst_idx)                                                     \
@@ -75,14 +88,33 @@ struct kscan_matrix_data {
 #if USE_INTERRUPTS
     /** Array of length config->inputs.len */
     struct kscan_matrix_irq_callback *irqs;
+#endif
+#if USE_PORT_BATCHED
+    /**
+     * Arrays of length config->inputs.len and config->outputs.len, of which the first
+     * input_ports_len and output_ports_len entries are used.
+     */
+    struct kscan_gpio_port_group *input_ports;
+    struct kscan_gpio_port_group *output_ports;
+    size_t input_ports_len;
+    size_t output_ports_len;
 #endif
     /** Timestamp of the current or scheduled scan. */
     int64_t scan_time;
+#if USE_HYBRID_SCAN
     /**
-     * Current state of the matrix as a flattened 2D array of length
-     * (config->rows * config->cols)
+     * Whether interrupts are watching the outputs with no active keys, so the next scan only needs
+     * to poll the others.
      */
-    struct zmk_debounce_state *matrix_state;
+    bool partial_scan;
+#endif
+    /**
+     * Current state of the matrix as a flattened 2D array of debounce groups of length
+     * (config->outputs.len * input_words). Bit j of group w for an output is input
+     * (w * INPUT_WORD_BITS + j) of data->inputs.
+     */
+    struct zmk_debounce_group *matrix_state;
+    size_t input_words;
 };
 
 struct kscan_matrix_config {
@@ -96,28 +128,92 @@ struct kscan_matrix_config {
 };
 
 /**
- * Get the index into a matrix state array from a row and column.
+ * Get the debounce groups for the inputs of the output at a position in config->outputs.
  */
-static int state_index_rc(const struct kscan_matrix_config *config, const int row, const int col) {
-    __ASSERT(row < config->rows, "Invalid row %i", row);
-    __ASSERT(col < config->cols, "Invalid column %i", col);
+static struct zmk_debounce_group *output_state(const struct device *dev, const int output_pos) {
+    const struct kscan_matrix_data *data = dev->data;
 
-    return (col * config->rows) + row;
+    return &data->matrix_state[output_pos * data->input_words];
 }
 
 /**
- * Get the index into a matrix state array from input/output pin indices.
+ * Add an input to the word of inputs being read, and debounce the word once it is complete.
  */
-static int state_index_io(const struct kscan_matrix_config *config, const int input_idx,
-                          const int output_idx) {
-    return (config->diode_direction == KSCAN_ROW2COL)
-               ? state_index_rc(config, output_idx, input_idx)
-               : state_index_rc(config, input_idx, output_idx);
+static void kscan_matrix_add_input(const struct device *dev, struct zmk_debounce_group *groups,
+                                   uint32_t *word, const int input_pos, const bool active) {
+    const struct kscan_matrix_data *data = dev->data;
+    const struct kscan_matrix_config *config = dev->config;
+    const int bit = input_pos % INPUT_WORD_BITS;
+
+    WRITE_BIT(*word, bit, active);
+
+    if (bit == INPUT_WORD_BITS - 1 || input_pos == data->inputs.len - 1) {
+        zmk_debounce_group_update(&groups[input_pos / INPUT_WORD_BITS], *word,
+                                  config->debounce_scan_period_ms, &config->debounce_config);
+        *word = 0;
+    }
 }
 
+/**
+ * Whether any key on the output at a position in config->outputs is pressed or being debounced.
+ */
+static bool kscan_matrix_output_is_active(const struct device *dev, const int output_pos) {
+    const struct kscan_matrix_data *data = dev->data;
+    const struct zmk_debounce_group *groups = output_state(dev, output_pos);
+
+    for (int w = 0; w < data->input_words; w++) {
+        if (zmk_debounce_group_get_active(&groups[w]) != 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Whether a scan needs to drive the output at a position in config->outputs. A partial scan skips
+ * outputs with no active keys, since interrupts catch any press on them.
+ */
+static bool kscan_matrix_output_is_scanned(const struct device *dev, const int output_pos,
+                                           const bool partial) {
+    return !partial || kscan_matrix_output_is_active(dev, output_pos);
+}
+
+#if USE_PORT_BATCHED
+
+/**
+ * Get the raw level of a pin's bit in a port for a logical value.
+ */
+static gpio_port_value_t kscan_matrix_raw_value(const struct gpio_dt_spec *gpio, const int value) {
+    const bool active_low = (gpio->dt_flags & GPIO_ACTIVE_LOW) != 0;
+    return (value != 0) != active_low ? BIT(gpio->pin) : 0;
+}
+
+static int kscan_matrix_set_output(const struct gpio_dt_spec *gpio, const int value) {
+    return gpio_port_set_masked_raw(gpio->port, BIT(gpio->pin),
+                                    kscan_matrix_raw_value(gpio, value));
+}
+
+#endif // USE_PORT_BATCHED
+
 static int kscan_matrix_set_all_outputs(const struct device *dev, const int value) {
     const struct kscan_matrix_config *config = dev->config;
 
+#if USE_PORT_BATCHED
+    const struct kscan_matrix_data *data = dev->data;
+
+    for (int i = 0; i < data->output_ports_len; i++) {
+        const struct kscan_gpio_port_group *group = &data->output_ports[i];
+
+        int err = gpio_port_set_masked_raw(group->port, group->mask,
+                                           value ? group->active : ~group->active);
+        if (err) {
+            LOG_ERR("Failed to set outputs on %s to %i: %i", group->port->name, value, err);
+            return err;
+        }
+    }
+
+#else
     for (int i = 0; i < config->outputs.len; i++) {
         const struct gpio_dt_spec *gpio = &config->outputs.gpios[i].spec;
 
@@ -127,6 +223,7 @@ static int kscan_matrix_set_all_outputs(const struct device *dev, const int valu
             return err;
         }
     }
+#endif
 
     return 0;
 }
@@ -186,15 +283,57 @@ static void kscan_matrix_irq_callback_handler(const struct device *port, struct
     kscan_matrix_interrupt_disable(data->dev);
 
     data->scan_time = k_uptime_get();
+#if USE_HYBRID_SCAN
+    // A key was pressed on an idle output, so every output needs scanning again.
+    data->partial_scan = false;
+#endif
 
     k_work_reschedule(&data->work, K_NO_WAIT);
 }
 #endif
 
+#if USE_HYBRID_SCAN
+/**
+ * Set the outputs with no active keys active and watch them with interrupts, leaving the outputs
+ * with active keys inactive for the next scan to poll.
+ */
+static int kscan_matrix_hybrid_arm(const struct device *dev) {
+    struct kscan_matrix_data *data = dev->data;
+    const struct kscan_matrix_config *config = dev->config;
+
+    for (int i = 0; i < config->outputs.len; i++) {
+        const struct kscan_gpio *out_gpio = &config->outputs.gpios[i];
+
+        if (kscan_matrix_output_is_active(dev, i)) {
+            continue;
+        }
+
+#if USE_PORT_BATCHED
+        int err = kscan_matrix_set_output(&out_gpio->spec, 1);
+#else
+        int err = gpio_pin_set_dt(&out_gpio->spec, 1);
+#endif
+        if (err) {
+            LOG_ERR("Failed to set output %i active: %i", out_gpio->index, err);
+            return err;
+        }
+    }
+
+    data->partial_scan = true;
+
+    return kscan_matrix_interrupt_configure(dev, GPIO_INT_LEVEL_ACTIVE);
+}
+#endif
+
 static void kscan_matrix_read_continue(const struct device *dev) {
     const struct kscan_matrix_config *config = dev->config;
     struct kscan_matrix_data *data = dev->data;
 
+#if USE_HYBRID_SCAN
+    // Only the outputs with active keys need polling. Interrupts watch the rest.
+    kscan_matrix_hybrid_arm(dev);
+#endif
+
     data->scan_time += config->debounce_scan_period_ms;
 
     k_work_reschedule(&data->work, K_TIMEOUT_ABS_MS(data->scan_time));
@@ -208,22 +347,146 @@ static void kscan_matrix_read_end(const struct device *dev) {
     struct kscan_matrix_data *data = dev->data;
     const struct kscan_matrix_config *config = dev->config;
 
-    data->scan_time += config->poll_period_ms;
+    data->scan_time += zmk_kscan_poll_period_ms(config->poll_period_ms);
 
     // Return to polling slowly.
     k_work_reschedule(&data->work, K_TIMEOUT_ABS_MS(data->scan_time));
 #endif
 }
 
+/**
+ * Read all inputs while one output is active, and update their debounce states.
+ */
+static int kscan_matrix_read_inputs(const struct device *dev, const int output_pos) {
+    struct kscan_matrix_data *data = dev->data;
+    struct zmk_debounce_group *groups = output_state(dev, output_pos);
+    uint32_t word = 0;
+
+#if USE_PORT_BATCHED
+    for (int i = 0; i < data->input_ports_len; i++) {
+        const struct kscan_gpio_port_group *group = &data->input_ports[i];
+
+        gpio_port_value_t value;
+        int err = gpio_port_get(group->port, &value);
+        if (err) {
+            LOG_ERR("Failed to read port %s: %i", group->port->name, err);
+            return err;
+        }
+
+        for (int j = group->start; j < group->start + group->len; j++) {
+            const struct kscan_gpio *in_gpio = &data->inputs.gpios[j];
+            const bool active = (value & BIT(in_gpio->spec.pin)) != 0;
+
+            kscan_matrix_add_input(dev, groups, &word, j, active);
+        }
+    }
+#else
+    struct kscan_gpio_port_state state = {0};
+
+    for (int j = 0; j < data->inputs.len; j++) {
+        const struct kscan_gpio *in_gpio = &data->inputs.gpios[j];
+
+        const int active = kscan_gpio_pin_get(in_gpio, &state);
+        if (active < 0) {
+            LOG_ERR("Failed to read port %s: %i", in_gpio->spec.port->name, active);
+            return active;
+        }
+
+        kscan_matrix_add_input(dev, groups, &word, j, active);
+    }
+#endif
+
+    return 0;
+}
+
+/**
+ * Update the debounce states of an output that wasn't scanned, whose inputs are all inactive.
+ */
+static void kscan_matrix_skip_inputs(const struct device *dev, const int output_pos) {
+    const struct kscan_matrix_data *data = dev->data;
+    const struct kscan_matrix_config *config = dev->config;
+    struct zmk_debounce_group *groups = output_state(dev, output_pos);
+
+    for (int w = 0; w < data->input_words; w++) {
+        zmk_debounce_group_update(&groups[w], 0, config->debounce_scan_period_ms,
+                                  &config->debounce_config);
+    }
+}
+
+#if USE_PORT_BATCHED
+/**
+ * Set an output inactive. Unless there is a wait between outputs, the next output to scan is set
+ * active in the same write if it is on the same port, in which case this returns 1.
+ */
+static int kscan_matrix_release_output(const struct device *dev, const int i, const bool partial) {
+    const struct kscan_matrix_config *config = dev->config;
+    const struct gpio_dt_spec *gpio = &config->outputs.gpios[i].spec;
+
+    int next_pos = i + 1;
+    while (next_pos < config->outputs.len &&
+           !kscan_matrix_output_is_scanned(dev, next_pos, partial)) {
+        next_pos++;
+    }
+
+    const struct gpio_dt_spec *next =
+        next_pos < config->outputs.len ? &config->outputs.gpios[next_pos].spec : NULL;
+
+    if (CONFIG_ZMK_KSCAN_MATRIX_WAIT_BETWEEN_OUTPUTS > 0 || next == NULL ||
+        next->port != gpio->port) {
+        return kscan_matrix_set_output(gpio, 0);
+    }
+
+    int err = gpio_port_set_masked_raw(gpio->port, BIT(gpio->pin) | BIT(next->pin),
+                                       kscan_matrix_raw_value(gpio, 0) |
+                                           kscan_matrix_raw_value(next, 1));
+    return err ? err : 1;
+}
+#endif
+
 static int kscan_matrix_read(const struct device *dev) {
     struct kscan_matrix_data *data = dev->data;
     const struct kscan_matrix_config *config = dev->config;
 
+#if USE_HYBRID_SCAN
+    const bool partial = data->partial_scan;
+
+    if (partial) {
+        // Stop watching the idle outputs and release them so the others can be scanned.
+        data->partial_scan = false;
+
+        int err = kscan_matrix_interrupt_disable(dev);
+        if (err) {
+            return err;
+        }
+    }
+#else
+    const bool partial = false;
+#endif
+
+    zmk_debounce_scan_begin(&config->debounce_config, config->debounce_scan_period_ms);
+
+    // Whether the output to scan next was already set active along with releasing the last one.
+    bool output_active = false;
+
     // Scan the matrix.
     for (int i = 0; i < config->outputs.len; i++) {
         const struct kscan_gpio *out_gpio = &config->outputs.gpios[i];
 
-        int err = gpio_pin_set_dt(&out_gpio->spec, 1);
+        if (!kscan_matrix_output_is_scanned(dev, i, partial)) {
+            // No key on this output is active and none was pressed, or an interrupt would have
+            // asked for a full scan. Its inputs all read inactive.
+            kscan_matrix_skip_inputs(dev, i);
+            continue;
+        }
+
+        int err = 0;
+        if (!output_active) {
+#if USE_PORT_BATCHED
+            err = kscan_matrix_set_output(&out_gpio->spec, 1);
+#else
+            err = gpio_pin_set_dt(&out_gpio->spec, 1);
+#endif
+        }
         if (err) {
             LOG_ERR("Failed to set output %i active: %i", out_gpio->index, err);
             return err;
@@ -232,23 +495,18 @@ static int kscan_matrix_read(const struct device *dev) {
 #if CONFIG_ZMK_KSCAN_MATRIX_WAIT_BEFORE_INPUTS > 0
         k_busy_wait(CONFIG_ZMK_KSCAN_MATRIX_WAIT_BEFORE_INPUTS);
 #endif
-        struct kscan_gpio_port_state state = {0};
-
-        for (int j = 0; j < data->inputs.len; j++) {
-            const struct kscan_gpio *in_gpio = &data->inputs.gpios[j];
-
-            const int index = state_index_io(config, in_gpio->index, out_gpio->index);
-            const int active = kscan_gpio_pin_get(in_gpio, &state);
-            if (active < 0) {
-                LOG_ERR("Failed to read port %s: %i", in_gpio->spec.port->name, active);
-                return active;
-            }
-
-            zmk_debounce_update(&data->matrix_state[index], active, config->debounce_scan_period_ms,
-                                &config->debounce_config);
+        err = kscan_matrix_read_inputs(dev, i);
+        if (err) {
+            return err;
         }
 
+#if USE_PORT_BATCHED
+        err = kscan_matrix_release_output(dev, i, partial);
+        output_active = err == 1;
+        err = MIN(err, 0);
+#else
         err = gpio_pin_set_dt(&out_gpio->spec, 0);
+#endif
         if (err) {
             LOG_ERR("Failed to set output %i inactive: %i", out_gpio->index, err);
             return err;
@@ -259,22 +517,48 @@ static int kscan_matrix_read(const struct device *dev) {
 #endif
     }
 
+    zmk_debounce_scan_end(&config->debounce_config);
+
+    // Count the changes first, so the last one can end the frame.
+    int remaining = 0;
+
+    for (int i = 0; i < config->outputs.len; i++) {
+        const struct zmk_debounce_group *groups = output_state(dev, i);
+
+        for (int w = 0; w < data->input_words; w++) {
+            remaining += __builtin_popcount(zmk_debounce_group_get_changed(&groups[w]));
+        }
+    }
+
     // Process the new state.
     bool continue_scan = false;
 
-    for (int r = 0; r < config->rows; r++) {
-        for (int c = 0; c < config->cols; c++) {
-            const int index = state_index_rc(config, r, c);
-            struct zmk_debounce_state *state = &data->matrix_state[index];
+    for (int i = 0; i < config->outputs.len; i++) {
+        const int out_index = config->outputs.gpios[i].index;
+        const struct zmk_debounce_group *groups = output_state(dev, i);
+
+        for (int w = 0; w < data->input_words; w++) {
+            const struct zmk_debounce_group *group = &groups[w];
 
-            if (zmk_debounce_get_changed(state)) {
-                const bool pressed = zmk_debounce_is_pressed(state);
+            // Only visit the inputs that changed, which usually means none at all.
+            uint32_t changed = zmk_debounce_group_get_changed(group);
+
+            while (changed != 0) {
+                const int bit = u32_count_trailing_zeros(changed);
+                changed &= changed - 1;
+
+                const int in_index = data->inputs.gpios[w * INPUT_WORD_BITS + bit].index;
+                const int r = config->diode_direction == KSCAN_ROW2COL ? out_index : in_index;
+                const int c = config->diode_direction == KSCAN_ROW2COL ? in_index : out_index;
+                const bool pressed = (zmk_debounce_group_get_pressed(group) & BIT(bit)) != 0;
 
                 LOG_DBG("Sending event at %i,%i state %s", r, c, pressed ? "on" : "off");
+                zmk_kscan_set_event_timestamp(data->scan_time);
+                zmk_kscan_set_event_sync(--remaining == 0);
                 data->callback(dev, r, c, pressed);
             }
 
-            continue_scan = continue_scan || zmk_debounce_is_active(state);
+            continue_scan = continue_scan || zmk_debounce_group_get_active(group) != 0;
         }
     }
 
@@ -321,6 +605,10 @@ static int kscan_matrix_disable(const struct device *dev) {
 
     k_work_cancel_delayable(&data->work);
 
+#if USE_HYBRID_SCAN
+    data->partial_scan = false;
+#endif
+
 #if USE_INTERRUPTS
     return kscan_matrix_interrupt_disable(dev);
 #else
@@ -413,6 +701,18 @@ static int kscan_matrix_init(const struct device *dev) {
     // Sort inputs by port so we can read each port just once per scan.
     kscan_gpio_list_sort_by_port(&data->inputs);
 
+#if USE_PORT_BATCHED
+    const struct kscan_matrix_config *config = dev->config;
+
+    // Outputs are sorted too, so consecutive outputs can share a port write. The list points to
+    // writable GPIO arrays even though the config is const.
+    struct kscan_gpio_list outputs = config->outputs;
+    kscan_gpio_list_sort_by_port(&outputs);
+
+    data->input_ports_len = kscan_gpio_list_group_by_port(&data->inputs, data->input_ports);
+    data->output_ports_len = kscan_gpio_list_group_by_port(&config->outputs, data->output_ports);
+#endif
+
     kscan_matrix_init_inputs(dev);
     kscan_matrix_init_outputs(dev);
     kscan_matrix_set_all_outputs(dev, 0);
@@ -455,16 +755,25 @@ static const struct kscan_driver_api kscan_matrix_api = {
     static struct kscan_gpio kscan_matrix_cols_##n[] = {                                           \
         LISTIFY(INST_COLS_LEN(n), KSCAN_GPIO_COL_CFG_INIT, (, ), n)};                              \
                                                                                                    \
-    static struct zmk_debounce_state kscan_matrix_state_##n[INST_MATRIX_LEN(n)];                   \
+    static struct zmk_debounce_group                                                               \
+        kscan_matrix_state_##n[INST_OUTPUTS_LEN(n) * INST_INPUT_WORDS(n)];                         \
+    static struct zmk_debounce_global kscan_matrix_debounce_global_##n;                            \
                                                                                                    \
     COND_INTERRUPTS(                                                                               \
         (static struct kscan_matrix_irq_callback kscan_matrix_irqs_##n[INST_INPUTS_LEN(n)];))      \
                                                                                                    \
+    COND_PORT_BATCHED(                                                                             \
+        (static struct kscan_gpio_port_group kscan_matrix_input_ports_##n[INST_INPUTS_LEN(n)];     \
+         static struct kscan_gpio_port_group kscan_matrix_output_ports_##n[INST_OUTPUTS_LEN(n)];)) \
+                                                                                                   \
     static struct kscan_matrix_data kscan_matrix_data_##n = {                                      \
         .inputs =                                                                                  \
             KSCAN_GPIO_LIST(COND_DIODE_DIR(n, (kscan_matrix_cols_##n), (kscan_matrix_rows_##n))),  \
         .matrix_state = kscan_matrix_state_##n,                                                    \
-        COND_INTERRUPTS((.irqs = kscan_matrix_irqs_##n, ))};                                       \
+        .input_words = INST_INPUT_WORDS(n),                                                        \
+        COND_INTERRUPTS((.irqs = kscan_matrix_irqs_##n, ))                                         \
+            COND_PORT_BATCHED((.input_ports = kscan_matrix_input_ports_##n,                        \
+                               .output_ports = kscan_matrix_output_ports_##n, ))};                 \
                                                                                                    \
     static struct kscan_matrix_config kscan_matrix_config_##n = {                                  \
         .rows = ARRAY_SIZE(kscan_matrix_rows_##n),                                                 \
@@ -475,6 +784,8 @@ static const struct kscan_driver_api kscan_matrix_api = {
             {                                                                                      \
                 .debounce_press_ms = INST_DEBOUNCE_PRESS_MS(n),                                    \
                 .debounce_release_ms = INST_DEBOUNCE_RELEASE_MS(n),                                \
+                .algorithm = DT_INST_ENUM_IDX(n, debounce_algorithm),                              \
+                .global = &kscan_matrix_debounce_global_##n,                                       \
             },                                                                                     \
         .debounce_scan_period_ms = DT_INST_PROP(n, debounce_scan_period_ms),                       \
         .poll_period_ms = DT_INST_PROP(n, poll_period_ms),                                         \
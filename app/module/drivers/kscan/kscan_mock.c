@@ -24,6 +24,139 @@ struct kscan_mock_data {
     const struct device *dev;
 };
 
+#if IS_ENABLED(CONFIG_ZMK_KSCAN_MOCK_TRACE)
+
+#include <stdio.h>
+#include <string.h>
+
+#include <zephyr/sys/byteorder.h>
+
+#include <zmk/kscan_timestamp.h>
+
+#include "cmdline.h"
+#include "soc.h"
+
+/*
+ * A trace file starts with TRACE_MAGIC, followed by a record for each event: a little-endian u32
+ * of milliseconds since the start of the trace, then a u8 row, a u8 column, and a u8 which is 1
+ * for a press and 0 for a release. Records must be in time order. They are read from the file as
+ * they are replayed, so a trace of millions of events takes no more memory than a short one.
+ */
+#define TRACE_MAGIC "ZKT1"
+#define TRACE_RECORD_LEN 7
+
+// Time to wait after the last event before exiting, so behaviors waiting on a timeout finish.
+#define TRACE_EXIT_DELAY_MS 1000
+
+static char *trace_path;
+
+static void kscan_mock_trace_options(void) {
+    static struct args_struct_t options[] = {
+        {.option = "kscan-trace",
+         .name = "path",
+         .type = 's',
+         .dest = (void *)&trace_path,
+         .descript = "Replay the events in this trace file instead of the events of the first "
+                     "mock kscan"},
+        ARG_TABLE_ENDMARKER};
+
+    native_add_command_line_opts(options);
+}
+
+NATIVE_TASK(kscan_mock_trace_options, PRE_BOOT_1, 1);
+
+struct kscan_mock_trace_event {
+    uint32_t timestamp;
+    uint8_t row;
+    uint8_t column;
+    bool pressed;
+};
+
+static FILE *trace_file;
+static int64_t trace_start;
+static struct kscan_mock_trace_event trace_next;
+static bool trace_has_next;
+static bool trace_done;
+
+static void kscan_mock_trace_read_next(void) {
+    uint8_t record[TRACE_RECORD_LEN];
+
+    trace_has_next = fread(record, sizeof(record), 1, trace_file) == 1;
+    if (trace_has_next) {
+        trace_next = (struct kscan_mock_trace_event){
+            .timestamp = sys_get_le32(record),
+            .row = record[4],
+            .column = record[5],
+            .pressed = record[6] != 0,
+        };
+    }
+}
+
+static int kscan_mock_trace_open(void) {
+    char magic[sizeof(TRACE_MAGIC) - 1];
+
+    trace_file = fopen(trace_path, "rb");
+    if (trace_file == NULL) {
+        LOG_ERR("Failed to open kscan trace %s", trace_path);
+        return -ENOENT;
+    }
+
+    if (fread(magic, sizeof(magic), 1, trace_file) != 1 ||
+        memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0) {
+        LOG_ERR("%s is not a kscan trace", trace_path);
+        fclose(trace_file);
+        trace_file = NULL;
+        return -EINVAL;
+    }
+
+    kscan_mock_trace_read_next();
+    return 0;
+}
+
+static void kscan_mock_trace_start(struct kscan_mock_data *data) {
+    // Re-enabling the kscan after it was disabled carries on where the trace left off.
+    if (trace_start == 0) {
+        trace_start = k_uptime_get();
+    }
+
+    k_work_schedule(&data->work, K_NO_WAIT);
+}
+
+static void kscan_mock_trace_replay(struct kscan_mock_data *data, bool exit_after) {
+    int64_t now = k_uptime_get();
+
+    if (trace_done) {
+        LOG_DBG("Exiting");
+        exit(0);
+    }
+
+    while (trace_has_next && trace_start + trace_next.timestamp <= now) {
+        zmk_kscan_set_event_timestamp(trace_start + trace_next.timestamp);
+        data->callback(data->dev, trace_next.row, trace_next.column, trace_next.pressed);
+        kscan_mock_trace_read_next();
+    }
+
+    if (trace_has_next) {
+        k_work_schedule(&data->work, K_MSEC(trace_start + trace_next.timestamp - now));
+    } else if (exit_after) {
+        trace_done = true;
+        k_work_schedule(&data->work, K_MSEC(TRACE_EXIT_DELAY_MS));
+    }
+}
+
+// Only the first mock kscan replays the trace.
+#define TRACE_ACTIVE(n) ((n) == 0 && trace_file != NULL)
+#define TRACE_OPEN(n) (((n) == 0 && trace_path != NULL) ? kscan_mock_trace_open() : 0)
+
+#else
+
+#define TRACE_ACTIVE(n) false
+#define TRACE_OPEN(n) 0
+static inline void kscan_mock_trace_start(struct kscan_mock_data *data) {}
+static inline void kscan_mock_trace_replay(struct kscan_mock_data *data, bool exit_after) {}
+
+#endif // IS_ENABLED(CONFIG_ZMK_KSCAN_MOCK_TRACE)
+
 static int kscan_mock_disable_callback(const struct device *dev) {
     struct kscan_mock_data *data = dev->data;
 
@@ -46,13 +179,13 @@ static int kscan_mock_configure(const struct device *dev, kscan_callback_t callb
 
 #define MOCK_INST_INIT(n)                                                                          \
     struct kscan_mock_config_##n {                                                                 \
-        uint32_t events[DT_INST_PROP_LEN(n, events)];                                              \
+        uint32_t events[DT_INST_PROP_LEN_OR(n, events, 0)];                                        \
         bool exit_after;                                                                           \
     };                                                                                             \
     static void kscan_mock_schedule_next_event_##n(const struct device *dev) {                     \
         struct kscan_mock_data *data = dev->data;                                                  \
         const struct kscan_mock_config_##n *cfg = dev->config;                                     \
-        if (data->event_index < DT_INST_PROP_LEN(n, events)) {                                     \
+        if (data->event_index < DT_INST_PROP_LEN_OR(n, events, 0)) {                               \
             uint32_t ev = cfg->events[data->event_index];                                          \
             LOG_DBG("delaying next keypress: %d", ZMK_MOCK_MSEC(ev));                              \
             k_work_schedule(&data->work, K_MSEC(ZMK_MOCK_MSEC(ev)));                               \
@@ -65,6 +198,10 @@ static int kscan_mock_configure(const struct device *dev, kscan_callback_t callb
         struct k_work_delayable *d_work = k_work_delayable_from_work(work);                        \
         struct kscan_mock_data *data = CONTAINER_OF(d_work, struct kscan_mock_data, work);         \
         const struct kscan_mock_config_##n *cfg = data->dev->config;                               \
+        if (TRACE_ACTIVE(n)) {                                                                     \
+            kscan_mock_trace_replay(data, cfg->exit_after);                                        \
+            return;                                                                                \
+        }                                                                                          \
         uint32_t ev = cfg->events[data->event_index];                                              \
         LOG_DBG("ev %u row %d column %d state %d\n", ev, ZMK_MOCK_ROW(ev), ZMK_MOCK_COL(ev),       \
                 ZMK_MOCK_IS_PRESS(ev));                                                            \
@@ -76,9 +213,13 @@ static int kscan_mock_configure(const struct device *dev, kscan_callback_t callb
         struct kscan_mock_data *data = dev->data;                                                  \
         data->dev = dev;                                                                           \
         k_work_init_delayable(&data->work, kscan_mock_work_handler_##n);                           \
-        return 0;                                                                                  \
+        return TRACE_OPEN(n);                                                                      \
     }                                                                                              \
     static int kscan_mock_enable_callback_##n(const struct device *dev) {                          \
+        if (TRACE_ACTIVE(n)) {                                                                     \
+            kscan_mock_trace_start(dev->data);                                                     \
+            return 0;                                                                              \
+        }                                                                                          \
         kscan_mock_schedule_next_event_##n(dev);                                                   \
         return 0;                                                                                  \
     }                                                                                              \
@@ -89,7 +230,7 @@ static int kscan_mock_configure(const struct device *dev, kscan_callback_t callb
     };                                                                                             \
     static struct kscan_mock_data kscan_mock_data_##n;                                             \
     static const struct kscan_mock_config_##n kscan_mock_config_##n = {                            \
-        .events = DT_INST_PROP(n, events), .exit_after = DT_INST_PROP(n, exit_after)};             \
+        .events = DT_INST_PROP_OR(n, events, {}), .exit_after = DT_INST_PROP(n, exit_after)};      \
     DEVICE_DT_INST_DEFINE(n, kscan_mock_init_##n, NULL, &kscan_mock_data_##n,                      \
                           &kscan_mock_config_##n, POST_KERNEL, CONFIG_KSCAN_INIT_PRIORITY,         \
                           &mock_driver_api_##n);
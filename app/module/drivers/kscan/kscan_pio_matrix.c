@@ -0,0 +1,523 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "kscan_gpio.h"
+
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/kscan.h>
+#include <zephyr/drivers/misc/pio_rpi_pico/pio_rpi_pico.h>
+#include <zephyr/pm/device.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+#include <hardware/clocks.h>
+#include <hardware/dma.h>
+#include <hardware/pio.h>
+
+#include <zmk/debounce.h>
+#include <zmk/kscan_poll.h>
+#include <zmk/kscan_timestamp.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#define DT_DRV_COMPAT zmk_kscan_pio_matrix
+
+#define INST_DIODE_DIR(n) DT_ENUM_IDX(DT_DRV_INST(n), diode_direction)
+#define COND_DIODE_DIR(n, row2col_code, col2row_code)                                              \
+    COND_CODE_0(INST_DIODE_DIR(n), row2col_code, col2row_code)
+
+#define INST_ROWS_LEN(n) DT_INST_PROP_LEN(n, row_gpios)
+#define INST_COLS_LEN(n) DT_INST_PROP_LEN(n, col_gpios)
+#define INST_OUTPUTS_LEN(n) COND_DIODE_DIR(n, (INST_ROWS_LEN(n)), (INST_COLS_LEN(n)))
+
+#if CONFIG_ZMK_KSCAN_DEBOUNCE_PRESS_MS >= 0
+#define INST_DEBOUNCE_PRESS_MS(n) CONFIG_ZMK_KSCAN_DEBOUNCE_PRESS_MS
+#else
+#define INST_DEBOUNCE_PRESS_MS(n) DT_INST_PROP(n, debounce_press_ms)
+#endif
+
+#if CONFIG_ZMK_KSCAN_DEBOUNCE_RELEASE_MS >= 0
+#define INST_DEBOUNCE_RELEASE_MS(n) CONFIG_ZMK_KSCAN_DEBOUNCE_RELEASE_MS
+#else
+#define INST_DEBOUNCE_RELEASE_MS(n) DT_INST_PROP(n, debounce_release_ms)
+#endif
+
+/*
+ * The output patterns and the input snapshot are DMA ring buffers, which must have a power of two
+ * length and be aligned to their size. Patterns past the last output drive no output.
+ */
+#define RING_LEN(len)                                                                              \
+    ((len) <= 1 ? 1 : (len) <= 2 ? 2 : (len) <= 4 ? 4 : (len) <= 8 ? 8 : (len) <= 16 ? 16 : 32)
+#define INST_RING_LEN(n) RING_LEN(INST_OUTPUTS_LEN(n))
+
+// DMA channels run for this many transfers, and are re-armed from the debounce work when done.
+#define DMA_TRANSFER_COUNT UINT32_MAX
+
+// Cycles between driving an output and sampling the inputs, set by the delay of the nop below.
+#define SETTLE_CYCLES 32
+
+/*
+ * Drives the next output pattern from the TX FIFO, waits for it to settle, and samples the inputs
+ * into the RX FIFO. Autopull and autopush do the FIFO accesses, so this loops without the CPU.
+ *
+ * .wrap_target
+ *     out pins, 32
+ *     nop [31]
+ *     in pins, 32
+ * .wrap
+ */
+RPI_PICO_PIO_DEFINE_PROGRAM(kscan_pio_matrix, 0, 2,
+                            0x6000, //  0: out    pins, 32
+                            0xbf42, //  1: nop           [31]
+                            0x4000, //  2: in     pins, 32
+);
+
+#define KSCAN_GPIO_ROW_CFG_INIT(idx, inst_idx)                                                     \
+    KSCAN_GPIO_GET_BY_IDX(DT_DRV_INST(inst_idx), row_gpios, idx)
+#define KSCAN_GPIO_COL_CFG_INIT(idx, inst_idx)                                                     \
+    KSCAN_GPIO_GET_BY_IDX(DT_DRV_INST(inst_idx), col_gpios, idx)
+
+enum kscan_diode_direction {
+    KSCAN_ROW2COL,
+    KSCAN_COL2ROW,
+};
+
+struct kscan_pio_matrix_data {
+    const struct device *dev;
+    kscan_callback_t callback;
+    struct k_work_delayable work;
+    /** Timestamp of the current or scheduled debounce update. */
+    int64_t scan_time;
+    PIO pio;
+    size_t sm;
+    int tx_dma;
+    int rx_dma;
+    /** GPIO of bit 0 of the input words. */
+    uint8_t in_base;
+    /** Bits of the input words that are inputs. */
+    uint32_t in_mask;
+    /** Bits of the input words whose inputs are active low. */
+    uint32_t in_invert;
+    /** Devicetree index of the input of each bit of the input words. */
+    uint8_t in_index[32];
+    /** Output GPIOs, and their raw levels with all outputs inactive. */
+    uint32_t out_pins;
+    uint32_t out_inactive;
+    /** Arrays of length config->ring_len. */
+    uint32_t *patterns;
+    volatile uint32_t *snapshot;
+    /**
+     * Current state of the matrix as one debounce group per output, with the same bits as the
+     * input words. Array of length config->outputs.len.
+     */
+    struct zmk_debounce_group *matrix_state;
+};
+
+struct kscan_pio_matrix_config {
+    const struct device *piodev;
+    struct kscan_gpio_list inputs;
+    struct kscan_gpio_list outputs;
+    struct zmk_debounce_config debounce_config;
+    size_t rows;
+    size_t cols;
+    size_t ring_len;
+    int32_t debounce_scan_period_ms;
+    int32_t poll_period_ms;
+    uint32_t settle_time_ns;
+    enum kscan_diode_direction diode_direction;
+};
+
+static void kscan_pio_matrix_rearm_dma(const struct kscan_pio_matrix_data *data) {
+    if (!dma_channel_is_busy(data->tx_dma)) {
+        dma_channel_set_trans_count(data->tx_dma, DMA_TRANSFER_COUNT, true);
+    }
+
+    if (!dma_channel_is_busy(data->rx_dma)) {
+        dma_channel_set_trans_count(data->rx_dma, DMA_TRANSFER_COUNT, true);
+    }
+}
+
+static void kscan_pio_matrix_read(const struct device *dev) {
+    struct kscan_pio_matrix_data *data = dev->data;
+    const struct kscan_pio_matrix_config *config = dev->config;
+
+    kscan_pio_matrix_rearm_dma(data);
+
+    bool continue_scan = false;
+
+    zmk_debounce_scan_begin(&config->debounce_config, config->debounce_scan_period_ms);
+
+    for (int i = 0; i < config->outputs.len; i++) {
+        const int out_index = config->outputs.gpios[i].index;
+        struct zmk_debounce_group *group = &data->matrix_state[i];
+
+        // Bits that aren't inputs read as inactive, so they never change.
+        zmk_debounce_group_update(group, (data->snapshot[i] ^ data->in_invert) & data->in_mask,
+                                  config->debounce_scan_period_ms, &config->debounce_config);
+
+        uint32_t changed = zmk_debounce_group_get_changed(group);
+
+        while (changed != 0) {
+            const int bit = u32_count_trailing_zeros(changed);
+            changed &= changed - 1;
+
+            const int in_index = data->in_index[bit];
+            const int row = config->diode_direction == KSCAN_ROW2COL ? out_index : in_index;
+            const int col = config->diode_direction == KSCAN_ROW2COL ? in_index : out_index;
+            const bool pressed = (zmk_debounce_group_get_pressed(group) & BIT(bit)) != 0;
+
+            LOG_DBG("Sending event at %i,%i state %s", row, col, pressed ? "on" : "off");
+            zmk_kscan_set_event_timestamp(data->scan_time);
+            data->callback(dev, row, col, pressed);
+        }
+
+        continue_scan = continue_scan || zmk_debounce_group_get_active(group) != 0;
+    }
+
+    zmk_debounce_scan_end(&config->debounce_config);
+
+    // The state machine scans continuously either way, this only sets how often it's debounced.
+    data->scan_time += continue_scan ? config->debounce_scan_period_ms
+                                     : zmk_kscan_poll_period_ms(config->poll_period_ms);
+
+    k_work_reschedule(&data->work, K_TIMEOUT_ABS_MS(data->scan_time));
+}
+
+static void kscan_pio_matrix_work_handler(struct k_work *work) {
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct kscan_pio_matrix_data *data = CONTAINER_OF(dwork, struct kscan_pio_matrix_data, work);
+    kscan_pio_matrix_read(data->dev);
+}
+
+static int kscan_pio_matrix_configure(const struct device *dev, const kscan_callback_t callback) {
+    struct kscan_pio_matrix_data *data = dev->data;
+
+    if (!callback) {
+        return -EINVAL;
+    }
+
+    data->callback = callback;
+    return 0;
+}
+
+static int kscan_pio_matrix_enable(const struct device *dev) {
+    struct kscan_pio_matrix_data *data = dev->data;
+    const struct kscan_pio_matrix_config *config = dev->config;
+
+    pio_sm_set_enabled(data->pio, data->sm, true);
+
+    // A full scan takes microseconds, so the snapshot is current by the first debounce update.
+    data->scan_time = k_uptime_get() + config->debounce_scan_period_ms;
+    k_work_reschedule(&data->work, K_TIMEOUT_ABS_MS(data->scan_time));
+
+    return 0;
+}
+
+static int kscan_pio_matrix_disable(const struct device *dev) {
+    struct kscan_pio_matrix_data *data = dev->data;
+
+    k_work_cancel_delayable(&data->work);
+
+    pio_sm_set_enabled(data->pio, data->sm, false);
+
+    // The state machine stops with an output still driven, so release them all.
+    pio_sm_set_pins_with_mask(data->pio, data->sm, data->out_inactive, data->out_pins);
+
+    return 0;
+}
+
+/**
+ * Finds the lowest GPIO of a list of pins and checks that all of them are within 32 GPIOs from
+ * there, since that is what one PIO instruction can read or write.
+ */
+static int kscan_pio_matrix_pin_base(const struct kscan_gpio_list *list, uint8_t *base) {
+    uint8_t min = UINT8_MAX;
+    uint8_t max = 0;
+
+    for (int i = 0; i < list->len; i++) {
+        const struct gpio_dt_spec *gpio = &list->gpios[i].spec;
+
+        if (gpio->port != list->gpios[0].spec.port) {
+            LOG_ERR("All pins must be on the same GPIO controller");
+            return -EINVAL;
+        }
+
+        min = MIN(min, gpio->pin);
+        max = MAX(max, gpio->pin);
+    }
+
+    if (max - min >= 32) {
+        LOG_ERR("Pins %u to %u are more than 32 GPIOs apart", min, max);
+        return -EINVAL;
+    }
+
+    *base = min;
+    return 0;
+}
+
+static int kscan_pio_matrix_init_inputs(const struct device *dev) {
+    struct kscan_pio_matrix_data *data = dev->data;
+    const struct kscan_pio_matrix_config *config = dev->config;
+
+    int err = kscan_pio_matrix_pin_base(&config->inputs, &data->in_base);
+    if (err) {
+        return err;
+    }
+
+    for (int i = 0; i < config->inputs.len; i++) {
+        const struct kscan_gpio *gpio = &config->inputs.gpios[i];
+        const int bit = gpio->spec.pin - data->in_base;
+
+        if (!device_is_ready(gpio->spec.port)) {
+            LOG_ERR("GPIO is not ready: %s", gpio->spec.port->name);
+            return -ENODEV;
+        }
+
+        // The state machine reads pins whatever their function, so inputs stay GPIOs with the
+        // pulls from the devicetree.
+        err = gpio_pin_configure_dt(&gpio->spec, GPIO_INPUT);
+        if (err) {
+            LOG_ERR("Unable to configure pin %u on %s for input", gpio->spec.pin,
+                    gpio->spec.port->name);
+            return err;
+        }
+
+        data->in_mask |= BIT(bit);
+        if (gpio->spec.dt_flags & GPIO_ACTIVE_LOW) {
+            data->in_invert |= BIT(bit);
+        }
+        data->in_index[bit] = gpio->index;
+    }
+
+    // Until the first scan completes, the snapshot reads as every input inactive.
+    for (int i = 0; i < config->ring_len; i++) {
+        data->snapshot[i] = data->in_invert;
+    }
+
+    return 0;
+}
+
+static int kscan_pio_matrix_init_outputs(const struct device *dev, uint8_t *out_base) {
+    struct kscan_pio_matrix_data *data = dev->data;
+    const struct kscan_pio_matrix_config *config = dev->config;
+
+    int err = kscan_pio_matrix_pin_base(&config->outputs, out_base);
+    if (err) {
+        return err;
+    }
+
+    for (int i = 0; i < config->outputs.len; i++) {
+        const struct gpio_dt_spec *gpio = &config->outputs.gpios[i].spec;
+
+        data->out_pins |= BIT(gpio->pin);
+        if (gpio->dt_flags & GPIO_ACTIVE_LOW) {
+            data->out_inactive |= BIT(gpio->pin);
+        }
+    }
+
+    // Each pattern drives one output active and the rest inactive, as raw levels relative to the
+    // output base. Patterns past the last output leave all of them inactive.
+    for (int i = 0; i < config->ring_len; i++) {
+        data->patterns[i] = data->out_inactive >> *out_base;
+
+        if (i < config->outputs.len) {
+            data->patterns[i] ^= BIT(config->outputs.gpios[i].spec.pin - *out_base);
+        }
+    }
+
+    pio_sm_set_pins_with_mask(data->pio, data->sm, data->out_inactive, data->out_pins);
+    pio_sm_set_pindirs_with_mask(data->pio, data->sm, data->out_pins, data->out_pins);
+
+    // Only pins given to the PIO are driven by it, so pins between the outputs are left alone.
+    for (int i = 0; i < config->outputs.len; i++) {
+        pio_gpio_init(data->pio, config->outputs.gpios[i].spec.pin);
+    }
+
+    return 0;
+}
+
+static int kscan_pio_matrix_init_sm(const struct device *dev, uint8_t out_base) {
+    struct kscan_pio_matrix_data *data = dev->data;
+    const struct kscan_pio_matrix_config *config = dev->config;
+    const struct pio_program *program = RPI_PICO_PIO_GET_PROGRAM(kscan_pio_matrix);
+
+    if (!pio_can_add_program(data->pio, program)) {
+        LOG_ERR("No room for the scan program in PIO instruction memory");
+        return -EBUSY;
+    }
+
+    const uint offset = pio_add_program(data->pio, program);
+    pio_sm_config sm_config = pio_get_default_sm_config();
+
+    sm_config_set_wrap(&sm_config, offset + RPI_PICO_PIO_GET_WRAP_TARGET(kscan_pio_matrix),
+                       offset + RPI_PICO_PIO_GET_WRAP(kscan_pio_matrix));
+    sm_config_set_out_pins(&sm_config, out_base, 32);
+    sm_config_set_in_pins(&sm_config, data->in_base);
+    sm_config_set_out_shift(&sm_config, true, true, 32);
+    sm_config_set_in_shift(&sm_config, true, true, 32);
+
+    // Slow the state machine down so the nop waits for the settle time, in 1/256 cycles.
+    uint64_t div = (uint64_t)config->settle_time_ns * clock_get_hz(clk_sys) * 256 /
+                   ((uint64_t)SETTLE_CYCLES * NSEC_PER_SEC);
+    div = CLAMP(div, 256, (UINT16_MAX << 8) | 0xff);
+    sm_config_set_clkdiv_int_frac(&sm_config, div >> 8, div & 0xff);
+
+    return pio_sm_init(data->pio, data->sm, offset, &sm_config);
+}
+
+static int kscan_pio_matrix_init_dma(const struct device *dev) {
+    struct kscan_pio_matrix_data *data = dev->data;
+    const struct kscan_pio_matrix_config *config = dev->config;
+    const uint ring_bits = u32_count_trailing_zeros(config->ring_len * sizeof(uint32_t));
+
+    data->tx_dma = dma_claim_unused_channel(false);
+    data->rx_dma = dma_claim_unused_channel(false);
+    if (data->tx_dma < 0 || data->rx_dma < 0) {
+        LOG_ERR("No free DMA channels for the matrix scan");
+        return -EBUSY;
+    }
+
+    // Feed the output patterns to the state machine round and round.
+    dma_channel_config tx_config = dma_channel_get_default_config(data->tx_dma);
+    channel_config_set_transfer_data_size(&tx_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&tx_config, true);
+    channel_config_set_write_increment(&tx_config, false);
+    channel_config_set_ring(&tx_config, false, ring_bits);
+    channel_config_set_dreq(&tx_config, pio_get_dreq(data->pio, data->sm, true));
+    dma_channel_configure(data->tx_dma, &tx_config, &data->pio->txf[data->sm], data->patterns,
+                          DMA_TRANSFER_COUNT, true);
+
+    // Store the input word sampled for each pattern at the pattern's index in the snapshot.
+    dma_channel_config rx_config = dma_channel_get_default_config(data->rx_dma);
+    channel_config_set_transfer_data_size(&rx_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&rx_config, false);
+    channel_config_set_write_increment(&rx_config, true);
+    channel_config_set_ring(&rx_config, true, ring_bits);
+    channel_config_set_dreq(&rx_config, pio_get_dreq(data->pio, data->sm, false));
+    dma_channel_configure(data->rx_dma, &rx_config, data->snapshot, &data->pio->rxf[data->sm],
+                          DMA_TRANSFER_COUNT, true);
+
+    return 0;
+}
+
+static int kscan_pio_matrix_init(const struct device *dev) {
+    struct kscan_pio_matrix_data *data = dev->data;
+    const struct kscan_pio_matrix_config *config = dev->config;
+
+    data->dev = dev;
+
+    if (!device_is_ready(config->piodev)) {
+        LOG_ERR("PIO is not ready: %s", config->piodev->name);
+        return -ENODEV;
+    }
+
+    data->pio = pio_rpi_pico_get_pio(config->piodev);
+
+    int err = pio_rpi_pico_allocate_sm(config->piodev, &data->sm);
+    if (err < 0) {
+        LOG_ERR("No free PIO state machine for the matrix scan: %i", err);
+        return err;
+    }
+
+    uint8_t out_base;
+    err = kscan_pio_matrix_init_inputs(dev);
+    if (!err) {
+        err = kscan_pio_matrix_init_outputs(dev, &out_base);
+    }
+    if (!err) {
+        err = kscan_pio_matrix_init_sm(dev, out_base);
+    }
+    if (!err) {
+        err = kscan_pio_matrix_init_dma(dev);
+    }
+    if (err) {
+        return err;
+    }
+
+    k_work_init_delayable(&data->work, kscan_pio_matrix_work_handler);
+
+    return 0;
+}
+
+#if IS_ENABLED(CONFIG_PM_DEVICE)
+
+static int kscan_pio_matrix_pm_action(const struct device *dev, enum pm_device_action action) {
+    switch (action) {
+    case PM_DEVICE_ACTION_SUSPEND:
+        return kscan_pio_matrix_disable(dev);
+    case PM_DEVICE_ACTION_RESUME:
+        return kscan_pio_matrix_enable(dev);
+    default:
+        return -ENOTSUP;
+    }
+}
+
+#endif // IS_ENABLED(CONFIG_PM_DEVICE)
+
+static const struct kscan_driver_api kscan_pio_matrix_api = {
+    .config = kscan_pio_matrix_configure,
+    .enable_callback = kscan_pio_matrix_enable,
+    .disable_callback = kscan_pio_matrix_disable,
+};
+
+#define KSCAN_PIO_MATRIX_INIT(n)                                                                   \
+    BUILD_ASSERT(INST_DEBOUNCE_PRESS_MS(n) <= DEBOUNCE_COUNTER_MAX,                                \
+                 "ZMK_KSCAN_DEBOUNCE_PRESS_MS or debounce-press-ms is too large");                 \
+    BUILD_ASSERT(INST_DEBOUNCE_RELEASE_MS(n) <= DEBOUNCE_COUNTER_MAX,                              \
+                 "ZMK_KSCAN_DEBOUNCE_RELEASE_MS or debounce-release-ms is too large");             \
+    BUILD_ASSERT(INST_OUTPUTS_LEN(n) <= 32, "A PIO matrix can have at most 32 outputs");           \
+                                                                                                   \
+    static struct kscan_gpio kscan_pio_matrix_rows_##n[] = {                                       \
+        LISTIFY(INST_ROWS_LEN(n), KSCAN_GPIO_ROW_CFG_INIT, (, ), n)};                              \
+                                                                                                   \
+    static struct kscan_gpio kscan_pio_matrix_cols_##n[] = {                                       \
+        LISTIFY(INST_COLS_LEN(n), KSCAN_GPIO_COL_CFG_INIT, (, ), n)};                              \
+                                                                                                   \
+    static struct zmk_debounce_group kscan_pio_matrix_state_##n[INST_OUTPUTS_LEN(n)];              \
+    static struct zmk_debounce_global kscan_pio_matrix_debounce_global_##n;                        \
+    static uint32_t kscan_pio_matrix_patterns_##n[INST_RING_LEN(n)]                                \
+        __aligned(INST_RING_LEN(n) * sizeof(uint32_t));                                            \
+    static volatile uint32_t kscan_pio_matrix_snapshot_##n[INST_RING_LEN(n)]                       \
+        __aligned(INST_RING_LEN(n) * sizeof(uint32_t));                                            \
+                                                                                                   \
+    static struct kscan_pio_matrix_data kscan_pio_matrix_data_##n = {                              \
+        .patterns = kscan_pio_matrix_patterns_##n,                                                 \
+        .snapshot = kscan_pio_matrix_snapshot_##n,                                                 \
+        .matrix_state = kscan_pio_matrix_state_##n,                                                \
+    };                                                                                             \
+                                                                                                   \
+    static const struct kscan_pio_matrix_config kscan_pio_matrix_config_##n = {                    \
+        .piodev = DEVICE_DT_GET(DT_INST_PARENT(n)),                                                \
+        .rows = ARRAY_SIZE(kscan_pio_matrix_rows_##n),                                             \
+        .cols = ARRAY_SIZE(kscan_pio_matrix_cols_##n),                                             \
+        .ring_len = INST_RING_LEN(n),                                                              \
+        .inputs = KSCAN_GPIO_LIST(                                                                 \
+            COND_DIODE_DIR(n, (kscan_pio_matrix_cols_##n), (kscan_pio_matrix_rows_##n))),          \
+        .outputs = KSCAN_GPIO_LIST(                                                                \
+            COND_DIODE_DIR(n, (kscan_pio_matrix_rows_##n), (kscan_pio_matrix_cols_##n))),          \
+        .debounce_config =                                                                         \
+            {                                                                                      \
+                .debounce_press_ms = INST_DEBOUNCE_PRESS_MS(n),                                    \
+                .debounce_release_ms = INST_DEBOUNCE_RELEASE_MS(n),                                \
+                .algorithm = DT_INST_ENUM_IDX(n, debounce_algorithm),                              \
+                .global = &kscan_pio_matrix_debounce_global_##n,                                   \
+            },                                                                                     \
+        .debounce_scan_period_ms = DT_INST_PROP(n, debounce_scan_period_ms),                       \
+        .poll_period_ms = DT_INST_PROP(n, poll_period_ms),                                         \
+        .settle_time_ns = DT_INST_PROP(n, settle_time_ns),                                         \
+        .diode_direction = INST_DIODE_DIR(n),                                                      \
+    };                                                                                             \
+                                                                                                   \
+    PM_DEVICE_DT_INST_DEFINE(n, kscan_pio_matrix_pm_action);                                       \
+                                                                                                   \
+    DEVICE_DT_INST_DEFINE(n, &kscan_pio_matrix_init, PM_DEVICE_DT_INST_GET(n),                     \
+                          &kscan_pio_matrix_data_##n, &kscan_pio_matrix_config_##n, POST_KERNEL,   \
+                          CONFIG_KSCAN_INIT_PRIORITY, &kscan_pio_matrix_api);
+
+DT_INST_FOREACH_STATUS_OKAY(KSCAN_PIO_MATRIX_INIT);
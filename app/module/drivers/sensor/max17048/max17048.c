@@ -106,6 +106,131 @@ done:
     return err;
 }
 
+#if IS_ENABLED(CONFIG_ZMK_MAX17048_TRIGGER)
+
+// Clears the alert flags, then the alert bit itself, which releases the ALRT pin.
+static int clear_alert(const struct device *dev) {
+    uint16_t tmp = 0;
+
+    int err = read_register(dev, REG_STATUS, &tmp);
+    if (err == 0) {
+        err = write_register(dev, REG_STATUS, tmp & ~REG_STATUS_ALERT_FLAGS);
+    }
+
+    if (err == 0) {
+        err = read_register(dev, REG_CONFIG, &tmp);
+    }
+
+    if (err == 0) {
+        err = write_register(dev, REG_CONFIG, tmp & ~REG_CONFIG_ALRT);
+    }
+
+    return err;
+}
+
+static void max17048_alert_work(struct k_work *work) {
+    struct max17048_drv_data *drv_data = CONTAINER_OF(work, struct max17048_drv_data, alert_work);
+    const struct device *dev = drv_data->dev;
+
+    k_sem_take(&drv_data->lock, K_FOREVER);
+
+    int err = clear_alert(dev);
+    sensor_trigger_handler_t handler = drv_data->handler;
+    const struct sensor_trigger *trigger = drv_data->trigger;
+
+    k_sem_give(&drv_data->lock);
+
+    if (err != 0) {
+        LOG_WRN("failed to clear alert: %d", err);
+    }
+
+    if (handler) {
+        handler(dev, trigger);
+    }
+}
+
+static void max17048_alert_callback(const struct device *port, struct gpio_callback *cb,
+                                    uint32_t pins) {
+    struct max17048_drv_data *drv_data = CONTAINER_OF(cb, struct max17048_drv_data, alert_cb);
+
+    // The registers are read over I2C, which can't be done from the interrupt.
+    k_work_submit(&drv_data->alert_work);
+}
+
+static int max17048_trigger_set(const struct device *dev, const struct sensor_trigger *trig,
+                                sensor_trigger_handler_t handler) {
+    struct max17048_drv_data *drv_data = dev->data;
+    const struct max17048_config *config = dev->config;
+
+    if (config->alert_gpio.port == NULL) {
+        return -ENOTSUP;
+    }
+
+    if (trig->type != SENSOR_TRIG_DELTA || trig->chan != SENSOR_CHAN_GAUGE_STATE_OF_CHARGE) {
+        return -ENOTSUP;
+    }
+
+    k_sem_take(&drv_data->lock, K_FOREVER);
+
+    drv_data->handler = handler;
+    drv_data->trigger = trig;
+
+    // The chip only alerts on state of charge changes of 1%.
+    uint16_t tmp = 0;
+    int err = read_register(dev, REG_CONFIG, &tmp);
+    if (err == 0) {
+        tmp = handler ? (tmp | REG_CONFIG_ALSC) : (tmp & ~REG_CONFIG_ALSC);
+        err = write_register(dev, REG_CONFIG, tmp);
+    }
+
+    k_sem_give(&drv_data->lock);
+
+    if (err == 0) {
+        LOG_DBG("state of charge alert %s", handler ? "enabled" : "disabled");
+    }
+
+    return err;
+}
+
+static int max17048_init_alert(const struct device *dev) {
+    struct max17048_drv_data *drv_data = dev->data;
+    const struct max17048_config *config = dev->config;
+
+    if (config->alert_gpio.port == NULL) {
+        return 0;
+    }
+
+    if (!gpio_is_ready_dt(&config->alert_gpio)) {
+        LOG_WRN("alert gpio not ready!");
+        return -ENODEV;
+    }
+
+    drv_data->dev = dev;
+    k_work_init(&drv_data->alert_work, max17048_alert_work);
+
+    int err = gpio_pin_configure_dt(&config->alert_gpio, GPIO_INPUT);
+    if (err != 0) {
+        return err;
+    }
+
+    gpio_init_callback(&drv_data->alert_cb, max17048_alert_callback, BIT(config->alert_gpio.pin));
+
+    err = gpio_add_callback(config->alert_gpio.port, &drv_data->alert_cb);
+    if (err != 0) {
+        return err;
+    }
+
+    // An alert left over from before the reset would hold the pin, and no edge would follow.
+    err = clear_alert(dev);
+    if (err != 0) {
+        return err;
+    }
+
+    return gpio_pin_interrupt_configure_dt(&config->alert_gpio, GPIO_INT_EDGE_TO_ACTIVE);
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_MAX17048_TRIGGER)
+
 static int max17048_sample_fetch(const struct device *dev, enum sensor_channel chan) {
 
     struct max17048_drv_data *const drv_data = dev->data;
@@ -196,17 +321,32 @@ static int max17048_init(const struct device *dev) {
     // set the default rcomp value -- 0x97, as stated in the datasheet
     set_rcomp_value(dev, 0x97);
 
+#if IS_ENABLED(CONFIG_ZMK_MAX17048_TRIGGER)
+    err = max17048_init_alert(dev);
+    if (err != 0) {
+        LOG_WRN("could not set up the alert pin: %d", err);
+        return err;
+    }
+#endif
+
     LOG_INF("device initialised at 0x%x (version %d)", config->i2c_bus.addr, ic_version);
 
     return 0;
 }
 
-static const struct sensor_driver_api max17048_api_table = {.sample_fetch = max17048_sample_fetch,
-                                                            .channel_get = max17048_channel_get};
+static const struct sensor_driver_api max17048_api_table = {
+    .sample_fetch = max17048_sample_fetch,
+    .channel_get = max17048_channel_get,
+#if IS_ENABLED(CONFIG_ZMK_MAX17048_TRIGGER)
+    .trigger_set = max17048_trigger_set,
+#endif
+};
 
 #define MAX17048_INIT(inst)                                                                        \
-    static struct max17048_config max17048_##inst##_config = {.i2c_bus =                           \
-                                                                  I2C_DT_SPEC_INST_GET(inst)};     \
+    static struct max17048_config max17048_##inst##_config = {                                     \
+        .i2c_bus = I2C_DT_SPEC_INST_GET(inst),                                                     \
+        IF_ENABLED(CONFIG_ZMK_MAX17048_TRIGGER,                                                    \
+                   (.alert_gpio = GPIO_DT_SPEC_INST_GET_OR(inst, alert_gpios, {0}), ))};           \
                                                                                                    \
     static struct max17048_drv_data max17048_##inst##_drvdata = {                                  \
         .raw_state_of_charge = 0,                                                                  \
@@ -7,6 +7,9 @@
 #pragma once
 
 #include <zephyr/device.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/sensor.h>
 #include <zephyr/sys/util.h>
 
 #ifdef __cplusplus
@@ -24,8 +27,18 @@ extern "C" {
 #define REG_VRESET 0x18
 #define REG_STATUS 0x1A
 
+// Low byte of CONFIG
+#define REG_CONFIG_ALSC BIT(6)
+#define REG_CONFIG_ALRT BIT(5)
+
+// RI, VH, VL, VR, HD and SC in the high byte of STATUS
+#define REG_STATUS_ALERT_FLAGS 0x3F00
+
 struct max17048_config {
     struct i2c_dt_spec i2c_bus;
+#if IS_ENABLED(CONFIG_ZMK_MAX17048_TRIGGER)
+    struct gpio_dt_spec alert_gpio;
+#endif
 };
 
 struct max17048_drv_data {
@@ -34,6 +47,15 @@ struct max17048_drv_data {
     uint16_t raw_state_of_charge;
     uint16_t raw_charge_rate;
     uint16_t raw_vcell;
+
+#if IS_ENABLED(CONFIG_ZMK_MAX17048_TRIGGER)
+    const struct device *dev;
+    struct gpio_callback alert_cb;
+    struct k_work alert_work;
+
+    sensor_trigger_handler_t handler;
+    const struct sensor_trigger *trigger;
+#endif
 };
 
 #ifdef __cplusplus
@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define DT_DRV_COMPAT zmk_pio_qdec
+
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/misc/pio_rpi_pico/pio_rpi_pico.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/util.h>
+
+#include <hardware/clocks.h>
+#include <hardware/pio.h>
+
+#include <zmk/kscan_poll.h>
+
+LOG_MODULE_REGISTER(PIO_QDEC, CONFIG_SENSOR_LOG_LEVEL);
+
+#define FULL_ROTATION 360
+
+// Cycles of one pass of the sampling loop when the pins haven't changed.
+#define SAMPLE_CYCLES 7
+
+/*
+ * Keeps the count of quadrature steps in Y and pushes it to the RX FIFO on every pass, dropping it
+ * while the FIFO is full. The last pin state is kept in OSR. Each pass shifts it into ISR along
+ * with the new pin state, and jumps with the resulting 4 bits into the table at the start of the
+ * program to step Y up or down or leave it. Contact bounce steps back and forth and cancels out,
+ * and both pins changing between two samples leaves the count alone. Every step is counted by the
+ * state machine, so the CPU only has to read the count.
+ *
+ * The table is jumped to with an absolute address, so the program must be loaded at offset 0.
+ *
+ *     ; old state 00
+ *     jmp update      ; new 00
+ *     jmp decrement   ; new 01
+ *     jmp increment   ; new 10
+ *     jmp update      ; new 11
+ *     ; old state 01
+ *     jmp increment   ; new 00
+ *     jmp update      ; new 01
+ *     jmp update      ; new 10
+ *     jmp decrement   ; new 11
+ *     ; old state 10
+ *     jmp decrement   ; new 00
+ *     jmp update      ; new 01
+ *     jmp update      ; new 10
+ *     jmp increment   ; new 11
+ *     ; old state 11
+ *     jmp update      ; new 00
+ *     jmp increment   ; new 01
+ *     jmp decrement   ; new 10
+ * .wrap_target
+ * update:             ; new 11
+ *     mov isr, y
+ *     push noblock
+ *     out isr, 2
+ *     in pins, 2
+ *     mov osr, isr
+ *     mov pc, isr
+ * increment:
+ *     mov y, ~y
+ *     jmp y--, next
+ * next:
+ *     mov y, ~y
+ * .wrap
+ * decrement:
+ *     jmp y--, done
+ * done:
+ *     jmp update
+ */
+RPI_PICO_PIO_DEFINE_PROGRAM(pio_qdec, 15, 23,
+                            0x000f, //  0: jmp    15
+                            0x0018, //  1: jmp    24
+                            0x0015, //  2: jmp    21
+                            0x000f, //  3: jmp    15
+                            0x0015, //  4: jmp    21
+                            0x000f, //  5: jmp    15
+                            0x000f, //  6: jmp    15
+                            0x0018, //  7: jmp    24
+                            0x0018, //  8: jmp    24
+                            0x000f, //  9: jmp    15
+                            0x000f, // 10: jmp    15
+                            0x0015, // 11: jmp    21
+                            0x000f, // 12: jmp    15
+                            0x0015, // 13: jmp    21
+                            0x0018, // 14: jmp    24
+                            0xa0c2, // 15: mov    isr, y
+                            0x8000, // 16: push   noblock
+                            0x60c2, // 17: out    isr, 2
+                            0x4002, // 18: in     pins, 2
+                            0xa0e6, // 19: mov    osr, isr
+                            0xa0a6, // 20: mov    pc, isr
+                            0xa04a, // 21: mov    y, ~y
+                            0x0097, // 22: jmp    y--, 23
+                            0xa04a, // 23: mov    y, ~y
+                            0x0099, // 24: jmp    y--, 25
+                            0x000f, // 25: jmp    15
+);
+
+struct pio_qdec_data {
+    const struct device *dev;
+    struct k_spinlock lock;
+    struct k_work_delayable work;
+    PIO pio;
+    size_t sm;
+    /** Count read by the last sample fetch. */
+    uint32_t count;
+    /** Steps counted by sample fetches since the last channel get. */
+    int32_t pulses;
+
+    sensor_trigger_handler_t handler;
+    const struct sensor_trigger *trigger;
+};
+
+struct pio_qdec_config {
+    const struct device *piodev;
+    struct gpio_dt_spec a;
+    struct gpio_dt_spec b;
+    uint16_t steps;
+    uint32_t sample_rate_hz;
+    int32_t poll_period_ms;
+};
+
+/**
+ * Which PIO blocks already have the program loaded, since all encoders on a block share it.
+ */
+static bool pio_qdec_loaded[NUM_PIOS];
+
+static uint32_t pio_qdec_read_count(const struct device *dev) {
+    struct pio_qdec_data *data = dev->data;
+    const struct pio_qdec_config *config = dev->config;
+
+    k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+    // The FIFO holds the oldest counts pushed since the last read, so drop them and wait for the
+    // next pass of the sampling loop to push the current one.
+    while (!pio_sm_is_rx_fifo_empty(data->pio, data->sm)) {
+        pio_sm_get(data->pio, data->sm);
+    }
+
+    uint32_t count = pio_sm_get_blocking(data->pio, data->sm);
+
+    k_spin_unlock(&data->lock, key);
+
+    // With B as the base pin the program counts the other way, so flip it to match the EC11 driver.
+    return config->a.pin < config->b.pin ? count : -count;
+}
+
+static int pio_qdec_sample_fetch(const struct device *dev, enum sensor_channel chan) {
+    struct pio_qdec_data *data = dev->data;
+
+    if (chan != SENSOR_CHAN_ALL && chan != SENSOR_CHAN_ROTATION) {
+        return -ENOTSUP;
+    }
+
+    const uint32_t count = pio_qdec_read_count(dev);
+
+    // The count wraps around, which the unsigned difference handles.
+    data->pulses += (int32_t)(count - data->count);
+    data->count = count;
+
+    return 0;
+}
+
+static int pio_qdec_channel_get(const struct device *dev, enum sensor_channel chan,
+                                struct sensor_value *val) {
+    struct pio_qdec_data *data = dev->data;
+    const struct pio_qdec_config *config = dev->config;
+    const int32_t pulses = data->pulses;
+
+    if (chan != SENSOR_CHAN_ROTATION) {
+        return -ENOTSUP;
+    }
+
+    data->pulses = 0;
+
+    val->val1 = (pulses * FULL_ROTATION) / config->steps;
+    val->val2 = (pulses * FULL_ROTATION) % config->steps;
+    if (val->val2 != 0) {
+        val->val2 *= 1000000;
+        val->val2 /= config->steps;
+    }
+
+    return 0;
+}
+
+static void pio_qdec_work_handler(struct k_work *work) {
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct pio_qdec_data *data = CONTAINER_OF(dwork, struct pio_qdec_data, work);
+    const struct pio_qdec_config *config = data->dev->config;
+
+    // Steps are only reported once fetched, so this triggers again until the handler fetches them.
+    if (data->handler && pio_qdec_read_count(data->dev) != data->count) {
+        data->handler(data->dev, data->trigger);
+    }
+
+    k_work_reschedule(&data->work, K_MSEC(zmk_kscan_poll_period_ms(config->poll_period_ms)));
+}
+
+static int pio_qdec_trigger_set(const struct device *dev, const struct sensor_trigger *trig,
+                                sensor_trigger_handler_t handler) {
+    struct pio_qdec_data *data = dev->data;
+
+    if (trig->type != SENSOR_TRIG_DATA_READY) {
+        return -ENOTSUP;
+    }
+
+    data->trigger = trig;
+    data->handler = handler;
+
+    if (handler) {
+        k_work_reschedule(&data->work, K_NO_WAIT);
+    } else {
+        k_work_cancel_delayable(&data->work);
+    }
+
+    return 0;
+}
+
+static const struct sensor_driver_api pio_qdec_driver_api = {
+    .trigger_set = pio_qdec_trigger_set,
+    .sample_fetch = pio_qdec_sample_fetch,
+    .channel_get = pio_qdec_channel_get,
+};
+
+static int pio_qdec_init_pins(const struct device *dev, uint8_t *base) {
+    const struct pio_qdec_config *config = dev->config;
+
+    if (config->a.port != config->b.port ||
+        (config->a.pin + 1 != config->b.pin && config->b.pin + 1 != config->a.pin)) {
+        LOG_ERR("The A and B pins must be consecutive GPIOs");
+        return -EINVAL;
+    }
+
+    if (!device_is_ready(config->a.port)) {
+        LOG_ERR("GPIO is not ready: %s", config->a.port->name);
+        return -ENODEV;
+    }
+
+    // The state machine reads pins whatever their function, so they stay GPIOs with the pulls from
+    // the devicetree. Inverting both pins doesn't change the direction of a step, so active low
+    // flags don't matter.
+    int err = gpio_pin_configure_dt(&config->a, GPIO_INPUT);
+    if (!err) {
+        err = gpio_pin_configure_dt(&config->b, GPIO_INPUT);
+    }
+    if (err) {
+        LOG_ERR("Unable to configure the encoder pins for input");
+        return err;
+    }
+
+    *base = MIN(config->a.pin, config->b.pin);
+    return 0;
+}
+
+static int pio_qdec_init_sm(const struct device *dev, uint8_t base) {
+    struct pio_qdec_data *data = dev->data;
+    const struct pio_qdec_config *config = dev->config;
+    const struct pio_program *program = RPI_PICO_PIO_GET_PROGRAM(pio_qdec);
+    const uint index = pio_get_index(data->pio);
+
+    if (!pio_qdec_loaded[index]) {
+        if (!pio_can_add_program_at_offset(data->pio, program, 0)) {
+            LOG_ERR("The decoder program must be at the start of PIO instruction memory");
+            return -EBUSY;
+        }
+
+        pio_add_program_at_offset(data->pio, program, 0);
+        pio_qdec_loaded[index] = true;
+    }
+
+    pio_sm_config sm_config = pio_get_default_sm_config();
+
+    sm_config_set_wrap(&sm_config, RPI_PICO_PIO_GET_WRAP_TARGET(pio_qdec),
+                       RPI_PICO_PIO_GET_WRAP(pio_qdec));
+    sm_config_set_in_pins(&sm_config, base);
+    sm_config_set_in_shift(&sm_config, false, false, 32);
+    sm_config_set_out_shift(&sm_config, true, false, 32);
+
+    // Slow the state machine down to the sample rate, in 1/256 cycles.
+    uint64_t div = (uint64_t)clock_get_hz(clk_sys) * 256 /
+                   ((uint64_t)SAMPLE_CYCLES * config->sample_rate_hz);
+    div = CLAMP(div, 256, (UINT16_MAX << 8) | 0xff);
+    sm_config_set_clkdiv_int_frac(&sm_config, div >> 8, div & 0xff);
+
+    int err = pio_sm_init(data->pio, data->sm, RPI_PICO_PIO_GET_WRAP_TARGET(pio_qdec), &sm_config);
+    if (err) {
+        return err;
+    }
+
+    // Start from the current pin state, so the first pass doesn't count a step.
+    pio_sm_exec(data->pio, data->sm, pio_encode_in(pio_pins, 2));
+    pio_sm_exec(data->pio, data->sm, pio_encode_mov(pio_osr, pio_isr));
+
+    pio_sm_set_enabled(data->pio, data->sm, true);
+
+    return 0;
+}
+
+static int pio_qdec_init(const struct device *dev) {
+    struct pio_qdec_data *data = dev->data;
+    const struct pio_qdec_config *config = dev->config;
+
+    data->dev = dev;
+
+    if (!device_is_ready(config->piodev)) {
+        LOG_ERR("PIO is not ready: %s", config->piodev->name);
+        return -ENODEV;
+    }
+
+    data->pio = pio_rpi_pico_get_pio(config->piodev);
+
+    int err = pio_rpi_pico_allocate_sm(config->piodev, &data->sm);
+    if (err < 0) {
+        LOG_ERR("No free PIO state machine for the encoder: %i", err);
+        return err;
+    }
+
+    uint8_t base;
+    err = pio_qdec_init_pins(dev, &base);
+    if (!err) {
+        err = pio_qdec_init_sm(dev, base);
+    }
+    if (err) {
+        return err;
+    }
+
+    data->count = pio_qdec_read_count(dev);
+
+    k_work_init_delayable(&data->work, pio_qdec_work_handler);
+
+    return 0;
+}
+
+#define PIO_QDEC_INST(n)                                                                           \
+    BUILD_ASSERT(DT_INST_PROP(n, steps) > 0, "steps must be greater than zero");                   \
+    BUILD_ASSERT(DT_INST_PROP(n, sample_rate_hz) > 0, "sample-rate-hz must be greater than zero"); \
+                                                                                                   \
+    static struct pio_qdec_data pio_qdec_data_##n;                                                 \
+                                                                                                   \
+    static const struct pio_qdec_config pio_qdec_config_##n = {                                    \
+        .piodev = DEVICE_DT_GET(DT_INST_PARENT(n)),                                                \
+        .a = GPIO_DT_SPEC_INST_GET(n, a_gpios),                                                    \
+        .b = GPIO_DT_SPEC_INST_GET(n, b_gpios),                                                    \
+        .steps = DT_INST_PROP(n, steps),                                                           \
+        .sample_rate_hz = DT_INST_PROP(n, sample_rate_hz),                                         \
+        .poll_period_ms = DT_INST_PROP(n, poll_period_ms),                                         \
+    };                                                                                             \
+                                                                                                   \
+    DEVICE_DT_INST_DEFINE(n, pio_qdec_init, NULL, &pio_qdec_data_##n, &pio_qdec_config_##n,        \
+                          POST_KERNEL, CONFIG_SENSOR_INIT_PRIORITY, &pio_qdec_driver_api);
+
+DT_INST_FOREACH_STATUS_OKAY(PIO_QDEC_INST)
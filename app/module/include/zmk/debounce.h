@@ -19,13 +19,77 @@ struct zmk_debounce_state {
     uint16_t counter : DEBOUNCE_COUNTER_BITS;
 };
 
+/**
+ * Debounce state of up to 32 switches, one per bit, updated together. Each counter is stored
+ * vertically, with bit i of every switch's counter in counter[i].
+ */
+struct zmk_debounce_group {
+    uint32_t pressed;
+    uint32_t changed;
+    uint32_t counter[DEBOUNCE_COUNTER_BITS];
+};
+
+/**
+ * Debounce algorithms, in the order of the debounce-algorithm devicetree property.
+ */
+enum zmk_debounce_algorithm {
+    /**
+     * Latch a change once the switch spent the debounce time more in the new state than in the
+     * old one. Bounces slow the change down rather than restart it.
+     */
+    ZMK_DEBOUNCE_INTEGRATE,
+    /**
+     * Latch a change on the first edge, then ignore the switch for the debounce time of the new
+     * state.
+     */
+    ZMK_DEBOUNCE_EAGER_PER_KEY,
+    /** Latch a change once the switch held the new state without a bounce for the debounce time. */
+    ZMK_DEBOUNCE_DEFER_PER_KEY,
+    /**
+     * Latch every switch once none of them changed for the longer of the two debounce times.
+     */
+    ZMK_DEBOUNCE_SYMMETRIC_GLOBAL,
+};
+
+/**
+ * State shared by all switches of one kscan device, for ZMK_DEBOUNCE_SYMMETRIC_GLOBAL.
+ */
+struct zmk_debounce_global {
+    /** Time since any switch last changed. */
+    uint16_t quiet_ms;
+    /** Some switch changed since the last time they were latched. */
+    bool pending;
+    /** Switches are latched in the current scan. */
+    bool latch;
+    /** Some switch changed in the current scan. */
+    bool changed;
+};
+
 struct zmk_debounce_config {
     /** Duration a switch must be pressed to latch as pressed. */
     uint32_t debounce_press_ms;
     /** Duration a switch must be released to latch as released. */
     uint32_t debounce_release_ms;
+    enum zmk_debounce_algorithm algorithm;
+    /** Required for ZMK_DEBOUNCE_SYMMETRIC_GLOBAL, unused otherwise. */
+    struct zmk_debounce_global *global;
 };
 
+/**
+ * Starts a scan of all switches of a kscan device. Call before updating any of them.
+ *
+ * @param config Debounce settings.
+ * @param elapsed_ms Time elapsed since the previous scan in milliseconds.
+ */
+void zmk_debounce_scan_begin(const struct zmk_debounce_config *config, const int elapsed_ms);
+
+/**
+ * Ends a scan of all switches of a kscan device. Call after updating all of them.
+ *
+ * @param config Debounce settings.
+ */
+void zmk_debounce_scan_end(const struct zmk_debounce_config *config);
+
 /**
  * Debounces one switch.
  *
@@ -54,3 +118,31 @@ bool zmk_debounce_is_pressed(const struct zmk_debounce_state *state);
  * debounce_update.
  */
 bool zmk_debounce_get_changed(const struct zmk_debounce_state *state);
+
+/**
+ * Debounces up to 32 switches at once. Each switch is debounced exactly as by
+ * zmk_debounce_update(), but with a fixed number of bitwise operations for the group.
+ *
+ * @param group The state for the switches to debounce.
+ * @param active Bit mask of the switches that are currently pressed.
+ * @param elapsed_ms Time elapsed since the previous update in milliseconds.
+ * @param config Debounce settings.
+ */
+void zmk_debounce_group_update(struct zmk_debounce_group *group, const uint32_t active,
+                               const int elapsed_ms, const struct zmk_debounce_config *config);
+
+/**
+ * @returns a bit mask of the switches for which zmk_debounce_is_active() would return true.
+ */
+uint32_t zmk_debounce_group_get_active(const struct zmk_debounce_group *group);
+
+/**
+ * @returns a bit mask of the switches latched as pressed.
+ */
+uint32_t zmk_debounce_group_get_pressed(const struct zmk_debounce_group *group);
+
+/**
+ * @returns a bit mask of the switches whose pressed state changed in the last call to
+ * zmk_debounce_group_update.
+ */
+uint32_t zmk_debounce_group_get_changed(const struct zmk_debounce_group *group);
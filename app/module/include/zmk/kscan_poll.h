@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/sys/util.h>
+
+/**
+ * Whether the keyboard has been idle long enough for polling kscan drivers to slow down.
+ */
+bool zmk_kscan_is_idle(void);
+
+/**
+ * Get the period for a polling kscan driver to wait before its next poll while no keys are active.
+ *
+ * While the keyboard is idle, this is lengthened to CONFIG_ZMK_KSCAN_IDLE_POLL_PERIOD_MS. The first
+ * key press is then found by a slow poll, after which the driver polls at the debounce scan period
+ * as usual and the keyboard becomes active again, so only that first press is delayed.
+ *
+ * @param poll_period_ms The driver's poll period for while the keyboard is active.
+ */
+static inline int32_t zmk_kscan_poll_period_ms(int32_t poll_period_ms) {
+#if CONFIG_ZMK_KSCAN_IDLE_POLL_PERIOD_MS > 0
+    if (zmk_kscan_is_idle()) {
+        return MAX(poll_period_ms, CONFIG_ZMK_KSCAN_IDLE_POLL_PERIOD_MS);
+    }
+#endif
+
+    return poll_period_ms;
+}
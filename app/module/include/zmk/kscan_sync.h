@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+/**
+ * Report whether the key state change passed to the next kscan callback is the last one found by
+ * its scan.
+ *
+ * Like zmk_kscan_set_event_timestamp(), this extends the Zephyr kscan callback contract. With
+ * CONFIG_ZMK_KSCAN_INPUT_BRIDGE, the changes up to and including one with @p sync set are handed
+ * to the keymap as a single input frame. The value is consumed by the callback, so drivers which
+ * never call this get each change in a frame of its own.
+ *
+ * @param sync False if the driver invokes its callback again for the same scan.
+ */
+void zmk_kscan_set_event_sync(bool sync);
+
+/**
+ * Consume the value set by zmk_kscan_set_event_sync().
+ *
+ * This is for kscan drivers which forward the state changes of other kscan drivers, so they can
+ * keep the sync of each change when they don't invoke their own callback right away.
+ *
+ * @return The pending sync, or true if there is none.
+ */
+bool zmk_kscan_take_event_sync(void);
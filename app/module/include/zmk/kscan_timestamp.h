@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Report when the key state change passed to the next kscan callback was detected.
+ *
+ * This extends the Zephyr kscan callback contract, which has no way to pass a timestamp. A kscan
+ * driver that knows when it scanned the matrix calls this immediately before invoking its callback,
+ * and the timestamp is attached to the resulting position event instead of the time at which the
+ * event is eventually processed. The value is consumed by the callback, so drivers which never
+ * call this get events stamped at the time the callback was invoked.
+ *
+ * @param timestamp Uptime in milliseconds, as from k_uptime_get(), of the scan that detected the
+ * state change.
+ */
+void zmk_kscan_set_event_timestamp(int64_t timestamp);
+
+/**
+ * Consume the timestamp set by zmk_kscan_set_event_timestamp().
+ *
+ * This is for kscan drivers which forward the state changes of other kscan drivers, so they can
+ * keep the timestamp of each change when they don't invoke their own callback right away.
+ *
+ * @return The pending timestamp, or the current uptime if there is none.
+ */
+int64_t zmk_kscan_take_event_timestamp(void);
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <zephyr/sys/atomic.h>
+
+/** Activity counted for the power estimate, in addition to the CPU time of each thread. */
+enum zmk_power_stats_event {
+    // A kscan driver scanned its inputs.
+    ZMK_POWER_STATS_KSCAN_SCAN,
+    // A HID report was handed to the BLE stack.
+    ZMK_POWER_STATS_BLE_REPORT,
+    // A split message was handed to the BLE stack.
+    ZMK_POWER_STATS_SPLIT_MESSAGE,
+    // The battery sensor was sampled.
+    ZMK_POWER_STATS_BATTERY_SAMPLE,
+    // The RGB underglow strip was updated.
+    ZMK_POWER_STATS_UNDERGLOW_FRAME,
+    ZMK_POWER_STATS_EVENT_COUNT,
+};
+
+struct zmk_power_stats {
+    // Length of the window the statistics cover.
+    uint32_t window_ms;
+    // Time spent running anything other than the idle thread.
+    uint32_t cpu_active_us;
+    // Estimated average current drawn by the CPU and the counted events.
+    uint32_t estimated_ua;
+    uint32_t events[ZMK_POWER_STATS_EVENT_COUNT];
+};
+
+#if IS_ENABLED(CONFIG_ZMK_POWER_STATS)
+
+extern atomic_t zmk_power_stats_events[ZMK_POWER_STATS_EVENT_COUNT];
+
+/**
+ * Counts one occurrence of the event in the current window. This is safe to call from any
+ * context, including interrupts.
+ */
+static inline void zmk_power_stats_record(enum zmk_power_stats_event event) {
+    atomic_inc(&zmk_power_stats_events[event]);
+}
+
+/**
+ * Gets the statistics for the last complete window of CONFIG_ZMK_POWER_STATS_WINDOW_SEC seconds.
+ */
+void zmk_power_stats_get(struct zmk_power_stats *stats);
+
+#else
+
+static inline void zmk_power_stats_record(enum zmk_power_stats_event event) {}
+
+#endif // IS_ENABLED(CONFIG_ZMK_POWER_STATS)
@@ -5,12 +5,21 @@
  */
 
 #include <zmk/debounce.h>
+#include <zmk/power_stats.h>
 
 static uint32_t get_threshold(const struct zmk_debounce_state *state,
                               const struct zmk_debounce_config *config) {
     return state->pressed ? config->debounce_release_ms : config->debounce_press_ms;
 }
 
+/**
+ * Time to ignore a switch for after it latched in a new state with ZMK_DEBOUNCE_EAGER_PER_KEY.
+ */
+static uint32_t get_lockout(const bool pressed, const struct zmk_debounce_config *config) {
+    return MIN(pressed ? config->debounce_press_ms : config->debounce_release_ms,
+               DEBOUNCE_COUNTER_MAX);
+}
+
 static void increment_counter(struct zmk_debounce_state *state, const int elapsed_ms) {
     if (state->counter + elapsed_ms > DEBOUNCE_COUNTER_MAX) {
         state->counter = DEBOUNCE_COUNTER_MAX;
@@ -27,30 +36,102 @@ static void decrement_counter(struct zmk_debounce_state *state, const int elapse
     }
 }
 
-void zmk_debounce_update(struct zmk_debounce_state *state, const bool active, const int elapsed_ms,
-                         const struct zmk_debounce_config *config) {
+static void flip(struct zmk_debounce_state *state) {
+    state->pressed = !state->pressed;
+    state->counter = 0;
+    state->changed = true;
+}
+
+static void update_integrate(struct zmk_debounce_state *state, const bool active,
+                             const int elapsed_ms, const struct zmk_debounce_config *config) {
     // This uses a variation of the integrator debouncing described at
     // https://www.kennethkuhn.com/electronics/debounce.c
     // Every update where "active" does not match the current state, we increment
     // a counter, otherwise we decrement it. When the counter reaches a
     // threshold, the state flips and we reset the counter.
-    state->changed = false;
-
     if (active == state->pressed) {
         decrement_counter(state, elapsed_ms);
         return;
     }
 
-    const uint32_t flip_threshold = get_threshold(state, config);
+    if (state->counter < get_threshold(state, config)) {
+        increment_counter(state, elapsed_ms);
+        return;
+    }
+
+    flip(state);
+}
+
+static void update_eager(struct zmk_debounce_state *state, const bool active, const int elapsed_ms,
+                         const struct zmk_debounce_config *config) {
+    // The counter holds the time left to ignore the switch for.
+    if (state->counter > 0) {
+        decrement_counter(state, elapsed_ms);
+        return;
+    }
+
+    if (active == state->pressed) {
+        return;
+    }
+
+    flip(state);
+    state->counter = get_lockout(state->pressed, config);
+}
+
+static void update_defer(struct zmk_debounce_state *state, const bool active, const int elapsed_ms,
+                         const struct zmk_debounce_config *config) {
+    // Like the integrator, except that any bounce back starts the wait over.
+    if (active == state->pressed) {
+        state->counter = 0;
+        return;
+    }
 
-    if (state->counter < flip_threshold) {
+    if (state->counter < get_threshold(state, config)) {
         increment_counter(state, elapsed_ms);
         return;
     }
 
-    state->pressed = !state->pressed;
-    state->counter = 0;
-    state->changed = true;
+    flip(state);
+}
+
+static void update_symmetric_global(struct zmk_debounce_state *state, const bool active,
+                                    const struct zmk_debounce_config *config) {
+    struct zmk_debounce_global *global = config->global;
+
+    // The counter holds the level read in the previous scan. Once no switch changed for the
+    // debounce time, every switch latches its level.
+    const bool level = state->counter != 0;
+
+    if (global->latch && level != state->pressed) {
+        state->pressed = level;
+        state->changed = true;
+    }
+
+    if (active != level) {
+        global->changed = true;
+    }
+
+    state->counter = active;
+}
+
+void zmk_debounce_update(struct zmk_debounce_state *state, const bool active, const int elapsed_ms,
+                         const struct zmk_debounce_config *config) {
+    state->changed = false;
+
+    switch (config->algorithm) {
+    case ZMK_DEBOUNCE_INTEGRATE:
+        update_integrate(state, active, elapsed_ms, config);
+        break;
+    case ZMK_DEBOUNCE_EAGER_PER_KEY:
+        update_eager(state, active, elapsed_ms, config);
+        break;
+    case ZMK_DEBOUNCE_DEFER_PER_KEY:
+        update_defer(state, active, elapsed_ms, config);
+        break;
+    case ZMK_DEBOUNCE_SYMMETRIC_GLOBAL:
+        update_symmetric_global(state, active, config);
+        break;
+    }
 }
 
 bool zmk_debounce_is_active(const struct zmk_debounce_state *state) {
@@ -59,4 +140,226 @@ bool zmk_debounce_is_active(const struct zmk_debounce_state *state) {
 
 bool zmk_debounce_is_pressed(const struct zmk_debounce_state *state) { return state->pressed; }
 
-bool zmk_debounce_get_changed(const struct zmk_debounce_state *state) { return state->changed; }
\ No newline at end of file
+bool zmk_debounce_get_changed(const struct zmk_debounce_state *state) { return state->changed; }
+
+void zmk_debounce_scan_begin(const struct zmk_debounce_config *config, const int elapsed_ms) {
+    struct zmk_debounce_global *global = config->global;
+
+    zmk_power_stats_record(ZMK_POWER_STATS_KSCAN_SCAN);
+
+    if (config->algorithm != ZMK_DEBOUNCE_SYMMETRIC_GLOBAL) {
+        return;
+    }
+
+    global->quiet_ms = MIN(global->quiet_ms + elapsed_ms, DEBOUNCE_COUNTER_MAX);
+    global->latch = global->pending && global->quiet_ms >= MIN(MAX(config->debounce_press_ms,
+                                                                   config->debounce_release_ms),
+                                                               DEBOUNCE_COUNTER_MAX);
+    global->changed = false;
+}
+
+void zmk_debounce_scan_end(const struct zmk_debounce_config *config) {
+    struct zmk_debounce_global *global = config->global;
+
+    if (config->algorithm != ZMK_DEBOUNCE_SYMMETRIC_GLOBAL) {
+        return;
+    }
+
+    if (global->latch) {
+        global->pending = false;
+    }
+
+    if (global->changed) {
+        global->pending = true;
+        global->quiet_ms = 0;
+    }
+}
+
+static uint32_t group_counter_nonzero(const struct zmk_debounce_group *group) {
+    uint32_t nonzero = 0;
+
+    for (int i = 0; i < DEBOUNCE_COUNTER_BITS; i++) {
+        nonzero |= group->counter[i];
+    }
+
+    return nonzero;
+}
+
+/**
+ * @returns a bit mask of the switches whose counter is less than value.
+ */
+static uint32_t group_counter_less(const struct zmk_debounce_group *group, const uint32_t value) {
+    if (value > DEBOUNCE_COUNTER_MAX) {
+        return UINT32_MAX;
+    }
+
+    // Compare from the most significant bit down, tracking which counters equal value so far.
+    uint32_t less = 0;
+    uint32_t equal = UINT32_MAX;
+
+    for (int i = DEBOUNCE_COUNTER_BITS - 1; i >= 0; i--) {
+        if (value & BIT(i)) {
+            less |= equal & ~group->counter[i];
+            equal &= group->counter[i];
+        } else {
+            equal &= ~group->counter[i];
+        }
+    }
+
+    return less;
+}
+
+static uint32_t group_below_threshold(const struct zmk_debounce_group *group,
+                                      const struct zmk_debounce_config *config) {
+    return (group->pressed & group_counter_less(group, config->debounce_release_ms)) |
+           (~group->pressed & group_counter_less(group, config->debounce_press_ms));
+}
+
+static uint32_t group_step(const int elapsed_ms) {
+    return CLAMP(elapsed_ms, 0, DEBOUNCE_COUNTER_MAX);
+}
+
+/**
+ * Sets the counters of the switches in mask to value.
+ */
+static void group_counter_set(struct zmk_debounce_group *group, const uint32_t mask,
+                              const uint32_t value) {
+    for (int i = 0; i < DEBOUNCE_COUNTER_BITS; i++) {
+        group->counter[i] = (group->counter[i] & ~mask) | ((value & BIT(i)) ? mask : 0);
+    }
+}
+
+/**
+ * Adds step to the counters of the switches in mask with ripple carry, saturating on overflow.
+ */
+static void group_counter_add(struct zmk_debounce_group *group, const uint32_t mask,
+                              const uint32_t step) {
+    uint32_t carry = 0;
+
+    for (int i = 0; i < DEBOUNCE_COUNTER_BITS; i++) {
+        const uint32_t counter = group->counter[i];
+        const uint32_t step_bit = (step & BIT(i)) ? mask : 0;
+        const uint32_t half = counter ^ step_bit;
+
+        group->counter[i] = half ^ carry;
+        carry = (counter & step_bit) | (carry & half);
+    }
+
+    for (int i = 0; i < DEBOUNCE_COUNTER_BITS; i++) {
+        group->counter[i] |= carry;
+    }
+}
+
+/**
+ * Subtracts step from the counters of the switches in mask with ripple borrow, stopping at zero.
+ */
+static void group_counter_subtract(struct zmk_debounce_group *group, const uint32_t mask,
+                                   const uint32_t step) {
+    uint32_t borrow = 0;
+
+    for (int i = 0; i < DEBOUNCE_COUNTER_BITS; i++) {
+        const uint32_t counter = group->counter[i];
+        const uint32_t step_bit = (step & BIT(i)) ? mask : 0;
+        const uint32_t half = counter ^ step_bit;
+
+        group->counter[i] = half ^ borrow;
+        borrow = (~counter & step_bit) | (~half & borrow);
+    }
+
+    for (int i = 0; i < DEBOUNCE_COUNTER_BITS; i++) {
+        group->counter[i] &= ~borrow;
+    }
+}
+
+static void group_flip(struct zmk_debounce_group *group, const uint32_t flip) {
+    group_counter_set(group, flip, 0);
+    group->pressed ^= flip;
+    group->changed = flip;
+}
+
+static void group_update_integrate(struct zmk_debounce_group *group, const uint32_t mismatch,
+                                   const int elapsed_ms, const struct zmk_debounce_config *config) {
+    const uint32_t below_threshold = group_below_threshold(group, config);
+
+    group_counter_subtract(group, ~mismatch, group_step(elapsed_ms));
+    group_counter_add(group, mismatch & below_threshold, group_step(elapsed_ms));
+    group_flip(group, mismatch & ~below_threshold);
+}
+
+static void group_update_eager(struct zmk_debounce_group *group, const uint32_t mismatch,
+                               const int elapsed_ms, const struct zmk_debounce_config *config) {
+    const uint32_t locked = group_counter_nonzero(group);
+    const uint32_t flip = mismatch & ~locked;
+
+    group_counter_subtract(group, locked, group_step(elapsed_ms));
+    group_flip(group, flip);
+    group_counter_set(group, flip & group->pressed, get_lockout(true, config));
+    group_counter_set(group, flip & ~group->pressed, get_lockout(false, config));
+}
+
+static void group_update_defer(struct zmk_debounce_group *group, const uint32_t mismatch,
+                               const int elapsed_ms, const struct zmk_debounce_config *config) {
+    const uint32_t below_threshold = group_below_threshold(group, config);
+
+    group_counter_set(group, ~mismatch, 0);
+    group_counter_add(group, mismatch & below_threshold, group_step(elapsed_ms));
+    group_flip(group, mismatch & ~below_threshold);
+}
+
+static void group_update_symmetric_global(struct zmk_debounce_group *group, const uint32_t active,
+                                          const struct zmk_debounce_config *config) {
+    struct zmk_debounce_global *global = config->global;
+    const uint32_t level = group->counter[0];
+    const uint32_t flip = global->latch ? level ^ group->pressed : 0;
+
+    group->pressed ^= flip;
+    group->changed = flip;
+
+    if (active != level) {
+        global->changed = true;
+    }
+
+    group->counter[0] = active;
+}
+
+void zmk_debounce_group_update(struct zmk_debounce_group *group, const uint32_t active,
+                               const int elapsed_ms, const struct zmk_debounce_config *config) {
+    // These are the same algorithms as zmk_debounce_update(), applied to every bit at once.
+    const uint32_t mismatch = active ^ group->pressed;
+
+    group->changed = 0;
+
+    // Nothing to do for the usual case of every switch settled where it is. The symmetric global
+    // algorithm keeps the last level in the counters instead, so it always needs the update.
+    if (config->algorithm != ZMK_DEBOUNCE_SYMMETRIC_GLOBAL && mismatch == 0 &&
+        group_counter_nonzero(group) == 0) {
+        return;
+    }
+
+    switch (config->algorithm) {
+    case ZMK_DEBOUNCE_INTEGRATE:
+        group_update_integrate(group, mismatch, elapsed_ms, config);
+        break;
+    case ZMK_DEBOUNCE_EAGER_PER_KEY:
+        group_update_eager(group, mismatch, elapsed_ms, config);
+        break;
+    case ZMK_DEBOUNCE_DEFER_PER_KEY:
+        group_update_defer(group, mismatch, elapsed_ms, config);
+        break;
+    case ZMK_DEBOUNCE_SYMMETRIC_GLOBAL:
+        group_update_symmetric_global(group, active, config);
+        break;
+    }
+}
+
+uint32_t zmk_debounce_group_get_active(const struct zmk_debounce_group *group) {
+    return group->pressed | group_counter_nonzero(group);
+}
+
+uint32_t zmk_debounce_group_get_pressed(const struct zmk_debounce_group *group) {
+    return group->pressed;
+}
+
+uint32_t zmk_debounce_group_get_changed(const struct zmk_debounce_group *group) {
+    return group->changed;
+}
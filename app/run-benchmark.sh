@@ -0,0 +1,33 @@
+#!/bin/sh
+
+# Copyright (c) 2024 The ZMK Contributors
+# SPDX-License-Identifier: MIT
+
+if [ -z "$1" ]; then
+    echo "Usage: ./run-benchmark.sh <path to benchmark>"
+    exit 1
+fi
+
+path="$1"
+if [ $path = "all" ]; then
+    path="benchmarks"
+fi
+
+# Benchmarks run one at a time, so they don't compete for the host's CPU.
+benchmarks=$(find $path -name native_posix_64.keymap -exec dirname \{\} \; | sort)
+err=0
+
+for benchmark in $benchmarks; do
+    west build -d build/$benchmark -b native_posix_64 -- -DZMK_CONFIG="$(pwd)/$benchmark" > /dev/null 2>&1
+    if [ $? -gt 0 ]; then
+        echo "FAILED: $benchmark did not build" >&2
+        err=1
+        continue
+    fi
+
+    # Each line of the results is a JSON object, tagged with the benchmark it came from.
+    ./build/$benchmark/zephyr/zmk.exe | sed -n -e "s/^zmk-benchmark {\(.*\)}$/{\"benchmark\":\"$(basename $benchmark)\",\1}/p" > build/$benchmark/benchmark.jsonl
+    cat build/$benchmark/benchmark.jsonl
+done
+
+exit $err
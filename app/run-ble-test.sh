@@ -89,10 +89,37 @@ do
   ${line} -s=${exe_name} | tee -a "${start_dir}/build/$testcase/output.log" > "${output_dev}" &
 done
 
-./bs_2G4_phy_v1 -s=${exe_name} -D=$(( 2 + central_counts )) -sim_length=50e6 > "${output_dev}" 2>&1
+# Test cases can set up the simulated radio channel, for example to attenuate it until packets
+# are lost. Lines starting with # are comments.
+phy_args=""
+if [ -e "${start_dir}/${testcase}/phy_args.txt" ]; then
+  phy_args=$(grep -v '^#' "${start_dir}/${testcase}/phy_args.txt")
+fi
+
+./bs_2G4_phy_v1 -s=${exe_name} -D=$(( 2 + central_counts )) -sim_length=50e6 ${phy_args} > "${output_dev}" 2>&1
 
 popd > /dev/null 2>&1
 
+# Test cases with a latency budget are checked against it instead of a snapshot, since their
+# timing is what they test.
+if [ -e $testcase/latency_budget.txt ]; then
+    python3 scripts/ble_latency.py build/$testcase/output.log $testcase/latency_budget.txt > build/$testcase/latency.log
+    err=$?
+    cat build/$testcase/latency.log > "${output_dev}"
+    if [ $err -gt 0 ]; then
+        if [ -f $testcase/pending ]; then
+            echo "PENDING: $testcase" | tee -a ./build/tests/pass-fail.log
+            exit 0
+        fi
+
+        echo "FAILED: $testcase" | tee -a ./build/tests/pass-fail.log
+        exit 1
+    fi
+
+    echo "PASS: $testcase" | tee -a ./build/tests/pass-fail.log
+    exit 0
+fi
+
 cat build/$testcase/output.log | sed -E -n -f $testcase/events.patterns > build/$testcase/filtered_output.log
 
 diff -auZ $testcase/snapshot.log build/$testcase/filtered_output.log
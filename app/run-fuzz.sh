@@ -0,0 +1,35 @@
+#!/bin/sh
+
+# Copyright (c) 2024 The ZMK Contributors
+# SPDX-License-Identifier: MIT
+
+if [ -z "$1" ]; then
+    echo "Usage: ./run-fuzz.sh <path to fuzz config> [behavior_fuzz.py options]"
+    exit 1
+fi
+
+path="$1"
+shift
+if [ $path = "all" ]; then
+    path="fuzz"
+fi
+
+fuzzers=$(find $path -name native_posix_64.keymap -exec dirname \{\} \; | sort)
+err=0
+
+for fuzz in $fuzzers; do
+    west build -d build/$fuzz -b native_posix_64 -- -DZMK_CONFIG="$(pwd)/$fuzz" > /dev/null 2>&1
+    if [ $? -gt 0 ]; then
+        echo "FAILED: $fuzz did not build" >&2
+        err=1
+        continue
+    fi
+
+    # Failing sequences are saved next to the build, named after the seed that generated them.
+    python3 scripts/behavior_fuzz.py build/$fuzz/zephyr/zmk.exe --name "$(basename $fuzz)" --failures-dir build/$fuzz "$@"
+    if [ $? -gt 0 ]; then
+        err=1
+    fi
+done
+
+exit $err
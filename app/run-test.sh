@@ -13,6 +13,15 @@ if [ $path = "all" ]; then
     path="tests"
 fi
 
+# Test cases differ almost only in their keymap, so most of each build compiles to the same
+# objects. With ccache set to ignore the build directory and rewrite paths relative to it, those
+# objects are compiled once and shared by every test case with the same Kconfig. This only works
+# because every build directory is at the same depth, which the flattened names below ensure.
+if command -v ccache > /dev/null 2>&1; then
+    export CCACHE_BASEDIR="${CCACHE_BASEDIR:-$(cd .. && pwd)}"
+    export CCACHE_NOHASHDIR=1
+fi
+
 testcases=$(find $path -name native_posix_64.keymap -exec dirname \{\} \;)
 num_cases=$(echo "$testcases" | wc -l)
 if [ $num_cases -gt 1 ] || [ "$testcases" != "$path" ]; then
@@ -26,13 +35,16 @@ fi
 testcase="$path"
 echo "Running $testcase:"
 
-west build -d build/$testcase -b native_posix_64 -- -DCONFIG_ASSERT=y -DZMK_CONFIG="$(pwd)/$testcase" > /dev/null 2>&1
+build_dir="build/test-builds/$(echo "$testcase" | tr '/' '-')"
+mkdir -p build/$testcase
+
+west build -d $build_dir -b native_posix_64 -- -DCONFIG_ASSERT=y -DZMK_CONFIG="$(pwd)/$testcase" > /dev/null 2>&1
 if [ $? -gt 0 ]; then
     echo "FAILED: $testcase did not build" | tee -a ./build/tests/pass-fail.log
     exit 1
 fi
 
-./build/$testcase/zephyr/zmk.exe | sed -e "s/.*> //" | tee build/$testcase/keycode_events_full.log | sed -n -f $testcase/events.patterns > build/$testcase/keycode_events.log
+./$build_dir/zephyr/zmk.exe | sed -e "s/.*> //" | tee build/$testcase/keycode_events_full.log | sed -n -f $testcase/events.patterns > build/$testcase/keycode_events.log
 diff -auZ $testcase/keycode_events.snapshot build/$testcase/keycode_events.log
 if [ $? -gt 0 ]; then
     if [ -f $testcase/pending ]; then
@@ -0,0 +1,241 @@
+# Copyright (c) 2024 The ZMK Contributors
+# SPDX-License-Identifier: MIT
+"""Replays random key sequences through a native ZMK build and checks invariants.
+
+Each run generates a legal sequence of presses and releases with random timing,
+where every key is released after it is pressed and all keys end up released,
+and replays it through the mock kscan with --kscan-trace. The debug log of the
+run is then checked for these invariants:
+
+- Every key event is processed, so none are dropped by the kscan queue.
+- Every keycode release follows a press of that keycode.
+- No keycode is still pressed once all keys have been up for the settle time.
+- No keycode event happens more than the settle time after the last key event,
+  so behaviors never hold on to captured events past their timeouts.
+
+The settle time has to be longer than every timeout in the keymap, and shorter
+than the second the mock kscan waits before exiting after the trace ends.
+
+With CONFIG_ZMK_BENCHMARK, the time spent processing key events is reported as
+key events per second. Failing sequences are saved as traces, which can be
+replayed with --kscan-trace or read with kscan_trace.py.
+"""
+
+import argparse
+import json
+import os
+import random
+import re
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from kscan_trace import MAGIC, RECORD  # noqa: E402
+
+LINE = re.compile(r"^\[(\d+):(\d+):(\d+)\.(\d+),(\d+)\] <\w+> \w+: (\w+): (.*)$")
+KEY_EVENT = re.compile(r"Row: (\d+), col: (\d+), position: (\d+), pressed: (\w+)")
+KEYCODE = re.compile(r"usage_page (0x[0-9A-Fa-f]+) keycode (0x[0-9A-Fa-f]+)")
+KEYCODE_FUNCTIONS = ("hid_listener_keycode_pressed", "hid_listener_keycode_released")
+BENCHMARK_PREFIX = "zmk-benchmark "
+
+# The keymap starts processing key events shortly after boot.
+START_MS = 100
+
+
+def generate(rng, args):
+    """Generates one sequence as (time_ms, row, column, pressed) tuples."""
+    positions = [(row, col) for row in range(args.rows) for col in range(args.columns)]
+    held = set()
+    events = []
+    time_ms = START_MS
+
+    for _ in range(args.events):
+        up = [pos for pos in positions if pos not in held]
+        if held and (len(held) >= args.max_held or rng.random() < 0.5):
+            pos = rng.choice(sorted(held))
+            held.remove(pos)
+            events.append((time_ms, *pos, False))
+        elif up:
+            pos = rng.choice(up)
+            held.add(pos)
+            events.append((time_ms, *pos, True))
+
+        # Mostly rolls and chords, with pauses around the keymap's timeouts and some
+        # long enough for everything to settle.
+        roll = rng.random()
+        if roll < 0.6:
+            time_ms += rng.randint(0, 40)
+        elif roll < 0.9:
+            time_ms += rng.randint(40, 300)
+        else:
+            time_ms += rng.randint(300, args.settle_ms + 200)
+
+    for pos in sorted(held):
+        events.append((time_ms, *pos, False))
+        time_ms += rng.randint(0, 40)
+
+    return events
+
+
+def write_trace(path, events):
+    with open(path, "wb") as f:
+        f.write(MAGIC)
+        for time_ms, row, column, pressed in events:
+            f.write(RECORD.pack(time_ms, row, column, pressed))
+
+
+def parse(output):
+    """Yields ("key", time_ms, pressed), ("keycode", time_ms, usage, pressed) and
+    ("benchmark", metric) entries from the output of a run."""
+    for line in output.splitlines():
+        if line.startswith(BENCHMARK_PREFIX):
+            yield "benchmark", json.loads(line[len(BENCHMARK_PREFIX) :])
+            continue
+
+        match = LINE.match(line)
+        if not match:
+            continue
+
+        hours, minutes, seconds, millis, micros = (int(match[i]) for i in range(1, 6))
+        seconds += (hours * 60 + minutes) * 60
+        time_ms = seconds * 1000 + millis + micros / 1000
+        function, message = match[6], match[7]
+
+        if function == "zmk_kscan_process_msgq":
+            key = KEY_EVENT.match(message)
+            if key:
+                yield "key", time_ms, key[4] == "true"
+        elif function in KEYCODE_FUNCTIONS:
+            keycode = KEYCODE.match(message)
+            if keycode:
+                usage = (int(keycode[1], 16), int(keycode[2], 16))
+                yield "keycode", time_ms, usage, function.endswith("pressed")
+
+
+def check(entries, expected_key_events, settle_ms):
+    """Checks the invariants, returning the failures and the benchmark metrics."""
+    failures = []
+    metrics = []
+    key_events = 0
+    keys_held = 0
+    last_key_ms = None
+    pressed = {}
+
+    def stuck():
+        return [f"0x{page:02X}/0x{id:02X}" for (page, id), n in pressed.items() if n]
+
+    for entry in entries:
+        if entry[0] == "benchmark":
+            metrics.append(entry[1])
+        elif entry[0] == "key":
+            _, time_ms, down = entry
+            if (
+                keys_held == 0
+                and last_key_ms is not None
+                and time_ms - last_key_ms >= settle_ms
+                and stuck()
+            ):
+                failures.append(f"{time_ms:.0f} ms: stuck after settling: {stuck()}")
+
+            key_events += 1
+            keys_held += 1 if down else -1
+            last_key_ms = time_ms
+        else:
+            _, time_ms, usage, down = entry
+            if last_key_ms is not None and time_ms - last_key_ms > settle_ms:
+                failures.append(
+                    f"{time_ms:.0f} ms: keycode event {time_ms - last_key_ms:.0f} ms "
+                    "after the last key event"
+                )
+
+            if down:
+                pressed[usage] = pressed.get(usage, 0) + 1
+            elif pressed.get(usage, 0) == 0:
+                failures.append(f"{time_ms:.0f} ms: release without press: {usage}")
+            else:
+                pressed[usage] -= 1
+
+    if key_events != expected_key_events:
+        failures.append(f"{key_events} of {expected_key_events} key events processed")
+    if stuck():
+        failures.append(f"stuck at the end: {stuck()}")
+
+    return failures, metrics
+
+
+def run(exe, trace, timeout):
+    completed = subprocess.run(
+        [exe, f"--kscan-trace={trace}"],
+        capture_output=True,
+        text=True,
+        errors="replace",
+        timeout=timeout,
+    )
+    return completed.returncode, completed.stdout
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter
+    )
+    parser.add_argument("exe", help="native_posix_64 zmk.exe to run")
+    parser.add_argument("--name", default="fuzz", help="name to tag the results with")
+    parser.add_argument("--runs", type=int, default=20, help="number of sequences")
+    parser.add_argument("--events", type=int, default=200, help="key events per run")
+    parser.add_argument("--seed", type=int, default=None, help="seed of the first run")
+    parser.add_argument("--settle-ms", type=int, default=500)
+    parser.add_argument("--rows", type=int, default=2)
+    parser.add_argument("--columns", type=int, default=2)
+    parser.add_argument("--max-held", type=int, default=3)
+    parser.add_argument("--timeout", type=int, default=120, help="seconds per run")
+    parser.add_argument(
+        "--failures-dir", default=".", help="directory to save failing traces in"
+    )
+    args = parser.parse_args()
+
+    seed = args.seed if args.seed is not None else random.randrange(2**32)
+    failed_runs = 0
+    total_events = 0
+    total_processing_ns = 0
+
+    with tempfile.TemporaryDirectory() as tmp:
+        for run_seed in range(seed, seed + args.runs):
+            events = generate(random.Random(run_seed), args)
+            trace = os.path.join(tmp, "fuzz.trace")
+            write_trace(trace, events)
+
+            returncode, output = run(args.exe, trace, args.timeout)
+            failures, metrics = check(parse(output), len(events), args.settle_ms)
+            if returncode != 0:
+                failures.append(f"exited with {returncode}")
+
+            for metric in metrics:
+                if metric.get("metric") == "key_event_ns":
+                    total_events += metric["count"]
+                    total_processing_ns += metric["count"] * metric["avg"]
+
+            if failures:
+                failed_runs += 1
+                saved = os.path.join(args.failures_dir, f"{args.name}-{run_seed}.trace")
+                write_trace(saved, events)
+                print(f"FAILED: {args.name} seed {run_seed}, saved as {saved}")
+                for failure in failures[:10]:
+                    print(f"  {failure}")
+
+    results = {
+        "fuzz": args.name,
+        "seed": seed,
+        "runs": args.runs,
+        "failed": failed_runs,
+    }
+    if total_processing_ns:
+        results["key_events"] = total_events
+        results["events_per_sec"] = round(total_events * 1e9 / total_processing_ns)
+    print(json.dumps(results))
+
+    return 1 if failed_runs else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,131 @@
+# Copyright (c) 2024 The ZMK Contributors
+# SPDX-License-Identifier: MIT
+"""Checks the key latency and notification rate of a BLE test run against a budget.
+
+Every device in a BabbleSim run shares the same simulated clock, which prefixes
+each line of the output. Each key event processed by the keyboard (device 0) is
+paired with the next report notification received by a central, oldest key
+event first, and the time between them is that event's latency.
+
+The budget file holds one budget per line, as a name and a value:
+
+    max_latency_ms <ms>            Longest any key event may take to arrive
+    avg_latency_ms <ms>            Longest the mean latency may be
+    min_notifications_per_sec <n>  Lowest rate notifications may arrive at,
+                                   from the first key event on
+"""
+
+import argparse
+import re
+import sys
+
+LINE = re.compile(r"^d_(\d+): @(\d+):(\d+):(\d+)\.(\d+)\s+(.*)$")
+KEY_EVENT = "zmk_kscan_process_msgq: Row:"
+NOTIFICATION = "notify_func: payload"
+
+
+def parse(log):
+    for line in log:
+        match = LINE.match(line)
+        if not match:
+            continue
+
+        device = int(match[1])
+        hours, minutes, seconds, micros = (int(match[i]) for i in range(2, 6))
+        time_ms = ((hours * 60 + minutes) * 60 + seconds) * 1000 + micros / 1000
+
+        if device == 0 and KEY_EVENT in match[6]:
+            yield time_ms, "key"
+        elif device != 0 and NOTIFICATION in match[6]:
+            yield time_ms, "notification"
+
+
+def measure(events):
+    pending = []
+    latencies = []
+    notifications = []
+
+    for time_ms, kind in sorted(events):
+        if kind == "key":
+            pending.append(time_ms)
+        elif pending:
+            latencies.append(time_ms - pending.pop(0))
+            notifications.append(time_ms)
+
+    results = {
+        "key_events": len(latencies) + len(pending),
+        "unanswered_key_events": len(pending),
+    }
+    if latencies:
+        span_ms = notifications[-1] - (notifications[0] - latencies[0])
+        results["max_latency_ms"] = max(latencies)
+        results["avg_latency_ms"] = sum(latencies) / len(latencies)
+        results["notifications_per_sec"] = (
+            len(notifications) * 1000 / span_ms if span_ms else 0
+        )
+
+    return results
+
+
+def check(results, budget):
+    failures = []
+
+    if results["key_events"] == 0:
+        failures.append("no key events were found in the output")
+    if results["unanswered_key_events"] > 0:
+        unanswered = results["unanswered_key_events"]
+        failures.append(f"{unanswered} key events never reached a central")
+
+    for name, limit in budget.items():
+        minimum = name.startswith("min_")
+        measured = name[len("min_") :] if minimum else name
+        if measured not in results:
+            continue
+
+        value = results[measured]
+        if minimum and value < limit:
+            failures.append(f"{measured} {value:.1f} is below {limit:g}")
+        elif not minimum and value > limit:
+            failures.append(f"{measured} {value:.1f} is above {limit:g}")
+
+    return failures
+
+
+def read_budget(path):
+    budget = {}
+    with open(path) as f:
+        for line in f:
+            line = line.split("#")[0].strip()
+            if line:
+                name, value = line.split()
+                budget[name] = float(value)
+
+    return budget
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter
+    )
+    parser.add_argument("log", help="combined output of the BabbleSim devices")
+    parser.add_argument("budget", help="file of latency budgets")
+    args = parser.parse_args()
+
+    with open(args.log) as log:
+        results = measure(parse(log))
+
+    for name, value in results.items():
+        if isinstance(value, float):
+            print(f"{name}: {value:.1f}")
+        else:
+            print(f"{name}: {value}")
+
+    failures = check(results, read_budget(args.budget))
+    for failure in failures:
+        print(f"over budget: {failure}")
+
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
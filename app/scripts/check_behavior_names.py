@@ -0,0 +1,55 @@
+# Copyright (c) 2024 The ZMK Contributors
+# SPDX-License-Identifier: MIT
+"""Checks that every enabled behavior in the devicetree has a unique name.
+
+Behaviors are looked up by their device name, which is the node's deprecated
+label property if it has one and its full node name otherwise, so two
+behaviors with the same name would make one of them unreachable.
+"""
+
+import argparse
+import pickle
+import sys
+
+
+def behavior_name(node):
+    label = node.props.get("label")
+    return label.val if label else node.name
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument(
+        "--edt-pickle", required=True, help="path to the pickled devicetree"
+    )
+    parser.add_argument(
+        "--dts-lib", required=True, help="path to Zephyr's python-devicetree source"
+    )
+    args = parser.parse_args()
+
+    # The pickle refers to edtlib's classes, so the library must be importable.
+    sys.path.insert(0, args.dts_lib)
+
+    with open(args.edt_pickle, "rb") as f:
+        edt = pickle.load(f)
+
+    paths_by_name = {}
+    for node in edt.nodes:
+        if node.status == "okay" and "#binding-cells" in node.props:
+            paths_by_name.setdefault(behavior_name(node), []).append(node.path)
+
+    ok = True
+    for name, paths in paths_by_name.items():
+        if len(paths) > 1:
+            print(
+                f"error: Multiple behaviors have the same name '{name}': "
+                + ", ".join(paths),
+                file=sys.stderr,
+            )
+            ok = False
+
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,397 @@
+# Copyright (c) 2024 The ZMK Contributors
+# SPDX-License-Identifier: MIT
+"""Reports the flash and RAM used by each ZMK source file and Kconfig feature.
+
+Sizes are read from the linker map, so only code and data that survived garbage
+collection are counted. Each ZMK object is matched to the source file it was
+built from through the CMakeLists.txt files of the app and its module, and the
+Kconfig option or condition that adds that file to the build is its feature.
+Everything else is counted per library.
+
+Flash is text, rodata and the initial values of data. RAM is data and bss,
+including noinit sections.
+
+With --baseline, the report is diffed against one saved earlier with --output,
+such as one from the same board built before a change.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+KINDS = ("text", "rodata", "data", "bss")
+ALWAYS = "(always)"
+
+CMAKE_COMMAND = re.compile(r"^\s*(\w+)\s*\((.*)\)\s*$")
+MAP_SECTION = re.compile(r"^ (\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$")
+MAP_SECTION_NAME = re.compile(r"^ (\S+)$")
+MAP_SECTION_PLACEMENT = re.compile(r"^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$")
+MAP_MEMORY = re.compile(r"^(\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s*(\w*)$")
+MAP_MEMBER = re.compile(r"^(.*)\((.*)\)$")
+IGNORED_SECTIONS = (".debug", ".comment", ".ARM.attributes", ".note", ".gnu.attributes")
+
+
+def read_config(path):
+    config = {}
+    with open(path) as f:
+        for line in f:
+            name, sep, value = line.strip().partition("=")
+            if sep and name.startswith("CONFIG_"):
+                config[name] = value.strip('"')
+
+    return config
+
+
+def evaluate(condition, config):
+    """Evaluates a CMake if() condition on Kconfig options. Conditions on
+    anything else are assumed to be met."""
+    tokens = re.findall(r"\(|\)|[^\s()]+", condition)
+    comparisons = {"GREATER": ">", "LESS": "<", "EQUAL": "=="}
+    expression = []
+
+    for i, token in enumerate(tokens):
+        compared = i + 1 < len(tokens) and tokens[i + 1] in comparisons
+        if token in ("(", ")") or token.isdigit():
+            expression.append(token)
+        elif token in ("NOT", "AND", "OR"):
+            expression.append(token.lower())
+        elif token in comparisons:
+            expression.append(comparisons[token])
+        elif token.startswith("CONFIG_") and compared:
+            expression.append(str(int(config.get(token, "0"), 0)))
+        elif token.startswith("CONFIG_"):
+            expression.append(str(config.get(token, "n") not in ("n", "0", "")))
+        else:
+            return True
+
+    try:
+        return bool(eval(" ".join(expression), {"__builtins__": {}}))
+    except (SyntaxError, ValueError):
+        return True
+
+
+def parse_cmake(path, config, sources, feature=None, enabled=True):
+    """Adds the sources of a CMakeLists.txt and the directories it adds to
+    sources, a mapping of file name to a list of (path, feature, built)."""
+    directory = os.path.dirname(path)
+    # The condition of each open if() block, and whether it is met.
+    blocks = []
+
+    def innermost():
+        return blocks[-1][0] if blocks else feature
+
+    def met():
+        return enabled and all(block_met for _, block_met in blocks)
+
+    def add(files, file_feature, built=True):
+        for name in files:
+            source = os.path.normpath(os.path.join(directory, name))
+            sources.setdefault(os.path.basename(source), []).append(
+                (source, file_feature or ALWAYS, met() and built)
+            )
+
+    with open(path) as f:
+        for line in f:
+            match = CMAKE_COMMAND.match(line.split("#")[0])
+            if not match:
+                continue
+
+            command, args = match[1], match[2].split()
+            ifdef = command.endswith("_ifdef")
+            option_set = ifdef and config.get(args[0], "n") != "n"
+
+            if command == "if":
+                condition = " ".join(args)
+                blocks.append((condition, evaluate(condition, config)))
+            elif command == "elseif" and blocks:
+                condition = " ".join(args)
+                _, previous_met = blocks.pop()
+                condition_met = not previous_met and evaluate(condition, config)
+                blocks.append((condition, condition_met))
+            elif command == "else" and blocks:
+                condition, previous_met = blocks.pop()
+                blocks.append((f"NOT ({condition})", not previous_met))
+            elif command == "endif" and blocks:
+                blocks.pop()
+            elif command == "target_sources":
+                add(args[2:], innermost())
+            elif command == "target_sources_ifdef":
+                add(args[3:], args[0], option_set)
+            elif command == "zephyr_library_sources":
+                add(args, innermost())
+            elif command == "zephyr_library_sources_ifdef":
+                add(args[1:], args[0], option_set)
+            elif command in ("add_subdirectory", "add_subdirectory_ifdef"):
+                subdirectory = os.path.join(directory, args[1] if ifdef else args[0])
+                cmake = os.path.join(subdirectory, "CMakeLists.txt")
+                if os.path.exists(cmake):
+                    parse_cmake(
+                        cmake,
+                        config,
+                        sources,
+                        args[0] if ifdef else innermost(),
+                        met() and (option_set or not ifdef),
+                    )
+
+    return sources
+
+
+def parse_map(path):
+    """Yields (object, section name, kind, size) for each input section in the
+    map, where object is (archive or None, object file)."""
+    writable = []
+    in_memory_map = False
+    output_section = None
+    pending = None
+
+    def kind(name, address):
+        if name.startswith(".text"):
+            return "text"
+        if name.startswith((".bss", ".noinit", "COMMON")):
+            return "bss"
+        if name.startswith(".data"):
+            return "data"
+        # Kernel objects and iterable sections which the linker places in RAM.
+        if any(start <= address < end for start, end in writable):
+            return "data"
+        return "rodata"
+
+    def placed(name, address, size, owner):
+        if size == 0 or output_section == "/DISCARD/":
+            return None
+        if name.startswith(IGNORED_SECTIONS) or name.startswith("*"):
+            return None
+
+        member = MAP_MEMBER.match(owner)
+        obj = (member[1], member[2]) if member else (None, owner)
+        return obj, name, kind(name, address), size
+
+    with open(path) as f:
+        for line in f:
+            line = line.rstrip("\n")
+            if not in_memory_map:
+                memory = MAP_MEMORY.match(line)
+                if memory and "w" in memory[4] and memory[1] != "*default*":
+                    start = int(memory[2], 16)
+                    writable.append((start, start + int(memory[3], 16)))
+                in_memory_map = line.startswith("Linker script and memory map")
+                continue
+
+            if pending:
+                placement = MAP_SECTION_PLACEMENT.match(line)
+                if placement:
+                    address, size = int(placement[1], 16), int(placement[2], 16)
+                    section = placed(pending, address, size, placement[3])
+                    if section:
+                        yield section
+                pending = None
+                continue
+
+            if line and not line[0].isspace():
+                output_section = line.split()[0]
+                continue
+
+            section = MAP_SECTION.match(line)
+            if section:
+                address, size = int(section[2], 16), int(section[3], 16)
+                result = placed(section[1], address, size, section[4])
+                if result:
+                    yield result
+                continue
+
+            name = MAP_SECTION_NAME.match(line)
+            if name:
+                pending = name[1]
+
+
+def object_sections(path):
+    """Returns the names of the sections in an object file, or None if it can't
+    be read."""
+    try:
+        from elftools.elf.elffile import ELFFile
+    except ImportError:
+        return None
+
+    try:
+        with open(path, "rb") as f:
+            return {section.name for section in ELFFile(f).iter_sections()}
+    except OSError:
+        return None
+
+
+def resolve(candidates, section, objects_dir, source_dir, cache):
+    """Picks which of several sources with the same file name an input section
+    comes from, by finding the section in their object files."""
+    for source, feature in candidates:
+        obj = os.path.join(objects_dir, os.path.relpath(source, source_dir) + ".obj")
+        if obj not in cache:
+            cache[obj] = object_sections(obj)
+        if cache[obj] is not None and section in cache[obj]:
+            return source, feature
+
+    names = " + ".join(os.path.relpath(source, source_dir) for source, _ in candidates)
+    features = " + ".join(sorted({feature for _, feature in candidates}))
+    return os.path.join(source_dir, names), features
+
+
+def measure(sections, sources, args):
+    """Sums the sections per ZMK source file, per ZMK feature and per library."""
+    files, features, libraries = {}, {}, {}
+    cache = {}
+
+    def add(table, key, kind, size):
+        sizes = table.setdefault(key, dict.fromkeys(KINDS, 0))
+        sizes[kind] += size
+
+    for (archive, obj), section, kind, size in sections:
+        name = os.path.basename(obj)
+        if name.endswith(".obj"):
+            name = name[: -len(".obj")]
+
+        built = [(path, feature) for path, feature, on in sources.get(name, []) if on]
+        is_app = archive is not None and os.path.basename(archive) == "libapp.a"
+        if not built and not is_app:
+            library = os.path.basename(archive) if archive else "(objects)"
+            add(libraries, library, kind, size)
+            continue
+
+        if len(built) == 1:
+            source, feature = built[0]
+        elif built:
+            source, feature = resolve(
+                built, section, args.objects_dir, args.source_dir, cache
+            )
+        else:
+            source, feature = os.path.join(args.source_dir, name), ALWAYS
+
+        add(files, os.path.relpath(source, args.source_dir), kind, size)
+        add(features, feature, kind, size)
+
+    return {"files": files, "features": features, "libraries": libraries}
+
+
+def totals(sizes):
+    return {
+        "flash": sizes["text"] + sizes["rodata"] + sizes["data"],
+        "ram": sizes["data"] + sizes["bss"],
+    }
+
+
+def summarize(report):
+    summary = {}
+    for group in ("files", "libraries"):
+        total = dict.fromkeys(KINDS, 0)
+        for sizes in report[group].values():
+            for kind in KINDS:
+                total[kind] += sizes[kind]
+        summary["zmk" if group == "files" else "other"] = total
+
+    summary["total"] = {
+        kind: summary["zmk"][kind] + summary["other"][kind] for kind in KINDS
+    }
+    return summary
+
+
+def print_table(title, table, baseline=None, limit=None):
+    columns = KINDS + ("flash", "ram")
+    rows = []
+    for name, sizes in table.items():
+        values = {**sizes, **totals(sizes)}
+        if baseline is not None:
+            old = baseline.get(name, dict.fromkeys(KINDS, 0))
+            old = {**old, **totals(old)}
+            delta = {column: values[column] - old[column] for column in columns}
+            rows.append((name, values, delta))
+        else:
+            rows.append((name, values, None))
+
+    if baseline is not None:
+        for name in baseline.keys() - table.keys():
+            old = {**baseline[name], **totals(baseline[name])}
+            values = {column: 0 for column in columns}
+            rows.append((name, values, {column: -old[column] for column in columns}))
+
+    rows.sort(key=lambda row: (-row[1]["flash"], row[0]))
+    if limit:
+        rows = rows[:limit]
+
+    width = max([len(title)] + [len(name) for name, _, _ in rows])
+    header = f"{title:<{width}}" + "".join(f" {column:>8}" for column in columns)
+    if baseline is not None:
+        header += f" {'flash +/-':>10} {'ram +/-':>9}"
+    print(header)
+
+    for name, values, delta in rows:
+        line = f"{name:<{width}}" + "".join(f" {values[c]:>8}" for c in columns)
+        if delta is not None:
+            line += f" {delta['flash']:>+10} {delta['ram']:>+9}"
+        print(line)
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter
+    )
+    parser.add_argument("--map", required=True, help="zephyr.map of the build")
+    parser.add_argument("--config", required=True, help=".config of the build")
+    parser.add_argument("--source-dir", required=True, help="ZMK app directory")
+    parser.add_argument(
+        "--objects-dir", default="", help="directory of the app target's objects"
+    )
+    parser.add_argument("--output", help="write the report as JSON to this file")
+    parser.add_argument("--baseline", help="report to diff against")
+    parser.add_argument(
+        "--max-growth",
+        type=int,
+        help="fail if the flash or RAM used by ZMK grew by more bytes than this",
+    )
+    parser.add_argument(
+        "--libraries", type=int, default=10, help="number of libraries to list"
+    )
+    args = parser.parse_args()
+    args.source_dir = os.path.abspath(args.source_dir)
+
+    config = read_config(args.config)
+    sources = {}
+    for cmake in ("CMakeLists.txt", "module/CMakeLists.txt"):
+        parse_cmake(os.path.join(args.source_dir, cmake), config, sources)
+
+    report = measure(parse_map(args.map), sources, args)
+    report["board"] = config.get("CONFIG_BOARD", "")
+    report["summary"] = summarize(report)
+
+    baseline = None
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+
+    def previous(group):
+        return baseline[group] if baseline is not None else None
+
+    print_table("ZMK source file", report["files"], previous("files"))
+    print_table("ZMK feature", report["features"], previous("features"))
+    print_table("Library", report["libraries"], previous("libraries"), args.libraries)
+    print_table("Summary", report["summary"], previous("summary"))
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(report, f, indent=2, sort_keys=True)
+            f.write("\n")
+
+    if baseline is not None and args.max_growth is not None:
+        now = totals(report["summary"]["zmk"])
+        before = totals(baseline["summary"]["zmk"])
+        for memory in ("flash", "ram"):
+            growth = now[memory] - before[memory]
+            if growth > args.max_growth:
+                print(f"ZMK {memory} grew by {growth} bytes, over {args.max_growth}")
+                return 1
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
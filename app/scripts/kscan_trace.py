@@ -0,0 +1,67 @@
+# Copyright (c) 2024 The ZMK Contributors
+# SPDX-License-Identifier: MIT
+"""Converts mock kscan traces between text and the binary --kscan-trace format.
+
+Each line of a text trace is one event: the milliseconds since the start of the
+trace, the row, the column, and "press" or "release", separated by whitespace or
+commas. Lines starting with "#" are ignored.
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = b"ZKT1"
+RECORD = struct.Struct("<IBBB")
+
+
+def encode(src, dst):
+    dst.write(MAGIC)
+    last = 0
+    for number, line in enumerate(src, 1):
+        line = line.strip()
+        if not line or line.startswith("#"):
+            continue
+
+        fields = line.replace(",", " ").split()
+        if len(fields) != 4 or fields[3] not in ("press", "release"):
+            sys.exit(f"line {number}: expected 'timestamp row column press|release'")
+
+        timestamp, row, column = (int(field) for field in fields[:3])
+        if timestamp < last:
+            sys.exit(f"line {number}: events must be in time order")
+        last = timestamp
+
+        dst.write(RECORD.pack(timestamp, row, column, fields[3] == "press"))
+
+
+def decode(src, dst):
+    if src.read(len(MAGIC)) != MAGIC:
+        sys.exit("not a kscan trace")
+
+    while record := src.read(RECORD.size):
+        if len(record) < RECORD.size:
+            sys.exit("trace ends with a partial record")
+
+        timestamp, row, column, pressed = RECORD.unpack(record)
+        state = "press" if pressed else "release"
+        dst.write(f"{timestamp} {row} {column} {state}\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("command", choices=["encode", "decode"])
+    parser.add_argument("input")
+    parser.add_argument("output")
+    args = parser.parse_args()
+
+    if args.command == "encode":
+        with open(args.input) as src, open(args.output, "wb") as dst:
+            encode(src, dst)
+    else:
+        with open(args.input, "rb") as src, open(args.output, "w") as dst:
+            decode(src, dst)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,394 @@
+# Copyright (c) 2024 The ZMK Contributors
+# SPDX-License-Identifier: MIT
+"""Latency measurement command for ZMK."""
+
+import argparse
+import json
+import math
+import os
+import random
+import select
+import sys
+import time
+
+from west.commands import WestCommand
+from west import log  # use this for user output
+
+RAW_HID_USAGE_PAGE = 0xFF60
+RAW_HID_USAGE = 0x61
+RAW_HID_REPORT_SIZE = 32
+RAW_HID_CMD_VERSION = 0x01
+RAW_HID_CMD_INJECT_KEY = 0x0D
+RAW_HID_INJECT_PROTOCOL_VERSION = 5
+
+# Round trips timed before measuring, to subtract half of one from every sample.
+ROUND_TRIPS = 10
+HISTOGRAM_ROWS = 20
+HISTOGRAM_WIDTH = 40
+
+
+class ChannelError(Exception):
+    pass
+
+
+class RawHidChannel:
+    """Injects key events through the raw HID interface."""
+
+    name = "raw-hid"
+
+    def __init__(self, vid, pid, timeout_ms):
+        try:
+            import hid
+        except ImportError:
+            log.die("The hidapi package is needed for raw HID: pip install hidapi")
+
+        devices = [
+            device
+            for device in hid.enumerate(vid or 0, pid or 0)
+            if device["usage_page"] == RAW_HID_USAGE_PAGE
+            and device["usage"] == RAW_HID_USAGE
+        ]
+        if not devices:
+            log.die("No keyboard with a ZMK raw HID interface was found")
+        if len(devices) > 1:
+            log.wrn("Several raw HID interfaces found, using the first one")
+
+        self.timeout_ms = timeout_ms
+        self.device = hid.device()
+        self.device.open_path(devices[0]["path"])
+
+    def close(self):
+        self.device.close()
+
+    def send(self, command, payload=b""):
+        report = bytes([command]) + payload
+        # The leading zero is the report ID, which hidapi always expects.
+        self.device.write(b"\0" + report.ljust(RAW_HID_REPORT_SIZE, b"\0"))
+        self.pending = command
+
+    def reply(self):
+        deadline = time.monotonic() + self.timeout_ms / 1000
+        while time.monotonic() < deadline:
+            report = bytes(self.device.read(RAW_HID_REPORT_SIZE, self.timeout_ms))
+            # Skip anything else the keyboard sends, such as streamed counters.
+            if report and report[0] == self.pending:
+                if report[1] != 0:
+                    raise ChannelError(f"command failed with error {report[1]}")
+                return report[2:]
+
+        raise ChannelError("no reply from the keyboard")
+
+    def ping(self):
+        self.send(RAW_HID_CMD_VERSION)
+        version = self.reply()[0]
+        if version < RAW_HID_INJECT_PROTOCOL_VERSION:
+            raise ChannelError(f"raw HID protocol {version} can't inject keys")
+
+    def inject(self, position, pressed):
+        payload = position.to_bytes(2, "little") + bytes([pressed])
+        self.send(RAW_HID_CMD_INJECT_KEY, payload)
+
+    def finish(self):
+        self.reply()
+
+
+class SerialChannel:
+    """Injects key events with the `zmk inject` command of the shell, such as over
+    CDC-ACM on a split peripheral."""
+
+    name = "serial"
+
+    def __init__(self, port, baud, timeout_ms):
+        try:
+            import serial
+        except ImportError:
+            log.die("The pyserial package is needed for serial: pip install pyserial")
+
+        self.timeout_ms = timeout_ms
+        self.port = serial.Serial(port, baud, timeout=0)
+        self.port.reset_input_buffer()
+
+    def close(self):
+        self.port.close()
+
+    def read_until(self, marker):
+        output = b""
+        deadline = time.monotonic() + self.timeout_ms / 1000
+        while time.monotonic() < deadline:
+            output += self.port.read(256)
+            if marker in output:
+                return output
+            time.sleep(0.001)
+
+        return output
+
+    def ping(self):
+        self.port.write(b"zmk inject ping\r")
+        if b"pong" not in self.read_until(b"pong"):
+            raise ChannelError("no reply from the shell, is CONFIG_ZMK_KEY_INJECT set?")
+
+    def inject(self, position, pressed):
+        action = "press" if pressed else "release"
+        self.port.write(f"zmk inject {action} {position}\r".encode())
+
+    def finish(self):
+        # The shell prints a prompt once the command is done, after any error.
+        output = self.read_until(b"$ ")
+        for error in (b"Failed", b"Invalid", b"command not found"):
+            if error in output:
+                raise ChannelError(output.decode(errors="replace").strip())
+
+
+class TerminalInput:
+    """Watches for the typed key in this terminal, which must have focus."""
+
+    clock = staticmethod(time.monotonic)
+
+    def __enter__(self):
+        import termios
+        import tty
+
+        self.fd = sys.stdin.fileno()
+        self.attrs = termios.tcgetattr(self.fd)
+        tty.setcbreak(self.fd)
+        return self
+
+    def __exit__(self, *exc):
+        import termios
+
+        termios.tcsetattr(self.fd, termios.TCSADRAIN, self.attrs)
+
+    def drain(self):
+        while select.select([self.fd], [], [], 0)[0]:
+            os.read(self.fd, 64)
+
+    def wait(self, timeout):
+        if select.select([self.fd], [], [], timeout)[0]:
+            arrived = self.clock()
+            os.read(self.fd, 64)
+            return arrived
+        return None
+
+
+class EvdevInput:
+    """Watches for key presses on a Linux input device, using the kernel's timestamps
+    of each event. The terminal does not need focus."""
+
+    clock = staticmethod(time.time)
+
+    def __init__(self, path):
+        try:
+            import evdev
+        except ImportError:
+            log.die("The evdev package is needed for --evdev: pip install evdev")
+
+        self.evdev = evdev
+        self.device = evdev.InputDevice(path)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.device.close()
+
+    def drain(self):
+        while select.select([self.device.fd], [], [], 0)[0]:
+            list(self.device.read())
+
+    def wait(self, timeout):
+        deadline = time.monotonic() + timeout
+        while select.select([self.device.fd], [], [], deadline - time.monotonic())[0]:
+            for event in self.device.read():
+                if event.type == self.evdev.ecodes.EV_KEY and event.value == 1:
+                    return event.timestamp()
+            if time.monotonic() >= deadline:
+                break
+        return None
+
+
+def percentile(values, fraction):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+
+def summarize(label, latencies, lost, round_trip_ms):
+    result = {
+        "label": label,
+        "samples": len(latencies),
+        "lost": lost,
+        "round_trip_ms": round(round_trip_ms, 3),
+    }
+    if latencies:
+        result.update(
+            {
+                "min_ms": round(min(latencies), 3),
+                "p50_ms": round(percentile(latencies, 0.5), 3),
+                "p90_ms": round(percentile(latencies, 0.9), 3),
+                "p99_ms": round(percentile(latencies, 0.99), 3),
+                "max_ms": round(max(latencies), 3),
+                "mean_ms": round(sum(latencies) / len(latencies), 3),
+            }
+        )
+    return result
+
+
+def print_histogram(latencies):
+    low, high = math.floor(min(latencies)), math.floor(max(latencies)) + 1
+    width = max(1, -(-(high - low) // HISTOGRAM_ROWS))
+    buckets = [0] * (-(-(high - low) // width))
+    for latency in latencies:
+        buckets[min(len(buckets) - 1, int((latency - low) // width))] += 1
+
+    most = max(buckets)
+    for i, count in enumerate(buckets):
+        start = low + i * width
+        bar = "#" * round(count * HISTOGRAM_WIDTH / most)
+        log.inf(f"{start:>5}-{start + width:<5} ms |{bar} {count}")
+
+
+def print_comparison(results):
+    columns = ("samples", "lost", "min_ms", "p50_ms", "p90_ms", "p99_ms", "max_ms")
+    width = max([len("label")] + [len(result["label"]) for result in results])
+    log.inf(f"{'label':<{width}}" + "".join(f" {column:>8}" for column in columns))
+    for result in results:
+        values = "".join(f" {result.get(column, '-'):>8}" for column in columns)
+        log.inf(f"{result['label']:<{width}}{values}")
+
+
+class Latency(WestCommand):
+    def __init__(self):
+        super().__init__(
+            name="latency",
+            help="measure key latency from the keyboard to the host",
+            description="Inject key presses into firmware built with "
+            "CONFIG_ZMK_KEY_INJECT and time their arrival on the host.",
+        )
+
+    def do_add_parser(self, parser_adder):
+        parser = parser_adder.add_parser(
+            self.name,
+            help=self.help,
+            description=self.description,
+            formatter_class=argparse.RawDescriptionHelpFormatter,
+            epilog="""\
+Each sample presses and releases a key position through the raw HID interface or
+the shell, then waits for the key to arrive on the host, either typed into this
+terminal or read from a Linux input device with --evdev. Pick a position bound to
+a plain key, such as a letter. Half of the round trip of a command to the keyboard
+is subtracted from each sample, so the latency is counted from when the keyboard
+receives the injected key.
+
+The report can leave over USB or BLE whichever channel injects the key, and a key
+injected on a split peripheral crosses the split link first, so run once per path
+with a --label for each and the same --output file to compare them.""",
+        )
+
+        parser.add_argument(
+            "-p", "--position", type=int, required=True, help="key position to press"
+        )
+        parser.add_argument(
+            "--serial",
+            metavar="PORT",
+            help="inject with the shell on this serial port instead of raw HID",
+        )
+        parser.add_argument(
+            "--baud", type=int, default=115200, help="baud rate of the serial port"
+        )
+        parser.add_argument(
+            "--vid", type=lambda x: int(x, 0), help="USB vendor ID for raw HID"
+        )
+        parser.add_argument(
+            "--pid", type=lambda x: int(x, 0), help="USB product ID for raw HID"
+        )
+        parser.add_argument(
+            "--evdev",
+            metavar="DEVICE",
+            help="read key presses from this input device instead of the terminal",
+        )
+        parser.add_argument(
+            "-n", "--samples", type=int, default=100, help="number of key presses"
+        )
+        parser.add_argument(
+            "--interval-ms",
+            type=int,
+            default=100,
+            help="least time between samples, a random delay up to as long again "
+            "is added so samples land at every point of the USB and BLE intervals",
+        )
+        parser.add_argument(
+            "--timeout-ms",
+            type=int,
+            default=500,
+            help="how long to wait for each key before counting it as lost",
+        )
+        parser.add_argument("--label", help="name of the path being measured")
+        parser.add_argument(
+            "-o", "--output", help="append the results to this JSON lines file"
+        )
+        return parser
+
+    def do_run(self, args, unknown_args):
+        if args.serial:
+            channel = SerialChannel(args.serial, args.baud, args.timeout_ms)
+        else:
+            channel = RawHidChannel(args.vid, args.pid, args.timeout_ms)
+
+        watcher = EvdevInput(args.evdev) if args.evdev else TerminalInput()
+        label = args.label or channel.name
+
+        try:
+            with watcher:
+                result, latencies = self.measure(args, channel, watcher, label)
+        except ChannelError as e:
+            log.die(str(e))
+        finally:
+            channel.close()
+
+        log.inf(
+            f"{label}: {result['samples']} samples, {result['lost']} lost, "
+            f"{result['round_trip_ms']:.2f} ms round trip"
+        )
+        if latencies:
+            log.inf(
+                f"min {result['min_ms']:.2f}  p50 {result['p50_ms']:.2f}  "
+                f"p90 {result['p90_ms']:.2f}  p99 {result['p99_ms']:.2f}  "
+                f"max {result['max_ms']:.2f}  mean {result['mean_ms']:.2f} ms"
+            )
+            print_histogram(latencies)
+
+        if args.output:
+            with open(args.output, "a") as f:
+                f.write(json.dumps({**result, "latencies_ms": latencies}) + "\n")
+            with open(args.output) as f:
+                print_comparison([json.loads(line) for line in f if line.strip()])
+
+    @staticmethod
+    def measure(args, channel, watcher, label):
+        round_trips = []
+        for _ in range(ROUND_TRIPS):
+            start = time.monotonic()
+            channel.ping()
+            round_trips.append((time.monotonic() - start) * 1000)
+        round_trip_ms = percentile(round_trips, 0.5)
+
+        latencies = []
+        lost = 0
+        log.inf(f"Measuring {args.samples} key presses of position {args.position}")
+
+        for _ in range(args.samples):
+            watcher.drain()
+            sent = watcher.clock()
+            channel.inject(args.position, True)
+            arrived = watcher.wait(args.timeout_ms / 1000)
+            channel.finish()
+            channel.inject(args.position, False)
+            channel.finish()
+
+            if arrived is None:
+                lost += 1
+            else:
+                latencies.append(round((arrived - sent) * 1000 - round_trip_ms / 2, 3))
+
+            time.sleep((args.interval_ms + random.uniform(0, args.interval_ms)) / 1000)
+
+        return summarize(label, latencies, lost, round_trip_ms), latencies
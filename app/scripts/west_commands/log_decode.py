@@ -0,0 +1,69 @@
+# Copyright (c) 2024 The ZMK Contributors
+# SPDX-License-Identifier: MIT
+"""Log decoding command for ZMK."""
+
+import os
+import subprocess
+import sys
+
+from west.commands import WestCommand
+from west import log  # use this for user output
+
+
+class LogDecode(WestCommand):
+    def __init__(self):
+        super().__init__(
+            name="log-decode",
+            help="decode dictionary based ZMK logs",
+            description="Decode a log captured from firmware built with "
+            "CONFIG_ZMK_LOGGING_DICTIONARY.",
+        )
+
+    def do_add_parser(self, parser_adder):
+        parser = parser_adder.add_parser(
+            self.name, help=self.help, description=self.description
+        )
+
+        parser.add_argument(
+            "-d",
+            "--build-dir",
+            default="build",
+            help='The build directory of the firmware. Defaults to "build".',
+        )
+        parser.add_argument("log", help="The file holding the captured log.")
+        return parser
+
+    def do_run(self, args, unknown_args):
+        zephyr_dir = os.path.join(args.build_dir, "zephyr")
+        database = os.path.join(zephyr_dir, "log_dictionary.json")
+        if not os.path.exists(database):
+            log.die(
+                f"{database} not found, was the firmware built with "
+                "CONFIG_ZMK_LOGGING_DICTIONARY?"
+            )
+
+        parser_args = []
+        if self.is_hex_output(zephyr_dir):
+            parser_args.append("--hex")
+
+        zephyr_base = os.environ.get("ZEPHYR_BASE", f"{self.topdir}/zephyr")
+        completed_process = subprocess.run(
+            [
+                sys.executable,
+                f"{zephyr_base}/scripts/logging/dictionary/log_parser.py",
+                *parser_args,
+                database,
+                args.log,
+            ]
+        )
+        exit(completed_process.returncode)
+
+    @staticmethod
+    def is_hex_output(zephyr_dir):
+        # The UART backend can write the binary log as hex characters, which the parser
+        # has to be told about. RTT always carries it as is.
+        with open(os.path.join(zephyr_dir, ".config")) as config:
+            return any(
+                line.strip() == "CONFIG_LOG_BACKEND_UART_OUTPUT_DICTIONARY_HEX=y"
+                for line in config
+            )
@@ -21,9 +21,11 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 #include <zmk/pm.h>
 
 #include <zmk/activity.h>
+#include <zmk/boot_timing.h>
 
 #if IS_ENABLED(CONFIG_USB_DEVICE_STACK)
 #include <zmk/usb.h>
+#include <zmk/events/usb_conn_state_changed.h>
 #endif
 
 bool is_usb_power_present(void) {
@@ -36,7 +38,7 @@ bool is_usb_power_present(void) {
 
 static enum zmk_activity_state activity_state;
 
-static uint32_t activity_last_uptime;
+static int64_t activity_last_uptime;
 
 #define MAX_IDLE_MS CONFIG_ZMK_IDLE_TIMEOUT
 
@@ -59,49 +61,156 @@ int set_state(enum zmk_activity_state state) {
 
 enum zmk_activity_state zmk_activity_get_state(void) { return activity_state; }
 
+static struct k_work_delayable activity_work;
+
+#if IS_ENABLED(CONFIG_ZMK_SLEEP_RETAIN_RAM)
+/** Whether devices are suspended for a sleep which keeps running from RAM. */
+static bool activity_suspended;
+
+static void activity_schedule_check(void);
+
+/**
+ * Finish waking once the wake key press has been handled, by resuming the devices left suspended
+ * and only then reporting the active state to the displays and lighting which use them.
+ */
+static void activity_resume_work_handler(struct k_work *work) {
+    zmk_pm_resume_devices();
+
+    set_state(ZMK_ACTIVITY_ACTIVE);
+    activity_schedule_check();
+}
+
+static K_WORK_DEFINE(activity_resume_work, activity_resume_work_handler);
+#endif
+
+/**
+ * Schedule the next check of the activity state for when the keyboard will have been inactive for
+ * long enough to change state, or for never if no more changes are due. Nothing runs periodically,
+ * so a keyboard which is idle and cannot sleep has no wakeups at all.
+ */
+static void activity_schedule_check(void) {
+    int32_t timeout_ms = -1;
+
+#if IS_ENABLED(CONFIG_ZMK_SLEEP_RETAIN_RAM)
+    // Nothing follows sleep. The next activity resumes the devices.
+    if (activity_suspended) {
+        k_work_cancel_delayable(&activity_work);
+        return;
+    }
+#endif
+
+    if (activity_state == ZMK_ACTIVITY_ACTIVE) {
+        timeout_ms = MAX_IDLE_MS;
+    }
+
+#if IS_ENABLED(CONFIG_ZMK_SLEEP)
+    // With USB power present the keyboard won't sleep, so wait for it to be removed instead.
+    if (!is_usb_power_present() && (timeout_ms < 0 || MAX_SLEEP_MS < timeout_ms)) {
+        timeout_ms = MAX_SLEEP_MS;
+    }
+#endif
+
+    if (timeout_ms < 0) {
+        k_work_cancel_delayable(&activity_work);
+        return;
+    }
+
+    // States change once the inactive time is strictly greater than their timeout.
+    k_work_reschedule(&activity_work, K_TIMEOUT_ABS_MS(activity_last_uptime + timeout_ms + 1));
+}
+
 int activity_event_listener(const zmk_event_t *eh) {
+#if IS_ENABLED(CONFIG_USB_DEVICE_STACK)
+    if (as_zmk_usb_conn_state_changed(eh)) {
+        // Not activity, but removing USB power can allow the keyboard to sleep.
+        activity_schedule_check();
+        return ZMK_EV_EVENT_BUBBLE;
+    }
+#endif
+
+    // This runs for every key press, so while active it only records the time. The scheduled check
+    // notices the new time when it runs, and reschedules itself instead of going idle.
     activity_last_uptime = k_uptime_get();
 
-    return set_state(ZMK_ACTIVITY_ACTIVE);
+    if (activity_state == ZMK_ACTIVITY_ACTIVE) {
+        return ZMK_EV_EVENT_BUBBLE;
+    }
+
+#if IS_ENABLED(CONFIG_ZMK_SLEEP_RETAIN_RAM)
+    if (activity_suspended) {
+        // The wake key press is already being processed, since the kscan device kept running.
+        // Resume only what it needs now, and the rest once it has been handled.
+        activity_suspended = false;
+        zmk_pm_resume_critical_devices();
+        k_work_submit(&activity_resume_work);
+        return ZMK_EV_EVENT_BUBBLE;
+    }
+
+    if (k_work_is_pending(&activity_resume_work)) {
+        return ZMK_EV_EVENT_BUBBLE;
+    }
+#endif
+
+    int ret = set_state(ZMK_ACTIVITY_ACTIVE);
+    activity_schedule_check();
+
+    return ret;
 }
 
 void activity_work_handler(struct k_work *work) {
-    int32_t current = k_uptime_get();
-    int32_t inactive_time = current - activity_last_uptime;
+#if IS_ENABLED(CONFIG_ZMK_SLEEP_RETAIN_RAM)
+    if (activity_suspended) {
+        return;
+    }
+#endif
+
+    int32_t inactive_time = k_uptime_get() - activity_last_uptime;
 #if IS_ENABLED(CONFIG_ZMK_SLEEP)
     if (inactive_time > MAX_SLEEP_MS && !is_usb_power_present()) {
         // Put devices in suspend power mode before sleeping
         set_state(ZMK_ACTIVITY_SLEEP);
 
+        // Reports and settings still waiting to go out would be lost if power is removed while
+        // asleep.
+        zmk_pm_flush_pending();
+
         if (zmk_pm_suspend_devices() < 0) {
             LOG_ERR("Failed to suspend all the devices");
             zmk_pm_resume_devices();
+            k_work_reschedule(&activity_work, K_SECONDS(1));
             return;
         }
 
+#if IS_ENABLED(CONFIG_ZMK_SLEEP_RETAIN_RAM)
+        // Stay in System ON with everything in RAM. With nothing left to run, the CPU idles until
+        // a wakeup source such as the kscan device reports activity.
+        activity_suspended = true;
+        return;
+#else
         sys_poweroff();
+#endif
     } else
 #endif /* IS_ENABLED(CONFIG_ZMK_SLEEP) */
         if (inactive_time > MAX_IDLE_MS) {
             set_state(ZMK_ACTIVITY_IDLE);
         }
-}
-
-K_WORK_DEFINE(activity_work, activity_work_handler);
 
-void activity_expiry_function(struct k_timer *_timer) { k_work_submit(&activity_work); }
-
-K_TIMER_DEFINE(activity_timer, activity_expiry_function, NULL);
+    activity_schedule_check();
+}
 
 static int activity_init(void) {
     activity_last_uptime = k_uptime_get();
 
-    k_timer_start(&activity_timer, K_SECONDS(1), K_SECONDS(1));
+    k_work_init_delayable(&activity_work, activity_work_handler);
+    activity_schedule_check();
     return 0;
 }
 
 ZMK_LISTENER(activity, activity_event_listener);
 ZMK_SUBSCRIPTION(activity, zmk_position_state_changed);
 ZMK_SUBSCRIPTION(activity, zmk_sensor_event);
+#if IS_ENABLED(CONFIG_USB_DEVICE_STACK)
+ZMK_SUBSCRIPTION(activity, zmk_usb_conn_state_changed);
+#endif
 
-SYS_INIT(activity_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+ZMK_SYS_INIT(activity_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -15,6 +15,9 @@
 
 #include <zmk/activity.h>
 #include <zmk/backlight.h>
+#include <zmk/deferred_init.h>
+#include <zmk/ext_power.h>
+#include <zmk/settings.h>
 #include <zmk/usb.h>
 #include <zmk/event_manager.h>
 #include <zmk/events/activity_state_changed.h>
@@ -42,10 +45,10 @@ struct backlight_state {
 static struct backlight_state state = {.brightness = CONFIG_ZMK_BACKLIGHT_BRT_START,
                                        .on = IS_ENABLED(CONFIG_ZMK_BACKLIGHT_ON_START)};
 
-static int zmk_backlight_update(void) {
-    uint8_t brt = zmk_backlight_get_brt();
-    LOG_DBG("Update backlight brightness: %d%%", brt);
+// The brightness the LEDs are currently set to, which differs from the state while fading.
+static uint8_t shown_brt;
 
+static int set_backlight_leds(uint8_t brt) {
     for (int i = 0; i < BACKLIGHT_NUM_LEDS; i++) {
         int rc = led_set_brightness(backlight_dev, i, brt);
         if (rc != 0) {
@@ -53,9 +56,84 @@ static int zmk_backlight_update(void) {
             return rc;
         }
     }
+
+    shown_brt = brt;
     return 0;
 }
 
+#if CONFIG_ZMK_BACKLIGHT_FADE_MS > 0
+
+// Fades follow the curve at this interval, but only set the LEDs when the brightness changes.
+#define FADE_INTERVAL_MS 20
+#define FADE_PROGRESS_MAX 1000
+
+// Set after init, so the backlight starts at the restored brightness rather than fading in.
+static bool fade_enabled;
+static uint8_t fade_from;
+static uint8_t fade_to;
+static int64_t fade_start;
+
+static uint32_t fade_ease(uint32_t progress) {
+#if IS_ENABLED(CONFIG_ZMK_BACKLIGHT_FADE_CURVE_EASE_IN_OUT)
+    // Smoothstep, 3t^2 - 2t^3, scaled to FADE_PROGRESS_MAX.
+    return progress * progress * (3 * FADE_PROGRESS_MAX - 2 * progress) /
+           (FADE_PROGRESS_MAX * FADE_PROGRESS_MAX);
+#else
+    return progress;
+#endif
+}
+
+static void backlight_fade_work_cb(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(backlight_fade_work, backlight_fade_work_cb);
+
+static void backlight_fade_work_cb(struct k_work *work) {
+    int64_t elapsed = k_uptime_get() - fade_start;
+
+    if (elapsed >= CONFIG_ZMK_BACKLIGHT_FADE_MS) {
+        set_backlight_leds(fade_to);
+        return;
+    }
+
+    uint32_t progress = fade_ease(elapsed * FADE_PROGRESS_MAX / CONFIG_ZMK_BACKLIGHT_FADE_MS);
+    uint8_t brt = fade_from + ((int)fade_to - fade_from) * (int)progress / FADE_PROGRESS_MAX;
+
+    if (brt == shown_brt || set_backlight_leds(brt) == 0) {
+        k_work_schedule(&backlight_fade_work, K_MSEC(FADE_INTERVAL_MS));
+    }
+}
+
+static void start_backlight_fade(uint8_t brt) {
+    // A fade which is still running continues from the brightness it reached.
+    fade_from = shown_brt;
+    fade_to = brt;
+    fade_start = k_uptime_get();
+
+    k_work_reschedule(&backlight_fade_work, K_NO_WAIT);
+}
+
+#endif // CONFIG_ZMK_BACKLIGHT_FADE_MS > 0
+
+static int zmk_backlight_update(void) {
+    uint8_t brt = zmk_backlight_get_brt();
+    LOG_DBG("Update backlight brightness: %d%%", brt);
+
+    zmk_ext_power_auto_off_update();
+
+#if CONFIG_ZMK_BACKLIGHT_FADE_MS > 0
+    if (fade_enabled) {
+        if (brt == shown_brt) {
+            k_work_cancel_delayable(&backlight_fade_work);
+        } else {
+            start_backlight_fade(brt);
+        }
+        return 0;
+    }
+#endif
+
+    return set_backlight_leds(brt);
+}
+
 #if IS_ENABLED(CONFIG_SETTINGS)
 static int backlight_settings_load_cb(const char *name, size_t len, settings_read_cb read_cb,
                                       void *cb_arg, void *param) {
@@ -70,12 +148,6 @@ static int backlight_settings_load_cb(const char *name, size_t len, settings_rea
     }
     return -ENOENT;
 }
-
-static void backlight_save_work_handler(struct k_work *work) {
-    settings_save_one("backlight/state", &state, sizeof(state));
-}
-
-static struct k_work_delayable backlight_save_work;
 #endif
 
 static int zmk_backlight_init(void) {
@@ -86,16 +158,21 @@ static int zmk_backlight_init(void) {
 
 #if IS_ENABLED(CONFIG_SETTINGS)
     settings_subsys_init();
-    int rc = settings_load_subtree_direct("backlight", backlight_settings_load_cb, NULL);
+    int rc = zmk_settings_load_subtree_direct("backlight", backlight_settings_load_cb, NULL);
     if (rc != 0) {
         LOG_ERR("Failed to load backlight settings: %d", rc);
     }
-    k_work_init_delayable(&backlight_save_work, backlight_save_work_handler);
 #endif
 #if IS_ENABLED(CONFIG_ZMK_BACKLIGHT_AUTO_OFF_USB)
     state.on = zmk_usb_is_powered();
 #endif
-    return zmk_backlight_update();
+    int err = zmk_backlight_update();
+
+#if CONFIG_ZMK_BACKLIGHT_FADE_MS > 0
+    fade_enabled = true;
+#endif
+
+    return err;
 }
 
 static int zmk_backlight_update_and_save(void) {
@@ -104,12 +181,7 @@ static int zmk_backlight_update_and_save(void) {
         return rc;
     }
 
-#if IS_ENABLED(CONFIG_SETTINGS)
-    int ret = k_work_reschedule(&backlight_save_work, K_MSEC(CONFIG_ZMK_SETTINGS_SAVE_DEBOUNCE));
-    return MIN(ret, 0);
-#else
-    return 0;
-#endif
+    return zmk_settings_save("backlight/state", &state, sizeof(state));
 }
 
 int zmk_backlight_on(void) {
@@ -189,4 +261,4 @@ ZMK_SUBSCRIPTION(backlight, zmk_activity_state_changed);
 ZMK_SUBSCRIPTION(backlight, zmk_usb_conn_state_changed);
 #endif
 
-SYS_INIT(zmk_backlight_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+ZMK_DEFERRED_INIT(zmk_backlight_init, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -15,17 +15,73 @@
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
+#include <zmk/deferred_init.h>
 #include <zmk/event_manager.h>
 #include <zmk/battery.h>
 #include <zmk/events/battery_state_changed.h>
 #include <zmk/events/activity_state_changed.h>
 #include <zmk/activity.h>
+#include <zmk/power_stats.h>
 #include <zmk/workqueue.h>
 
+#if IS_ENABLED(CONFIG_ZMK_BATTERY_REPORTING_FETCH_MODE_LITHIUM_ESTIMATE)
+#if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW)
+#include <zmk/rgb_underglow.h>
+#endif
+#if IS_ENABLED(CONFIG_ZMK_BACKLIGHT)
+#include <zmk/backlight.h>
+#endif
+#endif
+
 static uint8_t last_state_of_charge = 0;
 
 uint8_t zmk_battery_state_of_charge(void) { return last_state_of_charge; }
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_PERIPHERAL_BATTERY_LEVEL_FILTER)
+
+static bool bas_level_reported = false;
+static uint8_t bas_reported_level;
+static int64_t bas_reported_at;
+
+// A split peripheral's BAS notifications share the link with key events, so small changes are
+// held back until they exceed the hysteresis and the minimum interval has passed. Reaching empty
+// or full is always reported.
+static bool bas_should_report(uint8_t level) {
+    if (!bas_level_reported) {
+        return true;
+    }
+
+    if (level == bas_reported_level) {
+        return false;
+    }
+
+    if (level == 0 || level == 100) {
+        return true;
+    }
+
+    int delta = (int)level - (int)bas_reported_level;
+    if (delta < CONFIG_ZMK_SPLIT_BLE_PERIPHERAL_BATTERY_LEVEL_HYSTERESIS &&
+        -delta < CONFIG_ZMK_SPLIT_BLE_PERIPHERAL_BATTERY_LEVEL_HYSTERESIS) {
+        return false;
+    }
+
+    return k_uptime_get() - bas_reported_at >=
+           CONFIG_ZMK_SPLIT_BLE_PERIPHERAL_BATTERY_LEVEL_MIN_INTERVAL * MSEC_PER_SEC;
+}
+
+static void bas_mark_reported(uint8_t level) {
+    bas_level_reported = true;
+    bas_reported_level = level;
+    bas_reported_at = k_uptime_get();
+}
+
+#else
+
+static inline bool bas_should_report(uint8_t level) { return true; }
+static inline void bas_mark_reported(uint8_t level) {}
+
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_PERIPHERAL_BATTERY_LEVEL_FILTER)
+
 #if DT_HAS_CHOSEN(zmk_battery)
 static const struct device *const battery = DEVICE_DT_GET(DT_CHOSEN(zmk_battery));
 #else
@@ -50,10 +106,121 @@ static uint8_t lithium_ion_mv_to_pct(int16_t bat_mv) {
 
 #endif // IS_ENABLED(CONFIG_ZMK_BATTERY_REPORTING_FETCH_MODE_LITHIUM_VOLTAGE)
 
+#if IS_ENABLED(CONFIG_ZMK_BATTERY_REPORTING_FETCH_MODE_LITHIUM_ESTIMATE)
+
+struct lithium_curve_point {
+    uint16_t mv;
+    uint8_t pct;
+};
+
+// Open circuit voltage of a typical lithium polymer cell over its discharge, from full to empty.
+static const struct lithium_curve_point lithium_curve[] = {
+    {4200, 100}, {4150, 95}, {4110, 90}, {4080, 85}, {4020, 80}, {3980, 75}, {3950, 70},
+    {3910, 65},  {3870, 60}, {3850, 55}, {3840, 50}, {3820, 45}, {3800, 40}, {3790, 35},
+    {3770, 30},  {3750, 25}, {3730, 20}, {3710, 15}, {3690, 10}, {3610, 5},  {3270, 0},
+};
+
+static uint8_t lithium_curve_mv_to_pct(int32_t mv) {
+    if (mv >= lithium_curve[0].mv) {
+        return 100;
+    }
+
+    for (int i = 1; i < ARRAY_SIZE(lithium_curve); i++) {
+        const struct lithium_curve_point *hi = &lithium_curve[i - 1];
+        const struct lithium_curve_point *lo = &lithium_curve[i];
+
+        if (mv >= lo->mv) {
+            return lo->pct + (mv - lo->mv) * (hi->pct - lo->pct) / (hi->mv - lo->mv);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Estimate the current drawn from the battery from the state of the known loads.
+ */
+static int32_t lithium_estimate_load_ma(void) {
+    int32_t load_ma = CONFIG_ZMK_BATTERY_ESTIMATE_IDLE_LOAD_MA;
+
+    if (zmk_activity_get_state() == ZMK_ACTIVITY_ACTIVE) {
+        load_ma += CONFIG_ZMK_BATTERY_ESTIMATE_ACTIVE_LOAD_MA;
+    }
+
+#if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW)
+    bool underglow_on = false;
+    if (zmk_rgb_underglow_get_state(&underglow_on) == 0 && underglow_on) {
+        load_ma += CONFIG_ZMK_BATTERY_ESTIMATE_RGB_UNDERGLOW_LOAD_MA;
+    }
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_BACKLIGHT)
+    if (zmk_backlight_is_on()) {
+        load_ma += CONFIG_ZMK_BATTERY_ESTIMATE_BACKLIGHT_LOAD_MA;
+    }
+#endif
+
+    return load_ma;
+}
+
+static bool estimate_reported = false;
+static uint8_t estimate_level;
+
+/**
+ * Estimate the state of charge from a voltage measured under load. The estimate only moves once
+ * it is a few percent away from the last one, so sag from short load changes isn't reported.
+ */
+static uint8_t lithium_estimate_pct(uint16_t mv) {
+    const int32_t sag_mv =
+        lithium_estimate_load_ma() * CONFIG_ZMK_BATTERY_ESTIMATE_RESISTANCE_MOHM / 1000;
+    const int32_t open_mv = mv + sag_mv;
+    const uint8_t pct = lithium_curve_mv_to_pct(open_mv);
+    const int delta = (int)pct - (int)estimate_level;
+
+    LOG_DBG("Estimated %d mv without load, %d%%", open_mv, pct);
+
+    if (!estimate_reported || pct == 0 || pct == 100 ||
+        delta >= CONFIG_ZMK_BATTERY_ESTIMATE_HYSTERESIS ||
+        -delta >= CONFIG_ZMK_BATTERY_ESTIMATE_HYSTERESIS) {
+        estimate_reported = true;
+        estimate_level = pct;
+    }
+
+    return estimate_level;
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_BATTERY_REPORTING_FETCH_MODE_LITHIUM_ESTIMATE)
+
+#if IS_ENABLED(CONFIG_ZMK_BATTERY_REPORT_SMOOTHING)
+
+// Fixed point with 4 fractional bits. Each sample moves the average a quarter of the way to it,
+// and the truncated steps always leave the average within rounding distance of a steady level.
+#define SMOOTHING_SHIFT 4
+
+static bool smoothed_valid = false;
+static int32_t smoothed_level;
+
+static uint8_t smooth_state_of_charge(int32_t level) {
+    const int32_t sample = level << SMOOTHING_SHIFT;
+
+    if (!smoothed_valid) {
+        smoothed_valid = true;
+        smoothed_level = sample;
+    } else {
+        smoothed_level += (sample - smoothed_level) / 4;
+    }
+
+    return (smoothed_level + BIT(SMOOTHING_SHIFT - 1)) >> SMOOTHING_SHIFT;
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_BATTERY_REPORT_SMOOTHING)
+
 static int zmk_battery_update(const struct device *battery) {
     struct sensor_value state_of_charge;
     int rc;
 
+    zmk_power_stats_record(ZMK_POWER_STATS_BATTERY_SAMPLE);
+
 #if IS_ENABLED(CONFIG_ZMK_BATTERY_REPORTING_FETCH_MODE_STATE_OF_CHARGE)
 
     rc = sensor_sample_fetch_chan(battery, SENSOR_CHAN_GAUGE_STATE_OF_CHARGE);
@@ -87,20 +254,47 @@ static int zmk_battery_update(const struct device *battery) {
     state_of_charge.val1 = lithium_ion_mv_to_pct(mv);
 
     LOG_DBG("State of change %d from %d mv", state_of_charge.val1, mv);
+#elif IS_ENABLED(CONFIG_ZMK_BATTERY_REPORTING_FETCH_MODE_LITHIUM_ESTIMATE)
+    rc = sensor_sample_fetch_chan(battery, SENSOR_CHAN_GAUGE_VOLTAGE);
+    if (rc != 0) {
+        LOG_DBG("Failed to fetch battery values: %d", rc);
+        return rc;
+    }
+
+    struct sensor_value voltage;
+    rc = sensor_channel_get(battery, SENSOR_CHAN_GAUGE_VOLTAGE, &voltage);
+
+    if (rc != 0) {
+        LOG_DBG("Failed to get battery voltage: %d", rc);
+        return rc;
+    }
+
+    uint16_t mv = voltage.val1 * 1000 + (voltage.val2 / 1000);
+    state_of_charge.val1 = lithium_estimate_pct(mv);
+
+    LOG_DBG("State of charge %d from %d mv", state_of_charge.val1, mv);
 #else
 #error "Not a supported reporting fetch mode"
 #endif
 
+#if IS_ENABLED(CONFIG_ZMK_BATTERY_REPORT_SMOOTHING)
+    state_of_charge.val1 = smooth_state_of_charge(state_of_charge.val1);
+#endif
+
     if (last_state_of_charge != state_of_charge.val1) {
         last_state_of_charge = state_of_charge.val1;
 #if IS_ENABLED(CONFIG_BT_BAS)
-        LOG_DBG("Setting BAS GATT battery level to %d.", last_state_of_charge);
+        if (bas_should_report(last_state_of_charge)) {
+            LOG_DBG("Setting BAS GATT battery level to %d.", last_state_of_charge);
 
-        rc = bt_bas_set_battery_level(last_state_of_charge);
+            rc = bt_bas_set_battery_level(last_state_of_charge);
 
-        if (rc != 0) {
-            LOG_WRN("Failed to set BAS GATT battery level (err %d)", rc);
-            return rc;
+            if (rc != 0) {
+                LOG_WRN("Failed to set BAS GATT battery level (err %d)", rc);
+                return rc;
+            }
+
+            bas_mark_reported(last_state_of_charge);
         }
 #endif
         rc = raise_zmk_battery_state_changed(
@@ -110,25 +304,78 @@ static int zmk_battery_update(const struct device *battery) {
     return rc;
 }
 
+static void zmk_battery_work(struct k_work *work);
+
+// Defined statically, since activity changes can start reporting before the deferred init runs.
+static K_WORK_DELAYABLE_DEFINE(battery_work, zmk_battery_work);
+
+static uint32_t battery_interval_s = CONFIG_ZMK_BATTERY_REPORT_INTERVAL;
+
+// Set once the battery sensor alerts on every state of charge change, which makes the timer
+// unnecessary.
+static bool battery_triggered = false;
+
+#if IS_ENABLED(CONFIG_ZMK_BATTERY_REPORTING_FETCH_MODE_STATE_OF_CHARGE)
+
+static const struct sensor_trigger battery_trigger = {
+    .type = SENSOR_TRIG_DELTA,
+    .chan = SENSOR_CHAN_GAUGE_STATE_OF_CHARGE,
+};
+
+static void battery_trigger_handler(const struct device *dev, const struct sensor_trigger *trig) {
+    k_work_reschedule_for_queue(zmk_workqueue_lowprio_work_q(), &battery_work, K_NO_WAIT);
+}
+
+static void zmk_battery_enable_trigger(void) {
+    int rc = sensor_trigger_set(battery, &battery_trigger, battery_trigger_handler);
+
+    if (rc == 0) {
+        LOG_DBG("Battery level is updated on state of charge changes");
+        battery_triggered = true;
+    } else if (rc != -ENOSYS && rc != -ENOTSUP) {
+        LOG_WRN("Failed to set the battery state of charge trigger (err %d)", rc);
+    }
+}
+
+#else
+
+static inline void zmk_battery_enable_trigger(void) {}
+
+#endif // IS_ENABLED(CONFIG_ZMK_BATTERY_REPORTING_FETCH_MODE_STATE_OF_CHARGE)
+
 static void zmk_battery_work(struct k_work *work) {
+#if IS_ENABLED(CONFIG_ZMK_BATTERY_REPORT_ADAPTIVE_INTERVAL)
+    const uint8_t previous_state_of_charge = last_state_of_charge;
+#endif
+
     int rc = zmk_battery_update(battery);
 
     if (rc != 0) {
         LOG_DBG("Failed to update battery value: %d.", rc);
     }
-}
 
-K_WORK_DEFINE(battery_work, zmk_battery_work);
+#if IS_ENABLED(CONFIG_ZMK_BATTERY_REPORT_ADAPTIVE_INTERVAL)
+    if (rc != 0 || last_state_of_charge != previous_state_of_charge ||
+        last_state_of_charge <= CONFIG_ZMK_BATTERY_REPORT_LOW_LEVEL) {
+        battery_interval_s = CONFIG_ZMK_BATTERY_REPORT_INTERVAL;
+    } else {
+        battery_interval_s = MIN(battery_interval_s * 2, CONFIG_ZMK_BATTERY_REPORT_MAX_INTERVAL);
+    }
+#endif
+
+    // The next update comes from the trigger, unless reading this one failed.
+    if (battery_triggered && rc == 0) {
+        return;
+    }
 
-static void zmk_battery_timer(struct k_timer *timer) {
-    k_work_submit_to_queue(zmk_workqueue_lowprio_work_q(), &battery_work);
+    k_work_schedule_for_queue(zmk_workqueue_lowprio_work_q(), &battery_work,
+                              K_SECONDS(battery_interval_s));
 }
 
-K_TIMER_DEFINE(battery_timer, zmk_battery_timer, NULL);
-
 static void zmk_battery_start_reporting() {
     if (device_is_ready(battery)) {
-        k_timer_start(&battery_timer, K_NO_WAIT, K_SECONDS(CONFIG_ZMK_BATTERY_REPORT_INTERVAL));
+        battery_interval_s = CONFIG_ZMK_BATTERY_REPORT_INTERVAL;
+        k_work_reschedule_for_queue(zmk_workqueue_lowprio_work_q(), &battery_work, K_NO_WAIT);
     }
 }
 
@@ -148,6 +395,7 @@ static int zmk_battery_init(void) {
         return -ENODEV;
     }
 
+    zmk_battery_enable_trigger();
     zmk_battery_start_reporting();
     return 0;
 }
@@ -161,7 +409,10 @@ static int battery_event_listener(const zmk_event_t *eh) {
             return 0;
         case ZMK_ACTIVITY_IDLE:
         case ZMK_ACTIVITY_SLEEP:
-            k_timer_stop(&battery_timer);
+            // Triggered updates carry on while idle, since they only come when the level changes.
+            if (!battery_triggered) {
+                k_work_cancel_delayable(&battery_work);
+            }
             return 0;
         default:
             break;
@@ -174,4 +425,4 @@ ZMK_LISTENER(battery, battery_event_listener);
 
 ZMK_SUBSCRIPTION(battery, zmk_activity_state_changed);
 
-SYS_INIT(zmk_battery_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+ZMK_DEFERRED_INIT(zmk_battery_init, CONFIG_APPLICATION_INIT_PRIORITY);
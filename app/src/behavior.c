@@ -5,7 +5,7 @@
  */
 
 #include <zephyr/device.h>
-#include <zephyr/init.h>
+#include <zephyr/sys/crc.h>
 #include <zephyr/sys/util_macro.h>
 #include <string.h>
 
@@ -21,13 +21,34 @@ const struct device *zmk_behavior_get_binding(const char *name) {
     return behavior_get_binding(name);
 }
 
+#define LOOKUP_CACHE_SIZE 16
+
+// Bindings normally point at the same string as the device name, so lookups by pointer are cached
+// to avoid scanning every behavior on each key press. Each slot is a single pointer, so readers
+// never observe a half written entry, and a hit is validated against the name before it is used.
+static const struct zmk_behavior_ref *lookup_cache[LOOKUP_CACHE_SIZE];
+
+static inline size_t lookup_cache_index(const char *name) {
+    uintptr_t key = (uintptr_t)name;
+
+    return (key ^ (key >> 4) ^ (key >> 8)) % LOOKUP_CACHE_SIZE;
+}
+
 const struct device *z_impl_behavior_get_binding(const char *name) {
     if (name == NULL || name[0] == '\0') {
         return NULL;
     }
 
+    size_t cache_index = lookup_cache_index(name);
+    const struct zmk_behavior_ref *cached = lookup_cache[cache_index];
+
+    if (cached != NULL && cached->device->name == name) {
+        return cached->device;
+    }
+
     STRUCT_SECTION_FOREACH(zmk_behavior_ref, item) {
         if (z_device_is_ready(item->device) && item->device->name == name) {
+            lookup_cache[cache_index] = item;
             return item->device;
         }
     }
@@ -41,6 +62,35 @@ const struct device *z_impl_behavior_get_binding(const char *name) {
     return NULL;
 }
 
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_IDS)
+
+uint16_t zmk_behavior_get_id(const char *name) {
+    return crc16_ccitt(0, (const uint8_t *)name, strlen(name));
+}
+
+const struct device *zmk_behavior_get_binding_by_id(uint16_t id) {
+    const struct device *found = NULL;
+
+    // Scan every behavior rather than stopping at the first match, so a collision is reported
+    // instead of silently running the wrong behavior.
+    STRUCT_SECTION_FOREACH(zmk_behavior_ref, item) {
+        if (!z_device_is_ready(item->device) || zmk_behavior_get_id(item->device->name) != id) {
+            continue;
+        }
+
+        if (found != NULL) {
+            LOG_ERR("Behaviors %s and %s have the same ID 0x%04x", found->name,
+                    item->device->name, id);
+            return NULL;
+        }
+        found = item->device;
+    }
+
+    return found;
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_BEHAVIOR_IDS)
+
 #if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_METADATA)
 
 int zmk_behavior_get_empty_param_metadata(const struct device *dev,
@@ -184,30 +234,3 @@ int zmk_behavior_validate_binding(const struct zmk_behavior_binding *binding) {
     return 0;
 #endif // IS_ENABLED(CONFIG_ZMK_BEHAVIOR_METADATA)
 }
-
-#if IS_ENABLED(CONFIG_LOG)
-static int check_behavior_names(void) {
-    // Behavior names must be unique, but we don't have a good way to enforce this
-    // at compile time, so log an error at runtime if they aren't unique.
-    ptrdiff_t count;
-    STRUCT_SECTION_COUNT(zmk_behavior_ref, &count);
-
-    for (ptrdiff_t i = 0; i < count; i++) {
-        const struct zmk_behavior_ref *current;
-        STRUCT_SECTION_GET(zmk_behavior_ref, i, &current);
-
-        for (ptrdiff_t j = i + 1; j < count; j++) {
-            const struct zmk_behavior_ref *other;
-            STRUCT_SECTION_GET(zmk_behavior_ref, j, &other);
-
-            if (strcmp(current->device->name, other->device->name) == 0) {
-                LOG_ERR("Multiple behaviors have the same name '%s'", current->device->name);
-            }
-        }
-    }
-
-    return 0;
-}
-
-SYS_INIT(check_behavior_names, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
-#endif // IS_ENABLED(CONFIG_LOG)
@@ -6,28 +6,196 @@
 
 #include <zmk/behavior_queue.h>
 
+#include <string.h>
+
+#include <zephyr/init.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 #include <drivers/behavior.h>
+#include <zmk/input_frame.h>
+#include <zmk/workqueue.h>
+#include <zmk/boot_timing.h>
+#include <zmk/benchmark.h>
+#include <zmk/resource_stats.h>
+#if IS_ENABLED(CONFIG_ZMK_USB)
+#include <zmk/usb_hid.h>
+#endif
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+#include <zmk/hog.h>
+#endif
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
+#define QUEUE_SIZE CONFIG_ZMK_BEHAVIORS_QUEUE_SIZE
+#define LANES_LEN CONFIG_ZMK_BEHAVIORS_QUEUE_LANES
+#define NO_ITEM UINT16_MAX
+
+BUILD_ASSERT(QUEUE_SIZE < NO_ITEM, "CONFIG_ZMK_BEHAVIORS_QUEUE_SIZE must be less than 65535");
+
 struct q_item {
-    uint32_t position;
     struct zmk_behavior_binding binding;
+    uint32_t position;
     bool press : 1;
-    uint32_t wait : 31;
+    bool keep : 1;
+    uint32_t wait : 30;
+    uint16_t next;
+};
+
+struct q_lane {
+    struct k_work_delayable work;
+    uint16_t head;
+    uint16_t tail;
+    // Set while the lane invokes its behaviors, so behaviors that queue more of their own are
+    // picked up by the running loop instead of starting another one.
+    bool running;
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIORS_QUEUE_PACING)
+    // Set while the lane waits for the reports of the last invoked behavior to be delivered.
+    atomic_t pacing;
+    // The wait requested by that behavior ends at resume_at, and delivery is given up on at
+    // give_up_at.
+    int64_t resume_at;
+    int64_t give_up_at;
+#endif
 };
 
-K_MSGQ_DEFINE(zmk_behavior_queue_msgq, sizeof(struct q_item), CONFIG_ZMK_BEHAVIORS_QUEUE_SIZE, 4);
+// All lanes share one pool of items, so a single long macro can still use the whole queue. Items
+// are only ever added and consumed from the input work queue, so no locking is needed.
+static struct q_item items[QUEUE_SIZE];
+static uint16_t free_head = NO_ITEM;
+static struct q_lane lanes[LANES_LEN];
+static uint16_t used_items;
+
+ZMK_QUEUE_STATS_DEFINE(behavior_queue_stats, "Queued behaviors", QUEUE_SIZE);
+
+static uint16_t alloc_item(void) {
+    uint16_t index = free_head;
+    if (index == NO_ITEM) {
+        zmk_queue_stats_overflowed(&behavior_queue_stats);
+        return index;
+    }
+
+    free_head = items[index].next;
+    items[index].next = NO_ITEM;
+    used_items++;
+    zmk_benchmark_queue_push(ZMK_BENCHMARK_QUEUE_BEHAVIORS);
+    zmk_queue_stats_queued(&behavior_queue_stats, used_items);
+
+    return index;
+}
+
+static void free_item(uint16_t index) {
+    items[index].next = free_head;
+    free_head = index;
+}
+
+static void release_item(uint16_t index) {
+    free_item(index);
+    used_items--;
+    zmk_benchmark_queue_pop(ZMK_BENCHMARK_QUEUE_BEHAVIORS);
+}
+
+static bool lane_is_empty(const struct q_lane *lane) { return lane->head == NO_ITEM; }
+
+static bool pop_item(struct q_lane *lane, struct q_item *item) {
+    if (lane_is_empty(lane)) {
+        return false;
+    }
+
+    uint16_t index = lane->head;
+    *item = items[index];
+    lane->head = items[index].next;
+    if (lane->head == NO_ITEM) {
+        lane->tail = NO_ITEM;
+    }
+
+    release_item(index);
+    return true;
+}
+
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIORS_QUEUE_PACING)
 
-static void behavior_queue_process_next(struct k_work *work);
-static K_WORK_DELAYABLE_DEFINE(queue_work, behavior_queue_process_next);
+static bool reports_delivered(void) {
+#if IS_ENABLED(CONFIG_ZMK_USB)
+    if (!zmk_usb_hid_is_idle()) {
+        return false;
+    }
+#endif
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+    if (!zmk_hog_is_idle()) {
+        return false;
+    }
+#endif
+    return true;
+}
+
+static void start_pacing(struct q_lane *lane, uint32_t wait) {
+    int64_t now = k_uptime_get();
+
+    lane->resume_at = now + wait;
+    lane->give_up_at = lane->resume_at + CONFIG_ZMK_BEHAVIORS_QUEUE_PACING_TIMEOUT_MS;
+    atomic_set(&lane->pacing, true);
+
+    k_work_schedule_for_queue(zmk_workqueue_input_work_q(), &lane->work, K_MSEC(wait));
+}
+
+// Returns true if the lane still has to wait before invoking its next behavior, in which case the
+// work has been rescheduled for when the wait ends or delivery is given up on.
+static bool continue_pacing(struct q_lane *lane) {
+    if (!atomic_get(&lane->pacing)) {
+        return false;
+    }
+
+    int64_t now = k_uptime_get();
+    if (now < lane->resume_at) {
+        k_work_schedule_for_queue(zmk_workqueue_input_work_q(), &lane->work,
+                                  K_MSEC(lane->resume_at - now));
+        return true;
+    }
+
+    if (!reports_delivered() && now < lane->give_up_at) {
+        k_work_schedule_for_queue(zmk_workqueue_input_work_q(), &lane->work,
+                                  K_MSEC(lane->give_up_at - now));
+        return true;
+    }
+
+    if (now >= lane->give_up_at) {
+        LOG_DBG("Reports not delivered after %dms, continuing",
+                CONFIG_ZMK_BEHAVIORS_QUEUE_PACING_TIMEOUT_MS);
+    }
+
+    atomic_set(&lane->pacing, false);
+    return false;
+}
+
+void zmk_behavior_queue_report_delivered(void) {
+    for (int i = 0; i < LANES_LEN; i++) {
+        if (atomic_get(&lanes[i].pacing)) {
+            k_work_reschedule_for_queue(zmk_workqueue_input_work_q(), &lanes[i].work, K_NO_WAIT);
+        }
+    }
+}
+
+#else
+
+void zmk_behavior_queue_report_delivered(void) {}
+
+#endif // IS_ENABLED(CONFIG_ZMK_BEHAVIORS_QUEUE_PACING)
 
 static void behavior_queue_process_next(struct k_work *work) {
+    struct k_work_delayable *d_work = k_work_delayable_from_work(work);
+    struct q_lane *lane = CONTAINER_OF(d_work, struct q_lane, work);
     struct q_item item = {.wait = 0};
 
-    while (k_msgq_get(&zmk_behavior_queue_msgq, &item, K_NO_WAIT) == 0) {
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIORS_QUEUE_PACING)
+    if (continue_pacing(lane)) {
+        return;
+    }
+#endif
+
+    zmk_input_frame_begin();
+    lane->running = true;
+
+    while (pop_item(lane, &item)) {
         LOG_DBG("Invoking %s: 0x%02x 0x%02x", item.binding.behavior_dev, item.binding.param1,
                 item.binding.param2);
 
@@ -42,25 +210,169 @@ static void behavior_queue_process_next(struct k_work *work) {
 
         LOG_DBG("Processing next queued behavior in %dms", item.wait);
 
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIORS_QUEUE_PACING)
+        if (!lane_is_empty(lane)) {
+            start_pacing(lane, item.wait);
+            break;
+        }
+#endif
+
         if (item.wait > 0) {
-            k_work_schedule(&queue_work, K_MSEC(item.wait));
+            k_work_schedule_for_queue(zmk_workqueue_input_work_q(), &lane->work,
+                                      K_MSEC(item.wait));
             break;
         }
     }
+
+    lane->running = false;
+    zmk_input_frame_end();
+}
+
+static bool lane_has_position(const struct q_lane *lane, uint32_t position) {
+    for (uint16_t i = lane->head; i != NO_ITEM; i = items[i].next) {
+        if (items[i].position == position) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Keep all items for one position in order on the same lane. Otherwise give the position an idle
+// lane so it runs independently of anything already queued.
+static struct q_lane *lane_for_position(uint32_t position) {
+    struct q_lane *idle = NULL;
+
+    for (int i = 0; i < LANES_LEN; i++) {
+        struct q_lane *lane = &lanes[i];
+        if (lane_has_position(lane, position)) {
+            return lane;
+        }
+
+        if (!idle && lane_is_empty(lane) && !lane->running &&
+            !k_work_delayable_is_pending(&lane->work)) {
+            idle = lane;
+        }
+    }
+
+    return idle ? idle : &lanes[position % LANES_LEN];
 }
 
 int zmk_behavior_queue_add(uint32_t position, const struct zmk_behavior_binding binding, bool press,
                            uint32_t wait) {
-    struct q_item item = {.press = press, .binding = binding, .wait = wait};
+    uint16_t index = alloc_item();
+    if (index == NO_ITEM) {
+        return -ENOMSG;
+    }
+
+    struct q_lane *lane = lane_for_position(position);
 
-    const int ret = k_msgq_put(&zmk_behavior_queue_msgq, &item, K_NO_WAIT);
-    if (ret < 0) {
-        return ret;
+    items[index] = (struct q_item){
+        .binding = binding, .position = position, .press = press, .wait = wait, .next = NO_ITEM};
+
+    if (lane_is_empty(lane)) {
+        lane->head = index;
+    } else {
+        items[lane->tail].next = index;
     }
+    lane->tail = index;
 
-    if (!k_work_delayable_is_pending(&queue_work)) {
-        behavior_queue_process_next(&queue_work.work);
+    if (!lane->running && !k_work_delayable_is_pending(&lane->work)) {
+        behavior_queue_process_next(&lane->work.work);
     }
 
     return 0;
 }
+
+int zmk_behavior_queue_free_count(void) { return QUEUE_SIZE - used_items; }
+
+static bool bindings_equal(const struct zmk_behavior_binding *a,
+                           const struct zmk_behavior_binding *b) {
+    return a->param1 == b->param1 && a->param2 == b->param2 &&
+           strcmp(a->behavior_dev, b->behavior_dev) == 0;
+}
+
+// Look for a queued press of the same binding earlier in the lane. If there is one, the release is
+// cancelled along with it, otherwise the press was already invoked and the release must still run.
+static bool has_pending_press(const struct q_lane *lane, uint16_t release, uint32_t position) {
+    for (uint16_t i = lane->head; i != release; i = items[i].next) {
+        if (items[i].press && items[i].position == position &&
+            bindings_equal(&items[i].binding, &items[release].binding)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int cancel_lane_items(struct q_lane *lane, uint32_t position) {
+    int cancelled = 0;
+
+    // Releases are resolved first, while the presses they pair with are still in the lane. Kept
+    // releases run without any further wait once the lane reaches them.
+    for (uint16_t i = lane->head; i != NO_ITEM; i = items[i].next) {
+        if (items[i].position == position && !items[i].press &&
+            !has_pending_press(lane, i, position)) {
+            items[i].keep = true;
+            items[i].wait = 0;
+        }
+    }
+
+    uint16_t prev = NO_ITEM;
+    uint16_t i = lane->head;
+    while (i != NO_ITEM) {
+        uint16_t next = items[i].next;
+
+        if (items[i].position != position || items[i].keep) {
+            items[i].keep = false;
+            prev = i;
+            i = next;
+            continue;
+        }
+
+        if (prev == NO_ITEM) {
+            lane->head = next;
+        } else {
+            items[prev].next = next;
+        }
+        if (lane->tail == i) {
+            lane->tail = prev;
+        }
+
+        release_item(i);
+        cancelled++;
+        i = next;
+    }
+
+    return cancelled;
+}
+
+int zmk_behavior_queue_cancel(uint32_t position) {
+    int cancelled = 0;
+
+    for (int i = 0; i < LANES_LEN; i++) {
+        cancelled += cancel_lane_items(&lanes[i], position);
+    }
+
+    if (cancelled > 0) {
+        LOG_DBG("Cancelled %d queued behaviors for position %d", cancelled, position);
+    }
+
+    return cancelled;
+}
+
+static int behavior_queue_init(void) {
+    for (int i = 0; i < QUEUE_SIZE; i++) {
+        free_item(QUEUE_SIZE - 1 - i);
+    }
+
+    for (int i = 0; i < LANES_LEN; i++) {
+        lanes[i].head = NO_ITEM;
+        lanes[i].tail = NO_ITEM;
+        k_work_init_delayable(&lanes[i].work, behavior_queue_process_next);
+    }
+
+    return 0;
+}
+
+ZMK_SYS_INIT(behavior_queue_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -37,20 +37,55 @@ struct behavior_caps_word_config {
     struct caps_word_continue_item continuations[];
 };
 
+// One bit per keyboard page usage ID.
+#define USAGE_BITMAP_LEN (256 / 8)
+
 struct behavior_caps_word_data {
     bool active;
+    /**
+     * Keyboard usages that continue caps word whatever the modifiers: letters, numbers, modifiers
+     * and continue-list items without implicit modifiers.
+     */
+    uint8_t continue_usages[USAGE_BITMAP_LEN];
+    /** Keyboard usages with continue-list items that only continue with certain modifiers. */
+    uint8_t modded_usages[USAGE_BITMAP_LEN];
+    /** Whether the continue-list has items outside the keyboard page. */
+    bool other_pages;
 };
 
+static inline bool usage_bitmap_test(const uint8_t *bitmap, uint32_t id) {
+    return id <= UINT8_MAX && (bitmap[id / 8] & BIT(id % 8)) != 0;
+}
+
+static inline void usage_bitmap_set(uint8_t *bitmap, uint32_t id) { bitmap[id / 8] |= BIT(id % 8); }
+
+static int caps_word_keycode_state_changed_listener(const zmk_event_t *eh);
+
+// Only enabled while at least one caps word instance is active.
+ZMK_LISTENER_DYNAMIC(behavior_caps_word, caps_word_keycode_state_changed_listener, false);
+ZMK_SUBSCRIPTION(behavior_caps_word, zmk_keycode_state_changed);
+
+static uint8_t active_caps_words;
+
 static void activate_caps_word(const struct device *dev) {
     struct behavior_caps_word_data *data = dev->data;
 
-    data->active = true;
+    if (!data->active) {
+        data->active = true;
+        active_caps_words++;
+        ZMK_LISTENER_SET_ENABLED(behavior_caps_word, true);
+    }
 }
 
 static void deactivate_caps_word(const struct device *dev) {
     struct behavior_caps_word_data *data = dev->data;
 
-    data->active = false;
+    if (data->active) {
+        data->active = false;
+        if (--active_caps_words == 0) {
+            ZMK_LISTENER_SET_ENABLED(behavior_caps_word, false);
+        }
+    }
 }
 
 static int on_caps_word_binding_pressed(struct zmk_behavior_binding *binding,
@@ -80,15 +115,11 @@ static const struct behavior_driver_api behavior_caps_word_driver_api = {
 #endif // IS_ENABLED(CONFIG_ZMK_BEHAVIOR_METADATA)
 };
 
-static int caps_word_keycode_state_changed_listener(const zmk_event_t *eh);
-
-ZMK_LISTENER(behavior_caps_word, caps_word_keycode_state_changed_listener);
-ZMK_SUBSCRIPTION(behavior_caps_word, zmk_keycode_state_changed);
-
 static const struct device *devs[DT_NUM_INST_STATUS_OKAY(DT_DRV_COMPAT)];
 
+// Checks the items of the continue-list that the bitmaps can't tell on their own.
 static bool caps_word_is_caps_includelist(const struct behavior_caps_word_config *config,
-                                          uint16_t usage_page, uint8_t usage_id,
+                                          uint16_t usage_page, uint32_t usage_id,
                                           uint8_t implicit_modifiers) {
     for (int i = 0; i < config->continuations_count; i++) {
         const struct caps_word_continue_item *continuation = &config->continuations[i];
@@ -108,13 +139,21 @@ static bool caps_word_is_caps_includelist(const struct behavior_caps_word_config
     return false;
 }
 
-static bool caps_word_is_alpha(uint8_t usage_id) {
-    return (usage_id >= HID_USAGE_KEY_KEYBOARD_A && usage_id <= HID_USAGE_KEY_KEYBOARD_Z);
+static bool caps_word_continues(const struct behavior_caps_word_config *config,
+                                const struct behavior_caps_word_data *data, uint16_t usage_page,
+                                uint32_t usage_id, uint8_t implicit_modifiers) {
+    if (usage_page == HID_USAGE_KEY) {
+        return usage_bitmap_test(data->continue_usages, usage_id) ||
+               (usage_bitmap_test(data->modded_usages, usage_id) &&
+                caps_word_is_caps_includelist(config, usage_page, usage_id, implicit_modifiers));
+    }
+
+    return data->other_pages &&
+           caps_word_is_caps_includelist(config, usage_page, usage_id, implicit_modifiers);
 }
 
-static bool caps_word_is_numeric(uint8_t usage_id) {
-    return (usage_id >= HID_USAGE_KEY_KEYBOARD_1_AND_EXCLAMATION &&
-            usage_id <= HID_USAGE_KEY_KEYBOARD_0_AND_RIGHT_PARENTHESIS);
+static bool caps_word_is_alpha(uint8_t usage_id) {
+    return (usage_id >= HID_USAGE_KEY_KEYBOARD_A && usage_id <= HID_USAGE_KEY_KEYBOARD_Z);
 }
 
 static void caps_word_enhance_usage(const struct behavior_caps_word_config *config,
@@ -148,10 +187,8 @@ static int caps_word_keycode_state_changed_listener(const zmk_event_t *eh) {
 
         caps_word_enhance_usage(config, ev);
 
-        if (!caps_word_is_alpha(ev->keycode) && !caps_word_is_numeric(ev->keycode) &&
-            !is_mod(ev->usage_page, ev->keycode) &&
-            !caps_word_is_caps_includelist(config, ev->usage_page, ev->keycode,
-                                           ev->implicit_modifiers)) {
+        if (!caps_word_continues(config, data, ev->usage_page, ev->keycode,
+                                 ev->implicit_modifiers)) {
             LOG_DBG("Deactivating caps_word for 0x%02X - 0x%02X", ev->usage_page, ev->keycode);
             deactivate_caps_word(dev);
         }
@@ -160,9 +197,41 @@ static int caps_word_keycode_state_changed_listener(const zmk_event_t *eh) {
     return ZMK_EV_EVENT_BUBBLE;
 }
 
+static void caps_word_init_usages(const struct device *dev) {
+    struct behavior_caps_word_data *data = dev->data;
+    const struct behavior_caps_word_config *config = dev->config;
+
+    for (int i = HID_USAGE_KEY_KEYBOARD_A; i <= HID_USAGE_KEY_KEYBOARD_Z; i++) {
+        usage_bitmap_set(data->continue_usages, i);
+    }
+
+    for (int i = HID_USAGE_KEY_KEYBOARD_1_AND_EXCLAMATION;
+         i <= HID_USAGE_KEY_KEYBOARD_0_AND_RIGHT_PARENTHESIS; i++) {
+        usage_bitmap_set(data->continue_usages, i);
+    }
+
+    // Modifiers pass through, so shifting a letter or number doesn't end caps word.
+    for (int i = HID_USAGE_KEY_KEYBOARD_LEFTCONTROL; i <= HID_USAGE_KEY_KEYBOARD_RIGHT_GUI; i++) {
+        usage_bitmap_set(data->continue_usages, i);
+    }
+
+    for (int i = 0; i < config->continuations_count; i++) {
+        const struct caps_word_continue_item *continuation = &config->continuations[i];
+
+        if (continuation->page != HID_USAGE_KEY || continuation->id > UINT8_MAX) {
+            data->other_pages = true;
+        } else if (continuation->implicit_modifiers == 0) {
+            usage_bitmap_set(data->continue_usages, continuation->id);
+        } else {
+            usage_bitmap_set(data->modded_usages, continuation->id);
+        }
+    }
+}
+
 static int behavior_caps_word_init(const struct device *dev) {
     const struct behavior_caps_word_config *config = dev->config;
     devs[config->index] = dev;
+    caps_word_init_usages(dev);
     return 0;
 }
 
@@ -7,6 +7,7 @@
 #define DT_DRV_COMPAT zmk_behavior_hold_tap
 
 #include <zephyr/device.h>
+#include <zephyr/sys/atomic.h>
 #include <drivers/behavior.h>
 #include <zmk/keys.h>
 #include <dt-bindings/zmk/keys.h>
@@ -19,17 +20,27 @@
 #include <zmk/events/keycode_state_changed.h>
 #include <zmk/behavior.h>
 #include <zmk/keymap.h>
+#include <zmk/behavior_pool.h>
+#include <zmk/input_frame.h>
+#include <zmk/input_timer.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #if DT_HAS_COMPAT_STATUS_OKAY(DT_DRV_COMPAT)
 
-#define ZMK_BHV_HOLD_TAP_MAX_HELD 10
-#define ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS 40
+#define ZMK_BHV_HOLD_TAP_MAX_HELD                                                                  \
+    ZMK_BEHAVIOR_POOL_SIZE(DT_DRV_COMPAT, CONFIG_ZMK_HOLD_TAP_MAX_HELD)
+#define ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS CONFIG_ZMK_HOLD_TAP_MAX_CAPTURED_EVENTS
 
 // increase if you have keyboard with more keys.
 #define ZMK_BHV_HOLD_TAP_POSITION_NOT_USED 9999
 
+#define KEY_PRESS DEVICE_DT_NAME(DT_INST(0, zmk_behavior_key_press))
+
+// Modifiers that do nothing on their own when pressed and released, unlike Alt and GUI, which open
+// menus and launchers on some hosts.
+#define SPECULATIVE_HOLD_MODS (MOD_LCTL | MOD_LSFT | MOD_RCTL | MOD_RSFT)
+
 enum flavor {
     FLAVOR_HOLD_PREFERRED,
     FLAVOR_BALANCED,
@@ -55,6 +66,8 @@ enum decision_moment {
 
 struct behavior_hold_tap_config {
     int tapping_term_ms;
+    bool adaptive_tapping_term;
+    int adaptive_tapping_term_min_ms;
     char *hold_behavior_dev;
     char *tap_behavior_dev;
     int quick_tap_ms;
@@ -62,6 +75,7 @@ struct behavior_hold_tap_config {
     enum flavor flavor;
     bool hold_while_undecided;
     bool hold_while_undecided_linger;
+    bool speculative_hold;
     bool retro_tap;
     bool hold_trigger_on_release;
     int32_t hold_trigger_key_positions_len;
@@ -80,10 +94,13 @@ struct active_hold_tap {
     uint32_t param_hold;
     uint32_t param_tap;
     int64_t timestamp;
+    // The tapping term for this press, which differs from the configured one if it is adaptive.
+    int tapping_term_ms;
     enum status status;
     const struct behavior_hold_tap_config *config;
-    struct k_work_delayable work;
-    bool work_is_cancelled;
+    struct zmk_input_timer timer;
+    // Whether the hold binding is pressed right away, from hold-while-undecided or speculatively.
+    bool hold_while_undecided;
 
     // initialized to -1, which is to be interpreted as "no other key has been pressed yet"
     int32_t position_of_first_other_key_pressed;
@@ -93,7 +110,7 @@ struct active_hold_tap {
 // other keypress events can be released. While the undecided_hold_tap is
 // not NULL, most events are captured in captured_events.
 // After the hold_tap is decided, it will stay in the active_hold_taps until
-// its key-up has been processed and the delayed work is cleaned up.
+// its key-up has been processed.
 struct active_hold_tap *undecided_hold_tap = NULL;
 struct active_hold_tap active_hold_taps[ZMK_BHV_HOLD_TAP_MAX_HELD] = {};
 // We capture most position_state_changed events and some modifiers_state_changed events.
@@ -114,7 +131,16 @@ struct captured_event {
     union captured_event_data data;
 };
 
+// Captured events are kept in order in a ring buffer, indexed by captured_head and captured_tail
+// modulo its size. The events of the undecided hold-tap start at capture_start. Events released
+// while older ones are still pending are marked ET_NONE until the head moves past them.
 struct captured_event captured_events[ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS] = {};
+static uint32_t captured_head;
+static uint32_t captured_tail;
+static uint32_t capture_start;
+
+// Key positions with a key down event captured by the undecided hold-tap.
+static ATOMIC_DEFINE(captured_keydown_positions, ZMK_KEYMAP_LEN);
 
 // Keep track of which key was tapped most recently for the standard, if it is a hold-tap
 // a position, will be given, if not it will just be INT32_MIN
@@ -148,34 +174,113 @@ static bool is_quick_tap(struct active_hold_tap *hold_tap) {
     }
 }
 
+static inline struct captured_event *captured_event_at(uint32_t index) {
+    return &captured_events[index % ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS];
+}
+
+static void start_capturing(void) {
+    capture_start = captured_tail;
+    atomic_clear(captured_keydown_positions);
+}
+
+#define ADAPTIVE_TAPPING_TERM_INST(n) DT_INST_PROP(n, adaptive_tapping_term) ||
+
+#if DT_INST_FOREACH_STATUS_OKAY(ADAPTIVE_TAPPING_TERM_INST) 0
+
+// The average duration of recent taps for each key position, in milliseconds, or 0 before the
+// first tap. An adaptive tapping term waits twice as long as a typical tap of that key.
+static uint16_t tap_duration_avg_ms[ZMK_KEYMAP_LEN];
+
+static int get_tapping_term_ms(const struct behavior_hold_tap_config *config, int32_t position) {
+    if (!config->adaptive_tapping_term || position < 0 || position >= ZMK_KEYMAP_LEN ||
+        tap_duration_avg_ms[position] == 0) {
+        return config->tapping_term_ms;
+    }
+
+    return CLAMP(2 * tap_duration_avg_ms[position], config->adaptive_tapping_term_min_ms,
+                 config->tapping_term_ms);
+}
+
+static void record_tap_duration(struct active_hold_tap *hold_tap, int64_t timestamp) {
+    int64_t duration = timestamp - hold_tap->timestamp;
+
+    if (!hold_tap->config->adaptive_tapping_term || hold_tap->position < 0 ||
+        hold_tap->position >= ZMK_KEYMAP_LEN) {
+        return;
+    }
+
+    // A hold decided by the timer but released within the configured tapping term was most
+    // likely a slow tap, so it lengthens the term again.
+    if (hold_tap->status != STATUS_TAP &&
+        !(hold_tap->status == STATUS_HOLD_TIMER && duration < hold_tap->config->tapping_term_ms)) {
+        return;
+    }
+
+    uint16_t *avg = &tap_duration_avg_ms[hold_tap->position];
+    duration = CLAMP(duration, 1, hold_tap->config->tapping_term_ms);
+
+    // Exponential moving average, so the term follows changes in typing speed.
+    *avg = (*avg == 0) ? duration : *avg + (duration - *avg) / 4;
+
+    LOG_DBG("%d tap duration %d, average %d", hold_tap->position, (int)duration, *avg);
+}
+
+#else
+
+static int get_tapping_term_ms(const struct behavior_hold_tap_config *config, int32_t position) {
+    return config->tapping_term_ms;
+}
+
+static void record_tap_duration(struct active_hold_tap *hold_tap, int64_t timestamp) {}
+
+#endif
+
 static int capture_event(struct captured_event *data) {
-    for (int i = 0; i < ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS; i++) {
-        if (captured_events[i].tag == ET_NONE) {
-            captured_events[i] = *data;
-            return 0;
-        }
+    if (captured_tail - captured_head >= ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS) {
+        LOG_WRN("Unable to capture more than %d events, increase "
+                "CONFIG_ZMK_HOLD_TAP_MAX_CAPTURED_EVENTS",
+                ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS);
+        return -ENOMEM;
     }
-    return -ENOMEM;
+
+    *captured_event_at(captured_tail++) = *data;
+
+    if (data->tag == ET_POS_CHANGED && data->data.position.data.state &&
+        data->data.position.data.position < ZMK_KEYMAP_LEN) {
+        atomic_set_bit(captured_keydown_positions, data->data.position.data.position);
+    }
+
+    return 0;
 }
 
 static bool have_captured_keydown_event(uint32_t position) {
-    for (int i = 0; i < ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS; i++) {
-        struct captured_event *ev = &captured_events[i];
-        if (ev->tag == ET_NONE) {
-            return false;
-        }
+    if (position < ZMK_KEYMAP_LEN) {
+        return atomic_test_bit(captured_keydown_positions, position);
+    }
 
-        if (ev->tag != ET_POS_CHANGED) {
-            continue;
-        }
+    // Virtual key positions, such as combos, aren't in the bitmap.
+    for (uint32_t i = capture_start; i != captured_tail; i++) {
+        struct captured_event *ev = captured_event_at(i);
 
-        if (ev->data.position.data.position == position && ev->data.position.data.state) {
+        if (ev->tag == ET_POS_CHANGED && ev->data.position.data.position == position &&
+            ev->data.position.data.state) {
             return true;
         }
     }
     return false;
 }
 
+static void reclaim_captured_events(void) {
+    while (captured_head != captured_tail && captured_event_at(captured_head)->tag == ET_NONE) {
+        captured_head++;
+    }
+
+    // Start over once everything is released, so the indexes never wrap around.
+    if (captured_head == captured_tail) {
+        captured_head = captured_tail = capture_start = 0;
+    }
+}
+
 const struct zmk_listener zmk_listener_behavior_hold_tap;
 
 static void release_captured_events() {
@@ -183,40 +288,41 @@ static void release_captured_events() {
         return;
     }
 
-    // We use a trick to prevent copying the captured_events array.
-    //
-    // Events for different mod-tap instances are separated by a NULL pointer.
+    // Only the events captured by the hold-tap that was just decided are released.
     //
-    // The first event popped will never be caught by the next active hold-tap
-    // because to start capturing a mod-tap-key-down event must first completely
-    // go through the events queue.
+    // Releasing an event can make another hold-tap undecided, which then captures the following
+    // released events after the end of this range. If that hold-tap is decided while this range
+    // is still being released, its own range is released first, in a nested call, since those
+    // events happened before the ones remaining here.
     //
     // Example of this release process;
-    // [mt2_down, k1_down, k1_up, mt2_up, null, ...]
+    // [mt2_down, k1_down, k1_up, mt2_up]
     //  ^
     // mt2_down position event isn't captured because no hold-tap is active.
     // mt2_down behavior event is handled, now we have an undecided hold-tap
-    // [null, k1_down, k1_up, mt2_up, null, ...]
+    // [none, k1_down, k1_up, mt2_up]
     //        ^
-    // k1_down  is captured by the mt2 mod-tap
-    // !note that searches for find_captured_keydown_event by the mt2 behavior will stop at the
-    // first null encountered [mt1_down, null, k1_up, mt2_up, null, ...]
-    //                  ^
+    // k1_down is captured by the mt2 mod-tap after the end of the range
+    // [none, none, k1_up, mt2_up, k1_down]
+    //              ^
     // k1_up event is captured by the new hold-tap:
-    // [k1_down, k1_up, null, mt2_up, null, ...]
-    //                        ^
+    // [none, none, none, mt2_up, k1_down, k1_up]
+    //                    ^
     // mt2_up event is not captured but causes release of mt2 behavior
-    // [k1_down, k1_up, null, null, null, ...]
+    // [none, none, none, none, k1_down, k1_up]
+    //                          ^
     // now mt2 will start releasing it's own captured positions.
-    for (int i = 0; i < ZMK_BHV_HOLD_TAP_MAX_CAPTURED_EVENTS; i++) {
-        struct captured_event *captured_event = &captured_events[i];
+    const uint32_t end = captured_tail;
+
+    for (uint32_t i = capture_start; i != end; i++) {
+        struct captured_event *captured_event = captured_event_at(i);
         enum captured_event_tag tag = captured_event->tag;
 
         if (tag == ET_NONE) {
-            return;
+            continue;
         }
 
-        captured_events[i].tag = ET_NONE;
+        captured_event->tag = ET_NONE;
         if (undecided_hold_tap != NULL) {
             k_msleep(10);
         }
@@ -239,6 +345,8 @@ static void release_captured_events() {
             break;
         }
     }
+
+    reclaim_captured_events();
 }
 
 static struct active_hold_tap *find_hold_tap(uint32_t position) {
@@ -272,7 +380,6 @@ static struct active_hold_tap *store_hold_tap(uint32_t position, uint32_t param_
 static void clear_hold_tap(struct active_hold_tap *hold_tap) {
     hold_tap->position = ZMK_BHV_HOLD_TAP_POSITION_NOT_USED;
     hold_tap->status = STATUS_UNDECIDED;
-    hold_tap->work_is_cancelled = false;
 }
 
 static void decide_balanced(struct active_hold_tap *hold_tap, enum decision_moment event) {
@@ -447,15 +554,14 @@ static int press_binding(struct active_hold_tap *hold_tap) {
     }
 
     if (hold_tap->status == STATUS_HOLD_TIMER || hold_tap->status == STATUS_HOLD_INTERRUPT) {
-        if (hold_tap->config->hold_while_undecided) {
+        if (hold_tap->hold_while_undecided) {
             // the hold is already active, so we don't need to press it again
             return 0;
         } else {
             return press_hold_binding(hold_tap);
         }
     } else {
-        if (hold_tap->config->hold_while_undecided &&
-            !hold_tap->config->hold_while_undecided_linger) {
+        if (hold_tap->hold_while_undecided && !hold_tap->config->hold_while_undecided_linger) {
             // time to release the hold before pressing the tap
             release_hold_binding(hold_tap);
         }
@@ -519,7 +625,7 @@ static void decide_hold_tap(struct active_hold_tap *hold_tap,
         return;
     }
 
-    if (hold_tap->config->hold_while_undecided && decision_moment == HT_KEY_DOWN) {
+    if (hold_tap->hold_while_undecided && decision_moment == HT_KEY_DOWN) {
         LOG_DBG("%d hold behavior pressed while undecided", hold_tap->position);
         press_hold_binding(hold_tap);
         return;
@@ -586,6 +692,23 @@ static void update_hold_status_for_retro_tap(uint32_t ignore_position) {
     }
 }
 
+// Holding a lone Shift or Ctrl early is harmless: keys pressed with it are captured until the
+// hold-tap is decided, and it is released before the tap if that is the decision.
+static bool is_speculative_hold_safe(const struct behavior_hold_tap_config *config,
+                                     uint32_t param_hold) {
+    if (strcmp(config->hold_behavior_dev, KEY_PRESS) != 0 || SELECT_MODS(param_hold) != 0 ||
+        ZMK_HID_USAGE_PAGE(param_hold) != HID_USAGE_KEY) {
+        return false;
+    }
+
+    uint16_t usage_id = ZMK_HID_USAGE_ID(param_hold);
+    if (!is_mod(HID_USAGE_KEY, usage_id)) {
+        return false;
+    }
+
+    return BIT(usage_id - HID_USAGE_KEY_KEYBOARD_LEFTCONTROL) & SPECULATIVE_HOLD_MODS;
+}
+
 static int on_hold_tap_binding_pressed(struct zmk_behavior_binding *binding,
                                        struct zmk_behavior_binding_event event) {
     const struct device *dev = zmk_behavior_get_binding(binding->behavior_dev);
@@ -605,8 +728,14 @@ static int on_hold_tap_binding_pressed(struct zmk_behavior_binding *binding,
         return ZMK_BEHAVIOR_OPAQUE;
     }
 
+    hold_tap->tapping_term_ms = get_tapping_term_ms(cfg, event.position);
+    hold_tap->hold_while_undecided =
+        cfg->hold_while_undecided ||
+        (cfg->speculative_hold && is_speculative_hold_safe(cfg, binding->param1));
+
     LOG_DBG("%d new undecided hold_tap", event.position);
     undecided_hold_tap = hold_tap;
+    start_capturing();
 
     if (is_quick_tap(hold_tap)) {
         decide_hold_tap(hold_tap, HT_QUICK_TAP);
@@ -614,10 +743,8 @@ static int on_hold_tap_binding_pressed(struct zmk_behavior_binding *binding,
 
     decide_hold_tap(hold_tap, HT_KEY_DOWN);
 
-    // if this behavior was queued we have to adjust the timer to only
-    // wait for the remaining time.
-    int32_t tapping_term_ms_left = (hold_tap->timestamp + cfg->tapping_term_ms) - k_uptime_get();
-    k_work_schedule(&hold_tap->work, K_MSEC(tapping_term_ms_left));
+    // if this behavior was queued the deadline may already be close, or even in the past.
+    zmk_input_timer_start(&hold_tap->timer, hold_tap->timestamp + hold_tap->tapping_term_ms);
 
     return ZMK_BEHAVIOR_OPAQUE;
 }
@@ -632,28 +759,22 @@ static int on_hold_tap_binding_released(struct zmk_behavior_binding *binding,
 
     // If these events were queued, the timer event may be queued too late or not at all.
     // We insert a timer event before the TH_KEY_UP event to verify.
-    int work_cancel_result = k_work_cancel_delayable(&hold_tap->work);
-    if (event.timestamp > (hold_tap->timestamp + hold_tap->config->tapping_term_ms)) {
+    zmk_input_timer_stop(&hold_tap->timer);
+    if (event.timestamp > (hold_tap->timestamp + hold_tap->tapping_term_ms)) {
         decide_hold_tap(hold_tap, HT_TIMER_EVENT);
     }
 
     decide_hold_tap(hold_tap, HT_KEY_UP);
+    record_tap_duration(hold_tap, event.timestamp);
     decide_retro_tap(hold_tap);
     release_binding(hold_tap);
 
-    if (hold_tap->config->hold_while_undecided && hold_tap->config->hold_while_undecided_linger) {
+    if (hold_tap->hold_while_undecided && hold_tap->config->hold_while_undecided_linger) {
         release_hold_binding(hold_tap);
     }
 
-    if (work_cancel_result == -EINPROGRESS) {
-        // let the timer handler clean up
-        // if we'd clear now, the timer may call back for an uninitialized active_hold_tap.
-        LOG_DBG("%d hold-tap timer work in event queue", event.position);
-        hold_tap->work_is_cancelled = true;
-    } else {
-        LOG_DBG("%d cleaning up hold-tap", event.position);
-        clear_hold_tap(hold_tap);
-    }
+    LOG_DBG("%d cleaning up hold-tap", event.position);
+    clear_hold_tap(hold_tap);
 
     return ZMK_BEHAVIOR_OPAQUE;
 }
@@ -706,11 +827,17 @@ static const struct behavior_driver_api behavior_hold_tap_driver_api = {
 #endif // IS_ENABLED(CONFIG_ZMK_BEHAVIOR_METADATA)
 };
 
-static int position_state_changed_listener(const zmk_event_t *eh) {
-    struct zmk_position_state_changed *ev = as_zmk_position_state_changed(eh);
+// Decides the undecided hold-tap once its captured events fill the ring, which releases them, so
+// the event that didn't fit can follow them instead of reaching the host ahead of them.
+static void decide_on_capture_overflow(enum decision_moment decision_moment) {
+    decide_hold_tap(undecided_hold_tap, decision_moment);
 
-    update_hold_status_for_retro_tap(ev->position);
+    if (undecided_hold_tap != NULL) {
+        decide_hold_tap(undecided_hold_tap, HT_TIMER_EVENT);
+    }
+}
 
+static int handle_position_state_changed(struct zmk_position_state_changed *ev) {
     if (undecided_hold_tap == NULL) {
         LOG_DBG("%d bubble (no undecided hold_tap active)", ev->position);
         return ZMK_EV_EVENT_BUBBLE;
@@ -740,7 +867,7 @@ static int position_state_changed_listener(const zmk_event_t *eh) {
     // We make a timer decision before the other key events are handled if the timer would
     // have run out.
     if (ev->timestamp >
-        (undecided_hold_tap->timestamp + undecided_hold_tap->config->tapping_term_ms)) {
+        (undecided_hold_tap->timestamp + undecided_hold_tap->tapping_term_ms)) {
         decide_hold_tap(undecided_hold_tap, HT_TIMER_EVENT);
     }
 
@@ -762,19 +889,25 @@ static int position_state_changed_listener(const zmk_event_t *eh) {
         .tag = ET_POS_CHANGED,
         .data = {.position = copy_raised_zmk_position_state_changed(ev)},
     };
-    capture_event(&capture);
+    if (capture_event(&capture) < 0) {
+        // Releasing the captured events can leave another hold-tap undecided, which this event
+        // then goes to as though it came after them.
+        decide_on_capture_overflow(ev->state ? HT_OTHER_KEY_DOWN : HT_OTHER_KEY_UP);
+        return handle_position_state_changed(ev);
+    }
     decide_hold_tap(undecided_hold_tap, ev->state ? HT_OTHER_KEY_DOWN : HT_OTHER_KEY_UP);
     return ZMK_EV_EVENT_CAPTURED;
 }
 
-static int keycode_state_changed_listener(const zmk_event_t *eh) {
-    // we want to catch layer-up events too... how?
-    struct zmk_keycode_state_changed *ev = as_zmk_keycode_state_changed(eh);
+static int position_state_changed_listener(const zmk_event_t *eh) {
+    struct zmk_position_state_changed *ev = as_zmk_position_state_changed(eh);
 
-    if (ev->state && !is_mod(ev->usage_page, ev->keycode)) {
-        store_last_tapped(ev->timestamp);
-    }
+    update_hold_status_for_retro_tap(ev->position);
+
+    return handle_position_state_changed(ev);
+}
 
+static int handle_keycode_state_changed(struct zmk_keycode_state_changed *ev) {
     if (undecided_hold_tap == NULL) {
         // LOG_DBG("0x%02X bubble (no undecided hold_tap active)", ev->keycode);
         return ZMK_EV_EVENT_BUBBLE;
@@ -786,7 +919,7 @@ static int keycode_state_changed_listener(const zmk_event_t *eh) {
     }
 
     // hold-while-undecided can produce a mod, but we don't want to capture it.
-    if (undecided_hold_tap->config->hold_while_undecided &&
+    if (undecided_hold_tap->hold_while_undecided &&
         undecided_hold_tap->status == STATUS_UNDECIDED) {
         return ZMK_EV_EVENT_BUBBLE;
     }
@@ -797,10 +930,24 @@ static int keycode_state_changed_listener(const zmk_event_t *eh) {
             ev->state ? "down" : "up");
     struct captured_event capture = {
         .tag = ET_CODE_CHANGED, .data = {.keycode = copy_raised_zmk_keycode_state_changed(ev)}};
-    capture_event(&capture);
+    if (capture_event(&capture) < 0) {
+        decide_on_capture_overflow(HT_TIMER_EVENT);
+        return handle_keycode_state_changed(ev);
+    }
     return ZMK_EV_EVENT_CAPTURED;
 }
 
+static int keycode_state_changed_listener(const zmk_event_t *eh) {
+    // we want to catch layer-up events too... how?
+    struct zmk_keycode_state_changed *ev = as_zmk_keycode_state_changed(eh);
+
+    if (ev->state && !is_mod(ev->usage_page, ev->keycode)) {
+        store_last_tapped(ev->timestamp);
+    }
+
+    return handle_keycode_state_changed(ev);
+}
+
 int behavior_hold_tap_listener(const zmk_event_t *eh) {
     if (as_zmk_position_state_changed(eh) != NULL) {
         return position_state_changed_listener(eh);
@@ -815,15 +962,12 @@ ZMK_SUBSCRIPTION(behavior_hold_tap, zmk_position_state_changed);
 // this should be modifiers_state_changed, but unfrotunately that's not implemented yet.
 ZMK_SUBSCRIPTION(behavior_hold_tap, zmk_keycode_state_changed);
 
-void behavior_hold_tap_timer_work_handler(struct k_work *item) {
-    struct k_work_delayable *d_work = k_work_delayable_from_work(item);
-    struct active_hold_tap *hold_tap = CONTAINER_OF(d_work, struct active_hold_tap, work);
+static void behavior_hold_tap_timer_handler(struct zmk_input_timer *timer) {
+    struct active_hold_tap *hold_tap = CONTAINER_OF(timer, struct active_hold_tap, timer);
 
-    if (hold_tap->work_is_cancelled) {
-        clear_hold_tap(hold_tap);
-    } else {
-        decide_hold_tap(hold_tap, HT_TIMER_EVENT);
-    }
+    zmk_input_frame_begin();
+    decide_hold_tap(hold_tap, HT_TIMER_EVENT);
+    zmk_input_frame_end();
 }
 
 static int behavior_hold_tap_init(const struct device *dev) {
@@ -831,7 +975,7 @@ static int behavior_hold_tap_init(const struct device *dev) {
 
     if (init_first_run) {
         for (int i = 0; i < ZMK_BHV_HOLD_TAP_MAX_HELD; i++) {
-            k_work_init_delayable(&active_hold_taps[i].work, behavior_hold_tap_timer_work_handler);
+            zmk_input_timer_init(&active_hold_taps[i].timer, behavior_hold_tap_timer_handler);
             active_hold_taps[i].position = ZMK_BHV_HOLD_TAP_POSITION_NOT_USED;
         }
     }
@@ -842,6 +986,9 @@ static int behavior_hold_tap_init(const struct device *dev) {
 #define KP_INST(n)                                                                                 \
     static const struct behavior_hold_tap_config behavior_hold_tap_config_##n = {                  \
         .tapping_term_ms = DT_INST_PROP(n, tapping_term_ms),                                       \
+        .adaptive_tapping_term = DT_INST_PROP(n, adaptive_tapping_term),                           \
+        .adaptive_tapping_term_min_ms = DT_INST_PROP_OR(n, adaptive_tapping_term_min_ms,           \
+                                                        DT_INST_PROP(n, tapping_term_ms) / 2),     \
         .hold_behavior_dev = DEVICE_DT_NAME(DT_INST_PHANDLE_BY_IDX(n, bindings, 0)),               \
         .tap_behavior_dev = DEVICE_DT_NAME(DT_INST_PHANDLE_BY_IDX(n, bindings, 1)),                \
         .quick_tap_ms = DT_INST_PROP(n, quick_tap_ms),                                             \
@@ -851,6 +998,7 @@ static int behavior_hold_tap_init(const struct device *dev) {
         .flavor = DT_ENUM_IDX(DT_DRV_INST(n), flavor),                                             \
         .hold_while_undecided = DT_INST_PROP(n, hold_while_undecided),                             \
         .hold_while_undecided_linger = DT_INST_PROP(n, hold_while_undecided_linger),               \
+        .speculative_hold = DT_INST_PROP(n, speculative_hold),                                     \
         .retro_tap = DT_INST_PROP(n, retro_tap),                                                   \
         .hold_trigger_on_release = DT_INST_PROP(n, hold_trigger_on_release),                       \
         .hold_trigger_key_positions = DT_INST_PROP(n, hold_trigger_key_positions),                 \
@@ -18,12 +18,16 @@
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 struct vector2d {
-    float x;
-    float y;
+    int32_t x;
+    int32_t y;
 };
 
+// Movement is computed in fixed point with this many fractional bits, so no FPU is needed.
+#define FRACTION_BITS 24
+#define FRACTION_ONE (INT64_C(1) << FRACTION_BITS)
+
 struct movement_state_1d {
-    float remainder;
+    int64_t remainder;
     int16_t speed;
     uint64_t start_time;
 };
@@ -34,8 +38,9 @@ struct movement_state_2d {
 };
 
 struct behavior_input_two_axis_data {
-    struct k_work_delayable tick_work;
     const struct device *dev;
+    // Uptime of the next tick for this instance, or 0 while it isn't moving.
+    int64_t next_tick;
 
     struct movement_state_2d state;
 };
@@ -52,19 +57,6 @@ struct behavior_input_two_axis_config {
     uint8_t acceleration_exponent;
 };
 
-#if CONFIG_MINIMAL_LIBC
-static float powf(float base, float exponent) {
-    // poor man's power implementation rounds the exponent down to the nearest integer.
-    float power = 1.0f;
-    for (; exponent >= 1.0f; exponent--) {
-        power = power * base;
-    }
-    return power;
-}
-#else
-#include <math.h>
-#endif
-
 static int64_t ms_since_start(int64_t start, int64_t now, int64_t delay) {
     if (start == 0) {
         return 0;
@@ -77,8 +69,9 @@ static int64_t ms_since_start(int64_t start, int64_t now, int64_t delay) {
     return move_duration;
 }
 
-static float speed(const struct behavior_input_two_axis_config *config, float max_speed,
-                   int64_t duration_ms) {
+// Fraction of the maximum speed reached after duration_ms, in FRACTION_BITS fixed point.
+static int64_t speed_fraction(const struct behavior_input_two_axis_config *config,
+                              int64_t duration_ms) {
     // Calculate the speed based on MouseKeysAccel
     // See https://en.wikipedia.org/wiki/Mouse_keys
     if (duration_ms == 0) {
@@ -87,34 +80,38 @@ static float speed(const struct behavior_input_two_axis_config *config, float ma
 
     if (duration_ms > config->time_to_max_speed_ms || config->time_to_max_speed_ms == 0 ||
         config->acceleration_exponent == 0) {
-        return max_speed;
+        return FRACTION_ONE;
+    }
+
+    int64_t time_fraction = (duration_ms << FRACTION_BITS) / config->time_to_max_speed_ms;
+    int64_t fraction = FRACTION_ONE;
+    for (int i = 0; i < config->acceleration_exponent; i++) {
+        fraction = (fraction * time_fraction) >> FRACTION_BITS;
     }
-    float time_fraction = (float)duration_ms / config->time_to_max_speed_ms;
-    return max_speed * powf(time_fraction, config->acceleration_exponent);
+    return fraction;
 }
 
-static void track_remainder(float *move, float *remainder) {
-    float new_move = *move + *remainder;
-    *remainder = new_move - (int)new_move;
-    *move = (int)new_move;
+// Truncates toward zero like the integer cast it replaces, keeping the fraction for the next tick.
+static int32_t track_remainder(int64_t move, int64_t *remainder) {
+    int64_t new_move = move + *remainder;
+    int64_t whole = new_move / FRACTION_ONE;
+    *remainder = new_move - whole * FRACTION_ONE;
+    return (int32_t)whole;
 }
 
-static float update_movement_1d(const struct behavior_input_two_axis_config *config,
-                                struct movement_state_1d *state, int64_t now) {
-    float move = 0;
+static int32_t update_movement_1d(const struct behavior_input_two_axis_config *config,
+                                  struct movement_state_1d *state, int64_t now) {
     if (state->speed == 0) {
         state->remainder = 0;
-        return move;
+        return 0;
     }
 
     int64_t move_duration = ms_since_start(state->start_time, now, config->delay_ms);
-    move = (move_duration > 0)
-               ? (speed(config, state->speed, move_duration) * config->trigger_period_ms / 1000)
-               : 0;
-
-    track_remainder(&(move), &(state->remainder));
+    int64_t move = (move_duration > 0) ? (state->speed * speed_fraction(config, move_duration) *
+                                          config->trigger_period_ms / 1000)
+                                       : 0;
 
-    return move;
+    return track_remainder(move, &state->remainder);
 }
 static struct vector2d update_movement_2d(const struct behavior_input_two_axis_config *config,
                                           struct movement_state_2d *state, int64_t now) {
@@ -138,14 +135,45 @@ static bool should_be_working(struct behavior_input_two_axis_data *data) {
     return is_non_zero_2d_movement(&data->state);
 }
 
-static void tick_work_cb(struct k_work *work) {
-    struct k_work_delayable *d_work = k_work_delayable_from_work(work);
-    struct behavior_input_two_axis_data *data =
-        CONTAINER_OF(d_work, struct behavior_input_two_axis_data, tick_work);
-    const struct device *dev = data->dev;
-    const struct behavior_input_two_axis_config *cfg = dev->config;
+#define ITA_DEVICE(n) DEVICE_DT_INST_GET(n),
+
+static const struct device *const instances[] = {DT_INST_FOREACH_STATUS_OKAY(ITA_DEVICE)};
+
+static void tick_work_cb(struct k_work *work);
+
+// One tick drives every moving instance, so instances moving together report together.
+static K_WORK_DELAYABLE_DEFINE(tick_work, tick_work_cb);
+
+// Uptime the tick work is scheduled for, so it's only rescheduled when the earliest tick changes.
+static int64_t scheduled_tick;
 
-    uint64_t timestamp = k_uptime_get();
+static void schedule_next_tick(void) {
+    int64_t next_tick = 0;
+
+    for (int i = 0; i < ARRAY_SIZE(instances); i++) {
+        const struct behavior_input_two_axis_data *data = instances[i]->data;
+        if (data->next_tick != 0 && (next_tick == 0 || data->next_tick < next_tick)) {
+            next_tick = data->next_tick;
+        }
+    }
+
+    if (next_tick == 0) {
+        scheduled_tick = 0;
+        k_work_cancel_delayable(&tick_work);
+        return;
+    }
+
+    if (next_tick == scheduled_tick && k_work_delayable_is_pending(&tick_work)) {
+        return;
+    }
+
+    scheduled_tick = next_tick;
+    k_work_reschedule(&tick_work, K_MSEC(MAX(next_tick - k_uptime_get(), 0)));
+}
+
+static void tick_instance(const struct device *dev, int64_t timestamp) {
+    struct behavior_input_two_axis_data *data = dev->data;
+    const struct behavior_input_two_axis_config *cfg = dev->config;
 
     LOG_INF("x start: %llu, y start: %llu, current timestamp: %llu", data->state.x.start_time,
             data->state.y.start_time, timestamp);
@@ -164,9 +192,20 @@ static void tick_work_cb(struct k_work *work) {
                                K_NO_WAIT);
     }
 
-    if (should_be_working(data)) {
-        k_work_schedule(&data->tick_work, K_MSEC(cfg->trigger_period_ms));
+    data->next_tick = should_be_working(data) ? timestamp + cfg->trigger_period_ms : 0;
+}
+
+static void tick_work_cb(struct k_work *work) {
+    int64_t timestamp = k_uptime_get();
+
+    for (int i = 0; i < ARRAY_SIZE(instances); i++) {
+        const struct behavior_input_two_axis_data *data = instances[i]->data;
+        if (data->next_tick != 0 && data->next_tick <= timestamp) {
+            tick_instance(instances[i], timestamp);
+        }
     }
+
+    schedule_next_tick();
 }
 
 static void set_start_times_for_activity_1d(struct movement_state_1d *state) {
@@ -181,17 +220,34 @@ static void set_start_times_for_activity(struct movement_state_2d *state) {
     set_start_times_for_activity_1d(&state->y);
 }
 
+// An instance that starts moving joins the tick of any instance already moving, as long as that
+// comes within its own trigger period.
+static int64_t first_tick(const struct behavior_input_two_axis_config *cfg) {
+    int64_t first = k_uptime_get() + cfg->trigger_period_ms;
+
+    for (int i = 0; i < ARRAY_SIZE(instances); i++) {
+        const struct behavior_input_two_axis_data *data = instances[i]->data;
+        if (data->next_tick != 0 && data->next_tick < first) {
+            first = data->next_tick;
+        }
+    }
+
+    return first;
+}
+
 static void update_work_scheduling(const struct device *dev) {
     struct behavior_input_two_axis_data *data = dev->data;
     const struct behavior_input_two_axis_config *cfg = dev->config;
 
     set_start_times_for_activity(&data->state);
 
-    if (should_be_working(data)) {
-        k_work_schedule(&data->tick_work, K_MSEC(cfg->trigger_period_ms));
-    } else {
-        k_work_cancel_delayable(&data->tick_work);
+    if (!should_be_working(data)) {
+        data->next_tick = 0;
+    } else if (data->next_tick == 0) {
+        data->next_tick = first_tick(cfg);
     }
+
+    schedule_next_tick();
 }
 
 int behavior_input_two_axis_adjust_speed(const struct device *dev, int16_t dx, int16_t dy) {
@@ -212,7 +268,6 @@ static int behavior_input_two_axis_init(const struct device *dev) {
     struct behavior_input_two_axis_data *data = dev->data;
 
     data->dev = dev;
-    k_work_init_delayable(&data->tick_work, tick_work_cb);
 
     return 0;
 };
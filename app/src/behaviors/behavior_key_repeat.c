@@ -14,6 +14,7 @@
 
 #include <zmk/event_manager.h>
 #include <zmk/events/keycode_state_changed.h>
+#include <zmk/key_repeat.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
@@ -41,30 +42,80 @@ static const struct behavior_parameter_metadata metadata = {
 #endif
 
 struct behavior_key_repeat_config {
-    uint8_t index;
+    uint8_t history_index;
     uint8_t usage_pages_count;
     uint16_t usage_pages[];
 };
 
+#define HISTORY_SIZE CONFIG_ZMK_BEHAVIOR_KEY_REPEAT_HISTORY_SIZE
+
 struct behavior_key_repeat_data {
-    struct zmk_keycode_state_changed last_keycode_pressed;
     struct zmk_keycode_state_changed current_keycode_pressed;
+    // The most recently pressed keycodes on the behavior's usage pages, newest at
+    // history_head - 1. Keeping one per behavior means presses on other pages can't push out the
+    // keys it repeats.
+    struct zmk_keycode_state_changed history[HISTORY_SIZE];
+    uint8_t history_head;
+    uint8_t history_len;
 };
 
+// Set while a key repeat raises its keycode, so repeating doesn't push onto the history. Otherwise
+// repeating anything but the most recent key would shift the entry it repeats.
+static bool repeating;
+
+static bool is_tracked_usage_page(const struct behavior_key_repeat_config *config,
+                                  uint16_t usage_page) {
+    for (int i = 0; i < config->usage_pages_count; i++) {
+        if (config->usage_pages[i] == usage_page) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void record_press(const struct device *dev, const struct zmk_keycode_state_changed *ev) {
+    const struct behavior_key_repeat_config *config = dev->config;
+    struct behavior_key_repeat_data *data = dev->data;
+
+    if (!is_tracked_usage_page(config, ev->usage_page)) {
+        return;
+    }
+
+    data->history[data->history_head] = *ev;
+    data->history[data->history_head].implicit_modifiers |= zmk_hid_get_explicit_mods();
+    data->history_head = (data->history_head + 1) % HISTORY_SIZE;
+    data->history_len = MIN(data->history_len + 1, HISTORY_SIZE);
+}
+
+// Find the history_index'th most recent keycode on one of the behavior's usage pages.
+static const struct zmk_keycode_state_changed *
+find_history_entry(const struct behavior_key_repeat_config *config,
+                   const struct behavior_key_repeat_data *data) {
+    if (config->history_index >= data->history_len) {
+        return NULL;
+    }
+
+    return &data->history[(data->history_head + HISTORY_SIZE - 1 - config->history_index) %
+                          HISTORY_SIZE];
+}
+
 static int on_key_repeat_binding_pressed(struct zmk_behavior_binding *binding,
                                          struct zmk_behavior_binding_event event) {
     const struct device *dev = zmk_behavior_get_binding(binding->behavior_dev);
+    const struct behavior_key_repeat_config *config = dev->config;
     struct behavior_key_repeat_data *data = dev->data;
 
-    if (data->last_keycode_pressed.usage_page == 0) {
+    const struct zmk_keycode_state_changed *entry = find_history_entry(config, data);
+    if (entry == NULL) {
         return ZMK_BEHAVIOR_OPAQUE;
     }
 
-    memcpy(&data->current_keycode_pressed, &data->last_keycode_pressed,
-           sizeof(struct zmk_keycode_state_changed));
+    data->current_keycode_pressed = *entry;
     data->current_keycode_pressed.timestamp = k_uptime_get();
 
+    repeating = true;
     raise_zmk_keycode_state_changed(data->current_keycode_pressed);
+    repeating = false;
 
     return ZMK_BEHAVIOR_OPAQUE;
 }
@@ -93,57 +144,33 @@ static const struct behavior_driver_api behavior_key_repeat_driver_api = {
 #endif // IS_ENABLED(CONFIG_ZMK_BEHAVIOR_METADATA)
 };
 
-static int key_repeat_keycode_state_changed_listener(const zmk_event_t *eh);
-
-ZMK_LISTENER(behavior_key_repeat, key_repeat_keycode_state_changed_listener);
-ZMK_SUBSCRIPTION(behavior_key_repeat, zmk_keycode_state_changed);
-
-static const struct device *devs[DT_NUM_INST_STATUS_OKAY(DT_DRV_COMPAT)];
-
-static int key_repeat_keycode_state_changed_listener(const zmk_event_t *eh) {
-    struct zmk_keycode_state_changed *ev = as_zmk_keycode_state_changed(eh);
-    if (ev == NULL || !ev->state) {
-        return ZMK_EV_EVENT_BUBBLE;
-    }
-
-    for (int i = 0; i < DT_NUM_INST_STATUS_OKAY(DT_DRV_COMPAT); i++) {
-        const struct device *dev = devs[i];
-        if (dev == NULL) {
-            continue;
-        }
-
-        struct behavior_key_repeat_data *data = dev->data;
-        const struct behavior_key_repeat_config *config = dev->config;
-
-        for (int u = 0; u < config->usage_pages_count; u++) {
-            if (config->usage_pages[u] == ev->usage_page) {
-                memcpy(&data->last_keycode_pressed, ev, sizeof(struct zmk_keycode_state_changed));
-                data->last_keycode_pressed.implicit_modifiers |= zmk_hid_get_explicit_mods();
-                break;
-            }
-        }
-    }
-
-    return ZMK_EV_EVENT_BUBBLE;
-}
-
-static int behavior_key_repeat_init(const struct device *dev) {
-    const struct behavior_key_repeat_config *config = dev->config;
-    devs[config->index] = dev;
-    return 0;
-}
-
 #define KR_INST(n)                                                                                 \
+    BUILD_ASSERT(DT_INST_PROP(n, history_index) < HISTORY_SIZE,                                    \
+                 "history-index must be less than the key repeat history size");                   \
     static struct behavior_key_repeat_data behavior_key_repeat_data_##n = {};                      \
     static struct behavior_key_repeat_config behavior_key_repeat_config_##n = {                    \
-        .index = n,                                                                                \
+        .history_index = DT_INST_PROP(n, history_index),                                           \
         .usage_pages = DT_INST_PROP(n, usage_pages),                                               \
         .usage_pages_count = DT_INST_PROP_LEN(n, usage_pages),                                     \
     };                                                                                             \
-    BEHAVIOR_DT_INST_DEFINE(n, behavior_key_repeat_init, NULL, &behavior_key_repeat_data_##n,      \
+    BEHAVIOR_DT_INST_DEFINE(n, NULL, NULL, &behavior_key_repeat_data_##n,                          \
                             &behavior_key_repeat_config_##n, POST_KERNEL,                          \
                             CONFIG_KERNEL_INIT_PRIORITY_DEFAULT, &behavior_key_repeat_driver_api);
 
 DT_INST_FOREACH_STATUS_OKAY(KR_INST)
 
+#define KR_DEVICE(n) DEVICE_DT_INST_GET(n),
+
+static const struct device *devs[] = {DT_INST_FOREACH_STATUS_OKAY(KR_DEVICE)};
+
+void zmk_key_repeat_record_press(const struct zmk_keycode_state_changed *ev) {
+    if (repeating) {
+        return;
+    }
+
+    for (int i = 0; i < ARRAY_SIZE(devs); i++) {
+        record_press(devs[i], ev);
+    }
+}
+
 #endif
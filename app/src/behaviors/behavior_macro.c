@@ -25,26 +25,43 @@ struct behavior_macro_trigger_state {
     uint32_t wait_ms;
     uint32_t tap_ms;
     enum behavior_macro_mode mode;
-    uint16_t start_index;
-    uint16_t count;
     enum param_source param1_source;
     enum param_source param2_source;
 };
 
+// A single invokable step of a macro, with the control bindings that precede it already applied.
+struct behavior_macro_step {
+    uint32_t wait_ms;
+    uint32_t tap_ms;
+    uint16_t binding_index;
+    uint8_t mode;
+    uint8_t param1_source : 4;
+    uint8_t param2_source : 4;
+};
+
+// A contiguous run of compiled steps, run on either press or release of the macro.
+struct behavior_macro_program {
+    uint16_t start_index;
+    uint16_t count;
+    uint16_t first_step;
+    uint16_t steps_len;
+};
+
 struct behavior_macro_state {
-    struct behavior_macro_trigger_state release_state;
+    struct behavior_macro_program press_program;
+    struct behavior_macro_program release_program;
 
 #if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_METADATA)
     struct behavior_parameter_metadata_set set;
 #endif // IS_ENABLED(CONFIG_ZMK_BEHAVIOR_METADATA)
-
-    uint32_t press_bindings_count;
 };
 
 struct behavior_macro_config {
     uint32_t default_wait_ms;
     uint32_t default_tap_ms;
     uint32_t count;
+    bool cancel_on_release;
+    struct behavior_macro_step *steps;
     struct zmk_behavior_binding bindings[];
 };
 
@@ -111,28 +128,65 @@ static bool handle_control_binding(struct behavior_macro_trigger_state *state,
     return true;
 }
 
+static void compile_program(const struct behavior_macro_config *cfg,
+                            struct behavior_macro_trigger_state state, uint16_t start_index,
+                            uint16_t count, uint16_t first_step,
+                            struct behavior_macro_program *program) {
+    program->start_index = start_index;
+    program->count = count;
+    program->first_step = first_step;
+    program->steps_len = 0;
+
+    for (int i = start_index; i < start_index + count; i++) {
+        if (handle_control_binding(&state, &cfg->bindings[i])) {
+            continue;
+        }
+
+        cfg->steps[first_step + program->steps_len++] = (struct behavior_macro_step){
+            .wait_ms = state.wait_ms,
+            .tap_ms = state.tap_ms,
+            .binding_index = i,
+            .mode = state.mode,
+            .param1_source = state.param1_source,
+            .param2_source = state.param2_source,
+        };
+
+        state.param1_source = PARAM_SOURCE_BINDING;
+        state.param2_source = PARAM_SOURCE_BINDING;
+    }
+}
+
 static int behavior_macro_init(const struct device *dev) {
     const struct behavior_macro_config *cfg = dev->config;
     struct behavior_macro_state *state = dev->data;
-    state->press_bindings_count = cfg->count;
-    state->release_state.start_index = cfg->count;
-    state->release_state.count = 0;
+    struct behavior_macro_trigger_state press_state = {.mode = MACRO_MODE_TAP,
+                                                       .tap_ms = cfg->default_tap_ms,
+                                                       .wait_ms = cfg->default_wait_ms};
+    struct behavior_macro_trigger_state release_state = {0};
+    uint16_t press_count = cfg->count;
+    uint16_t release_start = cfg->count;
 
     LOG_DBG("Precalculate initial release state:");
     for (int i = 0; i < cfg->count; i++) {
-        if (handle_control_binding(&state->release_state, &cfg->bindings[i])) {
+        if (handle_control_binding(&release_state, &cfg->bindings[i])) {
             // Updated state used for initial state on release.
         } else if (IS_PAUSE(cfg->bindings[i].behavior_dev)) {
-            state->release_state.start_index = i + 1;
-            state->release_state.count = cfg->count - state->release_state.start_index;
-            state->press_bindings_count = i;
-            LOG_DBG("Release will resume at %d", state->release_state.start_index);
+            release_start = i + 1;
+            press_count = i;
+            LOG_DBG("Release will resume at %d", release_start);
             break;
         } else {
             // Ignore regular invokable bindings
         }
     }
 
+    compile_program(cfg, press_state, 0, press_count, 0, &state->press_program);
+    compile_program(cfg, release_state, release_start, cfg->count - release_start,
+                    state->press_program.steps_len, &state->release_program);
+
+    LOG_DBG("Compiled %d press steps and %d release steps", state->press_program.steps_len,
+            state->release_program.steps_len);
+
     return 0;
 };
 
@@ -148,40 +202,31 @@ static uint32_t select_param(enum param_source param_source, uint32_t source_bin
     }
 };
 
-static void replace_params(struct behavior_macro_trigger_state *state,
-                           struct zmk_behavior_binding *binding,
-                           const struct zmk_behavior_binding *macro_binding) {
-    binding->param1 = select_param(state->param1_source, binding->param1, macro_binding);
-    binding->param2 = select_param(state->param2_source, binding->param2, macro_binding);
-
-    state->param1_source = PARAM_SOURCE_BINDING;
-    state->param2_source = PARAM_SOURCE_BINDING;
-}
-
-static void queue_macro(uint32_t position, const struct zmk_behavior_binding bindings[],
-                        struct behavior_macro_trigger_state state,
+static void queue_macro(uint32_t position, const struct behavior_macro_config *cfg,
+                        const struct behavior_macro_program *program,
                         const struct zmk_behavior_binding *macro_binding) {
-    LOG_DBG("Iterating macro bindings - starting: %d, count: %d", state.start_index, state.count);
-    for (int i = state.start_index; i < state.start_index + state.count; i++) {
-        if (!handle_control_binding(&state, &bindings[i])) {
-            struct zmk_behavior_binding binding = bindings[i];
-            replace_params(&state, &binding, macro_binding);
-
-            switch (state.mode) {
-            case MACRO_MODE_TAP:
-                zmk_behavior_queue_add(position, binding, true, state.tap_ms);
-                zmk_behavior_queue_add(position, binding, false, state.wait_ms);
-                break;
-            case MACRO_MODE_PRESS:
-                zmk_behavior_queue_add(position, binding, true, state.wait_ms);
-                break;
-            case MACRO_MODE_RELEASE:
-                zmk_behavior_queue_add(position, binding, false, state.wait_ms);
-                break;
-            default:
-                LOG_ERR("Unknown macro mode: %d", state.mode);
-                break;
-            }
+    LOG_DBG("Iterating macro bindings - starting: %d, count: %d", program->start_index,
+            program->count);
+    for (int i = program->first_step; i < program->first_step + program->steps_len; i++) {
+        const struct behavior_macro_step *step = &cfg->steps[i];
+        struct zmk_behavior_binding binding = cfg->bindings[step->binding_index];
+        binding.param1 = select_param(step->param1_source, binding.param1, macro_binding);
+        binding.param2 = select_param(step->param2_source, binding.param2, macro_binding);
+
+        switch (step->mode) {
+        case MACRO_MODE_TAP:
+            zmk_behavior_queue_add(position, binding, true, step->tap_ms);
+            zmk_behavior_queue_add(position, binding, false, step->wait_ms);
+            break;
+        case MACRO_MODE_PRESS:
+            zmk_behavior_queue_add(position, binding, true, step->wait_ms);
+            break;
+        case MACRO_MODE_RELEASE:
+            zmk_behavior_queue_add(position, binding, false, step->wait_ms);
+            break;
+        default:
+            LOG_ERR("Unknown macro mode: %d", step->mode);
+            break;
         }
     }
 }
@@ -191,13 +236,8 @@ static int on_macro_binding_pressed(struct zmk_behavior_binding *binding,
     const struct device *dev = zmk_behavior_get_binding(binding->behavior_dev);
     const struct behavior_macro_config *cfg = dev->config;
     struct behavior_macro_state *state = dev->data;
-    struct behavior_macro_trigger_state trigger_state = {.mode = MACRO_MODE_TAP,
-                                                         .tap_ms = cfg->default_tap_ms,
-                                                         .wait_ms = cfg->default_wait_ms,
-                                                         .start_index = 0,
-                                                         .count = state->press_bindings_count};
 
-    queue_macro(event.position, cfg->bindings, trigger_state, binding);
+    queue_macro(event.position, cfg, &state->press_program, binding);
 
     return ZMK_BEHAVIOR_OPAQUE;
 }
@@ -208,7 +248,11 @@ static int on_macro_binding_released(struct zmk_behavior_binding *binding,
     const struct behavior_macro_config *cfg = dev->config;
     struct behavior_macro_state *state = dev->data;
 
-    queue_macro(event.position, cfg->bindings, state->release_state, binding);
+    if (cfg->cancel_on_release) {
+        zmk_behavior_queue_cancel(event.position);
+    }
+
+    queue_macro(event.position, cfg, &state->release_program, binding);
 
     return ZMK_BEHAVIOR_OPAQUE;
 }
@@ -239,16 +283,18 @@ static int get_macro_parameter_metadata(const struct device *macro,
                                         struct behavior_parameter_metadata *param_metadata) {
     const struct behavior_macro_config *cfg = macro->config;
     struct behavior_macro_state *data = macro->data;
-    struct behavior_macro_trigger_state state = {0};
+    uint16_t steps_len = data->press_program.steps_len + data->release_program.steps_len;
 
-    for (int i = 0; (i < cfg->count) && (!data->set.param1_values || !data->set.param2_values);
-         i++) {
-        if (handle_control_binding(&state, &cfg->bindings[i]) ||
-            (state.param1_source == PARAM_SOURCE_BINDING &&
-             state.param2_source == PARAM_SOURCE_BINDING)) {
+    for (int s = 0; (s < steps_len) && (!data->set.param1_values || !data->set.param2_values);
+         s++) {
+        const struct behavior_macro_step *step = &cfg->steps[s];
+        if (step->param1_source == PARAM_SOURCE_BINDING &&
+            step->param2_source == PARAM_SOURCE_BINDING) {
             continue;
         }
 
+        int i = step->binding_index;
+
         LOG_DBG("checking %d for the given state", i);
 
         struct behavior_parameter_metadata binding_meta;
@@ -261,36 +307,33 @@ static int get_macro_parameter_metadata(const struct device *macro,
 
         // If both macro parameters get passed to this one entry, use
         // the metadata for this behavior verbatim.
-        if (state.param1_source != PARAM_SOURCE_BINDING &&
-            state.param2_source != PARAM_SOURCE_BINDING) {
+        if (step->param1_source != PARAM_SOURCE_BINDING &&
+            step->param2_source != PARAM_SOURCE_BINDING) {
             param_metadata->sets_len = binding_meta.sets_len;
             param_metadata->sets = binding_meta.sets;
             return 0;
         }
 
-        if (state.param1_source != PARAM_SOURCE_BINDING) {
-            assign_values_to_set(state.param1_source, &data->set,
+        if (step->param1_source != PARAM_SOURCE_BINDING) {
+            assign_values_to_set(step->param1_source, &data->set,
                                  binding_meta.sets[0].param1_values,
                                  binding_meta.sets[0].param1_values_len);
         }
 
-        if (state.param2_source != PARAM_SOURCE_BINDING) {
+        if (step->param2_source != PARAM_SOURCE_BINDING) {
             // For the param2 metadata, we need to find a set that matches fully bound first
             // parameter of our macro entry, and use the metadata from that set.
-            for (int s = 0; s < binding_meta.sets_len; s++) {
-                if (zmk_behavior_validate_param_values(binding_meta.sets[s].param1_values,
-                                                       binding_meta.sets[s].param1_values_len,
+            for (int m = 0; m < binding_meta.sets_len; m++) {
+                if (zmk_behavior_validate_param_values(binding_meta.sets[m].param1_values,
+                                                       binding_meta.sets[m].param1_values_len,
                                                        cfg->bindings[i].param1) >= 0) {
-                    assign_values_to_set(state.param2_source, &data->set,
-                                         binding_meta.sets[s].param2_values,
-                                         binding_meta.sets[s].param2_values_len);
+                    assign_values_to_set(step->param2_source, &data->set,
+                                         binding_meta.sets[m].param2_values,
+                                         binding_meta.sets[m].param2_values_len);
                     break;
                 }
             }
         }
-
-        state.param1_source = PARAM_SOURCE_BINDING;
-        state.param2_source = PARAM_SOURCE_BINDING;
     }
 
     param_metadata->sets_len = 1;
@@ -314,10 +357,13 @@ static const struct behavior_driver_api behavior_macro_driver_api = {
 
 #define MACRO_INST(inst)                                                                           \
     static struct behavior_macro_state behavior_macro_state_##inst = {};                           \
+    static struct behavior_macro_step behavior_macro_steps_##inst[DT_PROP_LEN(inst, bindings)];    \
     static struct behavior_macro_config behavior_macro_config_##inst = {                           \
         .default_wait_ms = DT_PROP_OR(inst, wait_ms, CONFIG_ZMK_MACRO_DEFAULT_WAIT_MS),            \
         .default_tap_ms = DT_PROP_OR(inst, tap_ms, CONFIG_ZMK_MACRO_DEFAULT_TAP_MS),               \
         .count = DT_PROP_LEN(inst, bindings),                                                      \
+        .cancel_on_release = DT_PROP(inst, cancel_on_release),                                     \
+        .steps = behavior_macro_steps_##inst,                                                      \
         .bindings = TRANSFORMED_BEHAVIORS(inst)};                                                  \
     BEHAVIOR_DT_DEFINE(inst, behavior_macro_init, NULL, &behavior_macro_state_##inst,              \
                        &behavior_macro_config_##inst, POST_KERNEL,                                 \
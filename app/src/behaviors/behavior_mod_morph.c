@@ -32,8 +32,25 @@ struct behavior_mod_morph_config {
 
 struct behavior_mod_morph_data {
     struct zmk_behavior_binding *pressed_binding;
+    // Binding a press would use for the current modifiers, kept up to date as they change.
+    struct zmk_behavior_binding *resolved_binding;
 };
 
+#define MOD_MORPH_DEVICE(n) DEVICE_DT_INST_GET(n),
+
+static const struct device *devs[] = {DT_INST_FOREACH_STATUS_OKAY(MOD_MORPH_DEVICE)};
+
+static void mod_morph_resolve(const struct device *dev, zmk_mod_flags_t explicit_mods) {
+    const struct behavior_mod_morph_config *cfg = dev->config;
+    struct behavior_mod_morph_data *data = dev->data;
+
+    if (explicit_mods & cfg->mods) {
+        data->resolved_binding = (struct zmk_behavior_binding *)&cfg->morph_binding;
+    } else {
+        data->resolved_binding = (struct zmk_behavior_binding *)&cfg->normal_binding;
+    }
+}
+
 static int on_mod_morph_binding_pressed(struct zmk_behavior_binding *binding,
                                         struct zmk_behavior_binding_event event) {
     const struct device *dev = zmk_behavior_get_binding(binding->behavior_dev);
@@ -45,11 +62,9 @@ static int on_mod_morph_binding_pressed(struct zmk_behavior_binding *binding,
         return -ENOTSUP;
     }
 
-    if (zmk_hid_get_explicit_mods() & cfg->mods) {
+    data->pressed_binding = data->resolved_binding;
+    if (data->pressed_binding == &cfg->morph_binding) {
         zmk_hid_masked_modifiers_set(cfg->masked_mods);
-        data->pressed_binding = (struct zmk_behavior_binding *)&cfg->morph_binding;
-    } else {
-        data->pressed_binding = (struct zmk_behavior_binding *)&cfg->normal_binding;
     }
     return behavior_keymap_binding_pressed(data->pressed_binding, event);
 }
@@ -80,7 +95,23 @@ static const struct behavior_driver_api behavior_mod_morph_driver_api = {
 #endif // IS_ENABLED(CONFIG_ZMK_BEHAVIOR_METADATA)
 };
 
-static int behavior_mod_morph_init(const struct device *dev) { return 0; }
+static int mod_morph_modifiers_state_changed_listener(const zmk_event_t *eh) {
+    zmk_mod_flags_t explicit_mods = zmk_hid_get_explicit_mods();
+
+    for (int i = 0; i < ARRAY_SIZE(devs); i++) {
+        mod_morph_resolve(devs[i], explicit_mods);
+    }
+
+    return ZMK_EV_EVENT_BUBBLE;
+}
+
+ZMK_LISTENER(behavior_mod_morph, mod_morph_modifiers_state_changed_listener);
+ZMK_SUBSCRIPTION(behavior_mod_morph, zmk_modifiers_state_changed);
+
+static int behavior_mod_morph_init(const struct device *dev) {
+    mod_morph_resolve(dev, zmk_hid_get_explicit_mods());
+    return 0;
+}
 
 #define _TRANSFORM_ENTRY(idx, node)                                                                \
     {                                                                                              \
@@ -42,6 +42,13 @@ static const struct behavior_parameter_value_metadata std_values[] = {
         .type = BEHAVIOR_PARAMETER_VALUE_TYPE_VALUE,
     },
 #endif // IS_ENABLED(CONFIG_ZMK_BLE)
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
+    {
+        .value = OUT_MIR,
+        .display_name = "Toggle Mirrored Output",
+        .type = BEHAVIOR_PARAMETER_VALUE_TYPE_VALUE,
+    },
+#endif // IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
 };
 
 static const struct behavior_parameter_metadata_set std_set = {
@@ -65,6 +72,10 @@ static int on_keymap_binding_pressed(struct zmk_behavior_binding *binding,
         return zmk_endpoints_select_transport(ZMK_TRANSPORT_USB);
     case OUT_BLE:
         return zmk_endpoints_select_transport(ZMK_TRANSPORT_BLE);
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
+    case OUT_MIR:
+        return zmk_endpoints_toggle_mirror();
+#endif // IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
     default:
         LOG_ERR("Unknown output command: %d", binding->param1);
     }
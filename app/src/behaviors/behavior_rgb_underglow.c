@@ -259,7 +259,12 @@ static const struct behavior_driver_api behavior_rgb_underglow_driver_api = {
         on_keymap_binding_convert_central_state_dependent_params,
     .binding_pressed = on_keymap_binding_pressed,
     .binding_released = on_keymap_binding_released,
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+    // The central mirrors its underglow state to the peripherals instead.
+    .locality = BEHAVIOR_LOCALITY_CENTRAL,
+#else
     .locality = BEHAVIOR_LOCALITY_GLOBAL,
+#endif
 #if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_METADATA)
     .parameter_metadata = &metadata,
 #endif
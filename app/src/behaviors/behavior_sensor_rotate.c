@@ -28,10 +28,19 @@ static int behavior_sensor_rotate_init(const struct device *dev) { return 0; };
     }
 
 #define SENSOR_ROTATE_INST(n)                                                                      \
+    BUILD_ASSERT(DT_INST_PROP(n, acceleration_max_speed) >                                         \
+                     DT_INST_PROP(n, acceleration_min_speed),                                      \
+                 "acceleration-max-speed must be greater than acceleration-min-speed");            \
+    BUILD_ASSERT(!DT_INST_NODE_HAS_PROP(n, input_code) || IS_ENABLED(CONFIG_INPUT),                \
+                 "input-code needs CONFIG_ZMK_MOUSE");                                             \
     static struct behavior_sensor_rotate_config behavior_sensor_rotate_config_##n = {              \
         .cw_binding = _TRANSFORM_ENTRY(0, n),                                                      \
         .ccw_binding = _TRANSFORM_ENTRY(1, n),                                                     \
         .tap_ms = DT_INST_PROP_OR(n, tap_ms, 5),                                                   \
+        .acceleration_max = DT_INST_PROP(n, acceleration_max),                                     \
+        .acceleration_min_speed = DT_INST_PROP(n, acceleration_min_speed),                         \
+        .acceleration_max_speed = DT_INST_PROP(n, acceleration_max_speed),                         \
+        .input_code = DT_INST_PROP_OR(n, input_code, 0),                                           \
         .override_params = false,                                                                  \
     };                                                                                             \
     static struct behavior_sensor_rotate_data behavior_sensor_rotate_data_##n = {};                \
@@ -3,6 +3,11 @@
 #include <zephyr/drivers/sensor.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+#if IS_ENABLED(CONFIG_INPUT)
+#include <zephyr/input/input.h>
+#endif
 
 #include <zmk/behavior_queue.h>
 #include <zmk/virtual_key_position.h>
@@ -11,11 +16,46 @@
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
+// Scales triggers up with the speed of rotation, keeping what rounding leaves for the next data.
+static int accelerate(const struct behavior_sensor_rotate_config *cfg,
+                      struct behavior_sensor_rotate_data *data, int sensor_index, int layer,
+                      int triggers, int64_t timestamp) {
+    if (cfg->acceleration_max <= 1 || triggers == 0) {
+        return triggers;
+    }
+
+    const int64_t elapsed = MAX(timestamp - data->last_trigger[sensor_index][layer], 1);
+    const int64_t speed = ABS(triggers) * MSEC_PER_SEC / elapsed;
+    data->last_trigger[sensor_index][layer] = timestamp;
+
+    // The multiplier in hundredths, ramping up linearly between the two speeds.
+    int64_t percent = 100;
+    if (speed >= cfg->acceleration_max_speed) {
+        percent = cfg->acceleration_max * 100;
+    } else if (speed > cfg->acceleration_min_speed) {
+        percent += (cfg->acceleration_max - 1) * 100 * (speed - cfg->acceleration_min_speed) /
+                   (cfg->acceleration_max_speed - cfg->acceleration_min_speed);
+    }
+
+    int16_t *remainder = &data->acceleration_remainder[sensor_index][layer];
+
+    // Don't let a remainder from one direction carry into the other.
+    if ((*remainder > 0 && triggers < 0) || (*remainder < 0 && triggers > 0)) {
+        *remainder = 0;
+    }
+
+    const int64_t scaled = triggers * percent + *remainder;
+    *remainder = scaled % 100;
+
+    return scaled / 100;
+}
+
 int zmk_behavior_sensor_rotate_common_accept_data(
     struct zmk_behavior_binding *binding, struct zmk_behavior_binding_event event,
     const struct zmk_sensor_config *sensor_config, size_t channel_data_size,
     const struct zmk_sensor_channel_data *channel_data) {
     const struct device *dev = zmk_behavior_get_binding(binding->behavior_dev);
+    const struct behavior_sensor_rotate_config *cfg = dev->config;
     struct behavior_sensor_rotate_data *data = dev->data;
 
     const struct sensor_value value = channel_data[0].value;
@@ -45,6 +85,8 @@ int zmk_behavior_sensor_rotate_common_accept_data(
         data->remainder[sensor_index][event.layer] = remainder;
     }
 
+    triggers = accelerate(cfg, data, sensor_index, event.layer, triggers, event.timestamp);
+
     LOG_DBG(
         "val1: %d, val2: %d, remainder: %d/%d triggers: %d inc keycode 0x%02X dec keycode 0x%02X",
         value.val1, value.val2, data->remainder[sensor_index][event.layer].val1,
@@ -71,6 +113,20 @@ int zmk_behavior_sensor_rotate_common_process(struct zmk_behavior_binding *bindi
 
     int triggers = data->triggers[sensor_index][event.layer];
 
+#if IS_ENABLED(CONFIG_INPUT)
+    // All the triggers go out as a single relative input, such as scrolling several steps in one
+    // report, instead of a queued tap each.
+    if (cfg->input_code != 0 && triggers != 0) {
+        int ret = input_report_rel(dev, cfg->input_code,
+                                   (int16_t)CLAMP(triggers, INT16_MIN, INT16_MAX), true, K_FOREVER);
+        if (ret < 0) {
+            LOG_ERR("Failed to report rotation as input %d (%d)", cfg->input_code, ret);
+        }
+
+        return ZMK_BEHAVIOR_OPAQUE;
+    }
+#endif
+
     struct zmk_behavior_binding triggered_binding;
     if (triggers > 0) {
         triggered_binding = cfg->cw_binding;
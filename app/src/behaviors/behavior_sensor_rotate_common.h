@@ -14,11 +14,22 @@ struct behavior_sensor_rotate_config {
     struct zmk_behavior_binding ccw_binding;
     int tap_ms;
     bool override_params;
+    /** Largest number of triggers one detent of fast rotation becomes, or 1 for no acceleration. */
+    int acceleration_max;
+    /** Triggers per second at which acceleration starts and reaches acceleration_max. */
+    int acceleration_min_speed;
+    int acceleration_max_speed;
+    /** Relative input code to report the triggers as, or 0 to tap the bindings. */
+    uint16_t input_code;
 };
 
 struct behavior_sensor_rotate_data {
     struct sensor_value remainder[ZMK_KEYMAP_SENSORS_LEN][ZMK_KEYMAP_LAYERS_LEN];
     int triggers[ZMK_KEYMAP_SENSORS_LEN][ZMK_KEYMAP_LAYERS_LEN];
+    /** Time of the last data that triggered, to measure the speed of rotation. */
+    int64_t last_trigger[ZMK_KEYMAP_SENSORS_LEN][ZMK_KEYMAP_LAYERS_LEN];
+    /** Accelerated triggers left over from rounding, in hundredths. */
+    int16_t acceleration_remainder[ZMK_KEYMAP_SENSORS_LEN][ZMK_KEYMAP_LAYERS_LEN];
 };
 
 int zmk_behavior_sensor_rotate_common_accept_data(
@@ -19,10 +19,16 @@ static const struct behavior_driver_api behavior_sensor_rotate_var_driver_api =
 static int behavior_sensor_rotate_var_init(const struct device *dev) { return 0; };
 
 #define SENSOR_ROTATE_VAR_INST(n)                                                                  \
+    BUILD_ASSERT(DT_INST_PROP(n, acceleration_max_speed) >                                         \
+                     DT_INST_PROP(n, acceleration_min_speed),                                      \
+                 "acceleration-max-speed must be greater than acceleration-min-speed");            \
     static struct behavior_sensor_rotate_config behavior_sensor_rotate_var_config_##n = {          \
         .cw_binding = {.behavior_dev = DEVICE_DT_NAME(DT_INST_PHANDLE_BY_IDX(n, bindings, 0))},    \
         .ccw_binding = {.behavior_dev = DEVICE_DT_NAME(DT_INST_PHANDLE_BY_IDX(n, bindings, 1))},   \
         .tap_ms = DT_INST_PROP(n, tap_ms),                                                         \
+        .acceleration_max = DT_INST_PROP(n, acceleration_max),                                     \
+        .acceleration_min_speed = DT_INST_PROP(n, acceleration_min_speed),                         \
+        .acceleration_max_speed = DT_INST_PROP(n, acceleration_max_speed),                         \
         .override_params = true,                                                                   \
     };                                                                                             \
     static struct behavior_sensor_rotate_data behavior_sensor_rotate_var_data_##n = {};            \
@@ -57,9 +57,7 @@ static int on_keymap_binding_released(struct zmk_behavior_binding *binding,
         uint32_t hold_time = k_uptime_get() - data->press_start;
 
         if (hold_time > config->hold_time_ms) {
-            if (IS_ENABLED(CONFIG_ZMK_SPLIT) && IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)) {
-                k_sleep(K_MSEC(100));
-            }
+            // The split invocations queued for the peripherals are sent by zmk_pm_soft_off().
             zmk_pm_soft_off();
         } else {
             LOG_INF("Not triggering soft off: held for %d and hold time is %d", hold_time,
@@ -10,6 +10,7 @@
 #include <drivers/behavior.h>
 #include <zephyr/logging/log.h>
 #include <zmk/behavior.h>
+#include <zmk/behavior_pool.h>
 
 #include <zmk/matrix.h>
 #include <zmk/endpoints.h>
@@ -19,6 +20,7 @@
 #include <zmk/events/modifiers_state_changed.h>
 #include <zmk/hid.h>
 #include <zmk/keymap.h>
+#include <zmk/input_timer.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
@@ -26,7 +28,7 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #define KEY_PRESS DEVICE_DT_NAME(DT_INST(0, zmk_behavior_key_press))
 
-#define ZMK_BHV_STICKY_KEY_MAX_HELD 10
+#define ZMK_BHV_STICKY_KEY_MAX_HELD ZMK_BEHAVIOR_POOL_SIZE(DT_DRV_COMPAT, 10)
 
 #define ZMK_BHV_STICKY_KEY_POSITION_FREE UINT32_MAX
 
@@ -45,9 +47,8 @@ struct active_sticky_key {
     const struct behavior_sticky_key_config *config;
     // timer data.
     bool timer_started;
-    bool timer_cancelled;
     int64_t release_at;
-    struct k_work_delayable release_timer;
+    struct zmk_input_timer release_timer;
     // usage page and keycode for the key that is being modified by this sticky key
     uint8_t modified_key_usage_page;
     uint32_t modified_key_keycode;
@@ -55,13 +56,17 @@ struct active_sticky_key {
 
 struct active_sticky_key active_sticky_keys[ZMK_BHV_STICKY_KEY_MAX_HELD] = {};
 
+static int sticky_key_keycode_state_changed_listener(const zmk_event_t *eh);
+
+// Only enabled while a sticky key is active, so other keycode events don't pay for it.
+ZMK_LISTENER_DYNAMIC(behavior_sticky_key, sticky_key_keycode_state_changed_listener, false);
+
 static struct active_sticky_key *store_sticky_key(uint32_t position, uint32_t param1,
                                                   uint32_t param2,
                                                   const struct behavior_sticky_key_config *config) {
     for (int i = 0; i < ZMK_BHV_STICKY_KEY_MAX_HELD; i++) {
         struct active_sticky_key *const sticky_key = &active_sticky_keys[i];
-        if (sticky_key->position != ZMK_BHV_STICKY_KEY_POSITION_FREE ||
-            sticky_key->timer_cancelled) {
+        if (sticky_key->position != ZMK_BHV_STICKY_KEY_POSITION_FREE) {
             continue;
         }
         sticky_key->position = position;
@@ -69,10 +74,10 @@ static struct active_sticky_key *store_sticky_key(uint32_t position, uint32_t pa
         sticky_key->param2 = param2;
         sticky_key->config = config;
         sticky_key->release_at = 0;
-        sticky_key->timer_cancelled = false;
         sticky_key->timer_started = false;
         sticky_key->modified_key_usage_page = 0;
         sticky_key->modified_key_keycode = 0;
+        ZMK_LISTENER_SET_ENABLED(behavior_sticky_key, true);
         return sticky_key;
     }
     return NULL;
@@ -80,11 +85,18 @@ static struct active_sticky_key *store_sticky_key(uint32_t position, uint32_t pa
 
 static void clear_sticky_key(struct active_sticky_key *sticky_key) {
     sticky_key->position = ZMK_BHV_STICKY_KEY_POSITION_FREE;
+
+    for (int i = 0; i < ZMK_BHV_STICKY_KEY_MAX_HELD; i++) {
+        if (active_sticky_keys[i].position != ZMK_BHV_STICKY_KEY_POSITION_FREE) {
+            return;
+        }
+    }
+    ZMK_LISTENER_SET_ENABLED(behavior_sticky_key, false);
 }
 
 static struct active_sticky_key *find_sticky_key(uint32_t position) {
     for (int i = 0; i < ZMK_BHV_STICKY_KEY_MAX_HELD; i++) {
-        if (active_sticky_keys[i].position == position && !active_sticky_keys[i].timer_cancelled) {
+        if (active_sticky_keys[i].position == position) {
             return &active_sticky_keys[i];
         }
     }
@@ -130,13 +142,8 @@ static inline void on_sticky_key_timeout(struct active_sticky_key *sticky_key) {
     }
 }
 
-static int stop_timer(struct active_sticky_key *sticky_key) {
-    int timer_cancel_result = k_work_cancel_delayable(&sticky_key->release_timer);
-    if (timer_cancel_result == -EINPROGRESS) {
-        // too late to cancel, we'll let the timer handler clear up.
-        sticky_key->timer_cancelled = true;
-    }
-    return timer_cancel_result;
+static void stop_timer(struct active_sticky_key *sticky_key) {
+    zmk_input_timer_stop(&sticky_key->release_timer);
 }
 
 static int on_sticky_key_binding_pressed(struct zmk_behavior_binding *binding,
@@ -183,7 +190,7 @@ static int on_sticky_key_binding_released(struct zmk_behavior_binding *binding,
     // adjust timer in case this behavior was queued by a hold-tap
     int32_t ms_left = sticky_key->release_at - k_uptime_get();
     if (ms_left > 0) {
-        k_work_schedule(&sticky_key->release_timer, K_MSEC(ms_left));
+        zmk_input_timer_start(&sticky_key->release_timer, sticky_key->release_at);
     }
     return ZMK_BEHAVIOR_OPAQUE;
 }
@@ -225,9 +232,6 @@ static const struct behavior_driver_api behavior_sticky_key_driver_api = {
 #endif // IS_ENABLED(CONFIG_ZMK_BEHAVIOR_METADATA)
 };
 
-static int sticky_key_keycode_state_changed_listener(const zmk_event_t *eh);
-
-ZMK_LISTENER(behavior_sticky_key, sticky_key_keycode_state_changed_listener);
 ZMK_SUBSCRIPTION(behavior_sticky_key, zmk_keycode_state_changed);
 
 static int sticky_key_keycode_state_changed_listener(const zmk_event_t *eh) {
@@ -338,26 +342,21 @@ static int sticky_key_keycode_state_changed_listener(const zmk_event_t *eh) {
     return event_reraised ? ZMK_EV_EVENT_CAPTURED : ZMK_EV_EVENT_BUBBLE;
 }
 
-void behavior_sticky_key_timer_handler(struct k_work *item) {
-    struct k_work_delayable *d_work = k_work_delayable_from_work(item);
+static void behavior_sticky_key_timer_handler(struct zmk_input_timer *timer) {
     struct active_sticky_key *sticky_key =
-        CONTAINER_OF(d_work, struct active_sticky_key, release_timer);
+        CONTAINER_OF(timer, struct active_sticky_key, release_timer);
     if (sticky_key->position == ZMK_BHV_STICKY_KEY_POSITION_FREE) {
         return;
     }
-    if (sticky_key->timer_cancelled) {
-        sticky_key->timer_cancelled = false;
-    } else {
-        on_sticky_key_timeout(sticky_key);
-    }
+    on_sticky_key_timeout(sticky_key);
 }
 
 static int behavior_sticky_key_init(const struct device *dev) {
     static bool init_first_run = true;
     if (init_first_run) {
         for (int i = 0; i < ZMK_BHV_STICKY_KEY_MAX_HELD; i++) {
-            k_work_init_delayable(&active_sticky_keys[i].release_timer,
-                                  behavior_sticky_key_timer_handler);
+            zmk_input_timer_init(&active_sticky_keys[i].release_timer,
+                                 behavior_sticky_key_timer_handler);
             active_sticky_keys[i].position = ZMK_BHV_STICKY_KEY_POSITION_FREE;
         }
     }
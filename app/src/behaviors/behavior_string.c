@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define DT_DRV_COMPAT zmk_behavior_string
+
+#include <zephyr/device.h>
+#include <drivers/behavior.h>
+#include <zephyr/logging/log.h>
+
+#include <dt-bindings/zmk/keys.h>
+#include <zmk/behavior.h>
+#include <zmk/behavior_queue.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#if DT_HAS_COMPAT_STATUS_OKAY(DT_DRV_COMPAT)
+
+// Order matches the unicode-mode enum in the binding.
+enum string_unicode_mode {
+    UNICODE_MODE_NONE,
+    UNICODE_MODE_LINUX,
+    UNICODE_MODE_MACOS,
+    UNICODE_MODE_WINCOMPOSE,
+};
+
+struct behavior_string_config {
+    const char *text;
+    size_t text_len;
+    uint32_t wait_ms;
+    uint32_t tap_ms;
+    enum string_unicode_mode unicode_mode;
+};
+
+#define KEY_PRESS DEVICE_DT_NAME(DT_INST(0, zmk_behavior_key_press))
+
+// Keycodes for printable ASCII, starting at ' ', on a US layout host.
+static const uint32_t ascii_keys[] = {
+    SPACE, EXCL,  DQT,   HASH,  DLLR,  PRCNT, AMPS,  SQT,   LPAR,  RPAR,  STAR,  PLUS,
+    COMMA, MINUS, DOT,   FSLH,  N0,    N1,    N2,    N3,    N4,    N5,    N6,    N7,
+    N8,    N9,    COLON, SEMI,  LT,    EQUAL, GT,    QMARK, AT,    LS(A), LS(B), LS(C),
+    LS(D), LS(E), LS(F), LS(G), LS(H), LS(I), LS(J), LS(K), LS(L), LS(M), LS(N), LS(O),
+    LS(P), LS(Q), LS(R), LS(S), LS(T), LS(U), LS(V), LS(W), LS(X), LS(Y), LS(Z), LBKT,
+    BSLH,  RBKT,  CARET, UNDER, GRAVE, A,     B,     C,     D,     E,     F,     G,
+    H,     I,     J,     K,     L,     M,     N,     O,     P,     Q,     R,     S,
+    T,     U,     V,     W,     X,     Y,     Z,     LBRC,  PIPE,  RBRC,  TILDE,
+};
+
+BUILD_ASSERT(ARRAY_SIZE(ascii_keys) == '~' - ' ' + 1);
+
+static const uint32_t hex_digit_keys[] = {N0, N1, N2, N3, N4, N5, N6, N7,
+                                          N8, N9, A,  B,  C,  D,  E,  F};
+
+// Queuing a character's keys stops at the first failure, since the queue only fails when full.
+// With counting set, the keys are only counted, not queued.
+struct string_output {
+    const struct behavior_string_config *cfg;
+    uint32_t position;
+    bool counting;
+    int err;
+    int queued;
+};
+
+static void queue_key(struct string_output *out, uint32_t keycode, bool press, uint32_t wait) {
+    if (out->err) {
+        return;
+    }
+
+    if (out->counting) {
+        out->queued++;
+        return;
+    }
+
+    struct zmk_behavior_binding binding = {.behavior_dev = KEY_PRESS, .param1 = keycode};
+    out->err = zmk_behavior_queue_add(out->position, binding, press, wait);
+    out->queued++;
+}
+
+static void tap_key(struct string_output *out, uint32_t keycode) {
+    queue_key(out, keycode, true, out->cfg->tap_ms);
+    queue_key(out, keycode, false, out->cfg->wait_ms);
+}
+
+static void tap_hex(struct string_output *out, uint32_t value, int min_digits) {
+    int digits = min_digits;
+    while (digits < 8 && (value >> (digits * 4)) != 0) {
+        digits++;
+    }
+
+    for (int i = digits - 1; i >= 0; i--) {
+        tap_key(out, hex_digit_keys[(value >> (i * 4)) & 0xF]);
+    }
+}
+
+static void queue_unicode(struct string_output *out, uint32_t codepoint) {
+    switch (out->cfg->unicode_mode) {
+    case UNICODE_MODE_LINUX:
+        // IBus: Ctrl+Shift+U, the hex code point, then Space to commit it.
+        tap_key(out, LC(LS(U)));
+        tap_hex(out, codepoint, 4);
+        tap_key(out, SPACE);
+        break;
+    case UNICODE_MODE_MACOS:
+        // "Unicode Hex Input" input source: hold Option while typing UTF-16 code units.
+        queue_key(out, LALT, true, out->cfg->wait_ms);
+        if (codepoint > 0xFFFF) {
+            codepoint -= 0x10000;
+            tap_hex(out, 0xD800 + (codepoint >> 10), 4);
+            tap_hex(out, 0xDC00 + (codepoint & 0x3FF), 4);
+        } else {
+            tap_hex(out, codepoint, 4);
+        }
+        queue_key(out, LALT, false, out->cfg->wait_ms);
+        break;
+    case UNICODE_MODE_WINCOMPOSE:
+        // WinCompose with Right Alt as the compose key: Compose, U, the hex code point, Enter.
+        tap_key(out, RALT);
+        tap_key(out, U);
+        tap_hex(out, codepoint, 1);
+        tap_key(out, RET);
+        break;
+    default:
+        if (!out->counting) {
+            LOG_WRN("No unicode-mode set, skipping U+%04X", codepoint);
+        }
+        break;
+    }
+}
+
+static void queue_codepoint(struct string_output *out, uint32_t codepoint) {
+    if (codepoint >= ' ' && codepoint <= '~') {
+        tap_key(out, ascii_keys[codepoint - ' ']);
+    } else if (codepoint == '\n') {
+        tap_key(out, RET);
+    } else if (codepoint == '\t') {
+        tap_key(out, TAB);
+    } else {
+        queue_unicode(out, codepoint);
+    }
+}
+
+// A character's keys are only queued if they all fit, so a full queue can't leave one of its
+// presses without the matching release, and the key held on the host.
+static void queue_character(struct string_output *out, uint32_t codepoint) {
+    struct string_output count = {.cfg = out->cfg, .counting = true};
+
+    if (out->err) {
+        return;
+    }
+
+    queue_codepoint(&count, codepoint);
+    if (count.queued > zmk_behavior_queue_free_count()) {
+        out->err = -ENOMSG;
+        return;
+    }
+
+    queue_codepoint(out, codepoint);
+}
+
+// Decodes the UTF-8 sequence at text, returning its length. Malformed sequences decode one byte
+// at a time as U+FFFD.
+static size_t decode_utf8(const uint8_t *text, size_t len, uint32_t *codepoint) {
+    size_t seq_len;
+
+    if (text[0] < 0x80) {
+        *codepoint = text[0];
+        return 1;
+    } else if ((text[0] & 0xE0) == 0xC0) {
+        seq_len = 2;
+        *codepoint = text[0] & 0x1F;
+    } else if ((text[0] & 0xF0) == 0xE0) {
+        seq_len = 3;
+        *codepoint = text[0] & 0x0F;
+    } else if ((text[0] & 0xF8) == 0xF0) {
+        seq_len = 4;
+        *codepoint = text[0] & 0x07;
+    } else {
+        *codepoint = 0xFFFD;
+        return 1;
+    }
+
+    if (seq_len > len) {
+        *codepoint = 0xFFFD;
+        return 1;
+    }
+
+    for (size_t i = 1; i < seq_len; i++) {
+        if ((text[i] & 0xC0) != 0x80) {
+            *codepoint = 0xFFFD;
+            return 1;
+        }
+        *codepoint = (*codepoint << 6) | (text[i] & 0x3F);
+    }
+
+    return seq_len;
+}
+
+/*
+ * Only a chunk of the text is queued at a time, followed by a binding to this behavior that
+ * queues the next chunk once the queue reaches it. param1 of that binding holds the offset to
+ * continue from, plus one so it can't be mistaken for the keymap binding. Long strings then use a
+ * bounded part of the behavior queue and keep to its pacing.
+ */
+static int on_string_binding_pressed(struct zmk_behavior_binding *binding,
+                                     struct zmk_behavior_binding_event event) {
+    const struct device *dev = zmk_behavior_get_binding(binding->behavior_dev);
+    const struct behavior_string_config *cfg = dev->config;
+    struct string_output out = {.cfg = cfg, .position = event.position};
+    size_t offset = binding->param1 > 0 ? binding->param1 - 1 : 0;
+
+    while (offset < cfg->text_len && out.queued < CONFIG_ZMK_BEHAVIOR_STRING_QUEUE_CHUNK) {
+        uint32_t codepoint;
+        offset += decode_utf8((const uint8_t *)&cfg->text[offset], cfg->text_len - offset,
+                              &codepoint);
+        queue_character(&out, codepoint);
+    }
+
+    if (out.err) {
+        LOG_ERR("Failed to queue string output at offset %zu (%d)", offset, out.err);
+        return ZMK_BEHAVIOR_OPAQUE;
+    }
+
+    if (offset < cfg->text_len) {
+        struct zmk_behavior_binding next = {.behavior_dev = binding->behavior_dev,
+                                            .param1 = offset + 1};
+        int err = zmk_behavior_queue_add(event.position, next, true, 0);
+        if (err < 0) {
+            LOG_ERR("Failed to queue the rest of the string at offset %zu (%d)", offset, err);
+        }
+    }
+
+    return ZMK_BEHAVIOR_OPAQUE;
+}
+
+static int on_string_binding_released(struct zmk_behavior_binding *binding,
+                                      struct zmk_behavior_binding_event event) {
+    return ZMK_BEHAVIOR_OPAQUE;
+}
+
+static const struct behavior_driver_api behavior_string_driver_api = {
+    .binding_pressed = on_string_binding_pressed,
+    .binding_released = on_string_binding_released,
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_METADATA)
+    .get_parameter_metadata = zmk_behavior_get_empty_param_metadata,
+#endif // IS_ENABLED(CONFIG_ZMK_BEHAVIOR_METADATA)
+};
+
+#define STRING_INST(n)                                                                             \
+    static const struct behavior_string_config behavior_string_config_##n = {                      \
+        .text = DT_INST_PROP(n, text),                                                             \
+        .text_len = sizeof(DT_INST_PROP(n, text)) - 1,                                             \
+        .wait_ms = DT_INST_PROP_OR(n, wait_ms, CONFIG_ZMK_MACRO_DEFAULT_WAIT_MS),                  \
+        .tap_ms = DT_INST_PROP_OR(n, tap_ms, CONFIG_ZMK_MACRO_DEFAULT_TAP_MS),                     \
+        .unicode_mode = DT_INST_ENUM_IDX(n, unicode_mode),                                         \
+    };                                                                                             \
+    BEHAVIOR_DT_INST_DEFINE(n, NULL, NULL, NULL, &behavior_string_config_##n, POST_KERNEL,         \
+                            CONFIG_KERNEL_INIT_PRIORITY_DEFAULT, &behavior_string_driver_api);
+
+DT_INST_FOREACH_STATUS_OKAY(STRING_INST)
+
+#endif
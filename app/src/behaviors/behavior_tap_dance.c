@@ -10,18 +10,20 @@
 #include <drivers/behavior.h>
 #include <zephyr/logging/log.h>
 #include <zmk/behavior.h>
+#include <zmk/behavior_pool.h>
 #include <zmk/keymap.h>
 #include <zmk/matrix.h>
 #include <zmk/event_manager.h>
 #include <zmk/events/position_state_changed.h>
 #include <zmk/events/keycode_state_changed.h>
 #include <zmk/hid.h>
+#include <zmk/input_timer.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #if DT_HAS_COMPAT_STATUS_OKAY(DT_DRV_COMPAT)
 
-#define ZMK_BHV_TAP_DANCE_MAX_HELD 10
+#define ZMK_BHV_TAP_DANCE_MAX_HELD ZMK_BEHAVIOR_POOL_SIZE(DT_DRV_COMPAT, 10)
 
 #define ZMK_BHV_TAP_DANCE_POSITION_FREE UINT32_MAX
 
@@ -42,17 +44,26 @@ struct active_tap_dance {
 
     // Timer Data
     bool timer_started;
-    bool timer_cancelled;
     bool tap_dance_decided;
     int64_t release_at;
-    struct k_work_delayable release_timer;
+    struct zmk_input_timer release_timer;
 };
 
 struct active_tap_dance active_tap_dances[ZMK_BHV_TAP_DANCE_MAX_HELD] = {};
 
+BUILD_ASSERT(ZMK_BHV_TAP_DANCE_MAX_HELD <= 32, "Active tap dances must fit in a 32 bit mask");
+
+// One bit per entry in active_tap_dances that is in use, so lookups and the position listener
+// only visit active tap dances, and skip all work when there are none.
+static uint32_t active_tap_dances_mask;
+
+#define FOR_EACH_ACTIVE_TAP_DANCE(i, mask)                                                         \
+    for (uint32_t _mask = (mask), i; _mask != 0 && (i = __builtin_ctz(_mask), true);               \
+         _mask &= _mask - 1)
+
 static struct active_tap_dance *find_tap_dance(uint32_t position) {
-    for (int i = 0; i < ZMK_BHV_TAP_DANCE_MAX_HELD; i++) {
-        if (active_tap_dances[i].position == position && !active_tap_dances[i].timer_cancelled) {
+    FOR_EACH_ACTIVE_TAP_DANCE(i, active_tap_dances_mask) {
+        if (active_tap_dances[i].position == position) {
             return &active_tap_dances[i];
         }
     }
@@ -61,35 +72,33 @@ static struct active_tap_dance *find_tap_dance(uint32_t position) {
 
 static int new_tap_dance(uint32_t position, const struct behavior_tap_dance_config *config,
                          struct active_tap_dance **tap_dance) {
-    for (int i = 0; i < ZMK_BHV_TAP_DANCE_MAX_HELD; i++) {
-        struct active_tap_dance *const ref_dance = &active_tap_dances[i];
-        if (ref_dance->position == ZMK_BHV_TAP_DANCE_POSITION_FREE) {
-            ref_dance->counter = 0;
-            ref_dance->position = position;
-            ref_dance->config = config;
-            ref_dance->release_at = 0;
-            ref_dance->is_pressed = true;
-            ref_dance->timer_started = true;
-            ref_dance->timer_cancelled = false;
-            ref_dance->tap_dance_decided = false;
-            *tap_dance = ref_dance;
-            return 0;
-        }
+    // GENMASK rather than BIT_MASK, which would shift by 32 for a full pool.
+    uint32_t free_mask = ~active_tap_dances_mask & GENMASK(ZMK_BHV_TAP_DANCE_MAX_HELD - 1, 0);
+    if (free_mask == 0) {
+        return -ENOMEM;
     }
-    return -ENOMEM;
+
+    int i = __builtin_ctz(free_mask);
+    struct active_tap_dance *const ref_dance = &active_tap_dances[i];
+    ref_dance->counter = 0;
+    ref_dance->position = position;
+    ref_dance->config = config;
+    ref_dance->release_at = 0;
+    ref_dance->is_pressed = true;
+    ref_dance->timer_started = true;
+    ref_dance->tap_dance_decided = false;
+    active_tap_dances_mask |= BIT(i);
+    *tap_dance = ref_dance;
+    return 0;
 }
 
 static void clear_tap_dance(struct active_tap_dance *tap_dance) {
     tap_dance->position = ZMK_BHV_TAP_DANCE_POSITION_FREE;
+    active_tap_dances_mask &= ~BIT(ARRAY_INDEX(active_tap_dances, tap_dance));
 }
 
-static int stop_timer(struct active_tap_dance *tap_dance) {
-    int timer_cancel_result = k_work_cancel_delayable(&tap_dance->release_timer);
-    if (timer_cancel_result == -EINPROGRESS) {
-        // too late to cancel, we'll let the timer handler clear up.
-        tap_dance->timer_cancelled = true;
-    }
-    return timer_cancel_result;
+static void stop_timer(struct active_tap_dance *tap_dance) {
+    zmk_input_timer_stop(&tap_dance->release_timer);
 }
 
 static void reset_timer(struct active_tap_dance *tap_dance,
@@ -97,7 +106,7 @@ static void reset_timer(struct active_tap_dance *tap_dance,
     tap_dance->release_at = event.timestamp + tap_dance->config->tapping_term_ms;
     int32_t ms_left = tap_dance->release_at - k_uptime_get();
     if (ms_left > 0) {
-        k_work_schedule(&tap_dance->release_timer, K_MSEC(ms_left));
+        zmk_input_timer_start(&tap_dance->release_timer, tap_dance->release_at);
         LOG_DBG("Successfully reset timer at position %d", tap_dance->position);
     }
 }
@@ -168,16 +177,12 @@ static int on_tap_dance_binding_released(struct zmk_behavior_binding *binding,
     return ZMK_BEHAVIOR_OPAQUE;
 }
 
-void behavior_tap_dance_timer_handler(struct k_work *item) {
-    struct k_work_delayable *d_work = k_work_delayable_from_work(item);
+static void behavior_tap_dance_timer_handler(struct zmk_input_timer *timer) {
     struct active_tap_dance *tap_dance =
-        CONTAINER_OF(d_work, struct active_tap_dance, release_timer);
+        CONTAINER_OF(timer, struct active_tap_dance, release_timer);
     if (tap_dance->position == ZMK_BHV_TAP_DANCE_POSITION_FREE) {
         return;
     }
-    if (tap_dance->timer_cancelled) {
-        return;
-    }
     LOG_DBG("Tap dance has been decided via timer. Counter reached: %d", tap_dance->counter);
     press_tap_dance_behavior(tap_dance, tap_dance->release_at);
     if (tap_dance->is_pressed) {
@@ -208,11 +213,8 @@ static int tap_dance_position_state_changed_listener(const zmk_event_t *eh) {
         LOG_DBG("Ignore upstroke at position %d.", ev->position);
         return ZMK_EV_EVENT_BUBBLE;
     }
-    for (int i = 0; i < ZMK_BHV_TAP_DANCE_MAX_HELD; i++) {
+    FOR_EACH_ACTIVE_TAP_DANCE(i, active_tap_dances_mask) {
         struct active_tap_dance *tap_dance = &active_tap_dances[i];
-        if (tap_dance->position == ZMK_BHV_TAP_DANCE_POSITION_FREE) {
-            continue;
-        }
         if (tap_dance->position == ev->position) {
             continue;
         }
@@ -233,8 +235,8 @@ static int behavior_tap_dance_init(const struct device *dev) {
     static bool init_first_run = true;
     if (init_first_run) {
         for (int i = 0; i < ZMK_BHV_TAP_DANCE_MAX_HELD; i++) {
-            k_work_init_delayable(&active_tap_dances[i].release_timer,
-                                  behavior_tap_dance_timer_handler);
+            zmk_input_timer_init(&active_tap_dances[i].release_timer,
+                                 behavior_tap_dance_timer_handler);
             clear_tap_dance(&active_tap_dances[i]);
         }
     }
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+
+#include <zmk/benchmark.h>
+#include <zmk/boot_timing.h>
+#include <zmk/endpoint_latency.h>
+
+/*
+ * Simulated time on native_posix only advances while every thread is idle, so processing time is
+ * measured with the host's clock instead. Report latency is measured in simulated time, which
+ * shows the delays added by behaviors waiting on timeouts, such as hold-taps and combos.
+ *
+ * The results are printed as one JSON object per line when the process exits, which happens once
+ * the mock kscan has replayed all of its events.
+ */
+#define RESULT_PREFIX "zmk-benchmark "
+
+struct benchmark_stat {
+    uint32_t count;
+    uint64_t sum;
+    uint64_t max;
+};
+
+static struct k_spinlock lock;
+
+static struct benchmark_stat key_event_ns;
+static struct benchmark_stat key_event_listener_calls;
+static struct benchmark_stat report_latency_ms;
+
+static atomic_t listener_calls;
+
+static uint64_t key_event_start_ns;
+static atomic_val_t key_event_start_calls;
+
+static const char *const queue_names[] = {
+    [ZMK_BENCHMARK_QUEUE_KSCAN] = "kscan",
+    [ZMK_BENCHMARK_QUEUE_BEHAVIORS] = "behaviors",
+};
+
+BUILD_ASSERT(ARRAY_SIZE(queue_names) == ZMK_BENCHMARK_QUEUE_COUNT);
+
+static uint32_t queue_depth[ZMK_BENCHMARK_QUEUE_COUNT];
+static uint32_t queue_high_water[ZMK_BENCHMARK_QUEUE_COUNT];
+
+static uint64_t host_now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void stat_add(struct benchmark_stat *stat, uint64_t value) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    stat->count++;
+    stat->sum += value;
+    stat->max = MAX(stat->max, value);
+
+    k_spin_unlock(&lock, key);
+}
+
+void zmk_benchmark_key_event_begin(void) {
+    key_event_start_calls = atomic_get(&listener_calls);
+    key_event_start_ns = host_now_ns();
+}
+
+void zmk_benchmark_key_event_end(void) {
+    stat_add(&key_event_ns, host_now_ns() - key_event_start_ns);
+    stat_add(&key_event_listener_calls, atomic_get(&listener_calls) - key_event_start_calls);
+}
+
+void zmk_benchmark_listener_called(void) { atomic_inc(&listener_calls); }
+
+void zmk_benchmark_report_sent(void) {
+    stat_add(&report_latency_ms, (uint32_t)k_uptime_get() - zmk_endpoint_latency_origin());
+}
+
+void zmk_benchmark_queue_push(enum zmk_benchmark_queue queue) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    queue_depth[queue]++;
+    queue_high_water[queue] = MAX(queue_high_water[queue], queue_depth[queue]);
+
+    k_spin_unlock(&lock, key);
+}
+
+void zmk_benchmark_queue_pop(enum zmk_benchmark_queue queue) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (queue_depth[queue] > 0) {
+        queue_depth[queue]--;
+    }
+
+    k_spin_unlock(&lock, key);
+}
+
+static void print_stat(const char *metric, const struct benchmark_stat *stat) {
+    uint64_t avg = stat->count ? stat->sum / stat->count : 0;
+
+    printk(RESULT_PREFIX "{\"metric\":\"%s\",\"count\":%u,\"avg\":%llu,\"max\":%llu}\n", metric,
+           stat->count, (unsigned long long)avg, (unsigned long long)stat->max);
+}
+
+static void print_results(void) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    print_stat("key_event_ns", &key_event_ns);
+    print_stat("key_event_listener_calls", &key_event_listener_calls);
+    print_stat("report_latency_ms", &report_latency_ms);
+
+    printk(RESULT_PREFIX "{\"metric\":\"listener_calls\",\"value\":%ld}\n",
+           (long)atomic_get(&listener_calls));
+
+    for (int i = 0; i < ZMK_BENCHMARK_QUEUE_COUNT; i++) {
+        printk(RESULT_PREFIX "{\"metric\":\"queue_high_water\",\"queue\":\"%s\",\"value\":%u}\n",
+               queue_names[i], queue_high_water[i]);
+    }
+
+    k_spin_unlock(&lock, key);
+}
+
+static int benchmark_init(void) {
+    atexit(print_results);
+    return 0;
+}
+
+ZMK_SYS_INIT(benchmark_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -31,11 +31,17 @@
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
+#include <zmk/activity.h>
 #include <zmk/ble.h>
+#include <zmk/hog.h>
 #include <zmk/keys.h>
+#include <zmk/settings.h>
 #include <zmk/split/bluetooth/uuid.h>
+#include <zmk/split/bluetooth/central.h>
 #include <zmk/event_manager.h>
+#include <zmk/events/activity_state_changed.h>
 #include <zmk/events/ble_active_profile_changed.h>
+#include <zmk/boot_timing.h>
 
 #if IS_ENABLED(CONFIG_ZMK_BLE_PASSKEY_ENTRY)
 #include <zmk/events/keycode_state_changed.h>
@@ -107,7 +113,9 @@ void set_profile_address(uint8_t index, const bt_addr_le_t *addr) {
     sprintf(setting_name, "ble/profiles/%d", index);
     LOG_DBG("Setting profile addr for %s to %s", setting_name, addr_str);
 #if IS_ENABLED(CONFIG_SETTINGS)
-    settings_save_one(setting_name, &profiles[index], sizeof(struct zmk_ble_profile));
+    // The stack has already stored the bond, so don't leave the profile waiting for the debounce.
+    zmk_settings_save(setting_name, &profiles[index], sizeof(struct zmk_ble_profile));
+    zmk_settings_save_flush();
 #endif
     k_work_submit(&raise_profile_changed_event_work);
 }
@@ -145,8 +153,7 @@ bool zmk_ble_active_profile_is_connected(void) {
         bt_conn_unref(conn);                                                                       \
         return 0;                                                                                  \
     }                                                                                              \
-    err = bt_le_adv_start(BT_LE_ADV_CONN_DIR_LOW_DUTY(addr), zmk_ble_ad, ARRAY_SIZE(zmk_ble_ad),   \
-                          NULL, 0);                                                                \
+    err = start_directed_advertising(addr);                                                        \
     if (err) {                                                                                     \
         LOG_ERR("Advertising failed to start (err %d)", err);                                      \
         return err;                                                                                \
@@ -161,6 +168,67 @@ bool zmk_ble_active_profile_is_connected(void) {
     }                                                                                              \
     advertising_status = ZMK_ADV_CONN;
 
+#if IS_ENABLED(CONFIG_ZMK_BLE_DIRECTED_ADV)
+
+// Directed advertising is tried once per reconnect, then undirected advertising takes over.
+static bool directed_adv_attempted;
+// Hosts that ignored directed advertising and then connected through undirected advertising,
+// typically because they use a resolvable private address.
+static uint32_t directed_adv_ignored;
+
+static void directed_adv_timeout_callback(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(directed_adv_timeout_work, directed_adv_timeout_callback);
+
+static bool directed_adv_wanted(void) {
+    return !directed_adv_attempted && !(directed_adv_ignored & BIT(active_profile));
+}
+
+static void directed_adv_reset(void) {
+    directed_adv_attempted = false;
+    k_work_cancel_delayable(&directed_adv_timeout_work);
+}
+
+static int start_directed_advertising(const bt_addr_le_t *addr) {
+    struct bt_le_adv_param param =
+        BT_LE_ADV_PARAM_INIT(BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_ONE_TIME, 0, 0, addr);
+
+#if IS_ENABLED(CONFIG_BT_PRIVACY)
+    param.options |= BT_LE_ADV_OPT_DIR_ADDR_RPA;
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
+    // High duty advertising leaves the radio no time to scan, so don't use it while the central is
+    // still looking for its peripherals.
+    if (zmk_split_bt_central_is_scanning()) {
+        param.options |= BT_LE_ADV_OPT_DIR_MODE_LOW_DUTY;
+        param.interval_min = BT_GAP_ADV_FAST_INT_MIN_2;
+        param.interval_max = BT_GAP_ADV_FAST_INT_MAX_2;
+    }
+#endif
+
+    int err = bt_le_adv_start(&param, NULL, 0, NULL, 0);
+    if (err) {
+        return err;
+    }
+
+    directed_adv_attempted = true;
+
+    // High duty advertising ends by itself after 1.28 s, low duty advertising needs a limit.
+    k_work_reschedule(&directed_adv_timeout_work, K_MSEC(CONFIG_ZMK_BLE_DIRECTED_ADV_TIMEOUT_MS));
+
+    return 0;
+}
+
+#else
+
+static int start_directed_advertising(const bt_addr_le_t *addr) {
+    return bt_le_adv_start(BT_LE_ADV_CONN_DIR_LOW_DUTY(addr), zmk_ble_ad, ARRAY_SIZE(zmk_ble_ad),
+                           NULL, 0);
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_BLE_DIRECTED_ADV)
+
 int update_advertising(void) {
 #if IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
     if (CONFIG_ZMK_SPLIT_BLE_CENTRAL_PERIPHERALS == CONFIG_BT_MAX_CONN) {
@@ -178,13 +246,14 @@ int update_advertising(void) {
         desired_adv = ZMK_ADV_CONN;
     } else if (!zmk_ble_active_profile_is_connected()) {
         desired_adv = ZMK_ADV_CONN;
-        // Need to fix directed advertising for privacy centrals. See
-        // https://github.com/zephyrproject-rtos/zephyr/pull/14984 char
-        // addr_str[BT_ADDR_LE_STR_LEN]; bt_addr_le_to_str(zmk_ble_active_profile_addr(), addr_str,
-        // sizeof(addr_str));
-
-        // LOG_DBG("Directed advertising to %s", addr_str);
-        // desired_adv = ZMK_ADV_DIR;
+#if IS_ENABLED(CONFIG_ZMK_BLE_DIRECTED_ADV)
+        // Directed advertising to privacy centrals only works with BT_LE_ADV_OPT_DIR_ADDR_RPA,
+        // see https://github.com/zephyrproject-rtos/zephyr/pull/14984. Hosts that don't respond
+        // to it fall back to undirected advertising.
+        if (directed_adv_wanted()) {
+            desired_adv = ZMK_ADV_DIR;
+        }
+#endif
     }
     LOG_DBG("advertising from %d to %d", advertising_status, desired_adv);
 
@@ -217,10 +286,195 @@ static void update_advertising_callback(struct k_work *work) { update_advertisin
 
 K_WORK_DEFINE(update_advertising_work, update_advertising_callback);
 
+#if IS_ENABLED(CONFIG_ZMK_BLE_DIRECTED_ADV)
+
+static void directed_adv_timeout_callback(struct k_work *work) {
+    if (advertising_status != ZMK_ADV_DIR) {
+        return;
+    }
+
+    // The attempt has been used up, so this switches over to undirected advertising.
+    LOG_DBG("Directed advertising timed out");
+    update_advertising();
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_BLE_DIRECTED_ADV)
+
+#if IS_ENABLED(CONFIG_ZMK_BLE_DYNAMIC_CONN_PARAMS)
+
+#define CONN_PARAM(min, max)                                                                       \
+    BT_LE_CONN_PARAM_INIT(min, max, CONFIG_BT_PERIPHERAL_PREF_LATENCY,                             \
+                          CONFIG_BT_PERIPHERAL_PREF_TIMEOUT)
+
+// Hosts refuse the fastest intervals in different ways, so each profile steps down this list as
+// its host rejects them: macOS/iOS only accept 11.25 ms and up for HID, while Windows and Linux
+// hosts usually accept 7.5 ms.
+static const struct bt_le_conn_param active_conn_params[] = {
+    CONN_PARAM(CONFIG_ZMK_BLE_ACTIVE_PREF_INT, CONFIG_ZMK_BLE_ACTIVE_PREF_INT),
+    CONN_PARAM(9, 12),
+    CONN_PARAM(12, 24),
+};
+
+static const struct bt_le_conn_param idle_conn_param =
+    CONN_PARAM(CONFIG_ZMK_BLE_IDLE_PREF_MIN_INT, CONFIG_ZMK_BLE_IDLE_PREF_MAX_INT);
+
+// The supervision timeout must cover at least two skipped intervals at the maximum latency.
+BUILD_ASSERT(CONFIG_BT_PERIPHERAL_PREF_TIMEOUT * 4 >
+                 (CONFIG_BT_PERIPHERAL_PREF_LATENCY + 1) * CONFIG_ZMK_BLE_IDLE_PREF_MAX_INT,
+             "CONFIG_BT_PERIPHERAL_PREF_TIMEOUT is too short for the idle connection interval");
+
+// Hosts commonly ignore updates while they are still discovering services after connecting, or
+// changing the parameters themselves.
+#define CONN_PARAM_CONNECTED_DELAY_MS 5000
+
+struct conn_param_state {
+    // The first active parameters that the profile's host hasn't rejected.
+    uint8_t active_tier;
+    // A request is waiting for the host to apply it.
+    bool awaiting;
+    // The host didn't apply the last idle request, so don't keep retrying it.
+    bool idle_rejected;
+    int64_t requested_at;
+};
+
+static struct conn_param_state conn_param_states[ZMK_BLE_PROFILE_COUNT];
+
+static void conn_params_update_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(conn_params_update_work, conn_params_update_work_handler);
+
+static const struct bt_le_conn_param *wanted_conn_param(uint8_t index) {
+    const struct conn_param_state *state = &conn_param_states[index];
+
+    // Hosts connected in the background don't receive reports, so keep them in low duty mode.
+    if (index != active_profile || zmk_activity_get_state() != ZMK_ACTIVITY_ACTIVE) {
+        return state->idle_rejected ? NULL : &idle_conn_param;
+    }
+
+    if (state->active_tier >= ARRAY_SIZE(active_conn_params)) {
+        return NULL;
+    }
+
+    return &active_conn_params[state->active_tier];
+}
+
+// Returns how many milliseconds to wait before checking the profile again, or -1 if there is no
+// need to.
+static int32_t update_profile_conn_params(uint8_t index, struct bt_conn *conn) {
+    struct conn_param_state *state = &conn_param_states[index];
+    const struct bt_le_conn_param *param = wanted_conn_param(index);
+    struct bt_conn_info info;
+
+    if (bt_conn_get_info(conn, &info) != 0 || info.role != BT_CONN_ROLE_PERIPHERAL) {
+        state->awaiting = false;
+        return -1;
+    }
+
+    if (param == NULL || (info.le.interval >= param->interval_min &&
+                          info.le.interval <= param->interval_max)) {
+        state->awaiting = false;
+        return -1;
+    }
+
+    int64_t now = k_uptime_get();
+
+    if (state->awaiting) {
+        int64_t deadline = state->requested_at + CONFIG_ZMK_BLE_CONN_PARAM_UPDATE_TIMEOUT_MS;
+        if (now < deadline) {
+            return deadline - now;
+        }
+
+        state->awaiting = false;
+
+        if (param == &idle_conn_param) {
+            LOG_DBG("Profile %d host did not apply idle connection parameters", index);
+            state->idle_rejected = true;
+            return -1;
+        }
+
+        state->active_tier++;
+        LOG_INF("Profile %d host rejected interval %d-%d, falling back", index,
+                param->interval_min, param->interval_max);
+
+        param = wanted_conn_param(index);
+        if (param == NULL) {
+            return -1;
+        }
+    }
+
+    int err = bt_conn_le_param_update(conn, param);
+    if (err) {
+        LOG_WRN("Failed to request connection parameters for profile %d (err %d)", index, err);
+        return -1;
+    }
+
+    state->awaiting = true;
+    state->requested_at = now;
+
+    return CONFIG_ZMK_BLE_CONN_PARAM_UPDATE_TIMEOUT_MS;
+}
+
+static void conn_params_update_work_handler(struct k_work *work) {
+    int32_t next_check_ms = -1;
+
+    for (int i = 0; i < ZMK_BLE_PROFILE_COUNT; i++) {
+        if (!bt_addr_le_cmp(&profiles[i].peer, BT_ADDR_LE_ANY)) {
+            continue;
+        }
+
+        struct bt_conn *conn = bt_conn_lookup_addr_le(BT_ID_DEFAULT, &profiles[i].peer);
+        if (conn == NULL) {
+            conn_param_states[i].awaiting = false;
+            continue;
+        }
+
+        int32_t check_ms = update_profile_conn_params(i, conn);
+        bt_conn_unref(conn);
+
+        if (check_ms >= 0 && (next_check_ms < 0 || check_ms < next_check_ms)) {
+            next_check_ms = check_ms;
+        }
+    }
+
+    if (next_check_ms >= 0) {
+        k_work_reschedule(&conn_params_update_work, K_MSEC(next_check_ms));
+    }
+}
+
+static void conn_params_reset_profile(uint8_t index) {
+    conn_param_states[index] = (struct conn_param_state){0};
+}
+
+// Re-evaluates every connection after the wanted parameters changed, retrying idle requests.
+static void conn_params_refresh(void) {
+    for (int i = 0; i < ZMK_BLE_PROFILE_COUNT; i++) {
+        conn_param_states[i].idle_rejected = false;
+    }
+
+    k_work_reschedule(&conn_params_update_work, K_NO_WAIT);
+}
+
+static int conn_params_activity_listener(const zmk_event_t *eh) {
+    conn_params_refresh();
+
+    return ZMK_EV_EVENT_BUBBLE;
+}
+
+ZMK_LISTENER(zmk_ble_conn_params, conn_params_activity_listener);
+ZMK_SUBSCRIPTION(zmk_ble_conn_params, zmk_activity_state_changed);
+
+#endif // IS_ENABLED(CONFIG_ZMK_BLE_DYNAMIC_CONN_PARAMS)
+
 static void clear_profile_bond(uint8_t profile) {
     if (bt_addr_le_cmp(&profiles[profile].peer, BT_ADDR_LE_ANY)) {
         bt_unpair(BT_ID_DEFAULT, &profiles[profile].peer);
         set_profile_address(profile, BT_ADDR_LE_ANY);
+#if IS_ENABLED(CONFIG_ZMK_BLE_DYNAMIC_CONN_PARAMS)
+        conn_params_reset_profile(profile);
+#endif
+#if IS_ENABLED(CONFIG_ZMK_BLE_DIRECTED_ADV)
+        WRITE_BIT(directed_adv_ignored, profile, 0);
+#endif
     }
 }
 
@@ -255,17 +509,30 @@ int zmk_ble_profile_index(const bt_addr_le_t *addr) {
     return -ENODEV;
 }
 
-#if IS_ENABLED(CONFIG_SETTINGS)
-static void ble_save_profile_work(struct k_work *work) {
-    settings_save_one("ble/active_profile", &active_profile, sizeof(active_profile));
-}
+/*
+ * The profile last found for each connection, plus one so zero means none. A connection's address
+ * can change once its identity is resolved, and a profile's once it is paired, so each entry is
+ * only a hint that is checked against the profile before it is used.
+ */
+static uint8_t profile_by_conn[CONFIG_BT_MAX_CONN];
 
-static struct k_work_delayable ble_save_work;
-#endif
+int zmk_ble_profile_index_for_conn(const struct bt_conn *conn) {
+    uint8_t *entry = &profile_by_conn[bt_conn_index(conn)];
+    const bt_addr_le_t *addr = bt_conn_get_dst(conn);
+
+    if (*entry != 0 && bt_addr_le_cmp(addr, &profiles[*entry - 1].peer) == 0) {
+        return *entry - 1;
+    }
+
+    int index = zmk_ble_profile_index(addr);
+    *entry = index < 0 ? 0 : index + 1;
+
+    return index;
+}
 
 static int ble_save_profile(void) {
 #if IS_ENABLED(CONFIG_SETTINGS)
-    return k_work_reschedule(&ble_save_work, K_MSEC(CONFIG_ZMK_SETTINGS_SAVE_DEBOUNCE));
+    return zmk_settings_save("ble/active_profile", &active_profile, sizeof(active_profile));
 #else
     return 0;
 #endif
@@ -284,8 +551,17 @@ int zmk_ble_prof_select(uint8_t index) {
     active_profile = index;
     ble_save_profile();
 
+#if IS_ENABLED(CONFIG_ZMK_BLE_DIRECTED_ADV)
+    directed_adv_reset();
+#endif
+
     update_advertising();
 
+#if IS_ENABLED(CONFIG_ZMK_BLE_DYNAMIC_CONN_PARAMS)
+    // Speed up the new host's connection and let the previous one drop to low duty.
+    conn_params_refresh();
+#endif
+
     raise_profile_changed_event();
 
     return 0;
@@ -325,6 +601,14 @@ int zmk_ble_prof_disconnect(uint8_t index) {
 
 bt_addr_le_t *zmk_ble_active_profile_addr(void) { return &profiles[active_profile].peer; }
 
+bt_addr_le_t *zmk_ble_profile_addr(uint8_t index) {
+    if (index >= ZMK_BLE_PROFILE_COUNT) {
+        return NULL;
+    }
+
+    return &profiles[index].peer;
+}
+
 char *zmk_ble_active_profile_name(void) { return profiles[active_profile].name; }
 
 #if IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
@@ -353,7 +637,8 @@ int zmk_ble_put_peripheral_addr(const bt_addr_le_t *addr) {
 
             char setting_name[32];
             sprintf(setting_name, "ble/peripheral_addresses/%d", i);
-            settings_save_one(setting_name, addr, sizeof(bt_addr_le_t));
+            zmk_settings_save(setting_name, addr, sizeof(bt_addr_le_t));
+            zmk_settings_save_flush();
 
             return i;
         }
@@ -366,6 +651,36 @@ int zmk_ble_put_peripheral_addr(const bt_addr_le_t *addr) {
 
 #endif /* IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL) */
 
+#if IS_ENABLED(CONFIG_ZMK_BLE_REPORT_MAP_HASH)
+
+static uint32_t stored_report_map_hash;
+
+/*
+ * The GATT database hash hosts use to validate their cache only covers the attribute layout, so it
+ * stays the same when a firmware update only changes the content of a report map. Drop the stored
+ * database hash in that case. The host stack then finds the database changed once the "bt"
+ * settings are loaded, and indicates Service Changed to bonded hosts so they read the new map.
+ */
+static void check_report_map_hash(void) {
+    uint32_t hash = zmk_hog_report_map_hash();
+
+    if (hash == stored_report_map_hash) {
+        return;
+    }
+
+    LOG_INF("HID report map changed, bonded hosts will rediscover services");
+
+    int err = settings_delete("bt/hash");
+    if (err) {
+        LOG_ERR("Failed to delete the stored GATT database hash (err %d)", err);
+        return;
+    }
+
+    zmk_settings_save("ble/report_map_hash", &hash, sizeof(hash));
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_BLE_REPORT_MAP_HASH)
+
 #if IS_ENABLED(CONFIG_SETTINGS)
 
 static int ble_profiles_handle_set(const char *name, size_t len, settings_read_cb read_cb,
@@ -415,6 +730,19 @@ static int ble_profiles_handle_set(const char *name, size_t len, settings_read_c
             return err;
         }
     }
+#if IS_ENABLED(CONFIG_ZMK_BLE_REPORT_MAP_HASH)
+    else if (settings_name_steq(name, "report_map_hash", &next) && !next) {
+        if (len != sizeof(stored_report_map_hash)) {
+            return -EINVAL;
+        }
+
+        int err = read_cb(cb_arg, &stored_report_map_hash, sizeof(stored_report_map_hash));
+        if (err <= 0) {
+            LOG_ERR("Failed to handle report map hash from settings (err %d)", err);
+            return err;
+        }
+    }
+#endif
 #if IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
     else if (settings_name_steq(name, "peripheral_addresses", &next) && next) {
         if (len != sizeof(bt_addr_le_t)) {
@@ -457,6 +785,9 @@ static void connected(struct bt_conn *conn, uint8_t err) {
     }
 
     bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
+#if IS_ENABLED(CONFIG_ZMK_BLE_DIRECTED_ADV)
+    enum advertising_type connected_adv = advertising_status;
+#endif
     advertising_status = ZMK_ADV_NONE;
 
     if (err) {
@@ -465,14 +796,31 @@ static void connected(struct bt_conn *conn, uint8_t err) {
         return;
     }
 
+    zmk_boot_timing_mark("BLE host connected");
+
     LOG_DBG("Connected %s", addr);
 
+#if IS_ENABLED(CONFIG_ZMK_BLE_DIRECTED_ADV)
+    k_work_cancel_delayable(&directed_adv_timeout_work);
+
+    if (is_conn_active_profile(conn)) {
+        // Remember hosts that only come back through undirected advertising so the next
+        // reconnect doesn't waste time on directed advertising.
+        WRITE_BIT(directed_adv_ignored, active_profile,
+                  directed_adv_attempted && connected_adv == ZMK_ADV_CONN);
+    }
+#endif
+
     update_advertising();
 
     if (is_conn_active_profile(conn)) {
         LOG_DBG("Active profile connected");
         k_work_submit(&raise_profile_changed_event_work);
     }
+
+#if IS_ENABLED(CONFIG_ZMK_BLE_DYNAMIC_CONN_PARAMS)
+    k_work_reschedule(&conn_params_update_work, K_MSEC(CONN_PARAM_CONNECTED_DELAY_MS));
+#endif
 }
 
 static void disconnected(struct bt_conn *conn, uint8_t reason) {
@@ -483,6 +831,8 @@ static void disconnected(struct bt_conn *conn, uint8_t reason) {
 
     LOG_DBG("Disconnected from %s (reason 0x%02x)", addr, reason);
 
+    profile_by_conn[bt_conn_index(conn)] = 0;
+
     bt_conn_get_info(conn, &info);
 
     if (info.role != BT_CONN_ROLE_PERIPHERAL) {
@@ -490,6 +840,12 @@ static void disconnected(struct bt_conn *conn, uint8_t reason) {
         return;
     }
 
+#if IS_ENABLED(CONFIG_ZMK_BLE_DIRECTED_ADV)
+    if (is_conn_active_profile(conn)) {
+        directed_adv_attempted = false;
+    }
+#endif
+
     // We need to do this in a work callback, otherwise the advertising update will still see the
     // connection for a profile as active, and not start advertising yet.
     k_work_submit(&update_advertising_work);
@@ -519,6 +875,13 @@ static void le_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t l
     bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
 
     LOG_DBG("%s: interval %d latency %d timeout %d", addr, interval, latency, timeout);
+
+#if IS_ENABLED(CONFIG_ZMK_BLE_DYNAMIC_CONN_PARAMS)
+    // Check whether the host applied what was requested, or changed the parameters by itself. A
+    // host that changes them by itself is usually still setting up the connection, so give it the
+    // same time to settle as after connecting instead of asking again straight away.
+    k_work_reschedule(&conn_params_update_work, K_MSEC(CONN_PARAM_CONNECTED_DELAY_MS));
+#endif
 }
 
 static struct bt_conn_cb conn_callbacks = {
@@ -633,6 +996,7 @@ static void zmk_ble_ready(int err) {
         return;
     }
 
+    zmk_boot_timing_mark("BLE ready");
     update_advertising();
 }
 
@@ -653,10 +1017,11 @@ static int zmk_ble_init(void) {
         return err;
     }
 
-    k_work_init_delayable(&ble_save_work, ble_save_profile_work);
-
-    settings_load_subtree("ble");
-    settings_load_subtree("bt");
+    zmk_settings_load_subtree("ble");
+#if IS_ENABLED(CONFIG_ZMK_BLE_REPORT_MAP_HASH)
+    check_report_map_hash();
+#endif
+    zmk_settings_load_subtree_uncached("bt");
 
 #endif
 
@@ -715,11 +1080,6 @@ static int zmk_ble_handle_key_user(struct zmk_keycode_state_changed *event) {
 
     LOG_DBG("key %d", key);
 
-    if (!auth_passkey_entry_conn) {
-        LOG_DBG("No connection for passkey entry");
-        return ZMK_EV_EVENT_BUBBLE;
-    }
-
     if (event->state) {
         LOG_DBG("Key press, ignoring");
         return ZMK_EV_EVENT_HANDLED;
@@ -767,19 +1127,23 @@ static int zmk_ble_handle_key_user(struct zmk_keycode_state_changed *event) {
 }
 
 static int zmk_ble_listener(const zmk_event_t *eh) {
-    struct zmk_keycode_state_changed *kc_state;
+    // Subscriptions are fixed at link time, so this runs for every keycode. Outside of pairing it
+    // has to be nothing more than this check.
+    if (auth_passkey_entry_conn == NULL) {
+        return ZMK_EV_EVENT_BUBBLE;
+    }
 
-    kc_state = as_zmk_keycode_state_changed(eh);
+    struct zmk_keycode_state_changed *kc_state = as_zmk_keycode_state_changed(eh);
 
     if (kc_state != NULL) {
         return zmk_ble_handle_key_user(kc_state);
     }
 
-    return 0;
+    return ZMK_EV_EVENT_BUBBLE;
 }
 
 ZMK_LISTENER(zmk_ble, zmk_ble_listener);
 ZMK_SUBSCRIPTION(zmk_ble, zmk_keycode_state_changed);
 #endif /* IS_ENABLED(CONFIG_ZMK_BLE_PASSKEY_ENTRY) */
 
-SYS_INIT(zmk_ble_init, APPLICATION, CONFIG_ZMK_BLE_INIT_PRIORITY);
+ZMK_SYS_INIT(zmk_ble_init, APPLICATION, CONFIG_ZMK_BLE_INIT_PRIORITY);
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/boot_timing.h>
+
+struct boot_timing_mark {
+    const char *name;
+    uint32_t time_us;
+};
+
+static struct boot_timing_mark marks[CONFIG_ZMK_BOOT_TIMING_MAX_MARKS];
+static size_t mark_count;
+static bool marks_dropped;
+
+static struct k_spinlock lock;
+
+void zmk_boot_timing_mark(const char *name) {
+    uint32_t time_us = k_ticks_to_us_floor32(k_uptime_ticks());
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    bool found = false;
+    for (size_t i = 0; i < mark_count; i++) {
+        if (strcmp(marks[i].name, name) == 0) {
+            found = true;
+            break;
+        }
+    }
+
+    if (!found) {
+        if (mark_count < ARRAY_SIZE(marks)) {
+            marks[mark_count++] = (struct boot_timing_mark){.name = name, .time_us = time_us};
+        } else {
+            marks_dropped = true;
+        }
+    }
+
+    k_spin_unlock(&lock, key);
+}
+
+// Copies the marks out so they can be printed without holding the lock.
+static size_t boot_timing_get(struct boot_timing_mark *out, bool *dropped) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    size_t count = mark_count;
+    memcpy(out, marks, count * sizeof(marks[0]));
+    *dropped = marks_dropped;
+
+    k_spin_unlock(&lock, key);
+
+    return count;
+}
+
+#define MARK_TIME_FMT "%6u.%03u ms %+8d us  %s"
+#define MARK_TIME_ARGS(mark, prev_us)                                                              \
+    (mark).time_us / 1000, (mark).time_us % 1000, (int)((mark).time_us - (prev_us)), (mark).name
+
+static struct boot_timing_mark marks_copy[CONFIG_ZMK_BOOT_TIMING_MAX_MARKS];
+
+static void boot_timing_log_work_handler(struct k_work *work) {
+    bool dropped;
+    size_t count = boot_timing_get(marks_copy, &dropped);
+
+    LOG_INF("Boot timing (%zu marks, since kernel start):", count);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t prev_us = i > 0 ? marks_copy[i - 1].time_us : 0;
+
+        LOG_INF(MARK_TIME_FMT, MARK_TIME_ARGS(marks_copy[i], prev_us));
+    }
+
+    if (dropped) {
+        LOG_WRN("Some boot timing marks were dropped, increase CONFIG_ZMK_BOOT_TIMING_MAX_MARKS");
+    }
+}
+
+static K_WORK_DELAYABLE_DEFINE(boot_timing_log_work, boot_timing_log_work_handler);
+
+static int boot_timing_init(void) {
+    k_work_schedule(&boot_timing_log_work, K_MSEC(CONFIG_ZMK_BOOT_TIMING_LOG_DELAY_MS));
+    return 0;
+}
+
+SYS_INIT(boot_timing_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#if IS_ENABLED(CONFIG_SHELL)
+
+#include <zephyr/shell/shell.h>
+
+static int cmd_boot_timing(const struct shell *sh, size_t argc, char **argv) {
+    // The shell thread can't share the copy used by the log work.
+    static struct boot_timing_mark shell_marks[CONFIG_ZMK_BOOT_TIMING_MAX_MARKS];
+    bool dropped;
+    size_t count = boot_timing_get(shell_marks, &dropped);
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t prev_us = i > 0 ? shell_marks[i - 1].time_us : 0;
+
+        shell_print(sh, MARK_TIME_FMT, MARK_TIME_ARGS(shell_marks[i], prev_us));
+    }
+
+    if (dropped) {
+        shell_warn(sh, "Some marks were dropped");
+    }
+
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_boot,
+                               SHELL_CMD(timing, NULL, "Show boot timing", cmd_boot_timing),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((zmk), boot, &sub_boot, "Boot", NULL, 0, 0);
+
+#endif // IS_ENABLED(CONFIG_SHELL)
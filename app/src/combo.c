@@ -18,17 +18,40 @@
 #include <zmk/events/position_state_changed.h>
 #include <zmk/events/keycode_state_changed.h>
 #include <zmk/hid.h>
+#include <zmk/input_frame.h>
+#include <zmk/input_timer.h>
 #include <zmk/matrix.h>
 #include <zmk/keymap.h>
 #include <zmk/virtual_key_position.h>
+#include <zmk/boot_timing.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #if DT_HAS_COMPAT_STATUS_OKAY(DT_DRV_COMPAT)
 
+#define COMBO_ONE(n) +1
+#define COMBO_KEY_POSITIONS_LEN(n) +DT_PROP_LEN(n, key_positions)
+#define COMBOS_LEN (0 DT_INST_FOREACH_CHILD(0, COMBO_ONE))
+// the total number of key positions over all combos
+#define COMBOS_KEY_POSITIONS_LEN (0 DT_INST_FOREACH_CHILD(0, COMBO_KEY_POSITIONS_LEN))
+// a combo can't be activated again while any of its keys are still held from activating it
+#define COMBO_MAX_ACTIVE MAX(1, MIN(CONFIG_ZMK_COMBO_MAX_PRESSED_COMBOS, COMBOS_LEN))
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
+#define LATE_EVENT_TOLERANCE_MS CONFIG_ZMK_COMBO_LATE_EVENT_TOLERANCE_MS
+#else
+#define LATE_EVENT_TOLERANCE_MS 0
+#endif
+
+// bitsets over key positions and over combos, 32 entries per word.
+#define COMBO_POSITION_WORDS DIV_ROUND_UP(ZMK_KEYMAP_LEN, 32)
+#define COMBO_CANDIDATE_WORDS DIV_ROUND_UP(COMBOS_LEN, 32)
+
 struct combo_cfg {
     int32_t key_positions[CONFIG_ZMK_COMBO_MAX_KEYS_PER_COMBO];
     int32_t key_position_len;
+    // the same key positions as a bitset, so it can be compared against pressed_positions.
+    uint32_t key_positions_mask[COMBO_POSITION_WORDS];
     struct zmk_behavior_binding behavior;
     int32_t timeout_ms;
     int32_t require_prior_idle_ms;
@@ -38,6 +61,10 @@ struct combo_cfg {
     // the virtual key position is a key position outside the range used by the keyboard.
     // it is necessary so hold-taps can uniquely identify a behavior.
     int32_t virtual_key_position;
+    // the index of this combo in combos and in the candidates bitset.
+    int32_t index;
+    // the layers this combo is active on, built from layers by initialize_combo.
+    zmk_keymap_layers_state_t layers_mask;
     int32_t layers_len;
     int8_t layers[];
 };
@@ -52,30 +79,36 @@ struct active_combo {
         key_positions_pressed[CONFIG_ZMK_COMBO_MAX_KEYS_PER_COMBO];
 };
 
-struct combo_candidate {
-    struct combo_cfg *combo;
-    // the time after which this behavior should be removed from candidates.
-    // by keeping track of when the candidate should be cleared there is no
-    // possibility of accidental releases.
-    int64_t timeout_at;
-};
-
 uint32_t pressed_keys_count = 0;
 // set of keys pressed
 struct zmk_position_state_changed_event pressed_keys[CONFIG_ZMK_COMBO_MAX_KEYS_PER_COMBO] = {};
-// the set of candidate combos based on the currently pressed_keys
-struct combo_candidate candidates[CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY];
+// the positions in pressed_keys as a bitset
+uint32_t pressed_positions[COMBO_POSITION_WORDS];
+// all valid combos, sorted shortest-first, then by virtual-key-position.
+struct combo_cfg *combos[COMBOS_LEN];
+int combo_count = 0;
+// the set of candidate combos based on the currently pressed_keys, one bit per entry in combos.
+// Because combos is sorted, the lowest set bit is always the shortest candidate.
+uint32_t candidates[COMBO_CANDIDATE_WORDS];
+// the timestamp of the key press that set up the candidates. Each candidate is removed
+// timeout_ms after it, so there is no possibility of accidental releases.
+int64_t candidates_timestamp;
 // the last candidate that was completely pressed
 struct combo_cfg *fully_pressed_combo = NULL;
-// a lookup dict that maps a key position to all combos on that position
-struct combo_cfg *combo_lookup[ZMK_KEYMAP_LEN][CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY] = {NULL};
+// a lookup that maps a key position to all combos on that position, in compressed sparse row
+// form: the combos on position p are combos[combo_lookup_ids[i]] for i in
+// [combo_lookup_offsets[p], combo_lookup_offsets[p + 1]), in the same order as combos.
+uint16_t combo_lookup_offsets[ZMK_KEYMAP_LEN + 1];
+uint16_t combo_lookup_ids[COMBOS_KEY_POSITIONS_LEN];
+
+BUILD_ASSERT(COMBOS_KEY_POSITIONS_LEN <= UINT16_MAX, "Too many combo key positions");
 // combos that have been activated and still have (some) keys pressed
 // this array is always contiguous from 0.
-struct active_combo active_combos[CONFIG_ZMK_COMBO_MAX_PRESSED_COMBOS] = {NULL};
+struct active_combo active_combos[COMBO_MAX_ACTIVE] = {NULL};
 int active_combo_count = 0;
 
-struct k_work_delayable timeout_task;
-int64_t timeout_task_timeout_at;
+struct zmk_input_timer timeout_timer;
+int64_t timeout_timer_timeout_at;
 
 // this keeps track of the last non-combo, non-mod key tap
 int64_t last_tapped_timestamp = INT32_MIN;
@@ -88,8 +121,13 @@ static void store_last_tapped(int64_t timestamp) {
     }
 }
 
-// Store the combo key pointer in the combos array, one pointer for each key position
-// The combos are sorted shortest-first, then by virtual-key-position.
+static bool combo_sorts_before(struct combo_cfg *a, struct combo_cfg *b) {
+    return a->key_position_len < b->key_position_len ||
+           (a->key_position_len == b->key_position_len &&
+            a->virtual_key_position < b->virtual_key_position);
+}
+
+// Validate the combo and store it in the combos array.
 static int initialize_combo(struct combo_cfg *new_combo) {
     for (int i = 0; i < new_combo->key_position_len; i++) {
         int32_t position = new_combo->key_positions[i];
@@ -98,147 +136,151 @@ static int initialize_combo(struct combo_cfg *new_combo) {
             return -EINVAL;
         }
 
-        struct combo_cfg *insert_combo = new_combo;
-        bool set = false;
-        for (int j = 0; j < CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY; j++) {
-            struct combo_cfg *combo_at_j = combo_lookup[position][j];
-            if (combo_at_j == NULL) {
-                combo_lookup[position][j] = insert_combo;
-                set = true;
-                break;
-            }
-            if (combo_at_j->key_position_len < insert_combo->key_position_len ||
-                (combo_at_j->key_position_len == insert_combo->key_position_len &&
-                 combo_at_j->virtual_key_position < insert_combo->virtual_key_position)) {
+        new_combo->key_positions_mask[position / 32] |= BIT(position % 32);
+    }
+
+    if (new_combo->layers[0] == -1) {
+        // -1 in the first layer position is global layer scope
+        new_combo->layers_mask = ~(zmk_keymap_layers_state_t)0;
+    } else {
+        new_combo->layers_mask = 0;
+        for (int i = 0; i < new_combo->layers_len; i++) {
+            int8_t layer = new_combo->layers[i];
+            if (layer < 0 || layer >= ZMK_KEYMAP_LAYERS_LEN) {
+                LOG_WRN("Ignoring combo layer %d, which does not exist", layer);
                 continue;
             }
-            // put insert_combo in this spot, move all other combos up.
-            combo_lookup[position][j] = insert_combo;
-            insert_combo = combo_at_j;
-        }
-        if (!set) {
-            LOG_ERR("Too many combos for key position %d, CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY %d.",
-                    position, CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY);
-            return -ENOMEM;
+            new_combo->layers_mask |= ZMK_KEYMAP_LAYER_BIT(layer);
         }
     }
+
+    combos[combo_count++] = new_combo;
     return 0;
 }
 
-static bool combo_active_on_layer(struct combo_cfg *combo, uint8_t layer) {
-    if (combo->layers[0] == -1) {
-        // -1 in the first layer position is global layer scope
-        return true;
+// The combos are sorted shortest-first, then by virtual-key-position.
+static void sort_combos(void) {
+    for (int i = 1; i < combo_count; i++) {
+        struct combo_cfg *combo = combos[i];
+        int j = i;
+        for (; j > 0 && combo_sorts_before(combo, combos[j - 1]); j--) {
+            combos[j] = combos[j - 1];
+        }
+        combos[j] = combo;
     }
-    for (int j = 0; j < combo->layers_len; j++) {
-        if (combo->layers[j] == layer) {
-            return true;
+    for (int i = 0; i < combo_count; i++) {
+        combos[i]->index = i;
+    }
+}
+
+// Counting sort of the combos by key position. Since combos is visited in order, the combos on
+// each key position end up sorted the same way.
+static void build_combo_lookup(void) {
+    for (int i = 0; i < combo_count; i++) {
+        for (int j = 0; j < combos[i]->key_position_len; j++) {
+            combo_lookup_offsets[combos[i]->key_positions[j] + 1]++;
         }
     }
-    return false;
+    for (int position = 0; position < ZMK_KEYMAP_LEN; position++) {
+        combo_lookup_offsets[position + 1] += combo_lookup_offsets[position];
+    }
+
+    // use the offsets as insertion cursors, which leaves each one at the start of the next
+    // position, then shift them back.
+    for (int i = 0; i < combo_count; i++) {
+        for (int j = 0; j < combos[i]->key_position_len; j++) {
+            combo_lookup_ids[combo_lookup_offsets[combos[i]->key_positions[j]]++] = i;
+        }
+    }
+    for (int position = ZMK_KEYMAP_LEN; position > 0; position--) {
+        combo_lookup_offsets[position] = combo_lookup_offsets[position - 1];
+    }
+    combo_lookup_offsets[0] = 0;
 }
 
 static bool is_quick_tap(struct combo_cfg *combo, int64_t timestamp) {
     return (last_tapped_timestamp + combo->require_prior_idle_ms) > timestamp;
 }
 
+static inline bool combo_has_key_position(struct combo_cfg *combo, int32_t position) {
+    return combo->key_positions_mask[position / 32] & BIT(position % 32);
+}
+
+static inline void remove_candidate(int index) { candidates[index / 32] &= ~BIT(index % 32); }
+
+// returns the index of the first candidate at or after from, or -1 if there is none.
+static int next_candidate(int from) {
+    for (int word = from / 32; word < COMBO_CANDIDATE_WORDS; word++) {
+        uint32_t bits = candidates[word];
+        if (word == from / 32) {
+            bits &= ~BIT_MASK(from % 32);
+        }
+        if (bits != 0) {
+            return word * 32 + __builtin_ctz(bits);
+        }
+    }
+    return -1;
+}
+
+#define FOR_EACH_CANDIDATE(index)                                                                  \
+    for (int index = next_candidate(0); index >= 0; index = next_candidate(index + 1))
+
 static int setup_candidates_for_first_keypress(int32_t position, int64_t timestamp) {
     int number_of_combo_candidates = 0;
-    uint8_t highest_active_layer = zmk_keymap_highest_layer_active();
-    for (int i = 0; i < CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY; i++) {
-        struct combo_cfg *combo = combo_lookup[position][i];
-        if (combo == NULL) {
-            return number_of_combo_candidates;
-        }
-        if (combo_active_on_layer(combo, highest_active_layer) && !is_quick_tap(combo, timestamp)) {
-            candidates[number_of_combo_candidates].combo = combo;
-            candidates[number_of_combo_candidates].timeout_at = timestamp + combo->timeout_ms;
+    zmk_keymap_layers_state_t highest_active_layer_bit =
+        ZMK_KEYMAP_LAYER_BIT(zmk_keymap_highest_layer_active());
+    candidates_timestamp = timestamp;
+    for (int i = combo_lookup_offsets[position]; i < combo_lookup_offsets[position + 1]; i++) {
+        struct combo_cfg *combo = combos[combo_lookup_ids[i]];
+        if ((combo->layers_mask & highest_active_layer_bit) && !is_quick_tap(combo, timestamp)) {
+            candidates[combo->index / 32] |= BIT(combo->index % 32);
             number_of_combo_candidates++;
         }
-        // LOG_DBG("combo timeout %d %d %d", position, i, candidates[i].timeout_at);
     }
     return number_of_combo_candidates;
 }
 
 static int filter_candidates(int32_t position) {
-    // this code iterates over candidates and the lookup together to filter in O(n)
-    // assuming they are both sorted on key_position_len, virtual_key_position
-    int matches = 0, lookup_idx = 0, candidate_idx = 0;
-    while (lookup_idx < CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY &&
-           candidate_idx < CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY) {
-        struct combo_cfg *candidate = candidates[candidate_idx].combo;
-        struct combo_cfg *lookup = combo_lookup[position][lookup_idx];
-        if (candidate == NULL || lookup == NULL) {
-            break;
-        }
-        if (candidate->virtual_key_position == lookup->virtual_key_position) {
-            candidates[matches] = candidates[candidate_idx];
+    int matches = 0;
+    FOR_EACH_CANDIDATE(i) {
+        if (combo_has_key_position(combos[i], position)) {
             matches++;
-            candidate_idx++;
-            lookup_idx++;
-        } else if (candidate->key_position_len > lookup->key_position_len) {
-            lookup_idx++;
-        } else if (candidate->key_position_len < lookup->key_position_len) {
-            candidate_idx++;
-        } else if (candidate->virtual_key_position > lookup->virtual_key_position) {
-            lookup_idx++;
-        } else if (candidate->virtual_key_position < lookup->virtual_key_position) {
-            candidate_idx++;
+        } else {
+            remove_candidate(i);
         }
     }
-    // clear unmatched candidates
-    for (int i = matches; i < CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY; i++) {
-        candidates[i].combo = NULL;
-    }
     // LOG_DBG("combo matches after filter %d", matches);
     return matches;
 }
 
 static int64_t first_candidate_timeout() {
-    int64_t first_timeout = LONG_MAX;
-    for (int i = 0; i < CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY; i++) {
-        if (candidates[i].combo == NULL) {
-            break;
-        }
-        if (candidates[i].timeout_at < first_timeout) {
-            first_timeout = candidates[i].timeout_at;
+    int64_t first_timeout = LLONG_MAX;
+    FOR_EACH_CANDIDATE(i) {
+        int64_t timeout_at = candidates_timestamp + combos[i]->timeout_ms;
+        if (timeout_at < first_timeout) {
+            first_timeout = timeout_at;
         }
     }
     return first_timeout;
 }
 
 static inline bool candidate_is_completely_pressed(struct combo_cfg *candidate) {
-    // this code assumes set(pressed_keys) <= set(candidate->key_positions)
-    // this invariant is enforced by filter_candidates
     // since events may have been reraised after clearing one or more slots at
     // the start of pressed_keys (see: release_pressed_keys), we have to check
     // that each key needed to trigger the combo was pressed, not just the last.
-    return candidate->key_position_len == pressed_keys_count;
+    return memcmp(candidate->key_positions_mask, pressed_positions, sizeof(pressed_positions)) ==
+           0;
 }
 
 static int cleanup();
 
 static int filter_timed_out_candidates(int64_t timestamp) {
     int remaining_candidates = 0;
-    for (int i = 0; i < CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY; i++) {
-        struct combo_candidate *candidate = &candidates[i];
-        if (candidate->combo == NULL) {
-            break;
-        }
-        if (candidate->timeout_at > timestamp) {
-            bool need_to_bubble_up = remaining_candidates != i;
-            if (need_to_bubble_up) {
-                // bubble up => reorder candidates so they're contiguous
-                candidates[remaining_candidates].combo = candidate->combo;
-                candidates[remaining_candidates].timeout_at = candidate->timeout_at;
-                // clear the previous location
-                candidates[i].combo = NULL;
-                candidates[i].timeout_at = 0;
-            }
-
+    FOR_EACH_CANDIDATE(i) {
+        if (candidates_timestamp + combos[i]->timeout_ms > timestamp) {
             remaining_candidates++;
         } else {
-            candidate->combo = NULL;
+            remove_candidate(i);
         }
     }
 
@@ -249,22 +291,23 @@ static int filter_timed_out_candidates(int64_t timestamp) {
     return remaining_candidates;
 }
 
-static int clear_candidates() {
-    for (int i = 0; i < CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY; i++) {
-        if (candidates[i].combo == NULL) {
-            return i;
-        }
-        candidates[i].combo = NULL;
+static void clear_candidates() { memset(candidates, 0, sizeof(candidates)); }
+
+static void update_pressed_positions() {
+    memset(pressed_positions, 0, sizeof(pressed_positions));
+    for (int i = 0; i < pressed_keys_count; i++) {
+        uint32_t position = pressed_keys[i].data.position;
+        pressed_positions[position / 32] |= BIT(position % 32);
     }
-    return CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY;
 }
 
 static int capture_pressed_key(const struct zmk_position_state_changed *ev) {
-    if (pressed_keys_count == CONFIG_ZMK_COMBO_MAX_COMBOS_PER_KEY) {
+    if (pressed_keys_count == ARRAY_SIZE(pressed_keys)) {
         return ZMK_EV_EVENT_BUBBLE;
     }
 
     pressed_keys[pressed_keys_count++] = copy_raised_zmk_position_state_changed(ev);
+    pressed_positions[ev->position / 32] |= BIT(ev->position % 32);
     return ZMK_EV_EVENT_CAPTURED;
 }
 
@@ -273,6 +316,7 @@ const struct zmk_listener zmk_listener_combo;
 static int release_pressed_keys() {
     uint32_t count = pressed_keys_count;
     pressed_keys_count = 0;
+    update_pressed_positions();
     for (int i = 0; i < count; i++) {
         struct zmk_position_state_changed_event *ev = &pressed_keys[i];
         if (i == 0) {
@@ -322,10 +366,11 @@ static void move_pressed_keys_to_active_combo(struct active_combo *active_combo)
     }
 
     pressed_keys_count -= combo_length;
+    update_pressed_positions();
 }
 
 static struct active_combo *store_active_combo(struct combo_cfg *combo) {
-    for (int i = 0; i < CONFIG_ZMK_COMBO_MAX_PRESSED_COMBOS; i++) {
+    for (int i = 0; i < COMBO_MAX_ACTIVE; i++) {
         if (active_combos[i].combo == NULL) {
             active_combos[i].combo = combo;
             active_combo_count++;
@@ -334,7 +379,7 @@ static struct active_combo *store_active_combo(struct combo_cfg *combo) {
     }
     LOG_ERR("Unable to store combo; already %d active. Increase "
             "CONFIG_ZMK_COMBO_MAX_PRESSED_COMBOS",
-            CONFIG_ZMK_COMBO_MAX_PRESSED_COMBOS);
+            COMBO_MAX_ACTIVE);
     return NULL;
 }
 
@@ -395,7 +440,8 @@ static bool release_combo_key(int32_t position, int64_t timestamp) {
 }
 
 static int cleanup() {
-    k_work_cancel_delayable(&timeout_task);
+    zmk_input_timer_stop(&timeout_timer);
+    timeout_timer_timeout_at = 0;
     clear_candidates();
     if (fully_pressed_combo != NULL) {
         activate_combo(fully_pressed_combo);
@@ -404,41 +450,47 @@ static int cleanup() {
     return release_pressed_keys();
 }
 
-static void update_timeout_task() {
+static void update_timeout_timer() {
     int64_t first_timeout = first_candidate_timeout();
-    if (timeout_task_timeout_at == first_timeout) {
+    if (timeout_timer_timeout_at == first_timeout) {
         return;
     }
     if (first_timeout == LLONG_MAX) {
-        timeout_task_timeout_at = 0;
-        k_work_cancel_delayable(&timeout_task);
+        timeout_timer_timeout_at = 0;
+        zmk_input_timer_stop(&timeout_timer);
         return;
     }
-    if (k_work_schedule(&timeout_task, K_MSEC(first_timeout - k_uptime_get())) >= 0) {
-        timeout_task_timeout_at = first_timeout;
-    }
+    timeout_timer_timeout_at = first_timeout;
+    // give key presses from a peripheral that happened before the timeout a chance to arrive.
+    zmk_input_timer_start(&timeout_timer, first_timeout + LATE_EVENT_TOLERANCE_MS);
 }
 
 static int position_state_down(const zmk_event_t *ev, struct zmk_position_state_changed *data) {
     int num_candidates;
-    if (candidates[0].combo == NULL) {
+    if (next_candidate(0) < 0) {
         num_candidates = setup_candidates_for_first_keypress(data->position, data->timestamp);
         if (num_candidates == 0) {
             return ZMK_EV_EVENT_BUBBLE;
         }
     } else {
-        filter_timed_out_candidates(data->timestamp);
+        int64_t timestamp = data->timestamp;
+        if (data->source != ZMK_POSITION_STATE_CHANGE_SOURCE_LOCAL) {
+            timestamp -= LATE_EVENT_TOLERANCE_MS;
+        }
+        filter_timed_out_candidates(timestamp);
         num_candidates = filter_candidates(data->position);
     }
-    update_timeout_task();
+    update_timeout_timer();
 
-    struct combo_cfg *candidate_combo = candidates[0].combo;
     LOG_DBG("combo: capturing position event %d", data->position);
     int ret = capture_pressed_key(data);
-    switch (num_candidates) {
-    case 0:
+    if (num_candidates == 0) {
         cleanup();
         return ret;
+    }
+
+    struct combo_cfg *candidate_combo = combos[next_candidate(0)];
+    switch (num_candidates) {
     case 1:
         if (candidate_is_completely_pressed(candidate_combo)) {
             fully_pressed_combo = candidate_combo;
@@ -469,15 +521,13 @@ static int position_state_up(const zmk_event_t *ev, struct zmk_position_state_ch
     return ZMK_EV_EVENT_BUBBLE;
 }
 
-static void combo_timeout_handler(struct k_work *item) {
-    if (timeout_task_timeout_at == 0 || k_uptime_get() < timeout_task_timeout_at) {
-        // timer was cancelled or rescheduled.
-        return;
-    }
-    if (filter_timed_out_candidates(timeout_task_timeout_at) == 0) {
+static void combo_timeout_handler(struct zmk_input_timer *timer) {
+    zmk_input_frame_begin();
+    if (filter_timed_out_candidates(timeout_timer_timeout_at) == 0) {
         cleanup();
     }
-    update_timeout_task();
+    zmk_input_frame_end();
+    update_timeout_timer();
 }
 
 static int position_state_changed_listener(const zmk_event_t *ev) {
@@ -532,11 +582,13 @@ ZMK_SUBSCRIPTION(combo, zmk_keycode_state_changed);
 DT_INST_FOREACH_CHILD(0, COMBO_INST)
 
 static int combo_init(void) {
-    k_work_init_delayable(&timeout_task, combo_timeout_handler);
+    zmk_input_timer_init(&timeout_timer, combo_timeout_handler);
     DT_INST_FOREACH_CHILD(0, INITIALIZE_COMBO);
+    sort_combos();
+    build_combo_lookup();
     return 0;
 }
 
-SYS_INIT(combo_init, APPLICATION, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
+ZMK_SYS_INIT(combo_init, APPLICATION, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
 
 #endif
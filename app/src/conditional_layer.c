@@ -7,6 +7,7 @@
 #define DT_DRV_COMPAT zmk_conditional_layers
 
 #include <stdint.h>
+#include <zephyr/init.h>
 #include <zephyr/kernel.h>
 
 #include <zephyr/devicetree.h>
@@ -15,6 +16,7 @@
 #include <zmk/event_manager.h>
 #include <zmk/keymap.h>
 #include <zmk/events/layer_state_changed.h>
+#include <zmk/boot_timing.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
@@ -33,7 +35,7 @@ struct conditional_layer_cfg {
     int8_t then_layer;
 };
 
-#define IF_LAYER_BIT(node_id, prop, idx) BIT(DT_PROP_BY_IDX(node_id, prop, idx)) |
+#define IF_LAYER_BIT(node_id, prop, idx) ZMK_KEYMAP_LAYER_BIT(DT_PROP_BY_IDX(node_id, prop, idx)) |
 
 // Evaluates to conditional_layer_cfg struct initializer.
 #define CONDITIONAL_LAYER_DECL(n)                                                                  \
@@ -49,75 +51,123 @@ static const struct conditional_layer_cfg CONDITIONAL_LAYER_CFGS[] = {
 static const int32_t NUM_CONDITIONAL_LAYER_CFGS =
     sizeof(CONDITIONAL_LAYER_CFGS) / sizeof(*CONDITIONAL_LAYER_CFGS);
 
-static void conditional_layer_activate(int8_t layer) {
-    // This may trigger another event that could, in turn, activate additional then-layers. However,
-    // the process will eventually terminate (at worst, when every layer is active).
-    if (!zmk_keymap_layer_active(layer)) {
-        LOG_DBG("layer %d", layer);
-        zmk_keymap_layer_activate(layer);
+// For each layer, the then-layers of every config that has it as an if-layer, so a layer state
+// change only re-evaluates the configs it can affect.
+static zmk_keymap_layers_state_t then_layers_by_if_layer[ZMK_KEYMAP_LAYERS_LEN];
+
+// All then-layers. A then-layer changed by something else is re-evaluated too.
+static zmk_keymap_layers_state_t then_layers;
+
+// Layer changes that still need to be evaluated. Activating then-layers raises another layer state
+// change from within the listener, which is added here and handled by the outer loop.
+static zmk_keymap_layers_state_t pending_changes;
+
+static zmk_keymap_layers_state_t affected_then_layers(zmk_keymap_layers_state_t changed) {
+    zmk_keymap_layers_state_t affected = changed & then_layers;
+
+    while (changed != 0) {
+        int layer = zmk_keymap_layer_state_lowest(changed);
+
+        changed &= changed - 1;
+        affected |= then_layers_by_if_layer[layer];
     }
+
+    return affected;
+}
+
+static void conditional_layer_activate(zmk_keymap_layers_state_t *state, uint8_t layer) {
+    LOG_DBG("layer %d", layer);
+    *state |= ZMK_KEYMAP_LAYER_BIT(layer);
 }
 
-static void conditional_layer_deactivate(int8_t layer) {
+static void conditional_layer_deactivate(zmk_keymap_layers_state_t *state, uint8_t layer) {
     // This may deactivate a then-layer that's already active via another mechanism (e.g., a
     // momentary layer behavior). However, the same problem arises when multiple keys with the same
     // &mo binding are held and then one is released, so it's probably not an issue in practice.
-    if (zmk_keymap_layer_active(layer)) {
-        LOG_DBG("layer %d", layer);
-        zmk_keymap_layer_deactivate(layer);
+    LOG_DBG("layer %d", layer);
+    *state &= ~ZMK_KEYMAP_LAYER_BIT(layer);
+}
+
+static void conditional_layers_update(zmk_keymap_layers_state_t affected) {
+    zmk_keymap_layers_state_t state = zmk_keymap_layer_state();
+    zmk_keymap_layers_state_t then_layer_state = 0;
+
+    // Activate a then-layer if and only if all if-layers of one of its configs are active.
+    for (int i = 0; i < NUM_CONDITIONAL_LAYER_CFGS; i++) {
+        const struct conditional_layer_cfg *cfg = CONDITIONAL_LAYER_CFGS + i;
+        zmk_keymap_layers_state_t mask = cfg->if_layers_state_mask;
+
+        if ((ZMK_KEYMAP_LAYER_BIT(cfg->then_layer) & affected) != 0U && (state & mask) == mask) {
+            then_layer_state |= ZMK_KEYMAP_LAYER_BIT(cfg->then_layer);
+        }
+    }
+
+    zmk_keymap_layers_state_t new_state = state;
+    zmk_keymap_layers_state_t changed = ((state & affected) ^ then_layer_state);
+
+    while (changed != 0) {
+        uint8_t layer = zmk_keymap_layer_state_lowest(changed);
+
+        changed &= changed - 1;
+        if ((then_layer_state & ZMK_KEYMAP_LAYER_BIT(layer)) != 0U) {
+            conditional_layer_activate(&new_state, layer);
+        } else {
+            conditional_layer_deactivate(&new_state, layer);
+        }
+    }
+
+    // All then-layers change in one transition, which comes back here to evaluate the configs
+    // that depend on them.
+    if (new_state != state) {
+        zmk_keymap_layer_state_set(new_state);
     }
 }
 
-static int layer_state_changed_listener(const zmk_event_t *ev) {
-    static bool conditional_layer_updates_needed;
+static int layer_state_changed_listener(const zmk_event_t *eh) {
+    const struct zmk_layer_state_changed *ev = as_zmk_layer_state_changed(eh);
 
-    conditional_layer_updates_needed = true;
+    pending_changes |= ev->old_state ^ ev->new_state;
 
     // Semaphore ensures we don't re-enter the loop in the middle of doing update, and
     // ensures that "waterfalling layer updates" are all processed to trigger subsequent
-    // nested conditional layers properly.
+    // nested conditional layers properly. The process ends once a pass leaves the layer
+    // state unchanged.
     if (k_sem_take(&conditional_layer_sem, K_NO_WAIT) < 0) {
         return 0;
     }
 
-    while (conditional_layer_updates_needed) {
-        int8_t max_then_layer = -1;
-        uint32_t then_layers = 0;
-        uint32_t then_layer_state = 0;
-
-        conditional_layer_updates_needed = false;
-
-        // On layer state changes, examines each conditional layer config to determine if then-layer
-        // in the config should activate based on the currently active set of if-layers.
-        for (int i = 0; i < NUM_CONDITIONAL_LAYER_CFGS; i++) {
-            const struct conditional_layer_cfg *cfg = CONDITIONAL_LAYER_CFGS + i;
-            zmk_keymap_layers_state_t mask = cfg->if_layers_state_mask;
-            then_layers |= BIT(cfg->then_layer);
-            max_then_layer = MAX(max_then_layer, cfg->then_layer);
-
-            // Activate then-layer if and only if all if-layers are already active. Note that we
-            // reevaluate the current layer state for each config since activation of one layer can
-            // also trigger activation of another.
-            if ((zmk_keymap_layer_state() & mask) == mask) {
-                then_layer_state |= BIT(cfg->then_layer);
-            }
+    while (pending_changes != 0) {
+        zmk_keymap_layers_state_t affected = affected_then_layers(pending_changes);
+
+        pending_changes = 0;
+
+        if (affected != 0) {
+            conditional_layers_update(affected);
         }
+    }
 
-        for (uint8_t layer = 0; layer <= max_then_layer; layer++) {
-            if ((BIT(layer) & then_layers) != 0U) {
-                if ((BIT(layer) & then_layer_state) != 0U) {
-                    conditional_layer_activate(layer);
-                } else {
-                    conditional_layer_deactivate(layer);
-                }
+    k_sem_give(&conditional_layer_sem);
+    return 0;
+}
+
+static int conditional_layer_init(void) {
+    for (int i = 0; i < NUM_CONDITIONAL_LAYER_CFGS; i++) {
+        const struct conditional_layer_cfg *cfg = CONDITIONAL_LAYER_CFGS + i;
+
+        then_layers |= ZMK_KEYMAP_LAYER_BIT(cfg->then_layer);
+
+        for (int layer = 0; layer < ZMK_KEYMAP_LAYERS_LEN; layer++) {
+            if ((cfg->if_layers_state_mask & ZMK_KEYMAP_LAYER_BIT(layer)) != 0U) {
+                then_layers_by_if_layer[layer] |= ZMK_KEYMAP_LAYER_BIT(cfg->then_layer);
             }
         }
     }
 
-    k_sem_give(&conditional_layer_sem);
     return 0;
 }
 
+ZMK_SYS_INIT(conditional_layer_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
 ZMK_LISTENER(conditional_layer, layer_state_changed_listener);
 ZMK_SUBSCRIPTION(conditional_layer, zmk_layer_state_changed);
 
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/boot_timing.h>
+#include <zmk/deferred_init.h>
+#include <zmk/workqueue.h>
+
+extern const struct zmk_deferred_init __zmk_deferred_init_start[];
+extern const struct zmk_deferred_init __zmk_deferred_init_end[];
+
+static void deferred_init_work_handler(struct k_work *work) {
+    int64_t start = k_uptime_get();
+
+    for (const struct zmk_deferred_init *entry = __zmk_deferred_init_start;
+         entry < __zmk_deferred_init_end; entry++) {
+        int err = entry->init();
+        if (err) {
+            LOG_ERR("Deferred init %s failed (err %d)", entry->name, err);
+        }
+
+        zmk_boot_timing_mark(entry->name);
+    }
+
+    zmk_boot_timing_mark("deferred init done");
+    LOG_DBG("Deferred init finished in %lld ms", k_uptime_get() - start);
+}
+
+static K_WORK_DEFINE(deferred_init_work, deferred_init_work_handler);
+
+void zmk_deferred_init_start(void) {
+    k_work_submit_to_queue(zmk_workqueue_lowprio_work_q(), &deferred_init_work);
+}
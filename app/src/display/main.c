@@ -17,9 +17,14 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #include "theme.h"
 
+#include <zmk/boot_timing.h>
+#include <zmk/deferred_init.h>
 #include <zmk/event_manager.h>
 #include <zmk/events/activity_state_changed.h>
+#include <zmk/display.h>
 #include <zmk/display/status_screen.h>
+#include <zmk/resource_stats.h>
+#include <zmk/workqueue.h>
 
 static const struct device *display = DEVICE_DT_GET(DT_CHOSEN(zephyr_display));
 static bool initialized = false;
@@ -28,18 +33,17 @@ static lv_obj_t *screen;
 
 __attribute__((weak)) lv_obj_t *zmk_display_status_screen() { return NULL; }
 
-void display_tick_cb(struct k_work *work) { lv_task_handler(); }
-
 #define TICK_MS 10
 
-K_WORK_DEFINE(display_tick_work, display_tick_cb);
-
 #if IS_ENABLED(CONFIG_ZMK_DISPLAY_WORK_QUEUE_DEDICATED)
 
 K_THREAD_STACK_DEFINE(display_work_stack_area, CONFIG_ZMK_DISPLAY_DEDICATED_THREAD_STACK_SIZE);
 
 static struct k_work_q display_work_q;
 
+ZMK_STACK_STATS_DEFINE(display_work_q, display_work_stack_area, "Display");
+ZMK_WORKQUEUE_REGISTER(display_work_q, "Display", ZMK_WORKQUEUE_LATENCY_BULK);
+
 #endif
 
 struct k_work_q *zmk_display_work_q() {
@@ -50,19 +54,166 @@ struct k_work_q *zmk_display_work_q() {
 #endif
 }
 
+#if IS_ENABLED(CONFIG_ZMK_DISPLAY_WORK_QUEUE_SYSTEM) && CONFIG_ZMK_DISPLAY_RENDER_BUDGET_MS > 0
+
+// Uptime before which LVGL must not run again, after a render which went over the budget.
+static int64_t render_resume_at;
+static bool render_budget_warned;
+
+/**
+ * Run LVGL, timing how long it takes. A render which goes over the budget is followed by at least
+ * as long without rendering, so input processing on the system work queue waits behind at most one
+ * slow redraw at a time rather than a run of them.
+ */
+static void display_render() {
+    uint32_t start = k_cycle_get_32();
+
+    lv_task_handler();
+
+    uint32_t elapsed_ms = k_cyc_to_ms_ceil32(k_cycle_get_32() - start);
+    if (elapsed_ms <= CONFIG_ZMK_DISPLAY_RENDER_BUDGET_MS) {
+        return;
+    }
+
+    if (!render_budget_warned) {
+        LOG_WRN("Display render took %d ms on the system work queue, consider enabling "
+                "CONFIG_ZMK_DISPLAY_WORK_QUEUE_DEDICATED",
+                elapsed_ms);
+        render_budget_warned = true;
+    }
+
+    render_resume_at = k_uptime_get() + elapsed_ms;
+}
+
+static bool display_render_deferred() { return k_uptime_get() < render_resume_at; }
+
+static k_timeout_t display_render_after(int32_t delay_ms) {
+    return K_TIMEOUT_ABS_MS(MAX(render_resume_at, k_uptime_get() + delay_ms));
+}
+
+#else
+
+static void display_render() { lv_task_handler(); }
+
+static bool display_render_deferred() { return false; }
+
+static k_timeout_t display_render_after(int32_t delay_ms) { return K_MSEC(delay_ms); }
+
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_DISPLAY_TICK_ON_DEMAND)
+
+// Whether the display is unblanked, so changes need rendering. Only used from the display queue.
+static bool ticking;
+
+static bool display_tick_needed() {
+    lv_disp_t *disp = lv_disp_get_default();
+
+    return lv_anim_count_running() > 0 || (disp != NULL && disp->inv_p > 0);
+}
+
+void display_tick_cb(struct k_work *work);
+
+K_WORK_DELAYABLE_DEFINE(display_tick_work, display_tick_cb);
+
+// Keep ticking only while something is left to render, and stop once the display is up to date.
+void display_tick_cb(struct k_work *work) {
+    display_render();
+
+    if (ticking && display_tick_needed()) {
+        k_work_schedule_for_queue(zmk_display_work_q(), &display_tick_work,
+                                  display_render_after(TICK_MS));
+    }
+}
+
+void zmk_display_request_tick() {
+    if (ticking) {
+        k_work_schedule_for_queue(zmk_display_work_q(), &display_tick_work,
+                                  display_render_after(0));
+    }
+}
+
+static void start_display_ticks() {
+    ticking = true;
+    zmk_display_request_tick();
+}
+
+static void stop_display_ticks() {
+    ticking = false;
+    k_work_cancel_delayable(&display_tick_work);
+}
+
+#else
+
+void display_tick_cb(struct k_work *work) {
+    if (!display_render_deferred()) {
+        display_render();
+    }
+}
+
+K_WORK_DEFINE(display_tick_work, display_tick_cb);
+
 void display_timer_cb() { k_work_submit_to_queue(zmk_display_work_q(), &display_tick_work); }
 
 K_TIMER_DEFINE(display_timer, display_timer_cb, NULL);
 
+void zmk_display_request_tick() {}
+
+static void start_display_ticks() {
+    k_timer_start(&display_timer, K_MSEC(TICK_MS), K_MSEC(TICK_MS));
+}
+
+static void stop_display_ticks() { k_timer_stop(&display_timer); }
+
+#endif // IS_ENABLED(CONFIG_ZMK_DISPLAY_TICK_ON_DEMAND)
+
+// Widget updates queued since the last batch was applied, in the order they were first queued.
+static sys_slist_t widget_updates = SYS_SLIST_STATIC_INIT(&widget_updates);
+static struct k_spinlock widget_updates_lock;
+
+static void widget_updates_cb(struct k_work *work) {
+    sys_slist_t batch;
+
+    k_spinlock_key_t key = k_spin_lock(&widget_updates_lock);
+    batch = widget_updates;
+    sys_slist_init(&widget_updates);
+    k_spin_unlock(&widget_updates_lock, key);
+
+    struct zmk_display_widget_update *update, *next;
+    SYS_SLIST_FOR_EACH_CONTAINER_SAFE(&batch, update, next, node) {
+        // Cleared first, so a change while this update is applied queues it again.
+        atomic_clear(&update->pending);
+        update->apply();
+    }
+
+    zmk_display_request_tick();
+}
+
+K_WORK_DELAYABLE_DEFINE(widget_updates_work, widget_updates_cb);
+
+void zmk_display_widget_update_submit(struct zmk_display_widget_update *update) {
+    if (atomic_set(&update->pending, 1)) {
+        return;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&widget_updates_lock);
+    sys_slist_append(&widget_updates, &update->node);
+    k_spin_unlock(&widget_updates_lock, key);
+
+    // Does nothing if already scheduled, so the first update of a batch sets when it is applied.
+    k_work_schedule_for_queue(zmk_display_work_q(), &widget_updates_work,
+                              K_MSEC(CONFIG_ZMK_DISPLAY_WIDGET_BATCH_MS));
+}
+
 void unblank_display_cb(struct k_work *work) {
     display_blanking_off(display);
-    k_timer_start(&display_timer, K_MSEC(TICK_MS), K_MSEC(TICK_MS));
+    start_display_ticks();
 }
 
 #if IS_ENABLED(CONFIG_ZMK_DISPLAY_BLANK_ON_IDLE)
 
 void blank_display_cb(struct k_work *work) {
-    k_timer_stop(&display_timer);
+    stop_display_ticks();
     display_blanking_on(display);
 }
 K_WORK_DEFINE(blank_display_work, blank_display_cb);
@@ -120,7 +271,14 @@ void initialize_display(struct k_work *work) {
 
     lv_scr_load(screen);
 
+#if IS_ENABLED(CONFIG_ZMK_DISPLAY_MEM_STATS)
+    size_t used, peak;
+    zmk_display_mem_stats_get(&used, &peak);
+    LOG_INF("Status screen uses %zu bytes of the LVGL heap", used);
+#endif
+
     unblank_display_cb(work);
+    zmk_boot_timing_mark("display ready");
 }
 
 K_WORK_DEFINE(init_work, initialize_display);
@@ -138,6 +296,11 @@ int zmk_display_init() {
     return 0;
 }
 
+#if IS_ENABLED(CONFIG_ZMK_DEFERRED_INIT)
+// Otherwise started from main() once key scanning has started.
+ZMK_DEFERRED_INIT(zmk_display_init, CONFIG_APPLICATION_INIT_PRIORITY);
+#endif
+
 #if IS_ENABLED(CONFIG_ZMK_DISPLAY_BLANK_ON_IDLE)
 int display_event_handler(const zmk_event_t *eh) {
     struct zmk_activity_state_changed *ev = as_zmk_activity_state_changed(eh);
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <zephyr/kernel.h>
+
+#include <zmk/display.h>
+
+/*
+ * The LVGL heap itself is private to Zephyr's LVGL module, so the allocator it uses with
+ * CONFIG_LV_MEM_CUSTOM is wrapped at link time instead, and each allocation is prefixed with its
+ * size so frees and reallocations can be accounted for.
+ */
+
+void *__real_lvgl_malloc(size_t size);
+void *__real_lvgl_realloc(void *ptr, size_t size);
+void __real_lvgl_free(void *ptr);
+
+struct mem_header {
+    size_t size;
+} __aligned(8);
+
+static struct k_spinlock lock;
+static size_t used_bytes;
+static size_t peak_bytes;
+
+static void account(size_t freed, size_t allocated) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    used_bytes = used_bytes - freed + allocated;
+    peak_bytes = MAX(peak_bytes, used_bytes);
+
+    k_spin_unlock(&lock, key);
+}
+
+void *__wrap_lvgl_malloc(size_t size) {
+    struct mem_header *header = __real_lvgl_malloc(sizeof(*header) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+
+    header->size = size;
+    account(0, size);
+
+    return header + 1;
+}
+
+void *__wrap_lvgl_realloc(void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return __wrap_lvgl_malloc(size);
+    }
+
+    struct mem_header *header = (struct mem_header *)ptr - 1;
+    size_t old_size = header->size;
+
+    header = __real_lvgl_realloc(header, sizeof(*header) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+
+    header->size = size;
+    account(old_size, size);
+
+    return header + 1;
+}
+
+void __wrap_lvgl_free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    struct mem_header *header = (struct mem_header *)ptr - 1;
+
+    account(header->size, 0);
+    __real_lvgl_free(header);
+}
+
+void zmk_display_mem_stats_get(size_t *used, size_t *peak) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    *used = used_bytes;
+    *peak = peak_bytes;
+
+    k_spin_unlock(&lock, key);
+}
+
+#if IS_ENABLED(CONFIG_SHELL)
+
+#include <zephyr/shell/shell.h>
+
+static int cmd_display_mem(const struct shell *sh, size_t argc, char **argv) {
+    size_t used, peak;
+
+    zmk_display_mem_stats_get(&used, &peak);
+
+    shell_print(sh, "LVGL heap: %zu bytes used, %zu bytes peak of %d", used, peak,
+                CONFIG_LV_Z_MEM_POOL_SIZE);
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_display,
+                               SHELL_CMD(mem, NULL, "Show LVGL heap use", cmd_display_mem),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((zmk), display, &sub_display, "Display", NULL, 0, 0);
+
+#endif // IS_ENABLED(CONFIG_SHELL)
@@ -26,7 +26,8 @@ struct battery_status_state {
 #endif
 };
 
-static void set_battery_symbol(lv_obj_t *label, struct battery_status_state state) {
+static void set_battery_symbol(struct zmk_widget_battery_status *widget,
+                               struct battery_status_state state) {
     char text[9] = {};
 
     uint8_t level = state.level;
@@ -54,12 +55,12 @@ static void set_battery_symbol(lv_obj_t *label, struct battery_status_state stat
         strcat(text, LV_SYMBOL_BATTERY_EMPTY);
     }
 #endif
-    lv_label_set_text(label, text);
+    ZMK_DISPLAY_WIDGET_SET_TEXT(widget, text);
 }
 
 void battery_status_update_cb(struct battery_status_state state) {
     struct zmk_widget_battery_status *widget;
-    SYS_SLIST_FOR_EACH_CONTAINER(&widgets, widget, node) { set_battery_symbol(widget->obj, state); }
+    SYS_SLIST_FOR_EACH_CONTAINER(&widgets, widget, node) { set_battery_symbol(widget, state); }
 }
 
 static struct battery_status_state battery_status_get_state(const zmk_event_t *eh) {
@@ -22,25 +22,26 @@ struct layer_status_state {
     const char *label;
 };
 
-static void set_layer_symbol(lv_obj_t *label, struct layer_status_state state) {
+static void set_layer_symbol(struct zmk_widget_layer_status *widget,
+                             struct layer_status_state state) {
     if (state.label == NULL) {
         char text[7] = {};
 
         sprintf(text, LV_SYMBOL_KEYBOARD " %i", state.index);
 
-        lv_label_set_text(label, text);
+        ZMK_DISPLAY_WIDGET_SET_TEXT(widget, text);
     } else {
         char text[13] = {};
 
         snprintf(text, sizeof(text), LV_SYMBOL_KEYBOARD " %s", state.label);
 
-        lv_label_set_text(label, text);
+        ZMK_DISPLAY_WIDGET_SET_TEXT(widget, text);
     }
 }
 
 static void layer_status_update_cb(struct layer_status_state state) {
     struct zmk_widget_layer_status *widget;
-    SYS_SLIST_FOR_EACH_CONTAINER(&widgets, widget, node) { set_layer_symbol(widget->obj, state); }
+    SYS_SLIST_FOR_EACH_CONTAINER(&widgets, widget, node) { set_layer_symbol(widget, state); }
 }
 
 static struct layer_status_state layer_status_get_state(const zmk_event_t *eh) {
@@ -48,8 +49,8 @@ static struct layer_status_state layer_status_get_state(const zmk_event_t *eh) {
     return (struct layer_status_state){.index = index, .label = zmk_keymap_layer_name(index)};
 }
 
-ZMK_DISPLAY_WIDGET_LISTENER(widget_layer_status, struct layer_status_state, layer_status_update_cb,
-                            layer_status_get_state)
+ZMK_DISPLAY_WIDGET_DEFERRED_LISTENER(widget_layer_status, struct layer_status_state,
+                                     layer_status_update_cb, layer_status_get_state)
 
 ZMK_SUBSCRIPTION(widget_layer_status, zmk_layer_state_changed);
 
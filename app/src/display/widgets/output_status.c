@@ -34,7 +34,8 @@ static struct output_status_state get_state(const zmk_event_t *_eh) {
     ;
 }
 
-static void set_status_symbol(lv_obj_t *label, struct output_status_state state) {
+static void set_status_symbol(struct zmk_widget_output_status *widget,
+                              struct output_status_state state) {
     char text[10] = {};
 
     switch (state.selected_endpoint.transport) {
@@ -57,12 +58,12 @@ static void set_status_symbol(lv_obj_t *label, struct output_status_state state)
         break;
     }
 
-    lv_label_set_text(label, text);
+    ZMK_DISPLAY_WIDGET_SET_TEXT(widget, text);
 }
 
 static void output_status_update_cb(struct output_status_state state) {
     struct zmk_widget_output_status *widget;
-    SYS_SLIST_FOR_EACH_CONTAINER(&widgets, widget, node) { set_status_symbol(widget->obj, state); }
+    SYS_SLIST_FOR_EACH_CONTAINER(&widgets, widget, node) { set_status_symbol(widget, state); }
 }
 
 ZMK_DISPLAY_WIDGET_LISTENER(widget_output_status, struct output_status_state,
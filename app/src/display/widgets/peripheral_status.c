@@ -30,7 +30,8 @@ static void set_status_symbol(lv_obj_t *label, struct peripheral_status_state st
         state.connected ? (LV_SYMBOL_WIFI " " LV_SYMBOL_OK) : (LV_SYMBOL_WIFI " " LV_SYMBOL_CLOSE);
 
     LOG_DBG("connected? %s", state.connected ? "true" : "false");
-    lv_label_set_text(label, text);
+    // The text is a string literal, so LVGL doesn't need a copy of it.
+    lv_label_set_text_static(label, text);
 }
 
 static void output_status_update_cb(struct peripheral_status_state state) {
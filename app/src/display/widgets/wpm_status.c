@@ -24,19 +24,19 @@ struct wpm_status_state wpm_status_get_state(const zmk_event_t *eh) {
     return (struct wpm_status_state){.wpm = zmk_wpm_get_state()};
 };
 
-void set_wpm_symbol(lv_obj_t *label, struct wpm_status_state state) {
+void set_wpm_symbol(struct zmk_widget_wpm_status *widget, struct wpm_status_state state) {
     char text[4] = {};
 
     LOG_DBG("WPM changed to %i", state.wpm);
     snprintf(text, sizeof(text), "%i", state.wpm);
 
-    lv_label_set_text(label, text);
-    lv_obj_align(label, LV_ALIGN_BOTTOM_RIGHT, 0, 0);
+    ZMK_DISPLAY_WIDGET_SET_TEXT(widget, text);
+    lv_obj_align(widget->obj, LV_ALIGN_BOTTOM_RIGHT, 0, 0);
 }
 
 void wpm_status_update_cb(struct wpm_status_state state) {
     struct zmk_widget_wpm_status *widget;
-    SYS_SLIST_FOR_EACH_CONTAINER(&widgets, widget, node) { set_wpm_symbol(widget->obj, state); }
+    SYS_SLIST_FOR_EACH_CONTAINER(&widgets, widget, node) { set_wpm_symbol(widget, state); }
 }
 
 ZMK_DISPLAY_WIDGET_LISTENER(widget_wpm_status, struct wpm_status_state, wpm_status_update_cb,
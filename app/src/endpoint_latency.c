@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+
+#include <zmk/endpoint_latency.h>
+
+// Bucket 0 holds latencies under 1 ms, bucket n holds [2^(n-1), 2^n) ms and the last bucket holds
+// everything above.
+#define LATENCY_BUCKETS 10
+
+struct latency_histogram {
+    uint32_t buckets[LATENCY_BUCKETS];
+    uint32_t count;
+    uint64_t sum_ms;
+    uint32_t max_ms;
+};
+
+static const char *const transport_names[] = {
+    [ZMK_TRANSPORT_USB] = "USB",
+    [ZMK_TRANSPORT_BLE] = "BLE",
+};
+
+static struct latency_histogram histograms[ARRAY_SIZE(transport_names)];
+static struct k_spinlock lock;
+static atomic_t origin;
+
+void zmk_endpoint_latency_set_origin(int64_t timestamp) {
+    atomic_set(&origin, (uint32_t)timestamp);
+}
+
+uint32_t zmk_endpoint_latency_origin(void) { return (uint32_t)atomic_get(&origin); }
+
+static int latency_bucket(uint32_t latency_ms) {
+    for (int i = 0; i < LATENCY_BUCKETS - 1; i++) {
+        if (latency_ms < BIT(i)) {
+            return i;
+        }
+    }
+
+    return LATENCY_BUCKETS - 1;
+}
+
+void zmk_endpoint_latency_record(enum zmk_transport transport, uint32_t report_origin) {
+    if (transport >= ARRAY_SIZE(histograms)) {
+        return;
+    }
+
+    uint32_t latency_ms = (uint32_t)k_uptime_get() - report_origin;
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    struct latency_histogram *histogram = &histograms[transport];
+    histogram->buckets[latency_bucket(latency_ms)]++;
+    histogram->count++;
+    histogram->sum_ms += latency_ms;
+    histogram->max_ms = MAX(histogram->max_ms, latency_ms);
+
+    k_spin_unlock(&lock, key);
+}
+
+int zmk_endpoint_latency_get_stats(enum zmk_transport transport,
+                                   struct zmk_endpoint_latency_stats *stats) {
+    if (transport >= ARRAY_SIZE(histograms)) {
+        return -EINVAL;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    struct latency_histogram *histogram = &histograms[transport];
+    stats->count = histogram->count;
+    stats->avg_ms = histogram->count ? histogram->sum_ms / histogram->count : 0;
+    stats->max_ms = histogram->max_ms;
+
+    k_spin_unlock(&lock, key);
+
+    return 0;
+}
+
+#if IS_ENABLED(CONFIG_SHELL)
+
+static int cmd_latency_stats(const struct shell *sh, size_t argc, char **argv) {
+    for (int transport = 0; transport < ARRAY_SIZE(histograms); transport++) {
+        k_spinlock_key_t key = k_spin_lock(&lock);
+        struct latency_histogram histogram = histograms[transport];
+        k_spin_unlock(&lock, key);
+
+        if (histogram.count == 0) {
+            shell_print(sh, "%s: no reports", transport_names[transport]);
+            continue;
+        }
+
+        shell_print(sh, "%s: %u reports, %u ms avg, %u ms max", transport_names[transport],
+                    histogram.count, (uint32_t)(histogram.sum_ms / histogram.count),
+                    histogram.max_ms);
+
+        for (int i = 0; i < LATENCY_BUCKETS; i++) {
+            if (i == 0) {
+                shell_print(sh, "  <1 ms: %u", histogram.buckets[i]);
+            } else if (i == LATENCY_BUCKETS - 1) {
+                shell_print(sh, "  >=%lu ms: %u", BIT(i - 1), histogram.buckets[i]);
+            } else {
+                shell_print(sh, "  %lu-%lu ms: %u", BIT(i - 1), BIT(i) - 1, histogram.buckets[i]);
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int cmd_latency_reset(const struct shell *sh, size_t argc, char **argv) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    memset(histograms, 0, sizeof(histograms));
+    k_spin_unlock(&lock, key);
+
+    shell_print(sh, "Latency histograms reset");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_latency,
+                               SHELL_CMD(stats, NULL, "Show report latency histograms",
+                                         cmd_latency_stats),
+                               SHELL_CMD(reset, NULL, "Reset report latency histograms",
+                                         cmd_latency_reset),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((zmk), latency, &sub_latency, "Report latency per transport", NULL, 0, 0);
+
+#endif // IS_ENABLED(CONFIG_SHELL)
@@ -8,6 +8,11 @@
 #include <zephyr/settings/settings.h>
 
 #include <stdio.h>
+#include <string.h>
+
+#if IS_ENABLED(CONFIG_SHELL)
+#include <zephyr/shell/shell.h>
+#endif
 
 #include <zmk/ble.h>
 #include <zmk/endpoints.h>
@@ -15,6 +20,7 @@
 #include <dt-bindings/zmk/hid_usage_pages.h>
 #include <zmk/usb_hid.h>
 #include <zmk/hog.h>
+#include <zmk/settings.h>
 #include <zmk/mouse/hid.h>
 #include <zmk/mouse/hog.h>
 #include <zmk/mouse/usb_hid.h>
@@ -22,6 +28,9 @@
 #include <zmk/events/ble_active_profile_changed.h>
 #include <zmk/events/usb_conn_state_changed.h>
 #include <zmk/events/endpoint_changed.h>
+#include <zmk/boot_timing.h>
+#include <zmk/benchmark.h>
+#include <zmk/profiling.h>
 
 #include <zephyr/logging/log.h>
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
@@ -30,25 +39,35 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
     COND_CODE_1(IS_ENABLED(CONFIG_ZMK_BLE), (ZMK_TRANSPORT_BLE), (ZMK_TRANSPORT_USB))
 
 static struct zmk_endpoint_instance current_instance = {};
+
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+// The profile BLE reports are sent to. Other bonded hosts can stay connected in the background, so
+// switching profiles only has to move this target.
+static uint8_t ble_target_profile;
+#endif
 static enum zmk_transport preferred_transport =
     ZMK_TRANSPORT_USB; /* Used if multiple endpoints are ready */
 
-static void update_current_endpoint(void);
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
+static bool mirror_enabled = false;
+#endif
 
-#if IS_ENABLED(CONFIG_SETTINGS)
-static void endpoints_save_preferred_work(struct k_work *work) {
-    settings_save_one("endpoints/preferred", &preferred_transport, sizeof(preferred_transport));
-}
+BUILD_ASSERT(ZMK_ENDPOINT_COUNT <= 32, "Endpoint policies are stored as a 32 bit mask");
 
-static struct k_work_delayable endpoints_save_work;
-#endif
+// Endpoints whose hosts need the key release reported before the modifier release, indexed by
+// zmk_endpoint_instance_to_index(). CONFIG_ZMK_HID_SEPARATE_MOD_RELEASE_REPORT sets the default.
+static uint32_t separate_mod_release_endpoints =
+    IS_ENABLED(CONFIG_ZMK_HID_SEPARATE_MOD_RELEASE_REPORT) ? BIT_MASK(ZMK_ENDPOINT_COUNT) : 0;
+
+static void update_current_endpoint(void);
 
 static int endpoints_save_preferred(void) {
-#if IS_ENABLED(CONFIG_SETTINGS)
-    return k_work_reschedule(&endpoints_save_work, K_MSEC(CONFIG_ZMK_SETTINGS_SAVE_DEBOUNCE));
-#else
-    return 0;
+    zmk_settings_save("endpoints/preferred", &preferred_transport, sizeof(preferred_transport));
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
+    zmk_settings_save("endpoints/mirror", &mirror_enabled, sizeof(mirror_enabled));
 #endif
+    return zmk_settings_save("endpoints/mod_release", &separate_mod_release_endpoints,
+                             sizeof(separate_mod_release_endpoints));
 }
 
 bool zmk_endpoint_instance_eq(struct zmk_endpoint_instance a, struct zmk_endpoint_instance b) {
@@ -123,8 +142,81 @@ struct zmk_endpoint_instance zmk_endpoints_selected(void) {
     return current_instance;
 }
 
-static int send_keyboard_report(void) {
-    switch (current_instance.transport) {
+static bool is_usb_ready(void);
+static bool is_ble_ready(void);
+
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
+
+int zmk_endpoints_set_mirror(bool enabled) {
+    if (mirror_enabled == enabled) {
+        return 0;
+    }
+
+    // Release everything on both transports first, so nothing stays held on the one that stops
+    // receiving reports.
+    zmk_endpoints_clear_current();
+
+    mirror_enabled = enabled;
+    LOG_INF("Endpoint mirroring %s", enabled ? "enabled" : "disabled");
+
+    return endpoints_save_preferred();
+}
+
+int zmk_endpoints_toggle_mirror(void) { return zmk_endpoints_set_mirror(!mirror_enabled); }
+
+bool zmk_endpoints_mirror_enabled(void) { return mirror_enabled; }
+
+static bool is_mirroring(void) { return mirror_enabled && is_usb_ready() && is_ble_ready(); }
+
+#endif // IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
+
+static bool endpoint_separate_mod_release(struct zmk_endpoint_instance endpoint) {
+    return separate_mod_release_endpoints & BIT(zmk_endpoint_instance_to_index(endpoint));
+}
+
+bool zmk_endpoints_separate_mod_release(void) {
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
+    if (is_mirroring()) {
+        struct zmk_endpoint_instance usb = {.transport = ZMK_TRANSPORT_USB};
+        struct zmk_endpoint_instance ble = {.transport = ZMK_TRANSPORT_BLE,
+                                            .ble.profile_index = zmk_ble_active_profile_index()};
+        return endpoint_separate_mod_release(usb) || endpoint_separate_mod_release(ble);
+    }
+#endif // IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
+
+    return endpoint_separate_mod_release(current_instance);
+}
+
+int zmk_endpoints_set_separate_mod_release(struct zmk_endpoint_instance endpoint, bool enabled) {
+    uint32_t mask = separate_mod_release_endpoints;
+    WRITE_BIT(mask, zmk_endpoint_instance_to_index(endpoint), enabled);
+
+    if (mask == separate_mod_release_endpoints) {
+        return 0;
+    }
+
+    separate_mod_release_endpoints = mask;
+    return endpoints_save_preferred();
+}
+
+/*
+ * Calls send(transport) for the selected transport, or for both transports when mirroring. USB is
+ * sent first: its queue never blocks, while a full HOG queue may wait before dropping a report.
+ */
+static int send_to_transports(int (*send)(enum zmk_transport transport)) {
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
+    if (is_mirroring()) {
+        int usb_err = send(ZMK_TRANSPORT_USB);
+        int ble_err = send(ZMK_TRANSPORT_BLE);
+        return usb_err ? usb_err : ble_err;
+    }
+#endif // IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
+
+    return send(current_instance.transport);
+}
+
+static int send_keyboard_report_to(enum zmk_transport transport) {
+    switch (transport) {
     case ZMK_TRANSPORT_USB: {
 #if IS_ENABLED(CONFIG_ZMK_USB)
         int err = zmk_usb_hid_send_keyboard_report();
@@ -153,12 +245,12 @@ static int send_keyboard_report(void) {
     }
     }
 
-    LOG_ERR("Unhandled endpoint transport %d", current_instance.transport);
+    LOG_ERR("Unhandled endpoint transport %d", transport);
     return -ENOTSUP;
 }
 
-static int send_consumer_report(void) {
-    switch (current_instance.transport) {
+static int send_consumer_report_to(enum zmk_transport transport) {
+    switch (transport) {
     case ZMK_TRANSPORT_USB: {
 #if IS_ENABLED(CONFIG_ZMK_USB)
         int err = zmk_usb_hid_send_consumer_report();
@@ -187,19 +279,21 @@ static int send_consumer_report(void) {
     }
     }
 
-    LOG_ERR("Unhandled endpoint transport %d", current_instance.transport);
+    LOG_ERR("Unhandled endpoint transport %d", transport);
     return -ENOTSUP;
 }
 
 int zmk_endpoints_send_report(uint16_t usage_page) {
 
     LOG_DBG("usage page 0x%02X", usage_page);
+    zmk_benchmark_report_sent();
+    zmk_profiling_mark(ZMK_PROFILING_ENDPOINT_SEND);
     switch (usage_page) {
     case HID_USAGE_KEY:
-        return send_keyboard_report();
+        return send_to_transports(send_keyboard_report_to);
 
     case HID_USAGE_CONSUMER:
-        return send_consumer_report();
+        return send_to_transports(send_consumer_report_to);
     }
 
     LOG_ERR("Unsupported usage page %d", usage_page);
@@ -207,8 +301,8 @@ int zmk_endpoints_send_report(uint16_t usage_page) {
 }
 
 #if IS_ENABLED(CONFIG_ZMK_MOUSE)
-int zmk_endpoints_send_mouse_report() {
-    switch (current_instance.transport) {
+static int send_mouse_report_to(enum zmk_transport transport) {
+    switch (transport) {
     case ZMK_TRANSPORT_USB: {
 #if IS_ENABLED(CONFIG_ZMK_USB)
         int err = zmk_mouse_usb_hid_send_mouse_report();
@@ -237,9 +331,105 @@ int zmk_endpoints_send_mouse_report() {
     }
     }
 
-    LOG_ERR("Unhandled endpoint transport %d", current_instance.transport);
+    LOG_ERR("Unhandled endpoint transport %d", transport);
     return -ENOTSUP;
 }
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+static int send_mouse_abs_report_to(enum zmk_transport transport) {
+    switch (transport) {
+    case ZMK_TRANSPORT_USB: {
+#if IS_ENABLED(CONFIG_ZMK_USB)
+        int err = zmk_mouse_usb_hid_send_mouse_abs_report();
+        if (err) {
+            LOG_ERR("FAILED TO SEND OVER USB: %d", err);
+        }
+        return err;
+#else
+        LOG_ERR("USB endpoint is not supported");
+        return -ENOTSUP;
+#endif /* IS_ENABLED(CONFIG_ZMK_USB) */
+    }
+
+    case ZMK_TRANSPORT_BLE: {
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+        struct zmk_hid_mouse_abs_report *abs_report = zmk_mouse_hid_get_mouse_abs_report();
+        int err = zmk_mouse_hog_send_mouse_abs_report(&abs_report->body);
+        if (err) {
+            LOG_ERR("FAILED TO SEND OVER HOG: %d", err);
+        }
+        return err;
+#else
+        LOG_ERR("BLE HOG endpoint is not supported");
+        return -ENOTSUP;
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE) */
+    }
+    }
+
+    LOG_ERR("Unhandled endpoint transport %d", transport);
+    return -ENOTSUP;
+}
+
+int zmk_endpoints_send_mouse_abs_report() {
+    // This report carries the current buttons, so nothing is left to sync.
+    zmk_hid_mouse_abs_buttons_changed();
+    return send_to_transports(send_mouse_abs_report_to);
+}
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+
+int zmk_endpoints_send_mouse_report() {
+    int err = send_to_transports(send_mouse_report_to);
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+    if (zmk_hid_mouse_abs_buttons_changed()) {
+        int abs_err = send_to_transports(send_mouse_abs_report_to);
+        err = err ? err : abs_err;
+    }
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+
+    return err;
+}
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+static bool scroll_high_res(enum zmk_transport transport) {
+    switch (transport) {
+    case ZMK_TRANSPORT_USB:
+#if IS_ENABLED(CONFIG_ZMK_USB)
+        return zmk_mouse_usb_hid_scroll_high_res();
+#else
+        return false;
+#endif /* IS_ENABLED(CONFIG_ZMK_USB) */
+
+    case ZMK_TRANSPORT_BLE:
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+        return zmk_mouse_hog_scroll_high_res();
+#else
+        return false;
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE) */
+    }
+
+    return false;
+}
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+
+int zmk_endpoints_mouse_scroll_multiplier(void) {
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+    bool high_res = scroll_high_res(current_instance.transport);
+
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
+    // Both hosts get the same report, so only use high resolution if both of them asked for it.
+    if (is_mirroring()) {
+        high_res = scroll_high_res(ZMK_TRANSPORT_USB) && scroll_high_res(ZMK_TRANSPORT_BLE);
+    }
+#endif // IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
+
+    if (high_res) {
+        return CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING_MULTIPLIER;
+    }
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+
+    return 1;
+}
 #endif // IS_ENABLED(CONFIG_ZMK_MOUSE)
 
 #if IS_ENABLED(CONFIG_SETTINGS)
@@ -263,6 +453,37 @@ static int endpoints_handle_set(const char *name, size_t len, settings_read_cb r
         update_current_endpoint();
     }
 
+    if (settings_name_steq(name, "mod_release", NULL)) {
+        if (len != sizeof(separate_mod_release_endpoints)) {
+            LOG_ERR("Invalid mod release policy size (got %d expected %d)", len,
+                    sizeof(separate_mod_release_endpoints));
+            return -EINVAL;
+        }
+
+        int err = read_cb(cb_arg, &separate_mod_release_endpoints,
+                          sizeof(separate_mod_release_endpoints));
+        if (err <= 0) {
+            LOG_ERR("Failed to read mod release policy from settings (err %d)", err);
+            return err;
+        }
+    }
+
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
+    if (settings_name_steq(name, "mirror", NULL)) {
+        if (len != sizeof(mirror_enabled)) {
+            LOG_ERR("Invalid endpoint mirror size (got %d expected %d)", len,
+                    sizeof(mirror_enabled));
+            return -EINVAL;
+        }
+
+        int err = read_cb(cb_arg, &mirror_enabled, sizeof(mirror_enabled));
+        if (err <= 0) {
+            LOG_ERR("Failed to read endpoint mirror setting (err %d)", err);
+            return err;
+        }
+    }
+#endif // IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
+
     return 0;
 }
 
@@ -333,13 +554,16 @@ static int zmk_endpoints_init(void) {
         return err;
     }
 
-    k_work_init_delayable(&endpoints_save_work, endpoints_save_preferred_work);
-
-    settings_load_subtree("endpoints");
+    zmk_settings_load_subtree("endpoints");
 #endif
 
     current_instance = get_selected_instance();
 
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+    ble_target_profile = zmk_ble_active_profile_index();
+    zmk_hog_set_target_profile(ble_target_profile);
+#endif
+
     return 0;
 }
 
@@ -354,9 +578,41 @@ void zmk_endpoints_clear_current(void) {
     zmk_endpoints_send_report(HID_USAGE_CONSUMER);
 }
 
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+static bool ble_receives_reports(void) {
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINTS_MIRROR)
+    if (is_mirroring()) {
+        return true;
+    }
+#endif
+
+    return current_instance.transport == ZMK_TRANSPORT_BLE;
+}
+
+static void update_ble_target(void) {
+    uint8_t profile = zmk_ble_active_profile_index();
+    if (profile == ble_target_profile) {
+        return;
+    }
+
+    // Release everything on the old host first. Those reports are queued for the old target, so
+    // they reach it even though the new host is used as soon as the target moves.
+    if (ble_receives_reports()) {
+        zmk_endpoints_clear_current();
+    }
+
+    ble_target_profile = profile;
+    zmk_hog_set_target_profile(profile);
+}
+#endif // IS_ENABLED(CONFIG_ZMK_BLE)
+
 static void update_current_endpoint(void) {
     struct zmk_endpoint_instance new_instance = get_selected_instance();
 
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+    update_ble_target();
+#endif
+
     if (!zmk_endpoint_instance_eq(new_instance, current_instance)) {
         // Cancel all current keypresses so keys don't stay held on the old endpoint.
         zmk_endpoints_clear_current();
@@ -384,4 +640,40 @@ ZMK_SUBSCRIPTION(endpoint_listener, zmk_usb_conn_state_changed);
 ZMK_SUBSCRIPTION(endpoint_listener, zmk_ble_active_profile_changed);
 #endif
 
-SYS_INIT(zmk_endpoints_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+#if IS_ENABLED(CONFIG_SHELL)
+
+static int cmd_endpoint_mod_release(const struct shell *sh, size_t argc, char **argv) {
+    char endpoint_str[ZMK_ENDPOINT_STR_LEN];
+    zmk_endpoint_instance_to_str(current_instance, endpoint_str, sizeof(endpoint_str));
+
+    if (argc > 1) {
+        bool enabled;
+        if (strcmp(argv[1], "on") == 0) {
+            enabled = true;
+        } else if (strcmp(argv[1], "off") == 0) {
+            enabled = false;
+        } else {
+            shell_error(sh, "Expected on or off");
+            return -EINVAL;
+        }
+
+        zmk_endpoints_set_separate_mod_release(current_instance, enabled);
+    }
+
+    shell_print(sh, "%s: %s modifier release reports", endpoint_str,
+                endpoint_separate_mod_release(current_instance) ? "separate" : "combined");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_endpoint,
+                               SHELL_CMD_ARG(mod_release, NULL,
+                                             "Show or set whether the selected endpoint gets "
+                                             "modifier releases in a separate report [on|off]",
+                                             cmd_endpoint_mod_release, 1, 1),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((zmk), endpoint, &sub_endpoint, "Endpoint policies", NULL, 0, 0);
+
+#endif // IS_ENABLED(CONFIG_SHELL)
+
+ZMK_SYS_INIT(zmk_endpoints_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -10,23 +10,170 @@
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #include <zmk/event_manager.h>
+#include <zmk/boot_timing.h>
+#include <zmk/benchmark.h>
 
-extern struct zmk_event_type *__event_type_start[];
-extern struct zmk_event_type *__event_type_end[];
+extern const struct zmk_event_subscription __event_subscriptions_start[];
+extern const struct zmk_event_subscription __event_subscriptions_end[];
 
-extern struct zmk_event_subscription __event_subscriptions_start[];
-extern struct zmk_event_subscription __event_subscriptions_end[];
+/*
+ * The subscription section is sorted by event type, so an event type's subscriptions are the run
+ * that starts at its marker. The run ends at the next event type's subscriptions or at any
+ * alignment padding before the next marker, which reads as a NULL event type.
+ */
+static inline bool is_subscription_for(const zmk_event_t *event, int index) {
+    const struct zmk_event_subscription *ev_sub = event->event->subscriptions + index;
 
-int zmk_event_manager_handle_from(zmk_event_t *event, uint8_t start_index) {
+    return ev_sub < __event_subscriptions_end && ev_sub->event_type == event->event;
+}
+
+#if IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_TRACING)
+
+#include <zephyr/shell/shell.h>
+
+struct subscription_stats {
+    uint32_t calls;
+    uint32_t captured;
+    uint32_t handled;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+};
+
+static struct subscription_stats
+    subscription_stats[CONFIG_ZMK_EVENT_MANAGER_TRACING_MAX_SUBSCRIPTIONS];
+
+// Events are raised almost exclusively from the system work queue, so the depth is tracked
+// globally rather than per thread.
+static uint8_t raise_depth;
+static uint8_t max_raise_depth;
+
+static int call_listener(zmk_event_t *event, const struct zmk_event_subscription *ev_sub) {
+    size_t index = ev_sub - __event_subscriptions_start;
+    uint32_t start = k_cycle_get_32();
+
+    int ret = ev_sub->listener->callback(event);
+
+    uint32_t cycles = k_cycle_get_32() - start;
+
+    if (index >= ARRAY_SIZE(subscription_stats)) {
+        return ret;
+    }
+
+    struct subscription_stats *stats = &subscription_stats[index];
+
+    stats->calls++;
+    stats->total_cycles += cycles;
+    stats->max_cycles = MAX(stats->max_cycles, cycles);
+    if (ret == ZMK_EV_EVENT_CAPTURED) {
+        stats->captured++;
+    } else if (ret == ZMK_EV_EVENT_HANDLED) {
+        stats->handled++;
+    }
+
+    return ret;
+}
+
+typedef void (*stats_print_t)(void *ctx, const char *line);
+
+static void print_stats(stats_print_t print, void *ctx) {
+    char line[128];
+    size_t len = MIN(__event_subscriptions_end - __event_subscriptions_start,
+                     ARRAY_SIZE(subscription_stats));
+
+    snprintf(line, sizeof(line), "Max raise depth: %u", max_raise_depth);
+    print(ctx, line);
+
+    for (size_t i = 0; i < len; i++) {
+        const struct zmk_event_subscription *ev_sub = &__event_subscriptions_start[i];
+        const struct subscription_stats *stats = &subscription_stats[i];
+
+        if (stats->calls == 0) {
+            continue;
+        }
+
+        snprintf(line, sizeof(line),
+                 "%s -> %s: calls %u, captured %u, handled %u, avg %uus, max %uus",
+                 ev_sub->event_type->name, ev_sub->listener->name, stats->calls, stats->captured,
+                 stats->handled, k_cyc_to_us_floor32(stats->total_cycles / stats->calls),
+                 k_cyc_to_us_floor32(stats->max_cycles));
+        print(ctx, line);
+    }
+}
+
+static void reset_stats(void) {
+    memset(subscription_stats, 0, sizeof(subscription_stats));
+    max_raise_depth = 0;
+}
+
+#if CONFIG_ZMK_EVENT_MANAGER_TRACING_LOG_INTERVAL > 0
+
+static void log_stats_line(void *ctx, const char *line) { LOG_INF("%s", line); }
+
+static void log_stats_work_handler(struct k_work *work) {
+    print_stats(log_stats_line, NULL);
+    k_work_schedule(k_work_delayable_from_work(work),
+                    K_SECONDS(CONFIG_ZMK_EVENT_MANAGER_TRACING_LOG_INTERVAL));
+}
+
+static K_WORK_DELAYABLE_DEFINE(log_stats_work, log_stats_work_handler);
+
+static int event_manager_tracing_init(void) {
+    k_work_schedule(&log_stats_work, K_SECONDS(CONFIG_ZMK_EVENT_MANAGER_TRACING_LOG_INTERVAL));
+    return 0;
+}
+
+ZMK_SYS_INIT(event_manager_tracing_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#endif // CONFIG_ZMK_EVENT_MANAGER_TRACING_LOG_INTERVAL > 0
+
+#if IS_ENABLED(CONFIG_SHELL)
+
+static void shell_stats_line(void *ctx, const char *line) {
+    shell_print((const struct shell *)ctx, "%s", line);
+}
+
+static int cmd_events_stats(const struct shell *sh, size_t argc, char **argv) {
+    print_stats(shell_stats_line, (void *)sh);
+    return 0;
+}
+
+static int cmd_events_reset(const struct shell *sh, size_t argc, char **argv) {
+    reset_stats();
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_events,
+                               SHELL_CMD(stats, NULL, "Show per-listener statistics",
+                                         cmd_events_stats),
+                               SHELL_CMD(reset, NULL, "Reset statistics", cmd_events_reset),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((zmk), events, &sub_events, "Event manager tracing", NULL, 0, 0);
+
+#endif // IS_ENABLED(CONFIG_SHELL)
+
+#else
+
+static inline int call_listener(zmk_event_t *event, const struct zmk_event_subscription *ev_sub) {
+    return ev_sub->listener->callback(event);
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_TRACING)
+
+static inline bool listener_is_enabled(const struct zmk_listener *listener) {
+    return listener->enabled == NULL || *listener->enabled;
+}
+
+static int handle_from(zmk_event_t *event, uint8_t start_index) {
     int ret = 0;
-    uint8_t len = __event_subscriptions_end - __event_subscriptions_start;
-    for (int i = start_index; i < len; i++) {
-        struct zmk_event_subscription *ev_sub = __event_subscriptions_start + i;
-        if (ev_sub->event_type != event->event) {
+    for (int i = start_index; is_subscription_for(event, i); i++) {
+        const struct zmk_event_subscription *ev_sub = event->event->subscriptions + i;
+        if (!listener_is_enabled(ev_sub->listener)) {
             continue;
         }
         event->last_listener_index = i;
-        ret = ev_sub->listener->callback(event);
+        zmk_benchmark_listener_called();
+        ret = call_listener(event, ev_sub);
         switch (ret) {
         case ZMK_EV_EVENT_BUBBLE:
             continue;
@@ -45,31 +192,61 @@ int zmk_event_manager_handle_from(zmk_event_t *event, uint8_t start_index) {
     return 0;
 }
 
-int zmk_event_manager_raise(zmk_event_t *event) { return zmk_event_manager_handle_from(event, 0); }
+int zmk_event_manager_handle_from(zmk_event_t *event, uint8_t start_index) {
+#if IS_ENABLED(CONFIG_ZMK_EVENT_MANAGER_TRACING)
+    raise_depth++;
+    max_raise_depth = MAX(max_raise_depth, raise_depth);
 
-int zmk_event_manager_raise_after(zmk_event_t *event, const struct zmk_listener *listener) {
-    uint8_t len = __event_subscriptions_end - __event_subscriptions_start;
-    for (int i = 0; i < len; i++) {
-        struct zmk_event_subscription *ev_sub = __event_subscriptions_start + i;
+    int ret = handle_from(event, start_index);
 
-        if (ev_sub->event_type == event->event && ev_sub->listener == listener) {
-            return zmk_event_manager_handle_from(event, i + 1);
+    raise_depth--;
+    return ret;
+#else
+    return handle_from(event, start_index);
+#endif
+}
+
+/**
+ * Find the index of a listener's subscription among the subscriptions for the event's type.
+ *
+ * Events passed to ZMK_EVENT_RAISE_AFTER/ZMK_EVENT_RAISE_AT are almost always ones the same
+ * listener captured or copied while handling them, so the listener index recorded in the event
+ * header is checked first and resolves the lookup without a scan.
+ */
+static int subscription_index(const zmk_event_t *event, const struct zmk_listener *listener) {
+    const struct zmk_event_subscription *subs = event->event->subscriptions;
+
+    if (is_subscription_for(event, event->last_listener_index) &&
+        subs[event->last_listener_index].listener == listener) {
+        return event->last_listener_index;
+    }
+
+    for (int i = 0; is_subscription_for(event, i); i++) {
+        if (subs[i].listener == listener) {
+            return i;
         }
     }
 
+    return -ENOENT;
+}
+
+int zmk_event_manager_raise(zmk_event_t *event) { return zmk_event_manager_handle_from(event, 0); }
+
+int zmk_event_manager_raise_after(zmk_event_t *event, const struct zmk_listener *listener) {
+    int index = subscription_index(event, listener);
+    if (index >= 0) {
+        return zmk_event_manager_handle_from(event, index + 1);
+    }
+
     LOG_WRN("Unable to find where to raise this after event");
 
     return -EINVAL;
 }
 
 int zmk_event_manager_raise_at(zmk_event_t *event, const struct zmk_listener *listener) {
-    uint8_t len = __event_subscriptions_end - __event_subscriptions_start;
-    for (int i = 0; i < len; i++) {
-        struct zmk_event_subscription *ev_sub = __event_subscriptions_start + i;
-
-        if (ev_sub->event_type == event->event && ev_sub->listener == listener) {
-            return zmk_event_manager_handle_from(event, i);
-        }
+    int index = subscription_index(event, listener);
+    if (index >= 0) {
+        return zmk_event_manager_handle_from(event, index);
     }
 
     LOG_WRN("Unable to find where to raise this event");
@@ -80,3 +257,12 @@ int zmk_event_manager_raise_at(zmk_event_t *event, const struct zmk_listener *li
 int zmk_event_manager_release(zmk_event_t *event) {
     return zmk_event_manager_handle_from(event, event->last_listener_index + 1);
 }
+
+int zmk_event_manager_set_listener_enabled(const struct zmk_listener *listener, bool enabled) {
+    if (listener->enabled == NULL) {
+        return -ENOTSUP;
+    }
+
+    *listener->enabled = enabled;
+    return 0;
+}
@@ -0,0 +1,10 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <zephyr/kernel.h>
+#include <zmk/events/split_ble_link_stats_changed.h>
+
+ZMK_EVENT_IMPL(zmk_split_ble_link_stats_changed);
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/pm/device.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/ext_power.h>
+
+#if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_EXT_POWER)
+#include <zmk/rgb_underglow.h>
+#endif
+#include <zmk/boot_timing.h>
+
+#if IS_ENABLED(CONFIG_ZMK_BACKLIGHT)
+#include <zmk/backlight.h>
+#endif
+
+static const struct device *const ext_power = DEVICE_DT_GET(DT_INST(0, zmk_ext_power_generic));
+
+static bool ext_power_is_needed(void) {
+#if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_EXT_POWER)
+    bool underglow_on;
+
+    if (zmk_rgb_underglow_get_state(&underglow_on) == 0 && underglow_on) {
+        return true;
+    }
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_BACKLIGHT)
+    if (zmk_backlight_is_on()) {
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+static void ext_power_auto_off_work_handler(struct k_work *work) {
+    if (ext_power_is_needed()) {
+        return;
+    }
+
+    // The saved state is left alone, so the output comes back as it was when resumed.
+    int rc = pm_device_action_run(ext_power, PM_DEVICE_ACTION_SUSPEND);
+    if (rc == 0) {
+        LOG_DBG("Nothing is using external power, switching it off");
+    } else if (rc != -EALREADY) {
+        LOG_WRN("Failed to switch off unused external power (err %d)", rc);
+    }
+}
+
+static K_WORK_DELAYABLE_DEFINE(ext_power_auto_off_work, ext_power_auto_off_work_handler);
+
+void zmk_ext_power_auto_off_update(void) {
+    if (!ext_power_is_needed()) {
+        // Wait before switching off, so turning lighting off and on again doesn't cycle power.
+        k_work_reschedule(&ext_power_auto_off_work, K_MSEC(CONFIG_ZMK_EXT_POWER_AUTO_OFF_DELAY_MS));
+        return;
+    }
+
+    k_work_cancel_delayable(&ext_power_auto_off_work);
+
+    int rc = pm_device_action_run(ext_power, PM_DEVICE_ACTION_RESUME);
+    if (rc == 0) {
+        LOG_DBG("External power is in use, switching it back on");
+    } else if (rc != -EALREADY) {
+        LOG_WRN("Failed to switch on external power (err %d)", rc);
+    }
+}
+
+static int ext_power_auto_off_init(void) {
+    if (!device_is_ready(ext_power)) {
+        LOG_ERR("External power device \"%s\" is not ready", ext_power->name);
+        return -ENODEV;
+    }
+
+    // Lighting restores its state from settings after init, so only check once that has happened.
+    k_work_schedule(&ext_power_auto_off_work, K_MSEC(CONFIG_ZMK_EXT_POWER_AUTO_OFF_DELAY_MS));
+    return 0;
+}
+
+ZMK_SYS_INIT(ext_power_auto_off_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -16,6 +16,8 @@
 
 #include <drivers/ext_power.h>
 
+#include <zmk/settings.h>
+
 #if DT_HAS_COMPAT_STATUS_OKAY(DT_DRV_COMPAT)
 
 #include <zephyr/logging/log.h>
@@ -33,53 +35,63 @@ struct ext_power_generic_data {
 #endif
 };
 
+int ext_power_save_state(void) {
 #if IS_ENABLED(CONFIG_SETTINGS)
-static void ext_power_save_state_work(struct k_work *work) {
     char setting_path[40];
     const struct device *ext_power = DEVICE_DT_GET(DT_DRV_INST(0));
     struct ext_power_generic_data *data = ext_power->data;
 
     snprintf(setting_path, sizeof(setting_path), "ext_power/state/%s", ext_power->name);
-    settings_save_one(setting_path, &data->status, sizeof(data->status));
-}
-
-static struct k_work_delayable ext_power_save_work;
-#endif
-
-int ext_power_save_state(void) {
-#if IS_ENABLED(CONFIG_SETTINGS)
-    int ret = k_work_reschedule(&ext_power_save_work, K_MSEC(CONFIG_ZMK_SETTINGS_SAVE_DEBOUNCE));
-    return MIN(ret, 0);
+    return zmk_settings_save(setting_path, &data->status, sizeof(data->status));
 #else
     return 0;
 #endif
 }
 
-static int ext_power_generic_enable(const struct device *dev) {
-    struct ext_power_generic_data *data = dev->data;
+static int ext_power_generic_set_control(const struct device *dev, bool on) {
     const struct ext_power_generic_config *config = dev->config;
 
-    if (gpio_pin_set_dt(&config->control, 1)) {
-        LOG_WRN("Failed to set ext-power control pin");
+    if (gpio_pin_set_dt(&config->control, on)) {
+        LOG_WRN("Failed to %s ext-power control pin", on ? "set" : "clear");
         return -EIO;
     }
-    data->status = true;
-    return ext_power_save_state();
+
+    return 0;
 }
 
-static int ext_power_generic_disable(const struct device *dev) {
+static bool ext_power_generic_is_suspended(const struct device *dev) {
+#ifdef CONFIG_PM_DEVICE
+    enum pm_device_state state;
+
+    return pm_device_state_get(dev, &state) == 0 && state == PM_DEVICE_STATE_SUSPENDED;
+#else
+    return false;
+#endif
+}
+
+// While suspended the output stays off, and the new state is applied when the device resumes.
+static int ext_power_generic_set_status(const struct device *dev, bool status) {
     struct ext_power_generic_data *data = dev->data;
-    const struct ext_power_generic_config *config = dev->config;
 
-    if (gpio_pin_set_dt(&config->control, 0)) {
-        LOG_WRN("Failed to set ext-power control pin");
-        LOG_WRN("Failed to clear ext-power control pin");
-        return -EIO;
+    if (!ext_power_generic_is_suspended(dev)) {
+        int rc = ext_power_generic_set_control(dev, status);
+        if (rc < 0) {
+            return rc;
+        }
     }
-    data->status = false;
+
+    data->status = status;
     return ext_power_save_state();
 }
 
+static int ext_power_generic_enable(const struct device *dev) {
+    return ext_power_generic_set_status(dev, true);
+}
+
+static int ext_power_generic_disable(const struct device *dev) {
+    return ext_power_generic_set_status(dev, false);
+}
+
 static int ext_power_generic_get(const struct device *dev) {
     struct ext_power_generic_data *data = dev->data;
     return data->status;
@@ -98,10 +110,9 @@ static int ext_power_settings_set_status(const struct device *dev, size_t len,
     if (rc >= 0) {
         data->settings_init = true;
 
-        if (data->status) {
-            ext_power_generic_enable(dev);
-        } else {
-            ext_power_generic_disable(dev);
+        // Apply the loaded state without queueing it to be written back again.
+        if (!ext_power_generic_is_suspended(dev)) {
+            ext_power_generic_set_control(dev, data->status);
         }
 
         return 0;
@@ -143,14 +154,13 @@ static int ext_power_generic_init(const struct device *dev) {
         return err;
     }
 
-    k_work_init_delayable(&ext_power_save_work, ext_power_save_state_work);
-
     // Set default value (on) if settings isn't set
-    settings_load_subtree("ext_power");
+    zmk_settings_load_subtree("ext_power");
     if (!data->settings_init) {
 
         data->status = true;
-        k_work_schedule(&ext_power_save_work, K_NO_WAIT);
+        ext_power_save_state();
+        zmk_settings_save_flush();
 
         ext_power_enable(dev);
     }
@@ -168,13 +178,14 @@ static int ext_power_generic_init(const struct device *dev) {
 
 #ifdef CONFIG_PM_DEVICE
 static int ext_power_generic_pm_action(const struct device *dev, enum pm_device_action action) {
+    struct ext_power_generic_data *data = dev->data;
+
     switch (action) {
+    // Suspending only switches the output off, so the saved state isn't changed by sleeping.
     case PM_DEVICE_ACTION_RESUME:
-        ext_power_generic_enable(dev);
-        return 0;
+        return ext_power_generic_set_control(dev, data->status);
     case PM_DEVICE_ACTION_SUSPEND:
-        ext_power_generic_disable(dev);
-        return 0;
+        return ext_power_generic_set_control(dev, false);
     default:
         return -ENOTSUP;
     }
@@ -8,7 +8,12 @@
 #include <zephyr/logging/log.h>
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
+#include <string.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/arch/common/ffs.h>
+
 #include <zmk/hid.h>
+#include <zmk/events/modifiers_state_changed.h>
 #include <dt-bindings/zmk/modifiers.h>
 
 static struct zmk_hid_keyboard_report keyboard_report = {
@@ -22,6 +27,9 @@ static struct zmk_hid_consumer_report consumer_report = {.report_id = ZMK_HID_RE
 
 static zmk_hid_boot_report_t boot_report = {.modifiers = 0, ._reserved = 0, .keys = {0}};
 static uint8_t keys_held = 0;
+// Set once more keys are held than fit in the boot report, since its keys are then no longer kept
+// up to date.
+static bool boot_keys_stale = false;
 
 #endif /* IS_ENABLED(CONFIG_ZMK_USB_BOOT) */
 
@@ -42,12 +50,22 @@ static zmk_mod_flags_t masked_modifiers = 0;
 
 zmk_mod_flags_t zmk_hid_get_explicit_mods(void) { return explicit_modifiers; }
 
+// Lets behaviors that depend on the held modifiers, such as mod-morph, follow them as they change
+// instead of querying them on every key press.
+static void raise_explicit_mod_changed(zmk_mod_t modifier, bool state) {
+    raise_zmk_modifiers_state_changed(
+        (struct zmk_modifiers_state_changed){.modifiers = BIT(modifier), .state = state});
+}
+
 int zmk_hid_register_mod(zmk_mod_t modifier) {
     explicit_modifier_counts[modifier]++;
     LOG_DBG("Modifier %d count %d", modifier, explicit_modifier_counts[modifier]);
     WRITE_BIT(explicit_modifiers, modifier, true);
     zmk_mod_flags_t current = GET_MODIFIERS;
     SET_MODIFIERS(explicit_modifiers);
+    if (explicit_modifier_counts[modifier] == 1) {
+        raise_explicit_mod_changed(modifier, true);
+    }
     return current == GET_MODIFIERS ? 0 : 1;
 }
 
@@ -64,6 +82,9 @@ int zmk_hid_unregister_mod(zmk_mod_t modifier) {
     }
     zmk_mod_flags_t current = GET_MODIFIERS;
     SET_MODIFIERS(explicit_modifiers);
+    if (explicit_modifier_counts[modifier] == 0) {
+        raise_explicit_mod_changed(modifier, false);
+    }
     return current == GET_MODIFIERS ? 0 : 1;
 }
 
@@ -103,19 +124,70 @@ static zmk_hid_boot_report_t *boot_report_rollover(uint8_t modifiers) {
     return &boot_report;
 }
 
-#endif /* IS_ENABLED(CONFIG_ZMK_USB_BOOT) */
+// Fills the boot report keys from the keyboard report. Only needed when the number of held keys
+// drops back to what fits in the boot report.
+static void boot_report_rebuild(void);
 
-#if IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_NKRO)
+// The boot report keys are kept up to date as usages are selected and deselected, in the order
+// they were pressed, so sending the boot report doesn't need to build it from the keyboard report.
+static void boot_report_select(zmk_key_t usage) {
+    keys_held++;
 
-#define TOGGLE_KEYBOARD(code, val) WRITE_BIT(keyboard_report.body.keys[code / 8], code % 8, val)
+    if (keys_held > HID_BOOT_KEY_LEN) {
+        boot_keys_stale = true;
+    } else if (!boot_keys_stale) {
+        boot_report.keys[keys_held - 1] = usage;
+    }
+}
+
+static void boot_report_deselect(zmk_key_t usage) {
+    if (keys_held == 0) {
+        return;
+    }
+
+    keys_held--;
+
+    if (boot_keys_stale) {
+        if (keys_held <= HID_BOOT_KEY_LEN) {
+            boot_report_rebuild();
+            boot_keys_stale = false;
+        }
+        return;
+    }
+
+    for (int i = 0; i <= keys_held; i++) {
+        if (boot_report.keys[i] == usage) {
+            // Keep the remaining keys in the order they were pressed.
+            memmove(&boot_report.keys[i], &boot_report.keys[i + 1], keys_held - i);
+            boot_report.keys[keys_held] = 0;
+            break;
+        }
+    }
+}
+
+static void boot_report_reset(void) {
+    memset(&boot_report.keys, 0, HID_BOOT_KEY_LEN);
+    keys_held = 0;
+    boot_keys_stale = false;
+}
 
-#if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
 zmk_hid_boot_report_t *zmk_hid_get_boot_report(void) {
     if (keys_held > HID_BOOT_KEY_LEN) {
         return boot_report_rollover(keyboard_report.body.modifiers);
     }
 
     boot_report.modifiers = keyboard_report.body.modifiers;
+    return &boot_report;
+}
+
+#endif /* IS_ENABLED(CONFIG_ZMK_USB_BOOT) */
+
+#if IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_NKRO)
+
+#define TOGGLE_KEYBOARD(code, val) WRITE_BIT(keyboard_report.body.keys[code / 8], code % 8, val)
+
+#if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
+static void boot_report_rebuild(void) {
     memset(&boot_report.keys, 0, HID_BOOT_KEY_LEN);
     int ix = 0;
     uint8_t base_code = 0;
@@ -127,13 +199,12 @@ zmk_hid_boot_report_t *zmk_hid_get_boot_report(void) {
             continue;
         }
         base_code = i * 8;
-        for (int j = 0; j < 8; ++j) {
+        for (int j = 0; j < 8 && ix < keys_held; ++j) {
             if (keyboard_report.body.keys[i] & BIT(j)) {
                 boot_report.keys[ix++] = base_code + j;
             }
         }
     }
-    return &boot_report;
 }
 #endif
 
@@ -141,9 +212,12 @@ static inline int select_keyboard_usage(zmk_key_t usage) {
     if (usage > ZMK_HID_KEYBOARD_NKRO_MAX_USAGE) {
         return -EINVAL;
     }
+    if (keyboard_report.body.keys[usage / 8] & BIT(usage % 8)) {
+        return 0;
+    }
     TOGGLE_KEYBOARD(usage, 1);
 #if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
-    ++keys_held;
+    boot_report_select(usage);
 #endif
     return 0;
 }
@@ -152,9 +226,12 @@ static inline int deselect_keyboard_usage(zmk_key_t usage) {
     if (usage > ZMK_HID_KEYBOARD_NKRO_MAX_USAGE) {
         return -EINVAL;
     }
+    if (!(keyboard_report.body.keys[usage / 8] & BIT(usage % 8))) {
+        return 0;
+    }
     TOGGLE_KEYBOARD(usage, 0);
 #if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
-    --keys_held;
+    boot_report_deselect(usage);
 #endif
     return 0;
 }
@@ -168,73 +245,113 @@ static inline bool check_keyboard_usage(zmk_key_t usage) {
 
 #elif IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_HKRO)
 
-#define TOGGLE_KEYBOARD(match, val)                                                                \
-    for (int idx = 0; idx < CONFIG_ZMK_HID_KEYBOARD_REPORT_SIZE; idx++) {                          \
-        if (keyboard_report.body.keys[idx] != match) {                                             \
-            continue;                                                                              \
-        }                                                                                          \
-        keyboard_report.body.keys[idx] = val;                                                      \
-        if (val) {                                                                                 \
-            break;                                                                                 \
-        }                                                                                          \
-    }
+BUILD_ASSERT(CONFIG_ZMK_HID_KEYBOARD_REPORT_SIZE < UINT8_MAX,
+             "HKRO report slots must be indexable by a uint8_t");
 
-#if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
-zmk_hid_boot_report_t *zmk_hid_get_boot_report(void) {
-    if (keys_held > HID_BOOT_KEY_LEN) {
-        return boot_report_rollover(keyboard_report.body.modifiers);
-    }
+#define HKRO_MAX_USAGE UINT8_MAX
+#define HKRO_SLOT_WORDS DIV_ROUND_UP(CONFIG_ZMK_HID_KEYBOARD_REPORT_SIZE, 32)
 
-#if CONFIG_ZMK_HID_KEYBOARD_REPORT_SIZE != HID_BOOT_KEY_LEN
-    // Form a boot report from a report of different size.
+// Slot of each usage in keyboard_report.body.keys plus one, or 0 if it isn't in the report, and a
+// bitmap of taken slots, so presses, releases and lookups don't scan the report.
+static uint8_t hkro_usage_slots[HKRO_MAX_USAGE + 1];
+static uint32_t hkro_taken_slots[HKRO_SLOT_WORDS];
+static uint8_t hkro_used_slots;
 
-    boot_report.modifiers = keyboard_report.body.modifiers;
+// Usages pressed while every slot was taken. They aren't in the report but still count towards
+// the boot report rollover, until they're released.
+static uint32_t hkro_overflowed[DIV_ROUND_UP(HKRO_MAX_USAGE + 1, 32)];
+
+static void hkro_reset(void) {
+    memset(hkro_usage_slots, 0, sizeof(hkro_usage_slots));
+    memset(hkro_taken_slots, 0, sizeof(hkro_taken_slots));
+    hkro_used_slots = 0;
+    memset(hkro_overflowed, 0, sizeof(hkro_overflowed));
+}
+
+// Takes the lowest empty slot, which is where a linear scan of the report would put the usage.
+static int hkro_take_free_slot(void) {
+    for (int i = 0; i < HKRO_SLOT_WORDS; i++) {
+        int bit = find_lsb_set(~hkro_taken_slots[i]);
+        if (bit == 0 || i * 32 + bit - 1 >= CONFIG_ZMK_HID_KEYBOARD_REPORT_SIZE) {
+            continue;
+        }
+
+        WRITE_BIT(hkro_taken_slots[i], bit - 1, 1);
+        return i * 32 + bit - 1;
+    }
+
+    return -ENOMEM;
+}
 
+#if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
+static void boot_report_rebuild(void) {
     int out = 0;
-    for (int i = 0; i < CONFIG_ZMK_HID_KEYBOARD_REPORT_SIZE; i++) {
+    for (int i = 0; i < CONFIG_ZMK_HID_KEYBOARD_REPORT_SIZE && out < keys_held; i++) {
         uint8_t key = keyboard_report.body.keys[i];
         if (key) {
             boot_report.keys[out++] = key;
-            if (out == keys_held) {
-                break;
-            }
         }
     }
 
     while (out < HID_BOOT_KEY_LEN) {
         boot_report.keys[out++] = 0;
     }
-
-    return &boot_report;
-#else
-    return &keyboard_report.body;
-#endif /* CONFIG_ZMK_HID_KEYBOARD_REPORT_SIZE != HID_BOOT_KEY_LEN */
 }
 #endif /* IS_ENABLED(CONFIG_ZMK_USB_BOOT) */
 
 static inline int select_keyboard_usage(zmk_key_t usage) {
-    TOGGLE_KEYBOARD(0U, usage);
+    if (usage == 0 || usage > HKRO_MAX_USAGE) {
+        return -EINVAL;
+    }
+
+    if (hkro_usage_slots[usage] || (hkro_overflowed[usage / 32] & BIT(usage % 32))) {
+        return 0;
+    }
+
+    int slot = hkro_take_free_slot();
+    if (slot < 0) {
+        LOG_DBG("No free slot for usage 0x%02X", usage);
+        WRITE_BIT(hkro_overflowed[usage / 32], usage % 32, 1);
+    } else {
+        keyboard_report.body.keys[slot] = usage;
+        hkro_usage_slots[usage] = slot + 1;
+        hkro_used_slots++;
+    }
+
 #if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
-    ++keys_held;
+    boot_report_select(usage);
 #endif
     return 0;
 }
 
 static inline int deselect_keyboard_usage(zmk_key_t usage) {
-    TOGGLE_KEYBOARD(usage, 0U);
+    if (usage == 0 || usage > HKRO_MAX_USAGE) {
+        return -EINVAL;
+    }
+
+    uint8_t slot = hkro_usage_slots[usage];
+    if (slot) {
+        keyboard_report.body.keys[slot - 1] = 0;
+        WRITE_BIT(hkro_taken_slots[(slot - 1) / 32], (slot - 1) % 32, 0);
+        hkro_usage_slots[usage] = 0;
+        hkro_used_slots--;
+    } else if (hkro_overflowed[usage / 32] & BIT(usage % 32)) {
+        WRITE_BIT(hkro_overflowed[usage / 32], usage % 32, 0);
+    } else {
+        return 0;
+    }
+
 #if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
-    --keys_held;
+    boot_report_deselect(usage);
 #endif
     return 0;
 }
 
 static inline int check_keyboard_usage(zmk_key_t usage) {
-    for (int idx = 0; idx < CONFIG_ZMK_HID_KEYBOARD_REPORT_SIZE; idx++) {
-        if (keyboard_report.body.keys[idx] == usage) {
-            return true;
-        }
+    if (usage > HKRO_MAX_USAGE) {
+        return false;
     }
-    return false;
+    return hkro_usage_slots[usage] != 0;
 }
 
 #else
@@ -307,14 +424,51 @@ bool zmk_hid_keyboard_is_pressed(zmk_key_t code) {
 
 void zmk_hid_keyboard_clear(void) {
     memset(&keyboard_report.body, 0, sizeof(keyboard_report.body));
+#if IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_HKRO)
+    hkro_reset();
+#endif
+#if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
+    boot_report_reset();
+#endif
 }
 
+#if IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP)
+
+BUILD_ASSERT(ZMK_HID_CONSUMER_BITMAP_MIN_USAGE <= ZMK_HID_CONSUMER_BITMAP_MAX_USAGE,
+             "Consumer bitmap usage range is empty");
+BUILD_ASSERT(!IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_USAGES_BASIC) ||
+                 ZMK_HID_CONSUMER_BITMAP_MAX_USAGE <= 0xFF,
+             "Basic consumer usages only go up to 0xFF");
+
+#define IS_CONSUMER_BITMAP_USAGE(code)                                                             \
+    ((code) >= ZMK_HID_CONSUMER_BITMAP_MIN_USAGE && (code) <= ZMK_HID_CONSUMER_BITMAP_MAX_USAGE)
+#define TOGGLE_CONSUMER_BITMAP(code, val)                                                          \
+    WRITE_BIT(consumer_report.body.bitmap[((code) - ZMK_HID_CONSUMER_BITMAP_MIN_USAGE) / 8],       \
+              ((code) - ZMK_HID_CONSUMER_BITMAP_MIN_USAGE) % 8, val)
+
+#else
+
+#define IS_CONSUMER_BITMAP_USAGE(code) false
+#define TOGGLE_CONSUMER_BITMAP(code, val)
+
+#endif // IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP)
+
 int zmk_hid_consumer_press(zmk_key_t code) {
+    if (IS_CONSUMER_BITMAP_USAGE(code)) {
+        TOGGLE_CONSUMER_BITMAP(code, 1);
+        return 0;
+    }
+
     TOGGLE_CONSUMER(0U, code);
     return 0;
 };
 
 int zmk_hid_consumer_release(zmk_key_t code) {
+    if (IS_CONSUMER_BITMAP_USAGE(code)) {
+        TOGGLE_CONSUMER_BITMAP(code, 0);
+        return 0;
+    }
+
     TOGGLE_CONSUMER(code, 0U);
     return 0;
 };
@@ -324,6 +478,13 @@ void zmk_hid_consumer_clear(void) {
 }
 
 bool zmk_hid_consumer_is_pressed(zmk_key_t key) {
+#if IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP)
+    if (IS_CONSUMER_BITMAP_USAGE(key)) {
+        key -= ZMK_HID_CONSUMER_BITMAP_MIN_USAGE;
+        return consumer_report.body.bitmap[key / 8] & BIT(key % 8);
+    }
+#endif // IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP)
+
     for (int idx = 0; idx < CONFIG_ZMK_HID_CONSUMER_REPORT_SIZE; idx++) {
         if (consumer_report.body.keys[idx] == key) {
             return true;
@@ -369,3 +530,75 @@ struct zmk_hid_keyboard_report *zmk_hid_get_keyboard_report(void) {
 struct zmk_hid_consumer_report *zmk_hid_get_consumer_report(void) {
     return &consumer_report;
 }
+
+const uint8_t *zmk_hid_get_report_desc(void) {
+    static uint8_t report_desc[ZMK_HID_REPORT_DESC_LEN];
+    static bool assembled = false;
+
+    // The collections can't be concatenated at build time, so do it on first use, which happens
+    // while initializing the transports.
+    if (!assembled) {
+        memcpy(report_desc, zmk_hid_keyboard_report_desc, sizeof(zmk_hid_keyboard_report_desc));
+        memcpy(report_desc + sizeof(zmk_hid_keyboard_report_desc), zmk_hid_consumer_report_desc,
+               sizeof(zmk_hid_consumer_report_desc));
+        assembled = true;
+    }
+
+    return report_desc;
+}
+
+#if CONFIG_ZMK_HID_KEYBOARD_REPORT_SNAPSHOTS > 0
+
+static struct zmk_hid_keyboard_report snapshots[CONFIG_ZMK_HID_KEYBOARD_REPORT_SNAPSHOTS];
+static uint8_t snapshot_refs[CONFIG_ZMK_HID_KEYBOARD_REPORT_SNAPSHOTS];
+static int latest_snapshot = -1;
+static struct k_spinlock snapshot_lock;
+
+int zmk_hid_keyboard_report_snapshot_take(void) {
+    k_spinlock_key_t key = k_spin_lock(&snapshot_lock);
+    int index = -ENOMEM;
+
+    if (latest_snapshot >= 0 && snapshot_refs[latest_snapshot] > 0 &&
+        snapshot_refs[latest_snapshot] < UINT8_MAX &&
+        memcmp(&snapshots[latest_snapshot], &keyboard_report, sizeof(keyboard_report)) == 0) {
+        index = latest_snapshot;
+        goto done;
+    }
+
+    // Search from the slot after the latest one, so a snapshot just released by a transport isn't
+    // immediately overwritten.
+    for (int i = 1; i <= CONFIG_ZMK_HID_KEYBOARD_REPORT_SNAPSHOTS; i++) {
+        int candidate = (latest_snapshot + i) % CONFIG_ZMK_HID_KEYBOARD_REPORT_SNAPSHOTS;
+        if (snapshot_refs[candidate] == 0) {
+            memcpy(&snapshots[candidate], &keyboard_report, sizeof(keyboard_report));
+            index = latest_snapshot = candidate;
+            goto done;
+        }
+    }
+
+done:
+    if (index >= 0) {
+        snapshot_refs[index]++;
+    }
+    k_spin_unlock(&snapshot_lock, key);
+
+    return index;
+}
+
+const struct zmk_hid_keyboard_report *zmk_hid_keyboard_report_snapshot_get(uint8_t index) {
+    return &snapshots[index];
+}
+
+void zmk_hid_keyboard_report_snapshot_release(uint8_t index) {
+    k_spinlock_key_t key = k_spin_lock(&snapshot_lock);
+
+    if (snapshot_refs[index] > 0) {
+        snapshot_refs[index]--;
+    } else {
+        LOG_WRN("Released unused keyboard report snapshot %d", index);
+    }
+
+    k_spin_unlock(&snapshot_lock, key);
+}
+
+#endif // CONFIG_ZMK_HID_KEYBOARD_REPORT_SNAPSHOTS > 0
@@ -13,6 +13,7 @@
 #include <zmk/events/hid_indicators_changed.h>
 #include <zmk/events/endpoint_changed.h>
 #include <zmk/split/bluetooth/central.h>
+#include <zmk/split/serial/central.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
@@ -35,6 +36,9 @@ static void raise_led_changed_event(struct k_work *_work) {
 #if IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS) && IS_ENABLED(CONFIG_ZMK_SPLIT_BLE)
     zmk_split_bt_update_hid_indicator(indicators);
 #endif
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS) && IS_ENABLED(CONFIG_ZMK_SPLIT_SERIAL)
+    zmk_split_serial_update_hid_indicator(indicators);
+#endif
 }
 
 static K_WORK_DEFINE(led_changed_work, raise_led_changed_event);
@@ -15,6 +15,114 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 #include <zmk/hid.h>
 #include <dt-bindings/zmk/hid_usage_pages.h>
 #include <zmk/endpoints.h>
+#include <zmk/endpoint_latency.h>
+#include <zmk/input_frame.h>
+#include <zmk/key_repeat.h>
+#include <zmk/profiling.h>
+#include <zmk/events/input_frame_state_changed.h>
+
+#if IS_ENABLED(CONFIG_ZMK_HID_COALESCE_FRAME_REPORTS)
+
+struct pending_report {
+    uint16_t usage_page;
+    bool press;
+    bool release;
+};
+
+// Flushed in this order, so keyboard reports carrying the modifiers for a consumer usage are
+// sent before the consumer report, matching the order of the undeferred code paths.
+static struct pending_report pending_reports[] = {
+    {.usage_page = HID_USAGE_KEY},
+    {.usage_page = HID_USAGE_CONSUMER},
+};
+
+static struct pending_report *get_pending_report(uint16_t usage_page) {
+    for (int i = 0; i < ARRAY_SIZE(pending_reports); i++) {
+        if (pending_reports[i].usage_page == usage_page) {
+            return &pending_reports[i];
+        }
+    }
+
+    return NULL;
+}
+
+static int flush_pending_report(struct pending_report *pending) {
+    if (!pending->press && !pending->release) {
+        return 0;
+    }
+
+    pending->press = false;
+    pending->release = false;
+    return zmk_endpoints_send_report(pending->usage_page);
+}
+
+static void flush_pending_reports(void) {
+    for (int i = 0; i < ARRAY_SIZE(pending_reports); i++) {
+        int err = flush_pending_report(&pending_reports[i]);
+        if (err < 0) {
+            LOG_ERR("Failed to send deferred report for usage page 0x%02X (%d)",
+                    pending_reports[i].usage_page, err);
+        }
+    }
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_HID_COALESCE_FRAME_REPORTS)
+
+/**
+ * Flush any deferred report for the usage page whose pending changes go in the opposite direction,
+ * so a press and release of the same usage within one frame are never merged into one report.
+ * Must be called before the HID state for the usage page is changed.
+ */
+static void prepare_report(uint16_t usage_page, bool press) {
+#if IS_ENABLED(CONFIG_ZMK_HID_COALESCE_FRAME_REPORTS)
+    struct pending_report *pending = get_pending_report(usage_page);
+
+    if (pending && (press ? pending->release : pending->press)) {
+        int err = flush_pending_report(pending);
+        if (err < 0) {
+            LOG_ERR("Failed to send deferred report for usage page 0x%02X (%d)", usage_page, err);
+        }
+    }
+#endif
+}
+
+/**
+ * Send a report for the usage page immediately, even while in an input frame. The report carries
+ * all changes made so far, so any deferred report for the usage page is dropped.
+ */
+static int send_report_now(uint16_t usage_page) {
+#if IS_ENABLED(CONFIG_ZMK_HID_COALESCE_FRAME_REPORTS)
+    struct pending_report *pending = get_pending_report(usage_page);
+
+    if (pending) {
+        pending->press = false;
+        pending->release = false;
+    }
+#endif
+
+    return zmk_endpoints_send_report(usage_page);
+}
+
+/**
+ * Send a report for the usage page, or, while in an input frame, mark it to be sent once the
+ * frame ends.
+ */
+static int send_report(uint16_t usage_page, bool press) {
+#if IS_ENABLED(CONFIG_ZMK_HID_COALESCE_FRAME_REPORTS)
+    struct pending_report *pending = get_pending_report(usage_page);
+
+    if (pending && zmk_input_frame_is_active()) {
+        if (press) {
+            pending->press = true;
+        } else {
+            pending->release = true;
+        }
+        return 0;
+    }
+#endif
+
+    return zmk_endpoints_send_report(usage_page);
+}
 
 static int hid_listener_keycode_pressed(const struct zmk_keycode_state_changed *ev) {
     int err, explicit_mods_changed, implicit_mods_changed;
@@ -23,12 +131,14 @@ static int hid_listener_keycode_pressed(const struct zmk_keycode_state_changed *
         zmk_hid_is_pressed(ZMK_HID_USAGE(ev->usage_page, ev->keycode))) {
         LOG_DBG("unregistering usage_page 0x%02X keycode 0x%02X since it was already pressed",
                 ev->usage_page, ev->keycode);
+        prepare_report(ev->usage_page, false);
         err = zmk_hid_release(ZMK_HID_USAGE(ev->usage_page, ev->keycode));
         if (err < 0) {
             LOG_DBG("Unable to pre-release keycode (%d)", err);
             return err;
         }
-        err = zmk_endpoints_send_report(ev->usage_page);
+        // The host must see the release before the following press, so this is never deferred.
+        err = send_report_now(ev->usage_page);
         if (err < 0) {
             LOG_ERR("Failed to send key report for pre-releasing keycode (%d)", err);
         }
@@ -36,6 +146,8 @@ static int hid_listener_keycode_pressed(const struct zmk_keycode_state_changed *
 
     LOG_DBG("usage_page 0x%02X keycode 0x%02X implicit_mods 0x%02X explicit_mods 0x%02X",
             ev->usage_page, ev->keycode, ev->implicit_modifiers, ev->explicit_modifiers);
+    prepare_report(HID_USAGE_KEY, true);
+    prepare_report(ev->usage_page, true);
     err = zmk_hid_press(ZMK_HID_USAGE(ev->usage_page, ev->keycode));
     if (err < 0) {
         LOG_DBG("Unable to press keycode");
@@ -45,14 +157,14 @@ static int hid_listener_keycode_pressed(const struct zmk_keycode_state_changed *
     implicit_mods_changed = zmk_hid_implicit_modifiers_press(ev->implicit_modifiers);
     if (ev->usage_page != HID_USAGE_KEY &&
         (explicit_mods_changed > 0 || implicit_mods_changed > 0)) {
-        err = zmk_endpoints_send_report(HID_USAGE_KEY);
+        err = send_report(HID_USAGE_KEY, true);
         if (err < 0) {
             LOG_ERR("Failed to send key report for changed mofifiers for consumer page event (%d)",
                     err);
         }
     }
 
-    return zmk_endpoints_send_report(ev->usage_page);
+    return send_report(ev->usage_page, true);
 }
 
 static int hid_listener_keycode_released(const struct zmk_keycode_state_changed *ev) {
@@ -60,23 +172,26 @@ static int hid_listener_keycode_released(const struct zmk_keycode_state_changed
 
     LOG_DBG("usage_page 0x%02X keycode 0x%02X implicit_mods 0x%02X explicit_mods 0x%02X",
             ev->usage_page, ev->keycode, ev->implicit_modifiers, ev->explicit_modifiers);
+    prepare_report(HID_USAGE_KEY, false);
+    prepare_report(ev->usage_page, false);
     err = zmk_hid_release(ZMK_HID_USAGE(ev->usage_page, ev->keycode));
     if (err < 0) {
         LOG_DBG("Unable to release keycode");
         return err;
     }
 
-#if IS_ENABLED(CONFIG_ZMK_HID_SEPARATE_MOD_RELEASE_REPORT)
-
     // send report of normal key release early to fix the issue
-    // of some programs recognizing the implicit_mod release before the actual key release
-    err = zmk_endpoints_send_report(ev->usage_page);
-    if (err < 0) {
-        LOG_ERR("Failed to send key report for the released keycode (%d)", err);
+    // of some programs recognizing the implicit_mod release before the actual key release.
+    // This intermediate report is the point of the option, so it is never deferred. It is only
+    // needed when modifiers are about to change, and only for hosts that need it.
+    if ((ev->explicit_modifiers || ev->implicit_modifiers) &&
+        zmk_endpoints_separate_mod_release()) {
+        err = send_report_now(ev->usage_page);
+        if (err < 0) {
+            LOG_ERR("Failed to send key report for the released keycode (%d)", err);
+        }
     }
 
-#endif // IS_ENABLED(CONFIG_ZMK_HID_SEPARATE_MOD_RELEASE_REPORT)
-
     explicit_mods_changed = zmk_hid_unregister_mods(ev->explicit_modifiers);
     // There is a minor issue with this code.
     // If LC(A) is pressed, then LS(B), then LC(A) is released, the shift for B will be released
@@ -87,26 +202,44 @@ static int hid_listener_keycode_released(const struct zmk_keycode_state_changed
 
     if (ev->usage_page != HID_USAGE_KEY &&
         (explicit_mods_changed > 0 || implicit_mods_changed > 0)) {
-        err = zmk_endpoints_send_report(HID_USAGE_KEY);
+        err = send_report(HID_USAGE_KEY, false);
         if (err < 0) {
             LOG_ERR("Failed to send key report for changed mofifiers for consumer page event (%d)",
                     err);
         }
     }
-    return zmk_endpoints_send_report(ev->usage_page);
+    return send_report(ev->usage_page, false);
 }
 
 int hid_listener(const zmk_event_t *eh) {
     const struct zmk_keycode_state_changed *ev = as_zmk_keycode_state_changed(eh);
     if (ev) {
+        zmk_endpoint_latency_set_origin(ev->timestamp);
+        zmk_profiling_mark(ZMK_PROFILING_HID_LISTENER);
+
         if (ev->state) {
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_KEY_REPEAT)
+            zmk_key_repeat_record_press(ev);
+#endif
             hid_listener_keycode_pressed(ev);
         } else {
             hid_listener_keycode_released(ev);
         }
+        return 0;
     }
+
+#if IS_ENABLED(CONFIG_ZMK_HID_COALESCE_FRAME_REPORTS)
+    const struct zmk_input_frame_state_changed *frame_ev = as_zmk_input_frame_state_changed(eh);
+    if (frame_ev && !frame_ev->active) {
+        flush_pending_reports();
+    }
+#endif
+
     return 0;
 }
 
 ZMK_LISTENER(hid_listener, hid_listener);
 ZMK_SUBSCRIPTION(hid_listener, zmk_keycode_state_changed);
+#if IS_ENABLED(CONFIG_ZMK_HID_COALESCE_FRAME_REPORTS)
+ZMK_SUBSCRIPTION(hid_listener, zmk_input_frame_state_changed);
+#endif
@@ -4,23 +4,42 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <string.h>
+
 #include <zephyr/settings/settings.h>
 #include <zephyr/init.h>
+#include <zephyr/sys/crc.h>
 
 #include <zephyr/logging/log.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
 #include <zephyr/bluetooth/gatt.h>
 
 #include <zmk/ble.h>
+#include <zmk/behavior_queue.h>
+#include <zmk/endpoint_latency.h>
 #include <zmk/endpoints_types.h>
 #include <zmk/hog.h>
+#include <zmk/pm.h>
+#include <zmk/power_stats.h>
+#include <zmk/profiling.h>
 #include <zmk/hid.h>
+#include <zmk/boot_timing.h>
+#include <zmk/resource_stats.h>
+#include <zmk/workqueue.h>
 #if IS_ENABLED(CONFIG_ZMK_HID_INDICATORS)
 #include <zmk/hid_indicators.h>
 #endif // IS_ENABLED(CONFIG_ZMK_HID_INDICATORS)
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+#include <zmk/mouse/hid.h>
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE)
+
+#if IS_ENABLED(CONFIG_ZMK_BLE_QUEUE_STATS)
+#include <zephyr/shell/shell.h>
+#endif
 
 enum {
     HIDS_REMOTE_WAKE = BIT(0),
@@ -87,8 +106,18 @@ static ssize_t read_hids_report_ref(struct bt_conn *conn, const struct bt_gatt_a
 
 static ssize_t read_hids_report_map(struct bt_conn *conn, const struct bt_gatt_attr *attr,
                                     void *buf, uint16_t len, uint16_t offset) {
-    return bt_gatt_attr_read(conn, attr, buf, len, offset, zmk_hid_report_desc,
-                             sizeof(zmk_hid_report_desc));
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, zmk_hid_get_report_desc(),
+                             ZMK_HID_REPORT_DESC_LEN);
+}
+
+uint32_t zmk_hog_report_map_hash(void) {
+    uint32_t hash = crc32_ieee(zmk_hid_get_report_desc(), ZMK_HID_REPORT_DESC_LEN);
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+    hash = crc32_ieee_update(hash, zmk_mouse_hid_report_desc, sizeof(zmk_mouse_hid_report_desc));
+#endif
+
+    return hash;
 }
 
 static ssize_t read_hids_input_report(struct bt_conn *conn, const struct bt_gatt_attr *attr,
@@ -110,7 +139,7 @@ static ssize_t write_hids_leds_report(struct bt_conn *conn, const struct bt_gatt
     }
 
     struct zmk_hid_led_report_body *report = (struct zmk_hid_led_report_body *)buf;
-    int profile = zmk_ble_profile_index(bt_conn_get_dst(conn));
+    int profile = zmk_ble_profile_index_for_conn(conn);
     if (profile < 0) {
         return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
     }
@@ -194,12 +223,18 @@ BT_GATT_SERVICE_DEFINE(
     BT_GATT_CHARACTERISTIC(BT_UUID_HIDS_CTRL_POINT, BT_GATT_CHRC_WRITE_WITHOUT_RESP,
                            BT_GATT_PERM_WRITE, NULL, write_ctrl_point, &ctrl_point));
 
-static struct bt_conn *destination_connection(void) {
+// The profile new reports are sent to. Each queued report keeps the profile it was queued for, so
+// the reports releasing keys on the previous host still reach it after the target changes.
+static uint8_t target_profile;
+
+void zmk_hog_set_target_profile(uint8_t index) { target_profile = index; }
+
+static struct bt_conn *destination_connection(uint8_t profile) {
     struct bt_conn *conn;
-    bt_addr_le_t *addr = zmk_ble_active_profile_addr();
+    bt_addr_le_t *addr = zmk_ble_profile_addr(profile);
     LOG_DBG("Address pointer %p", addr);
-    if (!bt_addr_le_cmp(addr, BT_ADDR_LE_ANY)) {
-        LOG_WRN("Not sending, no active address for current profile");
+    if (addr == NULL || !bt_addr_le_cmp(addr, BT_ADDR_LE_ANY)) {
+        LOG_WRN("Not sending, no address for profile %d", profile);
         return NULL;
     } else if ((conn = bt_conn_lookup_addr_le(BT_ID_DEFAULT, addr)) == NULL) {
         LOG_WRN("Not sending, not connected to active profile");
@@ -213,45 +248,377 @@ K_THREAD_STACK_DEFINE(hog_q_stack, CONFIG_ZMK_BLE_THREAD_STACK_SIZE);
 
 static struct k_work_q hog_work_q;
 
-K_MSGQ_DEFINE(zmk_hog_keyboard_msgq, sizeof(struct zmk_hid_keyboard_report_body),
+ZMK_STACK_STATS_DEFINE(hog_work_q, hog_q_stack, "BLE notify");
+ZMK_WORKQUEUE_REGISTER(hog_work_q, "BLE notify", ZMK_WORKQUEUE_LATENCY_TRANSPORT);
+
+ZMK_QUEUE_STATS_DEFINE(keyboard_queue_stats, "BLE keyboard reports",
+                       CONFIG_ZMK_BLE_KEYBOARD_REPORT_QUEUE_SIZE);
+ZMK_QUEUE_STATS_DEFINE(consumer_queue_stats, "BLE consumer reports",
+                       CONFIG_ZMK_BLE_CONSUMER_REPORT_QUEUE_SIZE);
+
+struct hog_keyboard_msg {
+#if CONFIG_ZMK_HID_KEYBOARD_REPORT_SNAPSHOTS > 0
+    // Queue snapshot indices rather than whole reports, and notify straight from the snapshot.
+    uint8_t snapshot;
+#else
+    struct zmk_hid_keyboard_report_body body;
+#endif
+    uint8_t profile;
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+    uint32_t origin;
+#endif
+};
+
+struct hog_consumer_msg {
+    struct zmk_hid_consumer_report_body body;
+    uint8_t profile;
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+    uint32_t origin;
+#endif
+};
+
+void send_keyboard_report_callback(struct k_work *work);
+void send_consumer_report_callback(struct k_work *work);
+
+K_WORK_DEFINE(hog_keyboard_work, send_keyboard_report_callback);
+K_WORK_DEFINE(hog_consumer_work, send_consumer_report_callback);
+
+static void hog_resume_sending(void) {
+    k_work_submit_to_queue(&hog_work_q, &hog_keyboard_work);
+    k_work_submit_to_queue(&hog_work_q, &hog_consumer_work);
+}
+
+static void hog_retry_work_handler(struct k_work *work) { hog_resume_sending(); }
+
+static K_WORK_DELAYABLE_DEFINE(hog_retry_work, hog_retry_work_handler);
+
+#define HOG_NOTIFY_RETRY_MS 10
+
+// Notifications handed to the controller that haven't been sent yet, per connection. Sending
+// stops once a connection runs out of credits, and resumes as notifications complete, so bursts
+// wait in the report queues where they can be coalesced instead of failing in the controller.
+static atomic_t notifies_in_flight[CONFIG_BT_MAX_CONN];
+
+// Set when a connection drops, so the next reports aren't coalesced against what the old host saw.
+static atomic_t last_reports_stale;
+
+static bool hog_take_credit(struct bt_conn *conn) {
+    atomic_t *in_flight = &notifies_in_flight[bt_conn_index(conn)];
+
+    if (atomic_inc(in_flight) >= CONFIG_ZMK_BLE_NOTIFY_CREDITS) {
+        atomic_dec(in_flight);
+        return false;
+    }
+
+    return true;
+}
+
+static void hog_return_credit(struct bt_conn *conn) {
+    atomic_t *in_flight = &notifies_in_flight[bt_conn_index(conn)];
+    atomic_val_t val;
+
+    // Completions for a connection that has since dropped must not push the count below zero.
+    do {
+        val = atomic_get(in_flight);
+        if (val <= 0) {
+            return;
+        }
+    } while (!atomic_cas(in_flight, val, val - 1));
+}
+
+static bool hog_conn_connected(struct bt_conn *conn) {
+    struct bt_conn_info info;
+
+    return bt_conn_get_info(conn, &info) == 0 && info.state == BT_CONN_STATE_CONNECTED;
+}
+
+static void hog_notify_sent(struct bt_conn *conn, void *user_data) {
+    // Completions flushed after a disconnect belong to the old connection, and must not hand a
+    // credit to the next connection that takes this slot.
+    if (hog_conn_connected(conn)) {
+        hog_return_credit(conn);
+    }
+    zmk_endpoint_latency_record(ZMK_TRANSPORT_BLE, POINTER_TO_UINT(user_data));
+    zmk_profiling_transport_done();
+    hog_resume_sending();
+    zmk_behavior_queue_report_delivered();
+}
+
+static void hog_connected(struct bt_conn *conn, uint8_t err) {
+    if (err == 0) {
+        // A new connection in this slot starts with every credit.
+        atomic_clear(&notifies_in_flight[bt_conn_index(conn)]);
+    }
+}
+
+static void hog_disconnected(struct bt_conn *conn, uint8_t reason) {
+    atomic_clear(&notifies_in_flight[bt_conn_index(conn)]);
+    atomic_set(&last_reports_stale, true);
+}
+
+BT_CONN_CB_DEFINE(hog_conn_callbacks) = {
+    .connected = hog_connected,
+    .disconnected = hog_disconnected,
+};
+
+/*
+ * Notify the report to the connection, using up one of its credits. Returns -EAGAIN if the report
+ * couldn't be handed to the controller yet and should be retried, and 0 once it was either sent
+ * or dropped.
+ */
+static int hog_notify(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *data,
+                      uint16_t len, uint32_t origin) {
+    if (!hog_take_credit(conn)) {
+        // One of the notifications in flight completes soon and resumes sending.
+        return -EAGAIN;
+    }
+
+    struct bt_gatt_notify_params notify_params = {
+        .attr = attr,
+        .data = data,
+        .len = len,
+        .func = hog_notify_sent,
+        .user_data = UINT_TO_POINTER(origin),
+    };
+
+    int err = bt_gatt_notify_cb(conn, &notify_params);
+    if (err == 0) {
+        zmk_power_stats_record(ZMK_POWER_STATS_BLE_REPORT);
+        return 0;
+    }
+
+    hog_return_credit(conn);
+
+    switch (err) {
+    case -ENOMEM:
+    case -ENOBUFS:
+        // Buffers are shared with other traffic, so don't rely on a completion of our own.
+        k_work_schedule_for_queue(&hog_work_q, &hog_retry_work, K_MSEC(HOG_NOTIFY_RETRY_MS));
+        return -EAGAIN;
+    case -EPERM:
+        bt_conn_set_security(conn, BT_SECURITY_L2);
+        return err;
+    default:
+        LOG_DBG("Error notifying %d", err);
+        return err;
+    }
+}
+
+/*
+ * A queued report can be skipped if every usage slot in it matches either the report before it or
+ * the one after it. Each slot then changes at most once across the three reports, so skipping the
+ * middle one can't hide a press or a release from the host.
+ */
+static bool hog_report_is_redundant(const uint8_t *prev, const uint8_t *report, const uint8_t *next,
+                                    size_t len, size_t usage_size) {
+    for (size_t i = 0; i < len; i += usage_size) {
+        size_t size = MIN(usage_size, len - i);
+        if (memcmp(&report[i], &prev[i], size) != 0 && memcmp(&report[i], &next[i], size) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static uint32_t hog_keyboard_msg_origin(const struct hog_keyboard_msg *msg) {
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+    return msg->origin;
+#else
+    return 0;
+#endif
+}
+
+static uint32_t hog_consumer_msg_origin(const struct hog_consumer_msg *msg) {
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+    return msg->origin;
+#else
+    return 0;
+#endif
+}
+
+K_MSGQ_DEFINE(zmk_hog_keyboard_msgq, sizeof(struct hog_keyboard_msg),
               CONFIG_ZMK_BLE_KEYBOARD_REPORT_QUEUE_SIZE, 4);
 
+// The report waiting for a credit, kept out of the queue so newer reports can replace it.
+static struct hog_keyboard_msg keyboard_pending;
+static bool has_keyboard_pending;
+// The last report sent, and the profile it was sent to.
+static struct zmk_hid_keyboard_report_body keyboard_last;
+static uint8_t keyboard_last_profile;
+static bool has_keyboard_last;
+
+static void hog_keyboard_msg_release(struct hog_keyboard_msg *msg) {
+#if CONFIG_ZMK_HID_KEYBOARD_REPORT_SNAPSHOTS > 0
+    zmk_hid_keyboard_report_snapshot_release(msg->snapshot);
+#endif
+}
+
+static const struct zmk_hid_keyboard_report_body *
+hog_keyboard_msg_body(const struct hog_keyboard_msg *msg) {
+#if CONFIG_ZMK_HID_KEYBOARD_REPORT_SNAPSHOTS > 0
+    return &zmk_hid_keyboard_report_snapshot_get(msg->snapshot)->body;
+#else
+    return &msg->body;
+#endif
+}
+
+static bool hog_keyboard_next(void) {
+    struct hog_keyboard_msg next;
+
+    if (!has_keyboard_pending) {
+        if (k_msgq_get(&zmk_hog_keyboard_msgq, &keyboard_pending, K_NO_WAIT) != 0) {
+            return false;
+        }
+        has_keyboard_pending = true;
+    }
+
+    while (has_keyboard_last && keyboard_last_profile == keyboard_pending.profile &&
+           k_msgq_peek(&zmk_hog_keyboard_msgq, &next) == 0 &&
+           next.profile == keyboard_pending.profile &&
+           hog_report_is_redundant((const uint8_t *)&keyboard_last,
+                                   (const uint8_t *)hog_keyboard_msg_body(&keyboard_pending),
+                                   (const uint8_t *)hog_keyboard_msg_body(&next),
+                                   sizeof(keyboard_last), 1)) {
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+        // The replacement also carries the older event, so measure from that one.
+        uint32_t origin = keyboard_pending.origin;
+#endif
+        hog_keyboard_msg_release(&keyboard_pending);
+        k_msgq_get(&zmk_hog_keyboard_msgq, &keyboard_pending, K_NO_WAIT);
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+        keyboard_pending.origin = origin;
+#endif
+    }
+
+    return true;
+}
+
+static void hog_keyboard_pending_release(void) {
+    hog_keyboard_msg_release(&keyboard_pending);
+    has_keyboard_pending = false;
+}
+
+K_MSGQ_DEFINE(zmk_hog_consumer_msgq, sizeof(struct hog_consumer_msg),
+              CONFIG_ZMK_BLE_CONSUMER_REPORT_QUEUE_SIZE, 4);
+
+static struct hog_consumer_msg consumer_pending;
+static bool has_consumer_pending;
+static struct zmk_hid_consumer_report_body consumer_last;
+static uint8_t consumer_last_profile;
+static bool has_consumer_last;
+
+static bool hog_consumer_next(void) {
+    struct hog_consumer_msg next;
+
+    if (!has_consumer_pending) {
+        if (k_msgq_get(&zmk_hog_consumer_msgq, &consumer_pending, K_NO_WAIT) != 0) {
+            return false;
+        }
+        has_consumer_pending = true;
+    }
+
+    while (has_consumer_last && consumer_last_profile == consumer_pending.profile &&
+           k_msgq_peek(&zmk_hog_consumer_msgq, &next) == 0 &&
+           next.profile == consumer_pending.profile &&
+           hog_report_is_redundant((const uint8_t *)&consumer_last,
+                                   (const uint8_t *)&consumer_pending.body,
+                                   (const uint8_t *)&next.body, sizeof(consumer_last),
+                                   sizeof(consumer_last.keys[0]))) {
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+        uint32_t origin = consumer_pending.origin;
+#endif
+        k_msgq_get(&zmk_hog_consumer_msgq, &consumer_pending, K_NO_WAIT);
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+        consumer_pending.origin = origin;
+#endif
+    }
+
+    return true;
+}
+
+static void hog_check_last_reports(void) {
+    if (atomic_cas(&last_reports_stale, true, false)) {
+        has_keyboard_last = false;
+        has_consumer_last = false;
+    }
+}
+
 void send_keyboard_report_callback(struct k_work *work) {
-    struct zmk_hid_keyboard_report_body report;
+    hog_check_last_reports();
 
-    while (k_msgq_get(&zmk_hog_keyboard_msgq, &report, K_NO_WAIT) == 0) {
-        struct bt_conn *conn = destination_connection();
+    while (hog_keyboard_next()) {
+        struct bt_conn *conn = destination_connection(keyboard_pending.profile);
         if (conn == NULL) {
+            hog_keyboard_pending_release();
             return;
         }
 
-        struct bt_gatt_notify_params notify_params = {
-            .attr = &hog_svc.attrs[5],
-            .data = &report,
-            .len = sizeof(report),
-        };
-
-        int err = bt_gatt_notify_cb(conn, &notify_params);
-        if (err == -EPERM) {
-            bt_conn_set_security(conn, BT_SECURITY_L2);
-        } else if (err) {
-            LOG_DBG("Error notifying %d", err);
+        const struct zmk_hid_keyboard_report_body *body = hog_keyboard_msg_body(&keyboard_pending);
+        int err = hog_notify(conn, &hog_svc.attrs[5], body, sizeof(*body),
+                             hog_keyboard_msg_origin(&keyboard_pending));
+        bt_conn_unref(conn);
+
+        if (err == -EAGAIN) {
+            return;
         }
 
-        bt_conn_unref(conn);
+        if (err == 0) {
+            keyboard_last = *body;
+            keyboard_last_profile = keyboard_pending.profile;
+            has_keyboard_last = true;
+        }
+
+        hog_keyboard_pending_release();
     }
 }
 
-K_WORK_DEFINE(hog_keyboard_work, send_keyboard_report_callback);
+static int hog_drop_oldest_keyboard_report(void) {
+    struct hog_keyboard_msg discarded;
+    int err = k_msgq_get(&zmk_hog_keyboard_msgq, &discarded, K_NO_WAIT);
+    if (err == 0) {
+        hog_keyboard_msg_release(&discarded);
+    }
+
+    return err;
+}
 
 int zmk_hog_send_keyboard_report(struct zmk_hid_keyboard_report_body *report) {
-    int err = k_msgq_put(&zmk_hog_keyboard_msgq, report, K_MSEC(100));
+    struct hog_keyboard_msg msg = {.profile = target_profile};
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+    msg.origin = zmk_endpoint_latency_origin();
+#endif
+
+#if CONFIG_ZMK_HID_KEYBOARD_REPORT_SNAPSHOTS > 0
+    // Snapshots always capture the current keyboard report.
+    __ASSERT_NO_MSG(report == &zmk_hid_get_keyboard_report()->body);
+
+    int index = zmk_hid_keyboard_report_snapshot_take();
+    if (index < 0) {
+        LOG_WRN("No free keyboard report snapshot, dropping the oldest queued report");
+        if (hog_drop_oldest_keyboard_report() != 0) {
+            return index;
+        }
+
+        index = zmk_hid_keyboard_report_snapshot_take();
+        if (index < 0) {
+            return index;
+        }
+    }
+    msg.snapshot = index;
+#else
+    msg.body = *report;
+#endif
+
+    int err = k_msgq_put(&zmk_hog_keyboard_msgq, &msg, K_MSEC(100));
     if (err) {
+        hog_keyboard_msg_release(&msg);
+
         switch (err) {
         case -EAGAIN: {
             LOG_WRN("Keyboard message queue full, popping first message and queueing again");
-            struct zmk_hid_keyboard_report_body discarded_report;
-            k_msgq_get(&zmk_hog_keyboard_msgq, &discarded_report, K_NO_WAIT);
+            zmk_queue_stats_overflowed(&keyboard_queue_stats);
+            hog_drop_oldest_keyboard_report();
             return zmk_hog_send_keyboard_report(report);
         }
         default:
@@ -260,50 +627,55 @@ int zmk_hog_send_keyboard_report(struct zmk_hid_keyboard_report_body *report) {
         }
     }
 
+    zmk_queue_stats_queued(&keyboard_queue_stats, k_msgq_num_used_get(&zmk_hog_keyboard_msgq));
     k_work_submit_to_queue(&hog_work_q, &hog_keyboard_work);
 
     return 0;
 };
 
-K_MSGQ_DEFINE(zmk_hog_consumer_msgq, sizeof(struct zmk_hid_consumer_report_body),
-              CONFIG_ZMK_BLE_CONSUMER_REPORT_QUEUE_SIZE, 4);
-
 void send_consumer_report_callback(struct k_work *work) {
-    struct zmk_hid_consumer_report_body report;
+    hog_check_last_reports();
 
-    while (k_msgq_get(&zmk_hog_consumer_msgq, &report, K_NO_WAIT) == 0) {
-        struct bt_conn *conn = destination_connection();
+    while (hog_consumer_next()) {
+        struct bt_conn *conn = destination_connection(consumer_pending.profile);
         if (conn == NULL) {
+            has_consumer_pending = false;
             return;
         }
 
-        struct bt_gatt_notify_params notify_params = {
-            .attr = &hog_svc.attrs[9],
-            .data = &report,
-            .len = sizeof(report),
-        };
-
-        int err = bt_gatt_notify_cb(conn, &notify_params);
-        if (err == -EPERM) {
-            bt_conn_set_security(conn, BT_SECURITY_L2);
-        } else if (err) {
-            LOG_DBG("Error notifying %d", err);
+        int err = hog_notify(conn, &hog_svc.attrs[9], &consumer_pending.body,
+                             sizeof(consumer_pending.body),
+                             hog_consumer_msg_origin(&consumer_pending));
+        bt_conn_unref(conn);
+
+        if (err == -EAGAIN) {
+            return;
         }
 
-        bt_conn_unref(conn);
+        if (err == 0) {
+            consumer_last = consumer_pending.body;
+            consumer_last_profile = consumer_pending.profile;
+            has_consumer_last = true;
+        }
+
+        has_consumer_pending = false;
     }
 };
 
-K_WORK_DEFINE(hog_consumer_work, send_consumer_report_callback);
-
 int zmk_hog_send_consumer_report(struct zmk_hid_consumer_report_body *report) {
-    int err = k_msgq_put(&zmk_hog_consumer_msgq, report, K_MSEC(100));
+    struct hog_consumer_msg msg = {.body = *report, .profile = target_profile};
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+    msg.origin = zmk_endpoint_latency_origin();
+#endif
+
+    int err = k_msgq_put(&zmk_hog_consumer_msgq, &msg, K_MSEC(100));
     if (err) {
         switch (err) {
         case -EAGAIN: {
             LOG_WRN("Consumer message queue full, popping first message and queueing again");
-            struct zmk_hid_consumer_report_body discarded_report;
-            k_msgq_get(&zmk_hog_consumer_msgq, &discarded_report, K_NO_WAIT);
+            zmk_queue_stats_overflowed(&consumer_queue_stats);
+            struct hog_consumer_msg discarded;
+            k_msgq_get(&zmk_hog_consumer_msgq, &discarded, K_NO_WAIT);
             return zmk_hog_send_consumer_report(report);
         }
         default:
@@ -312,11 +684,30 @@ int zmk_hog_send_consumer_report(struct zmk_hid_consumer_report_body *report) {
         }
     }
 
+    zmk_queue_stats_queued(&consumer_queue_stats, k_msgq_num_used_get(&zmk_hog_consumer_msgq));
     k_work_submit_to_queue(&hog_work_q, &hog_consumer_work);
 
     return 0;
 };
 
+bool zmk_hog_is_idle(void) {
+    if (has_keyboard_pending || has_consumer_pending ||
+        k_msgq_num_used_get(&zmk_hog_keyboard_msgq) > 0 ||
+        k_msgq_num_used_get(&zmk_hog_consumer_msgq) > 0) {
+        return false;
+    }
+
+    for (int i = 0; i < ARRAY_SIZE(notifies_in_flight); i++) {
+        if (atomic_get(&notifies_in_flight[i]) > 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+ZMK_PM_FLUSH_DEFINE(hog, zmk_hog_is_idle);
+
 static int zmk_hog_init(void) {
     static const struct k_work_queue_config queue_config = {.name = "HID Over GATT Send Work"};
     k_work_queue_start(&hog_work_q, hog_q_stack, K_THREAD_STACK_SIZEOF(hog_q_stack),
@@ -325,4 +716,68 @@ static int zmk_hog_init(void) {
     return 0;
 }
 
-SYS_INIT(zmk_hog_init, APPLICATION, CONFIG_ZMK_BLE_INIT_PRIORITY);
+ZMK_SYS_INIT(zmk_hog_init, APPLICATION, CONFIG_ZMK_BLE_INIT_PRIORITY);
+
+#if IS_ENABLED(CONFIG_ZMK_BLE_QUEUE_STATS)
+
+// Leave a quarter on top of what was seen, since the shell only sees the load of one session.
+#define HOG_RECOMMENDED_SIZE(used) ((used) + DIV_ROUND_UP((used), 4))
+
+static void print_queue_stats(const struct shell *sh, const char *name,
+                              struct zmk_queue_stats *stats, uint32_t size) {
+    uint32_t high_water = atomic_get(&stats->high_water);
+    uint32_t dropped = atomic_get(&stats->overflows);
+
+    shell_print(sh, "%s queue: %u of %u used at most, %u dropped", name, high_water, size, dropped);
+
+    if (dropped > 0) {
+        shell_print(sh, "  Recommended size: more than %u", size);
+    } else {
+        shell_print(sh, "  Recommended size: %u", MAX(HOG_RECOMMENDED_SIZE(high_water), 1));
+    }
+}
+
+static int cmd_ble_queue_stats(const struct shell *sh, size_t argc, char **argv) {
+    size_t unused;
+    int err = k_thread_stack_space_get(&hog_work_q.thread, &unused);
+
+    if (err) {
+        shell_error(sh, "Failed to get the notify thread stack usage (%d)", err);
+    } else {
+        size_t size = K_THREAD_STACK_SIZEOF(hog_q_stack);
+        size_t used = size - unused;
+
+        shell_print(sh, "Notify thread stack: %zu of %zu bytes used at most", used, size);
+        shell_print(sh, "  Recommended CONFIG_ZMK_BLE_THREAD_STACK_SIZE: %zu",
+                    ROUND_UP(HOG_RECOMMENDED_SIZE(used), 64));
+    }
+
+    print_queue_stats(sh, "Keyboard", &keyboard_queue_stats,
+                      CONFIG_ZMK_BLE_KEYBOARD_REPORT_QUEUE_SIZE);
+    print_queue_stats(sh, "Consumer", &consumer_queue_stats,
+                      CONFIG_ZMK_BLE_CONSUMER_REPORT_QUEUE_SIZE);
+
+    return 0;
+}
+
+static int cmd_ble_queue_reset(const struct shell *sh, size_t argc, char **argv) {
+    atomic_clear(&keyboard_queue_stats.high_water);
+    atomic_clear(&keyboard_queue_stats.overflows);
+    atomic_clear(&consumer_queue_stats.high_water);
+    atomic_clear(&consumer_queue_stats.overflows);
+
+    shell_print(sh, "BLE report queue statistics reset");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_ble_queues,
+                               SHELL_CMD(stats, NULL,
+                                         "Show notify thread stack and report queue usage",
+                                         cmd_ble_queue_stats),
+                               SHELL_CMD(reset, NULL, "Reset report queue statistics",
+                                         cmd_ble_queue_reset),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((zmk), ble_queues, &sub_ble_queues, "BLE HID report queues", NULL, 0, 0);
+
+#endif // IS_ENABLED(CONFIG_ZMK_BLE_QUEUE_STATS)
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/input_frame.h>
+#include <zmk/event_manager.h>
+#include <zmk/events/input_frame_state_changed.h>
+
+static uint8_t frame_depth;
+
+void zmk_input_frame_begin(void) {
+    if (frame_depth++ > 0) {
+        return;
+    }
+
+    raise_zmk_input_frame_state_changed(
+        (struct zmk_input_frame_state_changed){.active = true, .timestamp = k_uptime_get()});
+}
+
+void zmk_input_frame_end(void) {
+    if (frame_depth == 0) {
+        LOG_WRN("Ending an input frame that was never started");
+        return;
+    }
+
+    if (--frame_depth > 0) {
+        return;
+    }
+
+    raise_zmk_input_frame_state_changed(
+        (struct zmk_input_frame_state_changed){.active = false, .timestamp = k_uptime_get()});
+}
+
+bool zmk_input_frame_is_active(void) { return frame_depth > 0; }
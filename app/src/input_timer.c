@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/dlist.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/input_timer.h>
+#include <zmk/workqueue.h>
+
+// Pending timers, sorted by deadline. Timers with equal deadlines run in the order they were
+// started.
+static sys_dlist_t pending_timers = SYS_DLIST_STATIC_INIT(&pending_timers);
+
+static bool dispatching;
+
+static void input_timer_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(input_timer_work, input_timer_work_handler);
+
+static void update_input_timer_work(void) {
+    struct zmk_input_timer *first = SYS_DLIST_PEEK_HEAD_CONTAINER(&pending_timers, first, node);
+
+    if (first == NULL) {
+        k_work_cancel_delayable(&input_timer_work);
+        return;
+    }
+
+    int64_t ms_left = first->deadline - k_uptime_get();
+    k_work_reschedule_for_queue(zmk_workqueue_input_work_q(), &input_timer_work,
+                                K_MSEC(MAX(ms_left, 0)));
+}
+
+static void input_timer_work_handler(struct k_work *work) {
+    int64_t now = k_uptime_get();
+
+    dispatching = true;
+
+    // Handlers may start or stop other timers, so take the first expired timer off the list on
+    // each pass rather than iterating over it.
+    struct zmk_input_timer *timer;
+    while ((timer = SYS_DLIST_PEEK_HEAD_CONTAINER(&pending_timers, timer, node)) != NULL &&
+           timer->deadline <= now) {
+        sys_dlist_remove(&timer->node);
+        timer->handler(timer);
+    }
+
+    dispatching = false;
+
+    update_input_timer_work();
+}
+
+void zmk_input_timer_init(struct zmk_input_timer *timer, zmk_input_timer_handler_t handler) {
+    sys_dnode_init(&timer->node);
+    timer->deadline = 0;
+    timer->handler = handler;
+}
+
+void zmk_input_timer_start(struct zmk_input_timer *timer, int64_t deadline) {
+    if (sys_dnode_is_linked(&timer->node)) {
+        sys_dlist_remove(&timer->node);
+    }
+
+    timer->deadline = deadline;
+
+    struct zmk_input_timer *next;
+    SYS_DLIST_FOR_EACH_CONTAINER(&pending_timers, next, node) {
+        if (next->deadline > deadline) {
+            sys_dlist_insert(&next->node, &timer->node);
+            break;
+        }
+    }
+
+    if (!sys_dnode_is_linked(&timer->node)) {
+        sys_dlist_append(&pending_timers, &timer->node);
+    }
+
+    if (!dispatching) {
+        update_input_timer_work();
+    }
+}
+
+void zmk_input_timer_stop(struct zmk_input_timer *timer) {
+    if (!sys_dnode_is_linked(&timer->node)) {
+        return;
+    }
+
+    sys_dlist_remove(&timer->node);
+
+    if (!dispatching) {
+        update_input_timer_work();
+    }
+}
+
+bool zmk_input_timer_is_pending(const struct zmk_input_timer *timer) {
+    return sys_dnode_is_linked(&timer->node);
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdlib.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/shell/shell.h>
+
+#include <zmk/input_frame.h>
+#include <zmk/key_inject.h>
+#include <zmk/matrix.h>
+#include <zmk/position_state.h>
+#include <zmk/resource_stats.h>
+#include <zmk/workqueue.h>
+#include <zmk/events/position_state_changed.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+// Enough for a host to queue a tap, with room to spare for a slow input work queue.
+#define KEY_INJECT_QUEUE_SIZE 8
+
+struct key_inject_event {
+    int64_t timestamp;
+    uint32_t position;
+    bool pressed;
+};
+
+K_MSGQ_DEFINE(key_inject_msgq, sizeof(struct key_inject_event), KEY_INJECT_QUEUE_SIZE, 8);
+ZMK_QUEUE_STATS_DEFINE(key_inject_queue_stats, "Injected keys", KEY_INJECT_QUEUE_SIZE);
+
+static void key_inject_work_handler(struct k_work *work) {
+    struct key_inject_event ev;
+
+    zmk_input_frame_begin();
+
+    while (k_msgq_get(&key_inject_msgq, &ev, K_NO_WAIT) == 0) {
+        LOG_DBG("Injected position: %d, pressed: %s", ev.position, (ev.pressed ? "true" : "false"));
+        zmk_position_state_update(ev.position, ev.pressed);
+        raise_zmk_position_state_changed(
+            (struct zmk_position_state_changed){.source = ZMK_POSITION_STATE_CHANGE_SOURCE_LOCAL,
+                                                .state = ev.pressed,
+                                                .position = ev.position,
+                                                .timestamp = ev.timestamp});
+    }
+
+    zmk_input_frame_end();
+}
+
+static K_WORK_DEFINE(key_inject_work, key_inject_work_handler);
+
+int zmk_key_inject(uint32_t position, bool pressed) {
+    struct key_inject_event ev = {
+        .timestamp = k_uptime_get(),
+        .position = position,
+        .pressed = pressed,
+    };
+
+    if (position >= ZMK_KEYMAP_LEN) {
+        return -EINVAL;
+    }
+
+    if (k_msgq_put(&key_inject_msgq, &ev, K_NO_WAIT) != 0) {
+        zmk_queue_stats_overflowed(&key_inject_queue_stats);
+        LOG_WRN("Injected key queue full, dropped position %d", position);
+        return -ENOMEM;
+    }
+
+    zmk_queue_stats_queued(&key_inject_queue_stats, k_msgq_num_used_get(&key_inject_msgq));
+    k_work_submit_to_queue(zmk_workqueue_input_work_q(), &key_inject_work);
+
+    return 0;
+}
+
+#if IS_ENABLED(CONFIG_SHELL)
+
+static int cmd_inject_key(const struct shell *sh, char **argv, bool pressed) {
+    char *end;
+    unsigned long position = strtoul(argv[1], &end, 10);
+
+    if (*end != '\0') {
+        shell_error(sh, "Invalid position %s", argv[1]);
+        return -EINVAL;
+    }
+
+    int err = zmk_key_inject(position, pressed);
+    if (err) {
+        shell_error(sh, "Failed to inject position %lu: %d", position, err);
+    }
+
+    return err;
+}
+
+static int cmd_inject_press(const struct shell *sh, size_t argc, char **argv) {
+    return cmd_inject_key(sh, argv, true);
+}
+
+static int cmd_inject_release(const struct shell *sh, size_t argc, char **argv) {
+    return cmd_inject_key(sh, argv, false);
+}
+
+// Lets a host time the round trip of a command, to take it out of its latency measurements.
+static int cmd_inject_ping(const struct shell *sh, size_t argc, char **argv) {
+    shell_print(sh, "pong");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_inject,
+                               SHELL_CMD_ARG(press, NULL, "Press a key position", cmd_inject_press,
+                                             2, 0),
+                               SHELL_CMD_ARG(release, NULL, "Release a key position",
+                                             cmd_inject_release, 2, 0),
+                               SHELL_CMD(ping, NULL, "Reply with pong", cmd_inject_ping),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((zmk), inject, &sub_inject, "Inject key events", NULL, 0, 0);
+
+#endif // IS_ENABLED(CONFIG_SHELL)
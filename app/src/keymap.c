@@ -4,7 +4,13 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <drivers/behavior.h>
+#include <zephyr/init.h>
+#include <zephyr/settings/settings.h>
 #include <zephyr/sys/util.h>
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/logging/log.h>
@@ -13,7 +19,9 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 #include <zmk/behavior.h>
 #include <zmk/keymap.h>
 #include <zmk/matrix.h>
+#include <zmk/profiling.h>
 #include <zmk/sensors.h>
+#include <zmk/settings.h>
 #include <zmk/virtual_key_position.h>
 
 #include <zmk/ble.h>
@@ -21,10 +29,23 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 #include <zmk/split/bluetooth/central.h>
 #endif
 
+#define ZMK_SERIAL_IS_CENTRAL                                                                      \
+    (IS_ENABLED(CONFIG_ZMK_SPLIT) && IS_ENABLED(CONFIG_ZMK_SPLIT_SERIAL) &&                        \
+     IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL))
+
+#if ZMK_SERIAL_IS_CENTRAL
+#include <zmk/split/central.h>
+#include <zmk/split/serial/serial.h>
+#endif
+
 #include <zmk/event_manager.h>
 #include <zmk/events/position_state_changed.h>
 #include <zmk/events/layer_state_changed.h>
 #include <zmk/events/sensor_event.h>
+#include <zmk/boot_timing.h>
+
+BUILD_ASSERT(ZMK_KEYMAP_LAYERS_LEN <= ZMK_KEYMAP_LAYER_STATE_BITS,
+             "Too many layers for the layer state, enable CONFIG_ZMK_KEYMAP_LAYER_STATE_64");
 
 static zmk_keymap_layers_state_t _zmk_keymap_layer_state = 0;
 static uint8_t _zmk_keymap_layer_default = 0;
@@ -40,6 +61,27 @@ static uint8_t _zmk_keymap_layer_default = 0;
 #define TRANSFORMED_LAYER(node)                                                                    \
     { LISTIFY(DT_PROP_LEN(node, bindings), ZMK_KEYMAP_EXTRACT_BINDING, (, ), node) }
 
+#define _TRANSPARENT_ENTRY(idx, layer)                                                             \
+    DT_NODE_HAS_COMPAT(DT_PHANDLE_BY_IDX(layer, bindings, idx), zmk_behavior_transparent)
+
+#define TRANSPARENT_LAYER(node)                                                                    \
+    { LISTIFY(DT_PROP_LEN(node, bindings), _TRANSPARENT_ENTRY, (, ), node) }
+
+#define _PACKED_ENTRY(idx, layer)                                                                  \
+    COND_CODE_1(_TRANSPARENT_ENTRY(idx, layer), (), (ZMK_KEYMAP_EXTRACT_BINDING(idx, layer), ))
+
+#define PACKED_LAYER(node) LISTIFY(DT_PROP_LEN(node, bindings), _PACKED_ENTRY, (), node)
+
+#define _BEHAVIOR_ENTRY(idx, layer) DEVICE_DT_GET(DT_PHANDLE_BY_IDX(layer, bindings, idx))
+
+#define BEHAVIOR_LAYER(node) { LISTIFY(DT_PROP_LEN(node, bindings), _BEHAVIOR_ENTRY, (, ), node) }
+
+#define _PACKED_BEHAVIOR_ENTRY(idx, layer)                                                         \
+    COND_CODE_1(_TRANSPARENT_ENTRY(idx, layer), (), (_BEHAVIOR_ENTRY(idx, layer), ))
+
+#define PACKED_BEHAVIOR_LAYER(node)                                                                \
+    LISTIFY(DT_PROP_LEN(node, bindings), _PACKED_BEHAVIOR_ENTRY, (), node)
+
 #if ZMK_KEYMAP_HAS_SENSORS
 #define _TRANSFORM_SENSOR_ENTRY(idx, layer)                                                        \
     {                                                                                              \
@@ -65,10 +107,89 @@ static uint8_t _zmk_keymap_layer_default = 0;
 // When a behavior handles a key position "down" event, we record the layer state
 // here so that even if that layer is deactivated before the "up", event, we
 // still send the release event to the behavior in that layer also.
-static uint32_t zmk_keymap_active_behavior_layer[ZMK_KEYMAP_LEN];
+static zmk_keymap_layers_state_t zmk_keymap_active_behavior_layer[ZMK_KEYMAP_LEN];
+
+// The highest layer that was searched for a behavior when each key position was pressed, so the
+// release starts from the same layer.
+static uint8_t zmk_keymap_active_behavior_top_layer[ZMK_KEYMAP_LEN];
+
+// For each key position, the highest active layer that isn't bound to &trans. Layers above it
+// would only fall through, so presses start searching for a behavior there. Kept up to date as
+// layers are activated and deactivated.
+static uint8_t zmk_keymap_effective_layer[ZMK_KEYMAP_LEN];
+
+#if IS_ENABLED(CONFIG_ZMK_KEYMAP_SPARSE)
+
+// The bindings of every layer that aren't &trans, in layer and position order.
+static const struct zmk_behavior_binding zmk_keymap_packed[] = {
+    DT_INST_FOREACH_CHILD(0, PACKED_LAYER)};
+
+#define KEYMAP_BITMAP_WORDS DIV_ROUND_UP(ZMK_KEYMAP_LEN, 32)
 
+// For each layer, a bitmap of the positions that have a binding in zmk_keymap_packed, and the
+// index in zmk_keymap_packed of the first binding in each word of the bitmap.
+static uint32_t zmk_keymap_bound[ZMK_KEYMAP_LAYERS_LEN][KEYMAP_BITMAP_WORDS];
+static uint16_t zmk_keymap_packed_rank[ZMK_KEYMAP_LAYERS_LEN][KEYMAP_BITMAP_WORDS];
+
+#if IS_ENABLED(CONFIG_ZMK_KEYMAP_STATIC_BEHAVIORS)
+
+// Behavior devices for the bindings in zmk_keymap_packed.
+static const struct device *const zmk_keymap_behaviors[] = {
+    DT_INST_FOREACH_CHILD(0, PACKED_BEHAVIOR_LAYER)};
+
+#else
+
+// Behavior devices for the bindings in zmk_keymap_packed, resolved on first use so key presses
+// don't need to look the behavior up by name.
+static const struct device *zmk_keymap_behaviors[ARRAY_SIZE(zmk_keymap_packed)];
+
+#endif // IS_ENABLED(CONFIG_ZMK_KEYMAP_STATIC_BEHAVIORS)
+
+#else
+
+#if IS_ENABLED(CONFIG_ZMK_KEYMAP_RUNTIME)
 static struct zmk_behavior_binding zmk_keymap[ZMK_KEYMAP_LAYERS_LEN][ZMK_KEYMAP_LEN] = {
     DT_INST_FOREACH_CHILD_SEP(0, TRANSFORMED_LAYER, (, ))};
+#else
+static const struct zmk_behavior_binding zmk_keymap[ZMK_KEYMAP_LAYERS_LEN][ZMK_KEYMAP_LEN] = {
+    DT_INST_FOREACH_CHILD_SEP(0, TRANSFORMED_LAYER, (, ))};
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_KEYMAP_STATIC_BEHAVIORS)
+
+// Behavior devices for the bindings in zmk_keymap.
+static const struct device *const zmk_keymap_behaviors[ZMK_KEYMAP_LAYERS_LEN][ZMK_KEYMAP_LEN] = {
+    DT_INST_FOREACH_CHILD_SEP(0, BEHAVIOR_LAYER, (, ))};
+
+#else
+
+// Behavior devices for the bindings in zmk_keymap, resolved on first use so key presses don't
+// need to look the behavior up by name.
+static const struct device *zmk_keymap_behaviors[ZMK_KEYMAP_LAYERS_LEN][ZMK_KEYMAP_LEN];
+
+#endif // IS_ENABLED(CONFIG_ZMK_KEYMAP_STATIC_BEHAVIORS)
+
+#endif // IS_ENABLED(CONFIG_ZMK_KEYMAP_SPARSE)
+
+#if IS_ENABLED(CONFIG_ZMK_KEYMAP_RUNTIME)
+
+// The devicetree keymap, which only bindings that differ from it are saved against.
+static const struct zmk_behavior_binding
+    zmk_keymap_defaults[ZMK_KEYMAP_LAYERS_LEN][ZMK_KEYMAP_LEN] = {
+        DT_INST_FOREACH_CHILD_SEP(0, TRANSFORMED_LAYER, (, ))};
+
+// Bindings are edited from other threads than the one processing key presses.
+static struct k_spinlock keymap_lock;
+
+static bool zmk_keymap_transparent[ZMK_KEYMAP_LAYERS_LEN][ZMK_KEYMAP_LEN] = {
+    DT_INST_FOREACH_CHILD_SEP(0, TRANSPARENT_LAYER, (, ))};
+
+#else
+
+static const bool zmk_keymap_transparent[ZMK_KEYMAP_LAYERS_LEN][ZMK_KEYMAP_LEN] = {
+    DT_INST_FOREACH_CHILD_SEP(0, TRANSPARENT_LAYER, (, ))};
+
+#endif // IS_ENABLED(CONFIG_ZMK_KEYMAP_RUNTIME)
 
 static const char *zmk_keymap_layer_names[ZMK_KEYMAP_LAYERS_LEN] = {
     DT_INST_FOREACH_CHILD_SEP(0, LAYER_NAME, (, ))};
@@ -79,8 +200,120 @@ static struct zmk_behavior_binding
     zmk_sensor_keymap[ZMK_KEYMAP_LAYERS_LEN][ZMK_KEYMAP_SENSORS_LEN] = {
         DT_INST_FOREACH_CHILD_SEP(0, SENSOR_LAYER, (, ))};
 
+// Behavior devices for the bindings in zmk_sensor_keymap, resolved once at boot.
+static const struct device
+    *zmk_sensor_keymap_behaviors[ZMK_KEYMAP_LAYERS_LEN][ZMK_KEYMAP_SENSORS_LEN];
+
+// For each sensor, the layers that have a behavior bound to it. Sensor events skip the others.
+static zmk_keymap_layers_state_t zmk_sensor_keymap_layers[ZMK_KEYMAP_SENSORS_LEN];
+
 #endif /* ZMK_KEYMAP_HAS_SENSORS */
 
+#if IS_ENABLED(CONFIG_ZMK_KEYMAP_SPARSE)
+
+static int keymap_sparse_init(void) {
+    uint16_t index = 0;
+
+    for (int layer = 0; layer < ZMK_KEYMAP_LAYERS_LEN; layer++) {
+        for (uint32_t position = 0; position < ZMK_KEYMAP_LEN; position++) {
+            if (position % 32 == 0) {
+                zmk_keymap_packed_rank[layer][position / 32] = index;
+            }
+
+            if (!zmk_keymap_transparent[layer][position]) {
+                zmk_keymap_bound[layer][position / 32] |= BIT(position % 32);
+                index++;
+            }
+        }
+    }
+
+    __ASSERT(index == ARRAY_SIZE(zmk_keymap_packed), "Packed keymap doesn't match the layers");
+
+    return 0;
+}
+
+SYS_INIT(keymap_sparse_init, PRE_KERNEL_1, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
+
+static const struct device *load_keymap_binding(int layer, uint32_t position,
+                                                struct zmk_behavior_binding *binding) {
+    uint32_t word = zmk_keymap_bound[layer][position / 32];
+
+    if ((word & BIT(position % 32)) == 0) {
+        return NULL;
+    }
+
+    uint16_t index = zmk_keymap_packed_rank[layer][position / 32] +
+                     __builtin_popcount(word & BIT_MASK(position % 32));
+
+    *binding = zmk_keymap_packed[index];
+#if !IS_ENABLED(CONFIG_ZMK_KEYMAP_STATIC_BEHAVIORS)
+    if (zmk_keymap_behaviors[index] == NULL) {
+        zmk_keymap_behaviors[index] = zmk_behavior_get_binding(binding->behavior_dev);
+    }
+#endif
+
+    return zmk_keymap_behaviors[index];
+}
+
+#else
+
+static const struct device *get_keymap_behavior(int layer, uint32_t position) {
+#if IS_ENABLED(CONFIG_ZMK_KEYMAP_STATIC_BEHAVIORS)
+    return zmk_keymap_behaviors[layer][position];
+#else
+    const struct device **behavior = &zmk_keymap_behaviors[layer][position];
+
+    if (*behavior == NULL) {
+        *behavior = zmk_behavior_get_binding(zmk_keymap[layer][position].behavior_dev);
+    }
+
+    return *behavior;
+#endif
+}
+
+static const struct device *load_keymap_binding(int layer, uint32_t position,
+                                                struct zmk_behavior_binding *binding) {
+#if IS_ENABLED(CONFIG_ZMK_KEYMAP_RUNTIME)
+    k_spinlock_key_t key = k_spin_lock(&keymap_lock);
+#endif
+
+    *binding = zmk_keymap[layer][position];
+    const struct device *behavior = get_keymap_behavior(layer, position);
+
+#if IS_ENABLED(CONFIG_ZMK_KEYMAP_RUNTIME)
+    k_spin_unlock(&keymap_lock, key);
+#endif
+
+    return behavior;
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_KEYMAP_SPARSE)
+
+static uint8_t find_effective_layer(uint32_t position, int top_layer) {
+    for (int layer = top_layer; layer > _zmk_keymap_layer_default; layer--) {
+        if ((_zmk_keymap_layer_state & ZMK_KEYMAP_LAYER_BIT(layer)) &&
+            !zmk_keymap_transparent[layer][position]) {
+            return layer;
+        }
+    }
+
+    return _zmk_keymap_layer_default;
+}
+
+static void update_effective_layers(uint8_t layer, bool state) {
+    for (uint32_t position = 0; position < ZMK_KEYMAP_LEN; position++) {
+        uint8_t effective_layer = zmk_keymap_effective_layer[position];
+
+        if (state) {
+            if (layer > effective_layer && !zmk_keymap_transparent[layer][position]) {
+                zmk_keymap_effective_layer[position] = layer;
+            }
+        } else if (layer == effective_layer) {
+            zmk_keymap_effective_layer[position] = find_effective_layer(position, layer - 1);
+        }
+    }
+}
+
 static inline int set_layer_state(uint8_t layer, bool state) {
     int ret = 0;
     if (layer >= ZMK_KEYMAP_LAYERS_LEN) {
@@ -93,11 +326,16 @@ static inline int set_layer_state(uint8_t layer, bool state) {
     }
 
     zmk_keymap_layers_state_t old_state = _zmk_keymap_layer_state;
-    WRITE_BIT(_zmk_keymap_layer_state, layer, state);
+    if (state) {
+        _zmk_keymap_layer_state |= ZMK_KEYMAP_LAYER_BIT(layer);
+    } else {
+        _zmk_keymap_layer_state &= ~ZMK_KEYMAP_LAYER_BIT(layer);
+    }
     // Don't send state changes unless there was an actual change
     if (old_state != _zmk_keymap_layer_state) {
+        update_effective_layers(layer, state);
         LOG_DBG("layer_changed: layer %d state %d", layer, state);
-        ret = raise_layer_state_changed(layer, state);
+        ret = raise_layer_state_changed(layer, state, old_state, _zmk_keymap_layer_state);
         if (ret < 0) {
             LOG_WRN("Failed to raise layer state changed (%d)", ret);
         }
@@ -113,7 +351,7 @@ zmk_keymap_layers_state_t zmk_keymap_layer_state(void) { return _zmk_keymap_laye
 bool zmk_keymap_layer_active_with_state(uint8_t layer, zmk_keymap_layers_state_t state_to_test) {
     // The default layer is assumed to be ALWAYS ACTIVE so we include an || here to ensure nobody
     // breaks up that assumption by accident
-    return (state_to_test & (BIT(layer))) == (BIT(layer)) || layer == _zmk_keymap_layer_default;
+    return (state_to_test & ZMK_KEYMAP_LAYER_BIT(layer)) != 0 || layer == _zmk_keymap_layer_default;
 };
 
 bool zmk_keymap_layer_active(uint8_t layer) {
@@ -121,12 +359,8 @@ bool zmk_keymap_layer_active(uint8_t layer) {
 };
 
 uint8_t zmk_keymap_highest_layer_active(void) {
-    for (uint8_t layer = ZMK_KEYMAP_LAYERS_LEN - 1; layer > 0; layer--) {
-        if (zmk_keymap_layer_active(layer)) {
-            return layer;
-        }
-    }
-    return zmk_keymap_layer_default();
+    return zmk_keymap_layer_state_highest(_zmk_keymap_layer_state |
+                                          ZMK_KEYMAP_LAYER_BIT(_zmk_keymap_layer_default));
 }
 
 int zmk_keymap_layer_activate(uint8_t layer) { return set_layer_state(layer, true); };
@@ -141,18 +375,66 @@ int zmk_keymap_layer_toggle(uint8_t layer) {
     return zmk_keymap_layer_activate(layer);
 };
 
+int zmk_keymap_layer_state_set(zmk_keymap_layers_state_t state) {
+#if ZMK_KEYMAP_LAYERS_LEN < ZMK_KEYMAP_LAYER_STATE_BITS
+    if ((state & ~(ZMK_KEYMAP_LAYER_BIT(ZMK_KEYMAP_LAYERS_LEN) - 1)) != 0) {
+        return -EINVAL;
+    }
+#endif
+
+    zmk_keymap_layers_state_t old_state = _zmk_keymap_layer_state;
+
+    // Default layer should *always* remain active
+    state |= old_state & ZMK_KEYMAP_LAYER_BIT(_zmk_keymap_layer_default);
+
+    zmk_keymap_layers_state_t changed = old_state ^ state;
+    if (changed == 0) {
+        return 0;
+    }
+
+    _zmk_keymap_layer_state = state;
+
+    for (uint32_t position = 0; position < ZMK_KEYMAP_LEN; position++) {
+        zmk_keymap_effective_layer[position] =
+            find_effective_layer(position, ZMK_KEYMAP_LAYERS_LEN - 1);
+    }
+
+    // Log deactivated layers before activated ones, each from the highest down, which is the
+    // order a layer-to change used to apply them one at a time.
+    for (int layer = ZMK_KEYMAP_LAYERS_LEN - 1; layer >= 0; layer--) {
+        if ((changed & old_state & ZMK_KEYMAP_LAYER_BIT(layer)) != 0U) {
+            LOG_DBG("layer_changed: layer %d state %d", layer, 0);
+        }
+    }
+    for (int layer = ZMK_KEYMAP_LAYERS_LEN - 1; layer >= 0; layer--) {
+        if ((changed & state & ZMK_KEYMAP_LAYER_BIT(layer)) != 0U) {
+            LOG_DBG("layer_changed: layer %d state %d", layer, 1);
+        }
+    }
+
+    uint8_t layer = zmk_keymap_layer_state_highest(changed);
+    bool layer_state = (state & ZMK_KEYMAP_LAYER_BIT(layer)) != 0;
+
+    int ret = raise_layer_state_changed(layer, layer_state, old_state, state);
+    if (ret < 0) {
+        LOG_WRN("Failed to raise layer state changed (%d)", ret);
+    }
+
+    return ret;
+}
+
 int zmk_keymap_layer_to(uint8_t layer) {
-    for (int i = ZMK_KEYMAP_LAYERS_LEN - 1; i >= 0; i--) {
-        zmk_keymap_layer_deactivate(i);
+    if (layer >= ZMK_KEYMAP_LAYERS_LEN) {
+        return -EINVAL;
     }
 
-    zmk_keymap_layer_activate(layer);
+    zmk_keymap_layer_state_set(ZMK_KEYMAP_LAYER_BIT(layer));
 
     return 0;
 }
 
 bool is_active_layer(uint8_t layer, zmk_keymap_layers_state_t layer_state) {
-    return (layer_state & BIT(layer)) == BIT(layer) || layer == _zmk_keymap_layer_default;
+    return (layer_state & ZMK_KEYMAP_LAYER_BIT(layer)) != 0 || layer == _zmk_keymap_layer_default;
 }
 
 const char *zmk_keymap_layer_name(uint8_t layer) {
@@ -166,6 +448,7 @@ const char *zmk_keymap_layer_name(uint8_t layer) {
 int invoke_locally(struct zmk_behavior_binding *binding, struct zmk_behavior_binding_event event,
                    bool pressed) {
     if (pressed) {
+        zmk_profiling_mark(ZMK_PROFILING_BEHAVIOR_PRESS);
         return behavior_keymap_binding_pressed(binding, event);
     } else {
         return behavior_keymap_binding_released(binding, event);
@@ -176,8 +459,8 @@ int zmk_keymap_apply_position_state(uint8_t source, int layer, uint32_t position
                                     int64_t timestamp) {
     // We want to make a copy of this, since it may be converted from
     // relative to absolute before being invoked
-    struct zmk_behavior_binding binding = zmk_keymap[layer][position];
-    const struct device *behavior;
+    struct zmk_behavior_binding binding;
+    const struct device *behavior = load_keymap_binding(layer, position, &binding);
     struct zmk_behavior_binding_event event = {
         .layer = layer,
         .position = position,
@@ -186,21 +469,22 @@ int zmk_keymap_apply_position_state(uint8_t source, int layer, uint32_t position
 
     LOG_DBG("layer: %d position: %d, binding name: %s", layer, position, binding.behavior_dev);
 
-    behavior = zmk_behavior_get_binding(binding.behavior_dev);
-
     if (!behavior) {
         LOG_WRN("No behavior assigned to %d on layer %d", position, layer);
         return 1;
     }
 
-    int err = behavior_keymap_binding_convert_central_state_dependent_params(&binding, event);
-    if (err) {
-        LOG_ERR("Failed to convert relative to absolute behavior binding (err %d)", err);
-        return err;
+    if (behavior_has_central_state_dependent_params(behavior)) {
+        int err = behavior_keymap_binding_convert_central_state_dependent_params(&binding, event);
+        if (err) {
+            LOG_ERR("Failed to convert relative to absolute behavior binding (err %d)", err);
+            return err;
+        }
     }
 
+#if ZMK_BLE_IS_CENTRAL || ZMK_SERIAL_IS_CENTRAL
     enum behavior_locality locality = BEHAVIOR_LOCALITY_CENTRAL;
-    err = behavior_get_locality(behavior, &locality);
+    int err = behavior_get_locality(behavior, &locality);
     if (err) {
         LOG_ERR("Failed to get behavior locality %d", err);
         return err;
@@ -210,33 +494,221 @@ int zmk_keymap_apply_position_state(uint8_t source, int layer, uint32_t position
     case BEHAVIOR_LOCALITY_CENTRAL:
         return invoke_locally(&binding, event, pressed);
     case BEHAVIOR_LOCALITY_EVENT_SOURCE:
-#if ZMK_BLE_IS_CENTRAL
         if (source == ZMK_POSITION_STATE_CHANGE_SOURCE_LOCAL) {
             return invoke_locally(&binding, event, pressed);
         } else {
             return zmk_split_invoke_behavior(source, &binding, event, pressed);
         }
-#else
-        return invoke_locally(&binding, event, pressed);
-#endif
     case BEHAVIOR_LOCALITY_GLOBAL:
 #if ZMK_BLE_IS_CENTRAL
         for (int i = 0; i < ZMK_SPLIT_BLE_PERIPHERAL_COUNT; i++) {
             zmk_split_invoke_behavior(i, &binding, event, pressed);
         }
+#elif ZMK_SERIAL_IS_CENTRAL
+        for (int i = 0; i < ZMK_SPLIT_SERIAL_PERIPHERAL_COUNT; i++) {
+            zmk_split_invoke_behavior(i, &binding, event, pressed);
+        }
 #endif
         return invoke_locally(&binding, event, pressed);
     }
 
     return -ENOTSUP;
+#else
+    // Without peripherals to forward to, every locality runs the behavior here.
+    return invoke_locally(&binding, event, pressed);
+#endif
+}
+
+#if IS_ENABLED(CONFIG_ZMK_KEYMAP_RUNTIME)
+
+#if DT_HAS_COMPAT_STATUS_OKAY(zmk_behavior_transparent)
+#define TRANSPARENT_BEHAVIOR DEVICE_DT_GET(DT_COMPAT_GET_ANY_STATUS_OKAY(zmk_behavior_transparent))
+#else
+#define TRANSPARENT_BEHAVIOR NULL
+#endif
+
+struct keymap_binding_setting {
+    uint16_t behavior_id;
+    uint32_t param1;
+    uint32_t param2;
+} __packed;
+
+static bool binding_is_default(uint8_t layer, uint32_t position) {
+    const struct zmk_behavior_binding *binding = &zmk_keymap[layer][position];
+    const struct zmk_behavior_binding *default_binding = &zmk_keymap_defaults[layer][position];
+
+    return strcmp(binding->behavior_dev, default_binding->behavior_dev) == 0 &&
+           binding->param1 == default_binding->param1 && binding->param2 == default_binding->param2;
+}
+
+// Called with keymap_lock held.
+static void apply_keymap_binding_locked(uint8_t layer, uint32_t position,
+                                        const struct device *behavior, uint32_t param1,
+                                        uint32_t param2) {
+    zmk_keymap[layer][position] = (struct zmk_behavior_binding){
+        .behavior_dev = behavior->name,
+        .param1 = param1,
+        .param2 = param2,
+    };
+    zmk_keymap_behaviors[layer][position] = behavior;
+    zmk_keymap_transparent[layer][position] = (behavior == TRANSPARENT_BEHAVIOR);
+    zmk_keymap_effective_layer[position] =
+        find_effective_layer(position, ZMK_KEYMAP_LAYERS_LEN - 1);
+}
+
+static void apply_keymap_binding(uint8_t layer, uint32_t position, const struct device *behavior,
+                                 uint32_t param1, uint32_t param2) {
+    k_spinlock_key_t key = k_spin_lock(&keymap_lock);
+    apply_keymap_binding_locked(layer, position, behavior, param1, param2);
+    k_spin_unlock(&keymap_lock, key);
+}
+
+#if IS_ENABLED(CONFIG_SETTINGS)
+
+static void save_keymap_binding(uint8_t layer, uint32_t position) {
+    char name[32];
+
+    snprintf(name, sizeof(name), "keymap/bindings/%u/%u", layer, position);
+
+    if (binding_is_default(layer, position)) {
+        zmk_settings_delete(name);
+        return;
+    }
+
+    const struct zmk_behavior_binding *binding = &zmk_keymap[layer][position];
+    struct keymap_binding_setting setting = {
+        .behavior_id = zmk_behavior_get_id(binding->behavior_dev),
+        .param1 = binding->param1,
+        .param2 = binding->param2,
+    };
+
+    zmk_settings_save(name, &setting, sizeof(setting));
+}
+
+#else
+
+static void save_keymap_binding(uint8_t layer, uint32_t position) {}
+
+#endif // IS_ENABLED(CONFIG_SETTINGS)
+
+int zmk_keymap_get_binding(uint8_t layer, uint32_t position, struct zmk_behavior_binding *binding,
+                           bool *modified) {
+    if (layer >= ZMK_KEYMAP_LAYERS_LEN || position >= ZMK_KEYMAP_LEN) {
+        return -EINVAL;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&keymap_lock);
+
+    *binding = zmk_keymap[layer][position];
+    if (modified != NULL) {
+        *modified = !binding_is_default(layer, position);
+    }
+
+    k_spin_unlock(&keymap_lock, key);
+
+    return 0;
+}
+
+int zmk_keymap_set_binding(uint8_t layer, uint32_t position,
+                           const struct zmk_behavior_binding *binding) {
+    if (layer >= ZMK_KEYMAP_LAYERS_LEN || position >= ZMK_KEYMAP_LEN) {
+        return -EINVAL;
+    }
+
+    const struct device *behavior = zmk_behavior_get_binding(binding->behavior_dev);
+    if (behavior == NULL) {
+        LOG_WRN("Unknown behavior %s", binding->behavior_dev);
+        return -ENODEV;
+    }
+
+    LOG_DBG("layer: %d position: %d, binding name: %s", layer, position, behavior->name);
+
+    apply_keymap_binding(layer, position, behavior, binding->param1, binding->param2);
+    save_keymap_binding(layer, position);
+
+    return 0;
+}
+
+int zmk_keymap_set_bindings(const struct zmk_keymap_binding_change *changes, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (changes[i].layer >= ZMK_KEYMAP_LAYERS_LEN || changes[i].position >= ZMK_KEYMAP_LEN) {
+            return -EINVAL;
+        }
+
+        if (zmk_behavior_get_binding(changes[i].binding.behavior_dev) == NULL) {
+            LOG_WRN("Unknown behavior %s", changes[i].binding.behavior_dev);
+            return -ENODEV;
+        }
+    }
+
+    // Every change is applied under the one lock, so no key press sees only some of them.
+    k_spinlock_key_t key = k_spin_lock(&keymap_lock);
+
+    for (size_t i = 0; i < len; i++) {
+        const struct zmk_keymap_binding_change *change = &changes[i];
+
+        apply_keymap_binding_locked(change->layer, change->position,
+                                    zmk_behavior_get_binding(change->binding.behavior_dev),
+                                    change->binding.param1, change->binding.param2);
+    }
+
+    k_spin_unlock(&keymap_lock, key);
+
+    LOG_DBG("Applied %zu binding changes", len);
+
+    for (size_t i = 0; i < len; i++) {
+        save_keymap_binding(changes[i].layer, changes[i].position);
+    }
+
+    // Write the whole change as one batch now, rather than leaving part of it to a later write.
+    zmk_settings_save_flush();
+
+    return 0;
 }
 
+int zmk_keymap_reset_binding(uint8_t layer, uint32_t position) {
+    if (layer >= ZMK_KEYMAP_LAYERS_LEN || position >= ZMK_KEYMAP_LEN) {
+        return -EINVAL;
+    }
+
+    if (binding_is_default(layer, position)) {
+        return 0;
+    }
+
+    return zmk_keymap_set_binding(layer, position, &zmk_keymap_defaults[layer][position]);
+}
+
+int zmk_keymap_reset_bindings(void) {
+    for (uint8_t layer = 0; layer < ZMK_KEYMAP_LAYERS_LEN; layer++) {
+        for (uint32_t position = 0; position < ZMK_KEYMAP_LEN; position++) {
+            int err = zmk_keymap_reset_binding(layer, position);
+            if (err) {
+                return err;
+            }
+        }
+    }
+
+    return 0;
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_KEYMAP_RUNTIME)
+
 int zmk_keymap_position_state_changed(uint8_t source, uint32_t position, bool pressed,
                                       int64_t timestamp) {
+    zmk_profiling_mark(ZMK_PROFILING_KEYMAP_DISPATCH);
+
     if (pressed) {
         zmk_keymap_active_behavior_layer[position] = _zmk_keymap_layer_state;
+        zmk_keymap_active_behavior_top_layer[position] = zmk_keymap_effective_layer[position];
     }
-    for (int layer = ZMK_KEYMAP_LAYERS_LEN - 1; layer >= _zmk_keymap_layer_default; layer--) {
+    for (int layer = zmk_keymap_active_behavior_top_layer[position];
+         layer >= _zmk_keymap_layer_default; layer--) {
+#if IS_ENABLED(CONFIG_ZMK_KEYMAP_SPARSE)
+        // &trans bindings aren't stored, and would only fall through to the next layer.
+        if (zmk_keymap_transparent[layer][position]) {
+            continue;
+        }
+#endif
         if (zmk_keymap_layer_active_with_state(layer, zmk_keymap_active_behavior_layer[position])) {
             int ret = zmk_keymap_apply_position_state(source, layer, position, pressed, timestamp);
             if (ret > 0) {
@@ -255,32 +727,86 @@ int zmk_keymap_position_state_changed(uint8_t source, uint32_t position, bool pr
 }
 
 #if ZMK_KEYMAP_HAS_SENSORS
+static int keymap_sensors_init(void) {
+    for (int layer = 0; layer < ZMK_KEYMAP_LAYERS_LEN; layer++) {
+        for (int sensor_index = 0; sensor_index < ZMK_KEYMAP_SENSORS_LEN; sensor_index++) {
+            const char *name = zmk_sensor_keymap[layer][sensor_index].behavior_dev;
+            const struct device *behavior = zmk_behavior_get_binding(name);
+
+            if (behavior == NULL) {
+                if (name != NULL) {
+                    LOG_WRN("No behavior %s for sensor %d on layer %d", name, sensor_index, layer);
+                }
+                continue;
+            }
+
+            zmk_sensor_keymap_behaviors[layer][sensor_index] = behavior;
+            zmk_sensor_keymap_layers[sensor_index] |= ZMK_KEYMAP_LAYER_BIT(layer);
+        }
+    }
+
+    return 0;
+}
+
+// Behaviors are initialized at POST_KERNEL, so they can be looked up here.
+ZMK_SYS_INIT(keymap_sensors_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+// These call the already resolved behavior device directly, instead of the behavior API wrappers
+// that look the behavior up by name again.
+static int sensor_binding_accept_data(const struct device *behavior,
+                                      struct zmk_behavior_binding *binding,
+                                      struct zmk_behavior_binding_event event,
+                                      const struct zmk_sensor_config *sensor_config,
+                                      size_t channel_data_size,
+                                      const struct zmk_sensor_channel_data *channel_data) {
+    const struct behavior_driver_api *api = (const struct behavior_driver_api *)behavior->api;
+
+    if (api->sensor_binding_accept_data == NULL) {
+        return -ENOTSUP;
+    }
+
+    return api->sensor_binding_accept_data(binding, event, sensor_config, channel_data_size,
+                                           channel_data);
+}
+
+static int sensor_binding_process(const struct device *behavior,
+                                  struct zmk_behavior_binding *binding,
+                                  struct zmk_behavior_binding_event event,
+                                  enum behavior_sensor_binding_process_mode mode) {
+    const struct behavior_driver_api *api = (const struct behavior_driver_api *)behavior->api;
+
+    if (api->sensor_binding_process == NULL) {
+        return -ENOTSUP;
+    }
+
+    return api->sensor_binding_process(binding, event, mode);
+}
+
 int zmk_keymap_sensor_event(uint8_t sensor_index,
                             const struct zmk_sensor_channel_data *channel_data,
                             size_t channel_data_size, int64_t timestamp) {
     bool opaque_response = false;
 
-    for (int layer = ZMK_KEYMAP_LAYERS_LEN - 1; layer >= 0; layer--) {
+    for (zmk_keymap_layers_state_t layers = zmk_sensor_keymap_layers[sensor_index]; layers != 0;) {
+        uint8_t layer = zmk_keymap_layer_state_highest(layers);
+
+        layers &= ~ZMK_KEYMAP_LAYER_BIT(layer);
+
         struct zmk_behavior_binding *binding = &zmk_sensor_keymap[layer][sensor_index];
+        const struct device *behavior = zmk_sensor_keymap_behaviors[layer][sensor_index];
 
         LOG_DBG("layer: %d sensor_index: %d, binding name: %s", layer, sensor_index,
                 binding->behavior_dev);
 
-        const struct device *behavior = zmk_behavior_get_binding(binding->behavior_dev);
-        if (!behavior) {
-            LOG_DBG("No behavior assigned to %d on layer %d", sensor_index, layer);
-            continue;
-        }
-
         struct zmk_behavior_binding_event event = {
             .layer = layer,
             .position = ZMK_VIRTUAL_KEY_POSITION_SENSOR(sensor_index),
             .timestamp = timestamp,
         };
 
-        int ret = behavior_sensor_keymap_binding_accept_data(
-            binding, event, zmk_sensors_get_config_at_index(sensor_index), channel_data_size,
-            channel_data);
+        int ret = sensor_binding_accept_data(behavior, binding, event,
+                                             zmk_sensors_get_config_at_index(sensor_index),
+                                             channel_data_size, channel_data);
 
         if (ret < 0) {
             LOG_WRN("behavior data accept for behavior %s returned an error (%d). Processing to "
@@ -295,7 +821,7 @@ int zmk_keymap_sensor_event(uint8_t sensor_index,
                 ? BEHAVIOR_SENSOR_BINDING_PROCESS_MODE_TRIGGER
                 : BEHAVIOR_SENSOR_BINDING_PROCESS_MODE_DISCARD;
 
-        ret = behavior_sensor_keymap_binding_process(binding, event, mode);
+        ret = sensor_binding_process(behavior, binding, event, mode);
 
         if (ret == ZMK_BEHAVIOR_OPAQUE) {
             LOG_DBG("sensor event processing complete, behavior response was opaque");
@@ -335,3 +861,72 @@ ZMK_SUBSCRIPTION(keymap, zmk_position_state_changed);
 #if ZMK_KEYMAP_HAS_SENSORS
 ZMK_SUBSCRIPTION(keymap, zmk_sensor_event);
 #endif /* ZMK_KEYMAP_HAS_SENSORS */
+
+#if IS_ENABLED(CONFIG_ZMK_KEYMAP_RUNTIME) && IS_ENABLED(CONFIG_SETTINGS)
+
+static int keymap_handle_set(const char *name, size_t len, settings_read_cb read_cb,
+                             void *cb_arg) {
+    const char *next;
+
+    if (!settings_name_steq(name, "bindings", &next) || !next) {
+        return 0;
+    }
+
+    char *endptr;
+    unsigned long layer = strtoul(next, &endptr, 10);
+    if (*endptr != '/') {
+        LOG_WRN("Invalid keymap binding setting: %s", name);
+        return -EINVAL;
+    }
+
+    unsigned long position = strtoul(endptr + 1, &endptr, 10);
+    if (*endptr != '\0' || layer >= ZMK_KEYMAP_LAYERS_LEN || position >= ZMK_KEYMAP_LEN) {
+        LOG_WRN("Invalid keymap binding setting: %s", name);
+        return -EINVAL;
+    }
+
+    struct keymap_binding_setting setting;
+    if (len != sizeof(setting)) {
+        return -EINVAL;
+    }
+
+    int err = read_cb(cb_arg, &setting, sizeof(setting));
+    if (err <= 0) {
+        LOG_ERR("Failed to handle keymap binding from settings (err %d)", err);
+        return err;
+    }
+
+    const struct device *behavior = zmk_behavior_get_binding_by_id(setting.behavior_id);
+    if (behavior == NULL) {
+        // The behavior may have been removed by a firmware update, so keep the default.
+        LOG_WRN("No behavior with ID 0x%04x for layer %lu position %lu", setting.behavior_id,
+                layer, position);
+        return 0;
+    }
+
+    apply_keymap_binding(layer, position, behavior, setting.param1, setting.param2);
+
+    return 0;
+}
+
+static struct settings_handler keymap_settings_handler = {.name = "keymap",
+                                                          .h_set = keymap_handle_set};
+
+static int keymap_runtime_init(void) {
+    settings_subsys_init();
+
+    int err = settings_register(&keymap_settings_handler);
+    if (err) {
+        LOG_ERR("Failed to register the keymap settings handler (err %d)", err);
+        return err;
+    }
+
+    // Only the bindings that differ from the devicetree keymap are stored, so this is usually
+    // nothing at all.
+    return zmk_settings_load_subtree("keymap");
+}
+
+// Behaviors are initialized at POST_KERNEL, so they can be looked up by ID here.
+ZMK_SYS_INIT(keymap_runtime_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#endif // IS_ENABLED(CONFIG_ZMK_KEYMAP_RUNTIME) && IS_ENABLED(CONFIG_SETTINGS)
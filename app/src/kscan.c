@@ -9,45 +9,279 @@
 #include <zephyr/pm/device.h>
 #include <zephyr/bluetooth/addr.h>
 #include <zephyr/drivers/kscan.h>
+#include <zephyr/input/input.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
+#include <zmk/activity.h>
+#include <zmk/benchmark.h>
+#include <zmk/input_frame.h>
+#include <zmk/kscan_poll.h>
+#include <zmk/kscan_sideband_behaviors.h>
+#include <zmk/kscan_sync.h>
+#include <zmk/kscan_timestamp.h>
+#include <zmk/matrix.h>
 #include <zmk/matrix_transform.h>
+#include <zmk/position_state.h>
+#include <zmk/profiling.h>
+#include <zmk/time.h>
+#include <zmk/resource_stats.h>
 #include <zmk/event_manager.h>
 #include <zmk/events/position_state_changed.h>
+#include <zmk/workqueue.h>
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_CENTRAL_REORDER)
+#include <zmk/split/central.h>
+#endif
 
 #define ZMK_KSCAN_EVENT_STATE_PRESSED 0
 #define ZMK_KSCAN_EVENT_STATE_RELEASED 1
 
+// Kept small since it is copied through the event queue from the kscan callback. The time keeps
+// the tick the change was detected at, and is only turned into uptime when the event is processed.
 struct zmk_kscan_event {
-    uint32_t row;
-    uint32_t column;
-    uint32_t state;
+    zmk_time_t time;
+    uint16_t row;
+    uint16_t column;
+    uint8_t state;
+#if IS_ENABLED(CONFIG_ZMK_PROFILING)
+    uint32_t cycles;
+#endif
 };
 
 struct zmk_kscan_msg_processor {
     struct k_work work;
 } msg_processor;
 
+static atomic_t dropped_presses;
+static atomic_t dropped_releases;
+
+ZMK_QUEUE_STATS_DEFINE(kscan_queue_stats, "KSCAN events", CONFIG_ZMK_KSCAN_EVENT_QUEUE_SIZE);
+
+#if IS_ENABLED(CONFIG_ZMK_KSCAN_EVENT_RING)
+
+BUILD_ASSERT(IS_POWER_OF_TWO(CONFIG_ZMK_KSCAN_EVENT_QUEUE_SIZE),
+             "CONFIG_ZMK_KSCAN_EVENT_QUEUE_SIZE must be a power of two");
+
+#define RING_MASK (CONFIG_ZMK_KSCAN_EVENT_QUEUE_SIZE - 1)
+
+// Single producer (the kscan callback) and single consumer (the message processor work item).
+// Each index is only ever written by its owner, and the sequentially consistent atomic accesses
+// order the event copy against publishing the new index.
+static struct zmk_kscan_event ring_events[CONFIG_ZMK_KSCAN_EVENT_QUEUE_SIZE];
+static atomic_t ring_head;
+static atomic_t ring_tail;
+static atomic_t ring_high_water;
+
+static int queue_put(const struct zmk_kscan_event *ev) {
+    uint32_t head = (uint32_t)atomic_get(&ring_head);
+    uint32_t used = head - (uint32_t)atomic_get(&ring_tail);
+
+    if (used >= CONFIG_ZMK_KSCAN_EVENT_QUEUE_SIZE) {
+        return -ENOMEM;
+    }
+
+    ring_events[head & RING_MASK] = *ev;
+    atomic_set(&ring_head, (atomic_val_t)(head + 1));
+
+    if (used + 1 > (uint32_t)atomic_get(&ring_high_water)) {
+        atomic_set(&ring_high_water, (atomic_val_t)(used + 1));
+    }
+
+    return 0;
+}
+
+static inline uint32_t queue_used(void) {
+    return (uint32_t)atomic_get(&ring_head) - (uint32_t)atomic_get(&ring_tail);
+}
+
+static int queue_get(struct zmk_kscan_event *ev) {
+    uint32_t tail = (uint32_t)atomic_get(&ring_tail);
+
+    if (tail == (uint32_t)atomic_get(&ring_head)) {
+        return -ENOMSG;
+    }
+
+    *ev = ring_events[tail & RING_MASK];
+    atomic_set(&ring_tail, (atomic_val_t)(tail + 1));
+
+    return 0;
+}
+
+#else
+
 K_MSGQ_DEFINE(zmk_kscan_msgq, sizeof(struct zmk_kscan_event), CONFIG_ZMK_KSCAN_EVENT_QUEUE_SIZE, 4);
 
+static int queue_put(const struct zmk_kscan_event *ev) {
+    return k_msgq_put(&zmk_kscan_msgq, ev, K_NO_WAIT);
+}
+
+static inline uint32_t queue_used(void) { return k_msgq_num_used_get(&zmk_kscan_msgq); }
+
+static int queue_get(struct zmk_kscan_event *ev) {
+    return k_msgq_get(&zmk_kscan_msgq, ev, K_NO_WAIT);
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_KSCAN_EVENT_RING)
+
+static int64_t pending_timestamp;
+
+void zmk_kscan_set_event_timestamp(int64_t timestamp) { pending_timestamp = timestamp; }
+
+static zmk_time_t take_event_time(void) {
+    zmk_time_t now = zmk_time_now();
+    int64_t timestamp = pending_timestamp;
+
+    pending_timestamp = 0;
+
+    if (timestamp <= 0) {
+        return now;
+    }
+
+    // Drivers report the scheduled time of the scan, which can't be later than now.
+    zmk_time_t time = zmk_time_from_uptime_ms(timestamp);
+    return zmk_time_before(time, now) ? time : now;
+}
+
+int64_t zmk_kscan_take_event_timestamp(void) {
+    return zmk_time_to_uptime_ms(take_event_time(), k_uptime_ticks());
+}
+
+static bool pending_unsynced;
+
+void zmk_kscan_set_event_sync(bool sync) { pending_unsynced = !sync; }
+
+bool zmk_kscan_take_event_sync(void) {
+    bool sync = !pending_unsynced;
+
+    pending_unsynced = false;
+    return sync;
+}
+
+bool zmk_kscan_is_idle(void) { return zmk_activity_get_state() != ZMK_ACTIVITY_ACTIVE; }
+
+static void queue_event(const struct zmk_kscan_event *ev) {
+    bool pressed = (ev->state == ZMK_KSCAN_EVENT_STATE_PRESSED);
+
+    if (queue_put(ev) < 0) {
+        // A lost release leaves the key stuck until it is pressed again, so always report it.
+        atomic_inc(pressed ? &dropped_presses : &dropped_releases);
+        zmk_queue_stats_overflowed(&kscan_queue_stats);
+        LOG_ERR("KSCAN event queue full, dropped %s for row: %d, col: %d",
+                (pressed ? "press" : "release"), ev->row, ev->column);
+    } else {
+        zmk_benchmark_queue_push(ZMK_BENCHMARK_QUEUE_KSCAN);
+        zmk_queue_stats_queued(&kscan_queue_stats, queue_used());
+    }
+}
+
+#if IS_ENABLED(CONFIG_ZMK_KSCAN_INPUT_BRIDGE)
+
+// Key events only have room for the state, so the time of each change goes before it in an event
+// of its own.
+#define KSCAN_INPUT_EV_TIME INPUT_EV_VENDOR_START
+
+static const struct device *const kscan_dev = DEVICE_DT_GET(ZMK_MATRIX_NODE_ID);
+
+static void report_input(const struct zmk_kscan_event *ev, bool sync) {
+    const uint16_t code = ev->row * ZMK_MATRIX_COLS + ev->column;
+    const bool pressed = (ev->state == ZMK_KSCAN_EVENT_STATE_PRESSED);
+
+    // Changes can be reported from interrupts, so never wait for room in the input queue.
+    int err = input_report(kscan_dev, KSCAN_INPUT_EV_TIME, 0, (int32_t)ev->time, false, K_NO_WAIT);
+    if (err == 0) {
+        err = input_report_key(kscan_dev, code, pressed, sync, K_NO_WAIT);
+    }
+
+    if (err < 0) {
+        atomic_inc(pressed ? &dropped_presses : &dropped_releases);
+        LOG_ERR("Input queue full, dropped %s for row: %d, col: %d",
+                (pressed ? "press" : "release"), ev->row, ev->column);
+    }
+}
+
+static zmk_time_t input_event_time;
+
+static void kscan_input_callback(struct input_event *evt) {
+    switch (evt->type) {
+    case KSCAN_INPUT_EV_TIME:
+        input_event_time = (zmk_time_t)evt->value;
+        break;
+    case INPUT_EV_KEY: {
+        struct zmk_kscan_event ev = {
+            .row = evt->code / ZMK_MATRIX_COLS,
+            .column = evt->code % ZMK_MATRIX_COLS,
+            .state = (evt->value ? ZMK_KSCAN_EVENT_STATE_PRESSED : ZMK_KSCAN_EVENT_STATE_RELEASED),
+            .time = input_event_time};
+#if IS_ENABLED(CONFIG_ZMK_PROFILING)
+        // Cycle counts don't fit in the input events, so profiling starts from the input thread.
+        ev.cycles = zmk_profiling_now();
+#endif
+        queue_event(&ev);
+        break;
+    }
+    }
+
+    // The rest of the scan's changes are still to come, so leave them to be processed together.
+    if (evt->sync) {
+        k_work_submit_to_queue(zmk_workqueue_input_work_q(), &msg_processor.work);
+    }
+}
+
+INPUT_CALLBACK_DEFINE(DEVICE_DT_GET(ZMK_MATRIX_NODE_ID), kscan_input_callback);
+
+#endif // IS_ENABLED(CONFIG_ZMK_KSCAN_INPUT_BRIDGE)
+
 static void zmk_kscan_callback(const struct device *dev, uint32_t row, uint32_t column,
                                bool pressed) {
+    uint32_t cycles = zmk_profiling_now();
     struct zmk_kscan_event ev = {
         .row = row,
         .column = column,
-        .state = (pressed ? ZMK_KSCAN_EVENT_STATE_PRESSED : ZMK_KSCAN_EVENT_STATE_RELEASED)};
+        .state = (pressed ? ZMK_KSCAN_EVENT_STATE_PRESSED : ZMK_KSCAN_EVENT_STATE_RELEASED),
+        .time = take_event_time()};
+    bool sync = zmk_kscan_take_event_sync();
+#if IS_ENABLED(CONFIG_ZMK_PROFILING)
+    ev.cycles = cycles;
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_KSCAN_INPUT_BRIDGE)
+    report_input(&ev, sync);
+#else
+    ARG_UNUSED(sync);
 
-    k_msgq_put(&zmk_kscan_msgq, &ev, K_NO_WAIT);
-    k_work_submit(&msg_processor.work);
+    queue_event(&ev);
+    k_work_submit_to_queue(zmk_workqueue_input_work_q(), &msg_processor.work);
+#endif
+    zmk_profiling_record(ZMK_PROFILING_KSCAN_CALLBACK, cycles);
 }
 
 void zmk_kscan_process_msgq(struct k_work *item) {
     struct zmk_kscan_event ev;
+    // Events are processed long before the tick count wraps, so one read serves the whole frame.
+    int64_t ref_ticks = k_uptime_ticks();
+
+    zmk_input_frame_begin();
+
+    while (queue_get(&ev) == 0) {
+        zmk_benchmark_queue_pop(ZMK_BENCHMARK_QUEUE_KSCAN);
+#if IS_ENABLED(CONFIG_ZMK_PROFILING)
+        zmk_profiling_begin(ev.cycles);
+#endif
+        zmk_profiling_mark(ZMK_PROFILING_KSCAN_DEQUEUE);
 
-    while (k_msgq_get(&zmk_kscan_msgq, &ev, K_NO_WAIT) == 0) {
         bool pressed = (ev.state == ZMK_KSCAN_EVENT_STATE_PRESSED);
+        int64_t timestamp = zmk_time_to_uptime_ms(ev.time, ref_ticks);
+
+#if ZMK_KSCAN_SIDEBAND_BEHAVIORS_CHOSEN
+        // Sideband keys don't need to be in the transform, so their bindings are invoked first.
+        zmk_kscan_sideband_process(ev.row, ev.column, pressed, timestamp);
+#endif
+
         int32_t position = zmk_matrix_transform_row_column_to_position(ev.row, ev.column);
 
         if (position < 0) {
@@ -58,14 +292,61 @@ void zmk_kscan_process_msgq(struct k_work *item) {
 
         LOG_DBG("Row: %d, col: %d, position: %d, pressed: %s", ev.row, ev.column, position,
                 (pressed ? "true" : "false"));
-        raise_zmk_position_state_changed(
-            (struct zmk_position_state_changed){.source = ZMK_POSITION_STATE_CHANGE_SOURCE_LOCAL,
-                                                .state = pressed,
-                                                .position = position,
-                                                .timestamp = k_uptime_get()});
+
+        struct zmk_position_state_changed position_ev = {
+            .source = ZMK_POSITION_STATE_CHANGE_SOURCE_LOCAL,
+            .state = pressed,
+            .position = position,
+            .timestamp = timestamp};
+
+        zmk_benchmark_key_event_begin();
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_CENTRAL_REORDER)
+        // Sorted in with the peripherals' events, which may have been scanned earlier.
+        zmk_split_central_raise_position_state(&position_ev);
+#else
+        zmk_position_state_update(position, pressed);
+        raise_zmk_position_state_changed(position_ev);
+#endif
+        zmk_benchmark_key_event_end();
     }
+
+    // Reports sent as the frame ends belong to the last key event of the frame.
+    zmk_input_frame_end();
+    zmk_profiling_end();
+}
+
+#if IS_ENABLED(CONFIG_SHELL)
+
+static int cmd_kscan_stats(const struct shell *sh, size_t argc, char **argv) {
+    shell_print(sh, "Queue size: %d", CONFIG_ZMK_KSCAN_EVENT_QUEUE_SIZE);
+#if IS_ENABLED(CONFIG_ZMK_KSCAN_EVENT_RING)
+    shell_print(sh, "Queue high water: %ld", (long)atomic_get(&ring_high_water));
+#endif
+    shell_print(sh, "Dropped presses: %ld", (long)atomic_get(&dropped_presses));
+    shell_print(sh, "Dropped releases: %ld", (long)atomic_get(&dropped_releases));
+    return 0;
 }
 
+static int cmd_kscan_reset(const struct shell *sh, size_t argc, char **argv) {
+    atomic_clear(&dropped_presses);
+    atomic_clear(&dropped_releases);
+#if IS_ENABLED(CONFIG_ZMK_KSCAN_EVENT_RING)
+    atomic_clear(&ring_high_water);
+#endif
+    shell_print(sh, "KSCAN statistics reset");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_kscan,
+                               SHELL_CMD(stats, NULL, "Show event queue statistics",
+                                         cmd_kscan_stats),
+                               SHELL_CMD(reset, NULL, "Reset statistics", cmd_kscan_reset),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((zmk), kscan, &sub_kscan, "KSCAN event queue", NULL, 0, 0);
+
+#endif // IS_ENABLED(CONFIG_SHELL)
+
 int zmk_kscan_init(const struct device *dev) {
     if (dev == NULL) {
         LOG_ERR("Failed to get the KSCAN device");
@@ -15,11 +15,14 @@
 #include <zmk/event_manager.h>
 #include <zmk/behavior.h>
 #include <zmk/keymap.h>
+#include <zmk/kscan_sideband_behaviors.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 struct ksbb_entry {
     struct zmk_behavior_binding binding;
+    // Resolved at init, so invoking the binding doesn't look the behavior up by name.
+    const struct device *behavior;
     uint8_t row;
     uint8_t column;
 };
@@ -68,25 +71,65 @@ struct ksbb_entry *find_sideband_behavior(const struct device *dev, uint32_t row
     return NULL;
 }
 
+static void invoke_sideband_behavior(struct ksbb_entry *entry, bool pressed, int64_t timestamp) {
+    if (entry->behavior == NULL) {
+        return;
+    }
+
+    const struct behavior_driver_api *api =
+        (const struct behavior_driver_api *)entry->behavior->api;
+    struct zmk_behavior_binding_event event = {.position = INT32_MAX, .timestamp = timestamp};
+    int ret;
+
+    if (pressed) {
+        ret = api->binding_pressed ? api->binding_pressed(&entry->binding, event) : -ENOTSUP;
+    } else {
+        ret = api->binding_released ? api->binding_released(&entry->binding, event) : -ENOTSUP;
+    }
+
+    if (ret < 0) {
+        LOG_WRN("Sideband behavior %s failed (%d)", entry->behavior->name, ret);
+    }
+}
+
+#if ZMK_KSCAN_SIDEBAND_BEHAVIORS_CHOSEN
+
+static const struct device *const chosen_ksbb = DEVICE_DT_GET(DT_CHOSEN(zmk_kscan));
+
+void zmk_kscan_sideband_process(uint32_t row, uint32_t column, bool pressed, int64_t timestamp) {
+    struct ksbb_entry *entry = find_sideband_behavior(chosen_ksbb, row, column);
+
+    if (entry) {
+        invoke_sideband_behavior(entry, pressed, timestamp);
+    }
+}
+
+static inline bool is_chosen_ksbb(const struct device *ksbb) { return ksbb == chosen_ksbb; }
+
+#else
+
+static inline bool is_chosen_ksbb(const struct device *ksbb) { return false; }
+
+#endif // ZMK_KSCAN_SIDEBAND_BEHAVIORS_CHOSEN
+
 void ksbb_inner_kscan_callback(const struct device *dev, uint32_t row, uint32_t column,
                                bool pressed) {
     const struct device *ksbb = find_ksbb_for_inner(dev);
     if (ksbb) {
         struct ksbb_data *data = ksbb->data;
+        bool forward = data->enabled && data->callback;
 
-        struct ksbb_entry *entry = find_sideband_behavior(ksbb, row, column);
-        if (entry) {
-            struct zmk_behavior_binding_event event = {.position = INT32_MAX,
-                                                       .timestamp = k_uptime_get()};
+        // Changes forwarded by the chosen kscan have their binding invoked with the rest of the
+        // kscan frame. Any other change, such as one while suspended, is handled right away.
+        if (!(forward && is_chosen_ksbb(ksbb))) {
+            struct ksbb_entry *entry = find_sideband_behavior(ksbb, row, column);
 
-            if (pressed) {
-                behavior_keymap_binding_pressed(&entry->binding, event);
-            } else {
-                behavior_keymap_binding_released(&entry->binding, event);
+            if (entry) {
+                invoke_sideband_behavior(entry, pressed, k_uptime_get());
             }
         }
 
-        if (data->enabled && data->callback) {
+        if (forward) {
             data->callback(ksbb, row, column, pressed);
         }
     }
@@ -129,6 +172,15 @@ static int ksbb_init(const struct device *dev) {
         return -ENODEV;
     }
 
+    for (int e = 0; e < config->entries_len; e++) {
+        struct ksbb_entry *entry = &config->entries[e];
+
+        entry->behavior = zmk_behavior_get_binding(entry->binding.behavior_dev);
+        if (entry->behavior == NULL) {
+            LOG_ERR("Unknown sideband behavior %s", entry->binding.behavior_dev);
+        }
+    }
+
     kscan_config(config->kscan, &ksbb_inner_kscan_callback);
     kscan_enable_callback(config->kscan);
 
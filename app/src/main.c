@@ -14,19 +14,26 @@ LOG_MODULE_REGISTER(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #include <zmk/matrix.h>
 #include <zmk/kscan.h>
+#include <zmk/boot_timing.h>
+#include <zmk/deferred_init.h>
 #include <zmk/display.h>
 #include <drivers/ext_power.h>
 
 int main(void) {
     LOG_INF("Welcome to ZMK!\n");
+    zmk_boot_timing_mark("main");
 
     if (zmk_kscan_init(DEVICE_DT_GET(ZMK_MATRIX_NODE_ID)) != 0) {
         return -ENOTSUP;
     }
 
-#ifdef CONFIG_ZMK_DISPLAY
+    zmk_boot_timing_mark("kscan started");
+
+#if defined(CONFIG_ZMK_DISPLAY) && !IS_ENABLED(CONFIG_ZMK_DEFERRED_INIT)
     zmk_display_init();
 #endif /* CONFIG_ZMK_DISPLAY */
 
+    zmk_deferred_init_start();
+
     return 0;
 }
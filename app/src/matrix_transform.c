@@ -24,6 +24,12 @@
  * initialized to 0, and the keymap index of 0 is a valid index. We want to
  * be able to detect the condition when an unassigned matrix position is
  * pressed and we want to return an error.
+ *
+ * The table stays dense rather than listing only the mapped positions. A
+ * sparse form would need the map sorted by matrix index to be searched,
+ * which the preprocessor can't do, and the lookup runs for every key
+ * event. The table is const and only as long as the highest mapped matrix
+ * index, so it costs one byte of flash per matrix position on most keymaps.
  */
 
 #define INDEX_OFFSET 1
@@ -32,20 +38,28 @@
     [(KT_ROW(DT_PROP_BY_IDX(ZMK_KEYMAP_TRANSFORM_NODE, map, i)) * ZMK_MATRIX_COLS) +               \
         KT_COL(DT_PROP_BY_IDX(ZMK_KEYMAP_TRANSFORM_NODE, map, i))] = i + INDEX_OFFSET
 
-static uint32_t transform[] = {LISTIFY(ZMK_KEYMAP_LEN, TRANSFORM_ENTRY, (, ), 0)};
-
+// Encoded keymap indexes fit in a byte for all but the largest keymaps.
+#if ZMK_KEYMAP_LEN + INDEX_OFFSET <= UINT8_MAX
+typedef uint8_t transform_entry_t;
+#else
+typedef uint16_t transform_entry_t;
 #endif
 
-int32_t zmk_matrix_transform_row_column_to_position(uint32_t row, uint32_t column) {
-#if DT_NODE_HAS_PROP(ZMK_KEYMAP_TRANSFORM_NODE, col_offset)
-    column += DT_PROP(ZMK_KEYMAP_TRANSFORM_NODE, col_offset);
-#endif
+static const transform_entry_t transform[] = {LISTIFY(ZMK_KEYMAP_LEN, TRANSFORM_ENTRY, (, ), 0)};
+
+// The reverse mapping is the map property itself, with each entry encoded by RC(row, col).
+static const uint16_t positions[] = DT_PROP(ZMK_KEYMAP_TRANSFORM_NODE, map);
 
-#if DT_NODE_HAS_PROP(ZMK_KEYMAP_TRANSFORM_NODE, row_offset)
-    row += DT_PROP(ZMK_KEYMAP_TRANSFORM_NODE, row_offset);
 #endif
 
-    const uint32_t matrix_index = (row * ZMK_MATRIX_COLS) + column;
+#define ROW_OFFSET DT_PROP_OR(ZMK_KEYMAP_TRANSFORM_NODE, row_offset, 0)
+#define COL_OFFSET DT_PROP_OR(ZMK_KEYMAP_TRANSFORM_NODE, col_offset, 0)
+
+// The row and column offsets only ever shift the matrix index by a constant.
+#define MATRIX_INDEX_OFFSET ((ROW_OFFSET * ZMK_MATRIX_COLS) + COL_OFFSET)
+
+int32_t zmk_matrix_transform_row_column_to_position(uint32_t row, uint32_t column) {
+    const uint32_t matrix_index = (row * ZMK_MATRIX_COLS) + column + MATRIX_INDEX_OFFSET;
 
 #ifdef ZMK_KEYMAP_TRANSFORM_NODE
     if (matrix_index >= ARRAY_SIZE(transform)) {
@@ -63,3 +77,20 @@ int32_t zmk_matrix_transform_row_column_to_position(uint32_t row, uint32_t colum
     return matrix_index;
 #endif /* ZMK_KEYMAP_TRANSFORM_NODE */
 };
+
+int zmk_matrix_transform_position_to_row_column(uint32_t position, uint32_t *row,
+                                                uint32_t *column) {
+    if (position >= ZMK_KEYMAP_LEN) {
+        return -EINVAL;
+    }
+
+#ifdef ZMK_KEYMAP_TRANSFORM_NODE
+    *row = KT_ROW(positions[position]);
+    *column = KT_COL(positions[position]);
+#else
+    *row = position / ZMK_MATRIX_COLS;
+    *column = position % ZMK_MATRIX_COLS;
+#endif /* ZMK_KEYMAP_TRANSFORM_NODE */
+
+    return 0;
+}
@@ -18,9 +18,47 @@ static struct zmk_hid_mouse_report mouse_report = {
 static int explicit_button_counts[5] = {0, 0, 0, 0, 0};
 static zmk_mod_flags_t explicit_buttons = 0;
 
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+static struct zmk_hid_mouse_abs_report mouse_abs_report = {
+    .report_id = ZMK_MOUSE_HID_REPORT_ID_ABS_POINTER};
+
+// Both pointers carry the buttons, so a button pressed through one is released through both. Only
+// tracked once the absolute pointer has a position, so hosts don't see a pointer that never moved.
+static bool abs_pointer_used;
+static bool abs_buttons_changed;
+
+static void set_abs_buttons(zmk_mouse_button_flags_t buttons) {
+    if (abs_pointer_used && mouse_abs_report.body.buttons != buttons) {
+        abs_buttons_changed = true;
+    }
+    mouse_abs_report.body.buttons = buttons;
+}
+
+void zmk_hid_mouse_abs_position_set(uint16_t x, uint16_t y) {
+    abs_pointer_used = true;
+    mouse_abs_report.body.x = MIN(x, ZMK_MOUSE_HID_ABS_MAX);
+    mouse_abs_report.body.y = MIN(y, ZMK_MOUSE_HID_ABS_MAX);
+    LOG_DBG("Mouse absolute position set to %d/%d", mouse_abs_report.body.x,
+            mouse_abs_report.body.y);
+}
+
+bool zmk_hid_mouse_abs_buttons_changed(void) {
+    bool changed = abs_buttons_changed;
+    abs_buttons_changed = false;
+    return changed;
+}
+
+struct zmk_hid_mouse_abs_report *zmk_mouse_hid_get_mouse_abs_report(void) {
+    return &mouse_abs_report;
+}
+#else
+static void set_abs_buttons(zmk_mouse_button_flags_t buttons) {}
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+
 #define SET_MOUSE_BUTTONS(btns)                                                                    \
     {                                                                                              \
         mouse_report.body.buttons = btns;                                                          \
+        set_abs_buttons(btns);                                                                     \
         LOG_DBG("Mouse buttons set to 0x%02X", mouse_report.body.buttons);                         \
     }
 
@@ -85,14 +123,14 @@ void zmk_hid_mouse_movement_update(int16_t x, int16_t y) {
     LOG_DBG("Mouse movement updated to %d/%d", mouse_report.body.d_x, mouse_report.body.d_y);
 }
 
-void zmk_hid_mouse_scroll_set(int8_t x, int8_t y) {
+void zmk_hid_mouse_scroll_set(int16_t x, int16_t y) {
     mouse_report.body.d_scroll_x = x;
     mouse_report.body.d_scroll_y = y;
     LOG_DBG("Mouse scroll set to %d/%d", mouse_report.body.d_scroll_x,
             mouse_report.body.d_scroll_y);
 }
 
-void zmk_hid_mouse_scroll_update(int8_t x, int8_t y) {
+void zmk_hid_mouse_scroll_update(int16_t x, int16_t y) {
     mouse_report.body.d_scroll_x += x;
     mouse_report.body.d_scroll_y += y;
     LOG_DBG("Mouse scroll updated to X: %d/%d", mouse_report.body.d_scroll_x,
@@ -102,6 +140,7 @@ void zmk_hid_mouse_scroll_update(int8_t x, int8_t y) {
 void zmk_hid_mouse_clear(void) {
     LOG_DBG("Mouse report cleared");
     memset(&mouse_report.body, 0, sizeof(mouse_report.body));
+    set_abs_buttons(0);
 }
 
 struct zmk_hid_mouse_report *zmk_mouse_hid_get_mouse_report(void) {
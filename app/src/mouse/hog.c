@@ -12,12 +12,16 @@
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
 #include <zephyr/bluetooth/gatt.h>
 
 #include <zmk/ble.h>
 #include <zmk/endpoints_types.h>
 #include <zmk/mouse/hog.h>
 #include <zmk/mouse/hid.h>
+#include <zmk/boot_timing.h>
+#include <zmk/resource_stats.h>
+#include <zmk/workqueue.h>
 
 enum {
     HIDS_REMOTE_WAKE = BIT(0),
@@ -52,7 +56,27 @@ static struct hids_report mouse_input = {
     .type = HIDS_INPUT,
 };
 
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+static struct hids_report mouse_abs_input = {
+    .id = ZMK_MOUSE_HID_REPORT_ID_ABS_POINTER,
+    .type = HIDS_INPUT,
+};
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+static struct hids_report mouse_resolution_feature = {
+    .id = ZMK_MOUSE_HID_REPORT_ID_MOUSE,
+    .type = HIDS_FEATURE,
+};
+
+// Each connected host sets the resolution multiplier for itself.
+static struct zmk_hid_mouse_resolution_feature_report_body resolution_features[CONFIG_BT_MAX_CONN];
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+
 static bool host_requests_notification = false;
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+static bool host_requests_abs_notification = false;
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
 static uint8_t ctrl_point;
 
 static ssize_t read_hids_info(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
@@ -80,11 +104,57 @@ static ssize_t read_hids_mouse_input_report(struct bt_conn *conn, const struct b
                              sizeof(struct zmk_hid_mouse_report_body));
 }
 
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+static ssize_t read_hids_mouse_abs_input_report(struct bt_conn *conn,
+                                                const struct bt_gatt_attr *attr, void *buf,
+                                                uint16_t len, uint16_t offset) {
+    struct zmk_hid_mouse_abs_report_body *report_body = &zmk_mouse_hid_get_mouse_abs_report()->body;
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, report_body,
+                             sizeof(struct zmk_hid_mouse_abs_report_body));
+}
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+static ssize_t read_hids_mouse_resolution_feature(struct bt_conn *conn,
+                                                  const struct bt_gatt_attr *attr, void *buf,
+                                                  uint16_t len, uint16_t offset) {
+    return bt_gatt_attr_read(conn, attr, buf, len, offset,
+                             &resolution_features[bt_conn_index(conn)],
+                             sizeof(struct zmk_hid_mouse_resolution_feature_report_body));
+}
+
+static ssize_t write_hids_mouse_resolution_feature(struct bt_conn *conn,
+                                                   const struct bt_gatt_attr *attr,
+                                                   const void *buf, uint16_t len, uint16_t offset,
+                                                   uint8_t flags) {
+    if (offset != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    if (len != sizeof(struct zmk_hid_mouse_resolution_feature_report_body)) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    const struct zmk_hid_mouse_resolution_feature_report_body *report = buf;
+    resolution_features[bt_conn_index(conn)].wheel_resolution = report->wheel_resolution & 0x03;
+    LOG_DBG("Scroll resolution multiplier %s",
+            report->wheel_resolution ? "enabled" : "disabled");
+
+    return len;
+}
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+
 static void input_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value) {
     LOG_DBG("Input CC changed for %d", attr->handle);
     host_requests_notification = (value == BT_GATT_CCC_NOTIFY) ? 1 : 0;
 }
 
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+static void abs_input_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value) {
+    LOG_DBG("Absolute input CC changed for %d", attr->handle);
+    host_requests_abs_notification = (value == BT_GATT_CCC_NOTIFY) ? 1 : 0;
+}
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+
 static ssize_t write_ctrl_point(struct bt_conn *conn, const struct bt_gatt_attr *attr,
                                 const void *buf, uint16_t len, uint16_t offset, uint8_t flags) {
     uint8_t *value = attr->user_data;
@@ -115,7 +185,31 @@ BT_GATT_SERVICE_DEFINE(
                            NULL, &info),
 
     BT_GATT_CHARACTERISTIC(BT_UUID_HIDS_CTRL_POINT, BT_GATT_CHRC_WRITE_WITHOUT_RESP,
-                           BT_GATT_PERM_WRITE, NULL, write_ctrl_point, &ctrl_point));
+                           BT_GATT_PERM_WRITE, NULL, write_ctrl_point, &ctrl_point),
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+    // Listed after the characteristics above so their attribute indexes don't depend on it.
+    BT_GATT_CHARACTERISTIC(BT_UUID_HIDS_REPORT, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
+                           BT_GATT_PERM_READ_ENCRYPT, read_hids_mouse_abs_input_report, NULL,
+                           NULL),
+    BT_GATT_CCC(abs_input_ccc_changed, BT_GATT_PERM_READ_ENCRYPT | BT_GATT_PERM_WRITE_ENCRYPT),
+    BT_GATT_DESCRIPTOR(BT_UUID_HIDS_REPORT_REF, BT_GATT_PERM_READ_ENCRYPT, read_hids_report_ref,
+                       NULL, &mouse_abs_input),
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+    BT_GATT_CHARACTERISTIC(BT_UUID_HIDS_REPORT, BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+                           BT_GATT_PERM_READ_ENCRYPT | BT_GATT_PERM_WRITE_ENCRYPT,
+                           read_hids_mouse_resolution_feature, write_hids_mouse_resolution_feature,
+                           NULL),
+    BT_GATT_DESCRIPTOR(BT_UUID_HIDS_REPORT_REF, BT_GATT_PERM_READ_ENCRYPT, read_hids_report_ref,
+                       NULL, &mouse_resolution_feature),
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+);
+
+// Attribute indexes of the input reports in the service above.
+#define MOUSE_INPUT_ATTR_INDEX 3
+#define MOUSE_ABS_INPUT_ATTR_INDEX 11
 
 static struct bt_conn *destination_connection(void) {
     struct bt_conn *conn;
@@ -136,57 +230,301 @@ K_THREAD_STACK_DEFINE(mouse_hog_q_stack, CONFIG_ZMK_BLE_THREAD_STACK_SIZE);
 
 static struct k_work_q mouse_hog_work_q;
 
+ZMK_STACK_STATS_DEFINE(mouse_hog_work_q, mouse_hog_q_stack, "BLE mouse notify");
+ZMK_WORKQUEUE_REGISTER(mouse_hog_work_q, "BLE mouse notify", ZMK_WORKQUEUE_LATENCY_TRANSPORT);
+
+// Reports whose buttons changed are queued as they are, so no click is lost or reordered. Motion
+// and scrolling between those are summed up in the pending report instead, and go out as one
+// notification per connection event.
 K_MSGQ_DEFINE(zmk_hog_mouse_msgq, sizeof(struct zmk_hid_mouse_report_body),
               CONFIG_ZMK_BLE_MOUSE_REPORT_QUEUE_SIZE, 4);
 
+ZMK_QUEUE_STATS_DEFINE(mouse_queue_stats, "BLE mouse reports",
+                       CONFIG_ZMK_BLE_MOUSE_REPORT_QUEUE_SIZE);
+
+struct mouse_report_accumulator {
+    zmk_mouse_button_flags_t buttons;
+    int32_t d_x;
+    int32_t d_y;
+    int32_t d_scroll_y;
+    int32_t d_scroll_x;
+    bool valid;
+};
+
+static struct mouse_report_accumulator pending_report;
+static struct k_spinlock pending_report_lock;
+
+// Set while a notification waits for its connection event. The next report is sent from its
+// completion callback, so anything that arrives in the meantime gets summed up.
+static atomic_t notify_in_flight;
+
+static int16_t take_delta(int32_t *delta) {
+    int16_t val = CLAMP(*delta, INT16_MIN, INT16_MAX);
+
+    // Motion that doesn't fit into one report is carried over to the next one.
+    *delta -= val;
+    return val;
+}
+
+static void take_pending_report(struct zmk_hid_mouse_report_body *report) {
+    report->buttons = pending_report.buttons;
+    report->d_x = take_delta(&pending_report.d_x);
+    report->d_y = take_delta(&pending_report.d_y);
+    report->d_scroll_y = take_delta(&pending_report.d_scroll_y);
+    report->d_scroll_x = take_delta(&pending_report.d_scroll_x);
+
+    pending_report.valid = pending_report.d_x || pending_report.d_y ||
+                           pending_report.d_scroll_y || pending_report.d_scroll_x;
+}
+
+static void queue_report(const struct zmk_hid_mouse_report_body *report) {
+    while (k_msgq_put(&zmk_hog_mouse_msgq, report, K_NO_WAIT) != 0) {
+        LOG_WRN("Mouse message queue full, popping first message and queueing again");
+        zmk_queue_stats_overflowed(&mouse_queue_stats);
+        struct zmk_hid_mouse_report_body discarded_report;
+        k_msgq_get(&zmk_hog_mouse_msgq, &discarded_report, K_NO_WAIT);
+    }
+
+    zmk_queue_stats_queued(&mouse_queue_stats, k_msgq_num_used_get(&zmk_hog_mouse_msgq));
+}
+
+static bool next_report(struct zmk_hid_mouse_report_body *report) {
+    if (k_msgq_get(&zmk_hog_mouse_msgq, report, K_NO_WAIT) == 0) {
+        return true;
+    }
+
+    bool found = false;
+    k_spinlock_key_t key = k_spin_lock(&pending_report_lock);
+
+    if (pending_report.valid) {
+        take_pending_report(report);
+        found = true;
+    }
+
+    k_spin_unlock(&pending_report_lock, key);
+    return found;
+}
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+// Only the latest position matters, so the absolute pointer just keeps the last report unsent.
+static struct zmk_hid_mouse_abs_report_body pending_abs_report;
+static bool pending_abs_report_valid;
+
+static bool next_abs_report(struct zmk_hid_mouse_abs_report_body *report) {
+    k_spinlock_key_t key = k_spin_lock(&pending_report_lock);
+
+    bool found = pending_abs_report_valid;
+    *report = pending_abs_report;
+    pending_abs_report_valid = false;
+
+    k_spin_unlock(&pending_report_lock, key);
+    return found;
+}
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+
+static void clear_pending_motion(void) {
+    pending_report.d_x = pending_report.d_y = 0;
+    pending_report.d_scroll_y = pending_report.d_scroll_x = 0;
+}
+
+static void discard_reports(void) {
+    k_msgq_purge(&zmk_hog_mouse_msgq);
+
+    k_spinlock_key_t key = k_spin_lock(&pending_report_lock);
+    clear_pending_motion();
+    pending_report.valid = false;
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+    pending_abs_report_valid = false;
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+    k_spin_unlock(&pending_report_lock, key);
+}
+
+static void mouse_notify_sent(struct bt_conn *conn, void *user_data);
+
+union mouse_hog_report {
+    struct zmk_hid_mouse_report_body rel;
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+    struct zmk_hid_mouse_abs_report_body abs;
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+};
+
+#define MOUSE_NOTIFY_RETRY_MS 10
+
+void send_mouse_report_callback(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(mouse_retry_work, send_mouse_report_callback);
+
+// A notification that failed for lack of buffers, which is sent once more before anything newer.
+static union mouse_hog_report retry_report;
+static const struct bt_gatt_attr *retry_attr;
+static uint16_t retry_len;
+static bool retry_pending;
+
+static bool next_notification(union mouse_hog_report *report,
+                              struct bt_gatt_notify_params *params) {
+    if (retry_pending) {
+        retry_pending = false;
+        *report = retry_report;
+        params->attr = retry_attr;
+        params->data = report;
+        params->len = retry_len;
+        return true;
+    }
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+    // A new position goes first, so buttons changed along with it apply where the pointer is now.
+    // Positions are dropped for a host that only subscribed to the relative report.
+    if (next_abs_report(&report->abs) && host_requests_abs_notification) {
+        params->attr = &mouse_hog_svc.attrs[MOUSE_ABS_INPUT_ATTR_INDEX];
+        params->data = &report->abs;
+        params->len = sizeof(report->abs);
+        return true;
+    }
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+
+    if (next_report(&report->rel)) {
+        params->attr = &mouse_hog_svc.attrs[MOUSE_INPUT_ATTR_INDEX];
+        params->data = &report->rel;
+        params->len = sizeof(report->rel);
+        return true;
+    }
+
+    return false;
+}
+
 void send_mouse_report_callback(struct k_work *work) {
-    struct zmk_hid_mouse_report_body report;
-    while (k_msgq_get(&zmk_hog_mouse_msgq, &report, K_NO_WAIT) == 0) {
-        struct bt_conn *conn = destination_connection();
-        if (conn == NULL) {
-            return;
-        }
+    union mouse_hog_report report;
+
+    if (!atomic_cas(&notify_in_flight, false, true)) {
+        return;
+    }
+
+    struct bt_conn *conn = destination_connection();
+    if (conn == NULL) {
+        // Don't let motion pile up for the host to replay in one jump once it connects.
+        discard_reports();
+        retry_pending = false;
+        atomic_clear(&notify_in_flight);
+        return;
+    }
+
+    struct bt_gatt_notify_params notify_params = {
+        .func = mouse_notify_sent,
+    };
+
+    bool is_retry = retry_pending;
 
-        struct bt_gatt_notify_params notify_params = {
-            .attr = &mouse_hog_svc.attrs[3],
-            .data = &report,
-            .len = sizeof(report),
-        };
+    if (!next_notification(&report, &notify_params)) {
+        atomic_clear(&notify_in_flight);
+        bt_conn_unref(conn);
+        return;
+    }
+
+    int err = bt_gatt_notify_cb(conn, &notify_params);
+    if (err) {
+        atomic_clear(&notify_in_flight);
 
-        int err = bt_gatt_notify_cb(conn, &notify_params);
-        if (err == -EPERM) {
+        switch (err) {
+        case -ENOMEM:
+        case -ENOBUFS:
+        case -EAGAIN:
+            if (is_retry) {
+                LOG_WRN("Dropping mouse report after notifying failed again (err %d)", err);
+                break;
+            }
+
+            // Buffers are shared with other traffic, so don't rely on a completion of our own.
+            retry_report = report;
+            retry_attr = notify_params.attr;
+            retry_len = notify_params.len;
+            retry_pending = true;
+            k_work_schedule_for_queue(&mouse_hog_work_q, &mouse_retry_work,
+                                      K_MSEC(MOUSE_NOTIFY_RETRY_MS));
+            break;
+        case -EPERM:
             bt_conn_set_security(conn, BT_SECURITY_L2);
-        } else if (err) {
+            break;
+        default:
             LOG_DBG("Error notifying %d", err);
+            break;
         }
-
-        bt_conn_unref(conn);
     }
+
+    bt_conn_unref(conn);
 };
 
 K_WORK_DEFINE(hog_mouse_work, send_mouse_report_callback);
 
+static void mouse_notify_sent(struct bt_conn *conn, void *user_data) {
+    atomic_clear(&notify_in_flight);
+    k_work_submit_to_queue(&mouse_hog_work_q, &hog_mouse_work);
+}
+
+static void mouse_hog_disconnected(struct bt_conn *conn, uint8_t reason) {
+    // The completion of a notification to a dropped connection may never arrive.
+    atomic_clear(&notify_in_flight);
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+    resolution_features[bt_conn_index(conn)].wheel_resolution = 0;
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+}
+
+BT_CONN_CB_DEFINE(mouse_hog_conn_callbacks) = {
+    .disconnected = mouse_hog_disconnected,
+};
+
 int zmk_mouse_hog_send_mouse_report(struct zmk_hid_mouse_report_body *report) {
-    int err = k_msgq_put(&zmk_hog_mouse_msgq, report, K_MSEC(100));
-    if (err) {
-        switch (err) {
-        case -EAGAIN: {
-            LOG_WRN("Consumer message queue full, popping first message and queueing again");
-            struct zmk_hid_mouse_report_body discarded_report;
-            k_msgq_get(&zmk_hog_mouse_msgq, &discarded_report, K_NO_WAIT);
-            return zmk_mouse_hog_send_mouse_report(report);
-        }
-        default:
-            LOG_WRN("Failed to queue mouse report to send (%d)", err);
-            return err;
-        }
+    k_spinlock_key_t key = k_spin_lock(&pending_report_lock);
+
+    if (pending_report.valid && pending_report.buttons != report->buttons) {
+        struct zmk_hid_mouse_report_body flushed;
+
+        // Carried over motion is dropped here rather than sent after the button change.
+        take_pending_report(&flushed);
+        queue_report(&flushed);
+        clear_pending_motion();
     }
 
+    pending_report.buttons = report->buttons;
+    pending_report.d_x += report->d_x;
+    pending_report.d_y += report->d_y;
+    pending_report.d_scroll_y += report->d_scroll_y;
+    pending_report.d_scroll_x += report->d_scroll_x;
+    pending_report.valid = true;
+
+    k_spin_unlock(&pending_report_lock, key);
+
     k_work_submit_to_queue(&mouse_hog_work_q, &hog_mouse_work);
 
     return 0;
 };
 
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+int zmk_mouse_hog_send_mouse_abs_report(struct zmk_hid_mouse_abs_report_body *report) {
+    k_spinlock_key_t key = k_spin_lock(&pending_report_lock);
+    pending_abs_report = *report;
+    pending_abs_report_valid = true;
+    k_spin_unlock(&pending_report_lock, key);
+
+    k_work_submit_to_queue(&mouse_hog_work_q, &hog_mouse_work);
+
+    return 0;
+}
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+bool zmk_mouse_hog_scroll_high_res(void) {
+    struct bt_conn *conn = bt_conn_lookup_addr_le(BT_ID_DEFAULT, zmk_ble_active_profile_addr());
+    if (conn == NULL) {
+        return false;
+    }
+
+    bool high_res = resolution_features[bt_conn_index(conn)].wheel_resolution != 0;
+    bt_conn_unref(conn);
+    return high_res;
+}
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+
 static int zmk_mouse_hog_init(void) {
     static const struct k_work_queue_config queue_config = {.name =
                                                                 "Mouse HID Over GATT Send Work"};
@@ -197,4 +535,4 @@ static int zmk_mouse_hog_init(void) {
     return 0;
 }
 
-SYS_INIT(zmk_mouse_hog_init, APPLICATION, CONFIG_ZMK_BLE_INIT_PRIORITY);
+ZMK_SYS_INIT(zmk_mouse_hog_init, APPLICATION, CONFIG_ZMK_BLE_INIT_PRIORITY);
@@ -15,6 +15,8 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #include <zephyr/dt-bindings/input/input-event-codes.h>
 
+#include <drivers/input_processor.h>
+
 #include <zmk/endpoints.h>
 #include <zmk/mouse/types.h>
 #include <zmk/mouse/hid.h>
@@ -34,28 +36,61 @@ enum input_listener_xy_data_mode {
 
 struct input_listener_xy_data {
     enum input_listener_xy_data_mode mode;
-    int16_t x;
-    int16_t y;
+    int32_t x;
+    int32_t y;
+};
+
+// What scaling left over of each relative axis, in units of 1 / scale_divisor, carried into the
+// next frame so slow motion isn't lost to rounding.
+enum input_listener_scale_axis {
+    SCALE_AXIS_X,
+    SCALE_AXIS_Y,
+    SCALE_AXIS_WHEEL,
+    SCALE_AXIS_HWHEEL,
+    SCALE_AXIS_COUNT,
+};
+
+struct input_listener_processor {
+    const struct device *dev;
+    uint32_t param1;
+    uint32_t param2;
+};
+
+struct input_listener_config {
+    bool xy_swap;
+    bool x_invert;
+    bool y_invert;
+    uint16_t scale_multiplier;
+    uint16_t scale_divisor;
+    uint16_t x_abs_max;
+    uint16_t y_abs_max;
+    size_t processors_len;
+    const struct input_listener_processor *processors;
 };
 
 struct input_listener_data {
+    const struct input_listener_config *config;
+
     union {
         struct {
             struct input_listener_xy_data data;
+            // In 1 / ZMK_MOUSE_HID_SCROLL_PER_DETENT detents.
             struct input_listener_xy_data wheel_data;
+            // Scrolling too small for a step at the host's resolution, carried into the next one.
+            struct input_listener_xy_data wheel_remainder;
+            // The position is kept between reports, since devices only report the axes that moved.
+            struct input_listener_xy_data abs_data;
 
             uint8_t button_set;
             uint8_t button_clear;
         } mouse;
     };
-};
 
-struct input_listener_config {
-    bool xy_swap;
-    bool x_invert;
-    bool y_invert;
-    uint16_t scale_multiplier;
-    uint16_t scale_divisor;
+    int32_t scale_remainders[SCALE_AXIS_COUNT];
+
+#if CONFIG_ZMK_INPUT_LISTENER_REPORT_INTERVAL_MS > 0
+    struct k_work_delayable report_work;
+#endif
 };
 
 static void handle_rel_code(struct input_listener_data *data, struct input_event *evt) {
@@ -70,9 +105,17 @@ static void handle_rel_code(struct input_listener_data *data, struct input_event
         break;
     case INPUT_REL_WHEEL:
         data->mouse.wheel_data.mode = INPUT_LISTENER_XY_DATA_MODE_REL;
-        data->mouse.wheel_data.y += evt->value;
+        data->mouse.wheel_data.y += evt->value * ZMK_MOUSE_HID_SCROLL_PER_DETENT;
         break;
     case INPUT_REL_HWHEEL:
+        data->mouse.wheel_data.mode = INPUT_LISTENER_XY_DATA_MODE_REL;
+        data->mouse.wheel_data.x += evt->value * ZMK_MOUSE_HID_SCROLL_PER_DETENT;
+        break;
+    case INPUT_REL_WHEEL_HI_RES:
+        data->mouse.wheel_data.mode = INPUT_LISTENER_XY_DATA_MODE_REL;
+        data->mouse.wheel_data.y += evt->value;
+        break;
+    case INPUT_REL_HWHEEL_HI_RES:
         data->mouse.wheel_data.mode = INPUT_LISTENER_XY_DATA_MODE_REL;
         data->mouse.wheel_data.x += evt->value;
         break;
@@ -82,7 +125,22 @@ static void handle_rel_code(struct input_listener_data *data, struct input_event
 }
 
 static void handle_abs_code(const struct input_listener_config *config,
-                            struct input_listener_data *data, struct input_event *evt) {}
+                            struct input_listener_data *data, struct input_event *evt) {
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+    switch (evt->code) {
+    case INPUT_ABS_X:
+        data->mouse.abs_data.mode = INPUT_LISTENER_XY_DATA_MODE_ABS;
+        data->mouse.abs_data.x = evt->value;
+        break;
+    case INPUT_ABS_Y:
+        data->mouse.abs_data.mode = INPUT_LISTENER_XY_DATA_MODE_ABS;
+        data->mouse.abs_data.y = evt->value;
+        break;
+    default:
+        break;
+    }
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+}
 
 static void handle_key_code(const struct input_listener_config *config,
                             struct input_listener_data *data, struct input_event *evt) {
@@ -106,114 +164,349 @@ static void handle_key_code(const struct input_listener_config *config,
     }
 }
 
-static void swap_xy(struct input_event *evt) {
-    switch (evt->code) {
-    case INPUT_REL_X:
-        evt->code = INPUT_REL_Y;
-        break;
-    case INPUT_REL_Y:
-        evt->code = INPUT_REL_X;
-        break;
+static int32_t scale(const struct input_listener_config *cfg, int32_t value, int32_t *remainder) {
+    int32_t scaled = value * cfg->scale_multiplier + *remainder;
+    int32_t result = scaled / cfg->scale_divisor;
+
+    *remainder = scaled - result * cfg->scale_divisor;
+    return result;
+}
+
+// Applies the listener's own swap, invert and scale settings, before any input processors.
+static void filter_with_input_config(const struct input_listener_config *cfg,
+                                     struct input_listener_data *data,
+                                     struct zmk_input_processor_frame *frame) {
+    if (cfg->xy_swap) {
+        int32_t x = frame->x;
+        frame->x = frame->y;
+        frame->y = x;
     }
+
+    if (cfg->x_invert) {
+        frame->x = -frame->x;
+    }
+
+    if (cfg->y_invert) {
+        frame->y = -frame->y;
+    }
+
+    frame->x = scale(cfg, frame->x, &data->scale_remainders[SCALE_AXIS_X]);
+    frame->y = scale(cfg, frame->y, &data->scale_remainders[SCALE_AXIS_Y]);
+    frame->scroll_x = scale(cfg, frame->scroll_x, &data->scale_remainders[SCALE_AXIS_HWHEEL]);
+    frame->scroll_y = scale(cfg, frame->scroll_y, &data->scale_remainders[SCALE_AXIS_WHEEL]);
 }
 
-static inline bool is_x_data(const struct input_event *evt) {
-    return evt->type == INPUT_EV_REL && evt->code == INPUT_REL_X;
+static void process_frame(const struct input_listener_config *cfg,
+                          struct input_listener_data *data,
+                          struct zmk_input_processor_frame *frame) {
+    filter_with_input_config(cfg, data, frame);
+
+    for (size_t i = 0; i < cfg->processors_len; i++) {
+        const struct input_listener_processor *proc = &cfg->processors[i];
+        int err =
+            zmk_input_processor_process_frame(proc->dev, frame, proc->param1, proc->param2);
+        if (err < 0) {
+            LOG_WRN("Input processor %s failed (%d)", proc->dev->name, err);
+        }
+    }
 }
 
-static inline bool is_y_data(const struct input_event *evt) {
-    return evt->type == INPUT_EV_REL && evt->code == INPUT_REL_Y;
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+// Maps an absolute position from the range of the device's axis onto the range of the report.
+static uint16_t normalize_abs(int32_t value, uint16_t max) {
+    return CLAMP((int64_t)value * ZMK_MOUSE_HID_ABS_MAX / MAX(max, 1), 0, ZMK_MOUSE_HID_ABS_MAX);
 }
 
-static void filter_with_input_config(const struct input_listener_config *cfg,
-                                     struct input_event *evt) {
-    if (!evt->dev) {
-        return;
-    }
+static void send_abs_report(const struct input_listener_config *cfg,
+                            struct input_listener_data *data) {
+    uint16_t x = normalize_abs(data->mouse.abs_data.x, cfg->x_abs_max);
+    uint16_t y = normalize_abs(data->mouse.abs_data.y, cfg->y_abs_max);
 
     if (cfg->xy_swap) {
-        swap_xy(evt);
+        uint16_t swapped = x;
+        x = y;
+        y = swapped;
     }
 
-    if ((cfg->x_invert && is_x_data(evt)) || (cfg->y_invert && is_y_data(evt))) {
-        evt->value = -(evt->value);
+    if (cfg->x_invert) {
+        x = ZMK_MOUSE_HID_ABS_MAX - x;
     }
 
-    evt->value = (int16_t)((evt->value * cfg->scale_multiplier) / cfg->scale_divisor);
+    if (cfg->y_invert) {
+        y = ZMK_MOUSE_HID_ABS_MAX - y;
+    }
+
+    zmk_hid_mouse_abs_position_set(x, y);
+    zmk_endpoints_send_mouse_abs_report();
+    data->mouse.abs_data.mode = INPUT_LISTENER_XY_DATA_MODE_NONE;
 }
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
 
 static void clear_xy_data(struct input_listener_xy_data *data) {
     data->x = data->y = 0;
     data->mode = INPUT_LISTENER_XY_DATA_MODE_NONE;
 }
 
-static void input_handler(const struct input_listener_config *config,
-                          struct input_listener_data *data, struct input_event *evt) {
-    // First, filter to update the event data as needed.
-    filter_with_input_config(config, evt);
+// Converts scrolling to steps of the resolution the host takes, keeping what's left for later.
+static int16_t take_scroll(int32_t scroll, int32_t *remainder, int multiplier) {
+    int32_t total = scroll * multiplier + *remainder;
+    int32_t steps = total / ZMK_MOUSE_HID_SCROLL_PER_DETENT;
 
-    switch (evt->type) {
-    case INPUT_EV_REL:
-        handle_rel_code(data, evt);
-        break;
-    case INPUT_EV_ABS:
-        handle_abs_code(config, data, evt);
-        break;
-    case INPUT_EV_KEY:
-        handle_key_code(config, data, evt);
-        break;
+    *remainder = total - steps * ZMK_MOUSE_HID_SCROLL_PER_DETENT;
+    return CLAMP(steps, INT16_MIN, INT16_MAX);
+}
+
+#define IL_REPORT_LOCK                                                                             \
+    (CONFIG_ZMK_INPUT_LISTENER_REPORT_INTERVAL_MS > 0 ||                                           \
+     CONFIG_ZMK_INPUT_LISTENER_BUTTON_COALESCE_MS > 0)
+
+#if IL_REPORT_LOCK
+// Listeners share the mouse report, and accumulate from the input thread while reports can also be
+// sent from the system work queue.
+static K_MUTEX_DEFINE(report_lock);
+#endif
+
+#if CONFIG_ZMK_INPUT_LISTENER_BUTTON_COALESCE_MS > 0
+
+/*
+ * A button change made while the pointer is moving is held for the next motion report instead of
+ * getting a report of its own, so a click-drag takes one report per frame. Only one change is held
+ * at a time, so the host still sees every press and release.
+ */
+static bool buttons_pending;
+// Uptime of the last report with motion or scrolling, or 0 if there wasn't one yet.
+static int64_t last_motion_report;
+
+static void send_pending_buttons(void) {
+    if (buttons_pending) {
+        buttons_pending = false;
+        zmk_endpoints_send_mouse_report();
     }
+}
 
-    if (evt->sync) {
-        if (data->mouse.wheel_data.mode == INPUT_LISTENER_XY_DATA_MODE_REL) {
-            zmk_hid_mouse_scroll_set(data->mouse.wheel_data.x, data->mouse.wheel_data.y);
+static void button_work_cb(struct k_work *work) {
+    k_mutex_lock(&report_lock, K_FOREVER);
+    send_pending_buttons();
+    k_mutex_unlock(&report_lock);
+}
+
+static K_WORK_DELAYABLE_DEFINE(button_work, button_work_cb);
+
+static bool hold_buttons(void) {
+    if (last_motion_report == 0 ||
+        k_uptime_get() - last_motion_report > CONFIG_ZMK_INPUT_LISTENER_BUTTON_COALESCE_MS) {
+        return false;
+    }
+
+    buttons_pending = true;
+    k_work_reschedule(&button_work, K_MSEC(CONFIG_ZMK_INPUT_LISTENER_BUTTON_COALESCE_MS));
+    return true;
+}
+
+static void motion_reported(void) {
+    last_motion_report = k_uptime_get();
+    // The motion report carried any held buttons along.
+    buttons_pending = false;
+    k_work_cancel_delayable(&button_work);
+}
+
+#endif // CONFIG_ZMK_INPUT_LISTENER_BUTTON_COALESCE_MS > 0
+
+static void send_report(struct input_listener_data *data) {
+    const struct input_listener_config *cfg = data->config;
+    bool moved = data->mouse.data.mode == INPUT_LISTENER_XY_DATA_MODE_REL;
+    bool scrolled = data->mouse.wheel_data.mode == INPUT_LISTENER_XY_DATA_MODE_REL;
+
+    if (moved || scrolled) {
+        struct zmk_input_processor_frame frame = {
+            .x = data->mouse.data.x,
+            .y = data->mouse.data.y,
+            .scroll_x = data->mouse.wheel_data.x,
+            .scroll_y = data->mouse.wheel_data.y,
+            .timestamp = k_uptime_get(),
+        };
+
+        process_frame(cfg, data, &frame);
+
+        // Processors can turn motion into scrolling.
+        scrolled = scrolled || frame.scroll_x != 0 || frame.scroll_y != 0;
+
+        if (scrolled) {
+            int multiplier = zmk_endpoints_mouse_scroll_multiplier();
+
+            zmk_hid_mouse_scroll_set(
+                take_scroll(frame.scroll_x, &data->mouse.wheel_remainder.x, multiplier),
+                take_scroll(frame.scroll_y, &data->mouse.wheel_remainder.y, multiplier));
         }
 
-        if (data->mouse.data.mode == INPUT_LISTENER_XY_DATA_MODE_REL) {
-            zmk_hid_mouse_movement_set(data->mouse.data.x, data->mouse.data.y);
+        if (moved) {
+            zmk_hid_mouse_movement_set(CLAMP(frame.x, INT16_MIN, INT16_MAX),
+                                       CLAMP(frame.y, INT16_MIN, INT16_MAX));
         }
+    }
+
+    bool buttons_changed = data->mouse.button_set != 0 || data->mouse.button_clear != 0;
 
-        if (data->mouse.button_set != 0) {
-            for (int i = 0; i < ZMK_MOUSE_HID_NUM_BUTTONS; i++) {
-                if ((data->mouse.button_set & BIT(i)) != 0) {
-                    zmk_hid_mouse_button_press(i);
-                }
+#if CONFIG_ZMK_INPUT_LISTENER_BUTTON_COALESCE_MS > 0
+    // A held change has to reach the host before the next one is made.
+    if (buttons_changed) {
+        send_pending_buttons();
+    }
+#endif
+
+    if (data->mouse.button_set != 0) {
+        for (int i = 0; i < ZMK_MOUSE_HID_NUM_BUTTONS; i++) {
+            if ((data->mouse.button_set & BIT(i)) != 0) {
+                zmk_hid_mouse_button_press(i);
             }
         }
+    }
 
-        if (data->mouse.button_clear != 0) {
-            for (int i = 0; i < ZMK_MOUSE_HID_NUM_BUTTONS; i++) {
-                if ((data->mouse.button_clear & BIT(i)) != 0) {
-                    zmk_hid_mouse_button_release(i);
-                }
+    if (data->mouse.button_clear != 0) {
+        for (int i = 0; i < ZMK_MOUSE_HID_NUM_BUTTONS; i++) {
+            if ((data->mouse.button_clear & BIT(i)) != 0) {
+                zmk_hid_mouse_button_release(i);
             }
         }
+    }
 
+    bool send_rel = true;
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+    if (data->mouse.abs_data.mode == INPUT_LISTENER_XY_DATA_MODE_ABS) {
+        send_abs_report(cfg, data);
+
+        // The relative pointer only needs a report for its own motion, or to see the buttons too.
+        send_rel = moved || scrolled || buttons_changed;
+    }
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+
+#if CONFIG_ZMK_INPUT_LISTENER_BUTTON_COALESCE_MS > 0
+    if (moved || scrolled) {
+        motion_reported();
+    } else if (send_rel && buttons_changed && hold_buttons()) {
+        send_rel = false;
+    }
+#endif
+
+    if (send_rel) {
         zmk_endpoints_send_mouse_report();
-        zmk_hid_mouse_scroll_set(0, 0);
-        zmk_hid_mouse_movement_set(0, 0);
+    }
+    zmk_hid_mouse_scroll_set(0, 0);
+    zmk_hid_mouse_movement_set(0, 0);
 
-        clear_xy_data(&data->mouse.data);
-        clear_xy_data(&data->mouse.wheel_data);
+    clear_xy_data(&data->mouse.data);
+    clear_xy_data(&data->mouse.wheel_data);
+
+    data->mouse.button_set = data->mouse.button_clear = 0;
+}
 
-        data->mouse.button_set = data->mouse.button_clear = 0;
+#if CONFIG_ZMK_INPUT_LISTENER_REPORT_INTERVAL_MS > 0
+
+/*
+ * Motion is only sent once per report interval, summed over every sync in between, so a sensor
+ * reporting faster than the host polls doesn't queue up reports the transport can't deliver.
+ * Button changes are sent right away, along with the motion accumulated so far.
+ */
+static void report_work_cb(struct k_work *work) {
+    struct input_listener_data *data =
+        CONTAINER_OF(k_work_delayable_from_work(work), struct input_listener_data, report_work);
+
+    k_mutex_lock(&report_lock, K_FOREVER);
+    if (data->mouse.data.mode != INPUT_LISTENER_XY_DATA_MODE_NONE ||
+        data->mouse.wheel_data.mode != INPUT_LISTENER_XY_DATA_MODE_NONE ||
+        data->mouse.abs_data.mode != INPUT_LISTENER_XY_DATA_MODE_NONE) {
+        send_report(data);
+    }
+    k_mutex_unlock(&report_lock);
+}
+
+static void input_synced(struct input_listener_data *data) {
+    if (data->mouse.button_set != 0 || data->mouse.button_clear != 0) {
+        k_work_cancel_delayable(&data->report_work);
+        send_report(data);
+        return;
+    }
+
+    if (!k_work_delayable_is_pending(&data->report_work)) {
+        k_work_schedule(&data->report_work, K_MSEC(CONFIG_ZMK_INPUT_LISTENER_REPORT_INTERVAL_MS));
+    }
+}
+
+#define INPUT_LISTENER_DATA_INIT(n)                                                                \
+    {.config = &config_##n, .report_work = Z_WORK_DELAYABLE_INITIALIZER(report_work_cb)}
+
+#else
+
+static void input_synced(struct input_listener_data *data) { send_report(data); }
+
+#define INPUT_LISTENER_DATA_INIT(n) {.config = &config_##n}
+
+#endif // CONFIG_ZMK_INPUT_LISTENER_REPORT_INTERVAL_MS > 0
+
+static void handle_input_event(const struct input_listener_config *config,
+                               struct input_listener_data *data, struct input_event *evt) {
+    switch (evt->type) {
+    case INPUT_EV_REL:
+        handle_rel_code(data, evt);
+        break;
+    case INPUT_EV_ABS:
+        handle_abs_code(config, data, evt);
+        break;
+    case INPUT_EV_KEY:
+        handle_key_code(config, data, evt);
+        break;
+    }
+
+    if (evt->sync) {
+        input_synced(data);
     }
 }
 
+static void input_handler(const struct input_listener_config *config,
+                          struct input_listener_data *data, struct input_event *evt) {
+#if IL_REPORT_LOCK
+    k_mutex_lock(&report_lock, K_FOREVER);
+    handle_input_event(config, data, evt);
+    k_mutex_unlock(&report_lock);
+#else
+    handle_input_event(config, data, evt);
+#endif
+}
+
 #endif // VALID_LISTENER_COUNT > 0
 
+#define IL_PROCESSOR(node_id, prop, idx)                                                           \
+    {                                                                                              \
+        .dev = DEVICE_DT_GET(DT_PHANDLE_BY_IDX(node_id, prop, idx)),                               \
+        .param1 = COND_CODE_1(DT_PHA_HAS_CELL_AT_IDX(node_id, prop, idx, param1),                  \
+                              (DT_PHA_BY_IDX(node_id, prop, idx, param1)), (0)),                   \
+        .param2 = COND_CODE_1(DT_PHA_HAS_CELL_AT_IDX(node_id, prop, idx, param2),                  \
+                              (DT_PHA_BY_IDX(node_id, prop, idx, param2)), (0)),                   \
+    },
+
+#define IL_PROCESSORS(n)                                                                           \
+    static const struct input_listener_processor processors_##n[] = {                             \
+        DT_INST_FOREACH_PROP_ELEM(n, input_processors, IL_PROCESSOR)};
+
 #define IL_INST(n)                                                                                 \
     COND_CODE_1(                                                                                   \
         DT_NODE_HAS_STATUS(DT_INST_PHANDLE(n, device), okay),                                      \
-        (static const struct input_listener_config config_##n =                                    \
+        (COND_CODE_1(DT_INST_NODE_HAS_PROP(n, input_processors), (IL_PROCESSORS(n)), ())          \
+         static const struct input_listener_config config_##n =                                    \
              {                                                                                     \
                  .xy_swap = DT_INST_PROP(n, xy_swap),                                              \
                  .x_invert = DT_INST_PROP(n, x_invert),                                            \
                  .y_invert = DT_INST_PROP(n, y_invert),                                            \
                  .scale_multiplier = DT_INST_PROP(n, scale_multiplier),                            \
                  .scale_divisor = DT_INST_PROP(n, scale_divisor),                                  \
+                 .x_abs_max = DT_INST_PROP(n, x_abs_max),                                          \
+                 .y_abs_max = DT_INST_PROP(n, y_abs_max),                                          \
+                 .processors_len = DT_INST_PROP_LEN_OR(n, input_processors, 0),                    \
+                 .processors = COND_CODE_1(DT_INST_NODE_HAS_PROP(n, input_processors),             \
+                                           (processors_##n), (NULL)),                              \
              };                                                                                    \
-         static struct input_listener_data data_##n = {};                                          \
+         static struct input_listener_data data_##n = INPUT_LISTENER_DATA_INIT(n);                 \
          void input_handler_##n(struct input_event *evt) {                                         \
              input_handler(&config_##n, &data_##n, evt);                                           \
          } INPUT_CALLBACK_DEFINE(DEVICE_DT_GET(DT_INST_PHANDLE(n, device)), input_handler_##n);),  \
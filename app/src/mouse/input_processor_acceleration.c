@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define DT_DRV_COMPAT zmk_input_processor_acceleration
+
+#include <stdlib.h>
+
+#include <zephyr/device.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include <drivers/input_processor.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+// Factors are in thousandths.
+#define FACTOR_ONE 1000
+
+// Frames further apart than this start a new motion, whose speed isn't known yet.
+#define MOTION_GAP_MS 100
+
+struct ip_acceleration_config {
+    uint16_t min_factor;
+    uint16_t max_factor;
+    uint32_t speed_threshold;
+    uint32_t speed_max;
+    uint8_t acceleration_exponent;
+};
+
+struct ip_acceleration_data {
+    int64_t last_timestamp;
+    int32_t remainder_x;
+    int32_t remainder_y;
+};
+
+// Within 7% of the length of the vector, without taking a square root.
+static uint32_t approx_magnitude(int32_t x, int32_t y) {
+    uint32_t ax = abs(x);
+    uint32_t ay = abs(y);
+
+    return MAX(ax, ay) + MIN(ax, ay) * 3 / 8;
+}
+
+static uint32_t factor_for_speed(const struct ip_acceleration_config *cfg, uint32_t speed) {
+    if (speed <= cfg->speed_threshold) {
+        return cfg->min_factor;
+    }
+
+    if (speed >= cfg->speed_max) {
+        return cfg->max_factor;
+    }
+
+    // How far between the two speeds this one is, from 0 to FACTOR_ONE.
+    int64_t position = (int64_t)(speed - cfg->speed_threshold) * FACTOR_ONE /
+                       (cfg->speed_max - cfg->speed_threshold);
+    int64_t curve = FACTOR_ONE;
+    for (int i = 0; i < cfg->acceleration_exponent; i++) {
+        curve = curve * position / FACTOR_ONE;
+    }
+
+    return cfg->min_factor + ((int64_t)cfg->max_factor - cfg->min_factor) * curve / FACTOR_ONE;
+}
+
+static int32_t apply_factor(int32_t value, uint32_t factor, int32_t *remainder) {
+    int64_t scaled = (int64_t)value * factor + *remainder;
+    int32_t result = scaled / FACTOR_ONE;
+
+    *remainder = scaled - (int64_t)result * FACTOR_ONE;
+    return result;
+}
+
+static int ip_acceleration_process_frame(const struct device *dev,
+                                         struct zmk_input_processor_frame *frame, uint32_t param1,
+                                         uint32_t param2) {
+    const struct ip_acceleration_config *cfg = dev->config;
+    struct ip_acceleration_data *data = dev->data;
+
+    if (frame->x == 0 && frame->y == 0) {
+        return 0;
+    }
+
+    int64_t elapsed = frame->timestamp - data->last_timestamp;
+    data->last_timestamp = frame->timestamp;
+
+    uint32_t speed = 0;
+    if (elapsed <= MOTION_GAP_MS) {
+        speed = (uint64_t)approx_magnitude(frame->x, frame->y) * 1000 / MAX(elapsed, 1);
+    }
+
+    uint32_t factor = factor_for_speed(cfg, speed);
+    frame->x = apply_factor(frame->x, factor, &data->remainder_x);
+    frame->y = apply_factor(frame->y, factor, &data->remainder_y);
+
+    return 0;
+}
+
+static const struct input_processor_driver_api ip_acceleration_driver_api = {
+    .process_frame = ip_acceleration_process_frame,
+};
+
+#define ACCEL_INST(n)                                                                              \
+    BUILD_ASSERT(DT_INST_PROP(n, speed_max) > DT_INST_PROP(n, speed_threshold),                    \
+                 "speed-max must be larger than speed-threshold");                                 \
+    static struct ip_acceleration_data ip_acceleration_data_##n = {};                              \
+    static const struct ip_acceleration_config ip_acceleration_config_##n = {                      \
+        .min_factor = DT_INST_PROP(n, min_factor),                                                 \
+        .max_factor = DT_INST_PROP(n, max_factor),                                                 \
+        .speed_threshold = DT_INST_PROP(n, speed_threshold),                                       \
+        .speed_max = DT_INST_PROP(n, speed_max),                                                   \
+        .acceleration_exponent = DT_INST_PROP(n, acceleration_exponent),                           \
+    };                                                                                             \
+    DEVICE_DT_INST_DEFINE(n, NULL, NULL, &ip_acceleration_data_##n, &ip_acceleration_config_##n,   \
+                          POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT,                        \
+                          &ip_acceleration_driver_api);
+
+DT_INST_FOREACH_STATUS_OKAY(ACCEL_INST)
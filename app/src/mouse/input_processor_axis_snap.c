@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define DT_DRV_COMPAT zmk_input_processor_axis_snap
+
+#include <stdlib.h>
+
+#include <zephyr/device.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include <drivers/input_processor.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+enum snap_axis {
+    SNAP_AXIS_NONE,
+    SNAP_AXIS_X,
+    SNAP_AXIS_Y,
+};
+
+struct ip_axis_snap_config {
+    uint16_t threshold;
+    uint16_t timeout_ms;
+};
+
+struct ip_axis_snap_data {
+    int64_t last_timestamp;
+    // Distance moved along each axis before one was chosen.
+    uint32_t total_x;
+    uint32_t total_y;
+    enum snap_axis axis;
+};
+
+static int ip_axis_snap_process_frame(const struct device *dev,
+                                      struct zmk_input_processor_frame *frame, uint32_t param1,
+                                      uint32_t param2) {
+    const struct ip_axis_snap_config *cfg = dev->config;
+    struct ip_axis_snap_data *data = dev->data;
+
+    if (frame->timestamp - data->last_timestamp > cfg->timeout_ms) {
+        data->total_x = data->total_y = 0;
+        data->axis = SNAP_AXIS_NONE;
+    }
+    data->last_timestamp = frame->timestamp;
+
+    if (data->axis == SNAP_AXIS_NONE) {
+        data->total_x += abs(frame->x);
+        data->total_y += abs(frame->y);
+
+        if (MAX(data->total_x, data->total_y) >= cfg->threshold) {
+            data->axis = data->total_x >= data->total_y ? SNAP_AXIS_X : SNAP_AXIS_Y;
+            LOG_DBG("Snapped to the %c axis", data->axis == SNAP_AXIS_X ? 'X' : 'Y');
+        }
+    }
+
+    switch (data->axis) {
+    case SNAP_AXIS_X:
+        frame->y = 0;
+        break;
+    case SNAP_AXIS_Y:
+        frame->x = 0;
+        break;
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+static const struct input_processor_driver_api ip_axis_snap_driver_api = {
+    .process_frame = ip_axis_snap_process_frame,
+};
+
+#define AXIS_SNAP_INST(n)                                                                          \
+    static struct ip_axis_snap_data ip_axis_snap_data_##n = {};                                    \
+    static const struct ip_axis_snap_config ip_axis_snap_config_##n = {                            \
+        .threshold = DT_INST_PROP(n, threshold),                                                   \
+        .timeout_ms = DT_INST_PROP(n, timeout_ms),                                                 \
+    };                                                                                             \
+    DEVICE_DT_INST_DEFINE(n, NULL, NULL, &ip_axis_snap_data_##n, &ip_axis_snap_config_##n,         \
+                          POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT,                        \
+                          &ip_axis_snap_driver_api);
+
+DT_INST_FOREACH_STATUS_OKAY(AXIS_SNAP_INST)
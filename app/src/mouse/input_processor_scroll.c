@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define DT_DRV_COMPAT zmk_input_processor_scroll
+
+#include <zephyr/device.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include <drivers/input_processor.h>
+
+#include <zmk/keymap.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+struct ip_scroll_config {
+    uint16_t scale_multiplier;
+    uint16_t scale_divisor;
+    bool x_invert;
+    bool y_invert;
+    size_t layers_len;
+    const uint8_t *layers;
+};
+
+struct ip_scroll_data {
+    int32_t remainder_x;
+    int32_t remainder_y;
+};
+
+static bool layers_active(const struct ip_scroll_config *cfg) {
+    if (cfg->layers_len == 0) {
+        return true;
+    }
+
+    for (size_t i = 0; i < cfg->layers_len; i++) {
+        if (zmk_keymap_layer_active(cfg->layers[i])) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int32_t scale(const struct ip_scroll_config *cfg, int32_t value, int32_t *remainder) {
+    int32_t scaled = value * cfg->scale_multiplier + *remainder;
+    int32_t result = scaled / cfg->scale_divisor;
+
+    *remainder = scaled - result * cfg->scale_divisor;
+    return result;
+}
+
+static int ip_scroll_process_frame(const struct device *dev,
+                                   struct zmk_input_processor_frame *frame, uint32_t param1,
+                                   uint32_t param2) {
+    const struct ip_scroll_config *cfg = dev->config;
+    struct ip_scroll_data *data = dev->data;
+
+    if (!layers_active(cfg)) {
+        return 0;
+    }
+
+    // Moving up has a negative Y, but scrolls up with a positive wheel value.
+    int32_t x = cfg->x_invert ? -frame->x : frame->x;
+    int32_t y = cfg->y_invert ? frame->y : -frame->y;
+
+    frame->scroll_x += scale(cfg, x, &data->remainder_x);
+    frame->scroll_y += scale(cfg, y, &data->remainder_y);
+    frame->x = frame->y = 0;
+
+    return 0;
+}
+
+static const struct input_processor_driver_api ip_scroll_driver_api = {
+    .process_frame = ip_scroll_process_frame,
+};
+
+#define SCROLL_LAYERS(n) static const uint8_t ip_scroll_layers_##n[] = DT_INST_PROP(n, layers);
+
+#define SCROLL_INST(n)                                                                             \
+    COND_CODE_1(DT_INST_NODE_HAS_PROP(n, layers), (SCROLL_LAYERS(n)), ())                          \
+    static struct ip_scroll_data ip_scroll_data_##n = {};                                          \
+    static const struct ip_scroll_config ip_scroll_config_##n = {                                  \
+        .scale_multiplier = DT_INST_PROP(n, scale_multiplier),                                     \
+        .scale_divisor = DT_INST_PROP(n, scale_divisor),                                           \
+        .x_invert = DT_INST_PROP(n, x_invert),                                                     \
+        .y_invert = DT_INST_PROP(n, y_invert),                                                     \
+        .layers_len = DT_INST_PROP_LEN_OR(n, layers, 0),                                           \
+        .layers = COND_CODE_1(DT_INST_NODE_HAS_PROP(n, layers), (ip_scroll_layers_##n), (NULL)),   \
+    };                                                                                             \
+    DEVICE_DT_INST_DEFINE(n, NULL, NULL, &ip_scroll_data_##n, &ip_scroll_config_##n, POST_KERNEL,  \
+                          CONFIG_KERNEL_INIT_PRIORITY_DEFAULT, &ip_scroll_driver_api);
+
+DT_INST_FOREACH_STATUS_OKAY(SCROLL_INST)
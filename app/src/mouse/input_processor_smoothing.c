@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define DT_DRV_COMPAT zmk_input_processor_smoothing
+
+#include <zephyr/device.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include <drivers/input_processor.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+struct ip_smoothing_config {
+    uint8_t weight;
+    uint16_t timeout_ms;
+};
+
+// Motion received but not sent yet. Each frame sends a share of it, so a jittery sensor's motion
+// is spread out while the total distance stays the same.
+struct ip_smoothing_data {
+    int64_t last_timestamp;
+    int32_t owed_x;
+    int32_t owed_y;
+};
+
+static int32_t take_share(int32_t *owed, uint8_t weight) {
+    int32_t share = *owed * weight / 100;
+
+    // Always send something, so small amounts don't linger until the next motion.
+    if (share == 0 && *owed != 0) {
+        share = *owed > 0 ? 1 : -1;
+    }
+
+    *owed -= share;
+    return share;
+}
+
+static int ip_smoothing_process_frame(const struct device *dev,
+                                      struct zmk_input_processor_frame *frame, uint32_t param1,
+                                      uint32_t param2) {
+    const struct ip_smoothing_config *cfg = dev->config;
+    struct ip_smoothing_data *data = dev->data;
+
+    if (frame->timestamp - data->last_timestamp > cfg->timeout_ms) {
+        data->owed_x = data->owed_y = 0;
+    }
+    data->last_timestamp = frame->timestamp;
+
+    data->owed_x += frame->x;
+    data->owed_y += frame->y;
+
+    frame->x = take_share(&data->owed_x, cfg->weight);
+    frame->y = take_share(&data->owed_y, cfg->weight);
+
+    return 0;
+}
+
+static const struct input_processor_driver_api ip_smoothing_driver_api = {
+    .process_frame = ip_smoothing_process_frame,
+};
+
+#define SMOOTHING_INST(n)                                                                          \
+    BUILD_ASSERT(DT_INST_PROP(n, weight) > 0 && DT_INST_PROP(n, weight) <= 100,                    \
+                 "weight must be between 1 and 100");                                              \
+    static struct ip_smoothing_data ip_smoothing_data_##n = {};                                    \
+    static const struct ip_smoothing_config ip_smoothing_config_##n = {                            \
+        .weight = DT_INST_PROP(n, weight),                                                         \
+        .timeout_ms = DT_INST_PROP(n, timeout_ms),                                                 \
+    };                                                                                             \
+    DEVICE_DT_INST_DEFINE(n, NULL, NULL, &ip_smoothing_data_##n, &ip_smoothing_config_##n,         \
+                          POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT,                        \
+                          &ip_smoothing_driver_api);
+
+DT_INST_FOREACH_STATUS_OKAY(SMOOTHING_INST)
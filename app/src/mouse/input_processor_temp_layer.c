@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define DT_DRV_COMPAT zmk_input_processor_temp_layer
+
+#include <zephyr/device.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include <drivers/input_processor.h>
+
+#include <zmk/keymap.h>
+#include <zmk/event_manager.h>
+#include <zmk/events/position_state_changed.h>
+#include <zmk/workqueue.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+struct ip_temp_layer_config {
+    uint16_t require_prior_idle_ms;
+};
+
+/*
+ * Frames are processed on the input thread, but the keymap is only changed from the input work
+ * queue, so layers are (de)activated from work items there.
+ */
+struct ip_temp_layer_data {
+    struct k_work activate_work;
+    struct k_work_delayable deactivate_work;
+    // The layer motion asked for, and the one this processor activated, if any.
+    uint8_t requested_layer;
+    int16_t active_layer;
+};
+
+static int64_t last_key_press;
+
+static void activate_work_cb(struct k_work *work) {
+    struct ip_temp_layer_data *data = CONTAINER_OF(work, struct ip_temp_layer_data, activate_work);
+    uint8_t layer = data->requested_layer;
+
+    if (data->active_layer == layer) {
+        return;
+    }
+
+    if (data->active_layer >= 0) {
+        zmk_keymap_layer_deactivate(data->active_layer);
+        data->active_layer = -1;
+    }
+
+    // A layer the user activated stays theirs to deactivate.
+    if (!zmk_keymap_layer_active(layer)) {
+        LOG_DBG("Activating layer %d on motion", layer);
+        zmk_keymap_layer_activate(layer);
+        data->active_layer = layer;
+    }
+}
+
+static void deactivate_work_cb(struct k_work *work) {
+    struct ip_temp_layer_data *data = CONTAINER_OF(k_work_delayable_from_work(work),
+                                                   struct ip_temp_layer_data, deactivate_work);
+
+    if (data->active_layer >= 0) {
+        LOG_DBG("Deactivating layer %d after motion", data->active_layer);
+        zmk_keymap_layer_deactivate(data->active_layer);
+        data->active_layer = -1;
+    }
+}
+
+static int ip_temp_layer_process_frame(const struct device *dev,
+                                       struct zmk_input_processor_frame *frame, uint32_t param1,
+                                       uint32_t param2) {
+    const struct ip_temp_layer_config *cfg = dev->config;
+    struct ip_temp_layer_data *data = dev->data;
+
+    if (frame->x == 0 && frame->y == 0 && frame->scroll_x == 0 && frame->scroll_y == 0) {
+        return 0;
+    }
+
+    if (param1 >= ZMK_KEYMAP_LAYERS_LEN) {
+        LOG_ERR("Invalid layer %d", param1);
+        return -EINVAL;
+    }
+
+    // Motion right after typing is more likely a bump than the start of pointing.
+    if (!k_work_delayable_is_pending(&data->deactivate_work) &&
+        frame->timestamp - last_key_press < cfg->require_prior_idle_ms) {
+        return 0;
+    }
+
+    data->requested_layer = param1;
+    k_work_submit_to_queue(zmk_workqueue_input_work_q(), &data->activate_work);
+    k_work_reschedule_for_queue(zmk_workqueue_input_work_q(), &data->deactivate_work,
+                                K_MSEC(param2));
+
+    return 0;
+}
+
+static int ip_temp_layer_position_listener(const zmk_event_t *eh) {
+    const struct zmk_position_state_changed *ev = as_zmk_position_state_changed(eh);
+
+    if (ev->state) {
+        last_key_press = ev->timestamp;
+    }
+
+    return ZMK_EV_EVENT_BUBBLE;
+}
+
+ZMK_LISTENER(input_processor_temp_layer, ip_temp_layer_position_listener);
+ZMK_SUBSCRIPTION(input_processor_temp_layer, zmk_position_state_changed);
+
+static int ip_temp_layer_init(const struct device *dev) {
+    struct ip_temp_layer_data *data = dev->data;
+
+    data->active_layer = -1;
+    k_work_init(&data->activate_work, activate_work_cb);
+    k_work_init_delayable(&data->deactivate_work, deactivate_work_cb);
+
+    return 0;
+}
+
+static const struct input_processor_driver_api ip_temp_layer_driver_api = {
+    .process_frame = ip_temp_layer_process_frame,
+};
+
+#define TEMP_LAYER_INST(n)                                                                         \
+    static struct ip_temp_layer_data ip_temp_layer_data_##n = {};                                  \
+    static const struct ip_temp_layer_config ip_temp_layer_config_##n = {                          \
+        .require_prior_idle_ms = DT_INST_PROP(n, require_prior_idle_ms),                           \
+    };                                                                                             \
+    DEVICE_DT_INST_DEFINE(n, ip_temp_layer_init, NULL, &ip_temp_layer_data_##n,                    \
+                          &ip_temp_layer_config_##n, POST_KERNEL,                                  \
+                          CONFIG_KERNEL_INIT_PRIORITY_DEFAULT, &ip_temp_layer_driver_api);
+
+DT_INST_FOREACH_STATUS_OKAY(TEMP_LAYER_INST)
@@ -11,9 +11,13 @@
 #include <zephyr/usb/class/usb_hid.h>
 
 #include <zmk/usb.h>
+#include <zmk/usb_hid.h>
 #include <zmk/mouse/hid.h>
+#include <zmk/mouse/usb_hid.h>
 #include <zmk/keymap.h>
 #include <zmk/event_manager.h>
+#include <zmk/events/usb_conn_state_changed.h>
+#include <zmk/boot_timing.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
@@ -37,6 +41,27 @@ static void set_proto_cb(const struct device *dev, uint8_t protocol) { hid_proto
 
 #endif /* IS_ENABLED(CONFIG_ZMK_USB_BOOT) */
 
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+static struct zmk_hid_mouse_resolution_feature_report resolution_feature_report = {
+    .report_id = ZMK_MOUSE_HID_REPORT_ID_MOUSE};
+
+bool zmk_mouse_usb_hid_scroll_high_res(void) {
+    return resolution_feature_report.body.wheel_resolution != 0;
+}
+
+static int usb_hid_mouse_listener(const zmk_event_t *eh) {
+    // The next host to enumerate sets the resolution again if it supports it.
+    if (as_zmk_usb_conn_state_changed(eh)->conn_state != ZMK_USB_CONN_HID) {
+        resolution_feature_report.body.wheel_resolution = 0;
+    }
+
+    return ZMK_EV_EVENT_BUBBLE;
+}
+
+ZMK_LISTENER(usb_hid_mouse, usb_hid_mouse_listener);
+ZMK_SUBSCRIPTION(usb_hid_mouse, zmk_usb_conn_state_changed);
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+
 static int get_report_cb(const struct device *dev, struct usb_setup_packet *setup, int32_t *len,
                          uint8_t **data) {
 
@@ -53,10 +78,24 @@ static int get_report_cb(const struct device *dev, struct usb_setup_packet *setu
 
     switch (setup->wValue & HID_GET_REPORT_ID_MASK) {
     case ZMK_MOUSE_HID_REPORT_ID_MOUSE:
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+        if ((setup->wValue & HID_GET_REPORT_TYPE_MASK) == HID_REPORT_TYPE_FEATURE) {
+            *data = (uint8_t *)&resolution_feature_report;
+            *len = sizeof(resolution_feature_report);
+            break;
+        }
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
         struct zmk_hid_mouse_report *report = zmk_mouse_hid_get_mouse_report();
         *data = (uint8_t *)report;
         *len = sizeof(*report);
         break;
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+    case ZMK_MOUSE_HID_REPORT_ID_ABS_POINTER:
+        struct zmk_hid_mouse_abs_report *abs_report = zmk_mouse_hid_get_mouse_abs_report();
+        *data = (uint8_t *)abs_report;
+        *len = sizeof(*abs_report);
+        break;
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
     default:
         LOG_ERR("Invalid report ID %d requested", setup->wValue & HID_GET_REPORT_ID_MASK);
         return -EINVAL;
@@ -75,6 +114,21 @@ static int set_report_cb(const struct device *dev, struct usb_setup_packet *setu
     }
 
     switch (setup->wValue & HID_GET_REPORT_ID_MASK) {
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
+    case ZMK_MOUSE_HID_REPORT_ID_MOUSE:
+        if ((setup->wValue & HID_GET_REPORT_TYPE_MASK) != HID_REPORT_TYPE_FEATURE ||
+            *len != sizeof(resolution_feature_report)) {
+            LOG_ERR("Invalid resolution multiplier report received");
+            return -EINVAL;
+        }
+
+        struct zmk_hid_mouse_resolution_feature_report *report =
+            (struct zmk_hid_mouse_resolution_feature_report *)*data;
+        resolution_feature_report.body.wheel_resolution = report->body.wheel_resolution & 0x03;
+        LOG_DBG("Scroll resolution multiplier %s",
+                resolution_feature_report.body.wheel_resolution ? "enabled" : "disabled");
+        break;
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_SMOOTH_SCROLLING)
     default:
         LOG_ERR("Invalid report ID %d requested", setup->wValue & HID_GET_REPORT_ID_MASK);
         return -EINVAL;
@@ -126,10 +180,23 @@ int zmk_mouse_usb_hid_send_mouse_report() {
     struct zmk_hid_mouse_report *report = zmk_mouse_hid_get_mouse_report();
     return zmk_mouse_usb_hid_send_report((uint8_t *)report, sizeof(*report));
 }
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
+int zmk_mouse_usb_hid_send_mouse_abs_report() {
+#if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
+    if (hid_protocol == HID_PROTOCOL_BOOT) {
+        return -ENOTSUP;
+    }
+#endif /* IS_ENABLED(CONFIG_ZMK_USB_BOOT) */
+
+    struct zmk_hid_mouse_abs_report *report = zmk_mouse_hid_get_mouse_abs_report();
+    return zmk_mouse_usb_hid_send_report((uint8_t *)report, sizeof(*report));
+}
+#endif // IS_ENABLED(CONFIG_ZMK_MOUSE_ABSOLUTE_POINTER)
 #endif // IS_ENABLED(CONFIG_ZMK_MOUSE)
 
 static int zmk_mouse_usb_hid_init(void) {
-    hid_dev = device_get_binding("HID_1");
+    hid_dev = zmk_usb_hid_get_device(ZMK_USB_HID_DEVICE_MOUSE);
     if (hid_dev == NULL) {
         LOG_ERR("Unable to locate HID device");
         return -EINVAL;
@@ -145,4 +212,4 @@ static int zmk_mouse_usb_hid_init(void) {
     return 0;
 }
 
-SYS_INIT(zmk_mouse_usb_hid_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+ZMK_SYS_INIT(zmk_mouse_usb_hid_init, APPLICATION, CONFIG_ZMK_USB_HID_INIT_PRIORITY);
@@ -16,6 +16,8 @@
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #include <zmk/endpoints.h>
+#include <zmk/pm.h>
+#include <zmk/settings.h>
 
 // Reimplement some of the device work from Zephyr PM to work with the new `sys_poweroff` API.
 // TODO: Tweak this to smarter runtime PM of subsystems on sleep.
@@ -64,16 +66,93 @@ int zmk_pm_suspend_devices(void) {
     return 0;
 }
 
-void zmk_pm_resume_devices(void) {
+/*
+ * Devices which only produce output for the user, so a key press can be handled before they are
+ * resumed. Anything they depend on, such as their bus, is resumed along with the other devices.
+ */
+static bool is_deferred_resume_device(const struct device *dev) {
+#if DT_HAS_CHOSEN(zephyr_display)
+    if (dev == DEVICE_DT_GET(DT_CHOSEN(zephyr_display))) {
+        return true;
+    }
+#endif
+#if DT_HAS_CHOSEN(zmk_underglow)
+    if (dev == DEVICE_DT_GET(DT_CHOSEN(zmk_underglow))) {
+        return true;
+    }
+#endif
+#if DT_HAS_CHOSEN(zmk_backlight)
+    if (dev == DEVICE_DT_GET(DT_CHOSEN(zmk_backlight))) {
+        return true;
+    }
+#endif
+#if DT_HAS_CHOSEN(zmk_battery)
+    if (dev == DEVICE_DT_GET(DT_CHOSEN(zmk_battery))) {
+        return true;
+    }
+#endif
+    return false;
+}
+
+static void resume_suspended_devices(bool include_deferred) {
+    // Resume in the reverse of suspend order, so dependencies come back before their users.
     for (int i = (zmk_num_susp - 1); i >= 0; i--) {
-        pm_device_action_run(TYPE_SECTION_START(pm_device_slots)[i], PM_DEVICE_ACTION_RESUME);
+        const struct device *dev = TYPE_SECTION_START(pm_device_slots)[i];
+
+        if (dev == NULL || (!include_deferred && is_deferred_resume_device(dev))) {
+            continue;
+        }
+
+        pm_device_action_run(dev, PM_DEVICE_ACTION_RESUME);
+        TYPE_SECTION_START(pm_device_slots)[i] = NULL;
     }
+}
+
+void zmk_pm_resume_critical_devices(void) { resume_suspended_devices(false); }
+
+void zmk_pm_resume_devices(void) {
+    resume_suspended_devices(true);
 
     zmk_num_susp = 0;
 }
 #endif /* !CONFIG_PM_DEVICE_RUNTIME_EXCLUSIVE */
 #endif /* CONFIG_ZMK_PM_DEVICE_SUSPEND_RESUME */
 
+void zmk_pm_flush_pending(void) {
+    const int64_t deadline = k_uptime_get() + CONFIG_ZMK_PM_FLUSH_TIMEOUT_MS;
+    bool flushed;
+
+    // Each pass gives every entry a push, since one can queue work for another, such as a split
+    // behavior run that ends in a report. Sleeping between passes lets the threads doing the work
+    // run, whatever the priority of the caller.
+    do {
+        flushed = true;
+        STRUCT_SECTION_FOREACH(zmk_pm_flush_entry, entry) {
+            if (!entry->flush()) {
+                flushed = false;
+            }
+        }
+
+        if (flushed) {
+            break;
+        }
+
+        k_sleep(K_MSEC(1));
+    } while (k_uptime_get() < deadline);
+
+    if (!flushed) {
+        STRUCT_SECTION_FOREACH(zmk_pm_flush_entry, entry) {
+            if (!entry->flush()) {
+                LOG_WRN("%s still pending after %d ms", entry->name,
+                        CONFIG_ZMK_PM_FLUSH_TIMEOUT_MS);
+            }
+        }
+    }
+
+    // Settings go last, so anything saved while flushing the rest is written too.
+    zmk_settings_save_flush_sync();
+}
+
 #if IS_ENABLED(CONFIG_ZMK_PM_SOFT_OFF)
 
 #define HAS_WAKERS DT_HAS_COMPAT_STATUS_OKAY(zmk_soft_off_wakeup_sources)
@@ -88,16 +167,18 @@ const struct device *soft_off_wakeup_sources[] = {
 #endif
 
 int zmk_pm_soft_off(void) {
-#if IS_ENABLED(CONFIG_PM_DEVICE)
-    size_t device_count;
-    const struct device *devs;
-
 #if !IS_ENABLED(CONFIG_ZMK_SPLIT) || IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
     zmk_endpoints_clear_current();
-    // Need to sleep to give any other threads a chance so submit endpoint data.
-    k_sleep(K_MSEC(100));
 #endif
 
+    // Send the cleared reports and anything else still queued, then write any settings waiting to
+    // be saved, while the radio and flash devices are still active.
+    zmk_pm_flush_pending();
+
+#if IS_ENABLED(CONFIG_PM_DEVICE)
+    size_t device_count;
+    const struct device *devs;
+
     device_count = z_device_get_all_static(&devs);
 
     // There may be some matrix/direct kscan devices that would be used for wakeup
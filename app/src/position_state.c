@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/matrix.h>
+#include <zmk/position_state.h>
+
+static ATOMIC_DEFINE(pressed_positions, ZMK_KEYMAP_LEN);
+// Kept alongside the bits so counting them doesn't scan the whole keymap.
+static atomic_t pressed_count;
+
+void zmk_position_state_update(uint32_t position, bool pressed) {
+    if (position >= ZMK_KEYMAP_LEN) {
+        LOG_WRN("Position %d is outside of the keymap", position);
+        return;
+    }
+
+    if (pressed) {
+        if (!atomic_test_and_set_bit(pressed_positions, position)) {
+            atomic_inc(&pressed_count);
+        }
+    } else if (atomic_test_and_clear_bit(pressed_positions, position)) {
+        atomic_dec(&pressed_count);
+    }
+}
+
+bool zmk_position_state_is_pressed(uint32_t position) {
+    return position < ZMK_KEYMAP_LEN && atomic_test_bit(pressed_positions, position);
+}
+
+uint32_t zmk_position_state_pressed_count(void) { return (uint32_t)atomic_get(&pressed_count); }
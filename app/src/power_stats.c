@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <string.h>
+
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+
+#include <zmk/power_stats.h>
+#include <zmk/boot_timing.h>
+
+#define WINDOW_MS (CONFIG_ZMK_POWER_STATS_WINDOW_SEC * MSEC_PER_SEC)
+
+atomic_t zmk_power_stats_events[ZMK_POWER_STATS_EVENT_COUNT];
+
+static const char *const event_names[] = {
+    [ZMK_POWER_STATS_KSCAN_SCAN] = "kscan scans",
+    [ZMK_POWER_STATS_BLE_REPORT] = "BLE HID reports",
+    [ZMK_POWER_STATS_SPLIT_MESSAGE] = "BLE split messages",
+    [ZMK_POWER_STATS_BATTERY_SAMPLE] = "battery samples",
+    [ZMK_POWER_STATS_UNDERGLOW_FRAME] = "underglow frames",
+};
+
+BUILD_ASSERT(ARRAY_SIZE(event_names) == ZMK_POWER_STATS_EVENT_COUNT,
+             "Every power statistics event needs a name");
+
+// Charge drawn by each event beyond the CPU time it takes, in nanocoulombs. Scans and frames only
+// cost CPU time and GPIO toggling as far as the estimate is concerned.
+static const uint32_t event_cost_nc[] = {
+    [ZMK_POWER_STATS_KSCAN_SCAN] = 0,
+    [ZMK_POWER_STATS_BLE_REPORT] = CONFIG_ZMK_POWER_STATS_BLE_TX_NC,
+    [ZMK_POWER_STATS_SPLIT_MESSAGE] = CONFIG_ZMK_POWER_STATS_BLE_TX_NC,
+    [ZMK_POWER_STATS_BATTERY_SAMPLE] = CONFIG_ZMK_POWER_STATS_BATTERY_SAMPLE_NC,
+    [ZMK_POWER_STATS_UNDERGLOW_FRAME] = 0,
+};
+
+struct thread_usage {
+    const struct k_thread *thread;
+    uint64_t start_cycles;
+    uint32_t window_us;
+};
+
+struct power_stats_window {
+    int64_t start_ms;
+    uint64_t start_active_cycles;
+    struct zmk_power_stats stats;
+    struct thread_usage threads[CONFIG_ZMK_POWER_STATS_MAX_THREADS];
+};
+
+static struct power_stats_window window;
+static struct k_spinlock lock;
+
+static uint32_t estimate_cpu_ua(uint32_t active_us, uint32_t window_ms) {
+    if (window_ms == 0) {
+        return 0;
+    }
+
+    return (uint64_t)active_us * CONFIG_ZMK_POWER_STATS_CPU_ACTIVE_UA / (window_ms * 1000ULL);
+}
+
+static uint32_t estimate_event_ua(enum zmk_power_stats_event event, uint32_t count,
+                                  uint32_t window_ms) {
+    if (window_ms == 0) {
+        return 0;
+    }
+
+    // Nanocoulombs per millisecond are microamps.
+    return (uint64_t)count * event_cost_nc[event] / window_ms;
+}
+
+static void rotate_thread(const struct k_thread *cthread, void *user_data) {
+    struct k_thread *thread = (struct k_thread *)cthread;
+    struct thread_usage *free_slot = NULL;
+    k_thread_runtime_stats_t usage;
+
+    if (k_thread_runtime_stats_get(thread, &usage) != 0) {
+        return;
+    }
+
+    for (int i = 0; i < ARRAY_SIZE(window.threads); i++) {
+        struct thread_usage *slot = &window.threads[i];
+
+        if (slot->thread == thread) {
+            slot->window_us = k_cyc_to_us_floor64(usage.execution_cycles - slot->start_cycles);
+            slot->start_cycles = usage.execution_cycles;
+            return;
+        }
+
+        if (slot->thread == NULL && free_slot == NULL) {
+            free_slot = slot;
+        }
+    }
+
+    // Threads seen for the first time only start being measured from the next window.
+    if (free_slot != NULL) {
+        free_slot->thread = thread;
+        free_slot->start_cycles = usage.execution_cycles;
+    }
+}
+
+static void rotate_window(void) {
+    k_thread_runtime_stats_t all;
+    int64_t now = k_uptime_get();
+
+    k_thread_runtime_stats_all_get(&all);
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    struct zmk_power_stats *stats = &window.stats;
+    stats->window_ms = now - window.start_ms;
+    stats->cpu_active_us = k_cyc_to_us_floor64(all.total_cycles - window.start_active_cycles);
+    stats->estimated_ua =
+        CONFIG_ZMK_POWER_STATS_IDLE_UA + estimate_cpu_ua(stats->cpu_active_us, stats->window_ms);
+
+    for (int i = 0; i < ZMK_POWER_STATS_EVENT_COUNT; i++) {
+        stats->events[i] = atomic_clear(&zmk_power_stats_events[i]);
+        stats->estimated_ua += estimate_event_ua(i, stats->events[i], stats->window_ms);
+    }
+
+    window.start_ms = now;
+    window.start_active_cycles = all.total_cycles;
+
+    k_spin_unlock(&lock, key);
+
+    // This takes the thread list lock, so the per-thread usage is updated outside ours.
+    k_thread_foreach(rotate_thread, NULL);
+}
+
+static void power_stats_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(power_stats_work, power_stats_work_handler);
+
+static void power_stats_work_handler(struct k_work *work) {
+    rotate_window();
+    k_work_schedule(&power_stats_work, K_MSEC(WINDOW_MS));
+}
+
+// Takes a new starting point without keeping anything measured since the last one.
+static void restart_window(void) {
+    rotate_window();
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    memset(&window.stats, 0, sizeof(window.stats));
+    k_spin_unlock(&lock, key);
+}
+
+void zmk_power_stats_get(struct zmk_power_stats *stats) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    *stats = window.stats;
+    k_spin_unlock(&lock, key);
+}
+
+static int power_stats_init(void) {
+    // Nothing is shown until the first window ends.
+    restart_window();
+
+    k_work_schedule(&power_stats_work, K_MSEC(WINDOW_MS));
+    return 0;
+}
+
+ZMK_SYS_INIT(power_stats_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#if IS_ENABLED(CONFIG_SHELL)
+
+static int cmd_power_stats(const struct shell *sh, size_t argc, char **argv) {
+    struct zmk_power_stats stats;
+
+    zmk_power_stats_get(&stats);
+
+    if (stats.window_ms == 0) {
+        shell_print(sh, "No complete window yet, try again in %d seconds",
+                    CONFIG_ZMK_POWER_STATS_WINDOW_SEC);
+        return 0;
+    }
+
+    shell_print(sh, "Last %u ms, estimated %u uA average", stats.window_ms, stats.estimated_ua);
+    shell_print(sh, "CPU active: %u us, %u uA", stats.cpu_active_us,
+                estimate_cpu_ua(stats.cpu_active_us, stats.window_ms));
+
+    for (int i = 0; i < ARRAY_SIZE(window.threads); i++) {
+        const struct thread_usage *slot = &window.threads[i];
+
+        if (slot->thread == NULL || slot->window_us == 0) {
+            continue;
+        }
+
+        const char *name = k_thread_name_get((struct k_thread *)slot->thread);
+        shell_print(sh, "  %s: %u us, %u uA", name ? name : "unnamed", slot->window_us,
+                    estimate_cpu_ua(slot->window_us, stats.window_ms));
+    }
+
+    for (int i = 0; i < ZMK_POWER_STATS_EVENT_COUNT; i++) {
+        shell_print(sh, "%s: %u, %u uA", event_names[i], stats.events[i],
+                    estimate_event_ua(i, stats.events[i], stats.window_ms));
+    }
+
+    return 0;
+}
+
+static int cmd_power_reset(const struct shell *sh, size_t argc, char **argv) {
+    // Start a new window now, so the next one shown doesn't include anything from before.
+    k_work_reschedule(&power_stats_work, K_MSEC(WINDOW_MS));
+    restart_window();
+
+    shell_print(sh, "Power statistics reset");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_power,
+                               SHELL_CMD(stats, NULL, "Show estimated power use per subsystem",
+                                         cmd_power_stats),
+                               SHELL_CMD(reset, NULL, "Start a new power statistics window",
+                                         cmd_power_reset),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((zmk), power, &sub_power, "Power use estimates", NULL, 0, 0);
+
+#endif // IS_ENABLED(CONFIG_SHELL)
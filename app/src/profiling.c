@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/shell/shell.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/boot_timing.h>
+#include <zmk/profiling.h>
+
+/*
+ * Recording a stage only updates its histogram, so nothing is formatted or printed on the path of
+ * a key event. Bucket n holds the times in [n, n + 1) * CONFIG_ZMK_PROFILING_BUCKET_US, and the
+ * last bucket holds everything above.
+ */
+#define BUCKETS CONFIG_ZMK_PROFILING_BUCKETS
+#define BUCKET_US CONFIG_ZMK_PROFILING_BUCKET_US
+
+struct stage_histogram {
+    uint32_t buckets[BUCKETS];
+    uint32_t count;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint64_t sum_cycles;
+};
+
+struct stage_summary {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t avg_us;
+    uint32_t max_us;
+    uint32_t p99_us;
+    bool p99_above;
+};
+
+static const char *const stage_names[] = {
+    [ZMK_PROFILING_KSCAN_CALLBACK] = "kscan callback",
+    [ZMK_PROFILING_KSCAN_DEQUEUE] = "kscan dequeue",
+    [ZMK_PROFILING_KEYMAP_DISPATCH] = "keymap dispatch",
+    [ZMK_PROFILING_BEHAVIOR_PRESS] = "behavior press",
+    [ZMK_PROFILING_HID_LISTENER] = "hid listener",
+    [ZMK_PROFILING_ENDPOINT_SEND] = "endpoint send",
+    [ZMK_PROFILING_TRANSPORT_DONE] = "transport done",
+};
+
+BUILD_ASSERT(ARRAY_SIZE(stage_names) == ZMK_PROFILING_STAGE_COUNT);
+
+static struct stage_histogram histograms[ZMK_PROFILING_STAGE_COUNT];
+static struct k_spinlock lock;
+
+static uint32_t cycles_per_us;
+static uint32_t cycles_per_bucket;
+
+// The key event being processed, and the one behind the last report sent.
+static uint32_t origin;
+static bool active;
+static uint32_t sent_origin;
+static bool sent_pending;
+
+void zmk_profiling_record(enum zmk_profiling_stage stage, uint32_t start) {
+    uint32_t cycles = zmk_profiling_now() - start;
+
+    // Key events can't be reported before the counter is started, but don't divide by zero.
+    if (cycles_per_bucket == 0) {
+        return;
+    }
+
+    uint32_t bucket = MIN(cycles / cycles_per_bucket, BUCKETS - 1);
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    struct stage_histogram *histogram = &histograms[stage];
+    histogram->buckets[bucket]++;
+    histogram->min_cycles = histogram->count ? MIN(histogram->min_cycles, cycles) : cycles;
+    histogram->max_cycles = MAX(histogram->max_cycles, cycles);
+    histogram->sum_cycles += cycles;
+    histogram->count++;
+
+    k_spin_unlock(&lock, key);
+}
+
+void zmk_profiling_begin(uint32_t key_origin) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    origin = key_origin;
+    active = true;
+    k_spin_unlock(&lock, key);
+}
+
+void zmk_profiling_end(void) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    active = false;
+    k_spin_unlock(&lock, key);
+}
+
+void zmk_profiling_mark(enum zmk_profiling_stage stage) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    bool record = active;
+    uint32_t start = origin;
+
+    if (record && stage == ZMK_PROFILING_ENDPOINT_SEND) {
+        sent_origin = origin;
+        sent_pending = true;
+    }
+    k_spin_unlock(&lock, key);
+
+    if (record) {
+        zmk_profiling_record(stage, start);
+    }
+}
+
+void zmk_profiling_transport_done(void) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    bool record = sent_pending;
+    uint32_t start = sent_origin;
+
+    sent_pending = false;
+    k_spin_unlock(&lock, key);
+
+    if (record) {
+        zmk_profiling_record(ZMK_PROFILING_TRANSPORT_DONE, start);
+    }
+}
+
+static void summarize(const struct stage_histogram *histogram, struct stage_summary *summary) {
+    uint32_t p99_count = DIV_ROUND_UP((uint64_t)histogram->count * 99, 100);
+    uint32_t seen = 0;
+    int bucket = 0;
+
+    for (; bucket < BUCKETS - 1; bucket++) {
+        seen += histogram->buckets[bucket];
+        if (seen >= p99_count) {
+            break;
+        }
+    }
+
+    *summary = (struct stage_summary){
+        .count = histogram->count,
+        .min_us = histogram->min_cycles / cycles_per_us,
+        .avg_us = histogram->count ? histogram->sum_cycles / histogram->count / cycles_per_us : 0,
+        .max_us = histogram->max_cycles / cycles_per_us,
+        // The p99 is the upper bound of the bucket it falls into.
+        .p99_us = (bucket == BUCKETS - 1 ? bucket : bucket + 1) * BUCKET_US,
+        .p99_above = bucket == BUCKETS - 1,
+    };
+}
+
+typedef void (*profile_print_t)(void *ctx, const char *line);
+
+static void print_profile(profile_print_t print, void *ctx) {
+    char line[96];
+
+    for (int i = 0; i < ZMK_PROFILING_STAGE_COUNT; i++) {
+        struct stage_summary summary;
+
+        k_spinlock_key_t key = k_spin_lock(&lock);
+        summarize(&histograms[i], &summary);
+        k_spin_unlock(&lock, key);
+
+        if (summary.count == 0) {
+            snprintf(line, sizeof(line), "%s: no samples", stage_names[i]);
+        } else {
+            snprintf(line, sizeof(line), "%s: %u samples, min %uus, avg %uus, p99 %s%uus, max %uus",
+                     stage_names[i], summary.count, summary.min_us, summary.avg_us,
+                     summary.p99_above ? ">" : "", summary.p99_us, summary.max_us);
+        }
+        print(ctx, line);
+    }
+}
+
+static void reset_profile(void) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    memset(histograms, 0, sizeof(histograms));
+    k_spin_unlock(&lock, key);
+}
+
+#if CONFIG_ZMK_PROFILING_LOG_INTERVAL > 0
+
+static void log_profile_line(void *ctx, const char *line) { LOG_INF("%s", line); }
+
+static void log_profile_work_handler(struct k_work *work) {
+    print_profile(log_profile_line, NULL);
+    k_work_schedule(k_work_delayable_from_work(work),
+                    K_SECONDS(CONFIG_ZMK_PROFILING_LOG_INTERVAL));
+}
+
+static K_WORK_DELAYABLE_DEFINE(log_profile_work, log_profile_work_handler);
+
+#endif // CONFIG_ZMK_PROFILING_LOG_INTERVAL > 0
+
+#if IS_ENABLED(CONFIG_SHELL)
+
+static void shell_profile_line(void *ctx, const char *line) {
+    shell_print((const struct shell *)ctx, "%s", line);
+}
+
+static int cmd_profile_stats(const struct shell *sh, size_t argc, char **argv) {
+    shell_print(sh, "Times from the kscan callback of each key event:");
+    print_profile(shell_profile_line, (void *)sh);
+    return 0;
+}
+
+static int cmd_profile_reset(const struct shell *sh, size_t argc, char **argv) {
+    reset_profile();
+    shell_print(sh, "Profile reset");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_profile,
+                               SHELL_CMD(stats, NULL, "Show key event stage timing",
+                                         cmd_profile_stats),
+                               SHELL_CMD(reset, NULL, "Reset key event stage timing",
+                                         cmd_profile_reset),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((zmk), profile, &sub_profile, "Key event hot path profile", NULL, 0, 0);
+
+#endif // IS_ENABLED(CONFIG_SHELL)
+
+static int profiling_init(void) {
+    int err = z_arm_dwt_init();
+    if (err == 0) {
+        err = z_arm_dwt_init_cycle_counter();
+    }
+
+    if (err) {
+        LOG_ERR("Failed to start the DWT cycle counter (%d)", err);
+        return err;
+    }
+
+    cycles_per_us = MAX(SystemCoreClock / USEC_PER_SEC, 1);
+    cycles_per_bucket = cycles_per_us * BUCKET_US;
+
+#if CONFIG_ZMK_PROFILING_LOG_INTERVAL > 0
+    k_work_schedule(&log_profile_work, K_SECONDS(CONFIG_ZMK_PROFILING_LOG_INTERVAL));
+#endif
+
+    return 0;
+}
+
+ZMK_SYS_INIT(profiling_init, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
@@ -0,0 +1,711 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <limits.h>
+#include <string.h>
+
+#include <zephyr/device.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/byteorder.h>
+
+#include <zephyr/usb/usb_device.h>
+#include <zephyr/usb/class/usb_hid.h>
+
+#include <zmk/behavior.h>
+#include <zmk/hid.h>
+#include <zmk/raw_hid.h>
+#include <zmk/usb.h>
+#include <zmk/usb_hid.h>
+#include <zmk/keymap.h>
+#include <zmk/key_inject.h>
+#include <zmk/endpoint_latency.h>
+#include <zmk/power_stats.h>
+#include <zmk/settings.h>
+#include <zmk/event_manager.h>
+#include <zmk/events/position_state_changed.h>
+#include <zmk/events/keycode_state_changed.h>
+#include <zmk/workqueue.h>
+#include <zmk/boot_timing.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+BUILD_ASSERT(ZMK_RAW_HID_REPORT_SIZE <= CONFIG_HID_INTERRUPT_EP_MPS,
+             "CONFIG_HID_INTERRUPT_EP_MPS must fit a raw HID report");
+
+// Command and status bytes that start every reply.
+#define RAW_HID_HEADER_SIZE 2
+#define RAW_HID_PAYLOAD_SIZE (ZMK_RAW_HID_REPORT_SIZE - RAW_HID_HEADER_SIZE)
+
+// Uptime, position and keycode event counts, then count, average and max latency per transport.
+#define RAW_HID_COUNTERS_SIZE (3 * 4 + 2 * (4 + 2 + 2))
+
+BUILD_ASSERT(RAW_HID_COUNTERS_SIZE <= RAW_HID_PAYLOAD_SIZE,
+             "Counters do not fit in a raw HID report");
+
+// Window, CPU time and estimated current, then a count per event.
+#define RAW_HID_POWER_STATS_SIZE (4 + 4 + 2 + ZMK_POWER_STATS_EVENT_COUNT * 4)
+
+BUILD_ASSERT(RAW_HID_POWER_STATS_SIZE <= RAW_HID_PAYLOAD_SIZE,
+             "Power statistics do not fit in a raw HID report");
+
+#define RAW_HID_TX_RETRY_MS 10
+
+// Returned by a command handler that has nothing to reply yet, such as for a bulk data report in
+// the middle of a window.
+#define RAW_HID_NO_REPLY INT_MAX
+
+static const uint8_t raw_hid_report_desc[] = {
+    // Usage Page (Vendor Defined 0xFF60)
+    0x06,
+    0x60,
+    0xFF,
+    HID_USAGE(0x61),
+    HID_COLLECTION(HID_COLLECTION_APPLICATION),
+    HID_USAGE(0x62),
+    HID_LOGICAL_MIN8(0x00),
+    HID_LOGICAL_MAX16(0xFF, 0x00),
+    HID_REPORT_SIZE(0x08),
+    HID_REPORT_COUNT(ZMK_RAW_HID_REPORT_SIZE),
+    HID_INPUT(ZMK_HID_MAIN_VAL_DATA | ZMK_HID_MAIN_VAL_VAR | ZMK_HID_MAIN_VAL_ABS),
+    HID_USAGE(0x63),
+    HID_LOGICAL_MIN8(0x00),
+    HID_LOGICAL_MAX16(0xFF, 0x00),
+    HID_REPORT_SIZE(0x08),
+    HID_REPORT_COUNT(ZMK_RAW_HID_REPORT_SIZE),
+    HID_OUTPUT(ZMK_HID_MAIN_VAL_DATA | ZMK_HID_MAIN_VAL_VAR | ZMK_HID_MAIN_VAL_ABS),
+    HID_END_COLLECTION,
+};
+
+struct raw_hid_report {
+    uint8_t data[ZMK_RAW_HID_REPORT_SIZE];
+};
+
+K_MSGQ_DEFINE(raw_hid_rx_msgq, sizeof(struct raw_hid_report), CONFIG_ZMK_RAW_HID_RX_QUEUE_SIZE,
+              1);
+K_MSGQ_DEFINE(raw_hid_tx_msgq, sizeof(struct raw_hid_report), CONFIG_ZMK_RAW_HID_TX_QUEUE_SIZE,
+              1);
+
+static const struct device *hid_dev;
+
+// Set while a report is in the IN endpoint, cleared once the host has read it.
+static atomic_t tx_in_flight;
+
+static atomic_t position_events;
+static atomic_t keycode_events;
+
+static uint16_t stream_interval_ms;
+
+static void raw_hid_tx_work_handler(struct k_work *work);
+static void raw_hid_rx_work_handler(struct k_work *work);
+static void raw_hid_stream_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(raw_hid_tx_work, raw_hid_tx_work_handler);
+static K_WORK_DEFINE(raw_hid_rx_work, raw_hid_rx_work_handler);
+static K_WORK_DELAYABLE_DEFINE(raw_hid_stream_work, raw_hid_stream_work_handler);
+
+static void raw_hid_tx_work_handler(struct k_work *work) {
+    struct raw_hid_report report;
+
+    if (atomic_get(&tx_in_flight)) {
+        return;
+    }
+
+    if (zmk_usb_get_status() != USB_DC_CONFIGURED) {
+        // Nobody is listening for the replies, so don't let stale ones pile up.
+        k_msgq_purge(&raw_hid_tx_msgq);
+        return;
+    }
+
+    if (k_msgq_peek(&raw_hid_tx_msgq, &report) != 0) {
+        return;
+    }
+
+    atomic_set(&tx_in_flight, true);
+    int err = hid_int_ep_write(hid_dev, report.data, sizeof(report.data), NULL);
+    if (err) {
+        atomic_set(&tx_in_flight, false);
+        LOG_WRN("Failed to write raw HID report: %d", err);
+        k_work_schedule_for_queue(zmk_workqueue_lowprio_work_q(), &raw_hid_tx_work,
+                                  K_MSEC(RAW_HID_TX_RETRY_MS));
+        return;
+    }
+
+    k_msgq_get(&raw_hid_tx_msgq, &report, K_NO_WAIT);
+}
+
+int zmk_raw_hid_send(const uint8_t *data, size_t len) {
+    struct raw_hid_report report = {0};
+
+    if (len > sizeof(report.data)) {
+        return -EINVAL;
+    }
+
+    if (zmk_usb_get_status() != USB_DC_CONFIGURED) {
+        return -ENODEV;
+    }
+
+    memcpy(report.data, data, len);
+
+    int err = k_msgq_put(&raw_hid_tx_msgq, &report, K_NO_WAIT);
+    if (err) {
+        LOG_WRN("Raw HID transmit queue is full, dropping report");
+        return -ENOMEM;
+    }
+
+    k_work_schedule_for_queue(zmk_workqueue_lowprio_work_q(), &raw_hid_tx_work, K_NO_WAIT);
+
+    return 0;
+}
+
+static void raw_hid_fill_latency(uint8_t *buf, enum zmk_transport transport) {
+    struct zmk_endpoint_latency_stats stats = {0};
+
+    zmk_endpoint_latency_get_stats(transport, &stats);
+
+    sys_put_le32(stats.count, buf);
+    sys_put_le16(MIN(stats.avg_ms, UINT16_MAX), buf + 4);
+    sys_put_le16(MIN(stats.max_ms, UINT16_MAX), buf + 6);
+}
+
+static int raw_hid_fill_counters(uint8_t *buf) {
+    sys_put_le32((uint32_t)k_uptime_get(), buf);
+    sys_put_le32((uint32_t)atomic_get(&position_events), buf + 4);
+    sys_put_le32((uint32_t)atomic_get(&keycode_events), buf + 8);
+    raw_hid_fill_latency(buf + 12, ZMK_TRANSPORT_USB);
+    raw_hid_fill_latency(buf + 20, ZMK_TRANSPORT_BLE);
+
+    return RAW_HID_COUNTERS_SIZE;
+}
+
+static void raw_hid_stream_work_handler(struct k_work *work) {
+    uint8_t report[ZMK_RAW_HID_REPORT_SIZE] = {ZMK_RAW_HID_CMD_STREAM_COUNTERS, 0};
+
+    if (stream_interval_ms == 0) {
+        return;
+    }
+
+    raw_hid_fill_counters(&report[RAW_HID_HEADER_SIZE]);
+    zmk_raw_hid_send(report, sizeof(report));
+
+    k_work_schedule_for_queue(zmk_workqueue_lowprio_work_q(), &raw_hid_stream_work,
+                              K_MSEC(stream_interval_ms));
+}
+
+static int raw_hid_stream_counters(const uint8_t *args, uint8_t *payload) {
+    uint16_t interval_ms = sys_get_le16(args);
+
+    if (interval_ms != 0) {
+        interval_ms = MAX(interval_ms, CONFIG_ZMK_RAW_HID_STREAM_MIN_INTERVAL_MS);
+    }
+
+    stream_interval_ms = interval_ms;
+    if (interval_ms == 0) {
+        k_work_cancel_delayable(&raw_hid_stream_work);
+    } else {
+        k_work_reschedule_for_queue(zmk_workqueue_lowprio_work_q(), &raw_hid_stream_work,
+                                    K_MSEC(interval_ms));
+    }
+
+    // Echo the interval actually used, since it may have been raised to the minimum.
+    sys_put_le16(interval_ms, payload);
+    return sizeof(uint16_t);
+}
+
+#if IS_ENABLED(CONFIG_SETTINGS)
+
+struct raw_hid_setting_read {
+    uint8_t *buf;
+    size_t size;
+    ssize_t len;
+};
+
+static int raw_hid_setting_load_cb(const char *name, size_t len, settings_read_cb read_cb,
+                                   void *cb_arg, void *param) {
+    struct raw_hid_setting_read *read = param;
+
+    // Only the exact key is wanted, not anything nested below it.
+    if (name != NULL && name[0] != '\0') {
+        return 0;
+    }
+
+    ssize_t rc = read_cb(cb_arg, read->buf, MIN(len, read->size));
+    if (rc < 0) {
+        return rc;
+    }
+
+    read->len = len;
+    return 0;
+}
+
+// Subtrees that the host may read. Anything else, such as Zephyr's Bluetooth bond keys under
+// "bt/", stays out of reach of the unauthenticated vendor page.
+static const char *const raw_hid_readable_settings[] = {
+    "backlight", "ble", "endpoints", "ext_power", "keymap", "rgb", "split", "zmk",
+};
+
+static bool raw_hid_setting_readable(const char *name) {
+    for (int i = 0; i < ARRAY_SIZE(raw_hid_readable_settings); i++) {
+        size_t len = strlen(raw_hid_readable_settings[i]);
+
+        if (strncmp(name, raw_hid_readable_settings[i], len) == 0 &&
+            (name[len] == '\0' || name[len] == '/')) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int raw_hid_read_setting(const uint8_t *args, uint8_t *payload) {
+    char name[ZMK_RAW_HID_REPORT_SIZE] = {0};
+    struct raw_hid_setting_read read = {
+        .buf = payload + 1,
+        .size = RAW_HID_PAYLOAD_SIZE - 1,
+        .len = -1,
+    };
+
+    // The request is not guaranteed to be terminated, so copy it somewhere that is.
+    memcpy(name, args, ZMK_RAW_HID_REPORT_SIZE - 1);
+    if (name[0] == '\0') {
+        return -EINVAL;
+    }
+
+    if (!raw_hid_setting_readable(name)) {
+        LOG_WRN("Refusing to read setting %s over raw HID", name);
+        return -EACCES;
+    }
+
+    int err = zmk_settings_load_subtree_direct(name, raw_hid_setting_load_cb, &read);
+    if (err) {
+        return err;
+    }
+
+    if (read.len < 0) {
+        return -ENOENT;
+    }
+
+    payload[0] = MIN(read.len, UINT8_MAX);
+    return 1 + MIN(read.len, read.size);
+}
+
+#else
+
+static int raw_hid_read_setting(const uint8_t *args, uint8_t *payload) { return -ENOTSUP; }
+
+#endif // IS_ENABLED(CONFIG_SETTINGS)
+
+static int raw_hid_layer(const uint8_t *args, uint8_t *payload) {
+    uint8_t layer = args[1];
+    int err;
+
+    if (layer >= ZMK_KEYMAP_LAYERS_LEN) {
+        return -EINVAL;
+    }
+
+    switch (args[0]) {
+    case ZMK_RAW_HID_LAYER_TOGGLE:
+        err = zmk_keymap_layer_toggle(layer);
+        break;
+    case ZMK_RAW_HID_LAYER_ACTIVATE:
+        err = zmk_keymap_layer_activate(layer);
+        break;
+    case ZMK_RAW_HID_LAYER_DEACTIVATE:
+        err = zmk_keymap_layer_deactivate(layer);
+        break;
+    case ZMK_RAW_HID_LAYER_TO:
+        err = zmk_keymap_layer_to(layer);
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    if (err < 0) {
+        return err;
+    }
+
+#if IS_ENABLED(CONFIG_ZMK_KEYMAP_LAYER_STATE_64)
+    sys_put_le64(zmk_keymap_layer_state(), payload);
+#else
+    sys_put_le32(zmk_keymap_layer_state(), payload);
+#endif
+    return sizeof(zmk_keymap_layers_state_t);
+}
+
+#if IS_ENABLED(CONFIG_ZMK_KEYMAP_RUNTIME)
+
+static int raw_hid_get_binding(const uint8_t *args, uint8_t *payload) {
+    struct zmk_behavior_binding binding;
+    bool modified;
+
+    int err = zmk_keymap_get_binding(args[0], sys_get_le16(&args[1]), &binding, &modified);
+    if (err) {
+        return err;
+    }
+
+    sys_put_le16(zmk_behavior_get_id(binding.behavior_dev), &payload[0]);
+    sys_put_le32(binding.param1, &payload[2]);
+    sys_put_le32(binding.param2, &payload[6]);
+    payload[10] = modified;
+    return 11;
+}
+
+static int raw_hid_set_binding(const uint8_t *args, uint8_t *payload) {
+    const struct device *behavior = zmk_behavior_get_binding_by_id(sys_get_le16(&args[3]));
+    if (behavior == NULL) {
+        return -ENODEV;
+    }
+
+    struct zmk_behavior_binding binding = {
+        .behavior_dev = behavior->name,
+        .param1 = sys_get_le32(&args[5]),
+        .param2 = sys_get_le32(&args[9]),
+    };
+
+    return zmk_keymap_set_binding(args[0], sys_get_le16(&args[1]), &binding);
+}
+
+static int raw_hid_reset_binding(const uint8_t *args, uint8_t *payload) {
+    if (args[0] == ZMK_RAW_HID_ALL_LAYERS) {
+        return zmk_keymap_reset_bindings();
+    }
+
+    return zmk_keymap_reset_binding(args[0], sys_get_le16(&args[1]));
+}
+
+/*
+ * A bulk transfer stages binding changes across several data reports and then applies them all at
+ * once on commit. The host can send a window of data reports, as many as the receive queue holds,
+ * before waiting for the ack sent for the last report of each window.
+ */
+
+// Sequence number, then the number of bindings in the report.
+#define RAW_HID_BULK_DATA_HEADER_SIZE 3
+// Layer, position, behavior ID, param1 and param2.
+#define RAW_HID_BULK_BINDING_SIZE (1 + 2 + 2 + 4 + 4)
+#define RAW_HID_BULK_WINDOW CONFIG_ZMK_RAW_HID_RX_QUEUE_SIZE
+
+BUILD_ASSERT(RAW_HID_BULK_DATA_HEADER_SIZE + RAW_HID_BULK_BINDING_SIZE <=
+                 ZMK_RAW_HID_REPORT_SIZE - 1,
+             "A bulk binding does not fit in a raw HID report");
+
+static struct zmk_keymap_binding_change bulk_changes[CONFIG_ZMK_RAW_HID_BULK_MAX_BINDINGS];
+static size_t bulk_len;
+static uint16_t bulk_next_seq;
+
+static int raw_hid_bulk_begin(uint8_t *payload) {
+    bulk_len = 0;
+    bulk_next_seq = 0;
+
+    payload[0] = RAW_HID_BULK_WINDOW;
+    sys_put_le16(ARRAY_SIZE(bulk_changes), &payload[1]);
+    return 3;
+}
+
+static int raw_hid_bulk_data(const uint8_t *args, uint8_t *payload) {
+    uint16_t seq = sys_get_le16(&args[0]);
+    uint8_t count = args[2];
+    const uint8_t *binding_args = &args[RAW_HID_BULK_DATA_HEADER_SIZE];
+
+    // Tell the host where to resume from whatever went wrong.
+    sys_put_le16(bulk_next_seq, payload);
+
+    if (seq != bulk_next_seq) {
+        return -EILSEQ;
+    }
+
+    if (RAW_HID_BULK_DATA_HEADER_SIZE + count * RAW_HID_BULK_BINDING_SIZE >
+        ZMK_RAW_HID_REPORT_SIZE - 1) {
+        return -EINVAL;
+    }
+
+    if (bulk_len + count > ARRAY_SIZE(bulk_changes)) {
+        return -ENOMEM;
+    }
+
+    for (int i = 0; i < count; i++, binding_args += RAW_HID_BULK_BINDING_SIZE) {
+        uint16_t behavior_id = sys_get_le16(&binding_args[3]);
+        const struct device *behavior = zmk_behavior_get_binding_by_id(behavior_id);
+        if (behavior == NULL) {
+            // Nothing from this report has been counted yet, so it can simply be resent.
+            return -ENODEV;
+        }
+
+        bulk_changes[bulk_len + i] = (struct zmk_keymap_binding_change){
+            .layer = binding_args[0],
+            .position = sys_get_le16(&binding_args[1]),
+            .binding =
+                {
+                    .behavior_dev = behavior->name,
+                    .param1 = sys_get_le32(&binding_args[5]),
+                    .param2 = sys_get_le32(&binding_args[9]),
+                },
+        };
+    }
+
+    bulk_len += count;
+    bulk_next_seq++;
+
+    if (bulk_next_seq % RAW_HID_BULK_WINDOW != 0) {
+        return RAW_HID_NO_REPLY;
+    }
+
+    sys_put_le16(bulk_next_seq, payload);
+    return sizeof(uint16_t);
+}
+
+static int raw_hid_bulk_commit(const uint8_t *args, uint8_t *payload) {
+    size_t len = bulk_len;
+
+    // The transfer is finished either way, so a failed commit must start again from the beginning.
+    bulk_len = 0;
+    bulk_next_seq = 0;
+
+    if (sys_get_le16(args) != len) {
+        return -EBADMSG;
+    }
+
+    int err = zmk_keymap_set_bindings(bulk_changes, len);
+    if (err) {
+        return err;
+    }
+
+    sys_put_le16(len, payload);
+    return sizeof(uint16_t);
+}
+
+#else
+
+static int raw_hid_get_binding(const uint8_t *args, uint8_t *payload) { return -ENOTSUP; }
+static int raw_hid_set_binding(const uint8_t *args, uint8_t *payload) { return -ENOTSUP; }
+static int raw_hid_reset_binding(const uint8_t *args, uint8_t *payload) { return -ENOTSUP; }
+static int raw_hid_bulk_begin(uint8_t *payload) { return -ENOTSUP; }
+static int raw_hid_bulk_data(const uint8_t *args, uint8_t *payload) { return -ENOTSUP; }
+static int raw_hid_bulk_commit(const uint8_t *args, uint8_t *payload) { return -ENOTSUP; }
+
+#endif // IS_ENABLED(CONFIG_ZMK_KEYMAP_RUNTIME)
+
+#if IS_ENABLED(CONFIG_ZMK_POWER_STATS)
+
+static int raw_hid_get_power_stats(uint8_t *payload) {
+    struct zmk_power_stats stats;
+
+    zmk_power_stats_get(&stats);
+
+    sys_put_le32(stats.window_ms, &payload[0]);
+    sys_put_le32(stats.cpu_active_us, &payload[4]);
+    sys_put_le16(MIN(stats.estimated_ua, UINT16_MAX), &payload[8]);
+    for (int i = 0; i < ZMK_POWER_STATS_EVENT_COUNT; i++) {
+        sys_put_le32(stats.events[i], &payload[10 + i * 4]);
+    }
+
+    return RAW_HID_POWER_STATS_SIZE;
+}
+
+#else
+
+static int raw_hid_get_power_stats(uint8_t *payload) { return -ENOTSUP; }
+
+#endif // IS_ENABLED(CONFIG_ZMK_POWER_STATS)
+
+#if IS_ENABLED(CONFIG_ZMK_KEY_INJECT)
+
+static int raw_hid_inject_key(const uint8_t *args, uint8_t *payload) {
+    int err = zmk_key_inject(sys_get_le16(&args[0]), args[2] != 0);
+    if (err) {
+        return err;
+    }
+
+    sys_put_le32((uint32_t)k_uptime_get(), payload);
+    return sizeof(uint32_t);
+}
+
+#else
+
+static int raw_hid_inject_key(const uint8_t *args, uint8_t *payload) { return -ENOTSUP; }
+
+#endif // IS_ENABLED(CONFIG_ZMK_KEY_INJECT)
+
+static int raw_hid_handle(const uint8_t *request, uint8_t *payload) {
+    const uint8_t *args = &request[1];
+
+    switch (request[0]) {
+    case ZMK_RAW_HID_CMD_VERSION:
+        payload[0] = ZMK_RAW_HID_PROTOCOL_VERSION;
+        payload[1] = ZMK_RAW_HID_REPORT_SIZE;
+        return 2;
+    case ZMK_RAW_HID_CMD_GET_COUNTERS:
+        return raw_hid_fill_counters(payload);
+    case ZMK_RAW_HID_CMD_STREAM_COUNTERS:
+        return raw_hid_stream_counters(args, payload);
+    case ZMK_RAW_HID_CMD_READ_SETTING:
+        return raw_hid_read_setting(args, payload);
+    case ZMK_RAW_HID_CMD_LAYER:
+        return raw_hid_layer(args, payload);
+    case ZMK_RAW_HID_CMD_GET_BINDING:
+        return raw_hid_get_binding(args, payload);
+    case ZMK_RAW_HID_CMD_SET_BINDING:
+        return raw_hid_set_binding(args, payload);
+    case ZMK_RAW_HID_CMD_RESET_BINDING:
+        return raw_hid_reset_binding(args, payload);
+    case ZMK_RAW_HID_CMD_GET_POWER_STATS:
+        return raw_hid_get_power_stats(payload);
+    case ZMK_RAW_HID_CMD_BULK_BEGIN:
+        return raw_hid_bulk_begin(payload);
+    case ZMK_RAW_HID_CMD_BULK_DATA:
+        return raw_hid_bulk_data(args, payload);
+    case ZMK_RAW_HID_CMD_BULK_COMMIT:
+        return raw_hid_bulk_commit(args, payload);
+    case ZMK_RAW_HID_CMD_INJECT_KEY:
+        return raw_hid_inject_key(args, payload);
+    default:
+        LOG_WRN("Unknown raw HID command 0x%02x", request[0]);
+        return -ENOTSUP;
+    }
+}
+
+static void raw_hid_rx_work_handler(struct k_work *work) {
+    struct raw_hid_report request;
+
+    while (k_msgq_get(&raw_hid_rx_msgq, &request, K_NO_WAIT) == 0) {
+        uint8_t reply[ZMK_RAW_HID_REPORT_SIZE] = {request.data[0], 0};
+
+        int ret = raw_hid_handle(request.data, &reply[RAW_HID_HEADER_SIZE]);
+        if (ret == RAW_HID_NO_REPLY) {
+            continue;
+        }
+
+        if (ret < 0) {
+            reply[1] = -ret;
+        }
+
+        zmk_raw_hid_send(reply, sizeof(reply));
+    }
+}
+
+// Called from the USB stack, so only copy the request and leave the handling to the work queue.
+static int raw_hid_receive(const uint8_t *data, size_t len) {
+    struct raw_hid_report request = {0};
+
+    if (len == 0) {
+        return -EINVAL;
+    }
+
+    memcpy(request.data, data, MIN(len, sizeof(request.data)));
+
+    if (k_msgq_put(&raw_hid_rx_msgq, &request, K_NO_WAIT) != 0) {
+        LOG_WRN("Raw HID receive queue is full, dropping request");
+        return -ENOMEM;
+    }
+
+    k_work_submit(&raw_hid_rx_work);
+
+    return 0;
+}
+
+void zmk_raw_hid_usb_status_changed(enum usb_dc_status_code status) {
+    switch (status) {
+    case USB_DC_RESET:
+    case USB_DC_DISCONNECTED:
+    case USB_DC_CONFIGURED:
+        // Whatever was in the IN endpoint is gone, and with it the in_ready callback that would
+        // have cleared the flag.
+        atomic_set(&tx_in_flight, false);
+        k_work_schedule_for_queue(zmk_workqueue_lowprio_work_q(), &raw_hid_tx_work, K_NO_WAIT);
+        break;
+    default:
+        break;
+    }
+}
+
+static void in_ready_cb(const struct device *dev) {
+    atomic_set(&tx_in_flight, false);
+    k_work_schedule_for_queue(zmk_workqueue_lowprio_work_q(), &raw_hid_tx_work, K_NO_WAIT);
+}
+
+#if IS_ENABLED(CONFIG_ENABLE_HID_INT_OUT_EP)
+static void out_ready_cb(const struct device *dev) {
+    uint8_t data[ZMK_RAW_HID_REPORT_SIZE];
+    uint32_t len;
+
+    if (hid_int_ep_read(dev, data, sizeof(data), &len) == 0) {
+        raw_hid_receive(data, len);
+    }
+}
+#endif // IS_ENABLED(CONFIG_ENABLE_HID_INT_OUT_EP)
+
+#define HID_GET_REPORT_TYPE_MASK 0xff00
+
+#define HID_REPORT_TYPE_INPUT 0x100
+#define HID_REPORT_TYPE_OUTPUT 0x200
+
+static int get_report_cb(const struct device *dev, struct usb_setup_packet *setup, int32_t *len,
+                         uint8_t **data) {
+    static uint8_t empty_report[ZMK_RAW_HID_REPORT_SIZE];
+
+    if ((setup->wValue & HID_GET_REPORT_TYPE_MASK) != HID_REPORT_TYPE_INPUT) {
+        LOG_ERR("Get: Unsupported report type %d requested",
+                (setup->wValue & HID_GET_REPORT_TYPE_MASK) >> 8);
+        return -ENOTSUP;
+    }
+
+    // Replies are only delivered through the interrupt endpoint.
+    *data = empty_report;
+    *len = sizeof(empty_report);
+
+    return 0;
+}
+
+static int set_report_cb(const struct device *dev, struct usb_setup_packet *setup, int32_t *len,
+                         uint8_t **data) {
+    if ((setup->wValue & HID_GET_REPORT_TYPE_MASK) != HID_REPORT_TYPE_OUTPUT) {
+        LOG_ERR("Set: Unsupported report type %d requested",
+                (setup->wValue & HID_GET_REPORT_TYPE_MASK) >> 8);
+        return -ENOTSUP;
+    }
+
+    return raw_hid_receive(*data, *len);
+}
+
+static const struct hid_ops ops = {
+    .int_in_ready = in_ready_cb,
+#if IS_ENABLED(CONFIG_ENABLE_HID_INT_OUT_EP)
+    .int_out_ready = out_ready_cb,
+#endif
+    .get_report = get_report_cb,
+    .set_report = set_report_cb,
+};
+
+static int raw_hid_event_listener(const zmk_event_t *eh) {
+    if (as_zmk_position_state_changed(eh) != NULL) {
+        atomic_inc(&position_events);
+    } else if (as_zmk_keycode_state_changed(eh) != NULL) {
+        atomic_inc(&keycode_events);
+    }
+
+    return ZMK_EV_EVENT_BUBBLE;
+}
+
+ZMK_LISTENER(raw_hid, raw_hid_event_listener);
+ZMK_SUBSCRIPTION(raw_hid, zmk_position_state_changed);
+ZMK_SUBSCRIPTION(raw_hid, zmk_keycode_state_changed);
+
+static int zmk_raw_hid_init(void) {
+    hid_dev = zmk_usb_hid_get_device(ZMK_USB_HID_DEVICE_RAW);
+    if (hid_dev == NULL) {
+        LOG_ERR("Unable to locate HID device %d", ZMK_USB_HID_DEVICE_RAW);
+        return -EINVAL;
+    }
+
+    usb_hid_register_device(hid_dev, raw_hid_report_desc, sizeof(raw_hid_report_desc), &ops);
+    usb_hid_init(hid_dev);
+
+    return 0;
+}
+
+ZMK_SYS_INIT(zmk_raw_hid_init, APPLICATION, CONFIG_ZMK_USB_HID_INIT_PRIORITY);
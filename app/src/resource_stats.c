@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/atomic.h>
+
+#include <zmk/resource_stats.h>
+
+void zmk_queue_stats_queued(struct zmk_queue_stats *stats, uint32_t used) {
+    atomic_val_t high_water;
+
+    do {
+        high_water = atomic_get(&stats->high_water);
+        if (used <= high_water) {
+            return;
+        }
+    } while (!atomic_cas(&stats->high_water, high_water, used));
+}
+
+void zmk_queue_stats_overflowed(struct zmk_queue_stats *stats) { atomic_inc(&stats->overflows); }
+
+static void print_stack(const struct shell *sh, const struct zmk_resource_stats_entry *entry) {
+    // The thread of a work queue that was never started has no stack to check.
+    if (entry->thread->stack_info.size == 0) {
+        shell_print(sh, "  %-28s not started", entry->name);
+        return;
+    }
+
+    size_t unused;
+    int err = k_thread_stack_space_get(entry->thread, &unused);
+
+    if (err) {
+        shell_error(sh, "  %-28s failed to get the stack usage (%d)", entry->name, err);
+        return;
+    }
+
+    shell_print(sh, "  %-28s %5zu of %5zu bytes used at most", entry->name, entry->size - unused,
+                entry->size);
+}
+
+static void print_queue(const struct shell *sh, const struct zmk_resource_stats_entry *entry) {
+    uint32_t high_water = atomic_get(&entry->queue->high_water);
+    uint32_t overflows = atomic_get(&entry->queue->overflows);
+
+    shell_print(sh, "  %-28s %5u of %5zu items used at most, %u overflows", entry->name, high_water,
+                entry->size, overflows);
+}
+
+static int cmd_resources_stats(const struct shell *sh, size_t argc, char **argv) {
+    shell_print(sh, "Stacks:");
+    STRUCT_SECTION_FOREACH(zmk_resource_stats_entry, entry) {
+        if (entry->thread) {
+            print_stack(sh, entry);
+        }
+    }
+
+    shell_print(sh, "Queues:");
+    STRUCT_SECTION_FOREACH(zmk_resource_stats_entry, entry) {
+        if (entry->queue) {
+            print_queue(sh, entry);
+        }
+    }
+
+    return 0;
+}
+
+static int cmd_resources_reset(const struct shell *sh, size_t argc, char **argv) {
+    STRUCT_SECTION_FOREACH(zmk_resource_stats_entry, entry) {
+        if (entry->queue) {
+            atomic_clear(&entry->queue->high_water);
+            atomic_clear(&entry->queue->overflows);
+        }
+    }
+
+    // Stack high water marks can't be reset, since they come from the unused part of the stack.
+    shell_print(sh, "Queue statistics reset");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_resources,
+                               SHELL_CMD(stats, NULL, "Show stack and queue usage",
+                                         cmd_resources_stats),
+                               SHELL_CMD(reset, NULL, "Reset queue statistics",
+                                         cmd_resources_reset),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((zmk), resources, &sub_resources, "Stack and queue usage", NULL, 0, 0);
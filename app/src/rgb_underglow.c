@@ -9,15 +9,19 @@
 #include <zephyr/kernel.h>
 #include <zephyr/settings/settings.h>
 
-#include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <zephyr/logging/log.h>
 
 #include <zephyr/drivers/led_strip.h>
 #include <drivers/ext_power.h>
 
+#include <zmk/deferred_init.h>
+#include <zmk/ext_power.h>
+#include <zmk/power_stats.h>
 #include <zmk/rgb_underglow.h>
+#include <zmk/settings.h>
 
 #include <zmk/activity.h>
 #include <zmk/usb.h>
@@ -26,6 +30,18 @@
 #include <zmk/events/usb_conn_state_changed.h>
 #include <zmk/workqueue.h>
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC) && IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
+#include <zmk/split/bluetooth/central.h>
+#endif
+
+#if DT_HAS_CHOSEN(zmk_underglow_key_map)
+#include <zmk/keymap.h>
+#include <zmk/events/position_state_changed.h>
+#if !IS_ENABLED(CONFIG_ZMK_SPLIT) || IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
+#include <zmk/events/layer_state_changed.h>
+#endif
+#endif
+
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #if !DT_HAS_CHOSEN(zmk_underglow)
@@ -49,6 +65,11 @@ enum rgb_underglow_effect {
     UNDERGLOW_EFFECT_BREATHE,
     UNDERGLOW_EFFECT_SPECTRUM,
     UNDERGLOW_EFFECT_SWIRL,
+#if DT_HAS_CHOSEN(zmk_underglow_key_map)
+    UNDERGLOW_EFFECT_HEATMAP,
+    UNDERGLOW_EFFECT_RIPPLE,
+    UNDERGLOW_EFFECT_LAYER_COLORS,
+#endif
     UNDERGLOW_EFFECT_NUMBER // Used to track number of underglow effects
 };
 
@@ -81,119 +102,318 @@ static struct zmk_led_hsb hsb_scale_zero_max(struct zmk_led_hsb hsb) {
     return hsb;
 }
 
-static struct led_rgb hsb_to_rgb(struct zmk_led_hsb hsb) {
-    float r = 0, g = 0, b = 0;
+#define HUE_SECTOR (HUE_MAX / 6)
 
-    uint8_t i = hsb.h / 60;
-    float v = hsb.b / ((float)BRT_MAX);
-    float s = hsb.s / ((float)SAT_MAX);
-    float f = hsb.h / ((float)HUE_MAX) * 6 - i;
-    float p = v * (1 - s);
-    float q = v * (1 - f * s);
-    float t = v * (1 - (1 - f) * s);
-
-    switch (i % 6) {
+/**
+ * Convert to 8-bit RGB with integer math only, since this runs for every pixel of every frame.
+ * Each channel is the exact value truncated, from a single division of the scaled products.
+ */
+static struct led_rgb hsb_to_rgb(struct zmk_led_hsb hsb) {
+    const uint32_t full = SAT_MAX * HUE_SECTOR;
+    const uint32_t scale = BRT_MAX * full;
+    const uint32_t base = hsb.b * 255;
+    const uint16_t h = hsb.h % HUE_MAX;
+    const uint32_t f = h % HUE_SECTOR;
+
+    const uint8_t v = base * full / scale;
+    const uint8_t p = base * (full - hsb.s * HUE_SECTOR) / scale;
+    const uint8_t q = base * (full - f * hsb.s) / scale;
+    const uint8_t t = base * (full - (HUE_SECTOR - f) * hsb.s) / scale;
+
+    switch (h / HUE_SECTOR) {
     case 0:
-        r = v;
-        g = t;
-        b = p;
-        break;
+        return (struct led_rgb){r : v, g : t, b : p};
     case 1:
-        r = q;
-        g = v;
-        b = p;
-        break;
+        return (struct led_rgb){r : q, g : v, b : p};
     case 2:
-        r = p;
-        g = v;
-        b = t;
-        break;
+        return (struct led_rgb){r : p, g : v, b : t};
     case 3:
-        r = p;
-        g = q;
-        b = v;
-        break;
+        return (struct led_rgb){r : p, g : q, b : v};
     case 4:
-        r = t;
-        g = p;
-        b = v;
-        break;
-    case 5:
-        r = v;
-        g = p;
-        b = q;
-        break;
+        return (struct led_rgb){r : t, g : p, b : v};
+    default:
+        return (struct led_rgb){r : v, g : p, b : q};
     }
+}
+
+// Whether the strip is known to show the pixels, so unchanged frames don't need pushing again.
+static bool pixels_shown;
 
-    struct led_rgb rgb = {r : r * 255, g : g * 255, b : b * 255};
+static bool set_pixel(int i, struct led_rgb rgb) {
+    if (pixels[i].r == rgb.r && pixels[i].g == rgb.g && pixels[i].b == rgb.b) {
+        return false;
+    }
 
-    return rgb;
+    pixels[i] = rgb;
+    return true;
 }
 
-static void zmk_rgb_underglow_effect_solid(void) {
+static bool fill_pixels(struct led_rgb rgb) {
+    bool changed = false;
+
     for (int i = 0; i < STRIP_NUM_PIXELS; i++) {
-        pixels[i] = hsb_to_rgb(hsb_scale_min_max(state.color));
+        changed |= set_pixel(i, rgb);
     }
-}
 
-static void zmk_rgb_underglow_effect_breathe(void) {
-    for (int i = 0; i < STRIP_NUM_PIXELS; i++) {
-        struct zmk_led_hsb hsb = state.color;
-        hsb.b = abs(state.animation_step - 1200) / 12;
+    return changed;
+}
 
-        pixels[i] = hsb_to_rgb(hsb_scale_zero_max(hsb));
+static bool is_static_effect(uint8_t effect) {
+    switch (effect) {
+    case UNDERGLOW_EFFECT_SOLID:
+#if DT_HAS_CHOSEN(zmk_underglow_key_map)
+    case UNDERGLOW_EFFECT_LAYER_COLORS:
+#endif
+        return true;
+    default:
+        return false;
     }
+}
+
+static bool zmk_rgb_underglow_effect_solid(void) {
+    return fill_pixels(hsb_to_rgb(hsb_scale_min_max(state.color)));
+}
+
+static bool zmk_rgb_underglow_effect_breathe(void) {
+    struct zmk_led_hsb hsb = state.color;
+    hsb.b = abs(state.animation_step - 1200) / 12;
+
+    bool changed = fill_pixels(hsb_to_rgb(hsb_scale_zero_max(hsb)));
 
     state.animation_step += state.animation_speed * 10;
 
     if (state.animation_step > 2400) {
         state.animation_step = 0;
     }
+
+    return changed;
 }
 
-static void zmk_rgb_underglow_effect_spectrum(void) {
-    for (int i = 0; i < STRIP_NUM_PIXELS; i++) {
-        struct zmk_led_hsb hsb = state.color;
-        hsb.h = state.animation_step;
+static bool zmk_rgb_underglow_effect_spectrum(void) {
+    struct zmk_led_hsb hsb = state.color;
+    hsb.h = state.animation_step;
 
-        pixels[i] = hsb_to_rgb(hsb_scale_min_max(hsb));
-    }
+    bool changed = fill_pixels(hsb_to_rgb(hsb_scale_min_max(hsb)));
 
     state.animation_step += state.animation_speed;
     state.animation_step = state.animation_step % HUE_MAX;
+
+    return changed;
 }
 
-static void zmk_rgb_underglow_effect_swirl(void) {
+static bool zmk_rgb_underglow_effect_swirl(void) {
+    const struct zmk_led_hsb hsb = hsb_scale_min_max(state.color);
+    bool changed = false;
+
     for (int i = 0; i < STRIP_NUM_PIXELS; i++) {
-        struct zmk_led_hsb hsb = state.color;
-        hsb.h = (HUE_MAX / STRIP_NUM_PIXELS * i + state.animation_step) % HUE_MAX;
+        struct zmk_led_hsb pixel = hsb;
+        pixel.h = (HUE_MAX / STRIP_NUM_PIXELS * i + state.animation_step) % HUE_MAX;
 
-        pixels[i] = hsb_to_rgb(hsb_scale_min_max(hsb));
+        changed |= set_pixel(i, hsb_to_rgb(pixel));
     }
 
     state.animation_step += state.animation_speed * 2;
     state.animation_step = state.animation_step % HUE_MAX;
+
+    return changed;
+}
+
+#if DT_HAS_CHOSEN(zmk_underglow_key_map)
+
+#define KEY_MAP_NODE DT_CHOSEN(zmk_underglow_key_map)
+
+#define HEAT_MAX UINT8_MAX
+#define HEAT_PER_PRESS 64
+#define HEAT_HUE_COLD 240
+
+#define RIPPLE_MAX 4
+// Ripple radii are in quarters of an LED, so the slowest speed still moves every frame.
+#define RIPPLE_STEPS_PER_LED 4
+#define RIPPLE_WIDTH (2 * RIPPLE_STEPS_PER_LED)
+#define RIPPLE_END ((STRIP_NUM_PIXELS * RIPPLE_STEPS_PER_LED) + RIPPLE_WIDTH)
+
+static const uint16_t key_leds[] = DT_PROP(KEY_MAP_NODE, led_indices);
+
+#if DT_NODE_HAS_PROP(KEY_MAP_NODE, layer_colors)
+static const uint32_t layer_colors[] = DT_PROP(KEY_MAP_NODE, layer_colors);
+#endif
+
+// The key position lit by each LED, or -1 for LEDs which don't belong to a key.
+static int16_t led_keys[STRIP_NUM_PIXELS];
+
+// How often each key was pressed recently. Written from events and decayed by each frame.
+static uint8_t key_heat[ARRAY_SIZE(key_leds)];
+
+struct ripple {
+    uint16_t led;
+    uint16_t radius;
+};
+
+// Ripples still spreading, from the oldest to the newest.
+static struct ripple ripples[RIPPLE_MAX];
+static size_t ripple_count;
+static struct k_spinlock ripple_lock;
+
+static void zmk_rgb_underglow_key_map_init(void) {
+    for (int i = 0; i < STRIP_NUM_PIXELS; i++) {
+        led_keys[i] = -1;
+    }
+
+    for (int pos = 0; pos < ARRAY_SIZE(key_leds); pos++) {
+        if (key_leds[pos] < STRIP_NUM_PIXELS) {
+            led_keys[key_leds[pos]] = pos;
+        }
+    }
+}
+
+static struct led_rgb scale_rgb(uint32_t color, uint8_t brightness) {
+    return (struct led_rgb){
+        r : ((color >> 16) & 0xff) * brightness / BRT_MAX,
+        g : ((color >> 8) & 0xff) * brightness / BRT_MAX,
+        b : (color & 0xff) * brightness / BRT_MAX,
+    };
+}
+
+static bool zmk_rgb_underglow_effect_heatmap(void) {
+    const struct zmk_led_hsb hsb = hsb_scale_min_max(state.color);
+    const uint8_t cooling = state.animation_speed;
+    bool changed = false;
+
+    for (int i = 0; i < STRIP_NUM_PIXELS; i++) {
+        const int16_t pos = led_keys[i];
+        struct led_rgb rgb = {r : 0, g : 0, b : 0};
+
+        if (pos >= 0) {
+            struct zmk_led_hsb pixel = hsb;
+            pixel.h = HEAT_HUE_COLD - HEAT_HUE_COLD * key_heat[pos] / HEAT_MAX;
+            rgb = hsb_to_rgb(pixel);
+        }
+
+        changed |= set_pixel(i, rgb);
+    }
+
+    for (int pos = 0; pos < ARRAY_SIZE(key_heat); pos++) {
+        key_heat[pos] -= MIN(key_heat[pos], cooling);
+    }
+
+    return changed;
+}
+
+static bool zmk_rgb_underglow_effect_ripple(void) {
+    struct ripple current[RIPPLE_MAX];
+    size_t count;
+
+    k_spinlock_key_t key = k_spin_lock(&ripple_lock);
+    count = ripple_count;
+    memcpy(current, ripples, sizeof(ripples));
+
+    // Spread the ripples for the next frame, and drop the ones which left the strip.
+    size_t kept = 0;
+    for (size_t i = 0; i < ripple_count; i++) {
+        ripples[i].radius += state.animation_speed;
+        if (ripples[i].radius <= RIPPLE_END) {
+            ripples[kept++] = ripples[i];
+        }
+    }
+    ripple_count = kept;
+    k_spin_unlock(&ripple_lock, key);
+
+    const struct zmk_led_hsb hsb = hsb_scale_min_max(state.color);
+    bool changed = false;
+
+    for (int i = 0; i < STRIP_NUM_PIXELS; i++) {
+        uint16_t intensity = 0;
+
+        for (size_t r = 0; r < count; r++) {
+            const int distance = abs(i - current[r].led) * RIPPLE_STEPS_PER_LED;
+            const int offset = abs(distance - current[r].radius);
+
+            if (offset < RIPPLE_WIDTH) {
+                intensity = MAX(intensity, RIPPLE_WIDTH - offset);
+            }
+        }
+
+        struct zmk_led_hsb pixel = hsb;
+        pixel.b = hsb.b * intensity / RIPPLE_WIDTH;
+        changed |= set_pixel(i, hsb_to_rgb(pixel));
+    }
+
+    return changed;
+}
+
+static uint8_t underglow_layer(void) {
+#if !IS_ENABLED(CONFIG_ZMK_SPLIT) || IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
+    return zmk_keymap_highest_layer_active();
+#else
+    // Layers are only tracked by the central.
+    return 0;
+#endif
+}
+
+static bool zmk_rgb_underglow_effect_layer_colors(void) {
+    const uint8_t layer = underglow_layer();
+    const struct zmk_led_hsb hsb = hsb_scale_min_max(state.color);
+    struct led_rgb color;
+
+#if DT_NODE_HAS_PROP(KEY_MAP_NODE, layer_colors)
+    color = scale_rgb(layer < ARRAY_SIZE(layer_colors) ? layer_colors[layer] : 0, hsb.b);
+#else
+    struct zmk_led_hsb layer_hsb = hsb;
+    layer_hsb.h = (hsb.h + HUE_MAX * layer / ZMK_KEYMAP_LAYERS_LEN) % HUE_MAX;
+    color = hsb_to_rgb(layer_hsb);
+#endif
+
+    bool changed = false;
+
+    for (int i = 0; i < STRIP_NUM_PIXELS; i++) {
+        changed |= set_pixel(i, led_keys[i] >= 0 ? color : (struct led_rgb){r : 0, g : 0, b : 0});
+    }
+
+    return changed;
 }
 
+#endif // DT_HAS_CHOSEN(zmk_underglow_key_map)
+
 static void zmk_rgb_underglow_tick(struct k_work *work) {
+    bool changed = false;
+
     switch (state.current_effect) {
     case UNDERGLOW_EFFECT_SOLID:
-        zmk_rgb_underglow_effect_solid();
+        changed = zmk_rgb_underglow_effect_solid();
         break;
     case UNDERGLOW_EFFECT_BREATHE:
-        zmk_rgb_underglow_effect_breathe();
+        changed = zmk_rgb_underglow_effect_breathe();
         break;
     case UNDERGLOW_EFFECT_SPECTRUM:
-        zmk_rgb_underglow_effect_spectrum();
+        changed = zmk_rgb_underglow_effect_spectrum();
         break;
     case UNDERGLOW_EFFECT_SWIRL:
-        zmk_rgb_underglow_effect_swirl();
+        changed = zmk_rgb_underglow_effect_swirl();
+        break;
+#if DT_HAS_CHOSEN(zmk_underglow_key_map)
+    case UNDERGLOW_EFFECT_HEATMAP:
+        changed = zmk_rgb_underglow_effect_heatmap();
+        break;
+    case UNDERGLOW_EFFECT_RIPPLE:
+        changed = zmk_rgb_underglow_effect_ripple();
         break;
+    case UNDERGLOW_EFFECT_LAYER_COLORS:
+        changed = zmk_rgb_underglow_effect_layer_colors();
+        break;
+#endif
+    }
+
+    if (!changed && pixels_shown) {
+        return;
     }
 
     int err = led_strip_update_rgb(led_strip, pixels, STRIP_NUM_PIXELS);
     if (err < 0) {
         LOG_ERR("Failed to update the RGB strip (%d)", err);
+        pixels_shown = false;
+    } else {
+        zmk_power_stats_record(ZMK_POWER_STATS_UNDERGLOW_FRAME);
+        pixels_shown = true;
     }
 }
 
@@ -209,6 +429,23 @@ static void zmk_rgb_underglow_tick_handler(struct k_timer *timer) {
 
 K_TIMER_DEFINE(underglow_tick, zmk_rgb_underglow_tick_handler, NULL);
 
+/**
+ * Render the current state. Animated effects keep ticking, while static effects render only once
+ * after each change, so an unchanging strip causes no wakeups or strip updates at all.
+ */
+static void zmk_rgb_underglow_refresh(void) {
+    if (!state.on) {
+        return;
+    }
+
+    if (is_static_effect(state.current_effect)) {
+        k_timer_stop(&underglow_tick);
+        k_work_submit_to_queue(zmk_workqueue_lowprio_work_q(), &underglow_tick_work);
+    } else {
+        k_timer_start(&underglow_tick, K_NO_WAIT, K_MSEC(50));
+    }
+}
+
 #if IS_ENABLED(CONFIG_SETTINGS)
 static int rgb_settings_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg) {
     const char *next;
@@ -231,16 +468,12 @@ static int rgb_settings_set(const char *name, size_t len, settings_read_cb read_
 }
 
 struct settings_handler rgb_conf = {.name = "rgb/underglow", .h_set = rgb_settings_set};
-
-static void zmk_rgb_underglow_save_state_work(struct k_work *_work) {
-    settings_save_one("rgb/underglow/state", &state, sizeof(state));
-}
-
-static struct k_work_delayable underglow_save_work;
 #endif
 
 static int zmk_rgb_underglow_init(void) {
-    led_strip = DEVICE_DT_GET(STRIP_CHOSEN);
+#if DT_HAS_CHOSEN(zmk_underglow_key_map)
+    zmk_rgb_underglow_key_map_init();
+#endif
 
 #if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_EXT_POWER)
     if (!device_is_ready(ext_power)) {
@@ -270,31 +503,33 @@ static int zmk_rgb_underglow_init(void) {
         return err;
     }
 
-    k_work_init_delayable(&underglow_save_work, zmk_rgb_underglow_save_state_work);
-
-    settings_load_subtree("rgb/underglow");
+    zmk_settings_load_subtree("rgb/underglow");
 #endif
 
 #if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_AUTO_OFF_USB)
     state.on = zmk_usb_is_powered();
 #endif
 
-    if (state.on) {
-        k_timer_start(&underglow_tick, K_NO_WAIT, K_MSEC(50));
-    }
+    // Set last, since the functions behaviors call return -ENODEV until it is.
+    led_strip = DEVICE_DT_GET(STRIP_CHOSEN);
+
+    zmk_rgb_underglow_refresh();
 
     return 0;
 }
 
-int zmk_rgb_underglow_save_state(void) {
-#if IS_ENABLED(CONFIG_SETTINGS)
-    int ret = k_work_reschedule(&underglow_save_work, K_MSEC(CONFIG_ZMK_SETTINGS_SAVE_DEBOUNCE));
-    return MIN(ret, 0);
-#else
-    return 0;
+static void sync_split_peripherals(void) {
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC) && IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
+    zmk_split_bt_sync_underglow();
 #endif
 }
 
+int zmk_rgb_underglow_save_state(void) {
+    sync_split_peripherals();
+
+    return zmk_settings_save("rgb/underglow/state", &state, sizeof(state));
+}
+
 int zmk_rgb_underglow_get_state(bool *on_off) {
     if (!led_strip)
         return -ENODEV;
@@ -318,15 +553,16 @@ int zmk_rgb_underglow_on(void) {
 
     state.on = true;
     state.animation_step = 0;
-    k_timer_start(&underglow_tick, K_NO_WAIT, K_MSEC(50));
+    zmk_ext_power_auto_off_update();
+    zmk_rgb_underglow_refresh();
 
     return zmk_rgb_underglow_save_state();
 }
 
 static void zmk_rgb_underglow_off_handler(struct k_work *work) {
-    for (int i = 0; i < STRIP_NUM_PIXELS; i++) {
-        pixels[i] = (struct led_rgb){r : 0, g : 0, b : 0};
-    }
+    // The strip may lose power while off, so the next frame is always pushed.
+    pixels_shown = false;
+    fill_pixels((struct led_rgb){r : 0, g : 0, b : 0});
 
     led_strip_update_rgb(led_strip, pixels, STRIP_NUM_PIXELS);
 }
@@ -350,6 +586,7 @@ int zmk_rgb_underglow_off(void) {
 
     k_timer_stop(&underglow_tick);
     state.on = false;
+    zmk_ext_power_auto_off_update();
 
     return zmk_rgb_underglow_save_state();
 }
@@ -368,6 +605,7 @@ int zmk_rgb_underglow_select_effect(int effect) {
 
     state.current_effect = effect;
     state.animation_step = 0;
+    zmk_rgb_underglow_refresh();
 
     return zmk_rgb_underglow_save_state();
 }
@@ -386,6 +624,8 @@ int zmk_rgb_underglow_set_hsb(struct zmk_led_hsb color) {
     }
 
     state.color = color;
+    zmk_rgb_underglow_refresh();
+    sync_split_peripherals();
 
     return 0;
 }
@@ -427,6 +667,7 @@ int zmk_rgb_underglow_change_hue(int direction) {
         return -ENODEV;
 
     state.color = zmk_rgb_underglow_calc_hue(direction);
+    zmk_rgb_underglow_refresh();
 
     return zmk_rgb_underglow_save_state();
 }
@@ -436,6 +677,7 @@ int zmk_rgb_underglow_change_sat(int direction) {
         return -ENODEV;
 
     state.color = zmk_rgb_underglow_calc_sat(direction);
+    zmk_rgb_underglow_refresh();
 
     return zmk_rgb_underglow_save_state();
 }
@@ -445,6 +687,7 @@ int zmk_rgb_underglow_change_brt(int direction) {
         return -ENODEV;
 
     state.color = zmk_rgb_underglow_calc_brt(direction);
+    zmk_rgb_underglow_refresh();
 
     return zmk_rgb_underglow_save_state();
 }
@@ -473,11 +716,12 @@ struct rgb_underglow_sleep_state {
     bool rgb_state_before_sleeping;
 };
 
+static struct rgb_underglow_sleep_state sleep_state = {
+    is_awake : true,
+    rgb_state_before_sleeping : false
+};
+
 static int rgb_underglow_auto_state(bool target_wake_state) {
-    static struct rgb_underglow_sleep_state sleep_state = {
-        is_awake : true,
-        rgb_state_before_sleeping : false
-    };
 
     // wake up event while awake, or sleep event while sleeping -> no-op
     if (target_wake_state == sleep_state.is_awake) {
@@ -497,7 +741,78 @@ static int rgb_underglow_auto_state(bool target_wake_state) {
     }
 }
 
+#endif // IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_AUTO_OFF_IDLE) ||
+       // IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_AUTO_OFF_USB)
+
+void zmk_rgb_underglow_get_sync_state(struct zmk_rgb_underglow_sync_state *sync) {
+    *sync = (struct zmk_rgb_underglow_sync_state){
+        .color = state.color,
+        .animation_step = state.animation_step,
+        .effect = state.current_effect,
+        .speed = state.animation_speed,
+        .on = state.on,
+    };
+}
+
+int zmk_rgb_underglow_apply_sync_state(const struct zmk_rgb_underglow_sync_state *sync) {
+    if (!led_strip)
+        return -ENODEV;
+
+    if (sync->effect >= UNDERGLOW_EFFECT_NUMBER || sync->color.h > HUE_MAX ||
+        sync->color.s > SAT_MAX || sync->color.b > BRT_MAX || sync->speed < 1 || sync->speed > 5) {
+        return -EINVAL;
+    }
+
+    bool changed = sync->effect != state.current_effect || sync->speed != state.animation_speed ||
+                   sync->color.h != state.color.h || sync->color.s != state.color.s ||
+                   sync->color.b != state.color.b;
+
+    state.color = sync->color;
+    state.current_effect = sync->effect;
+    state.animation_speed = sync->speed;
+
+    bool on = sync->on;
+
+#if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_AUTO_OFF_IDLE) ||                                          \
+    IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_AUTO_OFF_USB)
+    // While this half has switched itself off, only remember the state to restore on waking.
+    if (!sleep_state.is_awake) {
+        sleep_state.rgb_state_before_sleeping = on;
+        on = false;
+    }
+#endif
+
+    int err = 0;
+    if (on != state.on) {
+        err = on ? zmk_rgb_underglow_on() : zmk_rgb_underglow_off();
+        changed = false;
+    }
+
+    state.animation_step = sync->animation_step;
+    zmk_rgb_underglow_refresh();
+
+    if (changed) {
+        err = zmk_rgb_underglow_save_state();
+    }
+
+    return err;
+}
+
+#if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_AUTO_OFF_IDLE) ||                                          \
+    IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_AUTO_OFF_USB) || IS_ENABLED(CONFIG_ZMK_SLEEP_RETAIN_RAM)
 static int rgb_underglow_event_listener(const zmk_event_t *eh) {
+    // Not initialized yet. The init applies the current activity and USB state itself.
+    if (!led_strip) {
+        return ZMK_EV_EVENT_BUBBLE;
+    }
+
+#if IS_ENABLED(CONFIG_ZMK_SLEEP_RETAIN_RAM)
+    // The strip may have lost power while asleep, and static effects only push changed frames.
+    if (as_zmk_activity_state_changed(eh) && zmk_activity_get_state() == ZMK_ACTIVITY_ACTIVE) {
+        pixels_shown = false;
+        zmk_rgb_underglow_refresh();
+    }
+#endif
 
 #if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_AUTO_OFF_IDLE)
     if (as_zmk_activity_state_changed(eh)) {
@@ -511,14 +826,15 @@ static int rgb_underglow_event_listener(const zmk_event_t *eh) {
     }
 #endif
 
-    return -ENOTSUP;
+    return ZMK_EV_EVENT_BUBBLE;
 }
 
 ZMK_LISTENER(rgb_underglow, rgb_underglow_event_listener);
 #endif // IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_AUTO_OFF_IDLE) ||
-       // IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_AUTO_OFF_USB)
+       // IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_AUTO_OFF_USB) ||
+       // IS_ENABLED(CONFIG_ZMK_SLEEP_RETAIN_RAM)
 
-#if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_AUTO_OFF_IDLE)
+#if IS_ENABLED(CONFIG_ZMK_RGB_UNDERGLOW_AUTO_OFF_IDLE) || IS_ENABLED(CONFIG_ZMK_SLEEP_RETAIN_RAM)
 ZMK_SUBSCRIPTION(rgb_underglow, zmk_activity_state_changed);
 #endif
 
@@ -526,4 +842,55 @@ ZMK_SUBSCRIPTION(rgb_underglow, zmk_activity_state_changed);
 ZMK_SUBSCRIPTION(rgb_underglow, zmk_usb_conn_state_changed);
 #endif
 
-SYS_INIT(zmk_rgb_underglow_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+#if DT_HAS_CHOSEN(zmk_underglow_key_map)
+static void add_ripple(uint16_t led) {
+    k_spinlock_key_t key = k_spin_lock(&ripple_lock);
+
+    if (ripple_count == RIPPLE_MAX) {
+        memmove(&ripples[0], &ripples[1], sizeof(ripples[0]) * (RIPPLE_MAX - 1));
+        ripple_count--;
+    }
+
+    ripples[ripple_count++] = (struct ripple){.led = led, .radius = 0};
+
+    k_spin_unlock(&ripple_lock, key);
+}
+
+// Key presses only update the effect state. The effects render it on the next frame.
+static int rgb_underglow_key_listener(const zmk_event_t *eh) {
+#if !IS_ENABLED(CONFIG_ZMK_SPLIT) || IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
+    if (as_zmk_layer_state_changed(eh)) {
+        if (state.current_effect == UNDERGLOW_EFFECT_LAYER_COLORS) {
+            zmk_rgb_underglow_refresh();
+        }
+        return ZMK_EV_EVENT_BUBBLE;
+    }
+#endif
+
+    const struct zmk_position_state_changed *ev = as_zmk_position_state_changed(eh);
+    if (ev == NULL || !ev->state || ev->position >= ARRAY_SIZE(key_leds) || !state.on) {
+        return ZMK_EV_EVENT_BUBBLE;
+    }
+
+    switch (state.current_effect) {
+    case UNDERGLOW_EFFECT_HEATMAP:
+        key_heat[ev->position] = MIN(key_heat[ev->position] + HEAT_PER_PRESS, HEAT_MAX);
+        break;
+    case UNDERGLOW_EFFECT_RIPPLE:
+        if (key_leds[ev->position] < STRIP_NUM_PIXELS) {
+            add_ripple(key_leds[ev->position]);
+        }
+        break;
+    }
+
+    return ZMK_EV_EVENT_BUBBLE;
+}
+
+ZMK_LISTENER(rgb_underglow_keys, rgb_underglow_key_listener);
+ZMK_SUBSCRIPTION(rgb_underglow_keys, zmk_position_state_changed);
+#if !IS_ENABLED(CONFIG_ZMK_SPLIT) || IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
+ZMK_SUBSCRIPTION(rgb_underglow_keys, zmk_layer_state_changed);
+#endif
+#endif // DT_HAS_CHOSEN(zmk_underglow_key_map)
+
+ZMK_DEFERRED_INIT(zmk_rgb_underglow_init, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -7,6 +7,7 @@
 #include <zephyr/drivers/sensor.h>
 #include <zephyr/devicetree.h>
 #include <zephyr/init.h>
+#include <zephyr/kernel.h>
 
 #include <zephyr/logging/log.h>
 
@@ -14,7 +15,10 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #include <zmk/sensors.h>
 #include <zmk/event_manager.h>
+#include <zmk/input_frame.h>
 #include <zmk/events/sensor_event.h>
+#include <zmk/workqueue.h>
+#include <zmk/boot_timing.h>
 
 #if ZMK_KEYMAP_HAS_SENSORS
 
@@ -59,7 +63,16 @@ static struct zmk_sensor_config configs[] = {
 
 static struct sensors_item_cfg sensors[] = {LISTIFY(ZMK_KEYMAP_SENSORS_LEN, SENSOR_ITEM, (, ), 0)};
 
+/** Sensors with accumulated data to raise in the next frame. */
 static ATOMIC_DEFINE(pending_sensors, ZMK_KEYMAP_SENSORS_LEN);
+/** Sensors triggered from an ISR, which are fetched in the next frame. */
+static ATOMIC_DEFINE(fetch_sensors, ZMK_KEYMAP_SENSORS_LEN);
+
+/** Data fetched from each sensor since its last event. Guarded by sensors_lock. */
+static struct sensor_value accumulated[ZMK_KEYMAP_SENSORS_LEN];
+/** Uptime at which the next frame of sensor events may be raised. Guarded by sensors_lock. */
+static int64_t next_frame_time;
+static struct k_spinlock sensors_lock;
 
 const struct zmk_sensor_config *zmk_sensors_get_config_at_index(uint8_t sensor_index) {
     if (sensor_index > ARRAY_SIZE(configs)) {
@@ -69,7 +82,7 @@ const struct zmk_sensor_config *zmk_sensors_get_config_at_index(uint8_t sensor_i
     return &configs[sensor_index];
 }
 
-static void trigger_sensor_data_for_position(uint32_t sensor_index) {
+static void accumulate_sensor_data_for_position(uint32_t sensor_index) {
     int err;
     const struct sensors_item_cfg *item = &sensors[sensor_index];
 
@@ -87,6 +100,29 @@ static void trigger_sensor_data_for_position(uint32_t sensor_index) {
         return;
     }
 
+    k_spinlock_key_t key = k_spin_lock(&sensors_lock);
+
+    // Rotations add up as degrees. The old EC11 tick reports leave val1 at zero and add up as
+    // ticks in val2, which never carry since they stay far below a million.
+    struct sensor_value *sum = &accumulated[sensor_index];
+    sum->val1 += value.val1;
+    sum->val2 += value.val2;
+    sum->val1 += sum->val2 / 1000000;
+    sum->val2 %= 1000000;
+
+    k_spin_unlock(&sensors_lock, key);
+
+    atomic_set_bit(pending_sensors, sensor_index);
+}
+
+static void raise_sensor_data_for_position(uint32_t sensor_index) {
+    const struct sensors_item_cfg *item = &sensors[sensor_index];
+
+    k_spinlock_key_t key = k_spin_lock(&sensors_lock);
+    struct sensor_value value = accumulated[sensor_index];
+    accumulated[sensor_index] = (struct sensor_value){0};
+    k_spin_unlock(&sensors_lock, key);
+
     raise_zmk_sensor_event(
         (struct zmk_sensor_event){.sensor_index = item->sensor_index,
                                   .channel_data_size = 1,
@@ -96,14 +132,26 @@ static void trigger_sensor_data_for_position(uint32_t sensor_index) {
 }
 
 static void run_sensors_data_trigger(struct k_work *work) {
+    k_spinlock_key_t key = k_spin_lock(&sensors_lock);
+    next_frame_time = k_uptime_get() + CONFIG_ZMK_KEYMAP_SENSORS_SAMPLE_PERIOD_MS;
+    k_spin_unlock(&sensors_lock, key);
+
+    zmk_input_frame_begin();
+
     for (int i = 0; i < ARRAY_SIZE(sensors); i++) {
+        if (atomic_test_and_clear_bit(fetch_sensors, i)) {
+            accumulate_sensor_data_for_position(i);
+        }
+
         if (atomic_test_and_clear_bit(pending_sensors, i)) {
-            trigger_sensor_data_for_position(i);
+            raise_sensor_data_for_position(i);
         }
     }
+
+    zmk_input_frame_end();
 }
 
-K_WORK_DEFINE(sensor_data_work, run_sensors_data_trigger);
+K_WORK_DELAYABLE_DEFINE(sensor_data_work, run_sensors_data_trigger);
 
 static void zmk_sensors_trigger_handler(const struct device *dev,
                                         const struct sensor_trigger *trigger) {
@@ -116,12 +164,22 @@ static void zmk_sensors_trigger_handler(const struct device *dev,
         return;
     }
 
+    // Drivers such as the EC11 decode a step on each fetch, so fetch right away when allowed and
+    // only defer raising the event.
     if (k_is_in_isr()) {
-        atomic_set_bit(pending_sensors, sensor_index);
-        k_work_submit(&sensor_data_work);
+        atomic_set_bit(fetch_sensors, sensor_index);
     } else {
-        trigger_sensor_data_for_position(sensor_index);
+        accumulate_sensor_data_for_position(sensor_index);
     }
+
+    // Triggers until the next frame is due collapse into one event per sensor. An already
+    // scheduled frame keeps its time.
+    k_spinlock_key_t key = k_spin_lock(&sensors_lock);
+    const int64_t frame_time = next_frame_time;
+    k_spin_unlock(&sensors_lock, key);
+
+    k_work_schedule_for_queue(zmk_workqueue_input_work_q(), &sensor_data_work,
+                              K_TIMEOUT_ABS_MS(frame_time));
 }
 
 static void zmk_sensors_init_item(uint8_t i) {
@@ -146,6 +204,6 @@ static int zmk_sensors_init(void) {
     return 0;
 }
 
-SYS_INIT(zmk_sensors_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+ZMK_SYS_INIT(zmk_sensors_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
 
 #endif /* ZMK_KEYMAP_HAS_SENSORS */
@@ -4,10 +4,163 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <string.h>
+
 #include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/crc.h>
 
 #include <zmk/settings.h>
+#include <zmk/boot_timing.h>
+#include <zmk/workqueue.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+/*
+ * Erasing the whole settings partition during init blocks boot for as long as the flash takes to
+ * erase every page. Instead, the saved settings are treated as gone from the start of boot, so
+ * every load finds nothing, and they are deleted through the settings backend once the keyboard is
+ * running. The backend then reclaims the space when it next compacts.
+ *
+ * Only the settings saved before boot are deleted. Their names are collected during init, before
+ * anything can save a setting, along with a CRC of each value, so one saved again since boot, such
+ * as a new bond with the same host, is left alone. Settings saved through zmk_settings_save() are
+ * written on the same work queue as the deletion, so they always land after it.
+ */
+static atomic_t reset_pending = ATOMIC_INIT(true);
+
+bool zmk_settings_reset_pending(void) { return atomic_get(&reset_pending); }
+
+// Only this much of each value is checked for changes, which is enough for the bonds and other
+// settings saved by themselves.
+#define RESET_CRC_VALUE_LEN 128
+
+struct reset_entry {
+    char name[SETTINGS_MAX_NAME_LEN + 1];
+    uint32_t crc;
+};
+
+struct reset_snapshot {
+    struct reset_entry entries[CONFIG_ZMK_SETTINGS_RESET_DEFERRED_MAX];
+    int count;
+};
+
+static struct reset_snapshot snapshot;
+
+static uint32_t value_crc(size_t len, settings_read_cb read_cb, void *cb_arg) {
+    static uint8_t value[RESET_CRC_VALUE_LEN];
+
+    ssize_t n = read_cb(cb_arg, value, MIN(len, sizeof(value)));
+    if (n < 0) {
+        n = 0;
+    }
+
+    // The length is included, so truncating a value counts as a change.
+    return crc32_ieee_update(crc32_ieee((const uint8_t *)&len, sizeof(len)), value, n);
+}
+
+static int reset_collect_cb(const char *key, size_t len, settings_read_cb read_cb, void *cb_arg,
+                            void *param) {
+    struct reset_snapshot *snap = param;
+
+    if (snap->count >= ARRAY_SIZE(snap->entries)) {
+        return 1;
+    }
+
+    struct reset_entry *entry = &snap->entries[snap->count++];
+    strncpy(entry->name, key, SETTINGS_MAX_NAME_LEN);
+    entry->name[SETTINGS_MAX_NAME_LEN] = '\0';
+    entry->crc = value_crc(len, read_cb, cb_arg);
+    return 0;
+}
+
+struct reset_check {
+    const struct reset_entry *entry;
+    bool unchanged;
+};
+
+static int reset_check_cb(const char *key, size_t len, settings_read_cb read_cb, void *cb_arg,
+                          void *param) {
+    struct reset_check *check = param;
+
+    // Only the entry itself, not any under it.
+    if (key != NULL) {
+        return 0;
+    }
+
+    check->unchanged = value_crc(len, read_cb, cb_arg) == check->entry->crc;
+    return 1;
+}
+
+static int delete_entries(const struct reset_snapshot *snap, bool check_unchanged) {
+    for (int i = 0; i < snap->count; i++) {
+        const struct reset_entry *entry = &snap->entries[i];
+
+        if (check_unchanged) {
+            struct reset_check check = {.entry = entry};
+            settings_load_subtree_direct(entry->name, reset_check_cb, &check);
+            if (!check.unchanged) {
+                LOG_DBG("Keeping setting %s, saved again since boot", entry->name);
+                continue;
+            }
+        }
+
+        int err = settings_delete(entry->name);
+        if (err) {
+            LOG_ERR("Failed to delete setting %s (err %d)", entry->name, err);
+            return err;
+        }
+    }
+
+    return 0;
+}
+
+static void reset_settings_work_handler(struct k_work *work) {
+    delete_entries(&snapshot, true);
+
+    atomic_set(&reset_pending, false);
+
+    LOG_INF("Reset settings, deleted up to %d entries", snapshot.count);
+}
+
+static K_WORK_DEFINE(reset_settings_work, reset_settings_work_handler);
+
+static int reset_settings_on_start_init(void) {
+    int rc = settings_subsys_init();
+    if (rc < 0) {
+        LOG_ERR("Failed to init settings to reset (err %d)", rc);
+        return rc;
+    }
+
+    // Deleting entries while the backend is still reading them isn't safe, so they are collected
+    // first. A store with more entries than the snapshot holds has the extra ones deleted right
+    // away, which is still safe since nothing has saved a setting yet.
+    while (true) {
+        snapshot.count = 0;
+
+        rc = settings_load_subtree_direct(NULL, reset_collect_cb, &snapshot);
+        if (rc < 0) {
+            LOG_ERR("Failed to read settings to reset (err %d)", rc);
+            return rc;
+        }
+
+        if (snapshot.count < ARRAY_SIZE(snapshot.entries)) {
+            break;
+        }
+
+        rc = delete_entries(&snapshot, false);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
+    k_work_submit_to_queue(zmk_workqueue_lowprio_work_q(), &reset_settings_work);
+    return 0;
+}
 
-// Reset after the kernel is initialized but before any application code to
-// ensure settings are cleared before anything tries to use them.
-SYS_INIT(zmk_settings_erase, POST_KERNEL, CONFIG_ZMK_SETTINGS_RESET_ON_START_INIT_PRIORITY);
+// Runs before any application code, so settings are already treated as reset before anything
+// tries to load them, and the snapshot is taken before anything can save one.
+ZMK_SYS_INIT(reset_settings_on_start_init, POST_KERNEL,
+             CONFIG_ZMK_SETTINGS_RESET_ON_START_INIT_PRIORITY);
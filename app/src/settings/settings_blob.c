@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/crc.h>
+
+#include "settings_blob.h"
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+/*
+ * The small state settings which change at runtime are kept together in one entry, so a batch of
+ * changes costs a single write and a single entry's overhead in the store. The blob is a header
+ * followed by records packed back to back, each a u8 name length including the terminator, a u8
+ * value length, the name, and then the value.
+ */
+#define BLOB_VERSION 1
+
+struct blob_header {
+    uint8_t version;
+    uint8_t reserved;
+    // Length of the records following the header.
+    uint16_t len;
+    // CRC-32 of the records.
+    uint32_t crc;
+} __packed;
+
+#define RECORD_HEADER_LEN 2
+#define RECORDS_MAX_LEN (CONFIG_ZMK_SETTINGS_BLOB_SIZE - sizeof(struct blob_header))
+
+static uint8_t blob[CONFIG_ZMK_SETTINGS_BLOB_SIZE];
+static uint8_t *const records = &blob[sizeof(struct blob_header)];
+static size_t records_len;
+
+// Whether the blob changed since it was last written.
+static bool dirty;
+// Whether settings were added to the blob since it was last written, so any entries of their own
+// left from before they were saved in the blob need deleting.
+static bool names_added;
+
+static K_MUTEX_DEFINE(blob_mutex);
+
+static const char *const owned_subtrees[] = {
+    "endpoints", "ble/active_profile", "rgb/underglow", "backlight", "ext_power",
+};
+
+bool zmk_settings_blob_owns(const char *name) {
+    for (int i = 0; i < ARRAY_SIZE(owned_subtrees); i++) {
+        if (settings_name_steq(name, owned_subtrees[i], NULL)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static size_t record_len(size_t offset) {
+    return RECORD_HEADER_LEN + records[offset] + records[offset + 1];
+}
+
+static const char *record_name(size_t offset) {
+    return (const char *)&records[offset + RECORD_HEADER_LEN];
+}
+
+static uint8_t *record_value(size_t offset) {
+    return &records[offset + RECORD_HEADER_LEN + records[offset]];
+}
+
+static int find_record(const char *name) {
+    for (size_t offset = 0; offset < records_len; offset += record_len(offset)) {
+        if (strcmp(record_name(offset), name) == 0) {
+            return offset;
+        }
+    }
+
+    return -ENOENT;
+}
+
+static bool records_valid(size_t len) {
+    for (size_t offset = 0; offset < len; offset += record_len(offset)) {
+        if (offset + RECORD_HEADER_LEN > len || offset + record_len(offset) > len ||
+            records[offset] == 0 || record_name(offset)[records[offset] - 1] != '\0') {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int zmk_settings_blob_restore(size_t len, settings_read_cb read_cb, void *cb_arg) {
+    struct blob_header header;
+
+    k_mutex_lock(&blob_mutex, K_FOREVER);
+
+    records_len = 0;
+    dirty = false;
+    names_added = false;
+
+    ssize_t rc = len <= sizeof(blob) ? read_cb(cb_arg, blob, len) : -EINVAL;
+    memcpy(&header, blob, sizeof(header));
+
+    if (rc < (ssize_t)sizeof(header) || header.version != BLOB_VERSION ||
+        header.len != rc - sizeof(header) || header.crc != crc32_ieee(records, header.len) ||
+        !records_valid(header.len)) {
+        LOG_WRN("Ignoring invalid saved settings blob");
+    } else {
+        records_len = header.len;
+    }
+
+    k_mutex_unlock(&blob_mutex);
+
+    return 0;
+}
+
+struct record_read_arg {
+    const uint8_t *value;
+    size_t len;
+};
+
+static ssize_t record_read_cb(void *cb_arg, void *data, size_t len) {
+    struct record_read_arg *arg = cb_arg;
+
+    len = MIN(len, arg->len);
+    memcpy(data, arg->value, len);
+
+    return len;
+}
+
+int zmk_settings_blob_load(struct settings_load_arg *load_arg) {
+    int rc = 0;
+
+    k_mutex_lock(&blob_mutex, K_FOREVER);
+
+    for (size_t offset = 0; offset < records_len; offset += record_len(offset)) {
+        struct record_read_arg read_arg = {.value = record_value(offset),
+                                           .len = records[offset + 1]};
+
+        rc = settings_call_set_handler(record_name(offset), read_arg.len, record_read_cb,
+                                       &read_arg, load_arg);
+        if (rc != 0) {
+            break;
+        }
+    }
+
+    k_mutex_unlock(&blob_mutex);
+
+    return rc;
+}
+
+static int blob_set(const char *name, const void *value, size_t len) {
+    size_t name_len = strlen(name) + 1;
+
+    int offset = find_record(name);
+    if (offset >= 0) {
+        if (records[offset + 1] == len && memcmp(record_value(offset), value, len) == 0) {
+            return 0;
+        }
+
+        size_t removed_len = record_len(offset);
+        memmove(&records[offset], &records[offset + removed_len],
+                records_len - offset - removed_len);
+        records_len -= removed_len;
+        dirty = true;
+    }
+
+    if (len == 0) {
+        return 0;
+    }
+
+    if (name_len > UINT8_MAX || len > UINT8_MAX ||
+        records_len + RECORD_HEADER_LEN + name_len + len > RECORDS_MAX_LEN) {
+        return -ENOMEM;
+    }
+
+    records[records_len] = name_len;
+    records[records_len + 1] = len;
+    memcpy(&records[records_len + RECORD_HEADER_LEN], name, name_len);
+    memcpy(&records[records_len + RECORD_HEADER_LEN + name_len], value, len);
+    records_len += RECORD_HEADER_LEN + name_len + len;
+
+    dirty = true;
+    names_added |= offset < 0;
+
+    return 0;
+}
+
+int zmk_settings_blob_set(const char *name, const void *value, size_t len) {
+    k_mutex_lock(&blob_mutex, K_FOREVER);
+    int rc = blob_set(name, value, len);
+    k_mutex_unlock(&blob_mutex);
+
+    return rc;
+}
+
+static int blob_write(void) {
+    if (!dirty) {
+        return 0;
+    }
+
+    struct blob_header header = {
+        .version = BLOB_VERSION,
+        .len = records_len,
+        .crc = crc32_ieee(records, records_len),
+    };
+    memcpy(blob, &header, sizeof(header));
+
+    // A single entry, so the backend replaces the whole blob at once or not at all.
+    int err = settings_save_one(ZMK_SETTINGS_BLOB_NAME, blob, sizeof(header) + records_len);
+    if (err) {
+        LOG_ERR("Failed to save the settings blob (err %d)", err);
+        return err;
+    }
+
+    dirty = false;
+
+    // Only delete the old entries once the blob holding their values is safely written.
+    if (names_added) {
+        for (size_t offset = 0; offset < records_len; offset += record_len(offset)) {
+            settings_delete(record_name(offset));
+        }
+
+        names_added = false;
+    }
+
+    return 0;
+}
+
+int zmk_settings_blob_write(void) {
+    k_mutex_lock(&blob_mutex, K_FOREVER);
+    int err = blob_write();
+    k_mutex_unlock(&blob_mutex);
+
+    return err;
+}
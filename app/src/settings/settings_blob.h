@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <zephyr/settings/settings.h>
+
+#define ZMK_SETTINGS_BLOB_NAME "zmk/state"
+
+#if IS_ENABLED(CONFIG_ZMK_SETTINGS_BLOB)
+
+/** Whether a setting is saved in the blob rather than as an entry of its own. */
+bool zmk_settings_blob_owns(const char *name);
+
+/** Restores the blob from its entry in the store. An invalid blob is ignored. */
+int zmk_settings_blob_restore(size_t len, settings_read_cb read_cb, void *cb_arg);
+
+/** Passes the settings in the blob to a load, the same as entries read from the store. */
+int zmk_settings_blob_load(struct settings_load_arg *load_arg);
+
+/** Sets a setting in the blob, or deletes it if len is 0. Returns -ENOMEM if it doesn't fit. */
+int zmk_settings_blob_set(const char *name, const void *value, size_t len);
+
+/** Writes the blob to the store if it changed since it was last written. */
+int zmk_settings_blob_write(void);
+
+#else
+
+static inline bool zmk_settings_blob_owns(const char *name) { return false; }
+
+static inline int zmk_settings_blob_restore(size_t len, settings_read_cb read_cb, void *cb_arg) {
+    return 0;
+}
+
+static inline int zmk_settings_blob_load(struct settings_load_arg *load_arg) { return 0; }
+
+static inline int zmk_settings_blob_set(const char *name, const void *value, size_t len) {
+    return -ENOTSUP;
+}
+
+static inline int zmk_settings_blob_write(void) { return 0; }
+
+#endif // IS_ENABLED(CONFIG_ZMK_SETTINGS_BLOB)
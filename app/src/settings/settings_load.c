@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <string.h>
+
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+
+#include <zmk/boot_timing.h>
+#include <zmk/deferred_init.h>
+#include <zmk/settings.h>
+
+#include "settings_blob.h"
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+/*
+ * Every settings_load_subtree() reads the whole store, whatever the subtree, so each module
+ * loading its own subtree at boot would read every saved setting again. Instead, the first load
+ * reads the store once into this cache, and the rest are served from it.
+ *
+ * Entries are packed back to back in the order the backend reported them, each as a u8 name
+ * length including the terminator, a u16 value length, the name, and then the value. Bluetooth's
+ * own "bt" settings, such as bond keys, aren't cached. They are large and only loaded once. The
+ * settings blob is restored as it is read rather than cached, and its settings are passed to every
+ * load after those from the store, so they replace any older entries of their own.
+ */
+static uint8_t cache[CONFIG_ZMK_SETTINGS_LOAD_CACHE_SIZE];
+static size_t cache_len;
+
+#define ENTRY_HEADER_LEN 3
+
+enum cache_state {
+    CACHE_EMPTY,
+    CACHE_LOADED,
+    // The settings didn't fit, or boot has finished, so loads go to the store instead.
+    CACHE_UNAVAILABLE,
+};
+
+static enum cache_state cache_state;
+
+static int cache_entry_cb(const char *key, size_t len, settings_read_cb read_cb, void *cb_arg,
+                          void *param) {
+    if (settings_name_steq(key, "bt", NULL)) {
+        return 0;
+    }
+
+    if (strcmp(key, ZMK_SETTINGS_BLOB_NAME) == 0) {
+        return zmk_settings_blob_restore(len, read_cb, cb_arg);
+    }
+
+    size_t name_len = strlen(key) + 1;
+    if (name_len > UINT8_MAX || len > UINT16_MAX ||
+        cache_len + ENTRY_HEADER_LEN + name_len + len > sizeof(cache)) {
+        return -ENOMEM;
+    }
+
+    uint8_t *entry = &cache[cache_len];
+    uint16_t value_len = len;
+
+    entry[0] = name_len;
+    memcpy(&entry[1], &value_len, sizeof(value_len));
+    memcpy(&entry[ENTRY_HEADER_LEN], key, name_len);
+
+    ssize_t rc = read_cb(cb_arg, &entry[ENTRY_HEADER_LEN + name_len], len);
+    if (rc < 0) {
+        return rc;
+    }
+
+    cache_len += ENTRY_HEADER_LEN + name_len + len;
+    return 0;
+}
+
+#if IS_ENABLED(CONFIG_ZMK_SETTINGS_BLOB)
+static int blob_restore_cb(const char *key, size_t len, settings_read_cb read_cb, void *cb_arg,
+                           void *param) {
+    return key == NULL ? zmk_settings_blob_restore(len, read_cb, cb_arg) : 0;
+}
+#endif
+
+static bool cache_ready(void) {
+    if (cache_state == CACHE_EMPTY) {
+        int rc = settings_load_subtree_direct(NULL, cache_entry_cb, NULL);
+        if (rc == -ENOMEM) {
+            LOG_WRN("Settings don't fit CONFIG_ZMK_SETTINGS_LOAD_CACHE_SIZE, loading each "
+                    "subtree from the store");
+        } else if (rc < 0) {
+            LOG_ERR("Failed to read settings into the cache (err %d)", rc);
+        }
+
+#if IS_ENABLED(CONFIG_ZMK_SETTINGS_BLOB)
+        // The read stopped early, so it may not have reached the blob.
+        if (rc != 0) {
+            settings_load_subtree_direct(ZMK_SETTINGS_BLOB_NAME, blob_restore_cb, NULL);
+        }
+#endif
+
+        cache_state = rc == 0 ? CACHE_LOADED : CACHE_UNAVAILABLE;
+        zmk_boot_timing_mark("settings read");
+    }
+
+    return cache_state == CACHE_LOADED;
+}
+
+struct cache_read_arg {
+    const uint8_t *value;
+    size_t len;
+};
+
+static ssize_t cache_read_cb(void *cb_arg, void *data, size_t len) {
+    struct cache_read_arg *arg = cb_arg;
+
+    len = MIN(len, arg->len);
+    memcpy(data, arg->value, len);
+
+    return len;
+}
+
+static int load_cached(const char *subtree, settings_load_direct_cb cb, void *param) {
+    struct settings_load_arg load_arg = {.subtree = subtree, .cb = cb, .param = param};
+
+    for (size_t offset = 0; offset < cache_len;) {
+        const uint8_t *entry = &cache[offset];
+        const char *name = (const char *)&entry[ENTRY_HEADER_LEN];
+        uint16_t value_len;
+
+        memcpy(&value_len, &entry[1], sizeof(value_len));
+        offset += ENTRY_HEADER_LEN + entry[0] + value_len;
+
+        struct cache_read_arg read_arg = {.value = &entry[ENTRY_HEADER_LEN + entry[0]],
+                                          .len = value_len};
+
+        // Filters on the subtree and calls the direct callback or the registered handler, the
+        // same as for an entry read from the store.
+        int rc = settings_call_set_handler(name, value_len, cache_read_cb, &read_arg, &load_arg);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    return 0;
+}
+
+int zmk_settings_load_subtree(const char *subtree) {
+    struct settings_load_arg blob_arg = {.subtree = subtree};
+
+    if (zmk_settings_reset_pending()) {
+        return settings_commit_subtree(subtree);
+    }
+
+    if (!cache_ready()) {
+        // This commits before the blob's settings are passed on, which makes no difference since
+        // none of the handlers for ZMK's own settings have a commit callback.
+        int rc = settings_load_subtree(subtree);
+        return rc ? rc : zmk_settings_blob_load(&blob_arg);
+    }
+
+    int rc = load_cached(subtree, NULL, NULL);
+    if (rc == 0) {
+        rc = zmk_settings_blob_load(&blob_arg);
+    }
+
+    if (rc != 0) {
+        return rc;
+    }
+
+    return settings_commit_subtree(subtree);
+}
+
+int zmk_settings_load_subtree_direct(const char *subtree, settings_load_direct_cb cb,
+                                     void *param) {
+    struct settings_load_arg blob_arg = {.subtree = subtree, .cb = cb, .param = param};
+
+    if (zmk_settings_reset_pending()) {
+        return 0;
+    }
+
+    int rc = cache_ready() ? load_cached(subtree, cb, param)
+                           : settings_load_subtree_direct(subtree, cb, param);
+
+    return rc ? rc : zmk_settings_blob_load(&blob_arg);
+}
+
+// Later saves don't update the cache, so anything loading settings after boot reads the store.
+static int settings_load_cache_release(void) {
+    cache_state = CACHE_UNAVAILABLE;
+    cache_len = 0;
+    return 0;
+}
+
+// Runs after every other init, including those deferred with CONFIG_ZMK_DEFERRED_INIT.
+ZMK_DEFERRED_INIT(settings_load_cache_release, 99);
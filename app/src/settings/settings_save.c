@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+
+#include <zmk/settings.h>
+#include <zmk/workqueue.h>
+
+#include "settings_blob.h"
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+// Long enough for every key ZMK saves, such as "ble/peripheral_addresses/0".
+#define SETTINGS_SAVE_MAX_NAME_LEN 40
+
+struct settings_save_entry {
+    char name[SETTINGS_SAVE_MAX_NAME_LEN];
+    uint8_t value[ZMK_SETTINGS_SAVE_MAX_VALUE_LEN];
+    uint8_t len;
+    bool dirty;
+};
+
+static struct settings_save_entry entries[CONFIG_ZMK_SETTINGS_SAVE_QUEUE_SIZE];
+static struct k_spinlock lock;
+
+#if CONFIG_ZMK_SETTINGS_SAVE_RATE_LIMIT > 0
+
+#define RATE_WINDOW_MS (CONFIG_ZMK_SETTINGS_SAVE_RATE_WINDOW_SEC * MSEC_PER_SEC)
+
+/*
+ * Each batch of writes can make the backend compact the store, which erases flash and blocks the
+ * low priority queue for tens of milliseconds. Once CONFIG_ZMK_SETTINGS_SAVE_RATE_LIMIT batches
+ * have been written in the current window, later saves wait for the window to end and are all
+ * written together then. Guarded by lock.
+ */
+static int64_t rate_window_start;
+static int rate_window_writes;
+
+static void count_write(void) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    int64_t now = k_uptime_get();
+    if (rate_window_writes == 0 || now - rate_window_start >= RATE_WINDOW_MS) {
+        rate_window_start = now;
+        rate_window_writes = 0;
+    }
+
+    rate_window_writes++;
+
+    k_spin_unlock(&lock, key);
+}
+
+// Called with lock held.
+static k_timeout_t save_delay(void) {
+    int64_t delay = CONFIG_ZMK_SETTINGS_SAVE_DEBOUNCE;
+
+    if (rate_window_writes >= CONFIG_ZMK_SETTINGS_SAVE_RATE_LIMIT) {
+        delay = MAX(delay, rate_window_start + RATE_WINDOW_MS - k_uptime_get());
+    }
+
+    return K_MSEC(delay);
+}
+
+#else
+
+static void count_write(void) {}
+
+static k_timeout_t save_delay(void) { return K_MSEC(CONFIG_ZMK_SETTINGS_SAVE_DEBOUNCE); }
+
+#endif // CONFIG_ZMK_SETTINGS_SAVE_RATE_LIMIT > 0
+
+static void settings_save_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(settings_save_work, settings_save_work_handler);
+
+static int save_setting(const char *name, const void *value, size_t len) {
+    if (zmk_settings_blob_owns(name)) {
+        int err = zmk_settings_blob_set(name, value, len);
+        if (err != -ENOMEM) {
+            return err;
+        }
+
+        LOG_WRN("Setting %s doesn't fit CONFIG_ZMK_SETTINGS_BLOB_SIZE, saving it on its own",
+                name);
+    }
+
+    return settings_save_one(name, value, len);
+}
+
+static struct settings_save_entry *find_entry(const char *name) {
+    struct settings_save_entry *free_entry = NULL;
+
+    for (int i = 0; i < ARRAY_SIZE(entries); i++) {
+        if (!entries[i].dirty) {
+            free_entry = free_entry ? free_entry : &entries[i];
+        } else if (strcmp(entries[i].name, name) == 0) {
+            return &entries[i];
+        }
+    }
+
+    return free_entry;
+}
+
+int zmk_settings_save(const char *name, const void *value, size_t len) {
+    if (len > ZMK_SETTINGS_SAVE_MAX_VALUE_LEN || strlen(name) >= SETTINGS_SAVE_MAX_NAME_LEN) {
+        LOG_ERR("Setting %s is too large to queue", name);
+        return -EINVAL;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    struct settings_save_entry *entry = find_entry(name);
+    if (entry != NULL) {
+        strcpy(entry->name, name);
+        memcpy(entry->value, value, len);
+        entry->len = len;
+        entry->dirty = true;
+    }
+
+    k_timeout_t delay = save_delay();
+
+    k_spin_unlock(&lock, key);
+
+    if (entry == NULL) {
+        LOG_WRN("Settings save queue is full, saving %s immediately", name);
+
+        count_write();
+
+        int err = save_setting(name, value, len);
+        return err ? err : zmk_settings_blob_write();
+    }
+
+    // Schedule rather than reschedule, so a setting that keeps changing can't hold back the rest.
+    k_work_schedule_for_queue(zmk_workqueue_lowprio_work_q(), &settings_save_work, delay);
+
+    return 0;
+}
+
+void zmk_settings_save_flush(void) {
+    k_work_reschedule_for_queue(zmk_workqueue_lowprio_work_q(), &settings_save_work, K_NO_WAIT);
+}
+
+void zmk_settings_save_flush_sync(void) {
+    struct k_work_sync sync;
+
+    // Submits the write straight away if it is still waiting, then waits for it to finish.
+    k_work_flush_delayable(&settings_save_work, &sync);
+}
+
+static void settings_save_work_handler(struct k_work *work) {
+    bool written = false;
+
+    for (int i = 0; i < ARRAY_SIZE(entries); i++) {
+        struct settings_save_entry entry;
+
+        // Copy the entry out so the write itself happens without holding the lock.
+        k_spinlock_key_t key = k_spin_lock(&lock);
+        entry = entries[i];
+        entries[i].dirty = false;
+        k_spin_unlock(&lock, key);
+
+        if (!entry.dirty) {
+            continue;
+        }
+
+        written = true;
+
+        int err = save_setting(entry.name, entry.value, entry.len);
+        if (err) {
+            LOG_ERR("Failed to save setting %s (err %d)", entry.name, err);
+        }
+    }
+
+    // Everything queued together that belongs in the blob is written with a single entry.
+    zmk_settings_blob_write();
+
+    if (written) {
+        count_write();
+    }
+}
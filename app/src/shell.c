@@ -0,0 +1,11 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <zephyr/shell/shell.h>
+
+SHELL_SUBCMD_SET_CREATE(zmk_shell_cmds, (zmk));
+
+SHELL_CMD_REGISTER(zmk, &zmk_shell_cmds, "ZMK commands", NULL);
@@ -6,6 +6,8 @@
 
 #include <zephyr/types.h>
 #include <zephyr/init.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/conn.h>
@@ -14,27 +16,50 @@
 #include <zephyr/bluetooth/hci.h>
 #include <zephyr/sys/byteorder.h>
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_HANDLE_CACHE)
+#include <zephyr/settings/settings.h>
+#endif
+
 #include <zephyr/logging/log.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #include <zmk/stdlib.h>
+#include <zmk/activity.h>
 #include <zmk/ble.h>
 #include <zmk/behavior.h>
+#include <zmk/pm.h>
+#include <zmk/power_stats.h>
 #include <zmk/sensors.h>
+#include <zmk/settings.h>
+#include <zmk/split/bluetooth/central.h>
+#include <zmk/split/bluetooth/central_telemetry.h>
 #include <zmk/split/bluetooth/uuid.h>
 #include <zmk/split/central.h>
 #include <zmk/split/service.h>
 #include <zmk/event_manager.h>
+#include <zmk/events/activity_state_changed.h>
 #include <zmk/events/position_state_changed.h>
 #include <zmk/events/sensor_event.h>
 #include <zmk/events/battery_state_changed.h>
 #include <zmk/hid_indicators_types.h>
+#include <zmk/boot_timing.h>
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+#include <zmk/rgb_underglow.h>
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
 
 static int start_scanning(void);
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+static void split_central_sync_hid_indicators(k_timeout_t delay);
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+
 #define POSITION_STATE_DATA_LEN 16
 
+// Behavior invocations batched into one write, further limited by the connection's ATT MTU.
+#define RUN_BEHAVIORS_BATCH_MAX 8
+
 enum peripheral_slot_state {
     PERIPHERAL_SLOT_STATE_OPEN,
     PERIPHERAL_SLOT_STATE_CONNECTING,
@@ -46,33 +71,118 @@ struct peripheral_slot {
     struct bt_conn *conn;
     struct bt_gatt_discover_params discover_params;
     struct bt_gatt_subscribe_params subscribe_params;
+    struct bt_gatt_subscribe_params events_subscribe_params;
+    struct bt_gatt_read_params resync_read_params;
     struct bt_gatt_subscribe_params sensor_subscribe_params;
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+    struct bt_gatt_subscribe_params input_subscribe_params;
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
     struct bt_gatt_discover_params sub_discover_params;
     uint16_t run_behavior_handle;
+    uint16_t run_behaviors_handle;
+    struct zmk_split_run_behavior_compact run_behaviors_batch[RUN_BEHAVIORS_BATCH_MAX];
+    uint8_t run_behaviors_batch_len;
 #if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING)
     struct bt_gatt_subscribe_params batt_lvl_subscribe_params;
     struct bt_gatt_read_params batt_lvl_read_params;
 #endif /* IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING) */
 #if IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
     uint16_t update_hid_indicators;
+    // The indicators last written to the peripheral, if hid_indicators_sent is set.
+    zmk_hid_indicators_t hid_indicators;
+    bool hid_indicators_sent;
 #endif // IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+    uint16_t update_underglow;
+    // The underglow state last written to the peripheral, if underglow_sent is set.
+    struct zmk_rgb_underglow_sync_state underglow;
+    bool underglow_sent;
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
     uint8_t position_state[POSITION_STATE_DATA_LEN];
     uint8_t changed_positions[POSITION_STATE_DATA_LEN];
+    uint8_t next_event_seq;
+    bool event_seq_valid;
+    bool resync_pending;
+    int64_t last_event_timestamp;
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_HANDLE_CACHE)
+    // Whether the subscriptions were made with cached handles, which discovery replaces if any
+    // of them fails.
+    bool handles_from_cache;
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_HANDLE_CACHE)
 };
 
 static struct peripheral_slot peripherals[ZMK_SPLIT_BLE_PERIPHERAL_COUNT];
 
+static int split_central_start_discovery(struct peripheral_slot *slot);
+
 static bool is_scanning = false;
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_FAST_RECONNECT)
+
+// Scan continuously for a while after boot or a peripheral disconnect, so the peripheral's high
+// duty cycle directed advertising is caught on its first few packets.
+static const struct bt_le_scan_param fast_scan_param =
+    BT_LE_SCAN_PARAM_INIT(BT_LE_SCAN_TYPE_PASSIVE, BT_LE_SCAN_OPT_FILTER_DUPLICATE,
+                          BT_GAP_SCAN_FAST_INTERVAL, BT_GAP_SCAN_FAST_INTERVAL);
+
+static bool fast_scanning = false;
+
+static void fast_scan_timeout_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(fast_scan_timeout_work, fast_scan_timeout_handler);
+
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_FAST_RECONNECT)
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_DYNAMIC_CONN_PARAMS)
+
+static const struct bt_le_conn_param active_conn_param =
+    BT_LE_CONN_PARAM_INIT(CONFIG_ZMK_SPLIT_BLE_PREF_INT, CONFIG_ZMK_SPLIT_BLE_PREF_INT,
+                          CONFIG_ZMK_SPLIT_BLE_ACTIVE_PREF_LATENCY,
+                          CONFIG_ZMK_SPLIT_BLE_PREF_TIMEOUT);
+
+static const struct bt_le_conn_param idle_conn_param =
+    BT_LE_CONN_PARAM_INIT(CONFIG_ZMK_SPLIT_BLE_IDLE_PREF_INT, CONFIG_ZMK_SPLIT_BLE_IDLE_PREF_INT,
+                          CONFIG_ZMK_SPLIT_BLE_IDLE_PREF_LATENCY,
+                          CONFIG_ZMK_SPLIT_BLE_PREF_TIMEOUT);
+
+static const struct bt_le_conn_param *split_central_conn_param(void) {
+    return zmk_activity_get_state() == ZMK_ACTIVITY_ACTIVE ? &active_conn_param : &idle_conn_param;
+}
+
+#else
+
+static const struct bt_le_conn_param conn_param =
+    BT_LE_CONN_PARAM_INIT(CONFIG_ZMK_SPLIT_BLE_PREF_INT, CONFIG_ZMK_SPLIT_BLE_PREF_INT,
+                          CONFIG_ZMK_SPLIT_BLE_PREF_LATENCY, CONFIG_ZMK_SPLIT_BLE_PREF_TIMEOUT);
+
+static const struct bt_le_conn_param *split_central_conn_param(void) { return &conn_param; }
+
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_DYNAMIC_CONN_PARAMS)
+
 static const struct bt_uuid_128 split_service_uuid = BT_UUID_INIT_128(ZMK_SPLIT_BT_SERVICE_UUID);
 
+/*
+ * The slot last found for each connection, plus one so zero means none. Every notification looks
+ * up its slot, so the hint saves scanning the slots each time. It is checked against the slot's
+ * connection before it is used, so a slot that has since been released or reused is never returned.
+ */
+static uint8_t slot_by_conn[CONFIG_BT_MAX_CONN];
+
 int peripheral_slot_index_for_conn(struct bt_conn *conn) {
+    uint8_t *entry = &slot_by_conn[bt_conn_index(conn)];
+
+    if (*entry != 0 && peripherals[*entry - 1].conn == conn) {
+        return *entry - 1;
+    }
+
     for (int i = 0; i < ZMK_SPLIT_BLE_PERIPHERAL_COUNT; i++) {
         if (peripherals[i].conn == conn) {
+            *entry = i + 1;
             return i;
         }
     }
 
+    *entry = 0;
     return -EINVAL;
 }
 
@@ -85,6 +195,40 @@ struct peripheral_slot *peripheral_slot_for_conn(struct bt_conn *conn) {
     return &peripherals[idx];
 }
 
+// Clean up previously discovered handles.
+static void reset_peripheral_handles(struct peripheral_slot *slot) {
+    slot->subscribe_params.value_handle = 0;
+    slot->subscribe_params.ccc_handle = 0;
+    slot->events_subscribe_params.value_handle = 0;
+    slot->events_subscribe_params.ccc_handle = 0;
+#if ZMK_KEYMAP_HAS_SENSORS
+    slot->sensor_subscribe_params.value_handle = 0;
+    slot->sensor_subscribe_params.ccc_handle = 0;
+#endif /* ZMK_KEYMAP_HAS_SENSORS */
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+    slot->input_subscribe_params.value_handle = 0;
+    slot->input_subscribe_params.ccc_handle = 0;
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING)
+    slot->batt_lvl_subscribe_params.value_handle = 0;
+    slot->batt_lvl_subscribe_params.ccc_handle = 0;
+#endif /* IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING) */
+    slot->run_behavior_handle = 0;
+    slot->run_behaviors_handle = 0;
+    slot->run_behaviors_batch_len = 0;
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+    slot->update_hid_indicators = 0;
+    slot->hid_indicators_sent = false;
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+    slot->update_underglow = 0;
+    slot->underglow_sent = false;
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_HANDLE_CACHE)
+    slot->handles_from_cache = false;
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_HANDLE_CACHE)
+}
+
 int release_peripheral_slot(int index) {
     if (index < 0 || index >= ZMK_SPLIT_BLE_PERIPHERAL_COUNT) {
         return -EINVAL;
@@ -123,12 +267,10 @@ int release_peripheral_slot(int index) {
         slot->changed_positions[i] = 0U;
     }
 
-    // Clean up previously discovered handles;
-    slot->subscribe_params.value_handle = 0;
-    slot->run_behavior_handle = 0;
-#if IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
-    slot->update_hid_indicators = 0;
-#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+    slot->event_seq_valid = false;
+    slot->resync_pending = false;
+
+    reset_peripheral_handles(slot);
 
     return 0;
 }
@@ -198,23 +340,35 @@ static uint8_t split_central_sensor_notify_func(struct bt_conn *conn,
 }
 #endif /* ZMK_KEYMAP_HAS_SENSORS */
 
-static uint8_t split_central_notify_func(struct bt_conn *conn,
-                                         struct bt_gatt_subscribe_params *params, const void *data,
-                                         uint16_t length) {
-    struct peripheral_slot *slot = peripheral_slot_for_conn(conn);
-
-    if (slot == NULL) {
-        LOG_ERR("No peripheral state found for connection");
-        return BT_GATT_ITER_CONTINUE;
-    }
-
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+static uint8_t split_central_input_notify_func(struct bt_conn *conn,
+                                               struct bt_gatt_subscribe_params *params,
+                                               const void *data, uint16_t length) {
     if (!data) {
         LOG_DBG("[UNSUBSCRIBED]");
         params->value_handle = 0U;
         return BT_GATT_ITER_STOP;
     }
 
-    LOG_DBG("[NOTIFICATION] data %p length %u", data, length);
+    struct zmk_split_input_frame frame;
+    if (length < sizeof(frame)) {
+        LOG_WRN("Ignoring input frame notify with insufficient data length (%d)", length);
+        return BT_GATT_ITER_CONTINUE;
+    }
+
+    memcpy(&frame, data, sizeof(frame));
+    zmk_split_input_frame_handle(&frame);
+
+    return BT_GATT_ITER_CONTINUE;
+}
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+
+static void split_central_apply_position_state(struct bt_conn *conn, struct peripheral_slot *slot,
+                                              const void *data, uint16_t length) {
+    if (length < POSITION_STATE_DATA_LEN) {
+        LOG_WRN("Ignoring position state with insufficient data length (%d)", length);
+        return;
+    }
 
     for (int i = 0; i < POSITION_STATE_DATA_LEN; i++) {
         slot->changed_positions[i] = ((uint8_t *)data)[i] ^ slot->position_state[i];
@@ -237,6 +391,150 @@ static uint8_t split_central_notify_func(struct bt_conn *conn,
         }
     }
 
+    slot->last_event_timestamp = k_uptime_get();
+}
+
+static uint8_t split_central_notify_func(struct bt_conn *conn,
+                                         struct bt_gatt_subscribe_params *params, const void *data,
+                                         uint16_t length) {
+    struct peripheral_slot *slot = peripheral_slot_for_conn(conn);
+
+    if (slot == NULL) {
+        LOG_ERR("No peripheral state found for connection");
+        return BT_GATT_ITER_CONTINUE;
+    }
+
+    if (!data) {
+        LOG_DBG("[UNSUBSCRIBED]");
+        params->value_handle = 0U;
+        return BT_GATT_ITER_STOP;
+    }
+
+    LOG_DBG("[NOTIFICATION] data %p length %u", data, length);
+
+    zmk_split_bt_telemetry_notification(peripheral_slot_index_for_conn(conn));
+    split_central_apply_position_state(conn, slot, data, length);
+
+    return BT_GATT_ITER_CONTINUE;
+}
+
+static uint8_t split_central_resync_read_func(struct bt_conn *conn, uint8_t err,
+                                              struct bt_gatt_read_params *params, const void *data,
+                                              uint16_t length) {
+    struct peripheral_slot *slot = peripheral_slot_for_conn(conn);
+
+    if (slot == NULL) {
+        LOG_ERR("No peripheral state found for connection");
+        return BT_GATT_ITER_STOP;
+    }
+
+    if (err > 0) {
+        LOG_ERR("Error during reading peripheral position state: %u", err);
+        slot->resync_pending = false;
+        return BT_GATT_ITER_STOP;
+    }
+
+    if (!data) {
+        LOG_DBG("[READ COMPLETED]");
+        slot->resync_pending = false;
+        return BT_GATT_ITER_STOP;
+    }
+
+    LOG_DBG("[POSITION STATE READ] data %p length %u", data, length);
+
+    split_central_apply_position_state(conn, slot, data, length);
+
+    return BT_GATT_ITER_CONTINUE;
+}
+
+// Read the full position state to recover from lost position events.
+static void split_central_resync_position_state(struct bt_conn *conn,
+                                                struct peripheral_slot *slot) {
+    if (slot->resync_pending || !slot->subscribe_params.value_handle) {
+        return;
+    }
+
+    slot->resync_read_params.func = split_central_resync_read_func;
+    slot->resync_read_params.handle_count = 1;
+    slot->resync_read_params.single.handle = slot->subscribe_params.value_handle;
+    slot->resync_read_params.single.offset = 0;
+
+    int err = bt_gatt_read(conn, &slot->resync_read_params);
+    if (err) {
+        LOG_ERR("Failed to read position state (err %d)", err);
+        return;
+    }
+
+    slot->resync_pending = true;
+}
+
+static uint8_t split_central_events_notify_func(struct bt_conn *conn,
+                                                struct bt_gatt_subscribe_params *params,
+                                                const void *data, uint16_t length) {
+    struct peripheral_slot *slot = peripheral_slot_for_conn(conn);
+
+    if (slot == NULL) {
+        LOG_ERR("No peripheral state found for connection");
+        return BT_GATT_ITER_CONTINUE;
+    }
+
+    if (!data) {
+        LOG_DBG("[UNSUBSCRIBED]");
+        params->value_handle = 0U;
+        return BT_GATT_ITER_STOP;
+    }
+
+    LOG_DBG("[EVENTS NOTIFICATION] data %p length %u", data, length);
+
+    zmk_split_bt_telemetry_notification(peripheral_slot_index_for_conn(conn));
+
+    const size_t header_len = offsetof(struct zmk_split_position_events, events);
+    if (length < header_len) {
+        LOG_WRN("Ignoring position events with insufficient data length (%d)", length);
+        return BT_GATT_ITER_CONTINUE;
+    }
+
+    struct zmk_split_position_events events;
+    memcpy(&events, data, MIN(length, sizeof(events)));
+    uint8_t count = MIN(events.count, (MIN(length, sizeof(events)) - header_len) /
+                                          sizeof(struct zmk_split_position_event));
+
+    if (slot->event_seq_valid && events.seq != slot->next_event_seq) {
+        LOG_WRN("Lost %d position events, resyncing", (uint8_t)(events.seq - slot->next_event_seq));
+        split_central_resync_position_state(conn, slot);
+    }
+    slot->next_event_seq = events.seq + count;
+    slot->event_seq_valid = true;
+
+    int64_t now = k_uptime_get();
+    for (int i = 0; i < count; i++) {
+        const struct zmk_split_position_event *event = &events.events[i];
+        if (event->position >= POSITION_STATE_DATA_LEN * 8) {
+            LOG_WRN("Ignoring event for out of range position %d", event->position);
+            continue;
+        }
+
+        uint8_t *byte = &slot->position_state[event->position / 8];
+        bool pressed = event->state != 0;
+
+        // A resync read may already have applied this change.
+        if (((*byte & BIT(event->position % 8)) != 0) == pressed) {
+            continue;
+        }
+        WRITE_BIT(*byte, event->position % 8, pressed);
+
+        // Keep timestamps in order even if the peripheral's reported ages jitter.
+        int64_t timestamp = MAX(now - event->age, slot->last_event_timestamp);
+        zmk_split_bt_telemetry_key_latency(peripheral_slot_index_for_conn(conn), event->age);
+        slot->last_event_timestamp = timestamp;
+
+        struct zmk_position_state_changed ev = {.source = peripheral_slot_index_for_conn(conn),
+                                                .position = event->position,
+                                                .state = pressed,
+                                                .timestamp = timestamp};
+        zmk_position_state_change_handle(&ev);
+    }
+
     return BT_GATT_ITER_CONTINUE;
 }
 
@@ -263,6 +561,11 @@ K_MSGQ_DEFINE(peripheral_batt_lvl_msgq, sizeof(struct zmk_peripheral_battery_sta
 void peripheral_batt_lvl_change_callback(struct k_work *work) {
     struct zmk_peripheral_battery_state_changed ev;
     while (k_msgq_get(&peripheral_batt_lvl_msgq, &ev, K_NO_WAIT) == 0) {
+        // The initial read and the first notification often report the same level.
+        if (peripheral_battery_levels[ev.source] == ev.state_of_charge) {
+            continue;
+        }
+
         LOG_DBG("Triggering peripheral battery level change %u", ev.state_of_charge);
         peripheral_battery_levels[ev.source] = ev.state_of_charge;
         raise_zmk_peripheral_battery_state_changed(ev);
@@ -344,7 +647,210 @@ static uint8_t split_central_battery_level_read_func(struct bt_conn *conn, uint8
 
 #endif /* IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING) */
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_HANDLE_CACHE)
+
+// Handles of a bonded peripheral's split service, so reconnecting can skip GATT discovery. Only
+// characteristics enabled in this build are expected to be non-zero.
+struct peripheral_handle_cache {
+    bt_addr_le_t addr;
+    uint16_t position_state;
+    uint16_t position_state_ccc;
+    uint16_t position_events;
+    uint16_t position_events_ccc;
+    uint16_t run_behavior;
+    uint16_t run_behaviors;
+    uint16_t sensor_state;
+    uint16_t sensor_state_ccc;
+    uint16_t input_frames;
+    uint16_t input_frames_ccc;
+    uint16_t update_hid_indicators;
+    uint16_t update_underglow;
+    uint16_t batt_lvl;
+    uint16_t batt_lvl_ccc;
+};
+
+static struct peripheral_handle_cache handle_caches[ZMK_SPLIT_BLE_PERIPHERAL_COUNT];
+
+static bool handle_cache_is_complete(const struct peripheral_handle_cache *cache) {
+    // The position events characteristic is optional, since older peripherals don't have it, and
+    // so are input frames, which only peripherals with input devices have.
+    bool complete = cache->run_behavior && cache->position_state && cache->position_state_ccc &&
+                    (!cache->position_events || cache->position_events_ccc) &&
+                    (!cache->input_frames || cache->input_frames_ccc);
+
+#if ZMK_KEYMAP_HAS_SENSORS
+    complete = complete && cache->sensor_state && cache->sensor_state_ccc;
+#endif /* ZMK_KEYMAP_HAS_SENSORS */
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+    complete = complete && cache->update_hid_indicators;
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+    complete = complete && cache->update_underglow;
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING)
+    complete = complete && cache->batt_lvl && cache->batt_lvl_ccc;
+#endif /* IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING) */
+
+    return complete;
+}
+
+static void handle_cache_from_slot(struct peripheral_slot *slot,
+                                   struct peripheral_handle_cache *cache) {
+    *cache = (struct peripheral_handle_cache){
+        .position_state = slot->subscribe_params.value_handle,
+        .position_state_ccc = slot->subscribe_params.ccc_handle,
+        .position_events = slot->events_subscribe_params.value_handle,
+        .position_events_ccc = slot->events_subscribe_params.ccc_handle,
+        .run_behavior = slot->run_behavior_handle,
+        .run_behaviors = slot->run_behaviors_handle,
+#if ZMK_KEYMAP_HAS_SENSORS
+        .sensor_state = slot->sensor_subscribe_params.value_handle,
+        .sensor_state_ccc = slot->sensor_subscribe_params.ccc_handle,
+#endif /* ZMK_KEYMAP_HAS_SENSORS */
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+        .input_frames = slot->input_subscribe_params.value_handle,
+        .input_frames_ccc = slot->input_subscribe_params.ccc_handle,
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+        .update_hid_indicators = slot->update_hid_indicators,
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+        .update_underglow = slot->update_underglow,
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING)
+        .batt_lvl = slot->batt_lvl_subscribe_params.value_handle,
+        .batt_lvl_ccc = slot->batt_lvl_subscribe_params.ccc_handle,
+#endif /* IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING) */
+    };
+    bt_addr_le_copy(&cache->addr, bt_conn_get_dst(slot->conn));
+}
+
+static void handle_cache_save_work_handler(struct k_work *work) {
+    for (int i = 0; i < ZMK_SPLIT_BLE_PERIPHERAL_COUNT; i++) {
+        struct peripheral_slot *slot = &peripherals[i];
+        if (slot->state != PERIPHERAL_SLOT_STATE_CONNECTED) {
+            continue;
+        }
+
+        struct peripheral_handle_cache cache;
+        handle_cache_from_slot(slot, &cache);
+        if (!handle_cache_is_complete(&cache) ||
+            memcmp(&cache, &handle_caches[i], sizeof(cache)) == 0) {
+            continue;
+        }
+
+        handle_caches[i] = cache;
+
+        char setting_name[32];
+        sprintf(setting_name, "split/central/handles/%d", i);
+        int err = settings_save_one(setting_name, &cache, sizeof(cache));
+        if (err) {
+            LOG_ERR("Failed to save peripheral %d handles (err %d)", i, err);
+        }
+    }
+}
+
+static K_WORK_DELAYABLE_DEFINE(handle_cache_save_work, handle_cache_save_work_handler);
+
+// Forgets the cached handles of a peripheral whose GATT table no longer matches them, and undoes
+// the subscriptions made with them so discovery can subscribe again with fresh handles.
+static void split_central_drop_cached_handles(struct peripheral_slot *slot,
+                                              struct bt_gatt_subscribe_params *failed) {
+    int i = slot - peripherals;
+
+    handle_caches[i] = (struct peripheral_handle_cache){0};
+
+    char setting_name[32];
+    sprintf(setting_name, "split/central/handles/%d", i);
+    int err = settings_delete(setting_name);
+    if (err) {
+        LOG_ERR("Failed to delete peripheral %d handles (err %d)", i, err);
+    }
+
+    struct bt_gatt_subscribe_params *subscriptions[] = {
+        &slot->subscribe_params,
+        &slot->events_subscribe_params,
+#if ZMK_KEYMAP_HAS_SENSORS
+        &slot->sensor_subscribe_params,
+#endif /* ZMK_KEYMAP_HAS_SENSORS */
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+        &slot->input_subscribe_params,
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING)
+        &slot->batt_lvl_subscribe_params,
+#endif /* IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING) */
+    };
+
+    // The stack already dropped the failed subscription. The others are still registered, and
+    // discovery would find them already subscribed without writing their new CCC handles. ATT
+    // requests are handled in order, so the unsubscribes complete before discovery gets to them.
+    for (int j = 0; j < ARRAY_SIZE(subscriptions); j++) {
+        if (subscriptions[j] != failed && subscriptions[j]->value_handle) {
+            bt_gatt_unsubscribe(slot->conn, subscriptions[j]);
+        }
+    }
+
+    reset_peripheral_handles(slot);
+    memset(&slot->discover_params, 0, sizeof(slot->discover_params));
+    memset(&slot->sub_discover_params, 0, sizeof(slot->sub_discover_params));
+}
+
+// CCC handles are only known once a subscription has completed, so the cache is saved from here.
+static void split_central_subscribe_cb(struct bt_conn *conn, uint8_t err,
+                                       struct bt_gatt_subscribe_params *params) {
+    if (err == 0) {
+        k_work_reschedule(&handle_cache_save_work, K_MSEC(CONFIG_ZMK_SETTINGS_SAVE_DEBOUNCE));
+        return;
+    }
+
+    struct peripheral_slot *slot = peripheral_slot_for_conn(conn);
+    if (slot == NULL || !slot->handles_from_cache) {
+        LOG_ERR("Subscribe failed (err %d)", err);
+        return;
+    }
+
+    // The peripheral's GATT table changed since the handles were cached, such as after a firmware
+    // update.
+    LOG_WRN("Failed to subscribe with cached handles (err %d), discovering", err);
+    split_central_drop_cached_handles(slot, params);
+
+    err = split_central_start_discovery(slot);
+    if (err) {
+        LOG_ERR("Discover failed(err %d)", err);
+    }
+}
+
+static int split_central_handles_set(const char *name, size_t len, settings_read_cb read_cb,
+                                     void *cb_arg) {
+    const char *next;
+
+    if (settings_name_steq(name, "handles", &next) && next) {
+        int i = atoi(next);
+        if (i < 0 || i >= ZMK_SPLIT_BLE_PERIPHERAL_COUNT || len != sizeof(handle_caches[i])) {
+            return -EINVAL;
+        }
+
+        int err = read_cb(cb_arg, &handle_caches[i], sizeof(handle_caches[i]));
+        if (err <= 0) {
+            LOG_ERR("Failed to handle peripheral handles from settings (err %d)", err);
+            return err;
+        }
+
+        return 0;
+    }
+
+    return -ENOENT;
+}
+
+static struct settings_handler split_central_handles_conf = {.name = "split/central",
+                                                              .h_set = split_central_handles_set};
+
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_HANDLE_CACHE)
+
 static int split_central_subscribe(struct bt_conn *conn, struct bt_gatt_subscribe_params *params) {
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_HANDLE_CACHE)
+    params->subscribe = split_central_subscribe_cb;
+#endif
     int err = bt_gatt_subscribe(conn, params);
     switch (err) {
     case -EALREADY:
@@ -391,6 +897,15 @@ static uint8_t split_central_chrc_discovery_func(struct bt_conn *conn,
         slot->subscribe_params.notify = split_central_notify_func;
         slot->subscribe_params.value = BT_GATT_CCC_NOTIFY;
         split_central_subscribe(conn, &slot->subscribe_params);
+    } else if (bt_uuid_cmp(chrc_uuid,
+                           BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_POSITION_EVENTS_UUID)) == 0) {
+        LOG_DBG("Found position events characteristic");
+        slot->events_subscribe_params.disc_params = &slot->sub_discover_params;
+        slot->events_subscribe_params.end_handle = slot->discover_params.end_handle;
+        slot->events_subscribe_params.value_handle = bt_gatt_attr_value_handle(attr);
+        slot->events_subscribe_params.notify = split_central_events_notify_func;
+        slot->events_subscribe_params.value = BT_GATT_CCC_NOTIFY;
+        split_central_subscribe(conn, &slot->events_subscribe_params);
 #if ZMK_KEYMAP_HAS_SENSORS
     } else if (bt_uuid_cmp(chrc_uuid, BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_SENSOR_STATE_UUID)) ==
                0) {
@@ -411,12 +926,35 @@ static uint8_t split_central_chrc_discovery_func(struct bt_conn *conn,
         slot->discover_params.uuid = NULL;
         slot->discover_params.start_handle = attr->handle + 2;
         slot->run_behavior_handle = bt_gatt_attr_value_handle(attr);
+    } else if (bt_uuid_cmp(chrc_uuid, BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_RUN_BEHAVIORS_UUID)) ==
+               0) {
+        LOG_DBG("Found run behaviors handle");
+        slot->run_behaviors_handle = bt_gatt_attr_value_handle(attr);
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+    } else if (bt_uuid_cmp(chrc_uuid, BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_INPUT_FRAMES_UUID)) ==
+               0) {
+        LOG_DBG("Found input frames characteristic");
+        slot->input_subscribe_params.disc_params = &slot->sub_discover_params;
+        slot->input_subscribe_params.end_handle = slot->discover_params.end_handle;
+        slot->input_subscribe_params.value_handle = bt_gatt_attr_value_handle(attr);
+        slot->input_subscribe_params.notify = split_central_input_notify_func;
+        slot->input_subscribe_params.value = BT_GATT_CCC_NOTIFY;
+        split_central_subscribe(conn, &slot->input_subscribe_params);
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
 #if IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
     } else if (!bt_uuid_cmp(((struct bt_gatt_chrc *)attr->user_data)->uuid,
                             BT_UUID_DECLARE_128(ZMK_SPLIT_BT_UPDATE_HID_INDICATORS_UUID))) {
         LOG_DBG("Found update HID indicators handle");
         slot->update_hid_indicators = bt_gatt_attr_value_handle(attr);
+        split_central_sync_hid_indicators(K_NO_WAIT);
 #endif // IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+    } else if (!bt_uuid_cmp(((struct bt_gatt_chrc *)attr->user_data)->uuid,
+                            BT_UUID_DECLARE_128(ZMK_SPLIT_BT_UPDATE_UNDERGLOW_UUID))) {
+        LOG_DBG("Found update underglow handle");
+        slot->update_underglow = bt_gatt_attr_value_handle(attr);
+        zmk_split_bt_sync_underglow();
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
 #if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING)
     } else if (!bt_uuid_cmp(((struct bt_gatt_chrc *)attr->user_data)->uuid,
                             BT_UUID_BAS_BATTERY_LEVEL)) {
@@ -436,15 +974,28 @@ static uint8_t split_central_chrc_discovery_func(struct bt_conn *conn,
 #endif /* IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING) */
     }
 
-    bool subscribed = slot->run_behavior_handle && slot->subscribe_params.value_handle;
+    // Peripherals without the position events or batched run behaviors characteristics fall back to
+    // the older ones, after discovery has run to the end of the service.
+    bool subscribed = slot->run_behavior_handle && slot->run_behaviors_handle &&
+                      slot->subscribe_params.value_handle &&
+                      slot->events_subscribe_params.value_handle;
 
 #if ZMK_KEYMAP_HAS_SENSORS
     subscribed = subscribed && slot->sensor_subscribe_params.value_handle;
 #endif /* ZMK_KEYMAP_HAS_SENSORS */
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+    // Only peripherals with input devices have input frames, so the others are discovered to the
+    // end of the service.
+    subscribed = subscribed && slot->input_subscribe_params.value_handle;
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+
 #if IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
     subscribed = subscribed && slot->update_hid_indicators;
 #endif // IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+    subscribed = subscribed && slot->update_underglow;
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
 #if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING)
     subscribed = subscribed && slot->batt_lvl_subscribe_params.value_handle;
 #endif /* IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING) */
@@ -487,6 +1038,104 @@ static uint8_t split_central_service_discovery_func(struct bt_conn *conn,
     return BT_GATT_ITER_STOP;
 }
 
+static int split_central_start_discovery(struct peripheral_slot *slot) {
+    slot->discover_params.uuid = &split_service_uuid.uuid;
+    slot->discover_params.func = split_central_service_discovery_func;
+    slot->discover_params.start_handle = 0x0001;
+    slot->discover_params.end_handle = 0xffff;
+    slot->discover_params.type = BT_GATT_DISCOVER_PRIMARY;
+
+    return bt_gatt_discover(slot->conn, &slot->discover_params);
+}
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_HANDLE_CACHE)
+
+static int split_central_subscribe_cached(struct bt_conn *conn,
+                                          struct bt_gatt_subscribe_params *params,
+                                          bt_gatt_notify_func_t notify, uint16_t value_handle,
+                                          uint16_t ccc_handle) {
+    params->value_handle = value_handle;
+    params->ccc_handle = ccc_handle;
+    params->notify = notify;
+    params->value = BT_GATT_CCC_NOTIFY;
+
+    int err = split_central_subscribe(conn, params);
+    return err == -EALREADY ? 0 : err;
+}
+
+// Set up the peripheral from its cached handles instead of discovering them. Returns false if
+// there is no usable cache, in which case discovery must run.
+static bool split_central_use_cached_handles(struct bt_conn *conn, struct peripheral_slot *slot) {
+    const struct peripheral_handle_cache *cache = &handle_caches[slot - peripherals];
+
+    if (bt_addr_le_cmp(&cache->addr, bt_conn_get_dst(conn)) != 0 ||
+        !handle_cache_is_complete(cache)) {
+        return false;
+    }
+
+    LOG_DBG("Using cached split service handles");
+
+    slot->run_behavior_handle = cache->run_behavior;
+    slot->run_behaviors_handle = cache->run_behaviors;
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+    slot->update_hid_indicators = cache->update_hid_indicators;
+    split_central_sync_hid_indicators(K_NO_WAIT);
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+    slot->update_underglow = cache->update_underglow;
+    zmk_split_bt_sync_underglow();
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+
+    int err = split_central_subscribe_cached(conn, &slot->subscribe_params,
+                                             split_central_notify_func, cache->position_state,
+                                             cache->position_state_ccc);
+    if (!err && cache->position_events) {
+        err = split_central_subscribe_cached(conn, &slot->events_subscribe_params,
+                                             split_central_events_notify_func,
+                                             cache->position_events, cache->position_events_ccc);
+    }
+#if ZMK_KEYMAP_HAS_SENSORS
+    if (!err) {
+        err = split_central_subscribe_cached(conn, &slot->sensor_subscribe_params,
+                                             split_central_sensor_notify_func, cache->sensor_state,
+                                             cache->sensor_state_ccc);
+    }
+#endif /* ZMK_KEYMAP_HAS_SENSORS */
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+    if (!err && cache->input_frames) {
+        err = split_central_subscribe_cached(conn, &slot->input_subscribe_params,
+                                             split_central_input_notify_func,
+                                             cache->input_frames, cache->input_frames_ccc);
+    }
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING)
+    if (!err) {
+        err = split_central_subscribe_cached(conn, &slot->batt_lvl_subscribe_params,
+                                             split_central_battery_level_notify_func,
+                                             cache->batt_lvl, cache->batt_lvl_ccc);
+    }
+    if (!err) {
+        slot->batt_lvl_read_params.func = split_central_battery_level_read_func;
+        slot->batt_lvl_read_params.handle_count = 1;
+        slot->batt_lvl_read_params.single.handle = cache->batt_lvl;
+        slot->batt_lvl_read_params.single.offset = 0;
+        bt_gatt_read(conn, &slot->batt_lvl_read_params);
+    }
+#endif /* IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING) */
+
+    if (err) {
+        // Discovery subscribes again with freshly discovered handles, and saves those.
+        LOG_WRN("Failed to subscribe with cached handles (err %d), discovering", err);
+        split_central_drop_cached_handles(slot, NULL);
+        return false;
+    }
+
+    slot->handles_from_cache = true;
+    return true;
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_HANDLE_CACHE)
+
 static void split_central_process_connection(struct bt_conn *conn) {
     int err;
 
@@ -498,20 +1147,42 @@ static void split_central_process_connection(struct bt_conn *conn) {
         return;
     }
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_HANDLE_CACHE)
     if (!slot->subscribe_params.value_handle) {
-        slot->discover_params.uuid = &split_service_uuid.uuid;
-        slot->discover_params.func = split_central_service_discovery_func;
-        slot->discover_params.start_handle = 0x0001;
-        slot->discover_params.end_handle = 0xffff;
-        slot->discover_params.type = BT_GATT_DISCOVER_PRIMARY;
+        split_central_use_cached_handles(conn, slot);
+    }
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_HANDLE_CACHE)
 
-        err = bt_gatt_discover(slot->conn, &slot->discover_params);
+    if (!slot->subscribe_params.value_handle) {
+        err = split_central_start_discovery(slot);
         if (err) {
             LOG_ERR("Discover failed(err %d)", err);
             return;
         }
     }
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_PREF_2M_PHY)
+    err = bt_conn_le_phy_update(conn, BT_CONN_LE_PHY_PARAM_2M);
+    if (err) {
+        LOG_WRN("Failed to request 2M PHY (err %d)", err);
+    }
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_PREF_2M_PHY)
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_DATA_LEN_EXTENSION)
+    err = bt_conn_le_data_len_update(conn, BT_LE_DATA_LEN_PARAM_MAX);
+    if (err) {
+        LOG_WRN("Failed to request data length extension (err %d)", err);
+    }
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_DATA_LEN_EXTENSION)
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_DYNAMIC_CONN_PARAMS)
+    // The activity state may have changed while connecting.
+    err = bt_conn_le_param_update(conn, split_central_conn_param());
+    if (err) {
+        LOG_WRN("Failed to update connection parameters (err %d)", err);
+    }
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_DYNAMIC_CONN_PARAMS)
+
     struct bt_conn_info info;
 
     bt_conn_get_info(conn, &info);
@@ -523,6 +1194,8 @@ static void split_central_process_connection(struct bt_conn *conn) {
     start_scanning();
 }
 
+bool zmk_split_bt_central_is_scanning(void) { return is_scanning; }
+
 static int stop_scanning(void) {
     LOG_DBG("Stopping peripheral scanning");
     is_scanning = false;
@@ -556,10 +1229,7 @@ static bool split_central_eir_found(const bt_addr_le_t *addr) {
     }
 
     LOG_DBG("Initiating new connection");
-    struct bt_le_conn_param *param =
-        BT_LE_CONN_PARAM(CONFIG_ZMK_SPLIT_BLE_PREF_INT, CONFIG_ZMK_SPLIT_BLE_PREF_INT,
-                         CONFIG_ZMK_SPLIT_BLE_PREF_LATENCY, CONFIG_ZMK_SPLIT_BLE_PREF_TIMEOUT);
-    err = bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN, param, &slot->conn);
+    err = bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN, split_central_conn_param(), &slot->conn);
     if (err < 0) {
         LOG_ERR("Create conn failed (err %d) (create conn? 0x%04x)", err, BT_HCI_OP_LE_CREATE_CONN);
         release_peripheral_slot(slot_idx);
@@ -646,7 +1316,12 @@ static int start_scanning(void) {
 
     // Start scanning otherwise.
     is_scanning = true;
-    int err = bt_le_scan_start(BT_LE_SCAN_PASSIVE, split_central_device_found);
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_FAST_RECONNECT)
+    const struct bt_le_scan_param *param = fast_scanning ? &fast_scan_param : BT_LE_SCAN_PASSIVE;
+#else
+    const struct bt_le_scan_param *param = BT_LE_SCAN_PASSIVE;
+#endif
+    int err = bt_le_scan_start(param, split_central_device_found);
     if (err < 0) {
         LOG_ERR("Scanning failed to start (err %d)", err);
         return err;
@@ -656,6 +1331,32 @@ static int start_scanning(void) {
     return 0;
 }
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_FAST_RECONNECT)
+
+static int start_fast_scanning(void) {
+    fast_scanning = true;
+    k_work_reschedule(&fast_scan_timeout_work,
+                      K_MSEC(CONFIG_ZMK_SPLIT_BLE_FAST_RECONNECT_SCAN_DURATION_MS));
+
+    // Restart a slow scan which is already running with the fast parameters.
+    if (is_scanning) {
+        stop_scanning();
+    }
+    return start_scanning();
+}
+
+static void fast_scan_timeout_handler(struct k_work *work) {
+    fast_scanning = false;
+
+    if (is_scanning) {
+        LOG_DBG("No peripheral reconnected quickly, switching to a slow scan");
+        stop_scanning();
+        start_scanning();
+    }
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_FAST_RECONNECT)
+
 static void split_central_connected(struct bt_conn *conn, uint8_t conn_err) {
     char addr[BT_ADDR_LE_STR_LEN];
     struct bt_conn_info info;
@@ -681,6 +1382,8 @@ static void split_central_connected(struct bt_conn *conn, uint8_t conn_err) {
     LOG_DBG("Connected: %s", addr);
 
     confirm_peripheral_slot_conn(conn);
+    zmk_boot_timing_mark("split connected");
+    zmk_split_bt_telemetry_connected(peripheral_slot_index_for_conn(conn), conn);
     split_central_process_connection(conn);
 }
 
@@ -699,34 +1402,130 @@ static void split_central_disconnected(struct bt_conn *conn, uint8_t reason) {
     k_work_submit(&peripheral_batt_lvl_work);
 #endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_FETCHING)
 
+    zmk_split_bt_telemetry_disconnected(peripheral_slot_index_for_conn(conn));
+
     err = release_peripheral_slot_for_conn(conn);
 
     if (err < 0) {
         return;
     }
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_FAST_RECONNECT)
+    start_fast_scanning();
+#else
     start_scanning();
+#endif
+}
+
+static void split_central_le_param_updated(struct bt_conn *conn, uint16_t interval,
+                                          uint16_t latency, uint16_t timeout) {
+    int slot = peripheral_slot_index_for_conn(conn);
+    if (slot < 0) {
+        return;
+    }
+
+    LOG_DBG("Peripheral %d: interval %d latency %d timeout %d", slot, interval, latency, timeout);
+
+    zmk_split_bt_telemetry_conn_params(slot, interval, latency, timeout);
 }
 
 static struct bt_conn_cb conn_callbacks = {
     .connected = split_central_connected,
     .disconnected = split_central_disconnected,
+    .le_param_updated = split_central_le_param_updated,
 };
 
+// Behavior run writes handed to the stack but not sent yet, so soft off can wait for them.
+static atomic_t run_writes_in_flight;
+
+static void split_central_run_write_sent(struct bt_conn *conn, void *user_data) {
+    atomic_dec(&run_writes_in_flight);
+}
+
+static int split_central_write_run(struct bt_conn *conn, uint16_t handle, const void *data,
+                                   uint16_t length) {
+    atomic_inc(&run_writes_in_flight);
+
+    int err = bt_gatt_write_without_response_cb(conn, handle, data, length, true,
+                                                split_central_run_write_sent, NULL);
+    if (err) {
+        atomic_dec(&run_writes_in_flight);
+    } else {
+        zmk_power_stats_record(ZMK_POWER_STATS_SPLIT_MESSAGE);
+    }
+
+    return err;
+}
+
+static bool split_central_flush(void) {
+    // Save the handles now rather than at the end of the debounce, which sleep would cut short.
+    if (k_work_delayable_is_pending(&handle_cache_save_work)) {
+        k_work_cancel_delayable(&handle_cache_save_work);
+        handle_cache_save_work_handler(NULL);
+    }
+
+    return atomic_get(&run_writes_in_flight) == 0;
+}
+
+ZMK_PM_FLUSH_DEFINE(split_central, split_central_flush);
+
+static void split_central_flush_run_behaviors(struct peripheral_slot *slot) {
+    if (slot->run_behaviors_batch_len == 0) {
+        return;
+    }
+
+    int err = split_central_write_run(
+        slot->conn, slot->run_behaviors_handle, slot->run_behaviors_batch,
+        slot->run_behaviors_batch_len * sizeof(slot->run_behaviors_batch[0]));
+    if (err) {
+        LOG_ERR("Failed to write the run behaviors characteristic (err %d)", err);
+    }
+
+    slot->run_behaviors_batch_len = 0;
+}
+
+void send_split_run_flush_impl(void) {
+    for (int i = 0; i < ZMK_SPLIT_BLE_PERIPHERAL_COUNT; i++) {
+        if (peripherals[i].state == PERIPHERAL_SLOT_STATE_CONNECTED) {
+            split_central_flush_run_behaviors(&peripherals[i]);
+        }
+    }
+}
+
 void send_split_run_impl(struct zmk_split_run_behavior_payload_wrapper *payload_wrapper) {
     if (peripherals[payload_wrapper->source].state != PERIPHERAL_SLOT_STATE_CONNECTED) {
         LOG_ERR("Source not connected");
         return;
     }
+
+    struct peripheral_slot *slot = &peripherals[payload_wrapper->source];
+
+    // Batch invocations for peripherals which support it, until the batch fills a write.
+    if (slot->run_behaviors_handle) {
+        size_t max = MIN(ARRAY_SIZE(slot->run_behaviors_batch),
+                         (bt_gatt_get_mtu(slot->conn) - 3) /
+                             sizeof(struct zmk_split_run_behavior_compact));
+        if (slot->run_behaviors_batch_len >= max) {
+            split_central_flush_run_behaviors(slot);
+        }
+
+        slot->run_behaviors_batch[slot->run_behaviors_batch_len++] =
+            (struct zmk_split_run_behavior_compact){
+                .behavior_id = payload_wrapper->behavior_id,
+                .data = payload_wrapper->payload.data,
+            };
+        return;
+    }
+
     if (!peripherals[payload_wrapper->source].run_behavior_handle) {
         LOG_ERR("Run behavior handle not found");
         return;
     }
 
-    int err = bt_gatt_write_without_response(
-        peripherals[payload_wrapper->source].conn,
-        peripherals[payload_wrapper->source].run_behavior_handle, &payload_wrapper->payload,
-        sizeof(struct zmk_split_run_behavior_payload), true);
+    int err = split_central_write_run(peripherals[payload_wrapper->source].conn,
+                                      peripherals[payload_wrapper->source].run_behavior_handle,
+                                      &payload_wrapper->payload,
+                                      sizeof(struct zmk_split_run_behavior_payload));
 
     if (err) {
         LOG_ERR("Failed to write the behavior characteristic (err %d)", err);
@@ -740,39 +1539,184 @@ static zmk_hid_indicators_t hid_indicators = 0;
 static void split_central_update_indicators_callback(struct k_work *work) {
     zmk_hid_indicators_t indicators = hid_indicators;
     for (int i = 0; i < ZMK_SPLIT_BLE_PERIPHERAL_COUNT; i++) {
-        if (peripherals[i].state != PERIPHERAL_SLOT_STATE_CONNECTED) {
+        struct peripheral_slot *slot = &peripherals[i];
+
+        if (slot->state != PERIPHERAL_SLOT_STATE_CONNECTED) {
             continue;
         }
 
-        if (peripherals[i].update_hid_indicators == 0) {
+        if (slot->update_hid_indicators == 0) {
             // It appears that sometimes the peripheral is considered connected
             // before the GATT characteristics have been discovered. If this is
             // the case, the update_hid_indicators handle will not yet be set.
             continue;
         }
 
-        int err = bt_gatt_write_without_response(peripherals[i].conn,
-                                                 peripherals[i].update_hid_indicators, &indicators,
-                                                 sizeof(indicators), true);
+        // Hosts repeat the LED report on focus changes and the like, which peripherals don't need.
+        if (slot->hid_indicators_sent && slot->hid_indicators == indicators) {
+            continue;
+        }
+
+        int err = bt_gatt_write_without_response(slot->conn, slot->update_hid_indicators,
+                                                 &indicators, sizeof(indicators), true);
 
         if (err) {
             LOG_ERR("Failed to write HID indicator characteristic (err %d)", err);
+            continue;
         }
+
+        zmk_power_stats_record(ZMK_POWER_STATS_SPLIT_MESSAGE);
+        slot->hid_indicators = indicators;
+        slot->hid_indicators_sent = true;
     }
 }
 
-static K_WORK_DEFINE(split_central_update_indicators, split_central_update_indicators_callback);
+static K_WORK_DELAYABLE_DEFINE(split_central_update_indicators,
+                               split_central_update_indicators_callback);
+
+// An already scheduled write keeps its time and sends the latest indicators, so changes within the
+// coalescing window end up in a single write.
+static void split_central_sync_hid_indicators(k_timeout_t delay) {
+    k_work_schedule_for_queue(&split_central_split_run_q, &split_central_update_indicators, delay);
+}
 
 int zmk_split_bt_update_hid_indicator(zmk_hid_indicators_t indicators) {
     hid_indicators = indicators;
-    return k_work_submit_to_queue(&split_central_split_run_q, &split_central_update_indicators);
+    split_central_sync_hid_indicators(
+        K_MSEC(CONFIG_ZMK_SPLIT_BLE_CENTRAL_HID_INDICATORS_COALESCE_MS));
+    return 0;
 }
 
 #endif // IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+
+// Set to resend the animation step to every peripheral, even if nothing else changed.
+static atomic_t underglow_resync;
+
+static bool underglow_state_equal(const struct zmk_rgb_underglow_sync_state *a,
+                                  const struct zmk_rgb_underglow_sync_state *b) {
+    // The animation step advances every frame, so it's only sent along with other changes.
+    return a->color.h == b->color.h && a->color.s == b->color.s && a->color.b == b->color.b &&
+           a->effect == b->effect && a->speed == b->speed && a->on == b->on;
+}
+
+static void split_central_sync_underglow_callback(struct k_work *work) {
+    struct zmk_rgb_underglow_sync_state sync;
+    zmk_rgb_underglow_get_sync_state(&sync);
+
+    const bool resync = atomic_clear(&underglow_resync);
+
+    for (int i = 0; i < ZMK_SPLIT_BLE_PERIPHERAL_COUNT; i++) {
+        struct peripheral_slot *slot = &peripherals[i];
+
+        if (slot->state != PERIPHERAL_SLOT_STATE_CONNECTED || slot->update_underglow == 0) {
+            continue;
+        }
+
+        if (slot->underglow_sent && !resync && underglow_state_equal(&slot->underglow, &sync)) {
+            continue;
+        }
+
+        int err = bt_gatt_write_without_response(slot->conn, slot->update_underglow, &sync,
+                                                 sizeof(sync), true);
+        if (err) {
+            LOG_ERR("Failed to write underglow characteristic (err %d)", err);
+            continue;
+        }
+
+        zmk_power_stats_record(ZMK_POWER_STATS_SPLIT_MESSAGE);
+        slot->underglow = sync;
+        slot->underglow_sent = true;
+    }
+}
+
+static K_WORK_DEFINE(split_central_sync_underglow, split_central_sync_underglow_callback);
+
+int zmk_split_bt_sync_underglow(void) {
+    return k_work_submit_to_queue(&split_central_split_run_q, &split_central_sync_underglow);
+}
+
+#if CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC_INTERVAL_SEC > 0
+
+static void split_central_underglow_resync_callback(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(split_central_underglow_resync,
+                               split_central_underglow_resync_callback);
+
+static void split_central_underglow_resync_callback(struct k_work *work) {
+    bool on;
+
+    if (zmk_rgb_underglow_get_state(&on) == 0 && on) {
+        atomic_set(&underglow_resync, 1);
+        zmk_split_bt_sync_underglow();
+    }
+
+    k_work_schedule(&split_central_underglow_resync,
+                    K_SECONDS(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC_INTERVAL_SEC));
+}
+
+static int split_central_underglow_resync_init(void) {
+    k_work_schedule(&split_central_underglow_resync,
+                    K_SECONDS(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC_INTERVAL_SEC));
+    return 0;
+}
+
+ZMK_SYS_INIT(split_central_underglow_resync_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#endif // CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC_INTERVAL_SEC > 0
+
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_DYNAMIC_CONN_PARAMS)
+
+static int split_central_activity_listener(const zmk_event_t *eh) {
+    const struct bt_le_conn_param *param = split_central_conn_param();
+
+    for (int i = 0; i < ZMK_SPLIT_BLE_PERIPHERAL_COUNT; i++) {
+        if (peripherals[i].state != PERIPHERAL_SLOT_STATE_CONNECTED) {
+            continue;
+        }
+
+        int err = bt_conn_le_param_update(peripherals[i].conn, param);
+        if (err) {
+            LOG_WRN("Failed to update connection parameters for peripheral %d (err %d)", i, err);
+        }
+    }
+
+    return ZMK_EV_EVENT_BUBBLE;
+}
+
+ZMK_LISTENER(split_central_activity, split_central_activity_listener);
+ZMK_SUBSCRIPTION(split_central_activity, zmk_activity_state_changed);
+
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_DYNAMIC_CONN_PARAMS)
+
 static int zmk_split_bt_central_init(void) {
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_HANDLE_CACHE)
+    settings_subsys_init();
+
+    int err = settings_register(&split_central_handles_conf);
+    if (err) {
+        LOG_ERR("Failed to register the split central settings handler (err %d)", err);
+        return err;
+    }
+
+    zmk_settings_load_subtree("split/central");
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_CENTRAL_HANDLE_CACHE)
+
     bt_conn_cb_register(&conn_callbacks);
-    return IS_ENABLED(CONFIG_ZMK_BLE_CLEAR_BONDS_ON_START) ? 0 : start_scanning();
+
+    if (IS_ENABLED(CONFIG_ZMK_BLE_CLEAR_BONDS_ON_START)) {
+        return 0;
+    }
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_FAST_RECONNECT)
+    // Waking from deep sleep boots both halves, so look for the peripheral quickly here too.
+    return start_fast_scanning();
+#else
+    return start_scanning();
+#endif
 }
 
-SYS_INIT(zmk_split_bt_central_init, APPLICATION, CONFIG_ZMK_SPLIT_INIT_PRIORITY);
+ZMK_SYS_INIT(zmk_split_bt_central_init, APPLICATION, CONFIG_ZMK_SPLIT_INIT_PRIORITY);
@@ -10,6 +10,7 @@
 #include <zephyr/kernel.h>
 #include <zephyr/drivers/sensor.h>
 #include <zephyr/bluetooth/gatt.h>
+#include <zephyr/sys/atomic.h>
 
 #include <zephyr/logging/log.h>
 
@@ -68,6 +69,34 @@ BT_GATT_SERVICE_DEFINE(bas_aux, BT_GATT_PRIMARY_SERVICE(BT_UUID_BAS),
                        LISTIFY(CONFIG_ZMK_SPLIT_BLE_CENTRAL_PERIPHERALS, PERIPH_BATT_LEVEL_ATTRS,
                                ()));
 
+// Levels waiting to be notified to hosts, and the last ones notified.
+static uint8_t pending_levels[CONFIG_ZMK_SPLIT_BLE_CENTRAL_PERIPHERALS];
+static uint8_t notified_levels[CONFIG_ZMK_SPLIT_BLE_CENTRAL_PERIPHERALS];
+static atomic_t pending_sources;
+
+static void notify_work_handler(struct k_work *work) {
+    for (int i = 0; i < CONFIG_ZMK_SPLIT_BLE_CENTRAL_PERIPHERALS; i++) {
+        if (!atomic_test_and_clear_bit(&pending_sources, i) ||
+            pending_levels[i] == notified_levels[i]) {
+            continue;
+        }
+
+        // Offset by the index of the source plus the specific offset to find the attribute to
+        // notify on.
+        int index = (PERIPH_BATT_LEVEL_ATTR_COUNT * i) + PERIPH_BATT_LEVEL_ATTR_NOTIFY_IDX;
+
+        int rc = bt_gatt_notify(NULL, &bas_aux.attrs[index], &pending_levels[i], sizeof(uint8_t));
+        if (rc < 0 && rc != -ENOTCONN) {
+            LOG_WRN("Failed to notify hosts of peripheral battery level: %d", rc);
+            continue;
+        }
+
+        notified_levels[i] = pending_levels[i];
+    }
+}
+
+static K_WORK_DELAYABLE_DEFINE(notify_work, notify_work_handler);
+
 int peripheral_batt_lvl_listener(const zmk_event_t *eh) {
     const struct zmk_peripheral_battery_state_changed *ev =
         as_zmk_peripheral_battery_state_changed(eh);
@@ -82,14 +111,12 @@ int peripheral_batt_lvl_listener(const zmk_event_t *eh) {
 
     LOG_DBG("Peripheral battery level event: %u", ev->state_of_charge);
 
-    // Offset by the index of the source plus the specific offset to find the attribute to notify
-    // on.
-    int index = (PERIPH_BATT_LEVEL_ATTR_COUNT * ev->source) + PERIPH_BATT_LEVEL_ATTR_NOTIFY_IDX;
-
-    int rc = bt_gatt_notify(NULL, &bas_aux.attrs[index], &ev->state_of_charge, sizeof(uint8_t));
-    if (rc < 0 && rc != -ENOTCONN) {
-        LOG_WRN("Failed to notify hosts of peripheral battery level: %d", rc);
-    }
+    // Changes in quick succession, such as a peripheral disconnecting and reconnecting, are
+    // coalesced into a single notification of the final level.
+    pending_levels[ev->source] = ev->state_of_charge;
+    atomic_set_bit(&pending_sources, ev->source);
+    k_work_schedule(&notify_work,
+                    K_MSEC(CONFIG_ZMK_SPLIT_BLE_CENTRAL_BATTERY_LEVEL_PROXY_DELAY_MS));
 
     return ZMK_EV_EVENT_BUBBLE;
 };
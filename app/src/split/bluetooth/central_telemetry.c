@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/ble.h>
+#include <zmk/split/bluetooth/central_telemetry.h>
+#include <zmk/events/split_ble_link_stats_changed.h>
+#include <zmk/workqueue.h>
+
+struct link_telemetry {
+    struct bt_conn *conn;
+    int64_t window_start;
+    // Accumulated over the current reporting interval.
+    uint32_t notifications;
+    uint32_t key_events;
+    uint32_t key_latency_sum_ms;
+    uint16_t key_latency_max_ms;
+    // Last completed reporting interval and connection state.
+    struct zmk_split_ble_link_stats stats;
+};
+
+static struct link_telemetry links[ZMK_SPLIT_BLE_PERIPHERAL_COUNT];
+
+// Counters are updated from the Bluetooth receive thread and read from the low priority queue.
+static struct k_spinlock lock;
+
+static void telemetry_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(telemetry_work, telemetry_work_handler);
+
+static int read_rssi(struct bt_conn *conn, int8_t *rssi) {
+    uint16_t handle;
+    int err = bt_hci_get_conn_handle(conn, &handle);
+    if (err) {
+        return err;
+    }
+
+    struct net_buf *buf =
+        bt_hci_cmd_create(BT_HCI_OP_READ_RSSI, sizeof(struct bt_hci_cp_read_rssi));
+    if (!buf) {
+        return -ENOBUFS;
+    }
+
+    struct bt_hci_cp_read_rssi *cp = net_buf_add(buf, sizeof(*cp));
+    cp->handle = sys_cpu_to_le16(handle);
+
+    struct net_buf *rsp;
+    err = bt_hci_cmd_send_sync(BT_HCI_OP_READ_RSSI, buf, &rsp);
+    if (err) {
+        return err;
+    }
+
+    struct bt_hci_rp_read_rssi *rp = (void *)rsp->data;
+    err = rp->status ? -EIO : 0;
+    if (!err) {
+        *rssi = rp->rssi;
+    }
+    net_buf_unref(rsp);
+
+    return err;
+}
+
+static void telemetry_work_handler(struct k_work *work) {
+    int64_t now = k_uptime_get();
+    bool connected = false;
+
+    for (uint8_t slot = 0; slot < ARRAY_SIZE(links); slot++) {
+        struct link_telemetry *link = &links[slot];
+
+        k_spinlock_key_t key = k_spin_lock(&lock);
+        struct bt_conn *conn = link->conn ? bt_conn_ref(link->conn) : NULL;
+        k_spin_unlock(&lock, key);
+
+        if (!conn) {
+            continue;
+        }
+        connected = true;
+
+        int8_t rssi;
+        int err = read_rssi(conn, &rssi);
+        if (err) {
+            LOG_WRN("Failed to read RSSI of peripheral %d (err %d)", slot, err);
+        }
+        bt_conn_unref(conn);
+
+        key = k_spin_lock(&lock);
+
+        // The peripheral may have disconnected while reading the RSSI.
+        if (!link->conn) {
+            k_spin_unlock(&lock, key);
+            continue;
+        }
+
+        if (!err) {
+            // Smooth out the large swings in RSSI between individual reads.
+            link->stats.rssi = link->stats.rssi ? (link->stats.rssi * 3 + rssi) / 4 : rssi;
+        }
+
+        int64_t elapsed = MAX(now - link->window_start, 1);
+        link->stats.notify_rate = link->notifications * MSEC_PER_SEC / elapsed;
+        link->stats.key_latency_avg_ms =
+            link->key_events ? link->key_latency_sum_ms / link->key_events : 0;
+        link->stats.key_latency_max_ms = link->key_latency_max_ms;
+
+        link->window_start = now;
+        link->notifications = 0;
+        link->key_events = 0;
+        link->key_latency_sum_ms = 0;
+        link->key_latency_max_ms = 0;
+
+        struct zmk_split_ble_link_stats_changed ev = {.slot = slot, .stats = link->stats};
+
+        k_spin_unlock(&lock, key);
+
+        raise_zmk_split_ble_link_stats_changed(ev);
+    }
+
+    if (connected) {
+        k_work_schedule_for_queue(zmk_workqueue_lowprio_work_q(), &telemetry_work,
+                                  K_MSEC(CONFIG_ZMK_SPLIT_BLE_CENTRAL_TELEMETRY_INTERVAL_MS));
+    }
+}
+
+void zmk_split_bt_telemetry_connected(uint8_t slot, struct bt_conn *conn) {
+    if (slot >= ARRAY_SIZE(links)) {
+        return;
+    }
+
+    struct bt_conn_info info;
+    int err = bt_conn_get_info(conn, &info);
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    struct link_telemetry *link = &links[slot];
+    struct bt_conn *old_conn = link->conn;
+    *link = (struct link_telemetry){
+        .conn = bt_conn_ref(conn),
+        .window_start = k_uptime_get(),
+    };
+    if (!err) {
+        link->stats.interval = info.le.interval;
+        link->stats.latency = info.le.latency;
+        link->stats.timeout = info.le.timeout;
+    }
+
+    k_spin_unlock(&lock, key);
+
+    if (old_conn) {
+        bt_conn_unref(old_conn);
+    }
+
+    k_work_schedule_for_queue(zmk_workqueue_lowprio_work_q(), &telemetry_work,
+                              K_MSEC(CONFIG_ZMK_SPLIT_BLE_CENTRAL_TELEMETRY_INTERVAL_MS));
+}
+
+void zmk_split_bt_telemetry_disconnected(uint8_t slot) {
+    if (slot >= ARRAY_SIZE(links)) {
+        return;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    struct bt_conn *conn = links[slot].conn;
+    links[slot] = (struct link_telemetry){0};
+
+    k_spin_unlock(&lock, key);
+
+    if (conn) {
+        bt_conn_unref(conn);
+    }
+}
+
+void zmk_split_bt_telemetry_conn_params(uint8_t slot, uint16_t interval, uint16_t latency,
+                                        uint16_t timeout) {
+    if (slot >= ARRAY_SIZE(links)) {
+        return;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    links[slot].stats.interval = interval;
+    links[slot].stats.latency = latency;
+    links[slot].stats.timeout = timeout;
+
+    k_spin_unlock(&lock, key);
+}
+
+void zmk_split_bt_telemetry_notification(uint8_t slot) {
+    if (slot >= ARRAY_SIZE(links)) {
+        return;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    links[slot].notifications++;
+    k_spin_unlock(&lock, key);
+}
+
+void zmk_split_bt_telemetry_key_latency(uint8_t slot, uint16_t latency_ms) {
+    if (slot >= ARRAY_SIZE(links)) {
+        return;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    struct link_telemetry *link = &links[slot];
+    link->key_events++;
+    link->key_latency_sum_ms += latency_ms;
+    link->key_latency_max_ms = MAX(link->key_latency_max_ms, latency_ms);
+
+    k_spin_unlock(&lock, key);
+}
+
+#if IS_ENABLED(CONFIG_SHELL)
+
+static int cmd_split_ble_stats(const struct shell *sh, size_t argc, char **argv) {
+    for (uint8_t slot = 0; slot < ARRAY_SIZE(links); slot++) {
+        k_spinlock_key_t key = k_spin_lock(&lock);
+        bool connected = links[slot].conn != NULL;
+        struct zmk_split_ble_link_stats stats = links[slot].stats;
+        k_spin_unlock(&lock, key);
+
+        if (!connected) {
+            shell_print(sh, "Peripheral %d: not connected", slot);
+            continue;
+        }
+
+        shell_print(sh, "Peripheral %d:", slot);
+        shell_print(sh, "  Notifications: %u/s", stats.notify_rate);
+        shell_print(sh, "  RSSI: %d dBm", stats.rssi);
+        shell_print(sh, "  Interval: %u us", stats.interval * 1250);
+        shell_print(sh, "  Latency: %u", stats.latency);
+        shell_print(sh, "  Timeout: %u ms", stats.timeout * 10);
+        shell_print(sh, "  Key latency: %u ms avg, %u ms max", stats.key_latency_avg_ms,
+                    stats.key_latency_max_ms);
+    }
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_split_ble,
+                               SHELL_CMD(stats, NULL, "Show peripheral link statistics",
+                                         cmd_split_ble_stats),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((zmk), split_ble, &sub_split_ble, "BLE split peripheral links", NULL, 0, 0);
+
+#endif // IS_ENABLED(CONFIG_SHELL)
@@ -30,10 +30,14 @@
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
+#include <zmk/activity.h>
 #include <zmk/event_manager.h>
+#include <zmk/events/activity_state_changed.h>
 #include <zmk/events/split_peripheral_status_changed.h>
 #include <zmk/ble.h>
+#include <zmk/settings.h>
 #include <zmk/split/bluetooth/uuid.h>
+#include <zmk/boot_timing.h>
 
 static const struct bt_data zmk_ble_ad[] = {
     BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
@@ -45,6 +49,14 @@ static bool is_connected = false;
 
 static bool is_bonded = false;
 
+// Connection interval in 1.25 ms units, or 0 while disconnected.
+static uint16_t conn_interval = 0;
+
+// The default LE ATT MTU until the central exchanges a larger one.
+#define DEFAULT_ATT_MTU 23
+
+static uint16_t conn_mtu = DEFAULT_ATT_MTU;
+
 static void each_bond(const struct bt_bond_info *info, void *user_data) {
     bt_addr_le_t *addr = (bt_addr_le_t *)user_data;
 
@@ -83,6 +95,15 @@ K_WORK_DEFINE(advertising_work, advertising_cb);
 static void connected(struct bt_conn *conn, uint8_t err) {
     is_connected = (err == 0);
 
+    struct bt_conn_info info;
+    if (is_connected && bt_conn_get_info(conn, &info) == 0) {
+        conn_interval = info.le.interval;
+    }
+
+    if (is_connected) {
+        zmk_boot_timing_mark("split connected");
+    }
+
     raise_zmk_split_peripheral_status_changed(
         (struct zmk_split_peripheral_status_changed){.connected = is_connected});
 
@@ -100,6 +121,8 @@ static void disconnected(struct bt_conn *conn, uint8_t reason) {
     LOG_DBG("Disconnected from %s (reason 0x%02x)", addr, reason);
 
     is_connected = false;
+    conn_interval = 0;
+    conn_mtu = DEFAULT_ATT_MTU;
 
     raise_zmk_split_peripheral_status_changed(
         (struct zmk_split_peripheral_status_changed){.connected = is_connected});
@@ -127,6 +150,8 @@ static void le_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t l
     bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
 
     LOG_DBG("%s: interval %d latency %d timeout %d", addr, interval, latency, timeout);
+
+    conn_interval = interval;
 }
 
 static struct bt_conn_cb conn_callbacks = {
@@ -136,16 +161,60 @@ static struct bt_conn_cb conn_callbacks = {
     .le_param_updated = le_param_updated,
 };
 
+static void att_mtu_updated(struct bt_conn *conn, uint16_t tx, uint16_t rx) {
+    LOG_DBG("ATT MTU updated: tx %d rx %d", tx, rx);
+
+    conn_mtu = tx;
+}
+
+static struct bt_gatt_cb gatt_callbacks = {
+    .att_mtu_updated = att_mtu_updated,
+};
+
 static void auth_pairing_complete(struct bt_conn *conn, bool bonded) { is_bonded = bonded; }
 
 static struct bt_conn_auth_info_cb zmk_peripheral_ble_auth_info_cb = {
     .pairing_complete = auth_pairing_complete,
 };
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_FAST_RECONNECT)
+
+// High duty cycle directed advertising times out after 1.28 s, after which the peripheral falls
+// back to low duty cycle advertising. Once the keyboard is in use again, go back to high duty
+// cycle advertising so the central finds the peripheral within a few milliseconds.
+static int split_peripheral_activity_listener(const zmk_event_t *eh) {
+    if (zmk_activity_get_state() != ZMK_ACTIVITY_ACTIVE || is_connected || !is_bonded ||
+        !low_duty_advertising) {
+        return ZMK_EV_EVENT_BUBBLE;
+    }
+
+    LOG_DBG("Restarting high duty cycle advertising");
+
+    int err = bt_le_adv_stop();
+    if (err < 0) {
+        LOG_ERR("Failed to stop advertising (%d)", err);
+        return ZMK_EV_EVENT_BUBBLE;
+    }
+
+    low_duty_advertising = false;
+    k_work_submit(&advertising_work);
+
+    return ZMK_EV_EVENT_BUBBLE;
+}
+
+ZMK_LISTENER(split_peripheral_activity, split_peripheral_activity_listener);
+ZMK_SUBSCRIPTION(split_peripheral_activity, zmk_activity_state_changed);
+
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_FAST_RECONNECT)
+
 bool zmk_split_bt_peripheral_is_connected(void) { return is_connected; }
 
 bool zmk_split_bt_peripheral_is_bonded(void) { return is_bonded; }
 
+uint32_t zmk_split_bt_peripheral_conn_interval_us(void) { return conn_interval * 1250; }
+
+uint16_t zmk_split_bt_peripheral_mtu(void) { return conn_mtu; }
+
 static int zmk_peripheral_ble_init(void) {
     int err = bt_enable(NULL);
 
@@ -157,8 +226,8 @@ static int zmk_peripheral_ble_init(void) {
 #if IS_ENABLED(CONFIG_SETTINGS)
     settings_subsys_init();
 
-    settings_load_subtree("ble");
-    settings_load_subtree("bt");
+    zmk_settings_load_subtree("ble");
+    zmk_settings_load_subtree_uncached("bt");
 #endif
 
 #if IS_ENABLED(CONFIG_ZMK_BLE_CLEAR_BONDS_ON_START)
@@ -167,6 +236,7 @@ static int zmk_peripheral_ble_init(void) {
     bt_unpair(BT_ID_DEFAULT, NULL);
 #else
     bt_conn_cb_register(&conn_callbacks);
+    bt_gatt_cb_register(&gatt_callbacks);
     bt_conn_auth_info_cb_register(&zmk_peripheral_ble_auth_info_cb);
 
     low_duty_advertising = false;
@@ -176,4 +246,4 @@ static int zmk_peripheral_ble_init(void) {
     return 0;
 }
 
-SYS_INIT(zmk_peripheral_ble_init, APPLICATION, CONFIG_ZMK_SPLIT_INIT_PRIORITY);
+ZMK_SYS_INIT(zmk_peripheral_ble_init, APPLICATION, CONFIG_ZMK_SPLIT_INIT_PRIORITY);
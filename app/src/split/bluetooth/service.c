@@ -19,6 +19,9 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 #include <drivers/behavior.h>
 #include <zmk/behavior.h>
 #include <zmk/matrix.h>
+#include <zmk/pm.h>
+#include <zmk/power_stats.h>
+#include <zmk/split/bluetooth/peripheral.h>
 #include <zmk/split/bluetooth/uuid.h>
 #include <zmk/split/service.h>
 
@@ -26,6 +29,10 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 #include <zmk/events/hid_indicators_changed.h>
 #endif // IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+#include <zmk/rgb_underglow.h>
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+
 #include <zmk/events/sensor_event.h>
 #include <zmk/sensors.h>
 
@@ -54,6 +61,24 @@ static ssize_t split_svc_pos_state(struct bt_conn *conn, const struct bt_gatt_at
                              sizeof(position_state));
 }
 
+static void split_svc_invoke_behavior(struct zmk_behavior_binding *binding,
+                                      const struct zmk_split_run_behavior_data *data) {
+    LOG_DBG("%s with params %d %d: pressed? %d", binding->behavior_dev, binding->param1,
+            binding->param2, data->state);
+    struct zmk_behavior_binding_event event = {.position = data->position,
+                                               .timestamp = k_uptime_get()};
+    int err;
+    if (data->state > 0) {
+        err = behavior_keymap_binding_pressed(binding, event);
+    } else {
+        err = behavior_keymap_binding_released(binding, event);
+    }
+
+    if (err) {
+        LOG_ERR("Failed to invoke behavior %s: %d", binding->behavior_dev, err);
+    }
+}
+
 static ssize_t split_svc_run_behavior(struct bt_conn *conn, const struct bt_gatt_attr *attrs,
                                       const void *buf, uint16_t len, uint16_t offset,
                                       uint8_t flags) {
@@ -80,20 +105,42 @@ static ssize_t split_svc_run_behavior(struct bt_conn *conn, const struct bt_gatt
             .param2 = payload->data.param2,
             .behavior_dev = payload->behavior_dev,
         };
-        LOG_DBG("%s with params %d %d: pressed? %d", binding.behavior_dev, binding.param1,
-                binding.param2, payload->data.state);
-        struct zmk_behavior_binding_event event = {.position = payload->data.position,
-                                                   .timestamp = k_uptime_get()};
-        int err;
-        if (payload->data.state > 0) {
-            err = behavior_keymap_binding_pressed(&binding, event);
-        } else {
-            err = behavior_keymap_binding_released(&binding, event);
-        }
+        split_svc_invoke_behavior(&binding, &payload->data);
+    }
 
-        if (err) {
-            LOG_ERR("Failed to invoke behavior %s: %d", binding.behavior_dev, err);
+    return len;
+}
+
+static ssize_t split_svc_run_behaviors(struct bt_conn *conn, const struct bt_gatt_attr *attrs,
+                                       const void *buf, uint16_t len, uint16_t offset,
+                                       uint8_t flags) {
+    LOG_DBG("offset %d len %d", offset, len);
+
+    if (offset != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+
+    if (len % sizeof(struct zmk_split_run_behavior_compact) != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    for (const uint8_t *pos = buf; pos < (const uint8_t *)buf + len;
+         pos += sizeof(struct zmk_split_run_behavior_compact)) {
+        struct zmk_split_run_behavior_compact entry;
+        memcpy(&entry, pos, sizeof(entry));
+
+        const struct device *dev = zmk_behavior_get_binding_by_id(entry.behavior_id);
+        if (dev == NULL) {
+            LOG_ERR("No behavior with ID 0x%04x", entry.behavior_id);
+            continue;
         }
+
+        struct zmk_behavior_binding binding = {
+            .param1 = entry.data.param1,
+            .param2 = entry.data.param2,
+            .behavior_dev = dev->name,
+        };
+        split_svc_invoke_behavior(&binding, &entry.data);
     }
 
     return len;
@@ -108,6 +155,20 @@ static void split_svc_pos_state_ccc(const struct bt_gatt_attr *attr, uint16_t va
     LOG_DBG("value %d", value);
 }
 
+// Centrals that subscribe to position events are sent those instead of the full position state.
+static bool position_events_enabled;
+
+static void split_svc_pos_events_ccc(const struct bt_gatt_attr *attr, uint16_t value) {
+    LOG_DBG("value %d", value);
+    position_events_enabled = value == BT_GATT_CCC_NOTIFY;
+}
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+static void split_svc_input_frames_ccc(const struct bt_gatt_attr *attr, uint16_t value) {
+    LOG_DBG("value %d", value);
+}
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+
 #if IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
 
 static zmk_hid_indicators_t hid_indicators = 0;
@@ -136,6 +197,35 @@ static ssize_t split_svc_update_indicators(struct bt_conn *conn, const struct bt
 
 #endif // IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
 
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+
+static struct zmk_rgb_underglow_sync_state underglow_sync;
+
+static void split_svc_update_underglow_callback(struct k_work *work) {
+    int err = zmk_rgb_underglow_apply_sync_state(&underglow_sync);
+    if (err < 0) {
+        LOG_WRN("Failed to apply the central's underglow state (err %d)", err);
+    }
+}
+
+static K_WORK_DEFINE(split_svc_update_underglow_work, split_svc_update_underglow_callback);
+
+static ssize_t split_svc_update_underglow(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                          const void *buf, uint16_t len, uint16_t offset,
+                                          uint8_t flags) {
+    if (offset != 0 || len != sizeof(underglow_sync)) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    memcpy(&underglow_sync, buf, len);
+
+    k_work_submit(&split_svc_update_underglow_work);
+
+    return len;
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+
 BT_GATT_SERVICE_DEFINE(
     split_svc, BT_GATT_PRIMARY_SERVICE(BT_UUID_DECLARE_128(ZMK_SPLIT_BT_SERVICE_UUID)),
     BT_GATT_CHARACTERISTIC(BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_POSITION_STATE_UUID),
@@ -158,14 +248,155 @@ BT_GATT_SERVICE_DEFINE(
                            BT_GATT_CHRC_WRITE_WITHOUT_RESP, BT_GATT_PERM_WRITE_ENCRYPT, NULL,
                            split_svc_update_indicators, NULL),
 #endif // IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+    BT_GATT_CHARACTERISTIC(BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_POSITION_EVENTS_UUID),
+                           BT_GATT_CHRC_NOTIFY, BT_GATT_PERM_NONE, NULL, NULL, NULL),
+    BT_GATT_CCC(split_svc_pos_events_ccc, BT_GATT_PERM_READ_ENCRYPT | BT_GATT_PERM_WRITE_ENCRYPT),
+    BT_GATT_CHARACTERISTIC(BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_RUN_BEHAVIORS_UUID),
+                           BT_GATT_CHRC_WRITE_WITHOUT_RESP, BT_GATT_PERM_WRITE_ENCRYPT, NULL,
+                           split_svc_run_behaviors, NULL),
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+    BT_GATT_CHARACTERISTIC(BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_INPUT_FRAMES_UUID),
+                           BT_GATT_CHRC_NOTIFY, BT_GATT_PERM_NONE, NULL, NULL, NULL),
+    BT_GATT_CCC(split_svc_input_frames_ccc, BT_GATT_PERM_READ_ENCRYPT | BT_GATT_PERM_WRITE_ENCRYPT),
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
+    BT_GATT_CHARACTERISTIC(BT_UUID_DECLARE_128(ZMK_SPLIT_BT_UPDATE_UNDERGLOW_UUID),
+                           BT_GATT_CHRC_WRITE_WITHOUT_RESP, BT_GATT_PERM_WRITE_ENCRYPT, NULL,
+                           split_svc_update_underglow, NULL),
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_UNDERGLOW_SYNC)
 );
 
-void send_position_state_impl(uint8_t *state, int len) {
-    memcpy(position_state, state, MIN(len, sizeof(position_state)));
-    int err = bt_gatt_notify(NULL, &split_svc.attrs[1], state, len);
+// The position state notified to the central as events so far. Only accessed from the split
+// service work queue.
+static uint8_t sent_position_state[ZMK_SPLIT_POS_STATE_LEN];
+static struct zmk_split_position_events pending_position_events;
+static int64_t pending_position_timestamps[ZMK_SPLIT_POS_EVENTS_MAX];
+static uint8_t position_events_seq;
+
+static void flush_position_events(void) {
+    uint8_t count = pending_position_events.count;
+    if (count == 0) {
+        return;
+    }
+
+    int64_t now = k_uptime_get();
+    for (int i = 0; i < count; i++) {
+        pending_position_events.events[i].age =
+            MIN(now - pending_position_timestamps[i], UINT16_MAX);
+    }
+
+    // The sequence number advances even if the notification fails, so the central notices the
+    // lost events and resyncs.
+    pending_position_events.seq = position_events_seq;
+    position_events_seq += count;
+
+    static const struct bt_gatt_attr *attr;
+    if (attr == NULL) {
+        attr = bt_gatt_find_by_uuid(split_svc.attrs, split_svc.attr_count,
+                                    BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_POSITION_EVENTS_UUID));
+    }
+
+    int err = bt_gatt_notify(NULL, attr, &pending_position_events,
+                             offsetof(struct zmk_split_position_events, events) +
+                                 count * sizeof(struct zmk_split_position_event));
     if (err) {
         LOG_DBG("Error notifying %d", err);
+    } else {
+        zmk_power_stats_record(ZMK_POWER_STATS_SPLIT_MESSAGE);
+    }
+
+    pending_position_events.count = 0;
+}
+
+static void flush_position_events_callback(struct k_work *work) { flush_position_events(); }
+
+static K_WORK_DELAYABLE_DEFINE(flush_position_events_work, flush_position_events_callback);
+
+// Closes the batching window early, so the held events don't wait out the rest of it.
+static bool position_events_flush(void) {
+    if (k_work_delayable_is_pending(&flush_position_events_work)) {
+        k_work_reschedule_for_queue(zmk_split_service_work_q(), &flush_position_events_work,
+                                    K_NO_WAIT);
+        return false;
+    }
+
+    return true;
+}
+
+ZMK_PM_FLUSH_DEFINE(split_position_events, position_events_flush);
+
+// Number of events that fit into one notification at the current ATT MTU.
+static uint8_t position_events_capacity(void) {
+    const size_t header_len = 3 + offsetof(struct zmk_split_position_events, events);
+    uint16_t mtu = zmk_split_bt_peripheral_mtu();
+
+    if (mtu <= header_len) {
+        return 1;
     }
+
+    return CLAMP((mtu - header_len) / sizeof(struct zmk_split_position_event), 1,
+                 ZMK_SPLIT_POS_EVENTS_MAX);
+}
+
+void send_position_state_impl(uint8_t *state, int len, int64_t timestamp) {
+    memcpy(position_state, state, MIN(len, sizeof(position_state)));
+
+    if (!position_events_enabled) {
+        memcpy(sent_position_state, position_state, sizeof(position_state));
+        int err = bt_gatt_notify(NULL, &split_svc.attrs[1], state, len);
+        if (err) {
+            LOG_DBG("Error notifying %d", err);
+        } else {
+            zmk_power_stats_record(ZMK_POWER_STATS_SPLIT_MESSAGE);
+        }
+        return;
+    }
+
+    uint8_t capacity = position_events_capacity();
+    bool window_open = k_work_delayable_is_pending(&flush_position_events_work);
+
+    for (int i = 0; i < sizeof(position_state); i++) {
+        uint8_t changed = position_state[i] ^ sent_position_state[i];
+        for (int j = 0; j < 8; j++) {
+            if (!(changed & BIT(j))) {
+                continue;
+            }
+
+            if (pending_position_events.count >= capacity) {
+                flush_position_events();
+            }
+
+            uint8_t n = pending_position_events.count++;
+            pending_position_events.events[n] = (struct zmk_split_position_event){
+                .position = (i * 8) + j,
+                .state = (position_state[i] & BIT(j)) ? 1 : 0,
+            };
+            pending_position_timestamps[n] = timestamp;
+        }
+    }
+    memcpy(sent_position_state, position_state, sizeof(position_state));
+
+    if (pending_position_events.count >= capacity) {
+        flush_position_events();
+        return;
+    }
+
+    if (pending_position_events.count == 0) {
+        return;
+    }
+
+    // A change after a quiet period is sent right away, and opens a batching window. Changes that
+    // follow within it can't go out before the next connection event anyway, so they are held
+    // until the window closes, for at most one connection interval, and share one notification.
+    // The flush runs on the same work queue, after the queue of position states has been drained.
+    if (!window_open) {
+        flush_position_events();
+    }
+
+    uint32_t window_us = MIN(zmk_split_bt_peripheral_conn_interval_us(),
+                             CONFIG_ZMK_SPLIT_BLE_PERIPHERAL_EVENT_BATCH_MAX_US);
+    k_work_schedule_for_queue(zmk_split_service_work_q(), &flush_position_events_work,
+                              K_USEC(window_us));
 }
 
 #if ZMK_KEYMAP_HAS_SENSORS
@@ -174,6 +405,29 @@ void send_sensor_state_impl(struct sensor_event *event, int len) {
     int err = bt_gatt_notify(NULL, &split_svc.attrs[8], event, len);
     if (err) {
         LOG_DBG("Error notifying %d", err);
+    } else {
+        zmk_power_stats_record(ZMK_POWER_STATS_SPLIT_MESSAGE);
     }
 }
 #endif /* ZMK_KEYMAP_HAS_SENSORS */
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+void send_input_frame_impl(const struct zmk_split_input_frame *frame) {
+    static const struct bt_gatt_attr *attr;
+    if (attr == NULL) {
+        attr = bt_gatt_find_by_uuid(split_svc.attrs, split_svc.attr_count,
+                                    BT_UUID_DECLARE_128(ZMK_SPLIT_BT_CHAR_INPUT_FRAMES_UUID));
+    }
+
+    int err = bt_gatt_notify(NULL, attr, frame, sizeof(*frame));
+    if (err) {
+        LOG_DBG("Error notifying %d", err);
+    } else {
+        zmk_power_stats_record(ZMK_POWER_STATS_SPLIT_MESSAGE);
+    }
+}
+
+// A notification can't reach the central before its next connection event, so motion is summed up
+// for one connection interval.
+uint32_t input_frame_interval_us_impl(void) { return zmk_split_bt_peripheral_conn_interval_us(); }
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
@@ -4,55 +4,192 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <string.h>
+
 #include <zephyr/types.h>
 #include <zephyr/init.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/atomic.h>
 
+#include <drivers/behavior.h>
 #include <zmk/stdlib.h>
 #include <zmk/behavior.h>
 #include <zmk/event_manager.h>
+#include <zmk/input_frame.h>
+#include <zmk/pm.h>
+#include <zmk/position_state.h>
 #include <zmk/events/position_state_changed.h>
 #include <zmk/events/sensor_event.h>
 #include <zmk/split/central.h>
 #include <zmk/split/service.h>
+#include <zmk/resource_stats.h>
+#include <zmk/workqueue.h>
+#include <zmk/boot_timing.h>
 
 #include <zephyr/logging/log.h>
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
+static atomic_t dropped_position_events;
+static atomic_t dropped_global_presses;
+static atomic_t run_queue_stalls;
+
 K_MSGQ_DEFINE(peripheral_event_msgq, sizeof(struct zmk_position_state_changed),
               CONFIG_ZMK_SPLIT_CENTRAL_POSITION_QUEUE_SIZE, 4);
 
+ZMK_QUEUE_STATS_DEFINE(peripheral_event_stats, "Peripheral position events",
+                       CONFIG_ZMK_SPLIT_CENTRAL_POSITION_QUEUE_SIZE);
+
+static void raise_position_state(const struct zmk_position_state_changed *ev) {
+    LOG_DBG("Trigger key position state change for %d", ev->position);
+    zmk_position_state_update(ev->position, ev->state);
+    raise_zmk_position_state_changed(*ev);
+}
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_CENTRAL_REORDER)
+
+// Position events from every source, sorted by timestamp, waiting out any earlier scanned event
+// still on its way from a peripheral. Only used from the input work queue.
+static struct zmk_position_state_changed reorder_events[CONFIG_ZMK_SPLIT_CENTRAL_REORDER_SIZE];
+static size_t reorder_len;
+
+// Recent peak of how long peripheral events took to arrive after they were scanned. It decays by
+// an eighth with every peripheral event, so one slow event doesn't hold back keys for long.
+static uint32_t reorder_peak_ms;
+
+static void reorder_flush_work_callback(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(reorder_flush_work, reorder_flush_work_callback);
+
+static inline uint32_t reorder_window_ms(void) {
+    return MIN(reorder_peak_ms, CONFIG_ZMK_SPLIT_CENTRAL_REORDER_MAX_MS);
+}
+
+static inline bool reorder_front_is_due(int64_t now) {
+    return reorder_len > 0 && reorder_events[0].timestamp + reorder_window_ms() <= now;
+}
+
+static void reorder_raise_front(void) {
+    // Taken out of the buffer before it is raised, in case a listener raises another event.
+    struct zmk_position_state_changed ev = reorder_events[0];
+
+    reorder_len--;
+    memmove(&reorder_events[0], &reorder_events[1], reorder_len * sizeof(reorder_events[0]));
+
+    raise_position_state(&ev);
+}
+
+static void reorder_flush(void) {
+    int64_t now = k_uptime_get();
+
+    if (reorder_front_is_due(now)) {
+        zmk_input_frame_begin();
+
+        while (reorder_front_is_due(now)) {
+            reorder_raise_front();
+        }
+
+        zmk_input_frame_end();
+    }
+
+    if (reorder_len > 0) {
+        k_work_reschedule_for_queue(
+            zmk_workqueue_input_work_q(), &reorder_flush_work,
+            K_TIMEOUT_ABS_MS(reorder_events[0].timestamp + reorder_window_ms()));
+    } else {
+        k_work_cancel_delayable(&reorder_flush_work);
+    }
+}
+
+static void reorder_flush_work_callback(struct k_work *work) { reorder_flush(); }
+
+void zmk_split_central_raise_position_state(const struct zmk_position_state_changed *ev) {
+    if (ev->source != ZMK_POSITION_STATE_CHANGE_SOURCE_LOCAL) {
+        uint32_t delay_ms = CLAMP(k_uptime_get() - ev->timestamp, 0, UINT16_MAX);
+
+        reorder_peak_ms = MAX(delay_ms, reorder_peak_ms - reorder_peak_ms / 8);
+    }
+
+    if (reorder_len == ARRAY_SIZE(reorder_events)) {
+        // Make room by raising the oldest event early, which can only put that one out of order.
+        zmk_input_frame_begin();
+        reorder_raise_front();
+        zmk_input_frame_end();
+    }
+
+    // Events with the same timestamp stay in the order they arrived in.
+    size_t i = reorder_len++;
+    for (; i > 0 && reorder_events[i - 1].timestamp > ev->timestamp; i--) {
+        reorder_events[i] = reorder_events[i - 1];
+    }
+    reorder_events[i] = *ev;
+
+    reorder_flush();
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_CENTRAL_REORDER)
+
 void peripheral_event_work_callback(struct k_work *work) {
     struct zmk_position_state_changed ev;
+
+    zmk_input_frame_begin();
+
     while (k_msgq_get(&peripheral_event_msgq, &ev, K_NO_WAIT) == 0) {
-        LOG_DBG("Trigger key position state change for %d", ev.position);
-        raise_zmk_position_state_changed(ev);
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_CENTRAL_REORDER)
+        zmk_split_central_raise_position_state(&ev);
+#else
+        raise_position_state(&ev);
+#endif
     }
+
+    zmk_input_frame_end();
 }
 
 K_WORK_DEFINE(peripheral_event_work, peripheral_event_work_callback);
 
 void zmk_position_state_change_handle(struct zmk_position_state_changed *ev) {
-    k_msgq_put(&peripheral_event_msgq, ev, K_NO_WAIT);
-    k_work_submit(&peripheral_event_work);
+    // Called from the transport's receive context, which must not block.
+    if (k_msgq_put(&peripheral_event_msgq, ev, K_NO_WAIT) < 0) {
+        atomic_inc(&dropped_position_events);
+        zmk_queue_stats_overflowed(&peripheral_event_stats);
+        LOG_ERR("Peripheral position event queue full, dropped %s of %d",
+                ev->state ? "press" : "release", ev->position);
+    } else {
+        zmk_queue_stats_queued(&peripheral_event_stats,
+                               k_msgq_num_used_get(&peripheral_event_msgq));
+    }
+    k_work_submit_to_queue(zmk_workqueue_input_work_q(), &peripheral_event_work);
 }
 
 #if ZMK_KEYMAP_HAS_SENSORS
 K_MSGQ_DEFINE(peripheral_sensor_event_msgq, sizeof(struct zmk_sensor_event),
               CONFIG_ZMK_SPLIT_CENTRAL_POSITION_QUEUE_SIZE, 4);
 
+ZMK_QUEUE_STATS_DEFINE(peripheral_sensor_event_stats, "Peripheral sensor events",
+                       CONFIG_ZMK_SPLIT_CENTRAL_POSITION_QUEUE_SIZE);
+
 void peripheral_sensor_event_work_callback(struct k_work *work) {
     struct zmk_sensor_event ev;
+
+    zmk_input_frame_begin();
+
     while (k_msgq_get(&peripheral_sensor_event_msgq, &ev, K_NO_WAIT) == 0) {
         LOG_DBG("Trigger sensor change for %d", ev.sensor_index);
         raise_zmk_sensor_event(ev);
     }
+
+    zmk_input_frame_end();
 }
 
 K_WORK_DEFINE(peripheral_sensor_event_work, peripheral_sensor_event_work_callback);
 
 void zmk_sensor_event_handle(struct zmk_sensor_event *ev) {
-    k_msgq_put(&peripheral_sensor_event_msgq, ev, K_NO_WAIT);
-    k_work_submit(&peripheral_sensor_event_work);
+    if (k_msgq_put(&peripheral_sensor_event_msgq, ev, K_NO_WAIT) < 0) {
+        zmk_queue_stats_overflowed(&peripheral_sensor_event_stats);
+    } else {
+        zmk_queue_stats_queued(&peripheral_sensor_event_stats,
+                               k_msgq_num_used_get(&peripheral_sensor_event_msgq));
+    }
+    k_work_submit_to_queue(zmk_workqueue_input_work_q(), &peripheral_sensor_event_work);
 }
 #endif /* ZMK_KEYMAP_HAS_SENSORS */
 
@@ -61,10 +198,22 @@ K_THREAD_STACK_DEFINE(split_central_split_run_q_stack,
 
 struct k_work_q split_central_split_run_q;
 
+ZMK_STACK_STATS_DEFINE(split_central_split_run_q, split_central_split_run_q_stack,
+                       "Split behavior run");
+ZMK_WORKQUEUE_REGISTER(split_central_split_run_q, "Split behavior run",
+                       ZMK_WORKQUEUE_LATENCY_TRANSPORT);
+
 K_MSGQ_DEFINE(zmk_split_central_split_run_msgq,
               sizeof(struct zmk_split_run_behavior_payload_wrapper),
               CONFIG_ZMK_SPLIT_CENTRAL_SPLIT_RUN_QUEUE_SIZE, 4);
 
+ZMK_QUEUE_STATS_DEFINE(split_run_stats, "Split behavior runs",
+                       CONFIG_ZMK_SPLIT_CENTRAL_SPLIT_RUN_QUEUE_SIZE);
+
+BUILD_ASSERT(CONFIG_ZMK_SPLIT_CENTRAL_SPLIT_RUN_QUEUE_RESERVED <
+                 CONFIG_ZMK_SPLIT_CENTRAL_SPLIT_RUN_QUEUE_SIZE,
+             "The reserved behavior run queue slots must leave room for best effort events");
+
 void split_central_split_run_callback(struct k_work *work) {
     struct zmk_split_run_behavior_payload_wrapper payload_wrapper;
 
@@ -73,29 +222,51 @@ void split_central_split_run_callback(struct k_work *work) {
     while (k_msgq_get(&zmk_split_central_split_run_msgq, &payload_wrapper, K_NO_WAIT) == 0) {
         send_split_run_impl(&payload_wrapper);
     }
+
+    send_split_run_flush_impl();
 }
 
 K_WORK_DEFINE(split_central_split_run_work, split_central_split_run_callback);
 
+static bool split_run_flush(void) {
+    return k_msgq_num_used_get(&zmk_split_central_split_run_msgq) == 0 &&
+           !k_work_is_pending(&split_central_split_run_work);
+}
+
+ZMK_PM_FLUSH_DEFINE(split_run, split_run_flush);
+
 static int
-split_invoke_behavior_payload(struct zmk_split_run_behavior_payload_wrapper payload_wrapper) {
+split_invoke_behavior_payload(struct zmk_split_run_behavior_payload_wrapper payload_wrapper,
+                              bool best_effort) {
     LOG_DBG("");
 
-    int err = k_msgq_put(&zmk_split_central_split_run_msgq, &payload_wrapper, K_MSEC(100));
+    // Best effort invocations may not take the slots reserved for the rest, so a backlog of
+    // lighting changes can never hold up a release.
+    if (best_effort && k_msgq_num_free_get(&zmk_split_central_split_run_msgq) <=
+                           CONFIG_ZMK_SPLIT_CENTRAL_SPLIT_RUN_QUEUE_RESERVED) {
+        atomic_inc(&dropped_global_presses);
+        zmk_queue_stats_overflowed(&split_run_stats);
+        LOG_WRN("Behavior run queue congested, dropping %s for peripheral %d",
+                payload_wrapper.payload.behavior_dev, payload_wrapper.source);
+        return -EAGAIN;
+    }
+
+    int err;
+    while ((err = k_msgq_put(&zmk_split_central_split_run_msgq, &payload_wrapper,
+                             K_MSEC(100))) == -EAGAIN) {
+        atomic_inc(&run_queue_stalls);
+        zmk_queue_stats_overflowed(&split_run_stats);
+        LOG_WRN("Behavior run queue full, waiting for it to drain");
+    }
+
     if (err) {
-        switch (err) {
-        case -EAGAIN: {
-            LOG_WRN("Consumer message queue full, popping first message and queueing again");
-            struct zmk_split_run_behavior_payload_wrapper discarded_report;
-            k_msgq_get(&zmk_split_central_split_run_msgq, &discarded_report, K_NO_WAIT);
-            return split_invoke_behavior_payload(payload_wrapper);
-        }
-        default:
-            LOG_WRN("Failed to queue behavior to send (%d)", err);
-            return err;
-        }
+        LOG_WRN("Failed to queue behavior to send (%d)", err);
+        return err;
     }
 
+    zmk_queue_stats_queued(&split_run_stats,
+                           k_msgq_num_used_get(&zmk_split_central_split_run_msgq));
+
     k_work_submit_to_queue(&split_central_split_run_q, &split_central_split_run_work);
 
     return 0;
@@ -117,9 +288,52 @@ int zmk_split_invoke_behavior(uint8_t source, struct zmk_behavior_binding *bindi
     }
 
     struct zmk_split_run_behavior_payload_wrapper wrapper = {.source = source, .payload = payload};
-    return split_invoke_behavior_payload(wrapper);
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE)
+    wrapper.behavior_id = zmk_behavior_get_id(binding->behavior_dev);
+#endif
+
+    // Presses of global behaviors (lighting, external power and the like) are best effort, while
+    // releases and anything tied to a key position must always reach the peripheral.
+    bool best_effort = false;
+    if (state) {
+        const struct device *behavior = zmk_behavior_get_binding(binding->behavior_dev);
+        enum behavior_locality locality = BEHAVIOR_LOCALITY_CENTRAL;
+        best_effort = behavior && behavior_get_locality(behavior, &locality) == 0 &&
+                      locality == BEHAVIOR_LOCALITY_GLOBAL;
+    }
+
+    return split_invoke_behavior_payload(wrapper, best_effort);
+}
+
+#if IS_ENABLED(CONFIG_SHELL)
+
+static int cmd_split_stats(const struct shell *sh, size_t argc, char **argv) {
+    shell_print(sh, "Dropped peripheral position events: %ld",
+                (long)atomic_get(&dropped_position_events));
+    shell_print(sh, "Dropped global behavior presses: %ld",
+                (long)atomic_get(&dropped_global_presses));
+    shell_print(sh, "Behavior run queue stalls: %ld", (long)atomic_get(&run_queue_stalls));
+    return 0;
 }
 
+static int cmd_split_reset(const struct shell *sh, size_t argc, char **argv) {
+    atomic_clear(&dropped_position_events);
+    atomic_clear(&dropped_global_presses);
+    atomic_clear(&run_queue_stalls);
+    shell_print(sh, "Split queue statistics reset");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_split,
+                               SHELL_CMD(stats, NULL, "Show message queue statistics",
+                                         cmd_split_stats),
+                               SHELL_CMD(reset, NULL, "Reset statistics", cmd_split_reset),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((zmk), split, &sub_split, "Split message queues", NULL, 0, 0);
+
+#endif // IS_ENABLED(CONFIG_SHELL)
+
 static int zmk_split_central_init(void) {
     k_work_queue_start(&split_central_split_run_q, split_central_split_run_q_stack,
                        K_THREAD_STACK_SIZEOF(split_central_split_run_q_stack),
@@ -127,4 +341,4 @@ static int zmk_split_central_init(void) {
     return 0;
 }
 
-SYS_INIT(zmk_split_central_init, APPLICATION, CONFIG_ZMK_SPLIT_INIT_PRIORITY);
+ZMK_SYS_INIT(zmk_split_central_init, APPLICATION, CONFIG_ZMK_SPLIT_INIT_PRIORITY);
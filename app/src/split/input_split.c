@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define DT_DRV_COMPAT zmk_input_split
+
+#include <zephyr/device.h>
+#include <zephyr/kernel.h>
+#include <zephyr/input/input.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/dt-bindings/input/input-event-codes.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/split/service.h>
+
+#define INPUT_SPLIT_REG(n) [n] = DT_INST_REG_ADDR(n),
+
+static const uint8_t regs[] = {DT_INST_FOREACH_STATUS_OKAY(INPUT_SPLIT_REG)};
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
+
+#include <zmk/split/central.h>
+
+#define INPUT_SPLIT_DEVICE(n) [n] = DEVICE_DT_INST_GET(n),
+
+static const struct device *const devices[] = {DT_INST_FOREACH_STATUS_OKAY(INPUT_SPLIT_DEVICE)};
+
+struct input_split_axis {
+    uint16_t code;
+    int16_t value;
+};
+
+static int report_frame(const struct device *dev, const struct zmk_split_input_frame *frame) {
+    const struct input_split_axis axes[] = {
+        {INPUT_REL_X, frame->x},
+        {INPUT_REL_Y, frame->y},
+        {INPUT_REL_HWHEEL_HI_RES, frame->scroll_x},
+        {INPUT_REL_WHEEL_HI_RES, frame->scroll_y},
+    };
+
+    // Only the axes that moved are reported, the last of them with the sync.
+    int last = -1;
+    for (int i = 0; i < ARRAY_SIZE(axes); i++) {
+        if (axes[i].value != 0) {
+            last = i;
+        }
+    }
+
+    for (int i = 0; i <= last; i++) {
+        if (axes[i].value == 0) {
+            continue;
+        }
+
+        int err = input_report_rel(dev, axes[i].code, axes[i].value, i == last, K_NO_WAIT);
+        if (err < 0) {
+            LOG_WRN("Failed to report split input event (%d)", err);
+            return err;
+        }
+    }
+
+    return 0;
+}
+
+int zmk_split_input_frame_handle(const struct zmk_split_input_frame *frame) {
+    for (int i = 0; i < ARRAY_SIZE(regs); i++) {
+        if (regs[i] == frame->reg) {
+            return report_frame(devices[i], frame);
+        }
+    }
+
+    LOG_WRN("No split input device with reg %d", frame->reg);
+    return -ENODEV;
+}
+
+static int input_split_init(const struct device *dev) { return 0; }
+
+#define INPUT_SPLIT_INST(n)                                                                        \
+    DEVICE_DT_INST_DEFINE(n, input_split_init, NULL, NULL, NULL, POST_KERNEL,                      \
+                          CONFIG_KERNEL_INIT_PRIORITY_DEFAULT, NULL);
+
+DT_INST_FOREACH_STATUS_OKAY(INPUT_SPLIT_INST)
+
+#else
+
+// Motion not sent to the central yet, per device. Kept wider than a frame, so motion beyond what a
+// frame holds goes out with the next one.
+struct input_split_pending {
+    int32_t x;
+    int32_t y;
+    int32_t scroll_x;
+    int32_t scroll_y;
+};
+
+static struct input_split_pending pending[ARRAY_SIZE(regs)];
+static struct k_spinlock pending_lock;
+
+static bool has_motion(const struct input_split_pending *p) {
+    return p->x != 0 || p->y != 0 || p->scroll_x != 0 || p->scroll_y != 0;
+}
+
+static int16_t take(int32_t *value) {
+    int16_t sent = CLAMP(*value, INT16_MIN, INT16_MAX);
+    *value -= sent;
+    return sent;
+}
+
+static void send_frames_callback(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(send_frames_work, send_frames_callback);
+
+static void schedule_frames(void) {
+    // The frame goes out one transport interval after its first motion, and is not held back any
+    // further by later motion.
+    k_work_schedule_for_queue(zmk_split_service_work_q(), &send_frames_work,
+                              K_USEC(input_frame_interval_us_impl()));
+}
+
+static void send_frames_callback(struct k_work *work) {
+    bool more = false;
+
+    for (int i = 0; i < ARRAY_SIZE(regs); i++) {
+        struct zmk_split_input_frame frame = {.reg = regs[i]};
+
+        k_spinlock_key_t key = k_spin_lock(&pending_lock);
+        bool send = has_motion(&pending[i]);
+        if (send) {
+            frame.x = take(&pending[i].x);
+            frame.y = take(&pending[i].y);
+            frame.scroll_x = take(&pending[i].scroll_x);
+            frame.scroll_y = take(&pending[i].scroll_y);
+            more = more || has_motion(&pending[i]);
+        }
+        k_spin_unlock(&pending_lock, key);
+
+        if (send) {
+            send_input_frame_impl(&frame);
+        }
+    }
+
+    if (more) {
+        schedule_frames();
+    }
+}
+
+static void input_split_handle(size_t index, struct input_event *evt) {
+    if (evt->type != INPUT_EV_REL) {
+        return;
+    }
+
+    struct input_split_pending *p = &pending[index];
+
+    k_spinlock_key_t key = k_spin_lock(&pending_lock);
+    switch (evt->code) {
+    case INPUT_REL_X:
+        p->x += evt->value;
+        break;
+    case INPUT_REL_Y:
+        p->y += evt->value;
+        break;
+    case INPUT_REL_WHEEL:
+        p->scroll_y += evt->value * 120;
+        break;
+    case INPUT_REL_HWHEEL:
+        p->scroll_x += evt->value * 120;
+        break;
+    case INPUT_REL_WHEEL_HI_RES:
+        p->scroll_y += evt->value;
+        break;
+    case INPUT_REL_HWHEEL_HI_RES:
+        p->scroll_x += evt->value;
+        break;
+    default:
+        break;
+    }
+    bool moved = has_motion(p);
+    k_spin_unlock(&pending_lock, key);
+
+    if (moved) {
+        schedule_frames();
+    }
+}
+
+#define INPUT_SPLIT_INST(n)                                                                        \
+    BUILD_ASSERT(DT_INST_NODE_HAS_PROP(n, device),                                                 \
+                 "zmk,input-split nodes need a device on the peripheral");                         \
+    static void input_split_handle_##n(struct input_event *evt) { input_split_handle(n, evt); }    \
+    INPUT_CALLBACK_DEFINE(DEVICE_DT_GET(DT_INST_PHANDLE(n, device)), input_split_handle_##n);
+
+DT_INST_FOREACH_STATUS_OKAY(INPUT_SPLIT_INST)
+
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
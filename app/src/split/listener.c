@@ -23,9 +23,9 @@ int split_listener(const zmk_event_t *eh) {
     const struct zmk_position_state_changed *pos_ev;
     if ((pos_ev = as_zmk_position_state_changed(eh)) != NULL) {
         if (pos_ev->state) {
-            return zmk_split_position_pressed(pos_ev->position);
+            return zmk_split_position_pressed(pos_ev->position, pos_ev->timestamp);
         } else {
-            return zmk_split_position_released(pos_ev->position);
+            return zmk_split_position_released(pos_ev->position, pos_ev->timestamp);
         }
     }
 
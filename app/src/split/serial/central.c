@@ -5,52 +5,357 @@
  */
 
 #include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/sys/util.h>
 
 #include <zmk/split/central.h>
+#include <zmk/split/serial/central.h>
 #include <zmk/split/serial/serial.h>
 #include <zmk/events/position_state_changed.h>
+#include <zmk/boot_timing.h>
 
 // TODO TODO TODO
 #include <zephyr/logging/log.h>
 LOG_MODULE_DECLARE(slicemk);
 
 #define POSITION_STATE_DATA_LEN 16
-static uint8_t position_state[POSITION_STATE_DATA_LEN];
-static uint8_t changed_positions[POSITION_STATE_DATA_LEN];
 
-static void serial_handle_bitmap(uint8_t *data, uint8_t len) {
+// The clock offset is taken from the recent ping with the lowest round trip time, since that is
+// the least affected by buffering and scheduling delays.
+#define CLOCK_SAMPLES 8
+
+// Copies of a position frame from bonded links arrive within a few frames of each other. A
+// sequence number further behind than this is a new frame, such as after the numbers wrap.
+#define POSITION_SEQ_WINDOW 64
+
+struct clock_sample {
+    int32_t offset;
+    uint32_t rtt;
+};
+
+// State for the peripheral on each serial link, or the single peripheral on all bonded links. The
+// index is used as the event source slot. Only accessed from the serial work queue.
+struct serial_peripheral {
+    uint8_t position_state[POSITION_STATE_DATA_LEN];
+    uint8_t changed_positions[POSITION_STATE_DATA_LEN];
+
+    uint16_t seq_epoch;
+    uint16_t last_seq;
+    bool seq_valid;
+
+    struct clock_sample clock_samples[CLOCK_SAMPLES];
+    uint8_t clock_sample_count;
+    uint8_t clock_sample_next;
+
+    // Peripheral time minus central time, in milliseconds.
+    int32_t clock_offset;
+    bool clock_synced;
+
+    // Timestamps converted from the peripheral's clock are kept in order, so behaviors never see
+    // a later key state change with an earlier timestamp.
+    int64_t last_timestamp;
+};
+
+static struct serial_peripheral peripherals[ZMK_SPLIT_SERIAL_PERIPHERAL_COUNT];
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_SERIAL_BOND_LINKS)
+// Uptime of the last frame received on each link, used to pick a live link for commands which
+// must only be sent once.
+static uint32_t link_last_rx[ZMK_SPLIT_SERIAL_LINK_COUNT];
+#endif
+
+static inline uint8_t link_peripheral(uint8_t slot) {
+    return IS_ENABLED(CONFIG_ZMK_SPLIT_SERIAL_BOND_LINKS) ? 0 : slot;
+}
+
+// Returns whether a position frame is new, rather than a copy already received on another link.
+static bool accept_position_seq(struct serial_peripheral *peripheral, uint8_t **data,
+                                uint8_t *len) {
+    struct serial_position_header header;
+    if (*len < sizeof(header)) {
+        LOG_ERR("Received position frame without header (%d bytes)", *len);
+        return false;
+    }
+    memcpy(&header, *data, sizeof(header));
+    *data += sizeof(header);
+    *len -= sizeof(header);
+
+    if (peripheral->seq_valid && header.epoch != peripheral->seq_epoch) {
+        // The peripheral restarted, so its sequence numbers and clock started over.
+        LOG_INF("Peripheral restarted, resetting its sequence and clock sync");
+        peripheral->seq_valid = false;
+        peripheral->clock_sample_count = 0;
+        peripheral->clock_sample_next = 0;
+        peripheral->clock_synced = false;
+    }
+
+    int16_t age = (int16_t)(peripheral->last_seq - header.seq);
+    if (peripheral->seq_valid && age >= 0 && age < POSITION_SEQ_WINDOW) {
+        return false;
+    }
+
+    peripheral->seq_epoch = header.epoch;
+    peripheral->last_seq = header.seq;
+    peripheral->seq_valid = true;
+    return true;
+}
+
+static void serial_handle_clock_pong(struct serial_peripheral *peripheral, uint8_t *data,
+                                     uint8_t len) {
+    struct serial_clock_pong pong;
+    if (len < sizeof(pong)) {
+        LOG_ERR("Received short clock pong (%d bytes)", len);
+        return;
+    }
+    memcpy(&pong, data, sizeof(pong));
+
+    uint32_t rtt = k_uptime_get_32() - pong.central_time;
+    peripheral->clock_samples[peripheral->clock_sample_next] = (struct clock_sample){
+        // Assume the peripheral read its clock halfway through the round trip.
+        .offset = (int32_t)(pong.peripheral_time - (pong.central_time + rtt / 2)),
+        .rtt = rtt,
+    };
+    peripheral->clock_sample_next = (peripheral->clock_sample_next + 1) % CLOCK_SAMPLES;
+    peripheral->clock_sample_count = MIN(peripheral->clock_sample_count + 1, CLOCK_SAMPLES);
+
+    const struct clock_sample *best = &peripheral->clock_samples[0];
+    for (int i = 1; i < peripheral->clock_sample_count; i++) {
+        if (peripheral->clock_samples[i].rtt < best->rtt) {
+            best = &peripheral->clock_samples[i];
+        }
+    }
+
+    peripheral->clock_offset = best->offset;
+    peripheral->clock_synced = true;
+    LOG_DBG("Clock offset %d ms, round trip %d ms", peripheral->clock_offset, best->rtt);
+}
+
+static int64_t peripheral_to_central_time(const struct serial_peripheral *peripheral,
+                                          uint32_t peripheral_time, int64_t now) {
+    if (!peripheral->clock_synced) {
+        return now;
+    }
+
+    uint32_t central_time = peripheral_time - peripheral->clock_offset;
+    int64_t timestamp = now - (int32_t)((uint32_t)now - central_time);
+
+    return MIN(timestamp, now);
+}
+
+static void clock_ping_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(clock_ping_work, clock_ping_work_handler);
+
+static void clock_ping_work_handler(struct k_work *work) {
+    // With bonded links every link is pinged, so the clock offset comes from the fastest one.
+    for (uint8_t slot = 0; slot < ZMK_SPLIT_SERIAL_LINK_COUNT; slot++) {
+        struct serial_clock_ping ping = {.central_time = k_uptime_get_32()};
+        serial_write_slot(slot, SERIAL_CMD_CLOCK_PING, (uint8_t *)&ping, sizeof(ping));
+    }
+    k_work_schedule(&clock_ping_work, K_MSEC(CONFIG_ZMK_SPLIT_SERIAL_CLOCK_SYNC_INTERVAL_MS));
+}
+
+static int serial_central_init(void) {
+    k_work_schedule(&clock_ping_work, K_NO_WAIT);
+    return 0;
+}
+
+ZMK_SYS_INIT(serial_central_init, APPLICATION, CONFIG_ZMK_SPLIT_INIT_PRIORITY);
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+
+static void serial_handle_input_frame(uint8_t *data, uint8_t len) {
+    struct zmk_split_input_frame frame;
+    if (len < sizeof(frame)) {
+        LOG_ERR("Received short input frame (%d bytes)", len);
+        return;
+    }
+
+    memcpy(&frame, data, sizeof(frame));
+    zmk_split_input_frame_handle(&frame);
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+
+static void raise_position_state(uint8_t slot, uint32_t position, bool pressed,
+                                 int64_t timestamp) {
+    struct serial_peripheral *peripheral = &peripherals[slot];
+
+    timestamp = MAX(timestamp, peripheral->last_timestamp);
+    peripheral->last_timestamp = timestamp;
+
+    struct zmk_position_state_changed ev = {.source = slot,
+                                            .position = position,
+                                            .state = pressed,
+                                            .timestamp = timestamp};
+    zmk_position_state_change_handle(&ev);
+}
+
+static void serial_handle_bitmap(uint8_t slot, uint8_t *data, uint8_t len) {
+    struct serial_peripheral *peripheral = &peripherals[slot];
+
+    if (!accept_position_seq(peripheral, &data, &len)) {
+        return;
+    }
+
+    if (len < POSITION_STATE_DATA_LEN) {
+        LOG_ERR("Received short position state bitmap (%d bytes)", len);
+        return;
+    }
+
     for (int i = 0; i < POSITION_STATE_DATA_LEN; i++) {
-        changed_positions[i] = ((uint8_t *)data)[i] ^ position_state[i];
-        position_state[i] = ((uint8_t *)data)[i];
-        LOG_DBG("TODO TODO TODO data: %d", position_state[i]);
+        peripheral->changed_positions[i] = data[i] ^ peripheral->position_state[i];
+        peripheral->position_state[i] = data[i];
     }
 
     for (int i = 0; i < POSITION_STATE_DATA_LEN; i++) {
         for (int j = 0; j < 8; j++) {
-            if (changed_positions[i] & BIT(j)) {
+            if (peripheral->changed_positions[i] & BIT(j)) {
                 uint32_t position = (i * 8) + j;
-                bool pressed = position_state[i] & BIT(j);
+                bool pressed = peripheral->position_state[i] & BIT(j);
+
+                raise_position_state(slot, position, pressed, k_uptime_get());
+            }
+        }
+    }
+}
+
+static void serial_handle_delta(uint8_t slot, uint8_t *data, uint8_t len) {
+    struct serial_peripheral *peripheral = &peripherals[slot];
+    int64_t now = k_uptime_get();
+
+    if (!accept_position_seq(peripheral, &data, &len)) {
+        return;
+    }
+
+    for (int i = 0; i + sizeof(struct serial_position_delta) <= len;
+         i += sizeof(struct serial_position_delta)) {
+        struct serial_position_delta delta;
+        memcpy(&delta, &data[i], sizeof(delta));
 
-                // TODO TODO TODO does zero make sense? check ble central. what
-                // slot is central itself?
-                int slot = 0;
+        if (delta.position >= POSITION_STATE_DATA_LEN * 8) {
+            LOG_WRN("Received delta for out of range position %d", delta.position);
+            continue;
+        }
+
+        uint8_t *byte = &peripheral->position_state[delta.position / 8];
+        bool pressed = delta.state != 0;
+
+        // Deltas can repeat a change if the peripheral resent it, so only raise actual changes.
+        if (((*byte & BIT(delta.position % 8)) != 0) == pressed) {
+            continue;
+        }
+
+        WRITE_BIT(*byte, delta.position % 8, pressed);
+        raise_position_state(slot, delta.position, pressed,
+                             peripheral_to_central_time(peripheral, delta.timestamp, now));
+    }
+}
 
-                struct zmk_position_state_changed ev = {.source = slot,
-                                                        .position = position,
-                                                        .state = pressed,
-                                                        .timestamp = k_uptime_get()};
-                zmk_position_state_change_handle(&ev);
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_SERIAL_BOND_LINKS)
+
+// Behaviors must run exactly once, so they go to the link the peripheral was heard on most
+// recently, falling over to the other links if it can't take the frame.
+static int write_bonded_once(uint32_t cmd, uint8_t *data, uint8_t len) {
+    uint32_t now = k_uptime_get_32();
+    bool tried[ZMK_SPLIT_SERIAL_LINK_COUNT] = {0};
+    int err = -ENODEV;
+
+    for (int n = 0; n < ZMK_SPLIT_SERIAL_LINK_COUNT; n++) {
+        int best = -1;
+        for (int slot = 0; slot < ZMK_SPLIT_SERIAL_LINK_COUNT; slot++) {
+            if (!tried[slot] &&
+                (best < 0 || now - link_last_rx[slot] < now - link_last_rx[best])) {
+                best = slot;
             }
         }
+
+        tried[best] = true;
+        err = serial_write_slot(best, cmd, data, len);
+        if (err == 0) {
+            break;
+        }
     }
+
+    return err;
 }
 
-void serial_handle_rx(uint32_t cmd, uint8_t *data, uint8_t len) {
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_SERIAL_BOND_LINKS)
+
+void send_split_run_impl(struct zmk_split_run_behavior_payload_wrapper *payload_wrapper) {
+    if (payload_wrapper->source >= ZMK_SPLIT_SERIAL_PERIPHERAL_COUNT) {
+        LOG_ERR("No serial link for source %d", payload_wrapper->source);
+        return;
+    }
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_SERIAL_BOND_LINKS)
+    int err = write_bonded_once(SERIAL_CMD_RUN_BEHAVIOR, (uint8_t *)&payload_wrapper->payload,
+                                sizeof(payload_wrapper->payload));
+#else
+    int err = serial_write_slot(payload_wrapper->source, SERIAL_CMD_RUN_BEHAVIOR,
+                                (uint8_t *)&payload_wrapper->payload,
+                                sizeof(payload_wrapper->payload));
+#endif
+    if (err) {
+        LOG_ERR("Failed to send behavior to the peripheral (err %d)", err);
+    }
+}
+
+// Each invocation is queued on the serial link as soon as it is sent, so there is nothing to flush.
+void send_split_run_flush_impl(void) {}
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+
+static zmk_hid_indicators_t hid_indicators;
+
+// Only the latest indicator state matters, so updates made before the work runs are coalesced into
+// a single frame per link.
+static void update_hid_indicators_work_handler(struct k_work *work) {
+    zmk_hid_indicators_t indicators = hid_indicators;
+
+    for (uint8_t slot = 0; slot < ZMK_SPLIT_SERIAL_LINK_COUNT; slot++) {
+        int err = serial_write_slot(slot, SERIAL_CMD_HID_INDICATORS, (uint8_t *)&indicators,
+                                    sizeof(indicators));
+        if (err) {
+            LOG_ERR("Failed to send HID indicators to peripheral %d (err %d)", slot, err);
+        }
+    }
+}
+
+static K_WORK_DEFINE(update_hid_indicators_work, update_hid_indicators_work_handler);
+
+int zmk_split_serial_update_hid_indicator(zmk_hid_indicators_t indicators) {
+    hid_indicators = indicators;
+    return k_work_submit(&update_hid_indicators_work);
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+
+void serial_handle_rx(uint8_t slot, uint32_t cmd, uint8_t *data, uint8_t len) {
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_SERIAL_BOND_LINKS)
+    link_last_rx[slot] = k_uptime_get_32();
+#endif
+
+    uint8_t source = link_peripheral(slot);
+
     switch (cmd) {
-    // Handle split bitmap transformed (sbt) version 0.
-    case 0x73627400:
-        serial_handle_bitmap(data, len);
+    case SERIAL_CMD_POSITION_BITMAP:
+        serial_handle_bitmap(source, data, len);
+        break;
+
+    case SERIAL_CMD_POSITION_DELTA:
+        serial_handle_delta(source, data, len);
+        break;
+
+    case SERIAL_CMD_CLOCK_PONG:
+        serial_handle_clock_pong(&peripherals[source], data, len);
+        break;
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+    case SERIAL_CMD_INPUT_FRAME:
+        serial_handle_input_frame(data, len);
         break;
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
 
     default:
         LOG_ERR("Received unexpected UART command 0x%08x", cmd);
@@ -5,20 +5,251 @@
  */
 
 #include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/sys/util.h>
+#if IS_ENABLED(CONFIG_ENTROPY_HAS_DRIVER)
+#include <zephyr/random/random.h>
+#endif
 
+#include <drivers/behavior.h>
+#include <zmk/behavior.h>
+#include <zmk/split/service.h>
 #include <zmk/split/serial/serial.h>
+#include <zmk/boot_timing.h>
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+#include <zmk/events/hid_indicators_changed.h>
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
 
 // TODO TODO TODO
 #include <zephyr/logging/log.h>
 LOG_MODULE_DECLARE(slicemk);
 
-// TODO TODO TODO these two should be in a header somewhere
+// Changes beyond this many are sent as a full bitmap instead, which loses the timestamps.
+#define POSITION_DELTA_MAX 16
+
+#define POSITION_FRAME_MAX                                                                         \
+    (sizeof(struct serial_position_header) +                                                       \
+     MAX(ZMK_SPLIT_POS_STATE_LEN, POSITION_DELTA_MAX * sizeof(struct serial_position_delta)))
+
+// The latest state, and the state the central has been sent. Only accessed from the split service
+// work queue, so deltas and resync frames are always sent in order.
+static uint8_t position_state[ZMK_SPLIT_POS_STATE_LEN];
+static uint8_t sent_position_state[ZMK_SPLIT_POS_STATE_LEN];
+static uint16_t position_seq;
+static uint16_t position_epoch;
+
+// Any value other than the one from the last boot will do. Without an entropy driver, the cycle
+// count when the first frame is sent varies enough from boot to boot, since that waits on the
+// first key press or resync.
+static uint16_t get_position_epoch(void) {
+    if (position_epoch == 0) {
+#if IS_ENABLED(CONFIG_ENTROPY_HAS_DRIVER)
+        uint32_t value = sys_rand32_get();
+#else
+        uint32_t value = k_cycle_get_32();
+#endif
+        position_epoch = MAX((uint16_t)(value ^ (value >> 16)), 1);
+    }
+
+    return position_epoch;
+}
+
+static void serial_handle_clock_ping(uint8_t slot, uint8_t *data, uint8_t len) {
+    struct serial_clock_ping ping;
+    if (len < sizeof(ping)) {
+        LOG_ERR("Received short clock ping (%d bytes)", len);
+        return;
+    }
+    memcpy(&ping, data, sizeof(ping));
+
+    struct serial_clock_pong pong = {
+        .central_time = ping.central_time,
+        .peripheral_time = k_uptime_get_32(),
+    };
+    serial_write_slot(slot, SERIAL_CMD_CLOCK_PONG, (uint8_t *)&pong, sizeof(pong));
+}
+
+static void serial_handle_run_behavior(uint8_t *data, uint8_t len) {
+    struct zmk_split_run_behavior_payload payload = {0};
+
+    if (len <= sizeof(payload.data) || len > sizeof(payload)) {
+        LOG_ERR("Received behavior payload with invalid length %d", len);
+        return;
+    }
+
+    memcpy(&payload, data, len);
+    payload.behavior_dev[sizeof(payload.behavior_dev) - 1] = '\0';
+
+    struct zmk_behavior_binding binding = {
+        .param1 = payload.data.param1,
+        .param2 = payload.data.param2,
+        .behavior_dev = payload.behavior_dev,
+    };
+    LOG_DBG("%s with params %d %d: pressed? %d", binding.behavior_dev, binding.param1,
+            binding.param2, payload.data.state);
+    struct zmk_behavior_binding_event event = {.position = payload.data.position,
+                                               .timestamp = k_uptime_get()};
+
+    // Behaviors run on the serial work queue, which has a lower priority than the split service
+    // queue, so lighting and other central commands can't hold up key state sent to the central.
+    int err;
+    if (payload.data.state > 0) {
+        err = behavior_keymap_binding_pressed(&binding, event);
+    } else {
+        err = behavior_keymap_binding_released(&binding, event);
+    }
+
+    if (err) {
+        LOG_ERR("Failed to invoke behavior %s: %d", binding.behavior_dev, err);
+    }
+}
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+
+static zmk_hid_indicators_t hid_indicators;
+
+static void update_hid_indicators_work_handler(struct k_work *work) {
+    LOG_DBG("Raising HID indicators changed event: %x", hid_indicators);
+    raise_zmk_hid_indicators_changed(
+        (struct zmk_hid_indicators_changed){.indicators = hid_indicators});
+}
+
+static K_WORK_DEFINE(update_hid_indicators_work, update_hid_indicators_work_handler);
+
+static void serial_handle_hid_indicators(uint8_t *data, uint8_t len) {
+    if (len != sizeof(hid_indicators)) {
+        LOG_ERR("Received HID indicators with invalid length %d", len);
+        return;
+    }
+
+    memcpy(&hid_indicators, data, sizeof(hid_indicators));
+    k_work_submit(&update_hid_indicators_work);
+}
+
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+
+void serial_handle_rx(uint8_t slot, uint32_t cmd, uint8_t *data, uint8_t len) {
+    switch (cmd) {
+    case SERIAL_CMD_CLOCK_PING:
+        serial_handle_clock_ping(slot, data, len);
+        break;
+
+    case SERIAL_CMD_RUN_BEHAVIOR:
+        serial_handle_run_behavior(data, len);
+        break;
 
-// TODO TODO TODO implement central to peripheral data transfer
-void serial_handle_rx(uint32_t cmd, uint8_t *data, uint8_t len) {
-    LOG_HEXDUMP_ERR(data, len, "central to peripheral");
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+    case SERIAL_CMD_HID_INDICATORS:
+        serial_handle_hid_indicators(data, len);
+        break;
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_PERIPHERAL_HID_INDICATORS)
+
+    default:
+        LOG_ERR("Received unexpected UART command 0x%08x", cmd);
+        break;
+    }
+}
+
+static int send_position_frame(uint32_t cmd, const void *data, uint8_t len) {
+    uint8_t frame[POSITION_FRAME_MAX];
+    struct serial_position_header header = {
+        .epoch = get_position_epoch(),
+        .seq = position_seq++,
+    };
+
+    len = MIN(len, sizeof(frame) - sizeof(header));
+    memcpy(frame, &header, sizeof(header));
+    memcpy(&frame[sizeof(header)], data, len);
+
+    // With bonded links, a frame counts as sent once any link has it. Otherwise a disconnected
+    // link would turn every later change into a resend.
+    if (IS_ENABLED(CONFIG_ZMK_SPLIT_SERIAL_BOND_LINKS)) {
+        return serial_write_any(cmd, frame, sizeof(header) + len);
+    }
+    return serial_write_all(cmd, frame, sizeof(header) + len);
+}
+
+static void send_position_bitmap(void) {
+    int err = send_position_frame(SERIAL_CMD_POSITION_BITMAP, position_state,
+                                  sizeof(position_state));
+    if (err == 0) {
+        memcpy(sent_position_state, position_state, sizeof(position_state));
+    }
 }
 
-void send_position_state_impl(uint8_t *state, int len) {
-    serial_write_uart(0x73627400, state, len);
+void send_position_state_impl(uint8_t *state, int len, int64_t timestamp) {
+    memcpy(position_state, state, MIN(len, sizeof(position_state)));
+
+    struct serial_position_delta deltas[POSITION_DELTA_MAX];
+    int count = 0;
+
+    // Diffing against the last state that was sent also resends changes from frames that were
+    // dropped because the TX buffer was full.
+    for (int i = 0; i < sizeof(position_state); i++) {
+        uint8_t changed = position_state[i] ^ sent_position_state[i];
+        for (int j = 0; j < 8; j++) {
+            if (!(changed & BIT(j))) {
+                continue;
+            }
+
+            if (count == POSITION_DELTA_MAX) {
+                send_position_bitmap();
+                return;
+            }
+
+            deltas[count++] = (struct serial_position_delta){
+                .position = (i * 8) + j,
+                .state = (position_state[i] & BIT(j)) ? 1 : 0,
+                .timestamp = (uint32_t)timestamp,
+            };
+        }
+    }
+
+    if (count == 0) {
+        return;
+    }
+
+    int err = send_position_frame(SERIAL_CMD_POSITION_DELTA, deltas, count * sizeof(deltas[0]));
+    if (err == 0) {
+        memcpy(sent_position_state, position_state, sizeof(position_state));
+    }
 }
+
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+
+void send_input_frame_impl(const struct zmk_split_input_frame *frame) {
+    // A lost frame only loses a little motion, so unlike position frames it isn't resent.
+    int err = serial_write_all(SERIAL_CMD_INPUT_FRAME, (uint8_t *)frame, sizeof(*frame));
+    if (err) {
+        LOG_DBG("Failed to send input frame (%d)", err);
+    }
+}
+
+// The central reports to its host at most once per millisecond over USB full speed, so motion is
+// summed up for that long.
+uint32_t input_frame_interval_us_impl(void) { return 1000; }
+
+#endif // IS_ENABLED(CONFIG_ZMK_SPLIT_INPUT)
+
+#if CONFIG_ZMK_SPLIT_SERIAL_RESYNC_INTERVAL_MS > 0
+
+static void resync_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(resync_work, resync_work_handler);
+
+static void resync_work_handler(struct k_work *work) {
+    send_position_bitmap();
+    k_work_schedule_for_queue(zmk_split_service_work_q(), &resync_work,
+                              K_MSEC(CONFIG_ZMK_SPLIT_SERIAL_RESYNC_INTERVAL_MS));
+}
+
+static int serial_peripheral_init(void) {
+    k_work_schedule_for_queue(zmk_split_service_work_q(), &resync_work,
+                              K_MSEC(CONFIG_ZMK_SPLIT_SERIAL_RESYNC_INTERVAL_MS));
+    return 0;
+}
+
+ZMK_SYS_INIT(serial_peripheral_init, APPLICATION, CONFIG_ZMK_SPLIT_INIT_PRIORITY);
+
+#endif // CONFIG_ZMK_SPLIT_SERIAL_RESYNC_INTERVAL_MS > 0
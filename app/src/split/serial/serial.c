@@ -7,25 +7,39 @@
 #include <zephyr/device.h>
 #include <zephyr/drivers/uart.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/shell/shell.h>
 #include <zephyr/sys/crc.h>
 
+#include <zmk/activity.h>
+#include <zmk/event_manager.h>
+#include <zmk/events/activity_state_changed.h>
 #include <zmk/split/serial/serial.h>
+#include <zmk/boot_timing.h>
+#include <zmk/resource_stats.h>
+#include <zmk/workqueue.h>
 
 // TODO TODO TODO
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(slicemk);
 
 #define SERIAL_MSG_PREFIX "UarT"
+#define SERIAL_MSG_PREFIX_LEN (sizeof(SERIAL_MSG_PREFIX) - 1)
 
-K_THREAD_STACK_DEFINE(serial_wq_stack, 1024);
+K_THREAD_STACK_DEFINE(serial_wq_stack, CONFIG_ZMK_SPLIT_SERIAL_THREAD_STACK_SIZE);
 static struct k_work_q serial_wq;
 
+ZMK_STACK_STATS_DEFINE(serial_wq, serial_wq_stack, "Serial split");
+ZMK_WORKQUEUE_REGISTER(serial_wq, "Serial split", ZMK_WORKQUEUE_LATENCY_TRANSPORT);
+
 static struct serial_device serial_devs[] = {
 #ifdef CONFIG_ZMK_SPLIT_SERIAL_UART
     {
         .dev = DEVICE_DT_GET(DT_CHOSEN(zmk_split_uart)),
 #ifdef CONFIG_ZMK_SPLIT_SERIAL_UART_POLL
         .poll = true,
+#endif
+#ifdef CONFIG_ZMK_SPLIT_SERIAL_UART_ASYNC
+        .async = true,
 #endif
     },
 #endif
@@ -36,7 +50,8 @@ static struct serial_device serial_devs[] = {
 #endif
 };
 
-#define CONFIG_ZMK_SPLIT_SERIAL_COUNT ARRAY_SIZE(serial_devs)
+BUILD_ASSERT(ARRAY_SIZE(serial_devs) == ZMK_SPLIT_SERIAL_LINK_COUNT,
+             "Serial devices must match the serial link numbering");
 
 static bool serial_tx_callback(struct serial_device *ud) {
     // Read data from buffer. Stop transmitting if buffer is empty.
@@ -56,44 +71,137 @@ static bool serial_tx_callback(struct serial_device *ud) {
     return false;
 }
 
-static void serial_rx_work_handler(struct k_work *work) {
-    struct serial_device *sd = CONTAINER_OF(work, struct serial_device, rx_work);
+static int serial_write(struct serial_device *sd, uint32_t cmd, uint8_t *data, uint8_t len);
 
-    // Continue processing data as long as the buffer exceeds the header length
-    // (13 bytes).
-    uint8_t data[280];
-    while (ring_buf_peek(&sd->rx_rb, data, 13) >= 13) {
-        // Discard single byte if prefix does not match.
-        if (memcmp(data, SERIAL_MSG_PREFIX, strlen(SERIAL_MSG_PREFIX))) {
-            uint8_t discard;
-            ring_buf_get(&sd->rx_rb, &discard, 1);
-            continue;
+static void serial_handle_echo_reply(struct serial_device *sd, uint8_t *data, uint8_t len) {
+    struct serial_echo echo;
+    if (len != sizeof(echo) || !sd->echo_pending) {
+        return;
+    }
+
+    memcpy(&echo, data, sizeof(echo));
+    sd->echo_pending = false;
+    sd->stats.rtt_us = k_cyc_to_us_floor32(k_cycle_get_32() - echo.cycles);
+}
+
+static void serial_rx_dispatch(struct serial_device *sd, uint8_t *body) {
+    uint32_t cmd, crc;
+    uint8_t len = sd->rx_header[12];
+    memcpy(&cmd, &sd->rx_header[4], sizeof(cmd));
+    memcpy(&crc, &sd->rx_header[8], sizeof(crc));
+
+    if (crc != sd->rx_crc) {
+        sd->stats.rx_crc_errors++;
+        LOG_ERR("received UART message with invalid CRC32 checksum");
+        return;
+    }
+
+    sd->stats.rx_frames++;
+
+    // Latency probes are answered here so they measure the link rather than the split role.
+    switch (cmd) {
+    case SERIAL_CMD_ECHO_REQUEST:
+        serial_write(sd, SERIAL_CMD_ECHO_REPLY, body, len);
+        break;
+
+    case SERIAL_CMD_ECHO_REPLY:
+        serial_handle_echo_reply(sd, body, len);
+        break;
+
+    default:
+        serial_handle_rx(sd - serial_devs, cmd, body, len);
+        break;
+    }
+}
+
+// Feed received bytes through the frame parser. Each byte is looked at once: the prefix is matched
+// incrementally, and the checksum is computed over the body as it is consumed. A body that is
+// contiguous in @p data is handled in place; otherwise it is assembled in rx_frame.
+static void serial_rx_consume(struct serial_device *sd, uint8_t *data, uint32_t size) {
+    uint32_t i = 0;
+
+    while (i < size) {
+        switch (sd->rx_state) {
+        case SERIAL_RX_STATE_PREFIX: {
+            uint8_t c = data[i++];
+            if (c == SERIAL_MSG_PREFIX[sd->rx_pos]) {
+                sd->rx_header[sd->rx_pos++] = c;
+            } else {
+                // The prefix doesn't overlap itself, so a mismatch can only restart the match.
+                bool restart = c == SERIAL_MSG_PREFIX[0];
+                sd->stats.rx_discarded += sd->rx_pos + (restart ? 0 : 1);
+                sd->rx_pos = restart ? 1 : 0;
+                sd->rx_header[0] = c;
+            }
+
+            if (sd->rx_pos == SERIAL_MSG_PREFIX_LEN) {
+                sd->rx_state = SERIAL_RX_STATE_HEADER;
+            }
+            break;
         }
 
-        // Stop processing if message body is not completely buffered.
-        int len = data[12];
-        int total = len + 13;
-        if (ring_buf_size_get(&sd->rx_rb) < total) {
-            return;
+        case SERIAL_RX_STATE_HEADER: {
+            uint32_t n = MIN(size - i, SERIAL_MSG_HEADER_LEN - sd->rx_pos);
+            memcpy(&sd->rx_header[sd->rx_pos], &data[i], n);
+            sd->rx_pos += n;
+            i += n;
+
+            if (sd->rx_pos == SERIAL_MSG_HEADER_LEN) {
+                sd->rx_pos = 0;
+                sd->rx_crc = crc32_ieee(NULL, 0);
+                if (sd->rx_header[12] == 0) {
+                    sd->rx_state = SERIAL_RX_STATE_PREFIX;
+                    serial_rx_dispatch(sd, sd->rx_frame);
+                } else {
+                    sd->rx_state = SERIAL_RX_STATE_BODY;
+                }
+            }
+            break;
         }
 
-        // Check message checksum and handle message.
-        uint32_t cmd, crc;
-        ring_buf_get(&sd->rx_rb, data, total);
-        memcpy(&cmd, &data[4], sizeof(cmd));
-        memcpy(&crc, &data[8], sizeof(crc));
-        if (crc == crc32_ieee(&data[13], len)) {
-            serial_handle_rx(cmd, &data[13], len);
-        } else {
-            LOG_ERR("received UART message with invalid CRC32 checksum");
+        case SERIAL_RX_STATE_BODY: {
+            uint8_t len = sd->rx_header[12];
+            uint32_t n = MIN(size - i, len - sd->rx_pos);
+            uint8_t *body = &data[i];
+
+            sd->rx_crc = crc32_ieee_update(sd->rx_crc, body, n);
+            if (sd->rx_pos > 0 || n < len) {
+                memcpy(&sd->rx_frame[sd->rx_pos], body, n);
+                body = sd->rx_frame;
+            }
+            sd->rx_pos += n;
+            i += n;
+
+            if (sd->rx_pos == len) {
+                sd->rx_pos = 0;
+                sd->rx_state = SERIAL_RX_STATE_PREFIX;
+                serial_rx_dispatch(sd, body);
+            }
+            break;
+        }
         }
     }
 }
 
+static void serial_rx_work_handler(struct k_work *work) {
+    struct serial_device *sd = CONTAINER_OF(work, struct serial_device, rx_work);
+    uint8_t *data;
+    uint32_t size;
+
+    // Parse the buffered data where it is, one contiguous region at a time. The data stays claimed
+    // until it has been handled, so the receive callback can't overwrite it.
+    while ((size = ring_buf_get_claim(&sd->rx_rb, &data, SERIAL_BUF_SIZE)) > 0) {
+        serial_rx_consume(sd, data, size);
+        ring_buf_get_finish(&sd->rx_rb, size);
+    }
+}
+
 static void serial_rx_callback(struct serial_device *sd) {
     uint8_t c;
     while (uart_fifo_read(sd->dev, &c, 1) == 1) {
-        ring_buf_put(&sd->rx_rb, &c, 1);
+        if (ring_buf_put(&sd->rx_rb, &c, 1) == 0) {
+            sd->stats.rx_overflow++;
+        }
     }
     k_work_submit_to_queue(&serial_wq, &sd->rx_work);
 }
@@ -110,40 +218,192 @@ static void serial_callback(const struct device *dev, void *data) {
             }
         }
 
-        // TODO TODO TODO lookup index in serial_devs array for slot ID?
         if (uart_irq_rx_ready(dev)) {
             serial_rx_callback(ud);
         }
     }
 }
 
-static void serial_write(struct serial_device *sd, uint32_t cmd, uint8_t *data, uint8_t len) {
-    // TODO TODO TODO use buf with size SERIAL_BUF_SIZE. do single
-    // ring_buf_put() to avoid potential race
-    uint8_t header[13] = SERIAL_MSG_PREFIX;
+#ifdef CONFIG_ZMK_SPLIT_SERIAL_UART_ASYNC
+
+static void serial_async_tx_start(struct serial_device *sd) {
+    // The TX ring buffer is transmitted in place, so only one transfer may be in flight. Whoever
+    // sets tx_busy starts it, and re-checks for data after clearing it so nothing gets stranded.
+    while (!ring_buf_is_empty(&sd->tx_rb) && atomic_cas(&sd->tx_busy, 0, 1)) {
+        uint8_t *data;
+        uint32_t len = ring_buf_get_claim(&sd->tx_rb, &data, SERIAL_BUF_SIZE);
+        if (len > 0) {
+            int err = uart_tx(sd->dev, data, len, SYS_FOREVER_US);
+            if (err == 0) {
+                return;
+            }
+            LOG_ERR("failed to start UART transmission (err %d)", err);
+        }
+
+        ring_buf_get_finish(&sd->tx_rb, 0);
+        atomic_clear(&sd->tx_busy);
+        if (len > 0) {
+            return;
+        }
+    }
+}
+
+static void serial_async_callback(const struct device *dev, struct uart_event *evt,
+                                  void *user_data) {
+    struct serial_device *sd = user_data;
+
+    switch (evt->type) {
+    case UART_TX_DONE:
+    case UART_TX_ABORTED:
+        ring_buf_get_finish(&sd->tx_rb, evt->data.tx.len);
+        atomic_clear(&sd->tx_busy);
+        serial_async_tx_start(sd);
+        break;
+
+    case UART_RX_RDY: {
+        uint32_t len = ring_buf_put(&sd->rx_rb, &evt->data.rx.buf[evt->data.rx.offset],
+                                    evt->data.rx.len);
+        if (len < evt->data.rx.len) {
+            sd->stats.rx_overflow += evt->data.rx.len - len;
+            LOG_ERR("UART RX buffer overflow, dropped %d bytes", evt->data.rx.len - len);
+        }
+        k_work_submit_to_queue(&serial_wq, &sd->rx_work);
+        break;
+    }
+
+    case UART_RX_BUF_REQUEST:
+        uart_rx_buf_rsp(dev, sd->async_rx_bufs[sd->rx_next_buf], sizeof(sd->async_rx_bufs[0]));
+        sd->rx_next_buf = !sd->rx_next_buf;
+        break;
+
+    case UART_RX_STOPPED:
+        LOG_ERR("UART reception stopped (reason %d)", evt->data.rx_stop.reason);
+        break;
+
+    case UART_RX_DISABLED:
+        // Reception is disabled after an error, so restart it with a fresh pair of buffers.
+        sd->rx_next_buf = 1;
+        uart_rx_enable(dev, sd->async_rx_bufs[0], sizeof(sd->async_rx_bufs[0]),
+                       CONFIG_ZMK_SPLIT_SERIAL_UART_ASYNC_RX_TIMEOUT_US);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static int serial_async_init(struct serial_device *sd) {
+    int err = uart_callback_set(sd->dev, serial_async_callback, sd);
+    if (err) {
+        LOG_ERR("failed to set async callback for %s (err %d)", sd->dev->name, err);
+        return err;
+    }
+
+    sd->rx_next_buf = 1;
+    err = uart_rx_enable(sd->dev, sd->async_rx_bufs[0], sizeof(sd->async_rx_bufs[0]),
+                         CONFIG_ZMK_SPLIT_SERIAL_UART_ASYNC_RX_TIMEOUT_US);
+    if (err) {
+        LOG_ERR("failed to enable async reception for %s (err %d)", sd->dev->name, err);
+    }
+
+    return err;
+}
+
+#endif
+
+// Copy into the claimed space of the TX ring buffer, which may take more than one claim if the
+// space wraps around the end of the buffer.
+static void serial_tx_claim_copy(struct serial_device *sd, const uint8_t *data, uint32_t len) {
+    while (len > 0) {
+        uint8_t *dst;
+        uint32_t claimed = ring_buf_put_claim(&sd->tx_rb, &dst, len);
+        memcpy(dst, data, claimed);
+        data += claimed;
+        len -= claimed;
+    }
+}
+
+static int serial_write(struct serial_device *sd, uint32_t cmd, uint8_t *data, uint8_t len) {
+    uint8_t header[SERIAL_MSG_HEADER_LEN] = SERIAL_MSG_PREFIX;
     memcpy(&header[4], &cmd, sizeof(cmd));
     uint32_t crc = crc32_ieee(data, len);
     memcpy(&header[8], &crc, sizeof(crc));
     header[12] = len;
-    ring_buf_put(&sd->tx_rb, header, sizeof(header));
-    ring_buf_put(&sd->tx_rb, data, len);
+
+    uint32_t total = sizeof(header) + len;
+
+    // Frames are claimed and committed to the ring buffer under the lock so that frames from
+    // concurrent writers are never interleaved, and a frame is either written whole or not at all.
+    k_spinlock_key_t key = k_spin_lock(&sd->tx_lock);
+
+    if (ring_buf_space_get(&sd->tx_rb) < total) {
+        sd->stats.tx_overflow++;
+        k_spin_unlock(&sd->tx_lock, key);
+        LOG_ERR("UART TX buffer overflow, dropped %d byte message (%d dropped)", total,
+                sd->stats.tx_overflow);
+        return -ENOMEM;
+    }
+
+    serial_tx_claim_copy(sd, header, sizeof(header));
+    serial_tx_claim_copy(sd, data, len);
+    ring_buf_put_finish(&sd->tx_rb, total);
+
+    k_spin_unlock(&sd->tx_lock, key);
 
 #ifdef CONFIG_ZMK_SPLIT_SERIAL_UART_POLL
     if (sd->poll) {
         k_work_submit_to_queue(&serial_wq, &sd->tx_work);
-        return;
+        return 0;
+    }
+#endif
+
+#ifdef CONFIG_ZMK_SPLIT_SERIAL_UART_ASYNC
+    if (sd->async) {
+        serial_async_tx_start(sd);
+        return 0;
     }
 #endif
 
     uart_irq_tx_enable(sd->dev);
+    return 0;
 }
 
-// TODO TODO TODO this should be abstracted a bit differently
-#ifdef CONFIG_ZMK_SPLIT_SERIAL_UART
-void serial_write_uart(uint32_t cmd, uint8_t *data, uint8_t len) {
-    serial_write(&serial_devs[0], cmd, data, len);
+int serial_write_slot(uint8_t slot, uint32_t cmd, uint8_t *data, uint8_t len) {
+    if (slot >= ZMK_SPLIT_SERIAL_LINK_COUNT) {
+        return -EINVAL;
+    }
+
+    return serial_write(&serial_devs[slot], cmd, data, len);
+}
+
+int serial_write_all(uint32_t cmd, uint8_t *data, uint8_t len) {
+    int ret = 0;
+
+    for (uint8_t slot = 0; slot < ZMK_SPLIT_SERIAL_LINK_COUNT; slot++) {
+        int err = serial_write(&serial_devs[slot], cmd, data, len);
+        if (err && !ret) {
+            ret = err;
+        }
+    }
+
+    return ret;
+}
+
+int serial_write_any(uint32_t cmd, uint8_t *data, uint8_t len) {
+    int ret = 0;
+    bool queued = false;
+
+    for (uint8_t slot = 0; slot < ZMK_SPLIT_SERIAL_LINK_COUNT; slot++) {
+        int err = serial_write(&serial_devs[slot], cmd, data, len);
+        if (err == 0) {
+            queued = true;
+        } else if (!ret) {
+            ret = err;
+        }
+    }
+
+    return queued ? 0 : ret;
 }
-#endif
 
 #ifdef CONFIG_ZMK_SPLIT_SERIAL_UART_POLL
 
@@ -155,23 +415,136 @@ static void serial_tx_work_handler(struct k_work *work) {
     }
 }
 
+#define SERIAL_POLL_MAX_TICKS                                                                      \
+    MAX(1, k_us_to_ticks_floor32(CONFIG_ZMK_SPLIT_SERIAL_UART_POLL_MAX_INTERVAL_US))
+
 static void serial_rx_timer_handler(struct k_timer *timer) {
     struct serial_device *sd = CONTAINER_OF(timer, struct serial_device, rx_timer);
+    bool received = false;
     uint8_t c;
     while (uart_poll_in(sd->dev, &c) == 0) {
-        ring_buf_put(&sd->rx_rb, &c, sizeof(c));
+        if (ring_buf_put(&sd->rx_rb, &c, sizeof(c)) == 0) {
+            sd->stats.rx_overflow++;
+        }
+        received = true;
     }
-    k_work_submit_to_queue(&serial_wq, &sd->rx_work);
+
+    // Poll every tick while data is flowing, and back off exponentially while the link is idle.
+    if (received) {
+        sd->rx_poll_ticks = 1;
+        k_work_submit_to_queue(&serial_wq, &sd->rx_work);
+    } else {
+        sd->rx_poll_ticks = MIN(sd->rx_poll_ticks * 2, SERIAL_POLL_MAX_TICKS);
+    }
+
+    k_timer_start(&sd->rx_timer, K_TICKS(sd->rx_poll_ticks), K_NO_WAIT);
+}
+
+static void serial_poll_start(struct serial_device *sd) {
+    sd->rx_poll_ticks = 1;
+    k_timer_start(&sd->rx_timer, K_NO_WAIT, K_NO_WAIT);
+}
+
+static int serial_poll_activity_listener(const zmk_event_t *eh) {
+    enum zmk_activity_state state = zmk_activity_get_state();
+
+    // Keep polling at the backed off rate while idle, since the other half can still send frames
+    // (the central's activity is independent of ours), and only stop once we actually sleep.
+    bool stop = state == ZMK_ACTIVITY_SLEEP;
+
+    for (int i = 0; i < ZMK_SPLIT_SERIAL_LINK_COUNT; i++) {
+        struct serial_device *sd = &serial_devs[i];
+        if (!sd->poll) {
+            continue;
+        }
+
+        if (stop) {
+            k_timer_stop(&sd->rx_timer);
+        } else if (k_timer_remaining_ticks(&sd->rx_timer) == 0) {
+            serial_poll_start(sd);
+        }
+    }
+
+    return ZMK_EV_EVENT_BUBBLE;
+}
+
+ZMK_LISTENER(serial_poll, serial_poll_activity_listener);
+ZMK_SUBSCRIPTION(serial_poll, zmk_activity_state_changed);
+
+#endif
+
+#if CONFIG_ZMK_SPLIT_SERIAL_HEALTH_INTERVAL_MS > 0
+
+static void serial_health_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(serial_health_work, serial_health_work_handler);
+
+// Runs on the serial work queue, like the RX work, so the counters it reads are not being updated
+// by the parser at the same time.
+static void serial_health_work_handler(struct k_work *work) {
+    for (uint8_t slot = 0; slot < ZMK_SPLIT_SERIAL_LINK_COUNT; slot++) {
+        struct serial_device *sd = &serial_devs[slot];
+
+        if (sd->echo_pending) {
+            sd->stats.echo_lost++;
+        }
+
+        raise_zmk_split_serial_link_health_changed(
+            (struct zmk_split_serial_link_health_changed){.slot = slot, .stats = sd->stats});
+
+        struct serial_echo echo = {.cycles = k_cycle_get_32()};
+        sd->echo_pending = serial_write(sd, SERIAL_CMD_ECHO_REQUEST, (uint8_t *)&echo,
+                                        sizeof(echo)) == 0;
+    }
+
+    k_work_schedule_for_queue(&serial_wq, &serial_health_work,
+                              K_MSEC(CONFIG_ZMK_SPLIT_SERIAL_HEALTH_INTERVAL_MS));
 }
 
 #endif
 
+#if IS_ENABLED(CONFIG_SHELL)
+
+static int cmd_serial_stats(const struct shell *sh, size_t argc, char **argv) {
+    for (uint8_t slot = 0; slot < ZMK_SPLIT_SERIAL_LINK_COUNT; slot++) {
+        const struct serial_device *sd = &serial_devs[slot];
+
+        shell_print(sh, "Link %d (%s):", slot, sd->dev->name);
+        shell_print(sh, "  RX frames: %u", sd->stats.rx_frames);
+        shell_print(sh, "  RX CRC errors: %u", sd->stats.rx_crc_errors);
+        shell_print(sh, "  RX bytes discarded: %u", sd->stats.rx_discarded);
+        shell_print(sh, "  RX bytes overflowed: %u", sd->stats.rx_overflow);
+        shell_print(sh, "  TX frames overflowed: %u", sd->stats.tx_overflow);
+        shell_print(sh, "  Echo requests lost: %u", sd->stats.echo_lost);
+        shell_print(sh, "  Round trip time: %u us", sd->stats.rtt_us);
+    }
+    return 0;
+}
+
+static int cmd_serial_reset(const struct shell *sh, size_t argc, char **argv) {
+    for (uint8_t slot = 0; slot < ZMK_SPLIT_SERIAL_LINK_COUNT; slot++) {
+        serial_devs[slot].stats = (struct zmk_split_serial_link_stats){0};
+    }
+    shell_print(sh, "Serial link statistics reset");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_serial,
+                               SHELL_CMD(stats, NULL, "Show link health statistics",
+                                         cmd_serial_stats),
+                               SHELL_CMD(reset, NULL, "Reset statistics", cmd_serial_reset),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((zmk), serial, &sub_serial, "Serial split links", NULL, 0, 0);
+
+#endif // IS_ENABLED(CONFIG_SHELL)
+
 static int serial_init(void) {
     struct k_work_queue_config uart_tx_cfg = {.name = "serial_wq"};
-    k_work_queue_start(&serial_wq, serial_wq_stack, K_THREAD_STACK_SIZEOF(serial_wq_stack), 14,
-                       &uart_tx_cfg);
+    k_work_queue_start(&serial_wq, serial_wq_stack, K_THREAD_STACK_SIZEOF(serial_wq_stack),
+                       CONFIG_ZMK_SPLIT_SERIAL_THREAD_PRIORITY, &uart_tx_cfg);
 
-    for (int i = 0; i < CONFIG_ZMK_SPLIT_SERIAL_COUNT; i++) {
+    for (int i = 0; i < ZMK_SPLIT_SERIAL_LINK_COUNT; i++) {
         struct serial_device *sd = &serial_devs[i];
         if (!device_is_ready(sd->dev)) {
             LOG_ERR("failed to get serial device %s", sd->dev->name);
@@ -186,12 +559,22 @@ static int serial_init(void) {
 #ifdef CONFIG_ZMK_SPLIT_SERIAL_UART_POLL
         if (sd->poll) {
             k_timer_init(&sd->rx_timer, serial_rx_timer_handler, NULL);
-            k_timer_start(&sd->rx_timer, K_NO_WAIT, K_TICKS(1));
+            serial_poll_start(sd);
             k_work_init(&sd->tx_work, serial_tx_work_handler);
             continue;
         }
 #endif
 
+#ifdef CONFIG_ZMK_SPLIT_SERIAL_UART_ASYNC
+        if (sd->async) {
+            int err = serial_async_init(sd);
+            if (err) {
+                return err;
+            }
+            continue;
+        }
+#endif
+
         int err = uart_irq_callback_user_data_set(sd->dev, serial_callback, sd);
         if (err) {
             LOG_ERR("failed to set callback for %s (err %d)", sd->dev->name, err);
@@ -200,7 +583,12 @@ static int serial_init(void) {
         uart_irq_rx_enable(sd->dev);
     }
 
+#if CONFIG_ZMK_SPLIT_SERIAL_HEALTH_INTERVAL_MS > 0
+    k_work_schedule_for_queue(&serial_wq, &serial_health_work,
+                              K_MSEC(CONFIG_ZMK_SPLIT_SERIAL_HEALTH_INTERVAL_MS));
+#endif
+
     return 0;
 }
 
-SYS_INIT(serial_init, APPLICATION, CONFIG_ZMK_SPLIT_INIT_PRIORITY);
+ZMK_SYS_INIT(serial_init, APPLICATION, CONFIG_ZMK_SPLIT_INIT_PRIORITY);
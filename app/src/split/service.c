@@ -5,12 +5,18 @@
  */
 
 #include <zephyr/types.h>
+#include <zephyr/sys/atomic.h>
 #include <zephyr/sys/util.h>
 #include <zephyr/init.h>
+#include <zephyr/shell/shell.h>
 
 #include <zmk/events/sensor_event.h>
 #include <zmk/sensors.h>
+#include <zmk/pm.h>
 #include <zmk/split/service.h>
+#include <zmk/boot_timing.h>
+#include <zmk/resource_stats.h>
+#include <zmk/workqueue.h>
 
 #include <zephyr/logging/log.h>
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
@@ -24,80 +30,151 @@ K_THREAD_STACK_DEFINE(service_q_stack, CONFIG_ZMK_SPLIT_PERIPHERAL_STACK_SIZE);
 
 struct k_work_q service_work_q;
 
-K_MSGQ_DEFINE(position_state_msgq, sizeof(char[ZMK_SPLIT_POS_STATE_LEN]),
+ZMK_STACK_STATS_DEFINE(service_work_q, service_q_stack, "Split peripheral service");
+ZMK_WORKQUEUE_REGISTER(service_work_q, "Split peripheral service", ZMK_WORKQUEUE_LATENCY_INPUT);
+
+struct k_work_q *zmk_split_service_work_q(void) { return &service_work_q; }
+
+static atomic_t position_queue_stalls;
+static atomic_t coalesced_sensor_events;
+
+struct position_state_msg {
+    int64_t timestamp;
+    uint8_t state[ZMK_SPLIT_POS_STATE_LEN];
+};
+
+K_MSGQ_DEFINE(position_state_msgq, sizeof(struct position_state_msg),
               CONFIG_ZMK_SPLIT_PERIPHERAL_POSITION_QUEUE_SIZE, 4);
 
+ZMK_QUEUE_STATS_DEFINE(position_state_stats, "Peripheral position states",
+                       CONFIG_ZMK_SPLIT_PERIPHERAL_POSITION_QUEUE_SIZE);
+
 void send_position_state_callback(struct k_work *work) {
-    uint8_t state[ZMK_SPLIT_POS_STATE_LEN];
+    struct position_state_msg msg;
 
-    while (k_msgq_get(&position_state_msgq, &state, K_NO_WAIT) == 0) {
-        send_position_state_impl(state, sizeof(state));
+    while (k_msgq_get(&position_state_msgq, &msg, K_NO_WAIT) == 0) {
+        send_position_state_impl(msg.state, sizeof(msg.state), msg.timestamp);
     }
 };
 
 K_WORK_DEFINE(service_position_notify_work, send_position_state_callback);
 
-int send_position_state() {
-    int err = k_msgq_put(&position_state_msgq, position_state, K_MSEC(100));
+static bool position_state_flush(void) {
+    return k_msgq_num_used_get(&position_state_msgq) == 0 &&
+           !k_work_is_pending(&service_position_notify_work);
+}
+
+ZMK_PM_FLUSH_DEFINE(split_position_state, position_state_flush);
+
+int send_position_state(int64_t timestamp) {
+    struct position_state_msg msg = {.timestamp = timestamp};
+    memcpy(msg.state, position_state, sizeof(msg.state));
+
+    // Every state has to reach the central, or a release could be lost, so wait for the transport
+    // to catch up instead of discarding queued states.
+    int err;
+    while ((err = k_msgq_put(&position_state_msgq, &msg, K_MSEC(100))) == -EAGAIN) {
+        atomic_inc(&position_queue_stalls);
+        zmk_queue_stats_overflowed(&position_state_stats);
+        LOG_WRN("Position state message queue full, waiting for it to drain");
+    }
+
     if (err) {
-        switch (err) {
-        case -EAGAIN: {
-            LOG_WRN("Position state message queue full, popping first message and queueing again");
-            uint8_t discarded_state[ZMK_SPLIT_POS_STATE_LEN];
-            k_msgq_get(&position_state_msgq, &discarded_state, K_NO_WAIT);
-            return send_position_state();
-        }
-        default:
-            LOG_WRN("Failed to queue position state to send (%d)", err);
-            return err;
-        }
+        LOG_WRN("Failed to queue position state to send (%d)", err);
+        return err;
     }
 
+    zmk_queue_stats_queued(&position_state_stats, k_msgq_num_used_get(&position_state_msgq));
+
     k_work_submit_to_queue(&service_work_q, &service_position_notify_work);
 
     return 0;
 }
 
-int zmk_split_position_pressed(uint8_t position) {
+int zmk_split_position_pressed(uint8_t position, int64_t timestamp) {
     WRITE_BIT(position_state[position / 8], position % 8, true);
-    return send_position_state();
+    return send_position_state(timestamp);
 }
 
-int zmk_split_position_released(uint8_t position) {
+int zmk_split_position_released(uint8_t position, int64_t timestamp) {
     WRITE_BIT(position_state[position / 8], position % 8, false);
-    return send_position_state();
+    return send_position_state(timestamp);
 }
 
 #if ZMK_KEYMAP_HAS_SENSORS
-K_MSGQ_DEFINE(sensor_state_msgq, sizeof(struct sensor_event),
-              CONFIG_ZMK_SPLIT_PERIPHERAL_POSITION_QUEUE_SIZE, 4);
+BUILD_ASSERT(ZMK_KEYMAP_SENSORS_LEN <= 32, "Pending sensor events are tracked in a 32 bit mask");
+
+// One event per sensor waiting for its send window to close. Rotation deltas which arrive in the
+// meantime are added up, so a fast spin is sent as one net rotation that the central's sensor
+// behaviors turn into the same number of triggers. Other channels keep their latest value.
+static struct sensor_event pending_sensor_events[ZMK_KEYMAP_SENSORS_LEN];
+static uint32_t pending_sensors;
+static struct k_spinlock sensor_lock;
+
+static void send_sensor_state_callback(struct k_work *work) {
+    for (uint8_t i = 0; i < ZMK_KEYMAP_SENSORS_LEN; i++) {
+        k_spinlock_key_t key = k_spin_lock(&sensor_lock);
+        bool pending = pending_sensors & BIT(i);
+        if (pending) {
+            last_sensor_event = pending_sensor_events[i];
+            pending_sensors &= ~BIT(i);
+        }
+        k_spin_unlock(&sensor_lock, key);
 
-void send_sensor_state_callback(struct k_work *work) {
-    while (k_msgq_get(&sensor_state_msgq, &last_sensor_event, K_NO_WAIT) == 0) {
-        send_sensor_state_impl(&last_sensor_event, sizeof(last_sensor_event));
+        if (pending) {
+            send_sensor_state_impl(&last_sensor_event, sizeof(last_sensor_event));
+        }
     }
 };
 
-K_WORK_DEFINE(service_sensor_notify_work, send_sensor_state_callback);
+static K_WORK_DELAYABLE_DEFINE(service_sensor_notify_work, send_sensor_state_callback);
 
-int send_sensor_state(struct sensor_event ev) {
-    int err = k_msgq_put(&sensor_state_msgq, &ev, K_MSEC(100));
-    if (err) {
-        // retry...
-        switch (err) {
-        case -EAGAIN: {
-            LOG_WRN("Sensor state message queue full, popping first message and queueing again");
-            struct sensor_event discarded_state;
-            k_msgq_get(&sensor_state_msgq, &discarded_state, K_NO_WAIT);
-            return send_sensor_state(ev);
+static void merge_sensor_event(struct sensor_event *pending, const struct sensor_event *ev) {
+    if (pending->channel_data_size != ev->channel_data_size) {
+        *pending = *ev;
+        return;
+    }
+
+    for (int i = 0; i < ev->channel_data_size; i++) {
+        struct zmk_sensor_channel_data *acc = &pending->channel_data[i];
+        const struct zmk_sensor_channel_data *data = &ev->channel_data[i];
+
+        if (acc->channel != SENSOR_CHAN_ROTATION || data->channel != SENSOR_CHAN_ROTATION) {
+            *acc = *data;
+            continue;
         }
-        default:
-            LOG_WRN("Failed to queue sensor state to send (%d)", err);
-            return err;
+
+        acc->value.val1 += data->value.val1;
+        acc->value.val2 += data->value.val2;
+
+        // Encoders reporting plain ticks in val2 leave val1 at zero, so only carry for degrees.
+        if (acc->value.val1 != 0 && (acc->value.val2 >= 1000000 || acc->value.val2 <= -1000000)) {
+            acc->value.val1 += acc->value.val2 / 1000000;
+            acc->value.val2 %= 1000000;
         }
     }
+}
+
+int send_sensor_state(struct sensor_event ev) {
+    if (ev.sensor_index >= ZMK_KEYMAP_SENSORS_LEN) {
+        return -EINVAL;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&sensor_lock);
+
+    if (pending_sensors & BIT(ev.sensor_index)) {
+        merge_sensor_event(&pending_sensor_events[ev.sensor_index], &ev);
+        atomic_inc(&coalesced_sensor_events);
+    } else {
+        pending_sensor_events[ev.sensor_index] = ev;
+        pending_sensors |= BIT(ev.sensor_index);
+    }
+
+    k_spin_unlock(&sensor_lock, key);
 
-    k_work_submit_to_queue(&service_work_q, &service_sensor_notify_work);
+    // The window opens with the first pending event and is not extended by later ones.
+    k_work_schedule_for_queue(&service_work_q, &service_sensor_notify_work,
+                              K_MSEC(CONFIG_ZMK_SPLIT_PERIPHERAL_SENSOR_SEND_WINDOW_MS));
     return 0;
 }
 
@@ -116,6 +193,33 @@ int zmk_split_sensor_triggered(uint8_t sensor_index,
 }
 #endif /* ZMK_KEYMAP_HAS_SENSORS */
 
+#if IS_ENABLED(CONFIG_SHELL)
+
+static int cmd_split_stats(const struct shell *sh, size_t argc, char **argv) {
+    shell_print(sh, "Position state queue stalls: %ld", (long)atomic_get(&position_queue_stalls));
+#if ZMK_KEYMAP_HAS_SENSORS
+    shell_print(sh, "Coalesced sensor events: %ld", (long)atomic_get(&coalesced_sensor_events));
+#endif
+    return 0;
+}
+
+static int cmd_split_reset(const struct shell *sh, size_t argc, char **argv) {
+    atomic_clear(&position_queue_stalls);
+    atomic_clear(&coalesced_sensor_events);
+    shell_print(sh, "Split queue statistics reset");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_split,
+                               SHELL_CMD(stats, NULL, "Show message queue statistics",
+                                         cmd_split_stats),
+                               SHELL_CMD(reset, NULL, "Reset statistics", cmd_split_reset),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((zmk), split, &sub_split, "Split message queues", NULL, 0, 0);
+
+#endif // IS_ENABLED(CONFIG_SHELL)
+
 static int service_init(void) {
     static const struct k_work_queue_config queue_config = {
         .name = "Split Peripheral Notification Queue"};
@@ -125,4 +229,4 @@ static int service_init(void) {
     return 0;
 }
 
-SYS_INIT(service_init, APPLICATION, CONFIG_ZMK_SPLIT_INIT_PRIORITY);
+ZMK_SYS_INIT(service_init, APPLICATION, CONFIG_ZMK_SPLIT_INIT_PRIORITY);
@@ -6,6 +6,7 @@
 
 #include <zephyr/device.h>
 #include <zephyr/init.h>
+#include <zephyr/kernel.h>
 
 #include <zephyr/usb/usb_device.h>
 #include <zephyr/usb/class/usb_hid.h>
@@ -16,6 +17,8 @@
 #include <zmk/events/usb_conn_state_changed.h>
 
 #include <zmk/usb_hid.h>
+#include <zmk/raw_hid.h>
+#include <zmk/boot_timing.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
@@ -28,6 +31,15 @@ static void raise_usb_status_changed_event(struct k_work *_work) {
 
 K_WORK_DEFINE(usb_status_notifier_work, raise_usb_status_changed_event);
 
+/*
+ * USB starts early in boot, so the host can enumerate the keyboard while the rest of the firmware
+ * starts. The listeners for state changes may not be initialized yet then, so changes are only
+ * raised once everything else has started.
+ */
+static atomic_t notify_ready;
+
+#define ZMK_USB_NOTIFY_INIT_PRIORITY 99
+
 enum usb_dc_status_code zmk_usb_get_status(void) { return usb_status; }
 
 enum zmk_usb_conn_state zmk_usb_get_conn_state(void) {
@@ -62,7 +74,26 @@ void usb_status_cb(enum usb_dc_status_code status, const uint8_t *params) {
     }
 #endif
     usb_status = status;
-    k_work_submit(&usb_status_notifier_work);
+
+    if (status == USB_DC_CONFIGURED) {
+        zmk_boot_timing_mark("USB configured");
+    }
+
+#if IS_ENABLED(CONFIG_ZMK_RAW_HID)
+    zmk_raw_hid_usb_status_changed(status);
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_USB)
+    if (status == USB_DC_RESUME) {
+        zmk_usb_hid_resumed();
+    } else if (status == USB_DC_CONFIGURED) {
+        zmk_usb_hid_configured();
+    }
+#endif
+
+    if (atomic_get(&notify_ready)) {
+        k_work_submit(&usb_status_notifier_work);
+    }
 };
 
 static int zmk_usb_init(void) {
@@ -78,4 +109,17 @@ static int zmk_usb_init(void) {
     return 0;
 }
 
-SYS_INIT(zmk_usb_init, APPLICATION, CONFIG_ZMK_USB_INIT_PRIORITY);
+ZMK_SYS_INIT(zmk_usb_init, APPLICATION, CONFIG_ZMK_USB_INIT_PRIORITY);
+
+static int zmk_usb_notify_init(void) {
+    atomic_set(&notify_ready, true);
+
+    // Report whatever the host got up to while the firmware was starting.
+    if (usb_status != USB_DC_UNKNOWN) {
+        k_work_submit(&usb_status_notifier_work);
+    }
+
+    return 0;
+}
+
+ZMK_SYS_INIT(zmk_usb_notify_init, APPLICATION, ZMK_USB_NOTIFY_INIT_PRIORITY);
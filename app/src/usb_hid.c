@@ -10,58 +10,254 @@
 #include <zephyr/usb/usb_device.h>
 #include <zephyr/usb/class/usb_hid.h>
 
+#include <zmk/pm.h>
 #include <zmk/usb.h>
+#include <zmk/usb_hid.h>
 #include <zmk/hid.h>
 #include <zmk/keymap.h>
 #if IS_ENABLED(CONFIG_ZMK_HID_INDICATORS)
 #include <zmk/hid_indicators.h>
 #endif // IS_ENABLED(CONFIG_ZMK_HID_INDICATORS)
+#include <zmk/behavior_queue.h>
+#include <zmk/endpoints.h>
+#include <zmk/endpoint_latency.h>
 #include <zmk/event_manager.h>
+#include <zmk/profiling.h>
+#include <zmk/resource_stats.h>
 #include <zmk/workqueue.h>
+#include <zmk/boot_timing.h>
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
-static const struct device *hid_dev;
-
 struct usb_hid_msg {
     uint8_t data[CONFIG_HID_INTERRUPT_EP_MPS];
     uint8_t len;
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+    uint32_t origin;
+#endif
+};
+
+// Each report type has its own queue, so a key report never waits behind a queued consumer
+// report. With a separate consumer interface they also go out through separate endpoints.
+#define USB_HID_QUEUE_SIZE 8
+
+K_MSGQ_DEFINE(usb_hid_keyboard_msgq, sizeof(struct usb_hid_msg), USB_HID_QUEUE_SIZE, 1);
+K_MSGQ_DEFINE(usb_hid_consumer_msgq, sizeof(struct usb_hid_msg), USB_HID_QUEUE_SIZE, 1);
+
+ZMK_QUEUE_STATS_DEFINE(usb_hid_keyboard_stats, "USB keyboard reports", USB_HID_QUEUE_SIZE);
+ZMK_QUEUE_STATS_DEFINE(usb_hid_consumer_stats, "USB consumer reports", USB_HID_QUEUE_SIZE);
+
+struct usb_hid_queue {
+    struct k_msgq *msgq;
+    struct zmk_queue_stats *stats;
+    // Layout of the report usages, used to tell which queued reports can be coalesced.
+    uint8_t usages_offset;
+    uint8_t usage_size;
+    // The report currently being sent, kept out of the message queue so newer reports can
+    // replace it while the endpoint is stalled.
+    struct usb_hid_msg pending;
+    bool has_pending;
+    // The last report the host accepted.
+    struct usb_hid_msg last;
+    bool has_last;
+};
+
+static struct usb_hid_queue keyboard_queue = {
+    .msgq = &usb_hid_keyboard_msgq,
+    .stats = &usb_hid_keyboard_stats,
+    .usages_offset = 0,
+    .usage_size = 1,
+};
+
+static struct usb_hid_queue consumer_queue = {
+    .msgq = &usb_hid_consumer_msgq,
+    .stats = &usb_hid_consumer_stats,
+    .usages_offset = offsetof(struct zmk_hid_consumer_report, body),
+    .usage_size = sizeof(((struct zmk_hid_consumer_report_body *)NULL)->keys[0]),
+};
+
+struct usb_hid_iface {
+    const struct device *dev;
+    // Queues sent through this interface's interrupt IN endpoint, highest priority first.
+    struct usb_hid_queue *queues[2];
+    struct k_work_delayable work;
+    // Keep track of the number of consecutive HID writes failures so messages can
+    // be dropped if they continuously fail to send.
+    int failed;
+    // Set while a written report is waiting for the host to read it.
+    bool writing;
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+    // Origin of the report written to the endpoint, recorded once the host has read it.
+    uint32_t in_flight_origin;
+    bool in_flight;
+#endif
+};
+
+#if IS_ENABLED(CONFIG_ZMK_USB_HID_CONSUMER_INTERFACE)
+
+static struct usb_hid_iface ifaces[] = {
+    {.queues = {&keyboard_queue}},
+    {.queues = {&consumer_queue}},
+};
+
+#define KEYBOARD_IFACE (&ifaces[0])
+#define CONSUMER_IFACE (&ifaces[1])
+
+#else
+
+static struct usb_hid_iface ifaces[] = {
+    {.queues = {&keyboard_queue, &consumer_queue}},
 };
 
-// Keep track of the number of consecutive HID writes failures so messages can
-// be dropped if they continuously fail to send.
-static int usb_hid_failed;
+#define KEYBOARD_IFACE (&ifaces[0])
+#define CONSUMER_IFACE (&ifaces[0])
+
+#endif // IS_ENABLED(CONFIG_ZMK_USB_HID_CONSUMER_INTERFACE)
+
+/*
+ * A report can be skipped if every usage slot in it matches either the report before it or the
+ * one after it. Each slot then changes at most once across the three reports, so skipping the
+ * middle one can't hide a press or a release from the host.
+ */
+static bool usb_hid_report_is_redundant(const struct usb_hid_queue *queue,
+                                        const struct usb_hid_msg *prev,
+                                        const struct usb_hid_msg *msg,
+                                        const struct usb_hid_msg *next) {
+    if (msg->len != prev->len || msg->len != next->len) {
+        return false;
+    }
+
+    if (memcmp(msg->data, prev->data, queue->usages_offset) != 0 ||
+        memcmp(msg->data, next->data, queue->usages_offset) != 0) {
+        return false;
+    }
+
+    for (int i = queue->usages_offset; i < msg->len; i += queue->usage_size) {
+        size_t size = MIN(queue->usage_size, msg->len - i);
+        if (memcmp(&msg->data[i], &prev->data[i], size) != 0 &&
+            memcmp(&msg->data[i], &next->data[i], size) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
 
-K_MSGQ_DEFINE(usb_hid_msgq, sizeof(struct usb_hid_msg), 8, 1);
+// Load the next report to send into queue->pending, collapsing any run of queued reports down to
+// the ones the host needs to see every press and release.
+static bool usb_hid_queue_next(struct usb_hid_queue *queue) {
+    struct usb_hid_msg next;
+
+    if (!queue->has_pending) {
+        if (k_msgq_get(queue->msgq, &queue->pending, K_NO_WAIT) != 0) {
+            return false;
+        }
+        queue->has_pending = true;
+    }
+
+    while (queue->has_last && k_msgq_peek(queue->msgq, &next) == 0 &&
+           usb_hid_report_is_redundant(queue, &queue->last, &queue->pending, &next)) {
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+        // The replacement also carries the older event, so measure from that one.
+        uint32_t origin = queue->pending.origin;
+#endif
+        k_msgq_get(queue->msgq, &queue->pending, K_NO_WAIT);
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+        queue->pending.origin = origin;
+#endif
+    }
+
+    return true;
+}
+
+static struct usb_hid_queue *next_queue(struct usb_hid_iface *iface) {
+    for (int i = 0; i < ARRAY_SIZE(iface->queues) && iface->queues[i]; i++) {
+        if (usb_hid_queue_next(iface->queues[i])) {
+            return iface->queues[i];
+        }
+    }
+
+    return NULL;
+}
 
 static void usb_hid_work_handler(struct k_work *work) {
-    struct usb_hid_msg msg;
-    while (k_msgq_peek(&usb_hid_msgq, &msg) == 0) {
+    struct usb_hid_iface *iface =
+        CONTAINER_OF(k_work_delayable_from_work(work), struct usb_hid_iface, work);
+    struct usb_hid_queue *queue;
+
+    // Writes can't succeed while the bus is suspended. Queued reports are sent on resume.
+    if (zmk_usb_get_status() == USB_DC_SUSPEND) {
+        return;
+    }
+
+    while ((queue = next_queue(iface)) != NULL) {
+        // The host can read the report before the write returns, so mark it as written first, and
+        // put back what an earlier report set if the write fails.
+        bool was_writing = iface->writing;
+        iface->writing = true;
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+        uint32_t prev_origin = iface->in_flight_origin;
+        bool was_in_flight = iface->in_flight;
+        iface->in_flight_origin = queue->pending.origin;
+        iface->in_flight = true;
+#endif
+
         // Attempt to write HID message. If it fails, retry with up to a total
         // of three attempts. Reattempt after 10ms or when the USB HID interrupt
         // IN endpoint is ready, whichever comes first.
-        int err = hid_int_ep_write(hid_dev, msg.data, msg.len, NULL);
+        int err = hid_int_ep_write(iface->dev, queue->pending.data, queue->pending.len, NULL);
         if (err) {
-            usb_hid_failed++;
-            if (usb_hid_failed < 3) {
-                k_work_reschedule_for_queue(zmk_workqueue_lowprio_work_q(),
-                                            k_work_delayable_from_work(work), K_MSEC(10));
+            iface->writing = was_writing;
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+            iface->in_flight_origin = prev_origin;
+            iface->in_flight = was_in_flight;
+#endif
+            iface->failed++;
+            if (iface->failed < 3) {
+                k_work_reschedule_for_queue(zmk_workqueue_lowprio_work_q(), &iface->work,
+                                            K_MSEC(10));
                 return;
             } else {
-                LOG_ERR("dropped HID message due to %d consecutive failures", usb_hid_failed);
+                LOG_ERR("dropped HID message due to %d consecutive failures", iface->failed);
+                queue->has_last = false;
             }
+        } else {
+            queue->last = queue->pending;
+            queue->has_last = true;
         }
 
-        // Remove message from message queue and reset failure count.
-        k_msgq_get(&usb_hid_msgq, &msg, K_NO_WAIT);
-        usb_hid_failed = 0;
+        // Release the pending message and reset failure count.
+        queue->has_pending = false;
+        iface->failed = 0;
     }
 }
 
-K_WORK_DELAYABLE_DEFINE(usb_hid_work, usb_hid_work_handler);
+static struct usb_hid_iface *iface_for_dev(const struct device *dev) {
+    for (int i = 0; i < ARRAY_SIZE(ifaces); i++) {
+        if (ifaces[i].dev == dev) {
+            return &ifaces[i];
+        }
+    }
+
+    return NULL;
+}
 
 static void in_ready_cb(const struct device *dev) {
-    k_work_reschedule_for_queue(zmk_workqueue_lowprio_work_q(), &usb_hid_work, K_NO_WAIT);
+    struct usb_hid_iface *iface = iface_for_dev(dev);
+    if (iface) {
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+        if (iface->in_flight) {
+            iface->in_flight = false;
+            zmk_endpoint_latency_record(ZMK_TRANSPORT_USB, iface->in_flight_origin);
+        }
+#endif
+        if (iface->writing) {
+            iface->writing = false;
+            zmk_profiling_transport_done();
+            zmk_behavior_queue_report_delivered();
+        }
+        k_work_reschedule_for_queue(zmk_workqueue_lowprio_work_q(), &iface->work, K_NO_WAIT);
+    }
 }
 
 #define HID_GET_REPORT_TYPE_MASK 0xff00
@@ -164,35 +360,124 @@ static const struct hid_ops ops = {
     .set_report = set_report_cb,
 };
 
-static int zmk_usb_hid_send_report(const uint8_t *report, size_t len) {
+static int usb_hid_enqueue(struct usb_hid_iface *iface, struct usb_hid_queue *queue,
+                           const uint8_t *report, size_t len, bool schedule) {
+    struct usb_hid_msg msg = {.len = len};
+    memcpy(&msg.data, report, len);
+#if IS_ENABLED(CONFIG_ZMK_ENDPOINT_LATENCY)
+    msg.origin = zmk_endpoint_latency_origin();
+#endif
+    if (k_msgq_put(queue->msgq, &msg, K_NO_WAIT)) {
+        zmk_queue_stats_overflowed(queue->stats);
+        LOG_ERR("failed to add HID message to queue");
+        return 0;
+    }
+
+    zmk_queue_stats_queued(queue->stats, k_msgq_num_used_get(queue->msgq));
+    if (schedule) {
+        // Add to queue. This uses "schedule" rather than "reschedule"
+        // to keep the existing delay if the work item is already in the
+        // queue such as following a USB HID write failure.
+        k_work_schedule_for_queue(zmk_workqueue_lowprio_work_q(), &iface->work, K_NO_WAIT);
+    }
+    return 0;
+}
+
+// Don't repeat a remote wakeup request more often than this while the host wakes up.
+#define USB_HID_WAKEUP_RETRY_MS 1000
+
+// Uptime of the last remote wakeup request for the current suspend, or 0 if there was none.
+static int64_t wakeup_requested_at;
+
+/*
+ * Set when a report couldn't be sent because the host hadn't configured the device yet, such as
+ * while it enumerates after a KVM switch. The reports hold the current state of the keys rather
+ * than a history of them, so only the latest state needs sending once the host is ready for it.
+ */
+static atomic_t state_unsent;
+
+static int zmk_usb_hid_send_report(struct usb_hid_iface *iface, struct usb_hid_queue *queue,
+                                   const uint8_t *report, size_t len) {
     switch (zmk_usb_get_status()) {
     case USB_DC_SUSPEND:
-        return usb_wakeup_request();
+        // The first report wakes the host. Reports are then queued until the bus resumes, so the
+        // keystrokes that woke the host still reach it.
+        if (wakeup_requested_at == 0 ||
+            k_uptime_get() - wakeup_requested_at >= USB_HID_WAKEUP_RETRY_MS) {
+            int err = usb_wakeup_request();
+            if (err) {
+                return err;
+            }
+            wakeup_requested_at = k_uptime_get();
+        }
+        return usb_hid_enqueue(iface, queue, report, len, false);
     case USB_DC_ERROR:
+    case USB_DC_CONNECTED:
     case USB_DC_RESET:
     case USB_DC_DISCONNECTED:
     case USB_DC_UNKNOWN:
+        // The host can't read reports until it has configured the device.
+        atomic_set(&state_unsent, true);
         return -ENODEV;
-    default: {
-        struct usb_hid_msg msg = {.len = len};
-        memcpy(&msg.data, report, len);
-        if (k_msgq_put(&usb_hid_msgq, &msg, K_NO_WAIT)) {
-            LOG_ERR("failed to add HID message to queue");
-        } else {
-            // Add to queue. This uses "schedule" rather than "reschedule"
-            // to keep the existing delay if the work item is already in the
-            // queue such as following a USB HID write failure.
-            k_work_schedule_for_queue(zmk_workqueue_lowprio_work_q(), &usb_hid_work, K_NO_WAIT);
-        }
-        return 0;
+    default:
+        return usb_hid_enqueue(iface, queue, report, len, true);
+    }
+}
+
+static void usb_hid_configured_work_handler(struct k_work *work) {
+    // The endpoint may have moved to another transport in the meantime.
+    if (zmk_endpoints_selected().transport != ZMK_TRANSPORT_USB) {
+        return;
+    }
+
+    zmk_usb_hid_send_keyboard_report();
+    zmk_usb_hid_send_consumer_report();
+}
+
+static K_WORK_DEFINE(usb_hid_configured_work, usb_hid_configured_work_handler);
+
+void zmk_usb_hid_configured(void) {
+    if (atomic_cas(&state_unsent, true, false)) {
+        k_work_submit_to_queue(zmk_workqueue_lowprio_work_q(), &usb_hid_configured_work);
+    }
+}
+
+void zmk_usb_hid_resumed(void) {
+    wakeup_requested_at = 0;
+
+    for (int i = 0; i < ARRAY_SIZE(ifaces); i++) {
+        k_work_reschedule_for_queue(zmk_workqueue_lowprio_work_q(), &ifaces[i].work, K_NO_WAIT);
     }
+}
+
+bool zmk_usb_hid_is_idle(void) {
+    // Reports queued while the host isn't reading them are sent once it does, nothing to wait on.
+    if (!zmk_usb_is_hid_ready()) {
+        return true;
     }
+
+    for (int i = 0; i < ARRAY_SIZE(ifaces); i++) {
+        if (ifaces[i].writing) {
+            return false;
+        }
+
+        for (int q = 0; q < ARRAY_SIZE(ifaces[i].queues) && ifaces[i].queues[q]; q++) {
+            const struct usb_hid_queue *queue = ifaces[i].queues[q];
+            if (queue->has_pending || k_msgq_num_used_get(queue->msgq) > 0) {
+                return false;
+            }
+        }
+    }
+
+    return true;
 }
 
+ZMK_PM_FLUSH_DEFINE(usb_hid, zmk_usb_hid_is_idle);
+
 int zmk_usb_hid_send_keyboard_report(void) {
     size_t len;
     uint8_t *report = get_keyboard_report(&len);
-    return zmk_usb_hid_send_report(report, len);
+    return zmk_usb_hid_send_report(KEYBOARD_IFACE, &keyboard_queue, report, len);
 }
 
 int zmk_usb_hid_send_consumer_report(void) {
@@ -203,25 +488,64 @@ int zmk_usb_hid_send_consumer_report(void) {
 #endif /* IS_ENABLED(CONFIG_ZMK_USB_BOOT) */
 
     struct zmk_hid_consumer_report *report = zmk_hid_get_consumer_report();
-    return zmk_usb_hid_send_report((uint8_t *)report, sizeof(*report));
+    return zmk_usb_hid_send_report(CONSUMER_IFACE, &consumer_queue, (uint8_t *)report,
+                                   sizeof(*report));
+}
+
+#if IS_ENABLED(CONFIG_ZMK_USB_HID_CONSUMER_INTERFACE)
+
+static const struct hid_ops consumer_ops = {
+    .int_in_ready = in_ready_cb,
+    .get_report = get_report_cb,
+};
+
+#endif // IS_ENABLED(CONFIG_ZMK_USB_HID_CONSUMER_INTERFACE)
+
+BUILD_ASSERT(CONFIG_USB_HID_DEVICE_COUNT >= ZMK_USB_HID_DEVICE_COUNT,
+             "CONFIG_USB_HID_DEVICE_COUNT is too small for the enabled HID interfaces");
+
+const struct device *zmk_usb_hid_get_device(uint8_t index) {
+    char name[] = "HID_0";
+
+    if (index >= CONFIG_USB_HID_DEVICE_COUNT || index > 9) {
+        return NULL;
+    }
+
+    name[sizeof(name) - 2] += index;
+    return device_get_binding(name);
 }
 
 static int zmk_usb_hid_init(void) {
-    hid_dev = device_get_binding("HID_0");
-    if (hid_dev == NULL) {
-        LOG_ERR("Unable to locate HID device");
-        return -EINVAL;
+    // The keyboard and consumer interfaces are the first entries, matching their device indices.
+    for (int i = 0; i < ARRAY_SIZE(ifaces); i++) {
+        ifaces[i].dev = zmk_usb_hid_get_device(ZMK_USB_HID_DEVICE_KEYBOARD + i);
+        if (ifaces[i].dev == NULL) {
+            LOG_ERR("Unable to locate HID device %d", ZMK_USB_HID_DEVICE_KEYBOARD + i);
+            return -EINVAL;
+        }
+
+        k_work_init_delayable(&ifaces[i].work, usb_hid_work_handler);
     }
 
-    usb_hid_register_device(hid_dev, zmk_hid_report_desc, sizeof(zmk_hid_report_desc), &ops);
+#if IS_ENABLED(CONFIG_ZMK_USB_HID_CONSUMER_INTERFACE)
+    usb_hid_register_device(KEYBOARD_IFACE->dev, zmk_hid_keyboard_report_desc,
+                            sizeof(zmk_hid_keyboard_report_desc), &ops);
+    usb_hid_register_device(CONSUMER_IFACE->dev, zmk_hid_consumer_report_desc,
+                            sizeof(zmk_hid_consumer_report_desc), &consumer_ops);
+#else
+    usb_hid_register_device(KEYBOARD_IFACE->dev, zmk_hid_get_report_desc(),
+                            ZMK_HID_REPORT_DESC_LEN, &ops);
+#endif // IS_ENABLED(CONFIG_ZMK_USB_HID_CONSUMER_INTERFACE)
 
 #if IS_ENABLED(CONFIG_ZMK_USB_BOOT)
-    usb_hid_set_proto_code(hid_dev, HID_BOOT_IFACE_CODE_KEYBOARD);
+    usb_hid_set_proto_code(KEYBOARD_IFACE->dev, HID_BOOT_IFACE_CODE_KEYBOARD);
 #endif /* IS_ENABLED(CONFIG_ZMK_USB_BOOT) */
 
-    usb_hid_init(hid_dev);
+    for (int i = 0; i < ARRAY_SIZE(ifaces); i++) {
+        usb_hid_init(ifaces[i].dev);
+    }
 
     return 0;
 }
 
-SYS_INIT(zmk_usb_hid_init, APPLICATION, CONFIG_ZMK_USB_HID_INIT_PRIORITY);
+ZMK_SYS_INIT(zmk_usb_hid_init, APPLICATION, CONFIG_ZMK_USB_HID_INIT_PRIORITY);
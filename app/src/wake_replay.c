@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2024 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <zephyr/drivers/hwinfo.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/boot_timing.h>
+#include <zmk/endpoints.h>
+#include <zmk/event_manager.h>
+#include <zmk/events/endpoint_changed.h>
+#include <zmk/events/position_state_changed.h>
+#include <zmk/input_frame.h>
+#include <zmk/workqueue.h>
+
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+#include <zmk/ble.h>
+#include <zmk/events/ble_active_profile_changed.h>
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_USB)
+#include <zmk/usb.h>
+#include <zmk/events/usb_conn_state_changed.h>
+#endif
+
+// Key presses that arrived before the selected endpoint was connected, in order. Only accessed
+// from the input work queue.
+static struct zmk_position_state_changed_event captured[CONFIG_ZMK_WAKE_REPLAY_MAX_EVENTS];
+static size_t captured_count;
+
+// Set once the first connection or the timeout ends the window for holding back events, or from
+// the start on a boot that wasn't a wake from deep sleep or soft off.
+static bool replay_done;
+
+static bool endpoint_is_connected(void) {
+    switch (zmk_endpoints_selected().transport) {
+#if IS_ENABLED(CONFIG_ZMK_USB)
+    case ZMK_TRANSPORT_USB:
+        return zmk_usb_is_hid_ready();
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+    case ZMK_TRANSPORT_BLE:
+        return zmk_ble_active_profile_is_connected();
+#endif
+
+    default:
+        return false;
+    }
+}
+
+static void replay_captured(void) {
+    const size_t count = captured_count;
+
+    replay_done = true;
+    captured_count = 0;
+
+    LOG_DBG("Replaying %d key position events held back until connected", count);
+
+    // The replayed events are batched into reports like the events of a scan.
+    zmk_input_frame_begin();
+    for (size_t i = 0; i < count; i++) {
+        ZMK_EVENT_RELEASE(captured[i]);
+    }
+    zmk_input_frame_end();
+}
+
+static void replay_work_handler(struct k_work *work) { replay_captured(); }
+
+static K_WORK_DELAYABLE_DEFINE(replay_work, replay_work_handler);
+
+static int capture_position(const struct zmk_position_state_changed *ev) {
+    if (replay_done) {
+        return ZMK_EV_EVENT_BUBBLE;
+    }
+
+    if (captured_count == 0 &&
+        (endpoint_is_connected() || k_uptime_get() > CONFIG_ZMK_WAKE_REPLAY_TIMEOUT_MS)) {
+        // Nothing was held back, so there is nothing to replay from now on.
+        replay_done = true;
+        return ZMK_EV_EVENT_BUBBLE;
+    }
+
+    if (captured_count == ARRAY_SIZE(captured)) {
+        // Keep the events in order by replaying the held back ones before this one.
+        k_work_cancel_delayable(&replay_work);
+        replay_captured();
+        return ZMK_EV_EVENT_BUBBLE;
+    }
+
+    if (captured_count == 0) {
+        k_work_schedule_for_queue(zmk_workqueue_input_work_q(), &replay_work,
+                                  K_TIMEOUT_ABS_MS(CONFIG_ZMK_WAKE_REPLAY_TIMEOUT_MS));
+    }
+
+    captured[captured_count++] = copy_raised_zmk_position_state_changed(ev);
+
+    return ZMK_EV_EVENT_CAPTURED;
+}
+
+static void connected_work_handler(struct k_work *work) {
+    if (captured_count > 0 && endpoint_is_connected()) {
+        // Give the host a moment to enable notifications before sending it reports.
+        k_work_reschedule_for_queue(zmk_workqueue_input_work_q(), &replay_work,
+                                    K_MSEC(CONFIG_ZMK_WAKE_REPLAY_DELAY_MS));
+    }
+}
+
+static K_WORK_DEFINE(connected_work, connected_work_handler);
+
+static int wake_replay_listener(const zmk_event_t *eh) {
+    const struct zmk_position_state_changed *ev = as_zmk_position_state_changed(eh);
+    if (ev) {
+        return capture_position(ev);
+    }
+
+    // Connection events are raised from other queues, so check the captured events on the queue
+    // that owns them.
+    k_work_submit_to_queue(zmk_workqueue_input_work_q(), &connected_work);
+
+    return ZMK_EV_EVENT_BUBBLE;
+}
+
+static int wake_replay_init(void) {
+    uint32_t cause;
+
+    int err = hwinfo_get_reset_cause(&cause);
+    if (err < 0) {
+        LOG_WRN("Failed to get the reset cause (err %d), not holding back key presses", err);
+        replay_done = true;
+        return 0;
+    }
+
+    // The cause is sticky on some SoCs, such as RESETREAS on the nRF52, so clear it or every
+    // later reset would look like a wake too.
+    hwinfo_clear_reset_cause();
+
+    // Waking from deep sleep or soft off is a reset from the low power state. Any other boot has
+    // no waking key press to hold back.
+    replay_done = !(cause & RESET_LOW_POWER_WAKE);
+    return 0;
+}
+
+ZMK_SYS_INIT(wake_replay_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+ZMK_LISTENER(wake_replay, wake_replay_listener);
+ZMK_SUBSCRIPTION(wake_replay, zmk_position_state_changed);
+ZMK_SUBSCRIPTION(wake_replay, zmk_endpoint_changed);
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+ZMK_SUBSCRIPTION(wake_replay, zmk_ble_active_profile_changed);
+#endif
+#if IS_ENABLED(CONFIG_ZMK_USB)
+ZMK_SUBSCRIPTION(wake_replay, zmk_usb_conn_state_changed);
+#endif
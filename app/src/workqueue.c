@@ -6,22 +6,116 @@
 
 #include <zephyr/kernel.h>
 #include <zephyr/device.h>
+#include <zephyr/init.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #include <zmk/workqueue.h>
+#include <zmk/boot_timing.h>
+#include <zmk/resource_stats.h>
+
+#if IS_ENABLED(CONFIG_ZMK_LOW_PRIORITY_WORK_QUEUE)
 
 K_THREAD_STACK_DEFINE(lowprio_q_stack, CONFIG_ZMK_LOW_PRIORITY_THREAD_STACK_SIZE);
 
 static struct k_work_q lowprio_work_q;
 
+ZMK_STACK_STATS_DEFINE(lowprio_work_q, lowprio_q_stack, "Low priority work queue");
+ZMK_WORKQUEUE_REGISTER(lowprio_work_q, "Low priority work queue", ZMK_WORKQUEUE_LATENCY_BULK);
+
 struct k_work_q *zmk_workqueue_lowprio_work_q(void) {
     return &lowprio_work_q;
 }
 
+#endif // IS_ENABLED(CONFIG_ZMK_LOW_PRIORITY_WORK_QUEUE)
+
+#if IS_ENABLED(CONFIG_ZMK_INPUT_WORK_QUEUE)
+
+K_THREAD_STACK_DEFINE(input_q_stack, CONFIG_ZMK_INPUT_THREAD_STACK_SIZE);
+
+static struct k_work_q input_work_q;
+
+ZMK_STACK_STATS_DEFINE(input_work_q, input_q_stack, "Input work queue");
+ZMK_WORKQUEUE_REGISTER(input_work_q, "Input work queue", ZMK_WORKQUEUE_LATENCY_INPUT);
+// Left with mostly BLE and USB work once input has its own queue.
+ZMK_WORKQUEUE_REGISTER(k_sys_work_q, "System work queue", ZMK_WORKQUEUE_LATENCY_TRANSPORT);
+
+struct k_work_q *zmk_workqueue_input_work_q(void) { return &input_work_q; }
+
+#else
+
+ZMK_WORKQUEUE_REGISTER(k_sys_work_q, "System work queue", ZMK_WORKQUEUE_LATENCY_INPUT);
+
+struct k_work_q *zmk_workqueue_input_work_q(void) { return &k_sys_work_q; }
+
+#endif // IS_ENABLED(CONFIG_ZMK_INPUT_WORK_QUEUE)
+
 static int workqueue_init(void) {
+#if IS_ENABLED(CONFIG_ZMK_LOW_PRIORITY_WORK_QUEUE)
     static const struct k_work_queue_config queue_config = {.name = "Low Priority Work Queue"};
     k_work_queue_start(&lowprio_work_q, lowprio_q_stack, K_THREAD_STACK_SIZEOF(lowprio_q_stack),
                        CONFIG_ZMK_LOW_PRIORITY_THREAD_PRIORITY, &queue_config);
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_INPUT_WORK_QUEUE)
+    static const struct k_work_queue_config input_queue_config = {.name = "Input Work Queue"};
+    k_work_queue_start(&input_work_q, input_q_stack, K_THREAD_STACK_SIZEOF(input_q_stack),
+                       CONFIG_ZMK_INPUT_THREAD_PRIORITY, &input_queue_config);
+#endif
+
     return 0;
 }
 
-SYS_INIT(workqueue_init, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
+ZMK_SYS_INIT(workqueue_init, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
+
+#if IS_ENABLED(CONFIG_ZMK_WORKQUEUE_AUDIT)
+
+// Runs after every other APPLICATION init, by which point all the work queues are started.
+#define ZMK_WORKQUEUE_AUDIT_INIT_PRIORITY 99
+
+static const char *const latency_names[] = {
+    [ZMK_WORKQUEUE_LATENCY_INPUT] = "input",
+    [ZMK_WORKQUEUE_LATENCY_TRANSPORT] = "transport",
+    [ZMK_WORKQUEUE_LATENCY_BULK] = "bulk",
+};
+
+// Queues that are started later, such as on deferred init, are left out.
+static bool workqueue_started(const struct zmk_workqueue_entry *entry) {
+    return entry->work_q->flags & K_WORK_QUEUE_STARTED;
+}
+
+static int workqueue_priority(const struct zmk_workqueue_entry *entry) {
+    return k_thread_priority_get(k_work_queue_thread_get(entry->work_q));
+}
+
+// Work waits behind everything on a queue of a higher thread priority, so a queue for more
+// urgent work with a lower priority lets less urgent work delay it.
+static int workqueue_audit(void) {
+    STRUCT_SECTION_FOREACH(zmk_workqueue_entry, entry) {
+        if (!workqueue_started(entry)) {
+            continue;
+        }
+
+        LOG_DBG("%s runs %s work at priority %d", entry->name, latency_names[entry->latency],
+                workqueue_priority(entry));
+
+        STRUCT_SECTION_FOREACH(zmk_workqueue_entry, other) {
+            if (other->latency <= entry->latency || !workqueue_started(other)) {
+                continue;
+            }
+
+            if (workqueue_priority(entry) > workqueue_priority(other)) {
+                LOG_WRN("%s runs %s work at priority %d, behind %s with %s work at priority %d",
+                        entry->name, latency_names[entry->latency], workqueue_priority(entry),
+                        other->name, latency_names[other->latency], workqueue_priority(other));
+            }
+        }
+    }
+
+    return 0;
+}
+
+ZMK_SYS_INIT(workqueue_audit, APPLICATION, ZMK_WORKQUEUE_AUDIT_INIT_PRIORITY);
+
+#endif // IS_ENABLED(CONFIG_ZMK_WORKQUEUE_AUDIT)
@@ -7,6 +7,8 @@
 #include <zephyr/device.h>
 #include <zephyr/init.h>
 #include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/util.h>
 
 #include <zephyr/logging/log.h>
 
@@ -17,69 +19,115 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 #include <zmk/events/keycode_state_changed.h>
 
 #include <zmk/wpm.h>
-
-#define WPM_UPDATE_INTERVAL_SECONDS 1
-#define WPM_RESET_INTERVAL_SECONDS 5
+#include <zmk/boot_timing.h>
 
 // See https://en.wikipedia.org/wiki/Words_per_minute
 // "Since the length or duration of words is clearly variable, for the purpose of measurement of
 // text entry, the definition of each "word" is often standardized to be five characters or
 // keystrokes long in English"
-#define CHARS_PER_WORD 5.0
+#define CHARS_PER_WORD 5
+
+#define WINDOW_SECONDS CONFIG_ZMK_WPM_WINDOW_SECONDS
 
-static uint8_t wpm_state = -1;
-static uint8_t last_wpm_state;
-static uint8_t wpm_update_counter;
-static uint32_t key_pressed_count;
+/*
+ * Key releases counted in each second of uptime, as a ring indexed by the second. The window is
+ * the WINDOW_SECONDS full seconds before the current one, which has its own bucket so the window
+ * only ever holds complete seconds.
+ */
+static uint16_t buckets[WINDOW_SECONDS + 1];
+/** Releases in the window, kept alongside the buckets so computing the WPM doesn't sum them. */
+static uint32_t window_count;
+/** Second of uptime of the current bucket. */
+static int64_t current_second;
+static struct k_spinlock lock;
+
+static uint8_t wpm_state;
 
 int zmk_wpm_get_state(void) { return wpm_state; }
 
+static struct k_work_delayable wpm_work;
+
+// Moves the ring on to the given second, dropping the buckets that fall out of the window. Only
+// called lazily, when a key is released or the WPM is updated, so an idle ring costs nothing.
+static void advance_to(int64_t second) {
+    const int64_t steps = MIN(second - current_second, WINDOW_SECONDS + 1);
+
+    for (int64_t i = 0; i < steps; i++) {
+        const uint16_t completed = buckets[(current_second + i) % ARRAY_SIZE(buckets)];
+        const int64_t next = (current_second + i + 1) % ARRAY_SIZE(buckets);
+
+        // The completed bucket joins the window, and the one it replaces as the next bucket drops
+        // out of it.
+        window_count += completed;
+        window_count -= buckets[next];
+        buckets[next] = 0;
+    }
+
+    current_second = MAX(current_second, second);
+}
+
+static void schedule_update(void) {
+    // Updates land just after each second starts, when the last second's bucket is complete.
+    k_work_schedule(&wpm_work, K_TIMEOUT_ABS_MS((current_second + 1) * MSEC_PER_SEC));
+}
+
 int wpm_event_listener(const zmk_event_t *eh) {
     const struct zmk_keycode_state_changed *ev = as_zmk_keycode_state_changed(eh);
     if (ev) {
         // count only key up events
         if (!ev->state) {
-            key_pressed_count++;
-            LOG_DBG("key_pressed_count %d keycode %d", key_pressed_count, ev->keycode);
+            k_spinlock_key_t key = k_spin_lock(&lock);
+
+            advance_to(k_uptime_get() / MSEC_PER_SEC);
+            buckets[current_second % ARRAY_SIZE(buckets)]++;
+
+            k_spin_unlock(&lock, key);
+
+            LOG_DBG("Counted release of keycode %d", ev->keycode);
+
+            // Already scheduled updates keep their time, so this is cheap while typing.
+            schedule_update();
         }
     }
     return 0;
 }
 
 void wpm_work_handler(struct k_work *work) {
-    wpm_update_counter++;
-    wpm_state = (key_pressed_count / CHARS_PER_WORD) /
-                (wpm_update_counter * WPM_UPDATE_INTERVAL_SECONDS / 60.0);
+    k_spinlock_key_t key = k_spin_lock(&lock);
 
-    if (last_wpm_state != wpm_state) {
-        LOG_DBG("Raised WPM state changed %d wpm_update_counter %d", wpm_state, wpm_update_counter);
+    advance_to(k_uptime_get() / MSEC_PER_SEC);
 
-        raise_zmk_wpm_state_changed((struct zmk_wpm_state_changed){.state = wpm_state});
+    const uint32_t count = window_count;
+    const bool typing = count > 0 || buckets[current_second % ARRAY_SIZE(buckets)] > 0;
 
-        last_wpm_state = wpm_state;
-    }
+    k_spin_unlock(&lock, key);
 
-    if (wpm_update_counter >= WPM_RESET_INTERVAL_SECONDS) {
-        wpm_update_counter = 0;
-        key_pressed_count = 0;
-    }
-}
+    const uint8_t wpm = MIN(count * 60 / (CHARS_PER_WORD * WINDOW_SECONDS), UINT8_MAX);
+
+    // Small changes are held back so the value doesn't flicker, but reaching zero always shows.
+    if (ABS((int)wpm - (int)wpm_state) >= CONFIG_ZMK_WPM_HYSTERESIS ||
+        (wpm == 0 && wpm_state != 0)) {
+        LOG_DBG("Raised WPM state changed %d from %u key releases", wpm, count);
 
-K_WORK_DEFINE(wpm_work, wpm_work_handler);
+        wpm_state = wpm;
+        raise_zmk_wpm_state_changed((struct zmk_wpm_state_changed){.state = wpm_state});
+    }
 
-void wpm_expiry_function(struct k_timer *_timer) { k_work_submit(&wpm_work); }
+    if (!typing && wpm_state == 0) {
+        // Nothing is left in the window and zero was reported, so stop until the next key.
+        return;
+    }
 
-K_TIMER_DEFINE(wpm_timer, wpm_expiry_function, NULL);
+    schedule_update();
+}
 
 static int wpm_init(void) {
     wpm_state = 0;
-    wpm_update_counter = 0;
-    k_timer_start(&wpm_timer, K_SECONDS(WPM_UPDATE_INTERVAL_SECONDS),
-                  K_SECONDS(WPM_UPDATE_INTERVAL_SECONDS));
+    k_work_init_delayable(&wpm_work, wpm_work_handler);
     return 0;
 }
 
 ZMK_LISTENER(wpm, wpm_event_listener);
 ZMK_SUBSCRIPTION(wpm, zmk_keycode_state_changed);
 
-SYS_INIT(wpm_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+ZMK_SYS_INIT(wpm_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
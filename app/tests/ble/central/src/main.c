@@ -45,6 +45,7 @@ static bool skip_set_security_on_connect = false;
 static bool skip_discovery_on_connect = false;
 static bool read_directly_on_discovery = false;
 static int32_t wait_on_start = 0;
+static uint32_t conn_interval = 0;
 
 static void ble_central_native_posix_options(void) {
     static struct args_struct_t options[] = {
@@ -88,6 +89,11 @@ static void ble_central_native_posix_options(void) {
          .type = 'u',
          .dest = (void *)&wait_on_start,
          .descript = "Time in milliseconds to wait before starting the test process"},
+        {.option = "conn_interval",
+         .name = "units",
+         .type = 'u',
+         .dest = (void *)&conn_interval,
+         .descript = "Connection interval to request, in units of 1.25 ms, instead of the default"},
         ARG_TABLE_ENDMARKER};
 
     native_add_command_line_opts(options);
@@ -101,6 +107,17 @@ static void start_scan(void);
 
 static struct bt_conn *default_conn;
 
+static struct bt_le_conn_param *create_conn_param(void) {
+    static struct bt_le_conn_param param;
+
+    if (conn_interval == 0) {
+        return BT_LE_CONN_PARAM_DEFAULT;
+    }
+
+    param = (struct bt_le_conn_param)BT_LE_CONN_PARAM_INIT(conn_interval, conn_interval, 0, 400);
+    return &param;
+}
+
 static struct bt_uuid_16 uuid = BT_UUID_INIT_16(0);
 static struct bt_gatt_discover_params discover_params;
 static struct bt_gatt_subscribe_params subscribe_params;
@@ -195,7 +212,7 @@ static void reconnect(const bt_addr_le_t *addr) {
         LOG_DBG("Stop LE scan failed (err %d)", err);
     }
 
-    param = BT_LE_CONN_PARAM_DEFAULT;
+    param = create_conn_param();
     err = bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN, param, &default_conn);
     if (err < 0) {
         LOG_DBG("Create conn failed (err %d)", err);
@@ -235,7 +252,7 @@ static bool eir_found(struct bt_data *data, void *user_data) {
                 continue;
             }
 
-            param = BT_LE_CONN_PARAM_DEFAULT;
+            param = create_conn_param();
             err = bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN, param, &default_conn);
             if (err) {
                 LOG_DBG("[Create conn failed] (err %d)", err);
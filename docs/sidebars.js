@@ -44,6 +44,7 @@ module.exports = {
       "behaviors/mod-tap",
       "behaviors/mod-morph",
       "behaviors/macros",
+      "behaviors/string",
       "behaviors/key-toggle",
       "behaviors/sticky-key",
       "behaviors/sticky-layer",